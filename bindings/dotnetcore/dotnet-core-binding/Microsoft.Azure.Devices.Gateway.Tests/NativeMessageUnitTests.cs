@@ -0,0 +1,137 @@
+﻿using System;
+using Xunit;
+using Microsoft.Azure.Devices.Gateway;
+using Moq;
+using System.Collections.Generic;
+using System.Runtime.InteropServices;
+
+namespace Microsoft.Azure.Devices.Gateway.Test
+{
+    public class NativeMessageUnitTests
+    {
+        /* Tests_SRS_DOTNET_CORE_NATIVE_MESSAGE_17_001: [ If any parameter is null, constructor shall throw a ArgumentNullException ] */
+        [Fact]
+        public void NativeMessage_Constructor_with_null_message_throw()
+        {
+            ///arrage
+            Mock<NativeMessageInterop> mockedInterop = new Mock<NativeMessageInterop>();
+
+            ///act
+            ///assert
+            Assert.Throws<ArgumentNullException>(() => new NativeMessage(IntPtr.Zero, mockedInterop.Object));
+
+            ///cleanup
+        }
+
+        /* Tests_SRS_DOTNET_CORE_NATIVE_MESSAGE_17_001: [ If any parameter is null, constructor shall throw a ArgumentNullException ] */
+        [Fact]
+        public void NativeMessage_Constructor_with_null_interop_throw()
+        {
+            ///arrage
+
+            ///act
+            ///assert
+            Assert.Throws<ArgumentNullException>(() => new NativeMessage((IntPtr)0x42, null));
+
+            ///cleanup
+        }
+
+        /* Tests_SRS_DOTNET_CORE_NATIVE_MESSAGE_17_002: [ Content shall be a ReadOnlySpan over the content of the native message, without copying it ] */
+        [Fact]
+        public void NativeMessage_Content_is_a_view_on_the_native_content()
+        {
+            ///arrage
+            Mock<NativeMessageInterop> mockedInterop = new Mock<NativeMessageInterop>();
+            byte[] contentBytes = { 0x01, 0x02, 0x03 };
+            GCHandle pinnedContent = GCHandle.Alloc(contentBytes, GCHandleType.Pinned);
+            IntPtr content = pinnedContent.AddrOfPinnedObject();
+            int size = contentBytes.Length;
+            mockedInterop.Setup(t => t.GetContent((IntPtr)0x42, out content, out size)).Returns(true);
+            NativeMessage nativeMessage = new NativeMessage((IntPtr)0x42, mockedInterop.Object);
+
+            ///act
+            byte[] result = nativeMessage.Content.ToArray();
+            contentBytes[0] = 0x04;
+
+            ///assert
+            Assert.Equal(new byte[] { 0x01, 0x02, 0x03 }, result);
+            Assert.Equal(0x04, nativeMessage.Content[0]);
+
+            ///cleanup
+            nativeMessage.Dispose();
+            pinnedContent.Free();
+        }
+
+        /* Tests_SRS_DOTNET_CORE_NATIVE_MESSAGE_17_003: [ If the content or the properties cannot be had, Content and Properties shall throw an InvalidOperationException ] */
+        [Fact]
+        public void NativeMessage_Content_throw_when_GetContent_fails()
+        {
+            ///arrage
+            Mock<NativeMessageInterop> mockedInterop = new Mock<NativeMessageInterop>();
+            IntPtr content = IntPtr.Zero;
+            int size = 0;
+            mockedInterop.Setup(t => t.GetContent((IntPtr)0x42, out content, out size)).Returns(false);
+            NativeMessage nativeMessage = new NativeMessage((IntPtr)0x42, mockedInterop.Object);
+
+            ///act
+            ///assert
+            Assert.Throws<InvalidOperationException>(() => nativeMessage.Content.ToArray());
+
+            ///cleanup
+            nativeMessage.Dispose();
+        }
+
+        /* Tests_SRS_DOTNET_CORE_NATIVE_MESSAGE_17_004: [ Properties shall enumerate the properties of the native message, decoding each key and value as UTF-8 ] */
+        [Fact]
+        public void NativeMessage_Properties_decodes_the_native_properties()
+        {
+            ///arrage
+            Mock<NativeMessageInterop> mockedInterop = new Mock<NativeMessageInterop>();
+            IntPtr key = Marshal.StringToHGlobalAnsi("key1");
+            IntPtr value = Marshal.StringToHGlobalAnsi("value1");
+            IntPtr keys = Marshal.AllocHGlobal(IntPtr.Size);
+            IntPtr values = Marshal.AllocHGlobal(IntPtr.Size);
+            Marshal.WriteIntPtr(keys, key);
+            Marshal.WriteIntPtr(values, value);
+            int count = 1;
+            mockedInterop.Setup(t => t.GetProperties((IntPtr)0x42, out keys, out values, out count)).Returns(true);
+            NativeMessage nativeMessage = new NativeMessage((IntPtr)0x42, mockedInterop.Object);
+
+            ///act
+            List<KeyValuePair<string, string>> result = new List<KeyValuePair<string, string>>(nativeMessage.Properties);
+
+            ///assert
+            Assert.Equal(1, result.Count);
+            Assert.Equal("key1", result[0].Key);
+            Assert.Equal("value1", result[0].Value);
+
+            ///cleanup
+            nativeMessage.Dispose();
+            Marshal.FreeHGlobal(keys);
+            Marshal.FreeHGlobal(values);
+            Marshal.FreeHGlobal(key);
+            Marshal.FreeHGlobal(value);
+        }
+
+        /* Tests_SRS_DOTNET_CORE_NATIVE_MESSAGE_17_006: [ Once the message is disposed, Content, Properties and ToMessage shall throw an ObjectDisposedException ] */
+        /* Tests_SRS_DOTNET_CORE_NATIVE_MESSAGE_17_007: [ Dispose shall release the native message once, calling Module_DotNetCoreHost_Message_Release ] */
+        [Fact]
+        public void NativeMessage_Dispose_releases_once_and_invalidates_the_message()
+        {
+            ///arrage
+            Mock<NativeMessageInterop> mockedInterop = new Mock<NativeMessageInterop>();
+            NativeMessage nativeMessage = new NativeMessage((IntPtr)0x42, mockedInterop.Object);
+
+            ///act
+            nativeMessage.Dispose();
+            nativeMessage.Dispose();
+
+            ///assert
+            mockedInterop.Verify(t => t.Release((IntPtr)0x42), Times.Once());
+            Assert.Throws<ObjectDisposedException>(() => nativeMessage.Content.ToArray());
+            Assert.Throws<ObjectDisposedException>(() => nativeMessage.ToMessage());
+
+            ///cleanup
+        }
+    }
+}
@@ -5,6 +5,7 @@ using System.IO;
 using Moq;
 using System.Collections.Generic;
 using System.Reflection;
+using System.Runtime.InteropServices;
 
 namespace Microsoft.Azure.Devices.Gateway.Tests
 {
@@ -791,5 +792,111 @@ namespace Microsoft.Azure.Devices.Gateway.Tests
             ///assert
             ///cleanup
         }
+
+        /* Tests_SRS_DOTNET_CORE_NATIVE_MANAGED_GATEWAY_INTEROP_17_001: [ ReceiveMessageHandle shall wrap message in a NativeMessage and dispose it, releasing the native message, once it returns or throws. ] */
+        /* Tests_SRS_DOTNET_CORE_NATIVE_MANAGED_GATEWAY_INTEROP_17_005: [ ReceiveMessageHandle shall raise an Exception if module can't be found. ] */
+        [Fact]
+        public void NetCoreInterop_ReceiveMessageHandle_with_moduleid_that_not_exists_throw_and_release_the_message()
+        {
+            ///arrage
+            Mock<DotNetCoreReflectionLayer> mockedReflectionLayer = new Mock<DotNetCoreReflectionLayer>();
+            Mock<NativeMessageInterop> mockedNativeMessageInterop = new Mock<NativeMessageInterop>();
+            MethodInfo anyFakeMethod = typeof(NetCoreInteropUnitTests).GetRuntimeMethod("anyFakeMethod", new Type[] { });
+
+            mockedReflectionLayer.Setup(t => t.GetMethod(null, "Receive", new Type[] { typeof(Message) })).Returns(anyFakeMethod);
+            mockedReflectionLayer.Setup(t => t.GetMethod(null, "Destroy", new Type[] { })).Returns(anyFakeMethod);
+            NetCoreInterop.replaceReflectionLayer(mockedReflectionLayer.Object, mockedNativeMessageInterop.Object);
+
+            //Make sure we create the dictioary.
+            NetCoreInterop.Create((IntPtr)0x42, (IntPtr)0x42, "AnyAssemblyName", "AnyEntryType", "AnyConfiguration");
+
+            ///act
+            try
+            {
+                NetCoreInterop.ReceiveMessageHandle((IntPtr)0x43, 42);
+            }
+            catch (Exception e)
+            {
+                ///assert
+                Assert.Contains("Module 42 can't be found.", e.Message);
+                mockedNativeMessageInterop.Verify(t => t.Release((IntPtr)0x43), Times.Once());
+                return;
+            }
+            Assert.True(false, "No exception was thrown.");
+
+            ///cleanup
+        }
+
+        /* Tests_SRS_DOTNET_CORE_NATIVE_MANAGED_GATEWAY_INTEROP_17_001: [ ReceiveMessageHandle shall wrap message in a NativeMessage and dispose it, releasing the native message, once it returns or throws. ] */
+        /* Tests_SRS_DOTNET_CORE_NATIVE_MANAGED_GATEWAY_INTEROP_17_002: [ ReceiveMessageHandle shall get the DotNetCoreModuleInstance based on moduleID ] */
+        /* Tests_SRS_DOTNET_CORE_NATIVE_MANAGED_GATEWAY_INTEROP_17_003: [ If the .NET Core client module implements IGatewayModuleNativeReceive, ReceiveMessageHandle shall hand it the NativeMessage. ] */
+        [Fact]
+        public void NetCoreInterop_ReceiveMessageHandle_hands_the_native_message_to_IGatewayModuleNativeReceive()
+        {
+            ///arrage
+            Mock<DotNetCoreReflectionLayer> mockedReflectionLayer = new Mock<DotNetCoreReflectionLayer>();
+            Mock<NativeMessageInterop> mockedNativeMessageInterop = new Mock<NativeMessageInterop>();
+            Mock<IGatewayModule> mockedModule = new Mock<IGatewayModule>();
+            Mock<IGatewayModuleNativeReceive> mockedNativeReceive = mockedModule.As<IGatewayModuleNativeReceive>();
+            MethodInfo anyFakeMethod = typeof(NetCoreInteropUnitTests).GetRuntimeMethod("anyFakeMethod", new Type[] { });
+
+            mockedReflectionLayer.Setup(t => t.CreateInstance(null)).Returns(mockedModule.Object);
+            mockedReflectionLayer.Setup(t => t.GetMethod(null, "Receive", new Type[] { typeof(Message) })).Returns(anyFakeMethod);
+            mockedReflectionLayer.Setup(t => t.GetMethod(null, "Destroy", new Type[] { })).Returns(anyFakeMethod);
+            NetCoreInterop.replaceReflectionLayer(mockedReflectionLayer.Object, mockedNativeMessageInterop.Object);
+
+            uint moduleCreated = NetCoreInterop.Create((IntPtr)0x42, (IntPtr)0x42, "AnyAssemblyName", "AnyEntryType", "AnyConfiguration");
+
+            ///act
+            NetCoreInterop.ReceiveMessageHandle((IntPtr)0x43, moduleCreated);
+
+            ///assert
+            mockedNativeReceive.Verify(t => t.Receive(It.IsAny<NativeMessage>()), Times.Once());
+            mockedReflectionLayer.Verify(t => t.InvokeMethod(It.IsAny<IGatewayModule>(), anyFakeMethod, It.IsAny<Object[]>()), Times.Never());
+            mockedNativeMessageInterop.Verify(t => t.Release((IntPtr)0x43), Times.Once());
+
+            ///cleanup
+        }
+
+        /* Tests_SRS_DOTNET_CORE_NATIVE_MANAGED_GATEWAY_INTEROP_17_004: [ Otherwise ReceiveMessageHandle shall invoke .NET Core client method Receive with a copy of the message made by NativeMessage.ToMessage. ] */
+        [Fact]
+        public void NetCoreInterop_ReceiveMessageHandle_invokes_Receive_with_a_copy_of_the_message()
+        {
+            ///arrage
+            Mock<DotNetCoreReflectionLayer> mockedReflectionLayer = new Mock<DotNetCoreReflectionLayer>();
+            Mock<NativeMessageInterop> mockedNativeMessageInterop = new Mock<NativeMessageInterop>();
+            MethodInfo anyFakeMethod = typeof(NetCoreInteropUnitTests).GetRuntimeMethod("anyFakeMethod", new Type[] { });
+            Message received = null;
+
+            byte[] contentBytes = { 0x01, 0x02, 0x03 };
+            GCHandle pinnedContent = GCHandle.Alloc(contentBytes, GCHandleType.Pinned);
+            IntPtr content = pinnedContent.AddrOfPinnedObject();
+            int size = contentBytes.Length;
+            IntPtr keys = IntPtr.Zero;
+            IntPtr values = IntPtr.Zero;
+            int count = 0;
+
+            mockedNativeMessageInterop.Setup(t => t.GetContent((IntPtr)0x43, out content, out size)).Returns(true);
+            mockedNativeMessageInterop.Setup(t => t.GetProperties((IntPtr)0x43, out keys, out values, out count)).Returns(true);
+            mockedReflectionLayer.Setup(t => t.GetMethod(null, "Receive", new Type[] { typeof(Message) })).Returns(anyFakeMethod);
+            mockedReflectionLayer.Setup(t => t.GetMethod(null, "Destroy", new Type[] { })).Returns(anyFakeMethod);
+            mockedReflectionLayer.Setup(t => t.InvokeMethod(null, anyFakeMethod, It.IsAny<Object[]>()))
+                .Callback<IGatewayModule, MethodInfo, Object[]>((module, method, args) => received = (Message)args[0]);
+            NetCoreInterop.replaceReflectionLayer(mockedReflectionLayer.Object, mockedNativeMessageInterop.Object);
+
+            uint moduleCreated = NetCoreInterop.Create((IntPtr)0x42, (IntPtr)0x42, "AnyAssemblyName", "AnyEntryType", "AnyConfiguration");
+
+            ///act
+            NetCoreInterop.ReceiveMessageHandle((IntPtr)0x43, moduleCreated);
+
+            ///assert
+            Assert.NotNull(received);
+            Assert.Equal(contentBytes, received.Content);
+            Assert.Equal(0, received.Properties.Count);
+            mockedNativeMessageInterop.Verify(t => t.Release((IntPtr)0x43), Times.Once());
+
+            ///cleanup
+            pinnedContent.Free();
+        }
     }
 }
@@ -0,0 +1,17 @@
+﻿// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+namespace Microsoft.Azure.Devices.Gateway
+{
+    /// <summary> Optional Interface to be implemented by the .NET Module to read messages in place </summary>
+    public interface IGatewayModuleNativeReceive
+    {
+        /// <summary>
+        ///     Called upon message receipt instead of <see cref="IGatewayModule.Receive(Message)"/>.
+        ///     The message is given back to the gateway once this method returns.
+        /// </summary>
+        /// <param name="received_message">The message being sent to the module.</param>
+        /// <returns></returns>
+        void Receive(NativeMessage received_message);
+    }
+}
@@ -0,0 +1,154 @@
+﻿// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+using System;
+using System.Collections.Generic;
+using System.Runtime.InteropServices;
+using System.Text;
+
+namespace Microsoft.Azure.Devices.Gateway
+{
+    /// <summary>
+    ///     A message owned by the native gateway, read in place instead of being serialized and parsed again.
+    ///     It is only valid until <see cref="IGatewayModuleNativeReceive.Receive(NativeMessage)"/> returns, copy what has to outlive it.
+    /// </summary>
+    public sealed class NativeMessage : IDisposable
+    {
+        private IntPtr message;
+        private readonly NativeMessageInterop interop;
+
+        internal NativeMessage(IntPtr message, NativeMessageInterop interop)
+        {
+            if (message == IntPtr.Zero)
+            {
+                /* Codes_SRS_DOTNET_CORE_NATIVE_MESSAGE_17_001: [ If any parameter is null, constructor shall throw a ArgumentNullException ] */
+                throw new ArgumentNullException("message", "message cannot be null");
+            }
+            else if (interop == null)
+            {
+                /* Codes_SRS_DOTNET_CORE_NATIVE_MESSAGE_17_001: [ If any parameter is null, constructor shall throw a ArgumentNullException ] */
+                throw new ArgumentNullException("interop", "interop cannot be null");
+            }
+
+            this.message = message;
+            this.interop = interop;
+        }
+
+        private void throwIfDisposed()
+        {
+            if (this.message == IntPtr.Zero)
+            {
+                /* Codes_SRS_DOTNET_CORE_NATIVE_MESSAGE_17_006: [ Once the message is disposed, Content, Properties and ToMessage shall throw an ObjectDisposedException ] */
+                throw new ObjectDisposedException("NativeMessage");
+            }
+        }
+
+        private IntPtr Handle
+        {
+            get
+            {
+                throwIfDisposed();
+                return this.message;
+            }
+        }
+
+        /// <summary>
+        ///     Message Content, a view on the bytes of the native message.
+        /// </summary>
+        public ReadOnlySpan<byte> Content
+        {
+            get
+            {
+                IntPtr content;
+                int size;
+
+                /* Codes_SRS_DOTNET_CORE_NATIVE_MESSAGE_17_002: [ Content shall be a ReadOnlySpan over the content of the native message, without copying it ] */
+                if (!this.interop.GetContent(Handle, out content, out size))
+                {
+                    /* Codes_SRS_DOTNET_CORE_NATIVE_MESSAGE_17_003: [ If the content or the properties cannot be had, Content and Properties shall throw an InvalidOperationException ] */
+                    throw new InvalidOperationException("Could not get the content of the message.");
+                }
+
+                unsafe
+                {
+                    return new ReadOnlySpan<byte>((void*)content, size);
+                }
+            }
+        }
+
+        /// <summary>
+        ///    Message Properties, decoded one by one as they are enumerated.
+        /// </summary>
+        public IEnumerable<KeyValuePair<string, string>> Properties
+        {
+            get
+            {
+                IntPtr keys;
+                IntPtr values;
+                int count;
+
+                /* Codes_SRS_DOTNET_CORE_NATIVE_MESSAGE_17_004: [ Properties shall enumerate the properties of the native message, decoding each key and value as UTF-8 ] */
+                if (!this.interop.GetProperties(Handle, out keys, out values, out count))
+                {
+                    /* Codes_SRS_DOTNET_CORE_NATIVE_MESSAGE_17_003: [ If the content or the properties cannot be had, Content and Properties shall throw an InvalidOperationException ] */
+                    throw new InvalidOperationException("Could not get the properties of the message.");
+                }
+
+                return EnumerateProperties(keys, values, count);
+            }
+        }
+
+        private IEnumerable<KeyValuePair<string, string>> EnumerateProperties(IntPtr keys, IntPtr values, int count)
+        {
+            for (int i = 0; i < count; i++)
+            {
+                // the keys and values are gone with the native message
+                throwIfDisposed();
+                yield return new KeyValuePair<string, string>(
+                    readNullTerminatedString(Marshal.ReadIntPtr(keys, i * IntPtr.Size)),
+                    readNullTerminatedString(Marshal.ReadIntPtr(values, i * IntPtr.Size)));
+            }
+        }
+
+        private static string readNullTerminatedString(IntPtr source)
+        {
+            unsafe
+            {
+                byte* bytes = (byte*)source;
+                int length = 0;
+                while (bytes[length] != 0)
+                {
+                    length++;
+                }
+                return Encoding.UTF8.GetString(bytes, length);
+            }
+        }
+
+        /// <summary>
+        ///     Copies the native message into a <see cref="Message"/> that can be kept once the native message is gone.
+        /// </summary>
+        public Message ToMessage()
+        {
+            /* Codes_SRS_DOTNET_CORE_NATIVE_MESSAGE_17_005: [ ToMessage shall copy the content and the properties into a new Message ] */
+            Dictionary<string, string> properties = new Dictionary<string, string>();
+            foreach (KeyValuePair<string, string> property in Properties)
+            {
+                properties.Add(property.Key, property.Value);
+            }
+            return new Message(Content.ToArray(), properties);
+        }
+
+        /// <summary>
+        ///     Gives the native message back to the gateway.
+        /// </summary>
+        public void Dispose()
+        {
+            if (this.message != IntPtr.Zero)
+            {
+                /* Codes_SRS_DOTNET_CORE_NATIVE_MESSAGE_17_007: [ Dispose shall release the native message once, calling Module_DotNetCoreHost_Message_Release ] */
+                this.interop.Release(this.message);
+                this.message = IntPtr.Zero;
+            }
+        }
+    }
+}
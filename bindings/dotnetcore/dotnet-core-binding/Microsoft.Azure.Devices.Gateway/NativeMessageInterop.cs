@@ -0,0 +1,59 @@
+﻿// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+using System;
+using System.Runtime.InteropServices;
+
+namespace Microsoft.Azure.Devices.Gateway
+{
+    /// <summary>
+    ///     Wrapper Used for Native/Managed Interop on a message owned by the native gateway.
+    /// </summary>
+    internal class NativeMessageInterop
+    {
+        [DllImport(@"dotnetcore", EntryPoint = "Module_DotNetCoreHost_Message_GetContent", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool Module_DotNetCoreHost_Message_GetContent(IntPtr message, out IntPtr content, out Int32 size);
+
+        [DllImport(@"dotnetcore", EntryPoint = "Module_DotNetCoreHost_Message_GetProperties", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool Module_DotNetCoreHost_Message_GetProperties(IntPtr message, out IntPtr keys, out IntPtr values, out Int32 count);
+
+        [DllImport(@"dotnetcore", EntryPoint = "Module_DotNetCoreHost_Message_Release", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void Module_DotNetCoreHost_Message_Release(IntPtr message);
+
+        /// <summary>
+        ///     Gets the content of a native message, without copying it.
+        /// </summary>
+        /// <param name="message">Handle to the native message.</param>
+        /// <param name="content">Pointer to the first byte of the content.</param>
+        /// <param name="size">Size of the content.</param>
+        /// <returns>true on success.</returns>
+        virtual public bool GetContent(IntPtr message, out IntPtr content, out int size)
+        {
+            return Module_DotNetCoreHost_Message_GetContent(message, out content, out size);
+        }
+
+        /// <summary>
+        ///     Gets the properties of a native message, without copying them.
+        /// </summary>
+        /// <param name="message">Handle to the native message.</param>
+        /// <param name="keys">Array of pointers to the null terminated keys.</param>
+        /// <param name="values">Array of pointers to the null terminated values.</param>
+        /// <param name="count">Number of properties.</param>
+        /// <returns>true on success.</returns>
+        virtual public bool GetProperties(IntPtr message, out IntPtr keys, out IntPtr values, out int count)
+        {
+            return Module_DotNetCoreHost_Message_GetProperties(message, out keys, out values, out count);
+        }
+
+        /// <summary>
+        ///     Gives a native message back to the gateway.
+        /// </summary>
+        /// <param name="message">Handle to the native message.</param>
+        virtual public void Release(IntPtr message)
+        {
+            Module_DotNetCoreHost_Message_Release(message);
+        }
+    }
+}
@@ -38,20 +38,27 @@ namespace Microsoft.Azure.Devices.Gateway
         private IDictionary<uint, DotNetCoreModuleInstance> loadedModules = null;
         private uint moduleIDCounter = 0;
         private DotNetCoreReflectionLayer _reflectionLayer;
+        private NativeMessageInterop _nativeMessageInterop;
 
-        private NetCoreInteropInstance(DotNetCoreReflectionLayer interop)
+        private NetCoreInteropInstance(DotNetCoreReflectionLayer interop, NativeMessageInterop nativeMessageInterop)
         {
             _reflectionLayer = interop;
+            _nativeMessageInterop = nativeMessageInterop;
         }
 
         public static NetCoreInteropInstance GetInstance()
         {
-            return new NetCoreInteropInstance(new DotNetCoreReflectionLayer());
+            return new NetCoreInteropInstance(new DotNetCoreReflectionLayer(), new NativeMessageInterop());
         }
 
         public static NetCoreInteropInstance GetInstance(DotNetCoreReflectionLayer dotnetReflectionLayer)
         {
-            return new NetCoreInteropInstance(dotnetReflectionLayer);
+            return new NetCoreInteropInstance(dotnetReflectionLayer, new NativeMessageInterop());
+        }
+
+        public static NetCoreInteropInstance GetInstance(DotNetCoreReflectionLayer dotnetReflectionLayer, NativeMessageInterop nativeMessageInterop)
+        {
+            return new NetCoreInteropInstance(dotnetReflectionLayer, nativeMessageInterop);
         }
 
         public uint Create(IntPtr broker, IntPtr module, string assemblyName, string entryType, string configuration)
@@ -147,6 +154,36 @@ namespace Microsoft.Azure.Devices.Gateway
             }
         }
 
+        public void ReceiveMessageHandle(IntPtr message, uint moduleID)
+        {
+            /* Codes_SRS_DOTNET_CORE_NATIVE_MANAGED_GATEWAY_INTEROP_17_001: [ ReceiveMessageHandle shall wrap message in a NativeMessage and dispose it, releasing the native message, once it returns or throws. ] */
+            using (NativeMessage nativeMessage = new NativeMessage(message, _nativeMessageInterop))
+            {
+                DotNetCoreModuleInstance moduleDetails;
+
+                /* Codes_SRS_DOTNET_CORE_NATIVE_MANAGED_GATEWAY_INTEROP_17_002: [ ReceiveMessageHandle shall get the DotNetCoreModuleInstance based on moduleID ] */
+                if (loadedModules != null && loadedModules.TryGetValue(moduleID, out moduleDetails))
+                {
+                    IGatewayModuleNativeReceive nativeReceiver = moduleDetails.gatewayModule as IGatewayModuleNativeReceive;
+                    if (nativeReceiver != null)
+                    {
+                        /* Codes_SRS_DOTNET_CORE_NATIVE_MANAGED_GATEWAY_INTEROP_17_003: [ If the .NET Core client module implements IGatewayModuleNativeReceive, ReceiveMessageHandle shall hand it the NativeMessage. ] */
+                        nativeReceiver.Receive(nativeMessage);
+                    }
+                    else
+                    {
+                        /* Codes_SRS_DOTNET_CORE_NATIVE_MANAGED_GATEWAY_INTEROP_17_004: [ Otherwise ReceiveMessageHandle shall invoke .NET Core client method Receive with a copy of the message made by NativeMessage.ToMessage. ] */
+                        _reflectionLayer.InvokeMethod(moduleDetails.gatewayModule, moduleDetails.receiveMethodInfo, new Object[] { nativeMessage.ToMessage() });
+                    }
+                }
+                else
+                {
+                    /* Codes_SRS_DOTNET_CORE_NATIVE_MANAGED_GATEWAY_INTEROP_17_005: [ ReceiveMessageHandle shall raise an Exception if module can't be found. ] */
+                    throw new Exception("Module " + moduleID + " can't be found.");
+                }
+            }
+        }
+
         public void Destroy(uint moduleID)
         {
             DotNetCoreModuleInstance moduleDetails;
@@ -200,6 +237,8 @@ namespace Microsoft.Azure.Devices.Gateway
 
         private delegate void ReceiveDelegate([MarshalAs(UnmanagedType.LPArray, SizeParamIndex = 1)] byte[] messageAsArray, UInt32 size, uint moduleID);
 
+        private delegate void ReceiveMessageHandleDelegate(IntPtr message, uint moduleID);
+
         private delegate void DestroyDelegate(uint moduleID);
 
         private delegate void StartDelegate(uint moduleID);
@@ -211,6 +250,13 @@ namespace Microsoft.Azure.Devices.Gateway
         )]
         private static extern void InitializeDelegatesOnNative(IntPtr createAddress, IntPtr receiveAddress, IntPtr destroyAddress, IntPtr startAddress);
 
+        [DllImport("dotnetcore",
+            CharSet = CharSet.Ansi,
+            EntryPoint = "Module_DotNetCoreHost_SetReceiveMessageHandleDelegate",
+            CallingConvention = CallingConvention.Cdecl
+        )]
+        private static extern void InitializeReceiveMessageHandleDelegateOnNative(IntPtr receiveMessageHandleAddress);
+
 
         private static NetCoreInteropInstance _netCoreInteropInstance = NetCoreInteropInstance.GetInstance();
 
@@ -220,6 +266,11 @@ namespace Microsoft.Azure.Devices.Gateway
             _netCoreInteropInstance = NetCoreInteropInstance.GetInstance(dotNetCoreReflectionLayer);
         }
 
+        public static void replaceReflectionLayer(DotNetCoreReflectionLayer dotNetCoreReflectionLayer, NativeMessageInterop nativeMessageInterop)
+        {
+            _netCoreInteropInstance = NetCoreInteropInstance.GetInstance(dotNetCoreReflectionLayer, nativeMessageInterop);
+        }
+
         /// <summary>
         ///    Loads .NET Core module and call the Create method. This method is not thread safe, since gateway serializes calls to Create.
         /// </summary>
@@ -245,6 +296,16 @@ namespace Microsoft.Azure.Devices.Gateway
             _netCoreInteropInstance.Receive(messageAsArray, size, moduleID);
         }
 
+        /// <summary>
+        ///     Calls Receive method on .NET Core module with a message the native gateway still owns, without serializing it.
+        /// </summary>
+        /// <param name="message">Handle to the native message, released once the module is done with it.</param>
+        /// <param name="moduleID">Gateway module ID.</param>
+        public static void ReceiveMessageHandle(IntPtr message, uint moduleID)
+        {
+            _netCoreInteropInstance.ReceiveMessageHandle(message, moduleID);
+        }
+
         /// <summary>
         ///     Calls Destroy method on .NET Core module. This method is not thread safe, since gateway serializes calls to Destroy
         /// </summary>
@@ -265,6 +326,7 @@ namespace Microsoft.Azure.Devices.Gateway
 
         private static CreateDelegate delCreate = null;
         private static ReceiveDelegate delReceive = null;
+        private static ReceiveMessageHandleDelegate delReceiveMessageHandle = null;
         private static DestroyDelegate delDestroy = null;
         private static StartDelegate delStart = null;
 
@@ -273,6 +335,7 @@ namespace Microsoft.Azure.Devices.Gateway
             
             delCreate = Create;
             delReceive = Receive;
+            delReceiveMessageHandle = ReceiveMessageHandle;
             delDestroy = Destroy;
             delStart = Start;
 
@@ -280,6 +343,8 @@ namespace Microsoft.Azure.Devices.Gateway
                                         Marshal.GetFunctionPointerForDelegate(delReceive),
                                         Marshal.GetFunctionPointerForDelegate(delDestroy),
                                         Marshal.GetFunctionPointerForDelegate(delStart));
+
+            InitializeReceiveMessageHandleDelegateOnNative(Marshal.GetFunctionPointerForDelegate(delReceiveMessageHandle));
         }
     }
 }
@@ -32,6 +32,14 @@ MODULE_EXPORT bool Module_DotNetCoreHost_PublishMessage(BROKER_HANDLE broker, MO
 
 MODULE_EXPORT void Module_DotNetCoreHost_SetBindingDelegates(intptr_t createAddress, intptr_t receiveAddress, intptr_t destroyAddress, intptr_t startAddress);
 
+MODULE_EXPORT void Module_DotNetCoreHost_SetReceiveMessageHandleDelegate(intptr_t receiveMessageHandleAddress);
+
+MODULE_EXPORT bool Module_DotNetCoreHost_Message_GetContent(MESSAGE_HANDLE message, const unsigned char** content, int32_t* size);
+
+MODULE_EXPORT bool Module_DotNetCoreHost_Message_GetProperties(MESSAGE_HANDLE message, const char* const** keys, const char* const** values, int32_t* count);
+
+MODULE_EXPORT void Module_DotNetCoreHost_Message_Release(MESSAGE_HANDLE message);
+
 #ifdef __cplusplus
 }
 #endif
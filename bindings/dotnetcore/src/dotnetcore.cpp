@@ -3,6 +3,7 @@
 
 #include <cstring>
 #include <cstdbool>
+#include <cstdint>
 
 #include "module.h"
 #include "message.h"
@@ -30,6 +31,8 @@ typedef unsigned int(DOTNET_CORE_CALLING_CONVENTION *PGatewayCreateDelegate)(int
 
 typedef void(DOTNET_CORE_CALLING_CONVENTION *PGatewayReceiveDelegate)(unsigned char* buffer, int32_t bufferSize, unsigned int moduleIdManaged);
 
+typedef void(DOTNET_CORE_CALLING_CONVENTION *PGatewayReceiveMessageHandleDelegate)(intptr_t message, unsigned int moduleIdManaged);
+
 typedef void(DOTNET_CORE_CALLING_CONVENTION *PGatewayDestroyDelegate)(unsigned int moduleIdManaged);
 
 typedef void(DOTNET_CORE_CALLING_CONVENTION *PGatewayStartDelegate)(unsigned int moduleIdManaged);
@@ -38,6 +41,8 @@ PGatewayCreateDelegate GatewayCreateDelegate = NULL;
 
 PGatewayReceiveDelegate GatewayReceiveDelegate = NULL;
 
+PGatewayReceiveMessageHandleDelegate GatewayReceiveMessageHandleDelegate = NULL;
+
 PGatewayDestroyDelegate GatewayDestroyDelegate = NULL;
 
 PGatewayStartDelegate GatewayStartDelegate = NULL;
@@ -249,6 +254,34 @@ static MODULE_HANDLE DotNetCore_Create(BROKER_HANDLE broker, const void* configu
                                                 /* Codes_SRS_DOTNET_CORE_04_006: [ DotNetCore_Create shall return NULL if an underlying API call fails. ] */
                                                 LogError("Failed to create Destroy Delegate.");
                                             }
+                                            else
+                                            {
+                                                try
+                                                {
+                                                    /* Codes_SRS_DOTNET_CORE_17_001: [ DotNetCore_Create shall call coreclr_create_delegate to be able to call Microsoft.Azure.Devices.Gateway.NetCoreInterop.ReceiveMessageHandle ] */
+                                                    status = m_ptr_coreclr_create_delegate(
+                                                        hostHandle,
+                                                        domainId,
+                                                        "Microsoft.Azure.Devices.Gateway",
+                                                        "Microsoft.Azure.Devices.Gateway.NetCoreInterop",
+                                                        "ReceiveMessageHandle",
+                                                        reinterpret_cast<void**>(&GatewayReceiveMessageHandleDelegate)
+                                                    );
+                                                }
+                                                catch (const std::exception& msgErr)
+                                                {
+                                                    (void)msgErr;
+                                                    status = -1;
+                                                    LogError("Exception Thrown. ReceiveMessageHandle delegate failed.");
+                                                }
+
+                                                if (status < 0)
+                                                {
+                                                    /* Codes_SRS_DOTNET_CORE_17_002: [ If the ReceiveMessageHandle delegate cannot be created, DotNetCore_Create shall not fail and DotNetCore_Receive shall serialize the messages. ] */
+                                                    GatewayReceiveMessageHandleDelegate = NULL;
+                                                    LogInfo("Microsoft.Azure.Devices.Gateway has no ReceiveMessageHandle, messages are serialized.");
+                                                }
+                                            }
                                         }
                                     }
                                 }
@@ -323,36 +356,53 @@ static void DotNetCore_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messag
         {
             DOTNET_CORE_HOST_HANDLE_DATA* result = (DOTNET_CORE_HOST_HANDLE_DATA*)moduleHandle;
 
-            /* Codes_SRS_DOTNET_CORE_04_020: [ DotNetCore_Receive shall call Message_ToByteArray to serialize message. ] */
-            int32_t size = Message_ToByteArray(messageHandle, NULL, 0); 
-
-            if (size > 0)
+            if (GatewayReceiveMessageHandleDelegate != NULL)
             {
-                unsigned char* buffer = (unsigned char*)malloc(size);
-
-                if (buffer != NULL)
+                /* Codes_SRS_DOTNET_CORE_17_003: [ If there is a ReceiveMessageHandle delegate, DotNetCore_Receive shall call Message_Clone and hand the clone to it instead of serializing message. ] */
+                MESSAGE_HANDLE clone = Message_Clone(messageHandle);
+                if (clone == NULL)
                 {
-                    int32_t resultFromConversionToByteArray = Message_ToByteArray(messageHandle, buffer, size);
-
-                    if (resultFromConversionToByteArray > 0)
+                    LogError("Unable to clone the message.");
+                }
+                else
+                {
+                    try
                     {
-                        try
-                        {
-                            /* Codes_SRS_DOTNET_CORE_04_022: [ DotNetCore_Receive shall call Microsoft.Azure.Devices.Gateway.GatewayDelegatesGateway.Delegates_Receive C# method, implemented on Microsoft.Azure.Devices.Gateway.dll. ] */
-                            (*GatewayReceiveDelegate)(buffer, size, result->module_id);
-                        }
-                        catch (const std::exception& msgErr)
-                        {
-                            (void)msgErr;
-                            LogError("Exception Thrown. Error on calling Receive Delegate.");
-                        }
+                        /* Codes_SRS_DOTNET_CORE_17_004: [ DotNetCore_Receive shall leave the release of the clone to the managed side, which calls Module_DotNetCoreHost_Message_Release once it is done with the message. ] */
+                        (*GatewayReceiveMessageHandleDelegate)((intptr_t)clone, result->module_id);
                     }
-                    else
+                    catch (const std::exception& msgErr)
                     {
-                        LogError("Unable to convert message to Byte Array");
+                        (void)msgErr;
+                        LogError("Exception Thrown. Error on calling ReceiveMessageHandle Delegate.");
+                        /* Codes_SRS_DOTNET_CORE_17_015: [ If the ReceiveMessageHandle delegate throws, DotNetCore_Receive shall destroy the clone. ] */
+                        Message_Destroy(clone);
                     }
+                }
+            }
+            else
+            {
+                /* Codes_SRS_DOTNET_CORE_04_020: [ DotNetCore_Receive shall call Message_ToByteArray to serialize message. ] */
+                /* Codes_SRS_DOTNET_CORE_17_014: [ DotNetCore_Receive shall get the serialized message from Message_GetSerialized and hand it to the delegate without copying it, so that a message sent to several modules is serialized once. ] */
+                const CONSTBUFFER* serialized = Message_GetSerialized(messageHandle);
 
-                    delete(buffer);
+                if (serialized == NULL || serialized->size == 0 || serialized->size > INT32_MAX)
+                {
+                    LogError("Unable to convert message to Byte Array");
+                }
+                else
+                {
+                    try
+                    {
+                        /* Codes_SRS_DOTNET_CORE_04_022: [ DotNetCore_Receive shall call Microsoft.Azure.Devices.Gateway.GatewayDelegatesGateway.Delegates_Receive C# method, implemented on Microsoft.Azure.Devices.Gateway.dll. ] */
+                        // the managed side marshals the bytes into its own array, the shared serialization is never written to
+                        (*GatewayReceiveDelegate)(const_cast<unsigned char*>(serialized->buffer), (int32_t)serialized->size, result->module_id);
+                    }
+                    catch (const std::exception& msgErr)
+                    {
+                        (void)msgErr;
+                        LogError("Exception Thrown. Error on calling Receive Delegate.");
+                    }
                 }
             }
         }
@@ -447,6 +497,96 @@ MODULE_EXPORT void Module_DotNetCoreHost_SetBindingDelegates(intptr_t createAddr
     /* Codes_SRS_DOTNET_CORE_04_043: [ Module_DotNetCoreHost_SetBindingDelegates shall just assign startAddress to GatewayStartDelegate ] */
     GatewayStartDelegate = (PGatewayStartDelegate)startAddress;
 }
+
+MODULE_EXPORT void Module_DotNetCoreHost_SetReceiveMessageHandleDelegate(intptr_t receiveMessageHandleAddress)
+{
+    /* Codes_SRS_DOTNET_CORE_17_005: [ Module_DotNetCoreHost_SetReceiveMessageHandleDelegate shall just assign receiveMessageHandleAddress to GatewayReceiveMessageHandleDelegate ] */
+    GatewayReceiveMessageHandleDelegate = (PGatewayReceiveMessageHandleDelegate)receiveMessageHandleAddress;
+}
+
+MODULE_EXPORT bool Module_DotNetCoreHost_Message_GetContent(MESSAGE_HANDLE message, const unsigned char** content, int32_t* size)
+{
+    bool returnValue = false;
+    const CONSTBUFFER* messageContent;
+
+    /* Codes_SRS_DOTNET_CORE_17_006: [ Module_DotNetCoreHost_Message_GetContent shall return false if message, content or size is NULL. ] */
+    if (message == NULL || content == NULL || size == NULL)
+    {
+        LogError("invalid arg message=%p, content=%p, size=%p", message, content, size);
+    }
+    /* Codes_SRS_DOTNET_CORE_17_007: [ Module_DotNetCoreHost_Message_GetContent shall return false if Message_GetContent fails or the content is larger than INT32_MAX bytes. ] */
+    else if ((messageContent = Message_GetContent(message)) == NULL)
+    {
+        LogError("Error trying to get the content of the message.");
+    }
+    else if (messageContent->size > INT32_MAX)
+    {
+        LogError("The content of the message is too large.");
+    }
+    else
+    {
+        /* Codes_SRS_DOTNET_CORE_17_008: [ Module_DotNetCoreHost_Message_GetContent shall point content at the bytes of the message, without copying them, set size and return true. ] */
+        *content = messageContent->buffer;
+        *size = (int32_t)messageContent->size;
+        returnValue = true;
+    }
+
+    return returnValue;
+}
+
+MODULE_EXPORT bool Module_DotNetCoreHost_Message_GetProperties(MESSAGE_HANDLE message, const char* const** keys, const char* const** values, int32_t* count)
+{
+    bool returnValue = false;
+    CONSTMAP_HANDLE properties;
+
+    /* Codes_SRS_DOTNET_CORE_17_009: [ Module_DotNetCoreHost_Message_GetProperties shall return false if message, keys, values or count is NULL. ] */
+    if (message == NULL || keys == NULL || values == NULL || count == NULL)
+    {
+        LogError("invalid arg message=%p, keys=%p, values=%p, count=%p", message, keys, values, count);
+    }
+    /* Codes_SRS_DOTNET_CORE_17_010: [ Module_DotNetCoreHost_Message_GetProperties shall return false if Message_GetProperties or ConstMap_GetInternals fails. ] */
+    else if ((properties = Message_GetProperties(message)) == NULL)
+    {
+        LogError("Error trying to get the properties of the message.");
+    }
+    else
+    {
+        size_t propertyCount;
+        if (ConstMap_GetInternals(properties, keys, values, &propertyCount) != CONSTMAP_OK)
+        {
+            LogError("Error trying to get the keys and values of the properties.");
+        }
+        else if (propertyCount > INT32_MAX)
+        {
+            LogError("The message has too many properties.");
+        }
+        else
+        {
+            /* Codes_SRS_DOTNET_CORE_17_011: [ Module_DotNetCoreHost_Message_GetProperties shall point keys and values at the properties of the message, without copying them, set count and return true. ] */
+            *count = (int32_t)propertyCount;
+            returnValue = true;
+        }
+
+        /*the message holds the properties too, the keys and values live as long as the message does*/
+        ConstMap_Destroy(properties);
+    }
+
+    return returnValue;
+}
+
+MODULE_EXPORT void Module_DotNetCoreHost_Message_Release(MESSAGE_HANDLE message)
+{
+    /* Codes_SRS_DOTNET_CORE_17_012: [ Module_DotNetCoreHost_Message_Release shall do nothing if message is NULL. ] */
+    if (message == NULL)
+    {
+        LogError("invalid arg message=%p", message);
+    }
+    else
+    {
+        /* Codes_SRS_DOTNET_CORE_17_013: [ Module_DotNetCoreHost_Message_Release shall call Message_Destroy on message. ] */
+        Message_Destroy(message);
+    }
+}
 static void DotNetCore_Start(MODULE_HANDLE module)
 {
     /*Codes_SRS_DOTNET_CORE_004_015: [ DotNetCore_Start shall do nothing if module is NULL. ] */
@@ -182,7 +182,7 @@ TEST_FUNCTION_CLEANUP(TestMethodCleanup)
 TEST_FUNCTION(GW_dotnetcore_binding_e2e_Managed2Managed)
 {
     ///arrange
-    GATEWAY_MODULES_ENTRY modulesEntryArray[3];
+    GATEWAY_MODULES_ENTRY modulesEntryArray[3] = {};
 	GATEWAY_MODULE_LOADER_INFO loaders[3];
 
     //Add Managed Module 1
@@ -275,6 +275,7 @@ TEST_FUNCTION(GW_dotnetcore_binding_e2e_Managed2Managed)
     GATEWAY_PROPERTIES properties;
     properties.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
     properties.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+    properties.scheduler_threads = 0;
     ASSERT_IS_NOT_NULL(properties.gateway_modules);
     ASSERT_IS_NOT_NULL(properties.gateway_links);
     VECTOR_push_back(properties.gateway_modules, modulesEntryArray, 3);
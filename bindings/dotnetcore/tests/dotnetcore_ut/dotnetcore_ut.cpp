@@ -33,6 +33,8 @@ typedef unsigned int(DOTNET_CORE_CALLING_CONVENTION *PGatewayCreateDelegate)(int
 
 typedef void(DOTNET_CORE_CALLING_CONVENTION *PGatewayReceiveDelegate)(unsigned char* buffer, int32_t bufferSize, unsigned int moduleIdManaged);
 
+typedef void(DOTNET_CORE_CALLING_CONVENTION *PGatewayReceiveMessageHandleDelegate)(intptr_t message, unsigned int moduleIdManaged);
+
 typedef void(DOTNET_CORE_CALLING_CONVENTION *PGatewayDestroyDelegate)(unsigned int moduleIdManaged);
 
 typedef void(DOTNET_CORE_CALLING_CONVENTION *PGatewayStartDelegate)(unsigned int moduleIdManaged);
@@ -42,6 +44,8 @@ extern PGatewayCreateDelegate GatewayCreateDelegate;
 
 extern PGatewayReceiveDelegate GatewayReceiveDelegate;
 
+extern PGatewayReceiveMessageHandleDelegate GatewayReceiveMessageHandleDelegate;
+
 extern PGatewayDestroyDelegate GatewayDestroyDelegate;
 
 extern PGatewayStartDelegate GatewayStartDelegate;
@@ -66,12 +70,22 @@ extern "C" void  gballoc_free(void* ptr);
 static bool failCreateDelegate = false;
 static bool failReceiveDelegate = false;
 static bool failDestroyDelegate = false;
+static bool failReceiveMessageHandleDelegate = false;
 
 
 static bool calledCreateMethod = false;
 static bool calledReceiveMethod = false;
 static bool calledDestroyMethod = false;
 static bool calledStartMethod = false;
+static bool calledReceiveMessageHandleMethod = false;
+static intptr_t receivedMessageHandle = 0;
+
+static const unsigned char fakeContent[] = { 'a', 'b', 'c' };
+static const CONSTBUFFER fakeMessageContent = { fakeContent, sizeof(fakeContent) };
+static const unsigned char fakeSerializedMessage[11] = { 0xA1, 0x60 };
+static const CONSTBUFFER serializedMessage = { fakeSerializedMessage, sizeof(fakeSerializedMessage) };
+static const char* const fakeKeys[] = { "key1", "key2" };
+static const char* const fakeValues[] = { "value1", "value2" };
 
  int DOTNET_CORE_CALLING_CONVENTION fakeGatewayCreateMethod(intptr_t broker, intptr_t module, const char* assemblyName, const char* entryType, const char* gatewayConfiguration)
 {
@@ -85,6 +99,12 @@ void DOTNET_CORE_CALLING_CONVENTION fakeGatewayReceiveMethod(unsigned char* buff
     calledReceiveMethod = true;
 };
 
+void DOTNET_CORE_CALLING_CONVENTION fakeGatewayReceiveMessageHandleMethod(intptr_t message, unsigned int moduleIdManaged)
+{
+    calledReceiveMessageHandleMethod = true;
+    receivedMessageHandle = message;
+};
+
 void DOTNET_CORE_CALLING_CONVENTION fakeGatewayDestroyMethod(unsigned int moduleIdManaged)
 {
     calledDestroyMethod = true;
@@ -114,6 +134,10 @@ int DOTNET_CORE_CALLING_CONVENTION fake_create_delegate(void* hostHandle,
     {
         *delegate = (void*)fakeGatewayReceiveMethod;
     }
+    else if (strcmp(entryPointMethodName, "ReceiveMessageHandle") == 0)
+    {
+        *delegate = (void*)fakeGatewayReceiveMessageHandleMethod;
+    }
     else if (strcmp(entryPointMethodName, "Destroy") == 0)
     {
         *delegate = (void*)fakeGatewayDestroyMethod;
@@ -137,6 +161,10 @@ int DOTNET_CORE_CALLING_CONVENTION fake_create_delegate(void* hostHandle,
     {
         returnStatus = -1;
     }
+    else if (failReceiveMessageHandleDelegate == true && strcmp(entryPointMethodName, "ReceiveMessageHandle") == 0)
+    {
+        returnStatus = -1;
+    }
     else
     {
         returnStatus = 0;
@@ -240,8 +268,8 @@ public:
     MOCK_VOID_METHOD_END()
 
     //Message Mocks
-    MOCK_STATIC_METHOD_3(, int32_t, Message_ToByteArray, MESSAGE_HANDLE, messageHandle, unsigned char*, buf, int32_t , size)
-    MOCK_METHOD_END( int32_t, (int32_t)11);
+    MOCK_STATIC_METHOD_1(, const CONSTBUFFER*, Message_GetSerialized, MESSAGE_HANDLE, message)
+    MOCK_METHOD_END(const CONSTBUFFER*, &serializedMessage);
 
     
     MOCK_STATIC_METHOD_2(, MESSAGE_HANDLE, Message_CreateFromByteArray, const unsigned char*, source, int32_t, size)
@@ -250,6 +278,25 @@ public:
     MOCK_STATIC_METHOD_1(, void, Message_Destroy, MESSAGE_HANDLE, message)
     MOCK_VOID_METHOD_END()
 
+    MOCK_STATIC_METHOD_1(, MESSAGE_HANDLE, Message_Clone, MESSAGE_HANDLE, message)
+    MOCK_METHOD_END(MESSAGE_HANDLE, (MESSAGE_HANDLE)0x43);
+
+    MOCK_STATIC_METHOD_1(, const CONSTBUFFER*, Message_GetContent, MESSAGE_HANDLE, message)
+    MOCK_METHOD_END(const CONSTBUFFER*, &fakeMessageContent);
+
+    MOCK_STATIC_METHOD_1(, CONSTMAP_HANDLE, Message_GetProperties, MESSAGE_HANDLE, message)
+    MOCK_METHOD_END(CONSTMAP_HANDLE, (CONSTMAP_HANDLE)0x44);
+
+    //ConstMap Mocks
+    MOCK_STATIC_METHOD_4(, CONSTMAP_RESULT, ConstMap_GetInternals, CONSTMAP_HANDLE, handle, const char*const**, keys, const char*const**, values, size_t*, count)
+        *keys = fakeKeys;
+        *values = fakeValues;
+        *count = 2;
+    MOCK_METHOD_END(CONSTMAP_RESULT, CONSTMAP_OK);
+
+    MOCK_STATIC_METHOD_1(, void, ConstMap_Destroy, CONSTMAP_HANDLE, handle)
+    MOCK_VOID_METHOD_END()
+
     // memory
     MOCK_STATIC_METHOD_1(, void*, gballoc_malloc, size_t, size)
         void* result2 = BASEIMPLEMENTATION::gballoc_malloc(size);
@@ -366,12 +413,23 @@ extern "C"
 
         
     //Message Mocks
-    DECLARE_GLOBAL_MOCK_METHOD_3(CDOTNETCOREMocks, , int32_t, Message_ToByteArray, MESSAGE_HANDLE, messageHandle, unsigned char*, buf, int32_t, size);
+    DECLARE_GLOBAL_MOCK_METHOD_1(CDOTNETCOREMocks, , const CONSTBUFFER*, Message_GetSerialized, MESSAGE_HANDLE, message);
 
     DECLARE_GLOBAL_MOCK_METHOD_2(CDOTNETCOREMocks, , MESSAGE_HANDLE, Message_CreateFromByteArray, const unsigned char*, source, int32_t, size);
 
     DECLARE_GLOBAL_MOCK_METHOD_1(CDOTNETCOREMocks, , void, Message_Destroy, MESSAGE_HANDLE, message);
 
+    DECLARE_GLOBAL_MOCK_METHOD_1(CDOTNETCOREMocks, , MESSAGE_HANDLE, Message_Clone, MESSAGE_HANDLE, message);
+
+    DECLARE_GLOBAL_MOCK_METHOD_1(CDOTNETCOREMocks, , const CONSTBUFFER*, Message_GetContent, MESSAGE_HANDLE, message);
+
+    DECLARE_GLOBAL_MOCK_METHOD_1(CDOTNETCOREMocks, , CONSTMAP_HANDLE, Message_GetProperties, MESSAGE_HANDLE, message);
+
+    //ConstMap Mocks
+    DECLARE_GLOBAL_MOCK_METHOD_4(CDOTNETCOREMocks, , CONSTMAP_RESULT, ConstMap_GetInternals, CONSTMAP_HANDLE, handle, const char*const**, keys, const char*const**, values, size_t*, count);
+
+    DECLARE_GLOBAL_MOCK_METHOD_1(CDOTNETCOREMocks, , void, ConstMap_Destroy, CONSTMAP_HANDLE, handle);
+
     DECLARE_GLOBAL_MOCK_METHOD_1(CDOTNETCOREMocks, , JSON_Value*, json_parse_string, const char *, filename);
     DECLARE_GLOBAL_MOCK_METHOD_1(CDOTNETCOREMocks, , JSON_Object*, json_value_get_object, const JSON_Value*, value);
     DECLARE_GLOBAL_MOCK_METHOD_2(CDOTNETCOREMocks, , double, json_object_get_number, const JSON_Object*, value, const char*, name);
@@ -411,14 +469,18 @@ BEGIN_TEST_SUITE(dotnetcore_ut)
         failCreateDelegate = false;
         failReceiveDelegate = false;
         failDestroyDelegate = false;
+        failReceiveMessageHandleDelegate = false;
 
         calledCreateMethod = false;
         calledReceiveMethod = false;
         calledDestroyMethod = false;
         calledStartMethod = false;
+        calledReceiveMessageHandleMethod = false;
+        receivedMessageHandle = 0;
 
         GatewayCreateDelegate = NULL;
         GatewayReceiveDelegate = NULL;
+        GatewayReceiveMessageHandleDelegate = NULL;
         GatewayDestroyDelegate = NULL;
         GatewayStartDelegate = NULL;
 
@@ -1087,12 +1149,15 @@ BEGIN_TEST_SUITE(dotnetcore_ut)
     }
 
     /* Tests_SRS_DOTNET_CORE_04_020: [ DotNetCore_Receive shall call Message_ToByteArray to serialize message. ] */
+    /* Tests_SRS_DOTNET_CORE_17_014: [ DotNetCore_Receive shall get the serialized message from Message_GetSerialized and hand it to the delegate without copying it, so that a message sent to several modules is serialized once. ] */
     /* Tests_SRS_DOTNET_CORE_04_022: [ DotNetCore_Receive shall call Microsoft.Azure.Devices.Gateway.GatewayDelegatesGateway.Delegates_Receive C# method, implemented on Microsoft.Azure.Devices.Gateway.dll. ] */
+    /* Tests_SRS_DOTNET_CORE_17_002: [ If the ReceiveMessageHandle delegate cannot be created, DotNetCore_Create shall not fail and DotNetCore_Receive shall serialize the messages. ] */
     TEST_FUNCTION(DotNetCore_Receive_succeed)
     {
         ///arrange
         CDOTNETCOREMocks mocks;
         const MODULE_API* theAPIS = Module_GetApi(MODULE_API_VERSION_1);
+        failReceiveMessageHandleDelegate = true;
 
 
         DOTNET_CORE_HOST_CONFIG dotNetConfig;
@@ -1107,10 +1172,7 @@ BEGIN_TEST_SUITE(dotnetcore_ut)
         auto result = MODULE_CREATE(theAPIS)((BROKER_HANDLE)0x42, &dotNetConfig);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_ToByteArray((MESSAGE_HANDLE)0x42, NULL, 0));
-
-        STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(mocks, Message_GetSerialized((MESSAGE_HANDLE)0x42));
 
 
         ///act
@@ -1124,6 +1186,76 @@ BEGIN_TEST_SUITE(dotnetcore_ut)
         MODULE_DESTROY(theAPIS)(result);
     }
 
+    /* Tests_SRS_DOTNET_CORE_17_001: [ DotNetCore_Create shall call coreclr_create_delegate to be able to call Microsoft.Azure.Devices.Gateway.NetCoreInterop.ReceiveMessageHandle ] */
+    /* Tests_SRS_DOTNET_CORE_17_003: [ If there is a ReceiveMessageHandle delegate, DotNetCore_Receive shall call Message_Clone and hand the clone to it instead of serializing message. ] */
+    /* Tests_SRS_DOTNET_CORE_17_004: [ DotNetCore_Receive shall leave the release of the clone to the managed side, which calls Module_DotNetCoreHost_Message_Release once it is done with the message. ] */
+    TEST_FUNCTION(DotNetCore_Receive_hands_a_clone_of_the_message_to_ReceiveMessageHandle)
+    {
+        ///arrange
+        CDOTNETCOREMocks mocks;
+        const MODULE_API* theAPIS = Module_GetApi(MODULE_API_VERSION_1);
+
+        DOTNET_CORE_HOST_CONFIG dotNetConfig;
+        dotNetConfig.assemblyName = "/path/to/csharp_module.dll";
+        dotNetConfig.entryType = "mycsharpmodule.classname";
+        dotNetConfig.moduleArgs = "module configuration";
+        DOTNET_CORE_CLR_OPTIONS coreClrOptions;
+        dotNetConfig.clrOptions = &coreClrOptions;
+        dotNetConfig.clrOptions->coreClrPath = "coreCLRPath";
+        dotNetConfig.clrOptions->trustedPlatformAssembliesLocation = "c:\\TrustedPlatformPath";
+
+        auto result = MODULE_CREATE(theAPIS)((BROKER_HANDLE)0x42, &dotNetConfig);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Message_Clone((MESSAGE_HANDLE)0x42));
+
+        ///act
+        MODULE_RECEIVE(theAPIS)(result, (MESSAGE_HANDLE)0x42);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+        ASSERT_IS_TRUE(calledReceiveMessageHandleMethod);
+        ASSERT_IS_FALSE(calledReceiveMethod);
+        ASSERT_ARE_EQUAL(long, (long)receivedMessageHandle, 0x43);
+
+        ///cleanup
+        MODULE_DESTROY(theAPIS)(result);
+    }
+
+    /* Tests_SRS_DOTNET_CORE_17_003: [ If there is a ReceiveMessageHandle delegate, DotNetCore_Receive shall call Message_Clone and hand the clone to it instead of serializing message. ] */
+    TEST_FUNCTION(DotNetCore_Receive_does_nothing_when_Message_Clone_fails)
+    {
+        ///arrange
+        CDOTNETCOREMocks mocks;
+        const MODULE_API* theAPIS = Module_GetApi(MODULE_API_VERSION_1);
+
+        DOTNET_CORE_HOST_CONFIG dotNetConfig;
+        dotNetConfig.assemblyName = "/path/to/csharp_module.dll";
+        dotNetConfig.entryType = "mycsharpmodule.classname";
+        dotNetConfig.moduleArgs = "module configuration";
+        DOTNET_CORE_CLR_OPTIONS coreClrOptions;
+        dotNetConfig.clrOptions = &coreClrOptions;
+        dotNetConfig.clrOptions->coreClrPath = "coreCLRPath";
+        dotNetConfig.clrOptions->trustedPlatformAssembliesLocation = "c:\\TrustedPlatformPath";
+
+        auto result = MODULE_CREATE(theAPIS)((BROKER_HANDLE)0x42, &dotNetConfig);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Message_Clone((MESSAGE_HANDLE)0x42))
+            .SetReturn((MESSAGE_HANDLE)NULL);
+
+        ///act
+        MODULE_RECEIVE(theAPIS)(result, (MESSAGE_HANDLE)0x42);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+        ASSERT_IS_FALSE(calledReceiveMessageHandleMethod);
+        ASSERT_IS_FALSE(calledReceiveMethod);
+
+        ///cleanup
+        MODULE_DESTROY(theAPIS)(result);
+    }
+
     /* Tests_SRS_DOTNET_CORE_04_023: [ DotNetCore_Destroy shall do nothing if module is NULL. ] */
     TEST_FUNCTION(DotNetCore_Destroy_does_nothing_when_modulehandle_is_Null)
     {
@@ -1370,6 +1502,221 @@ BEGIN_TEST_SUITE(dotnetcore_ut)
         ///cleanup
     }
 
+    /* Tests_SRS_DOTNET_CORE_17_005: [ Module_DotNetCoreHost_SetReceiveMessageHandleDelegate shall just assign receiveMessageHandleAddress to GatewayReceiveMessageHandleDelegate ] */
+    TEST_FUNCTION(Module_DotNetCoreHost_SetReceiveMessageHandleDelegate_setting_delegate_succeed)
+    {
+        ///arrange
+        CDOTNETCOREMocks mocks;
+
+        ///act
+        Module_DotNetCoreHost_SetReceiveMessageHandleDelegate((intptr_t)0x46);
+
+        ///assert
+        ASSERT_ARE_EQUAL(long, (long)GatewayReceiveMessageHandleDelegate, 0x46);
+
+        ///cleanup
+    }
+
+    /* Tests_SRS_DOTNET_CORE_17_006: [ Module_DotNetCoreHost_Message_GetContent shall return false if message, content or size is NULL. ] */
+    TEST_FUNCTION(Module_DotNetCoreHost_Message_GetContent_with_NULL_args_returns_false)
+    {
+        ///arrange
+        CDOTNETCOREMocks mocks;
+        const unsigned char* content;
+        int32_t size;
+
+        ///act
+        auto result1 = Module_DotNetCoreHost_Message_GetContent(NULL, &content, &size);
+        auto result2 = Module_DotNetCoreHost_Message_GetContent((MESSAGE_HANDLE)0x42, NULL, &size);
+        auto result3 = Module_DotNetCoreHost_Message_GetContent((MESSAGE_HANDLE)0x42, &content, NULL);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+        ASSERT_IS_FALSE(result1);
+        ASSERT_IS_FALSE(result2);
+        ASSERT_IS_FALSE(result3);
+
+        ///cleanup
+    }
+
+    /* Tests_SRS_DOTNET_CORE_17_007: [ Module_DotNetCoreHost_Message_GetContent shall return false if Message_GetContent fails or the content is larger than INT32_MAX bytes. ] */
+    TEST_FUNCTION(Module_DotNetCoreHost_Message_GetContent_fails_when_Message_GetContent_fails)
+    {
+        ///arrange
+        CDOTNETCOREMocks mocks;
+        const unsigned char* content;
+        int32_t size;
+
+        STRICT_EXPECTED_CALL(mocks, Message_GetContent((MESSAGE_HANDLE)0x42))
+            .SetReturn((const CONSTBUFFER*)NULL);
+
+        ///act
+        auto result = Module_DotNetCoreHost_Message_GetContent((MESSAGE_HANDLE)0x42, &content, &size);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+        ASSERT_IS_FALSE(result);
+
+        ///cleanup
+    }
+
+    /* Tests_SRS_DOTNET_CORE_17_008: [ Module_DotNetCoreHost_Message_GetContent shall point content at the bytes of the message, without copying them, set size and return true. ] */
+    TEST_FUNCTION(Module_DotNetCoreHost_Message_GetContent_succeed)
+    {
+        ///arrange
+        CDOTNETCOREMocks mocks;
+        const unsigned char* content = NULL;
+        int32_t size = 0;
+
+        STRICT_EXPECTED_CALL(mocks, Message_GetContent((MESSAGE_HANDLE)0x42));
+
+        ///act
+        auto result = Module_DotNetCoreHost_Message_GetContent((MESSAGE_HANDLE)0x42, &content, &size);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+        ASSERT_IS_TRUE(result);
+        ASSERT_ARE_EQUAL(void_ptr, (void*)fakeContent, (void*)content);
+        ASSERT_ARE_EQUAL(int, (int)sizeof(fakeContent), (int)size);
+
+        ///cleanup
+    }
+
+    /* Tests_SRS_DOTNET_CORE_17_009: [ Module_DotNetCoreHost_Message_GetProperties shall return false if message, keys, values or count is NULL. ] */
+    TEST_FUNCTION(Module_DotNetCoreHost_Message_GetProperties_with_NULL_args_returns_false)
+    {
+        ///arrange
+        CDOTNETCOREMocks mocks;
+        const char* const* keys;
+        const char* const* values;
+        int32_t count;
+
+        ///act
+        auto result1 = Module_DotNetCoreHost_Message_GetProperties(NULL, &keys, &values, &count);
+        auto result2 = Module_DotNetCoreHost_Message_GetProperties((MESSAGE_HANDLE)0x42, NULL, &values, &count);
+        auto result3 = Module_DotNetCoreHost_Message_GetProperties((MESSAGE_HANDLE)0x42, &keys, NULL, &count);
+        auto result4 = Module_DotNetCoreHost_Message_GetProperties((MESSAGE_HANDLE)0x42, &keys, &values, NULL);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+        ASSERT_IS_FALSE(result1);
+        ASSERT_IS_FALSE(result2);
+        ASSERT_IS_FALSE(result3);
+        ASSERT_IS_FALSE(result4);
+
+        ///cleanup
+    }
+
+    /* Tests_SRS_DOTNET_CORE_17_010: [ Module_DotNetCoreHost_Message_GetProperties shall return false if Message_GetProperties or ConstMap_GetInternals fails. ] */
+    TEST_FUNCTION(Module_DotNetCoreHost_Message_GetProperties_fails_when_Message_GetProperties_fails)
+    {
+        ///arrange
+        CDOTNETCOREMocks mocks;
+        const char* const* keys;
+        const char* const* values;
+        int32_t count;
+
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperties((MESSAGE_HANDLE)0x42))
+            .SetReturn((CONSTMAP_HANDLE)NULL);
+
+        ///act
+        auto result = Module_DotNetCoreHost_Message_GetProperties((MESSAGE_HANDLE)0x42, &keys, &values, &count);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+        ASSERT_IS_FALSE(result);
+
+        ///cleanup
+    }
+
+    /* Tests_SRS_DOTNET_CORE_17_010: [ Module_DotNetCoreHost_Message_GetProperties shall return false if Message_GetProperties or ConstMap_GetInternals fails. ] */
+    TEST_FUNCTION(Module_DotNetCoreHost_Message_GetProperties_fails_when_ConstMap_GetInternals_fails)
+    {
+        ///arrange
+        CDOTNETCOREMocks mocks;
+        const char* const* keys;
+        const char* const* values;
+        int32_t count;
+
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperties((MESSAGE_HANDLE)0x42));
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetInternals((CONSTMAP_HANDLE)0x44, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(2)
+            .IgnoreArgument(3)
+            .IgnoreArgument(4)
+            .SetReturn(CONSTMAP_ERROR);
+        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy((CONSTMAP_HANDLE)0x44));
+
+        ///act
+        auto result = Module_DotNetCoreHost_Message_GetProperties((MESSAGE_HANDLE)0x42, &keys, &values, &count);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+        ASSERT_IS_FALSE(result);
+
+        ///cleanup
+    }
+
+    /* Tests_SRS_DOTNET_CORE_17_011: [ Module_DotNetCoreHost_Message_GetProperties shall point keys and values at the properties of the message, without copying them, set count and return true. ] */
+    TEST_FUNCTION(Module_DotNetCoreHost_Message_GetProperties_succeed)
+    {
+        ///arrange
+        CDOTNETCOREMocks mocks;
+        const char* const* keys = NULL;
+        const char* const* values = NULL;
+        int32_t count = 0;
+
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperties((MESSAGE_HANDLE)0x42));
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetInternals((CONSTMAP_HANDLE)0x44, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(2)
+            .IgnoreArgument(3)
+            .IgnoreArgument(4);
+        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy((CONSTMAP_HANDLE)0x44));
+
+        ///act
+        auto result = Module_DotNetCoreHost_Message_GetProperties((MESSAGE_HANDLE)0x42, &keys, &values, &count);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+        ASSERT_IS_TRUE(result);
+        ASSERT_ARE_EQUAL(void_ptr, (void*)fakeKeys, (void*)keys);
+        ASSERT_ARE_EQUAL(void_ptr, (void*)fakeValues, (void*)values);
+        ASSERT_ARE_EQUAL(int, 2, (int)count);
+
+        ///cleanup
+    }
+
+    /* Tests_SRS_DOTNET_CORE_17_012: [ Module_DotNetCoreHost_Message_Release shall do nothing if message is NULL. ] */
+    TEST_FUNCTION(Module_DotNetCoreHost_Message_Release_with_NULL_does_nothing)
+    {
+        ///arrange
+        CDOTNETCOREMocks mocks;
+
+        ///act
+        Module_DotNetCoreHost_Message_Release(NULL);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+    }
+
+    /* Tests_SRS_DOTNET_CORE_17_013: [ Module_DotNetCoreHost_Message_Release shall call Message_Destroy on message. ] */
+    TEST_FUNCTION(Module_DotNetCoreHost_Message_Release_destroys_the_message)
+    {
+        ///arrange
+        CDOTNETCOREMocks mocks;
+
+        STRICT_EXPECTED_CALL(mocks, Message_Destroy((MESSAGE_HANDLE)0x43));
+
+        ///act
+        Module_DotNetCoreHost_Message_Release((MESSAGE_HANDLE)0x43);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+    }
+
 
     /* Tests_SRS_DOTNET_CORE_04_026:: [ Module_GetApi shall return out the provided MODULES_API structure with required module's APIs functions. ] */
     TEST_FUNCTION(DotNetCore_Module_GetApi_returns_non_NULL)
@@ -7,6 +7,7 @@ package com.microsoft.azure.gateway.core;
 import com.microsoft.azure.gateway.messaging.Message;
 
 import java.io.IOException;
+import java.nio.ByteBuffer;
 
 public class Broker {
 
@@ -41,6 +42,91 @@ public class Broker {
         return this.localBroker.publishMessage(this.brokerAddr, moduleAddr, message.toByteArray());
     }
 
+    /**
+     * Publishes a {@link Message} already serialized in the gateway wire format, as produced by
+     * {@link Message#toByteArray()}. The bytes between the position and the limit of the buffer are published;
+     * a direct buffer is read in place by the native Broker, any other buffer is copied first.
+     *
+     * @param message
+     *            The serialized {@link Message} to be published.
+     * @param moduleAddr
+     *            The address of the pointer to the native module.
+     * @return 0 on success, non-zero otherwise.
+     */
+    public int publishMessage(ByteBuffer message, long moduleAddr) {
+        if (message == null) {
+            /*Codes_SRS_JAVA_BROKER_17_001: [ If message is null, publishMessage shall throw an IllegalArgumentException. ]*/
+            throw new IllegalArgumentException("Message cannot be null.");
+        }
+
+        int result;
+        if (message.isDirect()) {
+            /*Codes_SRS_JAVA_BROKER_17_002: [ If message is a direct buffer, publishMessage shall hand it to the native broker without copying it. ]*/
+            result = this.localBroker.publishMessageBuffer(this.brokerAddr, moduleAddr, wholeBuffer(message));
+        } else {
+            /*Codes_SRS_JAVA_BROKER_17_003: [ Otherwise publishMessage shall copy the message into a byte array and publish that. ]*/
+            result = this.localBroker.publishMessage(this.brokerAddr, moduleAddr, toByteArray(message));
+        }
+        return result;
+    }
+
+    /**
+     * Publishes several serialized {@link Message}s, in order. When every buffer is direct they are all handed to
+     * the native Broker in a single call.
+     *
+     * @param messages
+     *            The serialized {@link Message}s to be published.
+     * @param moduleAddr
+     *            The address of the pointer to the native module.
+     * @return 0 if every message was published, non-zero otherwise.
+     */
+    public int publishMessages(ByteBuffer[] messages, long moduleAddr) {
+        if (messages == null || messages.length == 0) {
+            /*Codes_SRS_JAVA_BROKER_17_004: [ If messages is null, empty or contains null, publishMessages shall throw an IllegalArgumentException. ]*/
+            throw new IllegalArgumentException("Messages cannot be null or empty.");
+        }
+
+        ByteBuffer[] direct = new ByteBuffer[messages.length];
+        for (int i = 0; i < messages.length; i++) {
+            if (messages[i] == null) {
+                /*Codes_SRS_JAVA_BROKER_17_004: [ If messages is null, empty or contains null, publishMessages shall throw an IllegalArgumentException. ]*/
+                throw new IllegalArgumentException("Messages cannot contain null.");
+            }
+            if (direct != null) {
+                if (messages[i].isDirect()) {
+                    direct[i] = wholeBuffer(messages[i]);
+                } else {
+                    direct = null;
+                }
+            }
+        }
+
+        int result = 0;
+        if (direct != null) {
+            /*Codes_SRS_JAVA_BROKER_17_005: [ If every buffer is direct, publishMessages shall publish them all with a single native call. ]*/
+            result = this.localBroker.publishMessageBuffers(this.brokerAddr, moduleAddr, direct);
+        } else {
+            /*Codes_SRS_JAVA_BROKER_17_006: [ Otherwise publishMessages shall publish the messages one by one, in order, and return a non-zero value if any failed. ]*/
+            for (ByteBuffer message : messages) {
+                if (this.publishMessage(message, moduleAddr) != 0) {
+                    result = 1;
+                }
+            }
+        }
+        return result;
+    }
+
+    // The native side reads a direct buffer from its start to its capacity
+    private static ByteBuffer wholeBuffer(ByteBuffer message) {
+        return (message.position() == 0 && message.limit() == message.capacity()) ? message : message.slice();
+    }
+
+    private static byte[] toByteArray(ByteBuffer message) {
+        byte[] bytes = new byte[message.remaining()];
+        message.duplicate().get(bytes);
+        return bytes;
+    }
+
     public long getAddress() {
         return this.brokerAddr;
     }
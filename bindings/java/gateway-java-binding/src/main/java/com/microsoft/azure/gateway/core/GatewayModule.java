@@ -7,6 +7,7 @@ package com.microsoft.azure.gateway.core;
 import com.microsoft.azure.gateway.messaging.Message;
 
 import java.io.IOException;
+import java.nio.ByteBuffer;
 
 /**
  * The Abstract {@link GatewayModule} class to be extended by the module-creator when creating any modules.
@@ -57,6 +58,53 @@ public abstract class GatewayModule implements IGatewayModule{
         this.receive(new Message(serializedMessage));
     }
 
+    /**
+     * Called by the native module host, in place of {@link #receive(byte[])}, with the serialized message in a direct
+     * {@link ByteBuffer} over native memory, from the buffer position to its limit. No byte[] is allocated for it.
+     *
+     * The native memory is reused for the next message as soon as this method returns, so anything kept past the
+     * call has to be copied out of the buffer. By default the message is deserialized and handed to
+     * {@link #receive(Message)}.
+     *
+     * @param serializedMessage The serialized message
+     */
+    public void receive(ByteBuffer serializedMessage){
+        /*Codes_SRS_JAVA_GATEWAY_MODULE_17_001: [ receive(ByteBuffer) shall deserialize the message and call receive(Message). ]*/
+        this.receive(new Message(serializedMessage));
+    }
+
+    /**
+     * Called by the native module host when several messages are waiting for this module, serialized one after the
+     * other in {@code serializedMessages}, from the buffer position on. The same lifetime rules as
+     * {@link #receive(ByteBuffer)} apply.
+     *
+     * By default {@link #receive(ByteBuffer)} is called for each message, in order, with the buffer narrowed down to
+     * that message.
+     *
+     * @param serializedMessages The serialized messages
+     * @param count The number of messages in the buffer
+     */
+    public void receiveBatch(ByteBuffer serializedMessages, int count){
+        int start = serializedMessages.position();
+        int end = serializedMessages.limit();
+
+        for(int index = 0; index < count; index++){
+            // every serialized message starts with a 2 byte header followed by its own size
+            int size = serializedMessages.getInt(start + 2);
+
+            /*Codes_SRS_JAVA_GATEWAY_MODULE_17_002: [ receiveBatch shall call receive(ByteBuffer) for each of the count messages, in order, with the buffer position and limit set to the bounds of that message. ]*/
+            serializedMessages.limit(end);
+            serializedMessages.position(start);
+            serializedMessages.limit(start + size);
+            this.receive(serializedMessages);
+
+            start += size;
+        }
+
+        serializedMessages.limit(end);
+        serializedMessages.position(start);
+    }
+
     /**
      * Publishes the {@link Message} to the {@link Broker}.
      *
@@ -68,6 +116,29 @@ public abstract class GatewayModule implements IGatewayModule{
         return this.broker.publishMessage(message, this._addr);
     }
 
+    /**
+     * Publishes a {@link Message} already serialized in the gateway wire format. Use a direct {@link ByteBuffer}
+     * to have it read in place by the native Broker.
+     *
+     * @param message The serialized {@link Message} to be published
+     * @return 0 on success, non-zero otherwise. See <a href="https://github.com/Azure/azure-iot-gateway-sdk/blob/master/core/devdoc/message_broker_requirements.md" target="_top">Message broker documentation</a>.
+     */
+    public int publish(ByteBuffer message) {
+        /*Codes_SRS_JAVA_GATEWAY_MODULE_17_003: [ publish(ByteBuffer) shall call Broker.publishMessage(ByteBuffer, long) with the module address and return its result. ]*/
+        return this.broker.publishMessage(message, this._addr);
+    }
+
+    /**
+     * Publishes several serialized {@link Message}s, in order, in as few native calls as possible.
+     *
+     * @param messages The serialized {@link Message}s to be published
+     * @return 0 if every message was published, non-zero otherwise.
+     */
+    public int publish(ByteBuffer[] messages) {
+        /*Codes_SRS_JAVA_GATEWAY_MODULE_17_004: [ publish(ByteBuffer[]) shall call Broker.publishMessages with the module address and return its result. ]*/
+        return this.broker.publishMessages(messages, this._addr);
+    }
+
     //Public getter methods
 
     final public Broker getBroker(){
@@ -6,6 +6,8 @@ package com.microsoft.azure.gateway.core;
 
 import com.microsoft.azure.gateway.messaging.Message;
 
+import java.nio.ByteBuffer;
+
 class LocalBroker {
 
     // Loads the native library
@@ -26,4 +28,25 @@ class LocalBroker {
      * @return 0 on success, non-zero otherwise.
      */
     native int publishMessage(long brokerAddr, long moduleAddr, byte[] message);
+
+    /**
+     * Publishes a {@link Message} already serialized in a direct {@link ByteBuffer}. The native side reads the
+     * whole capacity of the buffer in place, without copying it into a byte array first.
+     *
+     * @param brokerAddr The address of the pointer to the native Broker.
+     * @param moduleAddr The address of the pointer to the native module.
+     * @param message The direct buffer holding the serialized {@link Message}.
+     * @return 0 on success, non-zero otherwise.
+     */
+    native int publishMessageBuffer(long brokerAddr, long moduleAddr, ByteBuffer message);
+
+    /**
+     * Publishes several serialized {@link Message}s in one native call, in order.
+     *
+     * @param brokerAddr The address of the pointer to the native Broker.
+     * @param moduleAddr The address of the pointer to the native module.
+     * @param messages The direct buffers holding the serialized {@link Message}s.
+     * @return 0 if every message was published, non-zero otherwise.
+     */
+    native int publishMessageBuffers(long brokerAddr, long moduleAddr, ByteBuffer[] messages);
 }
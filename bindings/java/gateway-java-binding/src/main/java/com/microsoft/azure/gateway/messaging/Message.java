@@ -5,7 +5,7 @@
 package com.microsoft.azure.gateway.messaging;
 
 import java.io.*;
-import java.util.ArrayList;
+import java.nio.ByteBuffer;
 import java.util.HashMap;
 import java.util.Map;
 
@@ -39,10 +39,25 @@ public final class Message {
      * @throws IllegalArgumentException If the {@link byte[]} cannot be de-serialized.
      */
     public Message(byte[] serializedMessage){
+        this(serializedMessage != null ? ByteBuffer.wrap(serializedMessage) : null);
+    }
+
+    /**
+     * Construcor for a {@link Message} created from a fully and properly serialized message held in a {@link ByteBuffer},
+     * from its position to its limit. The position of {@code serializedMessage} is left untouched.
+     *
+     * @see <a href="https://github.com/Azure/azure-iot-gateway-sdk/blob/master/core/devdoc/message_requirements.md" target="_top">Message Documentation</a>
+     *
+     * @param serializedMessage The fully serialized message.
+     *
+     * @throws IllegalArgumentException If the {@link ByteBuffer} cannot be de-serialized.
+     */
+    public Message(ByteBuffer serializedMessage){
         try {
             /*Codes_SRS_JAVA_MESSAGE_14_001: [ The constructor shall create a Message object by deserializing the byte array. ]*/
             /*Codes_SRS_JAVA_MESSAGE_14_002: [ If the byte array is malformed, the function shall throw an IllegalArgumentException. ]*/
-            fromByteArray(serializedMessage);
+            /*Codes_SRS_JAVA_MESSAGE_17_001: [ The constructor shall deserialize the message from the position to the limit of the ByteBuffer without changing its position. ]*/
+            fromByteBuffer(serializedMessage);
         } catch (IOException e) {
             throw new IllegalArgumentException("Invalid byte array input.");
         }
@@ -112,36 +127,36 @@ public final class Message {
     }
 
     /**
-     * Deserializes a byte array and sets the {@link Message#content} and {@link Message#properties}.
+     * Deserializes a {@link ByteBuffer} and sets the {@link Message#content} and {@link Message#properties}.
      *
      * @param serializedMessage The message to be deserialized.
-     * @throws IOException if the byte array in malformed.
+     * @throws IOException if the buffer in malformed.
      */
-    private void fromByteArray(byte[] serializedMessage) throws IOException {
+    private void fromByteBuffer(ByteBuffer serializedMessage) throws IOException {
         try {
-            ByteArrayInputStream bis = new ByteArrayInputStream(serializedMessage);
-            DataInputStream dis = new DataInputStream(bis);
+            // read through a view, the caller's position stays where it is
+            ByteBuffer buffer = serializedMessage.duplicate();
 
             //Get Header
-            byte header1 = dis.readByte();
-            byte header2 = dis.readByte();
+            byte header1 = buffer.get();
+            byte header2 = buffer.get();
             if (header1 == (byte) 0xA1 && header2 == (byte) 0x60) {
-                int arraySize = dis.readInt();
+                int arraySize = buffer.getInt();
                 if (arraySize >= 14) {
                     Map<String, String> _properties = new HashMap<String, String>();
-                    int propCount = dis.readInt();
+                    int propCount = buffer.getInt();
 
                     if (propCount > 0) {
                         for (int count = 0; count < propCount; count++) {
-                            byte[] key = readNullTerminatedString(bis);
-                            byte[] value = readNullTerminatedString(bis);
+                            byte[] key = readNullTerminatedString(buffer);
+                            byte[] value = readNullTerminatedString(buffer);
                             _properties.put(new String(key), new String(value));
                         }
                     }
 
-                    int contentLength = dis.readInt();
+                    int contentLength = buffer.getInt();
                     byte[] content = new byte[contentLength];
-                    dis.readFully(content);
+                    buffer.get(content);
 
                     //At this point it should be safe to set both properties and content
                     this.properties = _properties;
@@ -158,29 +173,27 @@ public final class Message {
     }
 
     /**
-     * Returns the first null-terminated ('\0') sub-array.
+     * Returns the first null-terminated ('\0') sub-array and moves past its terminator.
      *
-     * @param bis The {@link ByteArrayInputStream} object from which to read the string.
+     * @param buffer The {@link ByteBuffer} from which to read the string.
      * @return The null-terminated string in a byte array.
      * @throws IOException if the null-terminated string could not be read.
      */
-    private byte[] readNullTerminatedString(ByteArrayInputStream bis) throws IOException {
-        ArrayList<Byte> byteArray = new ArrayList<Byte>();
-        byte b = (byte) bis.read();
+    private byte[] readNullTerminatedString(ByteBuffer buffer) throws IOException {
+        int start = buffer.position();
+        int end = start;
 
-        while(b != '\0' && b != -1){
-            byteArray.add(b);
-            b = (byte)bis.read();
+        while(end < buffer.limit() && buffer.get(end) != '\0'){
+            end++;
         }
 
         byte[] result;
 
-        if(b != -1) {
-
-            result = new byte[byteArray.size()];
-            for (int index = 0; index < result.length; index++) {
-                result[index] = byteArray.get(index);
-            }
+        if(end < buffer.limit()) {
+            result = new byte[end - start];
+            buffer.get(result);
+            // skip the terminator
+            buffer.get();
         } else {
             throw new IOException("Could not read null-terminated string.");
         }
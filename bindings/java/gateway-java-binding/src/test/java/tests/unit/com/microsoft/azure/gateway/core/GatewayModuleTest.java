@@ -9,8 +9,14 @@ import com.microsoft.azure.gateway.core.Broker;
 import com.microsoft.azure.gateway.messaging.Message;
 import mockit.Deencapsulation;
 import mockit.Mocked;
+import mockit.NonStrictExpectations;
+import mockit.Verifications;
 import org.junit.Test;
 
+import java.nio.ByteBuffer;
+import java.util.ArrayList;
+import java.util.List;
+
 import static org.junit.Assert.assertEquals;
 
 public class GatewayModuleTest {
@@ -43,8 +49,102 @@ public class GatewayModuleTest {
         GatewayModule module = new TestModule(address, null, null);
     }
 
+    /*Tests_SRS_JAVA_GATEWAY_MODULE_17_001: [ receive(ByteBuffer) shall deserialize the message and call receive(Message). ]*/
+    @Test
+    public void receiveByteBufferCallsReceiveMessage(){
+        TestModule module = new TestModule(0x12345678, mockBroker, null);
+        byte[] serialized = {
+                (byte) 0xA1, 0x60,      /*header*/
+                0x00, 0x00, 0x00, 16,   /*size of this array*/
+                0x00, 0x00, 0x00, 0x00, /*zero properties*/
+                0x00, 0x00, 0x00, 0x02, /*2 message content size*/
+                '3', '4'
+        };
+
+        module.receive(ByteBuffer.wrap(serialized));
+
+        assertEquals(1, module.received.size());
+        assertEquals("34", new String(module.received.get(0).getContent()));
+    }
+
+    /*Tests_SRS_JAVA_GATEWAY_MODULE_17_002: [ receiveBatch shall call receive(ByteBuffer) for each of the count messages, in order, with the buffer position and limit set to the bounds of that message. ]*/
+    @Test
+    public void receiveBatchCallsReceiveForEachMessage(){
+        TestModule module = new TestModule(0x12345678, mockBroker, null);
+        byte[] serialized = {
+                (byte) 0xA1, 0x60,      /*header*/
+                0x00, 0x00, 0x00, 15,   /*size of this message*/
+                0x00, 0x00, 0x00, 0x00, /*zero properties*/
+                0x00, 0x00, 0x00, 0x01, /*1 message content size*/
+                '1',
+                (byte) 0xA1, 0x60,      /*header*/
+                0x00, 0x00, 0x00, 16,   /*size of this message*/
+                0x00, 0x00, 0x00, 0x00, /*zero properties*/
+                0x00, 0x00, 0x00, 0x02, /*2 message content size*/
+                '2', '3'
+        };
+        ByteBuffer buffer = ByteBuffer.wrap(serialized);
+
+        module.receiveBatch(buffer, 2);
+
+        assertEquals(2, module.received.size());
+        assertEquals("1", new String(module.received.get(0).getContent()));
+        assertEquals("23", new String(module.received.get(1).getContent()));
+        assertEquals(serialized.length, buffer.limit());
+    }
+
+    /*Tests_SRS_JAVA_GATEWAY_MODULE_17_003: [ publish(ByteBuffer) shall call Broker.publishMessage(ByteBuffer, long) with the module address and return its result. ]*/
+    @Test
+    public void publishByteBufferCallsBrokerPublishMessage(){
+        final long address = 0x12345678;
+        final ByteBuffer buffer = ByteBuffer.allocateDirect(16);
+        GatewayModule module = new TestModule(address, mockBroker, null);
+        new NonStrictExpectations() {
+            {
+                mockBroker.publishMessage(buffer, address);
+                result = 0;
+            }
+        };
+
+        int result = module.publish(buffer);
+
+        assertEquals(0, result);
+        new Verifications() {
+            {
+                mockBroker.publishMessage(buffer, address);
+                times = 1;
+            }
+        };
+    }
+
+    /*Tests_SRS_JAVA_GATEWAY_MODULE_17_004: [ publish(ByteBuffer[]) shall call Broker.publishMessages with the module address and return its result. ]*/
+    @Test
+    public void publishByteBufferArrayCallsBrokerPublishMessages(){
+        final long address = 0x12345678;
+        final ByteBuffer[] buffers = { ByteBuffer.allocateDirect(16), ByteBuffer.allocateDirect(16) };
+        GatewayModule module = new TestModule(address, mockBroker, null);
+        new NonStrictExpectations() {
+            {
+                mockBroker.publishMessages(buffers, address);
+                result = 1;
+            }
+        };
+
+        int result = module.publish(buffers);
+
+        assertEquals(1, result);
+        new Verifications() {
+            {
+                mockBroker.publishMessages(buffers, address);
+                times = 1;
+            }
+        };
+    }
+
     public class TestModule extends GatewayModule{
 
+        public final List<Message> received = new ArrayList<Message>();
+
         /**
          * Constructs a {@link GatewayModule} from the provided address and {@link Broker}. A {@link GatewayModule} should always call this super
          * constructor before any module-specific constructor code.
@@ -59,7 +159,7 @@ public class GatewayModuleTest {
 
         @Override
         public void receive(Message message) {
-
+            received.add(message);
         }
 
         @Override
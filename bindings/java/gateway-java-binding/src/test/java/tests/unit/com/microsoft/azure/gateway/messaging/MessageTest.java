@@ -11,6 +11,7 @@ import org.junit.Test;
 
 import java.io.DataOutputStream;
 import java.io.IOException;
+import java.nio.ByteBuffer;
 import java.util.Arrays;
 import java.util.HashMap;
 import java.util.Map;
@@ -135,6 +136,36 @@ public class MessageTest {
         assertTrue(Arrays.equals(expectedContent, actualContent));
     }
 
+    /*Tests_SRS_JAVA_MESSAGE_17_001: [ The constructor shall deserialize the message from the position to the limit of the ByteBuffer without changing its position. ]*/
+    @Test
+    public void constructorSetsDataFromByteBuffer_Valid() throws IOException {
+
+        Map<String, String> expected = new HashMap<String, String>();
+        expected.put("BleedingEdge", "rocks");
+        expected.put("Azure IoT Gateway is", "awesome");
+        byte[] expectedContent = "34".getBytes();
+
+        ByteBuffer buffer = ByteBuffer.allocateDirect(validMessage.length + 3);
+        buffer.position(3);
+        buffer.put(validMessage);
+        buffer.position(3);
+
+        Message message = new Message(buffer);
+
+        assertEquals(expected, message.getProperties());
+        assertTrue(Arrays.equals(expectedContent, message.getContent()));
+        assertEquals(3, buffer.position());
+    }
+
+    /*Tests_SRS_JAVA_MESSAGE_14_002: [ If the byte array is malformed, the function shall throw an IllegalArgumentException. ]*/
+    @Test(expected = IllegalArgumentException.class)
+    public void constructorThrowsExceptionForTruncatedByteBuffer(){
+        ByteBuffer buffer = ByteBuffer.wrap(validMessage);
+        buffer.limit(validMessage.length - 1);
+
+        Message message = new Message(buffer);
+    }
+
     /*Tests_SRS_JAVA_MESSAGE_14_001: [ The constructor shall create a Message object by deserializing the byte array. ]*/
     @Test
     public void constructorSetsDataFromInputArray_NoProperties2Bytes() throws IOException {
@@ -5,12 +5,16 @@
 #define JAVA_MODULE_HOST_COMMON_H
 
 #define BROKER_CLASS_NAME "com/microsoft/azure/gateway/core/Broker"
+#define GATEWAY_MODULE_CLASS_NAME "com/microsoft/azure/gateway/core/GatewayModule"
 #define CONSTRUCTOR_METHOD_NAME "<init>"
 #define MODULE_DESTROY_METHOD_NAME "destroy"
 #define MODULE_RECEIVE_METHOD_NAME "receive"
+#define MODULE_RECEIVE_BATCH_METHOD_NAME "receiveBatch"
 #define MODULE_START_METHOD_NAME "start"
 #define MODULE_DESTROY_DESCRIPTOR "()V"
 #define MODULE_RECEIVE_DESCRIPTOR "([B)V"
+#define MODULE_RECEIVE_BUFFER_DESCRIPTOR "(Ljava/nio/ByteBuffer;)V"
+#define MODULE_RECEIVE_BATCH_DESCRIPTOR "(Ljava/nio/ByteBuffer;I)V"
 #define MODULE_START_DESCRIPTOR "()V"
 #define BROKER_CONSTRUCTOR_DESCRIPTOR "(J)V"
 #define MODULE_CONSTRUCTOR_DESCRIPTOR "(JLcom/microsoft/azure/gateway/core/Broker;Ljava/lang/String;)V"
@@ -20,5 +24,6 @@
 #define DEBUG_PORT_DEFAULT 9876
 #define DEBUG_PORT_MAX_VALUE 65535
 #define DEBUG_OPTIONS_STR_SIZE 64
+#define RECEIVE_LOCAL_FRAME_CAPACITY 8
 
 #endif /*JAVA_MODULE_HOST_COMMON_H*/
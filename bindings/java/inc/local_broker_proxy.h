@@ -15,6 +15,22 @@ extern "C" {
 JNIEXPORT jint JNICALL Java_com_microsoft_azure_gateway_core_LocalBroker_publishMessage
   (JNIEnv *, jobject, jlong, jlong, jbyteArray);
 
+/*
+ * Class:     com_microsoft_azure_gateway_core_LocalBroker
+ * Method:    publishMessageBuffer
+ * Signature: (JJLjava/nio/ByteBuffer;)I
+ */
+JNIEXPORT jint JNICALL Java_com_microsoft_azure_gateway_core_LocalBroker_publishMessageBuffer
+  (JNIEnv *, jobject, jlong, jlong, jobject);
+
+/*
+ * Class:     com_microsoft_azure_gateway_core_LocalBroker
+ * Method:    publishMessageBuffers
+ * Signature: (JJ[Ljava/nio/ByteBuffer;)I
+ */
+JNIEXPORT jint JNICALL Java_com_microsoft_azure_gateway_core_LocalBroker_publishMessageBuffers
+  (JNIEnv *, jobject, jlong, jlong, jobjectArray);
+
 #ifdef __cplusplus
 }
 #endif
@@ -2,6 +2,8 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 
 #ifdef UNDER_TEST /*This flag tells the compiler to redefine JNIEXPORT, JNIIMPORT, and JNICALL so this module can be unit tested using umock_c*/
 
@@ -79,6 +81,12 @@ typedef struct JAVA_MODULE_HANDLE_DATA_TAG
     jobject module;
     char* moduleName;
     JAVA_MODULE_HOST_MANAGER_HANDLE manager;
+    bool receive_methods_resolved;
+    jmethodID jModule_receive;
+    jmethodID jModule_receive_buffer;
+    jmethodID jModule_receive_batch;
+    unsigned char* arena;
+    size_t arena_size;
 }JAVA_MODULE_HANDLE_DATA;
 
 static int JVM_Create(JavaVM** jvm, JNIEnv** env, JVM_OPTIONS* options);
@@ -89,6 +97,8 @@ static void deinit_vm_options(JavaVMInitArgs* jvm_args, VECTOR_HANDLE options_st
 static jobject NewObjectInternal(JNIEnv* env, jclass clazz, jmethodID methodID, int args_count, ...);
 static void CallVoidMethodInternal(JNIEnv* env, jobject obj, jmethodID methodID, int args_count, ...);
 static jmethodID get_module_method(JAVA_MODULE_HANDLE_DATA* module, const char* method_name, const char* method_descriptor);
+static void deliver_messages(JAVA_MODULE_HANDLE_DATA* module, MESSAGE_HANDLE* messages, size_t count);
+static BROKER_RESULT publish_direct_buffer(JNIEnv* env, BROKER_HANDLE broker, MODULE_HANDLE module, jobject serialized_message);
 
 static MODULE_HANDLE JavaModuleHost_Create(BROKER_HANDLE broker, const void* configuration)
 {
@@ -125,6 +135,12 @@ static MODULE_HANDLE JavaModuleHost_Create(BROKER_HANDLE broker, const void* con
                 result->env = NULL;
                 result->jvm = NULL;
                 result->moduleName = (char*)config->class_name;
+                result->receive_methods_resolved = false;
+                result->jModule_receive = NULL;
+                result->jModule_receive_buffer = NULL;
+                result->jModule_receive_batch = NULL;
+                result->arena = NULL;
+                result->arena_size = 0;
 
                 /*Codes_SRS_JAVA_MODULE_HOST_14_037: [This function shall get a singleton instance of a JavaModuleHostManager. ]*/
                 result->manager = JavaModuleHostManager_Create(config);
@@ -382,84 +398,18 @@ static void JavaModuleHost_Receive(MODULE_HANDLE module, MESSAGE_HANDLE message)
     /*Codes_SRS_JAVA_MODULE_HOST_14_022: [This function shall do nothing if module or message is NULL.]*/
     if (module != NULL && message != NULL)
     {
-        JAVA_MODULE_HANDLE_DATA* moduleHandle = (JAVA_MODULE_HANDLE_DATA*)module;
-
-        /*Codes_SRS_JAVA_MODULE_HOST_14_023: [This function shall serialize message.]*/
-        int32_t size = Message_ToByteArray(message, NULL, 0);
-
-        if (size < 0)
-        {
-            /*Codes_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
-            LogError("Could not serialize the message to a byte array.");
-        }
-        else
-        {
-            unsigned char* serialized_message = (unsigned char*)malloc(size);
-            if (serialized_message == NULL)
-            {
-                LogError("Could not allocate byte array for message.");
-            }
-            else
-            {
-                Message_ToByteArray(message, serialized_message, size);
-
-                /*Codes_SRS_JAVA_MODULE_HOST_14_042: [This function shall attach the JVM to the current thread.]*/
-                jint jni_result = JNIFunc(moduleHandle->jvm, AttachCurrentThread, (void**)(&(moduleHandle->env)), NULL);
-
-                if (jni_result == JNI_OK)
-                {
-                    /*Codes_SRS_JAVA_MODULE_HOST_14_043: [This function shall create a new jbyteArray for the serialized message.]*/
-                    jbyteArray arr = JNIFunc(moduleHandle->env, NewByteArray, size);
-                    if (arr == NULL)
-                    {
-                        /*Codes_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
-                        LogError("New jbyteArray could not be constructed.");
-                    }
-                    else
-                    {
-                        /*Codes_SRS_JAVA_MODULE_HOST_14_044: [This function shall set the contents of the jbyteArray to the serialized_message.]*/
-                        JNIFunc(moduleHandle->env, SetByteArrayRegion, arr, 0, size, (jbyte*)serialized_message);
-                        jthrowable exception = JNIFunc(moduleHandle->env, ExceptionOccurred);
-                        if (exception)
-                        {
-                            /*Codes_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
-                            LogError("Exception occurred in SetByteArrayRegion.");
-                            JNIFunc(moduleHandle->env, ExceptionDescribe);
-                            JNIFunc(moduleHandle->env, ExceptionClear);
-                        }
-                        else
-                        {
-                            /*Codes_SRS_JAVA_MODULE_HOST_14_045: [This function shall get the user - defined Java module class using the module parameter and get the receive() method.]*/
-                            jmethodID jModule_receive = get_module_method(moduleHandle, MODULE_RECEIVE_METHOD_NAME, MODULE_RECEIVE_DESCRIPTOR);
-                            if (jModule_receive == NULL)
-                            {
-                                /*Codes_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
-                                LogError("Failed to get the %s receive() method.", moduleHandle->moduleName);
-                            }
-                            else
-                            {
-                                /*Codes_SRS_JAVA_MODULE_HOST_14_024: [This function shall call the void receive(byte[] source) method of the Java module object passing the serialized message.]*/
-                                CallVoidMethodInternal(moduleHandle->env, moduleHandle->module, jModule_receive, 1, arr);
-                                exception = JNIFunc(moduleHandle->env, ExceptionOccurred);
-                                if (exception)
-                                {
-                                    /*Codes_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
-                                    LogError("Exception occurred in receive() of %s.", moduleHandle->moduleName);
-                                    JNIFunc(moduleHandle->env, ExceptionDescribe);
-                                    JNIFunc(moduleHandle->env, ExceptionClear);
-                                }
-                            }
-                        }
-                        JNIFunc(moduleHandle->env, DeleteLocalRef, arr);
-                    }
-                    /*Codes_SRS_JAVA_MODULE_HOST_14_046: [This function shall detach the JVM from the current thread.]*/
-                    JNIFunc(moduleHandle->jvm, DetachCurrentThread);
-                }
-                free(serialized_message);
-            }
-        }
+        deliver_messages((JAVA_MODULE_HANDLE_DATA*)module, &message, 1);
     }
+}
 
+static void JavaModuleHost_ReceiveBatch(MODULE_HANDLE module, MESSAGE_HANDLE* messages, size_t count)
+{
+    /*Codes_SRS_JAVA_MODULE_HOST_17_009: [ JavaModuleHost_ReceiveBatch shall do nothing if module or messages is NULL, or if count is 0. ]*/
+    if (module != NULL && messages != NULL && count != 0)
+    {
+        /*Codes_SRS_JAVA_MODULE_HOST_17_010: [ JavaModuleHost_ReceiveBatch shall deliver the count messages to the Java module the way JavaModuleHost_Receive does, in one receiveBatch(ByteBuffer, int) call when the direct buffer methods are used. ]*/
+        deliver_messages((JAVA_MODULE_HANDLE_DATA*)module, messages, count);
+    }
 }
 
 static void JavaModuleHost_Start(MODULE_HANDLE module)
@@ -599,6 +549,56 @@ JNIEXPORT jint JNICALL Java_com_microsoft_azure_gateway_core_Broker_publishMessa
     return result;
 }
 
+JNIEXPORT jint JNICALL Java_com_microsoft_azure_gateway_core_LocalBroker_publishMessageBuffer(JNIEnv* env, jobject jBroker, jlong broker_address, jlong module_address, jobject serialized_message)
+{
+    (void)jBroker;
+
+    /*Codes_SRS_JAVA_MODULE_HOST_17_012: [ This function shall create the message straight from the memory of the direct ByteBuffer serialized_message, without copying it to an intermediate buffer, publish it and return the result of Broker_Publish. ]*/
+    return publish_direct_buffer(env, (BROKER_HANDLE)broker_address, (MODULE_HANDLE)module_address, serialized_message);
+}
+
+JNIEXPORT jint JNICALL Java_com_microsoft_azure_gateway_core_LocalBroker_publishMessageBuffers(JNIEnv* env, jobject jBroker, jlong broker_address, jlong module_address, jobjectArray serialized_messages)
+{
+    (void)jBroker;
+    BROKER_RESULT result;
+
+    jsize count = (serialized_messages == NULL) ? 0 : JNIFunc(env, GetArrayLength, serialized_messages);
+    if (count == 0)
+    {
+        /*Codes_SRS_JAVA_MODULE_HOST_17_016: [ This function shall return a non-zero value if serialized_messages is NULL or empty. ]*/
+        LogError("No serialized messages to publish.");
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        result = BROKER_OK;
+
+        /*Codes_SRS_JAVA_MODULE_HOST_17_014: [ This function shall publish every direct ByteBuffer of serialized_messages, in order, the way publishMessageBuffer does. ]*/
+        for (jsize index = 0; index < count; index++)
+        {
+            jobject serialized_message = JNIFunc(env, GetObjectArrayElement, serialized_messages, index);
+            if (serialized_message == NULL)
+            {
+                /*Codes_SRS_JAVA_MODULE_HOST_17_015: [ This function shall keep publishing the other messages if one of them fails, and return a non-zero value if any did. ]*/
+                LogError("Serialized message %i is null.", (int)index);
+                JNIFunc(env, ExceptionClear);
+                result = BROKER_ERROR;
+            }
+            else
+            {
+                if (publish_direct_buffer(env, (BROKER_HANDLE)broker_address, (MODULE_HANDLE)module_address, serialized_message) != BROKER_OK)
+                {
+                    /*Codes_SRS_JAVA_MODULE_HOST_17_015: [ This function shall keep publishing the other messages if one of them fails, and return a non-zero value if any did. ]*/
+                    result = BROKER_ERROR;
+                }
+                JNIFunc(env, DeleteLocalRef, serialized_message);
+            }
+        }
+    }
+
+    return result;
+}
+
 //Internal functions
 static jmethodID get_module_method(JAVA_MODULE_HANDLE_DATA* module, const char* method_name, const char* method_descriptor)
 {
@@ -624,6 +624,337 @@ static jmethodID get_module_method(JAVA_MODULE_HANDLE_DATA* module, const char*
     return jModule_method;
 }
 
+static BROKER_RESULT publish_direct_buffer(JNIEnv* env, BROKER_HANDLE broker, MODULE_HANDLE module, jobject serialized_message)
+{
+    BROKER_RESULT result = BROKER_ERROR;
+
+    const unsigned char* address = (serialized_message == NULL) ? NULL : (const unsigned char*)JNIFunc(env, GetDirectBufferAddress, serialized_message);
+    if (address == NULL)
+    {
+        /*Codes_SRS_JAVA_MODULE_HOST_17_013: [ This function shall return a non-zero value if serialized_message is not a direct ByteBuffer or holds more than INT32_MAX bytes, or if any underlying function call fails. ]*/
+        LogError("Serialized message is not a direct ByteBuffer.");
+    }
+    else
+    {
+        jlong capacity = JNIFunc(env, GetDirectBufferCapacity, serialized_message);
+        if (capacity <= 0 || capacity > INT32_MAX)
+        {
+            /*Codes_SRS_JAVA_MODULE_HOST_17_013: [ This function shall return a non-zero value if serialized_message is not a direct ByteBuffer or holds more than INT32_MAX bytes, or if any underlying function call fails. ]*/
+            LogError("Serialized message length (%ld) is out of range.", (long)capacity);
+        }
+        else
+        {
+            // the message copies what it needs, Java may reuse the buffer as soon as this returns
+            MESSAGE_HANDLE message = Message_CreateFromByteArray(address, (int32_t)capacity);
+            if (message == NULL)
+            {
+                LogError("Message could not be created from the direct buffer.");
+            }
+            else
+            {
+                result = Broker_Publish(broker, module, message);
+                Message_Destroy(message);
+            }
+        }
+    }
+
+    return result;
+}
+
+static JNIEnv* get_receive_env(JAVA_MODULE_HANDLE_DATA* module)
+{
+    JNIEnv* env;
+    jint jni_result = JNIFunc(module->jvm, GetEnv, (void**)(&env), JNI_VERSION_1_6);
+    if (jni_result == JNI_EDETACHED)
+    {
+        /*Codes_SRS_JAVA_MODULE_HOST_17_001: [ If the current thread is not attached to the JVM, this function shall attach it as a daemon thread and leave it attached, so that later deliveries on the same thread do not attach again. ]*/
+        jni_result = JNIFunc(module->jvm, AttachCurrentThreadAsDaemon, (void**)(&env), NULL);
+    }
+
+    if (jni_result != JNI_OK)
+    {
+        LogError("Could not attach the current thread to the JVM. (Result: %i)", jni_result);
+        env = NULL;
+    }
+    return env;
+}
+
+static jmethodID get_optional_method(JNIEnv* env, jclass clazz, const char* method_name, const char* method_descriptor)
+{
+    jmethodID method = JNIFunc(env, GetMethodID, clazz, method_name, method_descriptor);
+    jthrowable exception = JNIFunc(env, ExceptionOccurred);
+    if (method == NULL || exception)
+    {
+        // not finding the method is fine, so the NoSuchMethodError is not described
+        JNIFunc(env, ExceptionClear);
+        method = NULL;
+    }
+    return method;
+}
+
+static void resolve_receive_methods(JAVA_MODULE_HANDLE_DATA* module, JNIEnv* env)
+{
+    jclass jModule_class = JNIFunc(env, GetObjectClass, module->module);
+    if (jModule_class == NULL)
+    {
+        LogError("Could not find class (%s) for the module Java object. receive() will not be called on this object.", module->moduleName);
+    }
+    else
+    {
+        /*Codes_SRS_JAVA_MODULE_HOST_14_045: [This function shall get the user - defined Java module class using the module parameter and get the receive() method.]*/
+        /*Codes_SRS_JAVA_MODULE_HOST_17_003: [ This function shall look up the receive methods of the Java module only once, on the first delivery, and keep them for the lifetime of the module. ]*/
+        jmethodID jModule_receive = JNIFunc(env, GetMethodID, jModule_class, MODULE_RECEIVE_METHOD_NAME, MODULE_RECEIVE_DESCRIPTOR);
+        jthrowable exception = JNIFunc(env, ExceptionOccurred);
+        if (jModule_receive == NULL || exception)
+        {
+            LogError("Failed to find the %s receive() method. receive() will not be called on this object.", module->moduleName);
+            JNIFunc(env, ExceptionDescribe);
+            JNIFunc(env, ExceptionClear);
+        }
+        else
+        {
+            jmethodID jModule_receive_buffer = get_optional_method(env, jModule_class, MODULE_RECEIVE_METHOD_NAME, MODULE_RECEIVE_BUFFER_DESCRIPTOR);
+            jmethodID jModule_receive_batch = get_optional_method(env, jModule_class, MODULE_RECEIVE_BATCH_METHOD_NAME, MODULE_RECEIVE_BATCH_DESCRIPTOR);
+
+            if (jModule_receive_buffer != NULL && jModule_receive_batch != NULL)
+            {
+                /*Codes_SRS_JAVA_MODULE_HOST_17_004: [ This function shall deliver messages in direct ByteBuffers only if the module has receive(ByteBuffer) and receiveBatch(ByteBuffer, int) and does not override the receive(byte[]) method of GatewayModule. ]*/
+                // a module overriding receive(byte[]) expects its own code to run, so it keeps getting byte arrays.
+                // An inherited method has the same jmethodID as in the class declaring it.
+                jclass jGatewayModule_class = JNIFunc(env, FindClass, GATEWAY_MODULE_CLASS_NAME);
+                exception = JNIFunc(env, ExceptionOccurred);
+                if (jGatewayModule_class == NULL || exception)
+                {
+                    JNIFunc(env, ExceptionClear);
+                    jModule_receive_buffer = NULL;
+                }
+                else if (get_optional_method(env, jGatewayModule_class, MODULE_RECEIVE_METHOD_NAME, MODULE_RECEIVE_DESCRIPTOR) != jModule_receive)
+                {
+                    jModule_receive_buffer = NULL;
+                }
+            }
+            else
+            {
+                jModule_receive_buffer = NULL;
+            }
+
+            module->jModule_receive = jModule_receive;
+            module->jModule_receive_buffer = jModule_receive_buffer;
+            module->jModule_receive_batch = jModule_receive_batch;
+            module->receive_methods_resolved = true;
+        }
+    }
+}
+
+static int reserve_arena(JAVA_MODULE_HANDLE_DATA* module, size_t size)
+{
+    int result;
+    if (size <= module->arena_size)
+    {
+        result = 0;
+    }
+    else
+    {
+        size_t new_size = module->arena_size * 2;
+        if (new_size < size)
+        {
+            new_size = size;
+        }
+
+        unsigned char* new_arena = (unsigned char*)realloc(module->arena, new_size);
+        if (new_arena == NULL)
+        {
+            LogError("Could not grow the receive buffer to %zu bytes.", new_size);
+            result = __LINE__;
+        }
+        else
+        {
+            module->arena = new_arena;
+            module->arena_size = new_size;
+            result = 0;
+        }
+    }
+    return result;
+}
+
+static int serialize_message(JAVA_MODULE_HANDLE_DATA* module, MESSAGE_HANDLE message, size_t offset, int32_t* size)
+{
+    int result;
+
+    /*Codes_SRS_JAVA_MODULE_HOST_14_023: [This function shall serialize message.]*/
+    /*Codes_SRS_JAVA_MODULE_HOST_17_017: [ This function shall get the serialized message from Message_GetSerialized, so that a message sent to several modules is serialized once. ]*/
+    const CONSTBUFFER* serialized = Message_GetSerialized(message);
+    if (serialized == NULL)
+    {
+        LogError("Could not serialize the message to a byte array.");
+        result = __LINE__;
+    }
+    else if ((*size = (int32_t)serialized->size) < 0)
+    {
+        LogError("Serialized message is too large.");
+        result = __LINE__;
+    }
+    else if ((size_t)*size > INT32_MAX - offset)
+    {
+        LogError("Serialized messages do not fit in a Java buffer.");
+        result = __LINE__;
+    }
+    /*Codes_SRS_JAVA_MODULE_HOST_17_005: [ This function shall serialize the messages into a native buffer owned by the module, grown as needed and reused for every delivery. ]*/
+    else if (reserve_arena(module, offset + *size) != 0)
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        // the serialized message is shared with the other sinks, Java only ever sees a copy of it
+        (void)memcpy(module->arena + offset, serialized->buffer, *size);
+        result = 0;
+    }
+    return result;
+}
+
+static void check_receive_exception(JAVA_MODULE_HANDLE_DATA* module, JNIEnv* env)
+{
+    jthrowable exception = JNIFunc(env, ExceptionOccurred);
+    if (exception)
+    {
+        /*Codes_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
+        LogError("Exception occurred in receive() of %s.", module->moduleName);
+        JNIFunc(env, ExceptionDescribe);
+        JNIFunc(env, ExceptionClear);
+    }
+}
+
+static void deliver_byte_arrays(JAVA_MODULE_HANDLE_DATA* module, JNIEnv* env, MESSAGE_HANDLE* messages, size_t count)
+{
+    for (size_t index = 0; index < count; index++)
+    {
+        int32_t size;
+        if (serialize_message(module, messages[index], 0, &size) != 0)
+        {
+            /*Codes_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
+            LogError("Message %zu was not delivered to %s.", index, module->moduleName);
+        }
+        else
+        {
+            /*Codes_SRS_JAVA_MODULE_HOST_14_043: [This function shall create a new jbyteArray for the serialized message.]*/
+            jbyteArray arr = JNIFunc(env, NewByteArray, size);
+            if (arr == NULL)
+            {
+                /*Codes_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
+                LogError("New jbyteArray could not be constructed.");
+                JNIFunc(env, ExceptionClear);
+            }
+            else
+            {
+                /*Codes_SRS_JAVA_MODULE_HOST_14_044: [This function shall set the contents of the jbyteArray to the serialized_message.]*/
+                JNIFunc(env, SetByteArrayRegion, arr, 0, size, (jbyte*)module->arena);
+                jthrowable exception = JNIFunc(env, ExceptionOccurred);
+                if (exception)
+                {
+                    /*Codes_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
+                    LogError("Exception occurred in SetByteArrayRegion.");
+                    JNIFunc(env, ExceptionDescribe);
+                    JNIFunc(env, ExceptionClear);
+                }
+                else
+                {
+                    /*Codes_SRS_JAVA_MODULE_HOST_14_024: [This function shall call the void receive(byte[] source) method of the Java module object passing the serialized message.]*/
+                    CallVoidMethodInternal(env, module->module, module->jModule_receive, 1, arr);
+                    check_receive_exception(module, env);
+                }
+                JNIFunc(env, DeleteLocalRef, arr);
+            }
+        }
+    }
+}
+
+static void deliver_direct_buffer(JAVA_MODULE_HANDLE_DATA* module, JNIEnv* env, MESSAGE_HANDLE* messages, size_t count)
+{
+    size_t offset = 0;
+    jint packed = 0;
+    for (size_t index = 0; index < count; index++)
+    {
+        int32_t size;
+        if (serialize_message(module, messages[index], offset, &size) != 0)
+        {
+            /*Codes_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
+            LogError("Message %zu was not delivered to %s.", index, module->moduleName);
+        }
+        else
+        {
+            offset += size;
+            packed++;
+        }
+    }
+
+    if (packed != 0)
+    {
+        /*Codes_SRS_JAVA_MODULE_HOST_17_006: [ This function shall wrap the serialized messages in a direct ByteBuffer and call receive(ByteBuffer) for a single message, or receiveBatch(ByteBuffer, int) with the number of messages otherwise. ]*/
+        jobject buffer = JNIFunc(env, NewDirectByteBuffer, module->arena, (jlong)offset);
+        if (buffer == NULL)
+        {
+            /*Codes_SRS_JAVA_MODULE_HOST_17_007: [ If the direct ByteBuffer cannot be created, this function shall deliver the messages as byte arrays. ]*/
+            LogError("Could not create a direct ByteBuffer, delivering byte arrays to %s.", module->moduleName);
+            JNIFunc(env, ExceptionClear);
+            deliver_byte_arrays(module, env, messages, count);
+        }
+        else
+        {
+            if (packed == 1)
+            {
+                CallVoidMethodInternal(env, module->module, module->jModule_receive_buffer, 1, buffer);
+            }
+            else
+            {
+                CallVoidMethodInternal(env, module->module, module->jModule_receive_batch, 2, buffer, packed);
+            }
+            check_receive_exception(module, env);
+        }
+    }
+}
+
+static void deliver_messages(JAVA_MODULE_HANDLE_DATA* module, MESSAGE_HANDLE* messages, size_t count)
+{
+    JNIEnv* env = get_receive_env(module);
+    if (env == NULL)
+    {
+        /*Codes_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
+        LogError("Messages were not delivered to %s.", module->moduleName);
+    }
+    /*Codes_SRS_JAVA_MODULE_HOST_17_002: [ This function shall create a local reference frame for the delivery and pop it before returning, since the thread stays attached to the JVM. ]*/
+    else if (JNIFunc(env, PushLocalFrame, RECEIVE_LOCAL_FRAME_CAPACITY) != JNI_OK)
+    {
+        /*Codes_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
+        LogError("Could not create a local reference frame.");
+        JNIFunc(env, ExceptionClear);
+    }
+    else
+    {
+        if (!module->receive_methods_resolved)
+        {
+            resolve_receive_methods(module, env);
+        }
+
+        if (!module->receive_methods_resolved)
+        {
+            /*Codes_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
+            LogError("Failed to get the %s receive() method.", module->moduleName);
+        }
+        else if (module->jModule_receive_buffer != NULL)
+        {
+            deliver_direct_buffer(module, env, messages, count);
+        }
+        else
+        {
+            /*Codes_SRS_JAVA_MODULE_HOST_17_008: [ Otherwise this function shall call receive(byte[]) for each message, in order. ]*/
+            deliver_byte_arrays(module, env, messages, count);
+        }
+
+        (void)JNIFunc(env, PopLocalFrame, NULL);
+    }
+}
+
 static int JVM_Create(JavaVM** jvm, JNIEnv** env, JVM_OPTIONS* options)
 {
     /*Codes_SRS_JAVA_MODULE_HOST_14_007: [This function shall initialize a JavaVMInitArgs structure using the JVM_OPTIONS structure configuration->options.]*/
@@ -960,6 +1291,10 @@ static void destroy_module_internal(JAVA_MODULE_HANDLE_DATA* module, bool decref
         JVM_Destroy(&(module->jvm));
     }
     JavaModuleHostManager_Destroy(module->manager);
+    if (module->arena != NULL)
+    {
+        free(module->arena);
+    }
     free(module);
 }
 
@@ -995,6 +1330,21 @@ static const MODULE_API_1 JavaModuleHost_APIS =
     JavaModuleHost_Start
 };
 
+static const MODULE_API_2 JavaModuleHost_APIS_2 =
+{
+    {
+        {MODULE_API_VERSION_2},
+
+        JavaModuleHost_ParseConfigurationFromJson,
+        JavaModuleHost_FreeConfiguration,
+        JavaModuleHost_Create,
+        JavaModuleHost_Destroy,
+        JavaModuleHost_Receive,
+        JavaModuleHost_Start
+    },
+    JavaModuleHost_ReceiveBatch
+};
+
 
 /* Codes_SRS_JAVA_MODULE_HOST_26_001: [ Module_GetApi shall fill out the provided MODULES_API structure with required module's APIs functions. ]*/
 #ifdef BUILD_MODULE_TYPE_STATIC
@@ -1003,6 +1353,15 @@ MODULE_EXPORT const MODULE_API* MODULE_STATIC_GETAPI(JAVA_MODULE_HOST)(MODULE_AP
 MODULE_EXPORT const MODULE_API* Module_GetApi(MODULE_API_VERSION gateway_api_version)
 #endif
 {
-    (void)gateway_api_version;
-    return (const MODULE_API *)&JavaModuleHost_APIS;
+    const MODULE_API* result;
+    if (gateway_api_version >= MODULE_API_VERSION_2)
+    {
+        /* Codes_SRS_JAVA_MODULE_HOST_17_011: [ Module_GetApi shall return the MODULE_API_2 table, which adds Module_ReceiveBatch, if gateway_api_version is MODULE_API_VERSION_2 or later, and the MODULE_API_1 table otherwise. ]*/
+        result = (const MODULE_API *)&JavaModuleHost_APIS_2;
+    }
+    else
+    {
+        result = (const MODULE_API *)&JavaModuleHost_APIS;
+    }
+    return result;
 }
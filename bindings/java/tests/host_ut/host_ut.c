@@ -112,12 +112,12 @@ MESSAGE_HANDLE my_Message_CreateFromByteArray(const unsigned char* source, int32
     return (MESSAGE_HANDLE)malloc(1);
 }
 
-int32_t my_MessageToByteArray(MESSAGE_HANDLE messageHandle, unsigned char* buf, int32_t size)
+static unsigned char serialized_message_bytes[1];
+static const CONSTBUFFER serialized_message = { serialized_message_bytes, sizeof(serialized_message_bytes) };
+const CONSTBUFFER* my_Message_GetSerialized(MESSAGE_HANDLE message)
 {
-    (void)messageHandle;
-    (void)buf;
-    (void)size;
-    return 1;
+    (void)message;
+    return &serialized_message;
 }
 
 void my_Message_Destroy(MESSAGE_HANDLE message)
@@ -231,11 +231,59 @@ jthrowable my_ExceptionOccurred(JNIEnv* env)
 MOCKABLE_FUNCTION(JNICALL, void, ExceptionClear, JNIEnv*, env);
 MOCKABLE_FUNCTION(JNICALL, void, ExceptionDescribe, JNIEnv*, env);
 
+MOCKABLE_FUNCTION(JNICALL, jint, PushLocalFrame, JNIEnv*, env, jint, capacity);
+MOCKABLE_FUNCTION(JNICALL, jobject, PopLocalFrame, JNIEnv*, env, jobject, result);
+
+MOCKABLE_FUNCTION(JNICALL, jobject, NewDirectByteBuffer, JNIEnv*, env, void*, address, jlong, capacity);
+jobject my_NewDirectByteBuffer(JNIEnv* env, void* address, jlong capacity)
+{
+    (void)env;
+    (void)address;
+    (void)capacity;
+    return (jobject)0x42;
+}
+
+MOCKABLE_FUNCTION(JNICALL, void*, GetDirectBufferAddress, JNIEnv*, env, jobject, buf);
+void* my_GetDirectBufferAddress(JNIEnv* env, jobject buf)
+{
+    (void)env;
+    (void)buf;
+    return (void*)0x42;
+}
+
+MOCKABLE_FUNCTION(JNICALL, jlong, GetDirectBufferCapacity, JNIEnv*, env, jobject, buf);
+jlong my_GetDirectBufferCapacity(JNIEnv* env, jobject buf)
+{
+    (void)env;
+    (void)buf;
+    return 16;
+}
+
+MOCKABLE_FUNCTION(JNICALL, jobject, GetObjectArrayElement, JNIEnv*, env, jobjectArray, array, jsize, index);
+jobject my_GetObjectArrayElement(JNIEnv* env, jobjectArray array, jsize index)
+{
+    (void)env;
+    (void)array;
+    (void)index;
+    return (jobject)malloc(1);
+}
+
 //JVM function mocks
 MOCKABLE_FUNCTION(JNICALL, jint, AttachCurrentThread, JavaVM*, vm, void**, penv, void*, args);
 
 MOCKABLE_FUNCTION(JNICALL, jint, DetachCurrentThread, JavaVM*, vm);
 
+MOCKABLE_FUNCTION(JNICALL, jint, AttachCurrentThreadAsDaemon, JavaVM*, vm, void**, penv, void*, args);
+jint my_AttachCurrentThreadAsDaemon(JavaVM* vm, void** penv, void* args)
+{
+    (void)vm;
+    (void)args;
+
+    *penv = (void*)global_env;
+
+    return JNI_OK;
+}
+
 MOCKABLE_FUNCTION(JNICALL, jint, DestroyJavaVM, JavaVM*, vm);
 
 jint my_DestroyJavaVM(JavaVM* vm)
@@ -280,7 +328,7 @@ jint mock_JNI_CreateJavaVM(JavaVM** pvm, void** penv, void* args)
             0, 0, 0, 0,
 
             NULL, NULL, FindClass, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
-            NULL, ExceptionOccurred, ExceptionDescribe, ExceptionClear, NULL, NULL, NULL, NewGlobalRef, DeleteGlobalRef, DeleteLocalRef,
+            NULL, ExceptionOccurred, ExceptionDescribe, ExceptionClear, NULL, PushLocalFrame, PopLocalFrame, NewGlobalRef, DeleteGlobalRef, DeleteLocalRef,
             NULL, NULL, NULL, NULL, NULL, NewObjectV, NULL, GetObjectClass, NULL, GetMethodID,
             NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
             NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
@@ -295,13 +343,13 @@ jint mock_JNI_CreateJavaVM(JavaVM** pvm, void** penv, void* args)
             NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
             NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
             NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
-            NULL, NULL, NULL, NewStringUTF, NULL, NULL, NULL, GetArrayLength, NULL, NULL,
+            NULL, NULL, NULL, NewStringUTF, NULL, NULL, NULL, GetArrayLength, NULL, GetObjectArrayElement,
             NULL, NULL, NewByteArray, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
             NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
             NULL, NULL, NULL, NULL, NULL, NULL, GetByteArrayRegion, NULL, NULL, NULL,
             NULL, NULL, NULL, NULL, SetByteArrayRegion, NULL, NULL, NULL, NULL, NULL,
             NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
-            NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL
+            NULL, NULL, NULL, NULL, NULL, NewDirectByteBuffer, GetDirectBufferAddress, GetDirectBufferCapacity, NULL
         };
 
         struct JNIInvokeInterface_ vm = {
@@ -313,7 +361,7 @@ jint mock_JNI_CreateJavaVM(JavaVM** pvm, void** penv, void* args)
             AttachCurrentThread,
             DetachCurrentThread,
             GetEnv,
-            NULL
+            AttachCurrentThreadAsDaemon
         };
 
 #ifdef __cplusplus
@@ -505,6 +553,17 @@ void* my_gballoc_malloc(size_t size)
     return result;
 }
 
+void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    void* result = NULL;
+    if (malloc_will_fail == false)
+    {
+        result = realloc(ptr, size);
+    }
+
+    return result;
+}
+
 void my_gballoc_free(void* ptr)
 {
     free(ptr);
@@ -586,10 +645,31 @@ static pfModule_Create                      JavaModuleHost_Create = NULL; /*gets
 static pfModule_Destroy                     JavaModuleHost_Destroy = NULL; /*gets assigned in TEST_SUITE_INITIALIZE*/
 static pfModule_Receive                     JavaModuleHost_Receive = NULL; /*gets assigned in TEST_SUITE_INITIALIZE*/
 static pfModule_Start                       JavaModuleHost_Start = NULL; /*gets assigned in TEST_SUITE_INITIALIZE*/
+static pfModule_ReceiveBatch                JavaModuleHost_ReceiveBatch = NULL; /*gets assigned in TEST_SUITE_INITIALIZE*/
 
 IMPLEMENT_UMOCK_C_ENUM_TYPE(JAVA_MODULE_HOST_MANAGER_RESULT, JAVA_MODULE_HOST_MANAGER_RESULT_VALUES);
 IMPLEMENT_UMOCK_C_ENUM_TYPE(BROKER_RESULT, BROKER_RESULT_VALUES);
 
+static void expect_receive_methods_resolved(void)
+{
+    STRICT_EXPECTED_CALL(GetObjectClass(global_env, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(GetMethodID(global_env, IGNORED_PTR_ARG, MODULE_RECEIVE_METHOD_NAME, MODULE_RECEIVE_DESCRIPTOR))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
+    STRICT_EXPECTED_CALL(GetMethodID(global_env, IGNORED_PTR_ARG, MODULE_RECEIVE_METHOD_NAME, MODULE_RECEIVE_BUFFER_DESCRIPTOR))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
+    STRICT_EXPECTED_CALL(GetMethodID(global_env, IGNORED_PTR_ARG, MODULE_RECEIVE_BATCH_METHOD_NAME, MODULE_RECEIVE_BATCH_DESCRIPTOR))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
+    STRICT_EXPECTED_CALL(FindClass(global_env, GATEWAY_MODULE_CLASS_NAME));
+    STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
+    STRICT_EXPECTED_CALL(GetMethodID(global_env, IGNORED_PTR_ARG, MODULE_RECEIVE_METHOD_NAME, MODULE_RECEIVE_DESCRIPTOR))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
+}
+
 BEGIN_TEST_SUITE(JavaModuleHost_UnitTests)
 
 TEST_SUITE_INITIALIZE(TestClassInitialize)
@@ -598,13 +678,14 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     g_testByTest = TEST_MUTEX_CREATE();
     ASSERT_IS_NOT_NULL(g_testByTest);
 
-    const MODULE_API* apis = Module_GetApi(MODULE_API_VERSION_1);
+    const MODULE_API* apis = Module_GetApi(MODULE_API_VERSION_2);
     JavaModuleHost_ParseConfigurationFromJson = MODULE_PARSE_CONFIGURATION_FROM_JSON(apis);
     JavaModuleHost_FreeConfiguration = MODULE_FREE_CONFIGURATION(apis);
     JavaModuleHost_Create = MODULE_CREATE(apis);
     JavaModuleHost_Destroy = MODULE_DESTROY(apis);
     JavaModuleHost_Receive = MODULE_RECEIVE(apis);
     JavaModuleHost_Start = MODULE_START(apis);
+    JavaModuleHost_ReceiveBatch = MODULE_RECEIVE_BATCH(apis);
 
     umock_c_init(on_umock_c_error);
     umocktypes_charptr_register_types();
@@ -619,6 +700,13 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(NewGlobalRef, NULL);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(AttachCurrentThread, JNI_ERR);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(DetachCurrentThread, JNI_ERR);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(AttachCurrentThreadAsDaemon, JNI_ERR);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(GetEnv, JNI_ERR);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(PushLocalFrame, JNI_ERR);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(NewDirectByteBuffer, NULL);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(GetDirectBufferAddress, NULL);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(GetDirectBufferCapacity, -1);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(GetObjectArrayElement, NULL);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(JNI_CreateJavaVM, JNI_ERR);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(ExceptionOccurred, (jthrowable)0x42);
 
@@ -636,9 +724,15 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_HOOK(ExceptionOccurred, my_ExceptionOccurred);
     REGISTER_GLOBAL_MOCK_HOOK(DestroyJavaVM, my_DestroyJavaVM);
     REGISTER_GLOBAL_MOCK_HOOK(GetEnv, my_GetEnv);
+    REGISTER_GLOBAL_MOCK_HOOK(AttachCurrentThreadAsDaemon, my_AttachCurrentThreadAsDaemon);
+    REGISTER_GLOBAL_MOCK_HOOK(NewDirectByteBuffer, my_NewDirectByteBuffer);
+    REGISTER_GLOBAL_MOCK_HOOK(GetDirectBufferAddress, my_GetDirectBufferAddress);
+    REGISTER_GLOBAL_MOCK_HOOK(GetDirectBufferCapacity, my_GetDirectBufferCapacity);
+    REGISTER_GLOBAL_MOCK_HOOK(GetObjectArrayElement, my_GetObjectArrayElement);
 
     //gballoc Hooks
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
 
     //Vector Hooks
@@ -661,7 +755,7 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 
     //Message Hooks
     REGISTER_GLOBAL_MOCK_HOOK(Message_CreateFromByteArray, my_Message_CreateFromByteArray);
-    REGISTER_GLOBAL_MOCK_HOOK(Message_ToByteArray, my_MessageToByteArray);
+    REGISTER_GLOBAL_MOCK_HOOK(Message_GetSerialized, my_Message_GetSerialized);
     REGISTER_GLOBAL_MOCK_HOOK(Message_Destroy, my_Message_Destroy);
 
     //JavaModuleHostManager Hooks
@@ -681,6 +775,7 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_UMOCK_ALIAS_TYPE(MODULE_HANDLE, void*);
 
     REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(const CONSTBUFFER*, void*);
 
     REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
 
@@ -694,6 +789,7 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_UMOCK_ALIAS_TYPE(JavaVM*, void*);
     REGISTER_UMOCK_ALIAS_TYPE(JavaVM**, void*);
     REGISTER_UMOCK_ALIAS_TYPE(jint, int32_t);
+    REGISTER_UMOCK_ALIAS_TYPE(jlong, int64_t);
     REGISTER_UMOCK_ALIAS_TYPE(jclass, void*);
     REGISTER_UMOCK_ALIAS_TYPE(jmethodID, void*);
     REGISTER_UMOCK_ALIAS_TYPE(jobject, void*);
@@ -703,6 +799,7 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_UMOCK_ALIAS_TYPE(jsize, int);
     REGISTER_UMOCK_ALIAS_TYPE(const jbyte*, void*);
     REGISTER_UMOCK_ALIAS_TYPE(jarray, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(jobjectArray, void*);
     REGISTER_UMOCK_ALIAS_TYPE(BROKER_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(const char*, char*);
 
@@ -2150,13 +2247,14 @@ TEST_FUNCTION(JavaModuleHost_Create_gets_previously_created_JVM_success)
 //JavaModuleHost_Receive tests
 //=============================================================================
 
-/*Tests_SRS_JAVA_MODULE_HOST_14_023: [This function shall serialize message.]*/
-/*Tests_SRS_JAVA_MODULE_HOST_14_042: [This function shall attach the JVM to the current thread.]*/
-/*Tests_SRS_JAVA_MODULE_HOST_14_043: [This function shall create a new jbyteArray for the serialized message.]*/
-/*Tests_SRS_JAVA_MODULE_HOST_14_044: [This function shall set the contents of the jbyteArray to the serialized_message.]*/
+/*Tests_SRS_JAVA_MODULE_HOST_17_001: [ If the current thread is not attached to the JVM, this function shall attach it as a daemon thread and leave it attached, so that later deliveries on the same thread do not attach again. ]*/
+/*Tests_SRS_JAVA_MODULE_HOST_17_002: [ This function shall create a local reference frame for the delivery and pop it before returning, since the thread stays attached to the JVM. ]*/
 /*Tests_SRS_JAVA_MODULE_HOST_14_045: [This function shall get the user - defined Java module class using the module parameter and get the receive() method.]*/
-/*Tests_SRS_JAVA_MODULE_HOST_14_024: [This function shall call the void receive(byte[] source) method of the Java module object passing the serialized message.]*/
-/*Tests_SRS_JAVA_MODULE_HOST_14_046: [This function shall detach the JVM from the current thread.]*/
+/*Tests_SRS_JAVA_MODULE_HOST_17_003: [ This function shall look up the receive methods of the Java module only once, on the first delivery, and keep them for the lifetime of the module. ]*/
+/*Tests_SRS_JAVA_MODULE_HOST_17_004: [ This function shall deliver messages in direct ByteBuffers only if the module has receive(ByteBuffer) and receiveBatch(ByteBuffer, int) and does not override the receive(byte[]) method of GatewayModule. ]*/
+/*Tests_SRS_JAVA_MODULE_HOST_14_023: [This function shall serialize message.]*/
+/*Tests_SRS_JAVA_MODULE_HOST_17_005: [ This function shall serialize the messages into a native buffer owned by the module, grown as needed and reused for every delivery. ]*/
+/*Tests_SRS_JAVA_MODULE_HOST_17_006: [ This function shall wrap the serialized messages in a direct ByteBuffer and call receive(ByteBuffer) for a single message, or receiveBatch(ByteBuffer, int) with the number of messages otherwise. ]*/
 TEST_FUNCTION(JavaModuleHost_Receive_success)
 {
     //Arrange
@@ -2172,56 +2270,109 @@ TEST_FUNCTION(JavaModuleHost_Receive_success)
     MESSAGE_HANDLE message = Message_CreateFromByteArray(msg, sizeof(msg));
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, NULL, 0));
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(GetEnv(global_vm, IGNORED_PTR_ARG, JNI_VERSION_1_6))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(PushLocalFrame(global_env, IGNORED_NUM_ARG))
+        .IgnoreArgument(2);
+    expect_receive_methods_resolved();
+    STRICT_EXPECTED_CALL(Message_GetSerialized(message));
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, 1));
+    STRICT_EXPECTED_CALL(NewDirectByteBuffer(global_env, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(CallVoidMethodV(global_env, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
-        .IgnoreArgument(3);
+        .IgnoreArgument(3)
+        .IgnoreArgument(4);
+    STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
+    STRICT_EXPECTED_CALL(PopLocalFrame(global_env, NULL));
 
-    STRICT_EXPECTED_CALL(AttachCurrentThread(IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
+    //Act
+    JavaModuleHost_Receive(module, message);
 
-    STRICT_EXPECTED_CALL(NewByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
+    //Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    STRICT_EXPECTED_CALL(SetByteArrayRegion(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 0, IGNORED_NUM_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(4)
-        .IgnoreArgument(5);
+    //Cleanup
+    Message_Destroy(message);
+    JavaModuleHost_Destroy(module);
+}
 
-    STRICT_EXPECTED_CALL(ExceptionOccurred(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+/*Tests_SRS_JAVA_MODULE_HOST_17_003: [ This function shall look up the receive methods of the Java module only once, on the first delivery, and keep them for the lifetime of the module. ]*/
+/*Tests_SRS_JAVA_MODULE_HOST_17_005: [ This function shall serialize the messages into a native buffer owned by the module, grown as needed and reused for every delivery. ]*/
+TEST_FUNCTION(JavaModuleHost_Receive_reuses_methods_and_buffer)
+{
+    //Arrange
+    const unsigned char msg[] =
+    {
+        0xA1, 0x60,             /*header*/
+        0x00, 0x00, 0x00, 14,   /*size of this array*/
+        0x00, 0x00, 0x00, 0x00, /*zero properties*/
+        0x00, 0x00, 0x00, 0x00  /*zero message content size*/
+    };
 
-    STRICT_EXPECTED_CALL(GetObjectClass(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
+    MODULE_HANDLE module = JavaModuleHost_Create((BROKER_HANDLE)0x42, &config);
+    MESSAGE_HANDLE message = Message_CreateFromByteArray(msg, sizeof(msg));
+    JavaModuleHost_Receive(module, message);
+    umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(GetMethodID(IGNORED_PTR_ARG, IGNORED_PTR_ARG, MODULE_RECEIVE_METHOD_NAME, MODULE_RECEIVE_DESCRIPTOR))
-        .IgnoreArgument(1)
+    STRICT_EXPECTED_CALL(GetEnv(global_vm, IGNORED_PTR_ARG, JNI_VERSION_1_6))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(PushLocalFrame(global_env, IGNORED_NUM_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(Message_GetSerialized(message));
+    STRICT_EXPECTED_CALL(NewDirectByteBuffer(global_env, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(CallVoidMethodV(global_env, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3)
+        .IgnoreArgument(4);
+    STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
+    STRICT_EXPECTED_CALL(PopLocalFrame(global_env, NULL));
 
-    STRICT_EXPECTED_CALL(ExceptionOccurred(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    //Act
+    JavaModuleHost_Receive(module, message);
 
-    STRICT_EXPECTED_CALL(CallVoidMethodV(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
+    //Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    STRICT_EXPECTED_CALL(ExceptionOccurred(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    //Cleanup
+    Message_Destroy(message);
+    JavaModuleHost_Destroy(module);
+}
 
-    STRICT_EXPECTED_CALL(DeleteLocalRef(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
+/*Tests_SRS_JAVA_MODULE_HOST_17_001: [ If the current thread is not attached to the JVM, this function shall attach it as a daemon thread and leave it attached, so that later deliveries on the same thread do not attach again. ]*/
+TEST_FUNCTION(JavaModuleHost_Receive_attaches_thread_as_daemon)
+{
+    //Arrange
+    const unsigned char msg[] =
+    {
+        0xA1, 0x60,             /*header*/
+        0x00, 0x00, 0x00, 14,   /*size of this array*/
+        0x00, 0x00, 0x00, 0x00, /*zero properties*/
+        0x00, 0x00, 0x00, 0x00  /*zero message content size*/
+    };
 
-    STRICT_EXPECTED_CALL(DetachCurrentThread(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    MODULE_HANDLE module = JavaModuleHost_Create((BROKER_HANDLE)0x42, &config);
+    MESSAGE_HANDLE message = Message_CreateFromByteArray(msg, sizeof(msg));
+    JavaModuleHost_Receive(module, message);
+    umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(GetEnv(global_vm, IGNORED_PTR_ARG, JNI_VERSION_1_6))
+        .IgnoreArgument(2)
+        .SetReturn(JNI_EDETACHED);
+    STRICT_EXPECTED_CALL(AttachCurrentThreadAsDaemon(global_vm, IGNORED_PTR_ARG, NULL))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(PushLocalFrame(global_env, IGNORED_NUM_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(Message_GetSerialized(message));
+    STRICT_EXPECTED_CALL(NewDirectByteBuffer(global_env, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(CallVoidMethodV(global_env, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3)
+        .IgnoreArgument(4);
+    STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
+    STRICT_EXPECTED_CALL(PopLocalFrame(global_env, NULL));
 
     //Act
     JavaModuleHost_Receive(module, message);
@@ -2277,7 +2428,7 @@ TEST_FUNCTION(JavaModuleHost_Receive_message_NULL_failure)
 }
 
 /*Tests_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
-TEST_FUNCTION(JavaModuleHost_Receive_Message_ToByteArray_failure)
+TEST_FUNCTION(JavaModuleHost_Receive_GetEnv_failure)
 {
     //Arrange
     const unsigned char msg[] =
@@ -2292,18 +2443,11 @@ TEST_FUNCTION(JavaModuleHost_Receive_Message_ToByteArray_failure)
     MESSAGE_HANDLE message = Message_CreateFromByteArray(msg, sizeof(msg));
     umock_c_reset_all_calls();
 
-    int result = 0;
-    result = umock_c_negative_tests_init();
-    ASSERT_ARE_EQUAL(int, 0, result);
-
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, NULL, 0))
-        .SetFailReturn(-1);
-
-
-    umock_c_negative_tests_snapshot();
+    STRICT_EXPECTED_CALL(GetEnv(global_vm, IGNORED_PTR_ARG, JNI_VERSION_1_6))
+        .IgnoreArgument(2)
+        .SetReturn(JNI_ERR);
 
     //Act
-    umock_c_negative_tests_fail_call(0);
     JavaModuleHost_Receive(module, message);
 
     //Assert
@@ -2312,13 +2456,10 @@ TEST_FUNCTION(JavaModuleHost_Receive_Message_ToByteArray_failure)
     //Cleanup
     Message_Destroy(message);
     JavaModuleHost_Destroy(module);
-
-    umock_c_negative_tests_deinit();
-
 }
 
 /*Tests_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
-TEST_FUNCTION(JavaModuleHost_Receive_Message_allocate_failure)
+TEST_FUNCTION(JavaModuleHost_Receive_AttachCurrentThreadAsDaemon_failure)
 {
     //Arrange
     const unsigned char msg[] =
@@ -2333,19 +2474,14 @@ TEST_FUNCTION(JavaModuleHost_Receive_Message_allocate_failure)
     MESSAGE_HANDLE message = Message_CreateFromByteArray(msg, sizeof(msg));
     umock_c_reset_all_calls();
 
-    int result = 0;
-    result = umock_c_negative_tests_init();
-    ASSERT_ARE_EQUAL(int, 0, result);
-
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, NULL, 0));
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-        .IgnoreArgument(1)
-        .SetFailReturn(NULL);
-
-    umock_c_negative_tests_snapshot();
+    STRICT_EXPECTED_CALL(GetEnv(global_vm, IGNORED_PTR_ARG, JNI_VERSION_1_6))
+        .IgnoreArgument(2)
+        .SetReturn(JNI_EDETACHED);
+    STRICT_EXPECTED_CALL(AttachCurrentThreadAsDaemon(global_vm, IGNORED_PTR_ARG, NULL))
+        .IgnoreArgument(2)
+        .SetReturn(JNI_ERR);
 
     //Act
-    umock_c_negative_tests_fail_call(1);
     JavaModuleHost_Receive(module, message);
 
     //Assert
@@ -2354,12 +2490,10 @@ TEST_FUNCTION(JavaModuleHost_Receive_Message_allocate_failure)
     //Cleanup
     Message_Destroy(message);
     JavaModuleHost_Destroy(module);
-
-    umock_c_negative_tests_deinit();
-
 }
+
 /*Tests_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
-TEST_FUNCTION(JavaModuleHost_Receive_AttachCurrentThread_failure)
+TEST_FUNCTION(JavaModuleHost_Receive_PushLocalFrame_failure)
 {
     //Arrange
     const unsigned char msg[] =
@@ -2374,25 +2508,14 @@ TEST_FUNCTION(JavaModuleHost_Receive_AttachCurrentThread_failure)
     MESSAGE_HANDLE message = Message_CreateFromByteArray(msg, sizeof(msg));
     umock_c_reset_all_calls();
 
-    int result = 0;
-    result = umock_c_negative_tests_init();
-    ASSERT_ARE_EQUAL(int, 0, result);
-
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, NULL, 0));
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3);
-    STRICT_EXPECTED_CALL(AttachCurrentThread(global_vm, IGNORED_PTR_ARG, NULL))
+    STRICT_EXPECTED_CALL(GetEnv(global_vm, IGNORED_PTR_ARG, JNI_VERSION_1_6))
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    umock_c_negative_tests_snapshot();
+    STRICT_EXPECTED_CALL(PushLocalFrame(global_env, IGNORED_NUM_ARG))
+        .IgnoreArgument(2)
+        .SetReturn(JNI_ERR);
+    STRICT_EXPECTED_CALL(ExceptionClear(global_env));
 
     //Act
-    umock_c_negative_tests_fail_call(3);
     JavaModuleHost_Receive(module, message);
 
     //Assert
@@ -2401,12 +2524,10 @@ TEST_FUNCTION(JavaModuleHost_Receive_AttachCurrentThread_failure)
     //Cleanup
     Message_Destroy(message);
     JavaModuleHost_Destroy(module);
-
-    umock_c_negative_tests_deinit();
 }
 
 /*Tests_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
-TEST_FUNCTION(JavaModuleHost_Receive_NewByteArray_failure)
+TEST_FUNCTION(JavaModuleHost_Receive_GetObjectClass_failure)
 {
     //Arrange
     const unsigned char msg[] =
@@ -2421,30 +2542,16 @@ TEST_FUNCTION(JavaModuleHost_Receive_NewByteArray_failure)
     MESSAGE_HANDLE message = Message_CreateFromByteArray(msg, sizeof(msg));
     umock_c_reset_all_calls();
 
-    int result = 0;
-    result = umock_c_negative_tests_init();
-    ASSERT_ARE_EQUAL(int, 0, result);
-
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, NULL, 0));
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3);
-    STRICT_EXPECTED_CALL(AttachCurrentThread(global_vm, IGNORED_PTR_ARG, NULL))
+    STRICT_EXPECTED_CALL(GetEnv(global_vm, IGNORED_PTR_ARG, JNI_VERSION_1_6))
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(NewByteArray(global_env, IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(PushLocalFrame(global_env, IGNORED_NUM_ARG))
         .IgnoreArgument(2);
-
-    STRICT_EXPECTED_CALL(DetachCurrentThread(global_vm));
-
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    umock_c_negative_tests_snapshot();
+    STRICT_EXPECTED_CALL(GetObjectClass(global_env, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(PopLocalFrame(global_env, NULL));
 
     //Act
-    umock_c_negative_tests_fail_call(4);
     JavaModuleHost_Receive(module, message);
 
     //Assert
@@ -2453,12 +2560,10 @@ TEST_FUNCTION(JavaModuleHost_Receive_NewByteArray_failure)
     //Cleanup
     Message_Destroy(message);
     JavaModuleHost_Destroy(module);
-
-    umock_c_negative_tests_deinit();
 }
 
 /*Tests_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
-TEST_FUNCTION(JavaModuleHost_Receive_SetByteArrayRegion_failure)
+TEST_FUNCTION(JavaModuleHost_Receive_GetMethodID_failure)
 {
     //Arrange
     const unsigned char msg[] =
@@ -2473,38 +2578,21 @@ TEST_FUNCTION(JavaModuleHost_Receive_SetByteArrayRegion_failure)
     MESSAGE_HANDLE message = Message_CreateFromByteArray(msg, sizeof(msg));
     umock_c_reset_all_calls();
 
-    int result = 0;
-    result = umock_c_negative_tests_init();
-    ASSERT_ARE_EQUAL(int, 0, result);
-
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, NULL, 0));
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3);
-    STRICT_EXPECTED_CALL(AttachCurrentThread(global_vm, IGNORED_PTR_ARG, NULL))
+    STRICT_EXPECTED_CALL(GetEnv(global_vm, IGNORED_PTR_ARG, JNI_VERSION_1_6))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(PushLocalFrame(global_env, IGNORED_NUM_ARG))
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(NewByteArray(global_env, IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(GetObjectClass(global_env, IGNORED_PTR_ARG))
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(SetByteArrayRegion(global_env, IGNORED_PTR_ARG, 0, IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(GetMethodID(global_env, IGNORED_PTR_ARG, MODULE_RECEIVE_METHOD_NAME, MODULE_RECEIVE_DESCRIPTOR))
         .IgnoreArgument(2)
-        .IgnoreArgument(4)
-        .IgnoreArgument(5);
+        .SetReturn(NULL);
     STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
     STRICT_EXPECTED_CALL(ExceptionDescribe(global_env));
     STRICT_EXPECTED_CALL(ExceptionClear(global_env));
-    STRICT_EXPECTED_CALL(DeleteLocalRef(global_env, IGNORED_PTR_ARG))
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(DetachCurrentThread(global_vm));
-
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    umock_c_negative_tests_snapshot();
+    STRICT_EXPECTED_CALL(PopLocalFrame(global_env, NULL));
 
     //Act
-    umock_c_negative_tests_fail_call(6);
     JavaModuleHost_Receive(module, message);
 
     //Assert
@@ -2513,12 +2601,10 @@ TEST_FUNCTION(JavaModuleHost_Receive_SetByteArrayRegion_failure)
     //Cleanup
     Message_Destroy(message);
     JavaModuleHost_Destroy(module);
-
-    umock_c_negative_tests_deinit();
 }
 
 /*Tests_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
-TEST_FUNCTION(JavaModuleHost_Receive_GetObjectClass_failure)
+TEST_FUNCTION(JavaModuleHost_Receive_Message_GetSerialized_failure)
 {
     //Arrange
     const unsigned char msg[] =
@@ -2533,38 +2619,108 @@ TEST_FUNCTION(JavaModuleHost_Receive_GetObjectClass_failure)
     MESSAGE_HANDLE message = Message_CreateFromByteArray(msg, sizeof(msg));
     umock_c_reset_all_calls();
 
-    int result = 0;
-    result = umock_c_negative_tests_init();
-    ASSERT_ARE_EQUAL(int, 0, result);
+    STRICT_EXPECTED_CALL(GetEnv(global_vm, IGNORED_PTR_ARG, JNI_VERSION_1_6))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(PushLocalFrame(global_env, IGNORED_NUM_ARG))
+        .IgnoreArgument(2);
+    expect_receive_methods_resolved();
+    STRICT_EXPECTED_CALL(Message_GetSerialized(message))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(PopLocalFrame(global_env, NULL));
 
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, NULL, 0));
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3);
-    STRICT_EXPECTED_CALL(AttachCurrentThread(global_vm, IGNORED_PTR_ARG, NULL))
+    //Act
+    JavaModuleHost_Receive(module, message);
+
+    //Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //Cleanup
+    Message_Destroy(message);
+    JavaModuleHost_Destroy(module);
+}
+
+/*Tests_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
+TEST_FUNCTION(JavaModuleHost_Receive_buffer_allocate_failure)
+{
+    //Arrange
+    const unsigned char msg[] =
+    {
+        0xA1, 0x60,             /*header*/
+        0x00, 0x00, 0x00, 14,   /*size of this array*/
+        0x00, 0x00, 0x00, 0x00, /*zero properties*/
+        0x00, 0x00, 0x00, 0x00  /*zero message content size*/
+    };
+
+    MODULE_HANDLE module = JavaModuleHost_Create((BROKER_HANDLE)0x42, &config);
+    MESSAGE_HANDLE message = Message_CreateFromByteArray(msg, sizeof(msg));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(GetEnv(global_vm, IGNORED_PTR_ARG, JNI_VERSION_1_6))
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(NewByteArray(global_env, IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(PushLocalFrame(global_env, IGNORED_NUM_ARG))
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(SetByteArrayRegion(global_env, IGNORED_PTR_ARG, 0, IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+    expect_receive_methods_resolved();
+    STRICT_EXPECTED_CALL(Message_GetSerialized(message));
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, 1))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(PopLocalFrame(global_env, NULL));
+
+    //Act
+    JavaModuleHost_Receive(module, message);
+
+    //Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //Cleanup
+    Message_Destroy(message);
+    JavaModuleHost_Destroy(module);
+}
+
+/*Tests_SRS_JAVA_MODULE_HOST_17_007: [ If the direct ByteBuffer cannot be created, this function shall deliver the messages as byte arrays. ]*/
+/*Tests_SRS_JAVA_MODULE_HOST_14_043: [This function shall create a new jbyteArray for the serialized message.]*/
+/*Tests_SRS_JAVA_MODULE_HOST_14_044: [This function shall set the contents of the jbyteArray to the serialized_message.]*/
+/*Tests_SRS_JAVA_MODULE_HOST_14_024: [This function shall call the void receive(byte[] source) method of the Java module object passing the serialized message.]*/
+TEST_FUNCTION(JavaModuleHost_Receive_NewDirectByteBuffer_failure_delivers_byte_array)
+{
+    //Arrange
+    const unsigned char msg[] =
+    {
+        0xA1, 0x60,             /*header*/
+        0x00, 0x00, 0x00, 14,   /*size of this array*/
+        0x00, 0x00, 0x00, 0x00, /*zero properties*/
+        0x00, 0x00, 0x00, 0x00  /*zero message content size*/
+    };
+
+    MODULE_HANDLE module = JavaModuleHost_Create((BROKER_HANDLE)0x42, &config);
+    MESSAGE_HANDLE message = Message_CreateFromByteArray(msg, sizeof(msg));
+    JavaModuleHost_Receive(module, message);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(GetEnv(global_vm, IGNORED_PTR_ARG, JNI_VERSION_1_6))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(PushLocalFrame(global_env, IGNORED_NUM_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(Message_GetSerialized(message));
+    STRICT_EXPECTED_CALL(NewDirectByteBuffer(global_env, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(2)
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(ExceptionClear(global_env));
+    STRICT_EXPECTED_CALL(Message_GetSerialized(message));
+    STRICT_EXPECTED_CALL(NewByteArray(global_env, 1));
+    STRICT_EXPECTED_CALL(SetByteArrayRegion(global_env, IGNORED_PTR_ARG, 0, 1, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
-        .IgnoreArgument(4)
         .IgnoreArgument(5);
     STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
-    STRICT_EXPECTED_CALL(GetObjectClass(global_env, IGNORED_PTR_ARG))
-        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(CallVoidMethodV(global_env, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3)
+        .IgnoreArgument(4);
+    STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
     STRICT_EXPECTED_CALL(DeleteLocalRef(global_env, IGNORED_PTR_ARG))
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(DetachCurrentThread(global_vm));
-
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    umock_c_negative_tests_snapshot();
+    STRICT_EXPECTED_CALL(PopLocalFrame(global_env, NULL));
 
     //Act
-    umock_c_negative_tests_fail_call(7);
     JavaModuleHost_Receive(module, message);
 
     //Assert
@@ -2573,12 +2729,10 @@ TEST_FUNCTION(JavaModuleHost_Receive_GetObjectClass_failure)
     //Cleanup
     Message_Destroy(message);
     JavaModuleHost_Destroy(module);
-
-    umock_c_negative_tests_deinit();
 }
 
 /*Tests_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
-TEST_FUNCTION(JavaModuleHost_Receive_GetMethodID_failure)
+TEST_FUNCTION(JavaModuleHost_Receive_CallVoidMethod_failure)
 {
     //Arrange
     const unsigned char msg[] =
@@ -2591,45 +2745,92 @@ TEST_FUNCTION(JavaModuleHost_Receive_GetMethodID_failure)
 
     MODULE_HANDLE module = JavaModuleHost_Create((BROKER_HANDLE)0x42, &config);
     MESSAGE_HANDLE message = Message_CreateFromByteArray(msg, sizeof(msg));
+    JavaModuleHost_Receive(module, message);
     umock_c_reset_all_calls();
 
-    int result = 0;
-    result = umock_c_negative_tests_init();
-    ASSERT_ARE_EQUAL(int, 0, result);
-
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, NULL, 0));
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3);
-    STRICT_EXPECTED_CALL(AttachCurrentThread(global_vm, IGNORED_PTR_ARG, NULL))
+    STRICT_EXPECTED_CALL(GetEnv(global_vm, IGNORED_PTR_ARG, JNI_VERSION_1_6))
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(NewByteArray(global_env, IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(PushLocalFrame(global_env, IGNORED_NUM_ARG))
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(SetByteArrayRegion(global_env, IGNORED_PTR_ARG, 0, IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(Message_GetSerialized(message));
+    STRICT_EXPECTED_CALL(NewDirectByteBuffer(global_env, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(CallVoidMethodV(global_env, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
-        .IgnoreArgument(4)
-        .IgnoreArgument(5);;
-    STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
+        .IgnoreArgument(3)
+        .IgnoreArgument(4);
+    STRICT_EXPECTED_CALL(ExceptionOccurred(global_env))
+        .SetReturn((jthrowable)0x42);
+    STRICT_EXPECTED_CALL(ExceptionDescribe(global_env));
+    STRICT_EXPECTED_CALL(ExceptionClear(global_env));
+    STRICT_EXPECTED_CALL(PopLocalFrame(global_env, NULL));
+
+    //Act
+    JavaModuleHost_Receive(module, message);
+
+    //Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //Cleanup
+    Message_Destroy(message);
+    JavaModuleHost_Destroy(module);
+}
+
+/*Tests_SRS_JAVA_MODULE_HOST_17_004: [ This function shall deliver messages in direct ByteBuffers only if the module has receive(ByteBuffer) and receiveBatch(ByteBuffer, int) and does not override the receive(byte[]) method of GatewayModule. ]*/
+/*Tests_SRS_JAVA_MODULE_HOST_17_008: [ Otherwise this function shall call receive(byte[]) for each message, in order. ]*/
+TEST_FUNCTION(JavaModuleHost_Receive_without_buffer_methods_delivers_byte_array)
+{
+    //Arrange
+    const unsigned char msg[] =
+    {
+        0xA1, 0x60,             /*header*/
+        0x00, 0x00, 0x00, 14,   /*size of this array*/
+        0x00, 0x00, 0x00, 0x00, /*zero properties*/
+        0x00, 0x00, 0x00, 0x00  /*zero message content size*/
+    };
+
+    MODULE_HANDLE module = JavaModuleHost_Create((BROKER_HANDLE)0x42, &config);
+    MESSAGE_HANDLE message = Message_CreateFromByteArray(msg, sizeof(msg));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(GetEnv(global_vm, IGNORED_PTR_ARG, JNI_VERSION_1_6))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(PushLocalFrame(global_env, IGNORED_NUM_ARG))
+        .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(GetObjectClass(global_env, IGNORED_PTR_ARG))
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(GetMethodID(global_env, IGNORED_PTR_ARG, MODULE_RECEIVE_METHOD_NAME, MODULE_RECEIVE_DESCRIPTOR))
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
-    STRICT_EXPECTED_CALL(ExceptionDescribe(global_env));
+    STRICT_EXPECTED_CALL(GetMethodID(global_env, IGNORED_PTR_ARG, MODULE_RECEIVE_METHOD_NAME, MODULE_RECEIVE_BUFFER_DESCRIPTOR))
+        .IgnoreArgument(2)
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(ExceptionOccurred(global_env))
+        .SetReturn((jthrowable)0x42);
     STRICT_EXPECTED_CALL(ExceptionClear(global_env));
+    STRICT_EXPECTED_CALL(GetMethodID(global_env, IGNORED_PTR_ARG, MODULE_RECEIVE_BATCH_METHOD_NAME, MODULE_RECEIVE_BATCH_DESCRIPTOR))
+        .IgnoreArgument(2)
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(ExceptionOccurred(global_env))
+        .SetReturn((jthrowable)0x42);
+    STRICT_EXPECTED_CALL(ExceptionClear(global_env));
+    STRICT_EXPECTED_CALL(Message_GetSerialized(message));
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, 1));
+    STRICT_EXPECTED_CALL(NewByteArray(global_env, 1));
+    STRICT_EXPECTED_CALL(SetByteArrayRegion(global_env, IGNORED_PTR_ARG, 0, 1, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(5);
+    STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
+    STRICT_EXPECTED_CALL(CallVoidMethodV(global_env, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3)
+        .IgnoreArgument(4);
+    STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
     STRICT_EXPECTED_CALL(DeleteLocalRef(global_env, IGNORED_PTR_ARG))
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(DetachCurrentThread(global_vm));
-
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    umock_c_negative_tests_snapshot();
+    STRICT_EXPECTED_CALL(PopLocalFrame(global_env, NULL));
 
     //Act
-    umock_c_negative_tests_fail_call(8);
     JavaModuleHost_Receive(module, message);
 
     //Assert
@@ -2638,12 +2839,10 @@ TEST_FUNCTION(JavaModuleHost_Receive_GetMethodID_failure)
     //Cleanup
     Message_Destroy(message);
     JavaModuleHost_Destroy(module);
-
-    umock_c_negative_tests_deinit();
 }
 
-/*Tests_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
-TEST_FUNCTION(JavaModuleHost_Receive_CallVoidMethod_failure)
+/*Tests_SRS_JAVA_MODULE_HOST_17_004: [ This function shall deliver messages in direct ByteBuffers only if the module has receive(ByteBuffer) and receiveBatch(ByteBuffer, int) and does not override the receive(byte[]) method of GatewayModule. ]*/
+TEST_FUNCTION(JavaModuleHost_Receive_overridden_receive_delivers_byte_array)
 {
     //Arrange
     const unsigned char msg[] =
@@ -2658,58 +2857,233 @@ TEST_FUNCTION(JavaModuleHost_Receive_CallVoidMethod_failure)
     MESSAGE_HANDLE message = Message_CreateFromByteArray(msg, sizeof(msg));
     umock_c_reset_all_calls();
 
-    int result = 0;
-    result = umock_c_negative_tests_init();
-    ASSERT_ARE_EQUAL(int, 0, result);
-
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, NULL, 0));
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3);
-    STRICT_EXPECTED_CALL(AttachCurrentThread(global_vm, IGNORED_PTR_ARG, NULL))
+    STRICT_EXPECTED_CALL(GetEnv(global_vm, IGNORED_PTR_ARG, JNI_VERSION_1_6))
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(NewByteArray(global_env, IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(PushLocalFrame(global_env, IGNORED_NUM_ARG))
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(SetByteArrayRegion(global_env, IGNORED_PTR_ARG, 0, IGNORED_NUM_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(4)
-        .IgnoreArgument(5);;
-    STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
     STRICT_EXPECTED_CALL(GetObjectClass(global_env, IGNORED_PTR_ARG))
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(GetMethodID(global_env, IGNORED_PTR_ARG, MODULE_RECEIVE_METHOD_NAME, MODULE_RECEIVE_DESCRIPTOR))
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
+    STRICT_EXPECTED_CALL(GetMethodID(global_env, IGNORED_PTR_ARG, MODULE_RECEIVE_METHOD_NAME, MODULE_RECEIVE_BUFFER_DESCRIPTOR))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
+    STRICT_EXPECTED_CALL(GetMethodID(global_env, IGNORED_PTR_ARG, MODULE_RECEIVE_BATCH_METHOD_NAME, MODULE_RECEIVE_BATCH_DESCRIPTOR))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
+    STRICT_EXPECTED_CALL(FindClass(global_env, GATEWAY_MODULE_CLASS_NAME));
+    STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
+    STRICT_EXPECTED_CALL(GetMethodID(global_env, IGNORED_PTR_ARG, MODULE_RECEIVE_METHOD_NAME, MODULE_RECEIVE_DESCRIPTOR))
+        .IgnoreArgument(2)
+        .SetReturn((jmethodID)0x43);
+    STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
+    STRICT_EXPECTED_CALL(Message_GetSerialized(message));
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, 1));
+    STRICT_EXPECTED_CALL(NewByteArray(global_env, 1));
+    STRICT_EXPECTED_CALL(SetByteArrayRegion(global_env, IGNORED_PTR_ARG, 0, 1, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(5);
+    STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
     STRICT_EXPECTED_CALL(CallVoidMethodV(global_env, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3)
         .IgnoreArgument(4);
     STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
+    STRICT_EXPECTED_CALL(DeleteLocalRef(global_env, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(PopLocalFrame(global_env, NULL));
+
+    //Act
+    JavaModuleHost_Receive(module, message);
+
+    //Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //Cleanup
+    Message_Destroy(message);
+    JavaModuleHost_Destroy(module);
+}
+
+/*Tests_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
+TEST_FUNCTION(JavaModuleHost_Receive_SetByteArrayRegion_failure)
+{
+    //Arrange
+    const unsigned char msg[] =
+    {
+        0xA1, 0x60,             /*header*/
+        0x00, 0x00, 0x00, 14,   /*size of this array*/
+        0x00, 0x00, 0x00, 0x00, /*zero properties*/
+        0x00, 0x00, 0x00, 0x00  /*zero message content size*/
+    };
+
+    MODULE_HANDLE module = JavaModuleHost_Create((BROKER_HANDLE)0x42, &config);
+    MESSAGE_HANDLE message = Message_CreateFromByteArray(msg, sizeof(msg));
+    JavaModuleHost_Receive(module, message);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(GetEnv(global_vm, IGNORED_PTR_ARG, JNI_VERSION_1_6))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(PushLocalFrame(global_env, IGNORED_NUM_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(Message_GetSerialized(message));
+    STRICT_EXPECTED_CALL(NewDirectByteBuffer(global_env, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(2)
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(ExceptionClear(global_env));
+    STRICT_EXPECTED_CALL(Message_GetSerialized(message));
+    STRICT_EXPECTED_CALL(NewByteArray(global_env, 1));
+    STRICT_EXPECTED_CALL(SetByteArrayRegion(global_env, IGNORED_PTR_ARG, 0, 1, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(5);
+    STRICT_EXPECTED_CALL(ExceptionOccurred(global_env))
+        .SetReturn((jthrowable)0x42);
     STRICT_EXPECTED_CALL(ExceptionDescribe(global_env));
     STRICT_EXPECTED_CALL(ExceptionClear(global_env));
     STRICT_EXPECTED_CALL(DeleteLocalRef(global_env, IGNORED_PTR_ARG))
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(DetachCurrentThread(global_vm));
+    STRICT_EXPECTED_CALL(PopLocalFrame(global_env, NULL));
 
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+    //Act
+    JavaModuleHost_Receive(module, message);
+
+    //Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //Cleanup
+    Message_Destroy(message);
+    JavaModuleHost_Destroy(module);
+}
+
+//=============================================================================
+//JavaModuleHost_ReceiveBatch tests
+//=============================================================================
+
+/*Tests_SRS_JAVA_MODULE_HOST_17_010: [ JavaModuleHost_ReceiveBatch shall deliver the count messages to the Java module the way JavaModuleHost_Receive does, in one receiveBatch(ByteBuffer, int) call when the direct buffer methods are used. ]*/
+/*Tests_SRS_JAVA_MODULE_HOST_17_005: [ This function shall serialize the messages into a native buffer owned by the module, grown as needed and reused for every delivery. ]*/
+/*Tests_SRS_JAVA_MODULE_HOST_17_006: [ This function shall wrap the serialized messages in a direct ByteBuffer and call receive(ByteBuffer) for a single message, or receiveBatch(ByteBuffer, int) with the number of messages otherwise. ]*/
+TEST_FUNCTION(JavaModuleHost_ReceiveBatch_success)
+{
+    //Arrange
+    const unsigned char msg[] =
+    {
+        0xA1, 0x60,             /*header*/
+        0x00, 0x00, 0x00, 14,   /*size of this array*/
+        0x00, 0x00, 0x00, 0x00, /*zero properties*/
+        0x00, 0x00, 0x00, 0x00  /*zero message content size*/
+    };
+
+    MODULE_HANDLE module = JavaModuleHost_Create((BROKER_HANDLE)0x42, &config);
+    MESSAGE_HANDLE messages[2];
+    messages[0] = Message_CreateFromByteArray(msg, sizeof(msg));
+    messages[1] = Message_CreateFromByteArray(msg, sizeof(msg));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(GetEnv(global_vm, IGNORED_PTR_ARG, JNI_VERSION_1_6))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(PushLocalFrame(global_env, IGNORED_NUM_ARG))
+        .IgnoreArgument(2);
+    expect_receive_methods_resolved();
+    STRICT_EXPECTED_CALL(Message_GetSerialized(messages[0]));
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, 1));
+    STRICT_EXPECTED_CALL(Message_GetSerialized(messages[1]));
+    STRICT_EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, 2))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(NewDirectByteBuffer(global_env, IGNORED_PTR_ARG, 2))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(CallVoidMethodV(global_env, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3)
+        .IgnoreArgument(4);
+    STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
+    STRICT_EXPECTED_CALL(PopLocalFrame(global_env, NULL));
 
-    umock_c_negative_tests_snapshot();
+    //Act
+    JavaModuleHost_ReceiveBatch(module, messages, 2);
+
+    //Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //Cleanup
+    Message_Destroy(messages[0]);
+    Message_Destroy(messages[1]);
+    JavaModuleHost_Destroy(module);
+}
+
+/*Tests_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
+TEST_FUNCTION(JavaModuleHost_ReceiveBatch_skips_message_that_fails_to_serialize)
+{
+    //Arrange
+    const unsigned char msg[] =
+    {
+        0xA1, 0x60,             /*header*/
+        0x00, 0x00, 0x00, 14,   /*size of this array*/
+        0x00, 0x00, 0x00, 0x00, /*zero properties*/
+        0x00, 0x00, 0x00, 0x00  /*zero message content size*/
+    };
+
+    MODULE_HANDLE module = JavaModuleHost_Create((BROKER_HANDLE)0x42, &config);
+    MESSAGE_HANDLE messages[2];
+    messages[0] = Message_CreateFromByteArray(msg, sizeof(msg));
+    messages[1] = Message_CreateFromByteArray(msg, sizeof(msg));
+    JavaModuleHost_Receive(module, messages[0]);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(GetEnv(global_vm, IGNORED_PTR_ARG, JNI_VERSION_1_6))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(PushLocalFrame(global_env, IGNORED_NUM_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(Message_GetSerialized(messages[0]))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(Message_GetSerialized(messages[1]));
+    STRICT_EXPECTED_CALL(NewDirectByteBuffer(global_env, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(CallVoidMethodV(global_env, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3)
+        .IgnoreArgument(4);
+    STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
+    STRICT_EXPECTED_CALL(PopLocalFrame(global_env, NULL));
 
     //Act
-    umock_c_negative_tests_fail_call(11);
-    JavaModuleHost_Receive(module, message);
+    JavaModuleHost_ReceiveBatch(module, messages, 2);
 
     //Assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     //Cleanup
-    Message_Destroy(message);
+    Message_Destroy(messages[0]);
+    Message_Destroy(messages[1]);
     JavaModuleHost_Destroy(module);
+}
 
-    umock_c_negative_tests_deinit();
+/*Tests_SRS_JAVA_MODULE_HOST_17_009: [ JavaModuleHost_ReceiveBatch shall do nothing if module or messages is NULL, or if count is 0. ]*/
+TEST_FUNCTION(JavaModuleHost_ReceiveBatch_NULL_parameters_do_nothing)
+{
+    //Arrange
+    const unsigned char msg[] =
+    {
+        0xA1, 0x60,             /*header*/
+        0x00, 0x00, 0x00, 14,   /*size of this array*/
+        0x00, 0x00, 0x00, 0x00, /*zero properties*/
+        0x00, 0x00, 0x00, 0x00  /*zero message content size*/
+    };
+
+    MODULE_HANDLE module = JavaModuleHost_Create((BROKER_HANDLE)0x42, &config);
+    MESSAGE_HANDLE message = Message_CreateFromByteArray(msg, sizeof(msg));
+    umock_c_reset_all_calls();
+
+    //Act
+    JavaModuleHost_ReceiveBatch(NULL, &message, 1);
+    JavaModuleHost_ReceiveBatch(module, NULL, 1);
+    JavaModuleHost_ReceiveBatch(module, &message, 0);
+
+    //Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //Cleanup
+    Message_Destroy(message);
+    JavaModuleHost_Destroy(module);
 }
 
 //=============================================================================
@@ -3465,6 +3839,219 @@ TEST_FUNCTION(Java_com_microsoft_azure_gateway_core_Broker_publishMessage_failur
     JavaModuleHost_Destroy(module);
 }
 
+/*Tests_SRS_JAVA_MODULE_HOST_17_012: [ This function shall create the message straight from the memory of the direct ByteBuffer serialized_message, without copying it to an intermediate buffer, publish it and return the result of Broker_Publish. ]*/
+TEST_FUNCTION(Java_com_microsoft_azure_gateway_core_LocalBroker_publishMessageBuffer_success)
+{
+    //Arrange
+    MODULE_HANDLE module = JavaModuleHost_Create((BROKER_HANDLE)0x42, &config);
+    umock_c_reset_all_calls();
+
+    jobject serialized_message = (jobject)0x42;
+    jobject jBroker = (jobject)0x42;
+    jlong broker_address = (jlong)0x42;
+    BROKER_HANDLE broker = (BROKER_HANDLE)broker_address;
+
+    STRICT_EXPECTED_CALL(GetDirectBufferAddress(global_env, serialized_message));
+    STRICT_EXPECTED_CALL(GetDirectBufferCapacity(global_env, serialized_message));
+    STRICT_EXPECTED_CALL(Message_CreateFromByteArray(IGNORED_PTR_ARG, 16))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Broker_Publish(broker, module, IGNORED_PTR_ARG))
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(Message_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    //Act
+    jint result = Java_com_microsoft_azure_gateway_core_LocalBroker_publishMessageBuffer(global_env, jBroker, broker_address, (jlong)module, serialized_message);
+
+    //Assert
+    ASSERT_ARE_EQUAL(int32_t, JNI_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //Cleanup
+    JavaModuleHost_Destroy(module);
+}
+
+/*Tests_SRS_JAVA_MODULE_HOST_17_013: [ This function shall return a non-zero value if serialized_message is not a direct ByteBuffer or holds more than INT32_MAX bytes, or if any underlying function call fails. ]*/
+TEST_FUNCTION(Java_com_microsoft_azure_gateway_core_LocalBroker_publishMessageBuffer_failure)
+{
+    //Arrange
+    MODULE_HANDLE module = JavaModuleHost_Create((BROKER_HANDLE)0x42, &config);
+    umock_c_reset_all_calls();
+
+    jobject serialized_message = (jobject)0x42;
+    jobject jBroker = (jobject)0x42;
+    jlong broker_address = (jlong)0x42;
+    BROKER_HANDLE broker = (BROKER_HANDLE)broker_address;
+
+    int init_result = 0;
+    init_result = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, init_result);
+
+    STRICT_EXPECTED_CALL(GetDirectBufferAddress(global_env, serialized_message));
+    STRICT_EXPECTED_CALL(GetDirectBufferCapacity(global_env, serialized_message));
+    STRICT_EXPECTED_CALL(Message_CreateFromByteArray(IGNORED_PTR_ARG, 16))
+        .IgnoreArgument(1)
+        .SetFailReturn(NULL);
+    STRICT_EXPECTED_CALL(Broker_Publish(broker, module, IGNORED_PTR_ARG))
+        .IgnoreArgument(3)
+        .SetFailReturn(BROKER_ERROR);
+    STRICT_EXPECTED_CALL(Message_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    umock_c_negative_tests_snapshot();
+
+    //act
+    for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        if (i != 4)
+        {
+            // arrange
+            umock_c_negative_tests_reset();
+            umock_c_negative_tests_fail_call(i);
+
+            jint result = Java_com_microsoft_azure_gateway_core_LocalBroker_publishMessageBuffer(global_env, jBroker, broker_address, (jlong)module, serialized_message);
+
+            //Assert
+            ASSERT_ARE_NOT_EQUAL(int32_t, JNI_OK, result);
+        }
+    }
+    umock_c_negative_tests_deinit();
+
+    //Cleanup
+    JavaModuleHost_Destroy(module);
+}
+
+/*Tests_SRS_JAVA_MODULE_HOST_17_013: [ This function shall return a non-zero value if serialized_message is not a direct ByteBuffer or holds more than INT32_MAX bytes, or if any underlying function call fails. ]*/
+TEST_FUNCTION(Java_com_microsoft_azure_gateway_core_LocalBroker_publishMessageBuffer_too_large_fails)
+{
+    //Arrange
+    MODULE_HANDLE module = JavaModuleHost_Create((BROKER_HANDLE)0x42, &config);
+    umock_c_reset_all_calls();
+
+    jobject serialized_message = (jobject)0x42;
+
+    STRICT_EXPECTED_CALL(GetDirectBufferAddress(global_env, serialized_message));
+    STRICT_EXPECTED_CALL(GetDirectBufferCapacity(global_env, serialized_message))
+        .SetReturn((jlong)INT32_MAX + 1);
+
+    //Act
+    jint result = Java_com_microsoft_azure_gateway_core_LocalBroker_publishMessageBuffer(global_env, (jobject)0x42, (jlong)0x42, (jlong)module, serialized_message);
+
+    //Assert
+    ASSERT_ARE_NOT_EQUAL(int32_t, JNI_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //Cleanup
+    JavaModuleHost_Destroy(module);
+}
+
+/*Tests_SRS_JAVA_MODULE_HOST_17_014: [ This function shall publish every direct ByteBuffer of serialized_messages, in order, the way publishMessageBuffer does. ]*/
+TEST_FUNCTION(Java_com_microsoft_azure_gateway_core_LocalBroker_publishMessageBuffers_success)
+{
+    //Arrange
+    MODULE_HANDLE module = JavaModuleHost_Create((BROKER_HANDLE)0x42, &config);
+    umock_c_reset_all_calls();
+
+    jobjectArray serialized_messages = (jobjectArray)0x42;
+    jlong broker_address = (jlong)0x42;
+    BROKER_HANDLE broker = (BROKER_HANDLE)broker_address;
+
+    STRICT_EXPECTED_CALL(GetArrayLength(global_env, serialized_messages))
+        .SetReturn(2);
+    for (jsize index = 0; index < 2; index++)
+    {
+        STRICT_EXPECTED_CALL(GetObjectArrayElement(global_env, serialized_messages, index));
+        STRICT_EXPECTED_CALL(GetDirectBufferAddress(global_env, IGNORED_PTR_ARG))
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(GetDirectBufferCapacity(global_env, IGNORED_PTR_ARG))
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(Message_CreateFromByteArray(IGNORED_PTR_ARG, 16))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(Broker_Publish(broker, module, IGNORED_PTR_ARG))
+            .IgnoreArgument(3);
+        STRICT_EXPECTED_CALL(Message_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(DeleteLocalRef(global_env, IGNORED_PTR_ARG))
+            .IgnoreArgument(2);
+    }
+
+    //Act
+    jint result = Java_com_microsoft_azure_gateway_core_LocalBroker_publishMessageBuffers(global_env, (jobject)0x42, broker_address, (jlong)module, serialized_messages);
+
+    //Assert
+    ASSERT_ARE_EQUAL(int32_t, JNI_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //Cleanup
+    JavaModuleHost_Destroy(module);
+}
+
+/*Tests_SRS_JAVA_MODULE_HOST_17_015: [ This function shall keep publishing the other messages if one of them fails, and return a non-zero value if any did. ]*/
+TEST_FUNCTION(Java_com_microsoft_azure_gateway_core_LocalBroker_publishMessageBuffers_keeps_publishing_after_failure)
+{
+    //Arrange
+    MODULE_HANDLE module = JavaModuleHost_Create((BROKER_HANDLE)0x42, &config);
+    umock_c_reset_all_calls();
+
+    jobjectArray serialized_messages = (jobjectArray)0x42;
+    jlong broker_address = (jlong)0x42;
+    BROKER_HANDLE broker = (BROKER_HANDLE)broker_address;
+
+    STRICT_EXPECTED_CALL(GetArrayLength(global_env, serialized_messages))
+        .SetReturn(2);
+    STRICT_EXPECTED_CALL(GetObjectArrayElement(global_env, serialized_messages, 0))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(ExceptionClear(global_env));
+    STRICT_EXPECTED_CALL(GetObjectArrayElement(global_env, serialized_messages, 1));
+    STRICT_EXPECTED_CALL(GetDirectBufferAddress(global_env, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(GetDirectBufferCapacity(global_env, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(Message_CreateFromByteArray(IGNORED_PTR_ARG, 16))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Broker_Publish(broker, module, IGNORED_PTR_ARG))
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(Message_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(DeleteLocalRef(global_env, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+
+    //Act
+    jint result = Java_com_microsoft_azure_gateway_core_LocalBroker_publishMessageBuffers(global_env, (jobject)0x42, broker_address, (jlong)module, serialized_messages);
+
+    //Assert
+    ASSERT_ARE_NOT_EQUAL(int32_t, JNI_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //Cleanup
+    JavaModuleHost_Destroy(module);
+}
+
+/*Tests_SRS_JAVA_MODULE_HOST_17_016: [ This function shall return a non-zero value if serialized_messages is NULL or empty. ]*/
+TEST_FUNCTION(Java_com_microsoft_azure_gateway_core_LocalBroker_publishMessageBuffers_empty_fails)
+{
+    //Arrange
+    MODULE_HANDLE module = JavaModuleHost_Create((BROKER_HANDLE)0x42, &config);
+    umock_c_reset_all_calls();
+
+    jobjectArray serialized_messages = (jobjectArray)0x42;
+
+    STRICT_EXPECTED_CALL(GetArrayLength(global_env, serialized_messages))
+        .SetReturn(0);
+
+    //Act
+    jint result = Java_com_microsoft_azure_gateway_core_LocalBroker_publishMessageBuffers(global_env, (jobject)0x42, (jlong)0x42, (jlong)module, serialized_messages);
+    jint null_result = Java_com_microsoft_azure_gateway_core_LocalBroker_publishMessageBuffers(global_env, (jobject)0x42, (jlong)0x42, (jlong)module, NULL);
+
+    //Assert
+    ASSERT_ARE_NOT_EQUAL(int32_t, JNI_OK, result);
+    ASSERT_ARE_NOT_EQUAL(int32_t, JNI_OK, null_result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //Cleanup
+    JavaModuleHost_Destroy(module);
+}
+
 /*Tests_SRS_JAVA_MODULE_HOST_26_001: [ `Module_GetApi` shall fill out the provided `MODULES_API` structure with required module's APIs functions. ] */
 TEST_FUNCTION(Module_GetApi_returns_non_NULL)
 {
@@ -3483,4 +4070,21 @@ TEST_FUNCTION(Module_GetApi_returns_non_NULL)
     ASSERT_IS_NOT_NULL(MODULE_START(apis));
 }
 
+/*Tests_SRS_JAVA_MODULE_HOST_17_011: [ Module_GetApi shall return the MODULE_API_2 table, which adds Module_ReceiveBatch, if gateway_api_version is MODULE_API_VERSION_2 or later, and the MODULE_API_1 table otherwise. ]*/
+TEST_FUNCTION(Module_GetApi_returns_ReceiveBatch_for_version_2)
+{
+    //Arrange
+
+    //Act
+    const MODULE_API* apis_1 = Module_GetApi(MODULE_API_VERSION_1);
+    const MODULE_API* apis_2 = Module_GetApi(MODULE_API_VERSION_2);
+
+    //Assert
+    ASSERT_ARE_EQUAL(int, (int)MODULE_API_VERSION_1, (int)apis_1->version);
+    ASSERT_IS_NULL(MODULE_RECEIVE_BATCH(apis_1));
+    ASSERT_ARE_EQUAL(int, (int)MODULE_API_VERSION_2, (int)apis_2->version);
+    ASSERT_IS_NOT_NULL(MODULE_RECEIVE(apis_2));
+    ASSERT_IS_NOT_NULL(MODULE_RECEIVE_BATCH(apis_2));
+}
+
 END_TEST_SUITE(JavaModuleHost_UnitTests);
@@ -0,0 +1,114 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef NODEJS_MESSAGE_QUEUE_H
+#define NODEJS_MESSAGE_QUEUE_H
+
+#include <atomic>
+#include <new>
+
+#include "azure_c_shared_utility/xlogging.h"
+#include "message.h"
+
+namespace nodejs_module
+{
+    /**
+     * Lock-free, multiple producer queue of messages. Gateway threads push
+     * messages; Node's event thread takes everything queued so far in one
+     * go. Taking is an atomic exchange so it is safe from any thread, and
+     * batches taken concurrently never overlap.
+     */
+    class MessageQueue
+    {
+    private:
+        struct Node
+        {
+            MESSAGE_HANDLE message;
+            Node* next;
+        };
+
+        /**
+         * Most recently pushed node; the list runs from newest to oldest.
+         */
+        std::atomic<Node*> m_head;
+
+    public:
+        MessageQueue() : m_head(nullptr)
+        {}
+
+        /**
+         * Destroys the messages nobody took.
+         */
+        ~MessageQueue()
+        {
+            Drain([](MESSAGE_HANDLE message) {
+                Message_Destroy(message);
+            });
+        }
+
+        MessageQueue(const MessageQueue&) = delete;
+        MessageQueue& operator=(const MessageQueue&) = delete;
+
+        /**
+         * Queues 'message', taking ownership of it on success. 'was_empty'
+         * is set to true when the queue had nothing in it, in which case the
+         * caller is the one who has to schedule a drain.
+         */
+        bool Push(MESSAGE_HANDLE message, bool* was_empty)
+        {
+            bool result;
+            Node* node = new (std::nothrow) Node;
+            if (node == nullptr)
+            {
+                LogError("Could not allocate queue node");
+                result = false;
+            }
+            else
+            {
+                node->message = message;
+                node->next = m_head.load(std::memory_order_relaxed);
+                while (m_head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed) == false)
+                {
+                    // node->next was refreshed with the current head, retry
+                }
+
+                *was_empty = (node->next == nullptr);
+                result = true;
+            }
+
+            return result;
+        }
+
+        /**
+         * Takes every queued message and hands them to 'callback', oldest
+         * first. 'callback' must look like this:
+         *      [](MESSAGE_HANDLE){}
+         * and owns the message it is given.
+         */
+        template <typename TCallback>
+        void Drain(TCallback callback)
+        {
+            Node* newest = m_head.exchange(nullptr, std::memory_order_acquire);
+
+            // reverse the list in place to get back the order of the pushes
+            Node* oldest = nullptr;
+            while (newest != nullptr)
+            {
+                Node* next = newest->next;
+                newest->next = oldest;
+                oldest = newest;
+                newest = next;
+            }
+
+            while (oldest != nullptr)
+            {
+                Node* next = oldest->next;
+                callback(oldest->message);
+                delete oldest;
+                oldest = next;
+            }
+        }
+    };
+};
+
+#endif // NODEJS_MESSAGE_QUEUE_H
@@ -5,6 +5,7 @@
 #define NODEJS_COMMON_H
 
 #include <future>
+#include <map>
 #include <string>
 #include <utility>
 
@@ -19,6 +20,7 @@
 
 #include "broker.h"
 #include "lock.h"
+#include "message_queue.h"
 
 struct NODEJS_MODULE_HANDLE_DATA;
 
@@ -148,6 +150,22 @@ struct NODEJS_MODULE_HANDLE_DATA
      *          class will NOT survive a copy or move operation.
      */
     std::promise<NodeModuleState> create_complete;
+
+    /*
+     * Messages waiting to be handed to the JS module. Like the promise
+     * above, the queue is NOT carried over by a copy or move; copies only
+     * happen while the module is being created, before anything is queued.
+     */
+    nodejs_module::MessageQueue receive_queue;
+
+    /*
+     * Property keys interned as persistent v8 strings, only touched on
+     * Node's thread. Not carried over by a copy or move either. Copyable
+     * persistent handles are not reset by their destructor, so on_quit_node
+     * resets every entry on Node's thread, while the isolate that owns them
+     * is still alive, before the module is removed.
+     */
+    std::map<std::string, v8::Persistent<v8::String, v8::CopyablePersistentTraits<v8::String>>> interned_strings;
 };
 
 #endif /*NODEJS_COMMON_H*/
@@ -2,6 +2,7 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <chrono>
+#include <cstdint>
 #include <cstdbool>
 #include <cstdlib>
 #include <cstddef>
@@ -70,6 +71,10 @@ void call_start_on_module(NODEJS_MODULE_HANDLE_DATA* handle_data);
 
 static const size_t NODE_LOAD_TIMEOUT_S = 10;
 
+// bounds the cache of interned property keys, should a module see
+// arbitrary keys
+static const size_t MAX_INTERNED_STRINGS = 256;
+
 static MODULE_HANDLE NODEJS_Create(BROKER_HANDLE broker, const void* configuration)
 {
     MODULE_HANDLE result;
@@ -972,9 +977,51 @@ static v8::Local<v8::Uint8Array> copy_contents_to_object(
     return v8::Uint8Array::New(array_buffer, 0, content->size);
 }
 
+static v8::Local<v8::String> get_interned_string(
+    v8::Isolate* isolate,
+    NODEJS_MODULE_HANDLE_DATA& handle_data,
+    const char* str
+)
+{
+    // Node may be restarted with a new isolate once every module is gone, so
+    // the cache lives with the module rather than with the process; it is
+    // only used on Node's event thread and needs no lock.
+    auto& interned_strings = handle_data.interned_strings;
+    v8::Local<v8::String> result;
+
+    auto entry = interned_strings.find(str);
+    if (entry != interned_strings.end())
+    {
+        result = entry->second.Get(isolate);
+    }
+    else
+    {
+        result = v8::String::NewFromUtf8(isolate, str, v8::String::kInternalizedString);
+        if (result.IsEmpty() == true)
+        {
+            LogError("Could not instantiate v8 string for '%s'", str);
+        }
+        else if (interned_strings.size() < MAX_INTERNED_STRINGS)
+        {
+            try
+            {
+                interned_strings[str].Reset(isolate, result);
+            }
+            catch (std::bad_alloc& err)
+            {
+                // not cached, still usable
+                LogError("Could not cache v8 string for '%s': %s", str, err.what());
+            }
+        }
+    }
+
+    return result;
+}
+
 static v8::Local<v8::Object> copy_properties_to_object(
     v8::Isolate* isolate,
     v8::Local<v8::Context> context,
+    NODEJS_MODULE_HANDLE_DATA& handle_data,
     CONSTMAP_HANDLE message_properties
 )
 {
@@ -994,7 +1041,8 @@ static v8::Local<v8::Object> copy_properties_to_object(
             size_t i = 0;
             for (; i < count; i++)
             {
-                auto prop_key = v8::String::NewFromUtf8(isolate, keys[i]);
+                /*Codes_SRS_NODEJS_17_003: [ NodeJS_Receive shall intern the property keys as persistent v8 strings owned by the module and reuse them for subsequent messages to that module. ]*/
+                auto prop_key = get_interned_string(isolate, handle_data, keys[i]);
                 if (prop_key.IsEmpty() == true)
                 {
                     LogError("Could not instantiate v8 string for property key '%s'", keys[i]);
@@ -1032,115 +1080,247 @@ static v8::Local<v8::Object> copy_properties_to_object(
     return result;
 }
 
-static void on_run_receive_message(
+static v8::Local<v8::Object> create_js_message(
     v8::Isolate* isolate,
     v8::Local<v8::Context> context,
-    MODULE_HANDLE module,
+    NODEJS_MODULE_HANDLE_DATA& handle_data,
     MESSAGE_HANDLE message
 )
 {
-    NODEJS_MODULE_HANDLE_DATA* handle_data = reinterpret_cast<NODEJS_MODULE_HANDLE_DATA*>(module);
-    if (handle_data->module_object.IsEmpty() == true)
+    /*Codes_SRS_NODEJS_13_022: [ NodeJS_Receive shall construct an instance of the Message interface as defined below:
+        interface StringMap {
+            [key: string]: string;
+        }
+
+        interface Message {
+            properties: StringMap;
+            content: Uint8Array;
+        }
+    */
+
+    // convert the message properties into a JS object
+    auto js_props = copy_properties_to_object(
+        isolate,
+        context,
+        handle_data,
+        Message_GetProperties(message)
+    );
+
+    // convert the contents into a JS Uint8Array
+    v8::Local<v8::Uint8Array> js_contents;
+    auto content = Message_GetContent(message);
+    if (content != nullptr && content->buffer != nullptr && content->size > 0)
+    {
+        js_contents = copy_contents_to_object(isolate, context, content);
+    }
+
+    // create a JS object with 'properties' and 'content'
+    v8::Local<v8::Object> js_message = v8::Object::New(isolate);
+    if (js_message.IsEmpty())
     {
-        LogError("Module does not have a JS counterpart object - %s.", handle_data->main_path.c_str());
+        LogError("Could not create JS object for storing the message");
     }
     else
     {
-        /*Codes_SRS_NODEJS_13_022: [ NodeJS_Receive shall construct an instance of the Message interface as defined below:
-            interface StringMap {
-                [key: string]: string;
+        if (js_props.IsEmpty() == false)
+        {
+            auto prop_key = get_interned_string(isolate, handle_data, "properties");
+            if (prop_key.IsEmpty() == true)
+            {
+                LogError("Could not instantiate v8 string for constant 'properties'");
             }
+            else
+            {
+                auto status = js_message->CreateDataProperty(context, prop_key, js_props);
+                if (status.FromMaybe(false) == false)
+                {
+                    LogError("Could not add 'properties' property to JS message object");
+                }
+            }
+        }
 
-            interface Message {
-                properties: StringMap;
-                content: Uint8Array;
+        if (js_contents.IsEmpty() == false)
+        {
+            auto prop_key = get_interned_string(isolate, handle_data, "content");
+            if (prop_key.IsEmpty() == true)
+            {
+                LogError("Could not instantiate v8 string for constant 'content'");
             }
-        */
+            else
+            {
+                auto status = js_message->CreateDataProperty(context, prop_key, js_contents);
+                if (status.FromMaybe(false) == false)
+                {
+                    LogError("Could not add 'content' property to JS message object");
+                }
+            }
+        }
+    }
+
+    return js_message;
+}
+
+static v8::Local<v8::Function> get_module_method(
+    v8::Isolate* isolate,
+    v8::Local<v8::Context> context,
+    NODEJS_MODULE_HANDLE_DATA& handle_data,
+    v8::Local<v8::Object> gateway,
+    const char* method_name
+)
+{
+    v8::Local<v8::Function> result;
+
+    auto prop_key = get_interned_string(isolate, handle_data, method_name);
+    if (prop_key.IsEmpty() == true)
+    {
+        LogError("Could not instantiate v8 string for constant '%s'", method_name);
+    }
+    else
+    {
+        v8::Local<v8::Value> method;
+        if (gateway->Get(context, prop_key).ToLocal(&method) == true && method->IsFunction() == true)
+        {
+            result = method.As<v8::Function>();
+        }
+    }
+
+    return result;
+}
+
+static void receive_messages_one_by_one(
+    v8::Isolate* isolate,
+    v8::Local<v8::Context> context,
+    v8::Local<v8::Object> gateway,
+    v8::Local<v8::Function> receive_fn,
+    NODEJS_MODULE_HANDLE_DATA& handle_data
+)
+{
+    handle_data.receive_queue.Drain([isolate, context, gateway, receive_fn, &handle_data](MESSAGE_HANDLE message) {
+        // keep the handles of one message from piling up over the batch
+        v8::HandleScope message_scope(isolate);
 
-        // convert the message properties into a JS object
-        auto js_props = copy_properties_to_object(
-            isolate,
-            context,
-            Message_GetProperties(message)
-        );
-
-        // convert the contents into a JS Uint8Array
-        v8::Local<v8::Uint8Array> js_contents;
-        auto content = Message_GetContent(message);
-        if (content != nullptr && content->buffer != nullptr && content->size > 0)
+        auto js_message = create_js_message(isolate, context, handle_data, message);
+        if (js_message.IsEmpty() == false)
         {
-            js_contents = copy_contents_to_object(isolate, context, content);
+            /*Codes_SRS_NODEJS_13_023: [ NodeJS_Receive shall invoke GatewayModule.receive passing the newly constructed Message instance. ]*/
+            v8::Local<v8::Value> args[] = { js_message };
+            receive_fn->Call(gateway, 1, args);
         }
 
-        // create a JS object with 'properties' and 'content'
-        v8::Local<v8::Object> js_message = v8::Object::New(isolate);
-        if (js_message.IsEmpty())
+        Message_Destroy(message);
+    });
+}
+
+static void receive_messages_as_batch(
+    v8::Isolate* isolate,
+    v8::Local<v8::Context> context,
+    v8::Local<v8::Object> gateway,
+    v8::Local<v8::Function> receive_batch_fn,
+    NODEJS_MODULE_HANDLE_DATA& handle_data
+)
+{
+    // the JS messages point into the native content buffers, so the
+    // messages have to outlive the call
+    std::vector<MESSAGE_HANDLE> messages;
+    auto js_messages = v8::Array::New(isolate);
+    if (js_messages.IsEmpty() == true)
+    {
+        LogError("Could not create JS array for storing the messages");
+    }
+
+    handle_data.receive_queue.Drain([isolate, context, &js_messages, &messages, &handle_data](MESSAGE_HANDLE message) {
+        if (js_messages.IsEmpty() == true)
         {
-            LogError("Could not create JS object for storing the message");
+            Message_Destroy(message);
         }
         else
         {
-            if (js_props.IsEmpty() == false)
+            try
             {
-                auto prop_key = v8::String::NewFromUtf8(isolate, "properties");
-                if (prop_key.IsEmpty() == true)
-                {
-                    LogError("Could not instantiate v8 string for constant 'properties'");
-                }
-                else
-                {
-                    auto status = js_message->CreateDataProperty(context, prop_key, js_props);
-                    if (status.FromMaybe(false) == false)
-                    {
-                        LogError("Could not add 'properties' property to JS message object");
-                    }
-                }
+                messages.push_back(message);
+            }
+            catch (std::bad_alloc& err)
+            {
+                LogError("Could not keep the message for the batch, dropping it: %s", err.what());
+                Message_Destroy(message);
+                message = nullptr;
             }
 
-            if (js_contents.IsEmpty() == false)
+            if (message != nullptr)
             {
-                auto prop_key = v8::String::NewFromUtf8(isolate, "content");
-                if (prop_key.IsEmpty() == true)
-                {
-                    LogError("Could not instantiate v8 string for constant 'content'");
-                }
-                else
+                auto js_message = create_js_message(isolate, context, handle_data, message);
+                if (js_message.IsEmpty() == true ||
+                    js_messages->Set(context, static_cast<uint32_t>(js_messages->Length()), js_message).FromMaybe(false) == false)
                 {
-                    auto status = js_message->CreateDataProperty(context, prop_key, js_contents);
-                    if (status.FromMaybe(false) == false)
-                    {
-                        LogError("Could not add 'content' property to JS message object");
-                    }
+                    LogError("Could not add a message to the JS batch");
                 }
             }
+        }
+    });
 
-            auto prop_key = v8::String::NewFromUtf8(isolate, "receive");
-            if (prop_key.IsEmpty() == true)
+    if (js_messages.IsEmpty() == false && js_messages->Length() > 0)
+    {
+        /*Codes_SRS_NODEJS_17_005: [ If the module defines GatewayModule.receiveBatch, NodeJS_Receive shall invoke it once per drain, passing an array of the newly constructed Message instances in the order they were received. ]*/
+        v8::Local<v8::Value> args[] = { js_messages };
+        receive_batch_fn->Call(gateway, 1, args);
+    }
+
+    for (auto message : messages)
+    {
+        Message_Destroy(message);
+    }
+}
+
+static void on_run_receive_messages(
+    v8::Isolate* isolate,
+    v8::Local<v8::Context> context,
+    size_t module_id
+)
+{
+    auto modules_manager = nodejs_module::ModulesManager::Get();
+    if (modules_manager->HasModule(module_id) == false)
+    {
+        // whatever was queued went away with the module
+        LogError("Module is gone, nothing to receive.");
+    }
+    else
+    {
+        auto& handle_data = modules_manager->GetModuleFromId(module_id);
+        if (handle_data.module_object.IsEmpty() == true)
+        {
+            LogError("Module does not have a JS counterpart object - %s.", handle_data.main_path.c_str());
+            handle_data.receive_queue.Drain([](MESSAGE_HANDLE message) {
+                Message_Destroy(message);
+            });
+        }
+        else
+        {
+            /*Codes_SRS_NODEJS_17_004: [ NodeJS_Receive shall take every queued message at once when the drain runs, within a single Node.js context scope. ]*/
+            auto gateway = handle_data.module_object.Get(isolate);
+            auto receive_batch_fn = get_module_method(isolate, context, handle_data, gateway, "receiveBatch");
+            if (receive_batch_fn.IsEmpty() == false)
             {
-                LogError("Could not instantiate v8 string for constant 'receive'");
+                receive_messages_as_batch(isolate, context, gateway, receive_batch_fn, handle_data);
             }
             else
             {
-                // invoke 'receive' method on gateway; we know this member
-                // exists on the gateway
-                auto gateway = handle_data->module_object.Get(isolate);
-                v8::Local<v8::Value> receive_method;
-                if (gateway->Get(context, prop_key).ToLocal(&receive_method) == false || receive_method->IsFunction() == false)
+                // we know 'receive' exists on the gateway, registerModule checked it
+                auto receive_fn = get_module_method(isolate, context, handle_data, gateway, "receive");
+                if (receive_fn.IsEmpty() == true)
                 {
                     LogError("'receive' property on the gateway has an unexpected value");
+                    handle_data.receive_queue.Drain([](MESSAGE_HANDLE message) {
+                        Message_Destroy(message);
+                    });
                 }
                 else
                 {
-                    /*Codes_SRS_NODEJS_13_023: [ NodeJS_Receive shall invoke GatewayModule.receive passing the newly constructed Message instance. ]*/
-                    auto receive_fn = receive_method.As<v8::Function>();
-                    v8::Local<v8::Value> args[] = { js_message };
-                    receive_fn->Call(gateway, 1, args);
+                    /*Codes_SRS_NODEJS_17_006: [ Otherwise NodeJS_Receive shall invoke GatewayModule.receive once for each queued message, in the order they were received. ]*/
+                    receive_messages_one_by_one(isolate, context, gateway, receive_fn, handle_data);
                 }
             }
         }
     }
-
-    Message_Destroy(message);
 }
 
 void NODEJS_Receive(MODULE_HANDLE module, MESSAGE_HANDLE message)
@@ -1163,15 +1343,37 @@ void NODEJS_Receive(MODULE_HANDLE module, MESSAGE_HANDLE message)
         }
         else
         {
-            // inc ref the message handle
-            message = Message_Clone(message);
+            bool was_empty;
 
-            // run on node's event thread
-            nodejs_module::NodeJSIdle::Get()->AddCallback([module, message]() {
-                nodejs_module::NodeJSUtils::RunWithNodeContext([module, message](v8::Isolate* isolate, v8::Local<v8::Context> context) {
-                    on_run_receive_message(isolate, context, module, message);
+            // inc ref the message handle
+            MESSAGE_HANDLE queued_message = Message_Clone(message);
+            if (queued_message == nullptr)
+            {
+                LogError("Message_Clone failed");
+            }
+            /*Codes_SRS_NODEJS_17_001: [ NodeJS_Receive shall clone the message and push it on the module's lock-free receive queue. ]*/
+            else if (handle_data->receive_queue.Push(queued_message, &was_empty) == false)
+            {
+                LogError("Could not queue the message");
+                Message_Destroy(queued_message);
+            }
+            else if (was_empty == true)
+            {
+                /*Codes_SRS_NODEJS_13_038: [ NodeJS_Receive shall schedule a callback to be invoked on Node.js's event loop. ]*/
+                /*Codes_SRS_NODEJS_17_002: [ NodeJS_Receive shall schedule the callback only when the queue was empty, messages pushed before the callback runs are taken by the same callback. ]*/
+                auto module_id = handle_data->module_id;
+
+                // run on node's event thread
+                nodejs_module::NodeJSIdle::Get()->AddCallback([module_id]() {
+                    nodejs_module::NodeJSUtils::RunWithNodeContext([module_id](v8::Isolate* isolate, v8::Local<v8::Context> context) {
+                        on_run_receive_messages(isolate, context, module_id);
+                    });
                 });
-            });
+            }
+            else
+            {
+                // a drain is already scheduled and will pick this one up
+            }
         }
     }
 }
@@ -1226,6 +1428,15 @@ static void on_quit_node(
             }
         }
 
+        /*Codes_SRS_NODEJS_17_007: [ NodeJS_Destroy shall reset the module's interned property keys on Node.js's event thread before removing the module. ]*/
+        // copyable persistent handles are not reset by their destructor, and
+        // only this thread may touch them while the isolate is alive
+        for (auto& interned_string : handle_data.interned_strings)
+        {
+            interned_string.second.Reset();
+        }
+        handle_data.interned_strings.clear();
+
         try
         {
             /*Codes_SRS_NODEJS_13_025: [ NodeJS_Destroy shall free all resources. ]*/
@@ -0,0 +1,55 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       base64_encoder.h
+ *  @brief      Encodes message content as Base64 straight into a buffer the
+ *              caller already sized.
+ *
+ *  @details    Modules that put the content of a message in a JSON document
+ *              can size the whole document up front with
+ *              #Base64Encoder_GetEncodedSize and encode the content in place,
+ *              instead of encoding it into a STRING_HANDLE and appending that.
+ *              The encoder handles 12 input bytes at a time with SSSE3 on x86
+ *              and 48 at a time with NEON on AArch64, and falls back to plain
+ *              C elsewhere. The output is the standard alphabet of RFC 4648
+ *              with padding, the same as Base64_Encode_Bytes.
+ */
+
+#ifndef BASE64_ENCODER_H
+#define BASE64_ENCODER_H
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C"
+{
+#else
+#include <stddef.h>
+#endif
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#include "gateway_export.h"
+
+/** @brief      Gets the number of characters #Base64Encoder_Encode writes for
+ *              @c size bytes, which does not count a terminating '\0'.
+ *
+ *  @return     The size of the encoding, or 0 if it does not fit a size_t.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT size_t, Base64Encoder_GetEncodedSize, size_t, size);
+
+/** @brief      Encodes @c size bytes of @c source as Base64.
+ *
+ *  @param      source          The bytes to encode, can be NULL if @c size is 0.
+ *  @param      size            The number of bytes to encode.
+ *  @param      destination     At least #Base64Encoder_GetEncodedSize(size)
+ *                              characters. No '\0' is written.
+ *
+ *  @return     The number of characters written.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT size_t, Base64Encoder_Encode, const unsigned char*, source, size_t, size, char*, destination);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*BASE64_ENCODER_H*/
@@ -28,6 +28,7 @@ extern "C"
 {
 #else
 #include <stddef.h>
+#include <stdbool.h>
 #endif
 
 /** @brief    Link Data with #MODULE_HANDLE for source and sink. 
@@ -53,12 +54,56 @@ typedef struct BROKER_LINK_DATA_TAG {
 */
 DEFINE_ENUM(BROKER_RESULT, BROKER_RESULT_VALUES);
 
+#define BROKER_QUEUE_POLICY_VALUES \
+    BROKER_QUEUE_POLICY_DROP_OLDEST, \
+    BROKER_QUEUE_POLICY_DROP_NEWEST, \
+    BROKER_QUEUE_POLICY_BLOCK
+
+/** @brief    Enumeration describing what ::Broker_Publish does when the
+*            bounded queue of a module is full: discard the oldest queued
+*            message, discard the message being published, or wait until
+*            the module has taken a message off its queue.
+*/
+DEFINE_ENUM(BROKER_QUEUE_POLICY, BROKER_QUEUE_POLICY_VALUES);
+
+/** @brief    Configuration of the queue holding the messages waiting to be
+*            delivered to a module.
+*/
+typedef struct BROKER_QUEUE_CONFIG_TAG {
+    /** @brief    Maximum number of queued messages, 0 for an unbounded queue.
+    */
+    size_t capacity;
+    /** @brief    What to do with a new message when the queue is full.
+    */
+    BROKER_QUEUE_POLICY policy;
+    /** @brief    When true the module's messages are delivered on a thread of
+    *            its own even if the broker has a thread pool.
+    */
+    bool dedicated_thread;
+} BROKER_QUEUE_CONFIG;
+
 /** @brief        Creates a new message broker.
 *   
 *    @return        A valid #BROKER_HANDLE upon success, or @c NULL upon failure.
 */
 GATEWAY_EXPORT BROKER_HANDLE Broker_Create(void);
 
+/** @brief        Creates a new message broker that delivers messages to its
+*                modules from a fixed pool of threads.
+*
+*    @details    A module attached to this broker does not get a thread of its
+*                own unless it asks for one in its #BROKER_QUEUE_CONFIG or its
+*                queue uses #BROKER_QUEUE_POLICY_BLOCK. Each module still
+*                receives its messages in order and one at a time.
+*
+*    @param        thread_count    Number of threads in the pool. When 0 every
+*                                module gets its own thread, as with
+*                                ::Broker_Create.
+*
+*    @return        A valid #BROKER_HANDLE upon success, or @c NULL upon failure.
+*/
+GATEWAY_EXPORT BROKER_HANDLE Broker_CreateWithThreadPool(size_t thread_count);
+
 /** @brief        Increments the reference count of a message broker.
 *
 *    @details    This function will simply increment the internal reference
@@ -111,6 +156,34 @@ GATEWAY_EXPORT BROKER_RESULT Broker_Publish(BROKER_HANDLE broker, MODULE_HANDLE
 */
 GATEWAY_EXPORT BROKER_RESULT Broker_AddModule(BROKER_HANDLE broker, const MODULE* module);
 
+/** @brief        Adds a module to the message broker, queueing the messages
+*                for the module as described by @c queue_config.
+*
+*    @details    ::Broker_AddModule is equivalent to calling this function
+*                with an unbounded queue.
+*
+*    @param        broker          The #BROKER_HANDLE onto which the module will be
+*                                added.
+*    @param        module            The #MODULE for the module that will be added
+*                                to this message broker.
+*    @param        queue_config    The #BROKER_QUEUE_CONFIG of the module's queue.
+*                                (optional, may be NULL for an unbounded queue)
+*
+*    @return        A #BROKER_RESULT describing the result of the function.
+*/
+GATEWAY_EXPORT BROKER_RESULT Broker_AddModuleWithQueue(BROKER_HANDLE broker, const MODULE* module, const BROKER_QUEUE_CONFIG* queue_config);
+
+/** @brief        Gets the number of messages the broker discarded because the
+*                queue of a module was full.
+*
+*    @param        broker              The #BROKER_HANDLE the module is attached to.
+*    @param        module              The #MODULE of the module.
+*    @param        dropped_messages    Receives the number of discarded messages.
+*
+*    @return        A #BROKER_RESULT describing the result of the function.
+*/
+GATEWAY_EXPORT BROKER_RESULT Broker_GetDroppedMessageCount(BROKER_HANDLE broker, const MODULE* module, size_t* dropped_messages);
+
 /** @brief        Removes a module from the message broker.
 *   
 *    @param        broker    The #BROKER_HANDLE from which the module will be removed.
@@ -18,6 +18,7 @@
 
 #include "module.h"
 #include "module_loader.h"
+#include "broker.h"
 #include "gateway_export.h"
 
 #ifdef __cplusplus
@@ -97,11 +98,22 @@ typedef struct GATEWAY_MODULES_ENTRY_TAG
 
     /** @brief  The user-defined configuration object for the module */
     const void* module_configuration;
+
+    /** @brief  The queue of messages waiting to be delivered to the module;
+     *          a zero capacity leaves the queue unbounded, and
+     *          @c dedicated_thread keeps the module off the scheduler's
+     *          threads */
+    BROKER_QUEUE_CONFIG queue_configuration;
 } GATEWAY_MODULES_ENTRY;
 
 /** @brief      Struct representing the properties that should be used when
  *              creating a module; each entry of the @c VECTOR_HANDLE being a
  *              #GATEWAY_MODULES_ENTRY.
+ *
+ *  @details    Hosts that fill this struct by hand rather than through
+ *              #Gateway_CreateFromJson must set every field, including
+ *              @c scheduler_threads; zero-initializing the struct keeps the
+ *              thread per module behavior of earlier releases.
  */
 typedef struct GATEWAY_PROPERTIES_DATA_TAG
 {
@@ -110,6 +122,10 @@ typedef struct GATEWAY_PROPERTIES_DATA_TAG
 
     /** @brief  Vector of #GATEWAY_LINK_ENTRY objects. */
     VECTOR_HANDLE gateway_links;
+
+    /** @brief  Number of threads shared by the modules for receiving
+     *          messages; 0 gives every module a thread of its own. */
+    size_t scheduler_threads;
 } GATEWAY_PROPERTIES;
 
 /** @brief      Creates a gateway using a JSON configuration file as input
@@ -147,9 +163,17 @@ typedef struct GATEWAY_PROPERTIES_DATA_TAG
                             },
                             "args": {
                                 "filename": "/var/logs/gateway-log.json"
-                            }
+                            },
+                            "queue": {
+                                "capacity": 1000,
+                                "policy": "drop_oldest"
+                            },
+                            "dedicated_thread": true
                         }
  *                  ],
+ *                  "scheduler": {
+ *                      "threads": 4
+ *                  },
  *                  "links":
  *                  [
  *                      {
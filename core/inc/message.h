@@ -87,16 +87,69 @@ typedef struct MESSAGE_BUFFER_CONFIG_TAG
     MAP_HANDLE sourceProperties;
 }MESSAGE_BUFFER_CONFIG;
 
+/** @brief      Function called by a message to release the content it adopted
+ *              through #Message_CreateWithOwnership.
+ *
+ *  @param      context     The @c deallocatorContext of the
+ *                          #MESSAGE_OWNERSHIP_CONFIG.
+ *  @param      buffer      The @c source of the #MESSAGE_OWNERSHIP_CONFIG.
+ *  @param      size        The @c size of the #MESSAGE_OWNERSHIP_CONFIG.
+ */
+typedef void(*MESSAGE_CONTENT_DEALLOCATOR)(void* context, unsigned char* buffer, size_t size);
+
+/** @brief  Struct defining the configuration of a message that takes
+ *          ownership of its content instead of copying it.
+ */
+typedef struct MESSAGE_OWNERSHIP_CONFIG_TAG
+{
+    /** @brief  Specifies the size of the buffer pointed at by @c source. */
+    size_t size;
+
+    /** @brief  Pointer to the buffer that will become the content of this
+     *          message. This field must not be @c NULL.
+     */
+    unsigned char* source;
+
+    /** @brief  Function that the message calls to release @c source once
+     *          the message is destroyed. This field must not be @c NULL.
+     */
+    MESSAGE_CONTENT_DEALLOCATOR deallocator;
+
+    /** @brief  Pointer passed as-is to @c deallocator. */
+    void* deallocatorContext;
+
+    /** @brief  A collection of key/value pairs where both the key and value
+     *          are strings representing the properties of this message. This
+     *          field must not be @c NULL.
+     */
+    MAP_HANDLE sourceProperties;
+}MESSAGE_OWNERSHIP_CONFIG;
+
+/** @brief  Struct defining a change made to the properties of a message by
+ *          #Message_CreateDerived.
+ */
+typedef struct MESSAGE_PROPERTY_EDIT_TAG
+{
+    /** @brief  Name of the property to add, replace or remove. This field
+     *          must not be @c NULL.
+     */
+    const char* name;
+
+    /** @brief  New value of the property, or @c NULL to remove it. */
+    const char* value;
+}MESSAGE_PROPERTY_EDIT;
+
 #include "azure_c_shared_utility/umock_c_prod.h"
 
 /** @brief      Creates a new reference counted message from a #MESSAGE_CONFIG
  *              structure with the reference count initialized to 1.
  *
- *  @details    This function will create its own @c CONSTBUFFER and
- *              @c ConstMap with copies of the @c source and
- *              @c sourceProperties contained within the #MESSAGE_CONFIG
- *              structure parameter. It is the responsibility of the Message
- *              to dispose of these resources.
+ *  @details    This function will copy the @c source and @c sourceProperties
+ *              contained within the #MESSAGE_CONFIG structure parameter. The
+ *              properties, and the content when it is no bigger than 1024
+ *              bytes, are kept in the same allocation as the message; bigger
+ *              content is copied to its own @c CONSTBUFFER. It is the
+ *              responsibility of the Message to dispose of these resources.
  *
  *  @param      cfg     Pointer to a #MESSAGE_CONFIG structure.
  *
@@ -153,6 +206,44 @@ MOCKABLE_FUNCTION(, GATEWAY_EXPORT int32_t, Message_ToByteArray, MESSAGE_HANDLE,
  */
 MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_CreateFromBuffer, const MESSAGE_BUFFER_CONFIG *, cfg);
 
+/** @brief      Creates a new message that takes ownership of the content
+ *              described by a #MESSAGE_OWNERSHIP_CONFIG instead of copying it.
+ *
+ *  @details    The properties are copied as #Message_Create does. The content
+ *              is not copied: @c source becomes the content of the message and
+ *              @c deallocator is called with it when the reference count
+ *              drops to zero, from whichever thread destroys the last
+ *              reference. The caller must not modify or free @c source after
+ *              this function succeeds. If this function fails, the caller
+ *              keeps ownership of @c source.
+ *
+ *  @param      cfg     Pointer to a #MESSAGE_OWNERSHIP_CONFIG structure.
+ *
+ *  @return     A non-NULL #MESSAGE_HANDLE for the newly created message, or
+ *              @c NULL upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_CreateWithOwnership, const MESSAGE_OWNERSHIP_CONFIG *, cfg);
+
+/** @brief      Creates a new message with the content of @c message and its
+ *              properties changed by @c edits.
+ *
+ *  @details    The new message shares the content and the unchanged
+ *              properties of @c message, which it keeps a reference to; only
+ *              the added and replaced properties are copied. An edit with a
+ *              @c NULL value removes the property, an edit of a property
+ *              @c message does not have adds it at the end. If several edits
+ *              name the same property, the last one wins. @c message is not
+ *              modified.
+ *
+ *  @param      message     The #MESSAGE_HANDLE the new message derives from.
+ *  @param      edits       Array of #MESSAGE_PROPERTY_EDIT.
+ *  @param      editCount   Number of elements in @c edits.
+ *
+ *  @return     A non-NULL #MESSAGE_HANDLE for the newly created message, or
+ *              @c NULL upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_CreateDerived, MESSAGE_HANDLE, message, const MESSAGE_PROPERTY_EDIT*, edits, size_t, editCount);
+
 /** @brief      Creates a clone of the message.
  *
  *  @details    Since messages are immutable, this function only increments the 
@@ -179,6 +270,22 @@ MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_Clone, MESSAGE_HANDLE
  */
 MOCKABLE_FUNCTION(, GATEWAY_EXPORT CONSTMAP_HANDLE, Message_GetProperties, MESSAGE_HANDLE, message);
 
+/** @brief      Gets the value of a single property of a message.
+ *
+ *  @details    Messages keep their properties serialized; this function reads
+ *              them in place without building the @c CONSTMAP returned by
+ *              #Message_GetProperties. The returned string is owned by the
+ *              message and is valid for as long as the message is.
+ *
+ *  @param      message     The #MESSAGE_HANDLE from which the property will
+ *                          be fetched.
+ *  @param      name        The name of the property.
+ *
+ *  @return     The value of the property, or @c NULL if the message has no
+ *              such property or upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT const char*, Message_GetProperty, MESSAGE_HANDLE, message, const char*, name);
+
 /** @brief      Gets the content of a message.
  *
  *  @details    The returned @c CONSTBUFFER need not be freed by the caller.
@@ -204,6 +311,22 @@ MOCKABLE_FUNCTION(, GATEWAY_EXPORT const CONSTBUFFER *, Message_GetContent, MESS
  */
 MOCKABLE_FUNCTION(, GATEWAY_EXPORT CONSTBUFFER_HANDLE, Message_GetContentHandle, MESSAGE_HANDLE, message);
 
+/** @brief      Gets the message serialized in the same format as
+ *              #Message_ToByteArray.
+ *
+ *  @details    The message is serialized the first time it is asked for and
+ *              the result is kept until the message is destroyed, so sending
+ *              one message to several remote modules serializes it once. The
+ *              returned @c CONSTBUFFER need not be freed by the caller and is
+ *              valid for as long as the caller holds the message.
+ *
+ *  @param      message     The #MESSAGE_HANDLE to serialize.
+ *
+ *  @return     A non-NULL pointer to a @c CONSTBUFFER holding the serialized
+ *              message, or @c NULL upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT const CONSTBUFFER *, Message_GetSerialized, MESSAGE_HANDLE, message);
+
 /** @brief      Disposes of resources allocated by the message.
  *       
  *  @param      message     The #MESSAGE_HANDLE to be destroyed.
@@ -23,6 +23,7 @@ typedef struct MESSAGE_QUEUE_TAG* MESSAGE_QUEUE_HANDLE;
 
 /* creation */
 MOCKABLE_FUNCTION(, MESSAGE_QUEUE_HANDLE, MESSAGE_QUEUE_create);
+MOCKABLE_FUNCTION(, MESSAGE_QUEUE_HANDLE, MESSAGE_QUEUE_create_bounded, size_t, capacity);
 
 /* destruction */
 MOCKABLE_FUNCTION(, void, MESSAGE_QUEUE_destroy, MESSAGE_QUEUE_HANDLE, handle);
@@ -35,6 +36,7 @@ MOCKABLE_FUNCTION(, MESSAGE_HANDLE, MESSAGE_QUEUE_pop, MESSAGE_QUEUE_HANDLE, han
 
 /* access */
 MOCKABLE_FUNCTION(, bool,  MESSAGE_QUEUE_is_empty, MESSAGE_QUEUE_HANDLE, handle);
+MOCKABLE_FUNCTION(, bool,  MESSAGE_QUEUE_is_full, MESSAGE_QUEUE_HANDLE, handle);
 MOCKABLE_FUNCTION(, MESSAGE_HANDLE, MESSAGE_QUEUE_front, MESSAGE_QUEUE_HANDLE, handle);
 
 #ifdef __cplusplus
@@ -107,6 +107,24 @@ extern "C"
      */
     typedef void(*pfModule_Receive)(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHandle);
 
+    /** @brief      Receives several messages from the broker in one call.
+     *
+     *  @details    This function is optional. When it is implemented the
+     *              broker hands over every message that is waiting for the
+     *              module, in the order they were published, instead of
+     *              calling #Module_Receive once per message. As with
+     *              #Module_Receive, the broker destroys the messages when the
+     *              function returns; a module that keeps a message must clone
+     *              it.
+     *
+     *  @param      moduleHandle    The #MODULE_HANDLE of the module receiving
+     *                              the messages.
+     *  @param      messageHandles  The #MESSAGE_HANDLE of each message being
+     *                              sent to the module.
+     *  @param      count           The number of messages, at least 1.
+     */
+    typedef void(*pfModule_ReceiveBatch)(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE* messageHandles, size_t count);
+
     /** @brief      Signals to the module that the broker is ready to send and
      *              receive messages.
      *
@@ -121,11 +139,12 @@ extern "C"
     /** @brief  Module API version. */
     typedef enum MODULE_API_VERSION_TAG
     {
-        MODULE_API_VERSION_1
+        MODULE_API_VERSION_1,
+        MODULE_API_VERSION_2
     } MODULE_API_VERSION;
 
     /** @brief  Current gateway module API version */
-    static const MODULE_API_VERSION Module_ApiGatewayVersion = MODULE_API_VERSION_1;
+    static const MODULE_API_VERSION Module_ApiGatewayVersion = MODULE_API_VERSION_2;
 
     /** @brief  Structure returned by ::Module_GetApi containing the API
      *          version. By convention, the module returns a compound structure 
@@ -171,6 +190,20 @@ extern "C"
         pfModule_Start Module_Start;
     } MODULE_API_1;
 
+    /** @brief  The module interface, version 2. It extends version 1 with
+     *          #Module_ReceiveBatch; v1.base.version shall be
+     *          #MODULE_API_VERSION_2.
+     */
+    typedef struct MODULE_API_2_TAG
+    {
+        /** @brief  The version 1 function table, always the first element */
+        MODULE_API_1 v1;
+
+        /** @brief  Function pointer to the #Module_ReceiveBatch function
+         *          (optional). */
+        pfModule_ReceiveBatch Module_ReceiveBatch;
+    } MODULE_API_2;
+
     /** @brief  This is the only function exported by a module. Using the
      *          exported function, the caller learns the functions for the 
      *          particular module.
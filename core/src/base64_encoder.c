@@ -0,0 +1,204 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "base64_encoder.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "azure_c_shared_utility/xlogging.h"
+
+/*the vector encoders follow "Base64 encoding with SIMD instructions" by Wojciech Mula and Daniel Lemire*/
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define BASE64_ENCODER_NEON
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#define BASE64_ENCODER_SSSE3
+#define BASE64_ENCODER_TARGET_SSSE3
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+/*SSSE3 is not part of the baseline of the build, so it is checked for at run time*/
+#include <tmmintrin.h>
+#define BASE64_ENCODER_SSSE3
+#define BASE64_ENCODER_SSSE3_AT_RUN_TIME
+#define BASE64_ENCODER_TARGET_SSSE3 __attribute__((target("ssse3")))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <tmmintrin.h>
+#define BASE64_ENCODER_SSSE3
+#define BASE64_ENCODER_SSSE3_AT_RUN_TIME
+#define BASE64_ENCODER_TARGET_SSSE3
+#endif
+
+static const char base64_alphabet[64] =
+{
+    'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O', 'P',
+    'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z', 'a', 'b', 'c', 'd', 'e', 'f',
+    'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v',
+    'w', 'x', 'y', 'z', '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '+', '/'
+};
+
+/*encodes whole groups of 3 bytes and the padded tail, returns the number of characters written*/
+static size_t encode_scalar(const unsigned char* source, size_t size, char* destination)
+{
+    char* out = destination;
+    size_t i;
+    for (i = 0; size - i >= 3; i += 3)
+    {
+        uint32_t group = ((uint32_t)source[i] << 16) | ((uint32_t)source[i + 1] << 8) | (uint32_t)source[i + 2];
+        out[0] = base64_alphabet[(group >> 18) & 0x3F];
+        out[1] = base64_alphabet[(group >> 12) & 0x3F];
+        out[2] = base64_alphabet[(group >> 6) & 0x3F];
+        out[3] = base64_alphabet[group & 0x3F];
+        out += 4;
+    }
+
+    if (size - i == 1)
+    {
+        out[0] = base64_alphabet[source[i] >> 2];
+        out[1] = base64_alphabet[(source[i] & 0x03) << 4];
+        out[2] = '=';
+        out[3] = '=';
+        out += 4;
+    }
+    else if (size - i == 2)
+    {
+        out[0] = base64_alphabet[source[i] >> 2];
+        out[1] = base64_alphabet[((source[i] & 0x03) << 4) | (source[i + 1] >> 4)];
+        out[2] = base64_alphabet[(source[i + 1] & 0x0F) << 2];
+        out[3] = '=';
+        out += 4;
+    }
+    return (size_t)(out - destination);
+}
+
+#ifdef BASE64_ENCODER_SSSE3
+
+#ifdef BASE64_ENCODER_SSSE3_AT_RUN_TIME
+static int ssse3_state = -1; /*-1 until checked, then 0 or 1. Racing threads all store the same value*/
+
+static bool has_ssse3(void)
+{
+    if (ssse3_state < 0)
+    {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 1);
+        ssse3_state = ((info[2] & (1 << 9)) != 0) ? 1 : 0;
+#else
+        ssse3_state = __builtin_cpu_supports("ssse3") ? 1 : 0;
+#endif
+    }
+    return ssse3_state == 1;
+}
+#else
+#define has_ssse3() true
+#endif
+
+/*encodes 12 bytes per step out of 16 byte loads, returns the number of bytes encoded, a multiple of 3*/
+BASE64_ENCODER_TARGET_SSSE3
+static size_t encode_ssse3(const unsigned char* source, size_t size, char* destination)
+{
+    size_t done = 0;
+    const __m128i spread = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    const __m128i offsets = _mm_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    while (size - done >= 16)
+    {
+        __m128i in = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(source + done)), spread);
+
+        /*moves the four 6 bit values of each 3 bytes to the four bytes of a 32 bit lane*/
+        __m128i high = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+        __m128i low = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+        __m128i indices = _mm_or_si128(high, low);
+
+        /*0..25 map to offset 13, 26..51 to 0, 52..61 to 1..10, 62 to 11 and 63 to 12*/
+        __m128i ranges = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+        ranges = _mm_or_si128(ranges, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), indices), _mm_set1_epi8(13)));
+        _mm_storeu_si128((__m128i*)(destination + done / 3 * 4), _mm_add_epi8(_mm_shuffle_epi8(offsets, ranges), indices));
+        done += 12;
+    }
+    return done;
+}
+
+#endif /*BASE64_ENCODER_SSSE3*/
+
+#ifdef BASE64_ENCODER_NEON
+
+/*encodes 48 bytes per step, returns the number of bytes encoded, a multiple of 3*/
+static size_t encode_neon(const unsigned char* source, size_t size, char* destination)
+{
+    size_t done = 0;
+    const uint8x16_t mask = vdupq_n_u8(0x3F);
+    uint8x16x4_t alphabet;
+    alphabet.val[0] = vld1q_u8((const uint8_t*)base64_alphabet);
+    alphabet.val[1] = vld1q_u8((const uint8_t*)base64_alphabet + 16);
+    alphabet.val[2] = vld1q_u8((const uint8_t*)base64_alphabet + 32);
+    alphabet.val[3] = vld1q_u8((const uint8_t*)base64_alphabet + 48);
+    while (size - done >= 48)
+    {
+        uint8x16x3_t in = vld3q_u8(source + done);
+        uint8x16x4_t out;
+        out.val[0] = vshrq_n_u8(in.val[0], 2);
+        out.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[0], 4), vshrq_n_u8(in.val[1], 4)), mask);
+        out.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[1], 2), vshrq_n_u8(in.val[2], 6)), mask);
+        out.val[3] = vandq_u8(in.val[2], mask);
+        out.val[0] = vqtbl4q_u8(alphabet, out.val[0]);
+        out.val[1] = vqtbl4q_u8(alphabet, out.val[1]);
+        out.val[2] = vqtbl4q_u8(alphabet, out.val[2]);
+        out.val[3] = vqtbl4q_u8(alphabet, out.val[3]);
+        vst4q_u8((uint8_t*)destination + done / 3 * 4, out);
+        done += 48;
+    }
+    return done;
+}
+
+#endif /*BASE64_ENCODER_NEON*/
+
+size_t Base64Encoder_GetEncodedSize(size_t size)
+{
+    size_t result;
+    size_t groups = (size / 3) + (((size % 3) != 0) ? 1 : 0);
+    if (groups > SIZE_MAX / 4)
+    {
+        /*Codes_SRS_BASE64_ENCODER_17_002: [ If the encoding of `size` bytes does not fit a `size_t`, `Base64Encoder_GetEncodedSize` shall return 0. ]*/
+        LogError("%zu bytes are too many to encode", size);
+        result = 0;
+    }
+    else
+    {
+        /*Codes_SRS_BASE64_ENCODER_17_001: [ `Base64Encoder_GetEncodedSize` shall return 4 characters for every 3 bytes of `size`, rounded up. ]*/
+        result = groups * 4;
+    }
+    return result;
+}
+
+size_t Base64Encoder_Encode(const unsigned char* source, size_t size, char* destination)
+{
+    size_t result;
+    if ((destination == NULL) || ((source == NULL) && (size != 0)))
+    {
+        /*Codes_SRS_BASE64_ENCODER_17_003: [ If `destination` is `NULL`, or `source` is `NULL` and `size` is not 0, `Base64Encoder_Encode` shall write nothing and return 0. ]*/
+        LogError("invalid arg source=%p size=%zu destination=%p", source, size, destination);
+        result = 0;
+    }
+    else
+    {
+        /*Codes_SRS_BASE64_ENCODER_17_004: [ `Base64Encoder_Encode` shall write the Base64 encoding of the `size` bytes of `source` to `destination`, with the alphabet and the padding of RFC 4648, without a terminating '\0'. ]*/
+        /*Codes_SRS_BASE64_ENCODER_17_005: [ `Base64Encoder_Encode` shall encode with SSSE3 or NEON instructions when the processor has them, and write the same characters either way. ]*/
+        size_t done = 0;
+#if defined(BASE64_ENCODER_SSSE3)
+        if (has_ssse3())
+        {
+            done = encode_ssse3(source, size, destination);
+        }
+#elif defined(BASE64_ENCODER_NEON)
+        done = encode_neon(source, size, destination);
+#endif
+        /*Codes_SRS_BASE64_ENCODER_17_006: [ `Base64Encoder_Encode` shall return the number of characters written. ]*/
+        result = (done / 3 * 4) + encode_scalar(source + done, size - done, destination + done / 3 * 4);
+    }
+    return result;
+}
@@ -3,38 +3,132 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
 
 #include "azure_c_shared_utility/gballoc.h"
-#include "azure_c_shared_utility/vector.h"
-#include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/lock.h"
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/refcount.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
-#include "azure_c_shared_utility/uniqueid.h"
-
-#include "nanomsg/nn.h"
-#include "nanomsg/pubsub.h"
+#include "azure_c_shared_utility/condition.h"
 
 #include "message.h"
+#include "message_queue.h"
 #include "module.h"
 #include "module_access.h"
 #include "broker.h"
 
-/* minimum size for a guid string, 36 characters + null terminator */
-#define BROKER_GUID_SIZE 37
-#define INPROC_URL_HEAD "inproc://"
-#define INPROC_URL_HEAD_SIZE 9
-#define URL_SIZE (INPROC_URL_HEAD_SIZE + BROKER_GUID_SIZE +1)
+/*sequentially consistent atomics used by the routing table readers and writers*/
+#ifdef _WIN32
+#define ROUTING_ATOMIC_LOAD(p)              InterlockedCompareExchange((p), 0, 0)
+#define ROUTING_ATOMIC_INC(p)               InterlockedIncrement(p)
+#define ROUTING_ATOMIC_DEC(p)               InterlockedDecrement(p)
+#define ROUTING_ATOMIC_LOAD_PTR(p)          InterlockedCompareExchangePointer((PVOID volatile*)(p), NULL, NULL)
+#define ROUTING_ATOMIC_EXCHANGE_PTR(p, v)   InterlockedExchangePointer((PVOID volatile*)(p), (v))
+#else
+#define ROUTING_ATOMIC_LOAD(p)              __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define ROUTING_ATOMIC_INC(p)               __atomic_add_fetch((p), 1, __ATOMIC_SEQ_CST)
+#define ROUTING_ATOMIC_DEC(p)               __atomic_sub_fetch((p), 1, __ATOMIC_SEQ_CST)
+#define ROUTING_ATOMIC_LOAD_PTR(p)          __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define ROUTING_ATOMIC_EXCHANGE_PTR(p, v)   __atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+#endif
+
+#ifdef _WIN32
+#define BROKER_THREAD_LOCAL                 __declspec(thread)
+#else
+#define BROKER_THREAD_LOCAL                 __thread
+#endif
+
+/*most messages a pool thread delivers to one module before giving the other modules a turn*/
+#define BROKER_POOL_QUANTUM                 32
+
+/*most messages handed to Module_ReceiveBatch in one call*/
+#define BROKER_RECEIVE_BATCH_MAX            32
+
+struct BROKER_MODULEINFO_TAG;
+
+/*Messages published by 'source' are delivered to 'sink'*/
+typedef struct BROKER_ROUTE_TAG
+{
+    MODULE_HANDLE                   source;
+    struct BROKER_MODULEINFO_TAG*   sink;
+}BROKER_ROUTE;
+
+/*The sinks of one source: a run of route_count entries starting at
+ *BROKER_ROUTING_TABLE::routes[first_route]*/
+typedef struct BROKER_SOURCE_ROUTES_TAG
+{
+    MODULE_HANDLE           source;
+    size_t                  first_route;
+    size_t                  route_count;
+}BROKER_SOURCE_ROUTES;
+
+/*An immutable snapshot of all the links in the broker. A table is never
+ *modified once it is published; adding or removing a link builds a new one.*/
+typedef struct BROKER_ROUTING_TABLE_TAG
+{
+    /** All routes, ordered by source so each source's sinks are contiguous */
+    size_t                  route_count;
+    BROKER_ROUTE*           routes;
+    /** One entry per distinct source, ordered by source for bsearch */
+    size_t                  source_count;
+    BROKER_SOURCE_ROUTES*   sources;
+}BROKER_ROUTING_TABLE;
+
+struct BROKER_THREAD_POOL_TAG;
+
+/*One thread of the pool and the modules waiting for it to run them*/
+typedef struct BROKER_POOL_WORKER_TAG
+{
+    struct BROKER_THREAD_POOL_TAG*  pool;
+    /** Position of this worker in BROKER_THREAD_POOL::workers */
+    size_t                          index;
+    THREAD_HANDLE                   thread;
+    /** Lock guarding the run queue */
+    LOCK_HANDLE                     lock;
+    /** Modules with queued messages, linked through BROKER_MODULEINFO::next_ready */
+    struct BROKER_MODULEINFO_TAG*   ready_head;
+    struct BROKER_MODULEINFO_TAG*   ready_tail;
+}BROKER_POOL_WORKER;
+
+/*Threads shared by every module that does not have a thread of its own*/
+typedef struct BROKER_THREAD_POOL_TAG
+{
+    size_t                  worker_count;
+    BROKER_POOL_WORKER*     workers;
+    /** Lock guarding pending and quit */
+    LOCK_HANDLE             lock;
+    /** Signaled when a module is ready to run or the pool is asked to quit */
+    COND_HANDLE             cond;
+    /** Modules in the run queues; a worker may take a module before it is
+     *  counted, so this can briefly drop below zero
+     */
+    long                    pending;
+    /** Set when the pool threads should exit */
+    bool                    quit;
+}BROKER_THREAD_POOL;
 
 /*The structure backing the message broker handle*/
 typedef struct BROKER_HANDLE_DATA_TAG
 {
     SINGLYLINKEDLIST_HANDLE modules;
     LOCK_HANDLE             modules_lock;
-    int                     publish_socket;
-    STRING_HANDLE           url;
+    /** Current routing table, NULL when there are no links. Readers never
+     *  lock; writers replace it while holding modules_lock.
+     */
+    BROKER_ROUTING_TABLE*   routing;
+    /** Incremented every time the routing table is replaced */
+    volatile long           routing_epoch;
+    /** Number of Broker_Publish calls reading the table, by epoch parity */
+    volatile long           routing_readers[2];
+    /** Threads shared by the modules, NULL when every module has its own */
+    BROKER_THREAD_POOL*     pool;
+    /** Pool worker the next pooled module is assigned to, guarded by modules_lock */
+    size_t                  next_pool_worker;
 }BROKER_HANDLE_DATA;
 
 DEFINE_REFCOUNT_TYPE(BROKER_HANDLE_DATA);
@@ -42,55 +136,54 @@ DEFINE_REFCOUNT_TYPE(BROKER_HANDLE_DATA);
 typedef struct BROKER_MODULEINFO_TAG
 {
     /** Handle to the module that's associated with the broker */
-    MODULE*         module;
+    MODULE*                 module;
     /** Handle to the thread on which this module's message processing loop is
      *  running
      */
-    THREAD_HANDLE   thread;
-    /** Socket this module will receive messages on */
-    int             receive_socket;
-    /** Lock to prevent nanomsg race condition */
-    LOCK_HANDLE     socket_lock;
-    /** Guid sent to module worker thread to close task */
-    STRING_HANDLE   quit_message_guid;
-
+    THREAD_HANDLE           thread;
+    /** Messages waiting to be delivered to this module */
+    MESSAGE_QUEUE_HANDLE    mq;
+    /** Lock guarding mq and quit_worker */
+    LOCK_HANDLE             mq_lock;
+    /** Signaled when a message is queued or the worker is asked to quit */
+    COND_HANDLE             mq_cond;
+    /** Signaled when a message leaves a full queue, NULL unless publishers
+     *  block on a full queue
+     */
+    COND_HANDLE             mq_space_cond;
+    /** What Broker_Publish does when mq is full */
+    BROKER_QUEUE_POLICY     queue_policy;
+    /** Number of messages discarded because mq was full, guarded by mq_lock */
+    size_t                  dropped_messages;
+    /** Set when the worker thread should exit */
+    bool                    quit_worker;
+    /** Set once the module's routes are being removed, publishers stop
+     *  blocking on its full queue, guarded by mq_lock
+     */
+    bool                    detaching;
+    /** Pool worker the module is queued on when it becomes ready, NULL when
+     *  the module has its own thread
+     */
+    BROKER_POOL_WORKER*     home_worker;
+    /** Set while the module is in a run queue or running on the pool,
+     *  guarded by mq_lock
+     */
+    bool                    scheduled;
+    /** Next module in the same run queue */
+    struct BROKER_MODULEINFO_TAG* next_ready;
 }BROKER_MODULEINFO;
 
-static STRING_HANDLE construct_url()
-{
-    STRING_HANDLE result;
+static BROKER_THREAD_POOL* pool_create(size_t thread_count);
+static void pool_destroy(BROKER_THREAD_POOL* pool, size_t started_threads);
 
-    /*Codes_SRS_BROKER_17_002: [ Broker_Create shall create a unique id. ]*/
-    char uuid[BROKER_GUID_SIZE];
-    memset(uuid, 0, BROKER_GUID_SIZE);
-    if (UniqueId_Generate(uuid, BROKER_GUID_SIZE) != UNIQUEID_OK)
-    {
-        LogError("Unable to generate unique Id.");
-        result = NULL;
-    }
-    else
-    {
-        /*Codes_SRS_BROKER_17_003: [ Broker_Create shall initialize a url consisting of "inproc://" + unique id. ]*/
-        result = STRING_construct(INPROC_URL_HEAD);
-        if (result == NULL)
-        {
-            LogError("Unable to construct url.");
-        }
-        else
-        {
-            if (STRING_concat(result, uuid) != 0)
-            {
-                /*Codes_SRS_BROKER_13_003: [ This function shall return NULL if an underlying API call to the platform causes an error. ]*/
-                STRING_delete(result);
-                LogError("Unable to append uuid to url.");
-                result = NULL;
-            }
-        }
-    }
-    return result;
-}
 
 BROKER_HANDLE Broker_Create(void)
+{
+    /*Codes_SRS_BROKER_17_072: [ Broker_CreateWithThreadPool shall behave as Broker_Create when thread_count is 0. ]*/
+    return Broker_CreateWithThreadPool(0);
+}
+
+BROKER_HANDLE Broker_CreateWithThreadPool(size_t thread_count)
 {
     BROKER_HANDLE_DATA* result;
 
@@ -126,45 +219,27 @@ BROKER_HANDLE Broker_Create(void)
             }
             else
             {
-                /*Codes_SRS_BROKER_17_001: [ Broker_Create shall initialize a socket for publishing messages. ]*/
-                result->publish_socket = nn_socket(AF_SP, NN_PUB);
-                if (result->publish_socket < 0)
-                {
-                    /*Codes_SRS_BROKER_13_003: [ This function shall return NULL if an underlying API call to the platform causes an error. ]*/
-                    LogError("nanomsg puclish socket create failedL %d", result->publish_socket);
-                    singlylinkedlist_destroy(result->modules);
-                    Lock_Deinit(result->modules_lock);
-                    free(result);
-                    result = NULL;
-                }
-                else
+                /*Codes_SRS_BROKER_17_054: [ Broker_Create shall initialize BROKER_HANDLE_DATA::routing to an empty routing table. ]*/
+                result->routing = NULL;
+                result->routing_epoch = 0;
+                result->routing_readers[0] = 0;
+                result->routing_readers[1] = 0;
+                result->pool = NULL;
+                result->next_pool_worker = 0;
+
+                if (thread_count > 0)
                 {
-                    result->url = construct_url();
-                    if (result->url == NULL)
+                    /*Codes_SRS_BROKER_17_073: [ Broker_CreateWithThreadPool shall start a pool of thread_count threads shared by the modules of the broker. ]*/
+                    result->pool = pool_create(thread_count);
+                    if (result->pool == NULL)
                     {
-                        /*Codes_SRS_BROKER_13_003: [ This function shall return NULL if an underlying API call to the platform causes an error. ]*/
-                        singlylinkedlist_destroy(result->modules);
+                        /*Codes_SRS_BROKER_17_074: [ If the pool cannot be started, Broker_CreateWithThreadPool shall free all resources and return NULL. ]*/
+                        LogError("unable to start a pool of %zu threads", thread_count);
                         Lock_Deinit(result->modules_lock);
-                        nn_close(result->publish_socket);
+                        singlylinkedlist_destroy(result->modules);
                         free(result);
-                        LogError("Unable to generate unique url.");
                         result = NULL;
                     }
-                    else
-                    {
-                        /*Codes_SRS_BROKER_17_004: [ Broker_Create shall bind the socket to the BROKER_HANDLE_DATA::url. ]*/
-                        if (nn_bind(result->publish_socket, STRING_c_str(result->url)) < 0)
-                        {
-                            /*Codes_SRS_BROKER_13_003: [ This function shall return NULL if an underlying API call to the platform causes an error. ]*/
-                            LogError("nanomsg bind failed");
-                            singlylinkedlist_destroy(result->modules);
-                            Lock_Deinit(result->modules_lock);
-                            nn_close(result->publish_socket);
-                            STRING_delete(result->url);                
-                            free(result);
-                            result = NULL;
-                        }
-                    }
                 }
             }
         }
@@ -188,86 +263,471 @@ void Broker_IncRef(BROKER_HANDLE broker)
     }
 }
 
+/*takes up to max_count messages off the queue of a module, mq_lock held*/
+static size_t take_messages(BROKER_MODULEINFO* module_info, MESSAGE_HANDLE* messages, size_t max_count)
+{
+    size_t count = 0;
+    bool was_full = (module_info->mq_space_cond != NULL) && MESSAGE_QUEUE_is_full(module_info->mq);
+
+    /*Codes_SRS_BROKER_17_048: [ The function shall pop the next message from module_info->mq. ]*/
+    while (count < max_count && (messages[count] = MESSAGE_QUEUE_pop(module_info->mq)) != NULL)
+    {
+        count++;
+    }
+
+    if (count > 0 && was_full)
+    {
+        /*Codes_SRS_BROKER_17_068: [ After taking a message off a full queue, the function shall signal module_info->mq_space_cond if publishers block on the queue. ]*/
+        (void)Condition_Post(module_info->mq_space_cond);
+    }
+
+    return count;
+}
+
+/*number of messages to take off the queue of a module for one delivery*/
+static size_t delivery_size(const BROKER_MODULEINFO* module_info)
+{
+    /*Codes_SRS_BROKER_17_082: [ If the module implements Module_ReceiveBatch, the function shall take up to BROKER_RECEIVE_BATCH_MAX messages off module_info->mq at once, otherwise one. ]*/
+    return (MODULE_RECEIVE_BATCH(module_info->module->module_apis) != NULL) ? BROKER_RECEIVE_BATCH_MAX : 1;
+}
+
+/*hands messages taken off the queue of a module to the module, then destroys them*/
+static void deliver_messages(BROKER_MODULEINFO* module_info, MESSAGE_HANDLE* messages, size_t count)
+{
+    size_t i;
+    pfModule_ReceiveBatch receive_batch = MODULE_RECEIVE_BATCH(module_info->module->module_apis);
+
+    if (receive_batch != NULL)
+    {
+        /*Codes_SRS_BROKER_17_083: [ The function shall deliver the messages it took in one call to Module_ReceiveBatch when the module implements it. ]*/
+        receive_batch(module_info->module->module_handle, messages, count);
+    }
+    else
+    {
+        for (i = 0; i < count; i++)
+        {
+            /*Codes_SRS_BROKER_13_092: [The function shall deliver the message to the module's callback function via module_info->module_apis. ]*/
+            MODULE_RECEIVE(module_info->module->module_apis)(module_info->module->module_handle, messages[i]);
+        }
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        /*Codes_SRS_BROKER_13_093: [ The function shall destroy the message that was dequeued by calling Message_Destroy. ]*/
+        Message_Destroy(messages[i]);
+    }
+}
+
 /**
 * This function runs for each module. It receives a pointer to a MODULE_INFO
 * object that describes the module. Its job is to call the Receive function on
-* the associated module whenever it receives a message.
+* the associated module whenever a message is queued for it.
 */
 static int module_worker(void * user_data)
 {
     /*Codes_SRS_BROKER_13_026: [This function shall assign `user_data` to a local variable called `module_info` of type `BROKER_MODULEINFO*`.]*/
     BROKER_MODULEINFO* module_info = (BROKER_MODULEINFO*)user_data;
+    MESSAGE_HANDLE messages[BROKER_RECEIVE_BATCH_MAX];
+    size_t max_count = delivery_size(module_info);
 
     int should_continue = 1;
     while (should_continue)
     {
-        /*Codes_SRS_BROKER_13_089: [ This function shall acquire the lock on module_info->socket_lock. ]*/
-        if (Lock(module_info->socket_lock))
+        size_t count = 0;
+
+        /*Codes_SRS_BROKER_13_089: [ This function shall acquire the lock on module_info->mq_lock. ]*/
+        if (Lock(module_info->mq_lock))
         {
             /*Codes_SRS_BROKER_02_004: [ If acquiring the lock fails, then module_worker shall return. ]*/
             LogError("unable to Lock");
             should_continue = 0;
             break;
         }
-        int nn_fd = module_info->receive_socket;
-        int nbytes;
-        unsigned char *buf = NULL;
 
-        /*Codes_SRS_BROKER_17_005: [ For every iteration of the loop, the function shall wait on the receive_socket for messages. ]*/
-        nbytes = nn_recv(nn_fd, (void *)&buf, NN_MSG, 0);
-        /*Codes_SRS_BROKER_13_091: [ The function shall unlock module_info->socket_lock. ]*/
-        if (Unlock(module_info->socket_lock) != LOCK_OK)
+        /*Codes_SRS_BROKER_13_068: [ This function shall run a loop that keeps running until module_info->quit_worker is set. ]*/
+        if (module_info->quit_worker)
+        {
+            should_continue = 0;
+        }
+        else
+        {
+            count = take_messages(module_info, messages, max_count);
+            if (count == 0)
+            {
+                /*Codes_SRS_BROKER_17_046: [ If module_info->mq is empty and module_info->quit_worker is not set, the function shall wait on module_info->mq_cond. ]*/
+                if (Condition_Wait(module_info->mq_cond, module_info->mq_lock, 0) != COND_OK)
+                {
+                    /*Codes_SRS_BROKER_17_047: [ If waiting on module_info->mq_cond fails, then module_worker shall return. ]*/
+                    LogError("unable to wait on the module queue condition");
+                    should_continue = 0;
+                }
+            }
+        }
+
+        /*Codes_SRS_BROKER_13_091: [ The function shall unlock module_info->mq_lock. ]*/
+        if (Unlock(module_info->mq_lock) != LOCK_OK)
         {
             /*Codes_SRS_BROKER_17_016: [ If releasing the lock fails, then module_worker shall return. ]*/
+            LogError("unable to Unlock");
             should_continue = 0;
-            if (nbytes > 0)
+            while (count > 0)
             {
-                /*Codes_SRS_BROKER_17_019: [ The function shall free the buffer received on the receive_socket. ]*/
-                nn_freemsg(buf);
+                /*Codes_SRS_BROKER_13_093: [ The function shall destroy the message that was dequeued by calling Message_Destroy. ]*/
+                Message_Destroy(messages[--count]);
             }
             break;
         }
 
-        if (nbytes < 0)
+        if (count > 0)
+        {
+            deliver_messages(module_info, messages, count);
+        }
+    }
+
+    return 0;
+}
+
+/*the pool worker running on the calling thread, NULL on any other thread*/
+static BROKER_THREAD_LOCAL BROKER_POOL_WORKER* current_pool_worker = NULL;
+
+/*appends a module to the run queue of worker and wakes a pool thread to run it*/
+static void pool_push(BROKER_POOL_WORKER* worker, BROKER_MODULEINFO* module_info)
+{
+    BROKER_THREAD_POOL* pool = worker->pool;
+
+    if (Lock(worker->lock) != LOCK_OK)
+    {
+        LogError("unable to lock the run queue of pool worker [%p]", worker);
+    }
+    else
+    {
+        module_info->next_ready = NULL;
+        if (worker->ready_tail == NULL)
+        {
+            worker->ready_head = module_info;
+        }
+        else
+        {
+            worker->ready_tail->next_ready = module_info;
+        }
+        worker->ready_tail = module_info;
+        (void)Unlock(worker->lock);
+
+        if (Lock(pool->lock) != LOCK_OK)
+        {
+            LogError("unable to lock the thread pool");
+        }
+        else
+        {
+            pool->pending++;
+            (void)Condition_Post(pool->cond);
+            (void)Unlock(pool->lock);
+        }
+    }
+}
+
+/*hands a module that just became ready to the pool. A module readied by a pool thread stays on that
+ *thread, otherwise it goes to the worker it was assigned to when it was added.*/
+static void pool_schedule(BROKER_MODULEINFO* module_info)
+{
+    BROKER_POOL_WORKER* worker = current_pool_worker;
+    if (worker == NULL || worker->pool != module_info->home_worker->pool)
+    {
+        worker = module_info->home_worker;
+    }
+    pool_push(worker, module_info);
+}
+
+/*pops the first module of the run queue of worker, NULL if the queue is empty*/
+static BROKER_MODULEINFO* pool_pop(BROKER_POOL_WORKER* worker)
+{
+    BROKER_MODULEINFO* result;
+
+    if (Lock(worker->lock) != LOCK_OK)
+    {
+        LogError("unable to lock the run queue of pool worker [%p]", worker);
+        result = NULL;
+    }
+    else
+    {
+        result = worker->ready_head;
+        if (result != NULL)
+        {
+            worker->ready_head = result->next_ready;
+            if (worker->ready_head == NULL)
+            {
+                worker->ready_tail = NULL;
+            }
+            result->next_ready = NULL;
+        }
+        (void)Unlock(worker->lock);
+    }
+
+    return result;
+}
+
+/*takes the next module for worker to run, NULL if no module is ready*/
+static BROKER_MODULEINFO* pool_take(BROKER_POOL_WORKER* worker)
+{
+    BROKER_THREAD_POOL* pool = worker->pool;
+    size_t i;
+
+    /*Codes_SRS_BROKER_17_077: [ A pool thread shall run the modules of its own run queue first and take a module from the run queue of another pool thread when its own is empty. ]*/
+    BROKER_MODULEINFO* result = pool_pop(worker);
+    for (i = 1; result == NULL && i < pool->worker_count; i++)
+    {
+        result = pool_pop(&pool->workers[(worker->index + i) % pool->worker_count]);
+    }
+
+    if (result != NULL)
+    {
+        if (Lock(pool->lock) != LOCK_OK)
+        {
+            LogError("unable to lock the thread pool");
+        }
+        else
+        {
+            pool->pending--;
+            (void)Unlock(pool->lock);
+        }
+    }
+
+    return result;
+}
+
+/*delivers the queued messages of a module taken off a run queue. A module that still has messages after
+ *BROKER_POOL_QUANTUM deliveries goes to the back of the run queue so it cannot starve the others.*/
+static void pool_run_module(BROKER_POOL_WORKER* worker, BROKER_MODULEINFO* module_info)
+{
+    MESSAGE_HANDLE messages[BROKER_RECEIVE_BATCH_MAX];
+    size_t max_count = delivery_size(module_info);
+    size_t delivered = 0;
+    bool should_continue = true;
+
+    while (should_continue)
+    {
+        size_t count = 0;
+        bool reschedule = false;
+
+        if (Lock(module_info->mq_lock) != LOCK_OK)
+        {
+            LogError("unable to lock queue for module [%p]", module_info);
+            should_continue = false;
+        }
+        else
+        {
+            /*Codes_SRS_BROKER_17_078: [ A pool thread shall deliver the messages of a module in the order they were queued, at most BROKER_POOL_QUANTUM at a time, then put the module back on its run queue if more messages are waiting or mark it as not scheduled otherwise. ]*/
+            if (!module_info->quit_worker && delivered < BROKER_POOL_QUANTUM)
+            {
+                size_t quantum_left = BROKER_POOL_QUANTUM - delivered;
+                count = take_messages(module_info, messages, (max_count < quantum_left) ? max_count : quantum_left);
+            }
+
+            if (count == 0)
+            {
+                should_continue = false;
+                if (!module_info->quit_worker && !MESSAGE_QUEUE_is_empty(module_info->mq))
+                {
+                    reschedule = true;
+                }
+                else
+                {
+                    module_info->scheduled = false;
+                    if (module_info->quit_worker)
+                    {
+                        /*Broker_RemoveModule is waiting for the module to be let go*/
+                        (void)Condition_Post(module_info->mq_cond);
+                    }
+                }
+            }
+            (void)Unlock(module_info->mq_lock);
+
+            if (count > 0)
+            {
+                deliver_messages(module_info, messages, count);
+                delivered += count;
+            }
+            else if (reschedule)
+            {
+                pool_push(worker, module_info);
+            }
+        }
+    }
+}
+
+/**
+* This function runs on each thread of the pool. It receives a pointer to the
+* BROKER_POOL_WORKER of the thread and runs the modules that have messages
+* queued until the pool is asked to quit.
+*/
+static int pool_worker(void* user_data)
+{
+    BROKER_POOL_WORKER* worker = (BROKER_POOL_WORKER*)user_data;
+    BROKER_THREAD_POOL* pool = worker->pool;
+    int should_continue = 1;
+
+    current_pool_worker = worker;
+    while (should_continue)
+    {
+        BROKER_MODULEINFO* module_info = pool_take(worker);
+        if (module_info != NULL)
+        {
+            pool_run_module(worker, module_info);
+        }
+        else if (Lock(pool->lock) != LOCK_OK)
         {
-            /*Codes_SRS_BROKER_17_006: [ An error on receiving a message shall terminate the loop. ]*/
+            LogError("unable to lock the thread pool");
             should_continue = 0;
         }
         else
         {
-            if (nbytes == BROKER_GUID_SIZE &&
-                (strncmp(STRING_c_str(module_info->quit_message_guid), (const char *)buf, BROKER_GUID_SIZE-1)==0))
+            /*Codes_SRS_BROKER_17_079: [ A pool thread shall wait on the pool condition while no module is ready, and exit when the pool is asked to quit or waiting fails. ]*/
+            if (pool->quit)
             {
-                /*Codes_SRS_BROKER_13_068: [ This function shall run a loop that keeps running until module_info->quit_message_guid is sent to the thread. ]*/
-                /* received special quit message for this module */
+                /*pass the wake up on to the next thread*/
+                (void)Condition_Post(pool->cond);
                 should_continue = 0;
             }
-            else
+            else if (pool->pending <= 0 && Condition_Wait(pool->cond, pool->lock, 0) != COND_OK)
             {
-                /*Codes_SRS_BROKER_17_024: [ The function shall strip off the topic from the message. ]*/
-                const unsigned char*buf_bytes = (const unsigned char*)buf;
-                buf_bytes += sizeof(MODULE_HANDLE);
-                /*Codes_SRS_BROKER_17_017: [ The function shall deserialize the message received. ]*/
-                MESSAGE_HANDLE msg = Message_CreateFromByteArray(buf_bytes, nbytes - sizeof(MODULE_HANDLE));
-                /*Codes_SRS_BROKER_17_018: [ If the deserialization is not successful, the message loop shall continue. ]*/
-                if (msg != NULL)
+                LogError("unable to wait on the thread pool condition");
+                should_continue = 0;
+            }
+            (void)Unlock(pool->lock);
+        }
+    }
+    current_pool_worker = NULL;
+
+    return 0;
+}
+
+static BROKER_THREAD_POOL* pool_create(size_t thread_count)
+{
+    BROKER_THREAD_POOL* result;
+
+    if (thread_count > SIZE_MAX / sizeof(BROKER_POOL_WORKER))
+    {
+        LogError("too many threads requested (%zu)", thread_count);
+        result = NULL;
+    }
+    else if ((result = (BROKER_THREAD_POOL*)malloc(sizeof(BROKER_THREAD_POOL))) == NULL)
+    {
+        LogError("unable to allocate the thread pool");
+    }
+    else if ((result->workers = (BROKER_POOL_WORKER*)malloc(thread_count * sizeof(BROKER_POOL_WORKER))) == NULL)
+    {
+        LogError("unable to allocate %zu pool workers", thread_count);
+        free(result);
+        result = NULL;
+    }
+    else if ((result->lock = Lock_Init()) == NULL)
+    {
+        LogError("Lock_Init for the thread pool failed");
+        free(result->workers);
+        free(result);
+        result = NULL;
+    }
+    else if ((result->cond = Condition_Init()) == NULL)
+    {
+        LogError("Condition_Init for the thread pool failed");
+        Lock_Deinit(result->lock);
+        free(result->workers);
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        size_t i;
+
+        result->pending = 0;
+        result->quit = false;
+        result->worker_count = 0;
+
+        /*every worker exists before the first thread starts looking at them*/
+        for (i = 0; i < thread_count; i++)
+        {
+            BROKER_POOL_WORKER* worker = &result->workers[i];
+            worker->pool = result;
+            worker->index = i;
+            worker->ready_head = NULL;
+            worker->ready_tail = NULL;
+            worker->lock = Lock_Init();
+            if (worker->lock == NULL)
+            {
+                LogError("Lock_Init for pool worker %zu failed", i);
+                break;
+            }
+            result->worker_count++;
+        }
+
+        if (result->worker_count < thread_count)
+        {
+            pool_destroy(result, 0);
+            result = NULL;
+        }
+        else
+        {
+            for (i = 0; i < thread_count; i++)
+            {
+                if (ThreadAPI_Create(&result->workers[i].thread, pool_worker, &result->workers[i]) != THREADAPI_OK)
                 {
-                    /*Codes_SRS_BROKER_13_092: [The function shall deliver the message to the module's callback function via module_info->module_apis. ]*/
-                    MODULE_RECEIVE(module_info->module->module_apis)(module_info->module->module_handle, msg);
-                    /*Codes_SRS_BROKER_13_093: [ The function shall destroy the message that was dequeued by calling Message_Destroy. ]*/
-                    Message_Destroy(msg);
+                    LogError("ThreadAPI_Create for pool worker %zu failed", i);
+                    break;
                 }
             }
-            /*Codes_SRS_BROKER_17_019: [ The function shall free the buffer received on the receive_socket. ]*/
-            nn_freemsg(buf);
-        }    
+
+            if (i < thread_count)
+            {
+                pool_destroy(result, i);
+                result = NULL;
+            }
+        }
     }
 
-    return 0;
+    return result;
 }
 
-static BROKER_RESULT init_module(BROKER_MODULEINFO* module_info, const MODULE* module)
+/*stops the first started_threads threads of the pool and frees it*/
+static void pool_destroy(BROKER_THREAD_POOL* pool, size_t started_threads)
 {
+    size_t i;
+
+    if (Lock(pool->lock) != LOCK_OK)
+    {
+        LogError("unable to lock the thread pool, signaling the threads without the lock");
+        pool->quit = true;
+        (void)Condition_Post(pool->cond);
+    }
+    else
+    {
+        pool->quit = true;
+        (void)Condition_Post(pool->cond);
+        (void)Unlock(pool->lock);
+    }
+
+    for (i = 0; i < started_threads; i++)
+    {
+        int thread_result;
+        if (ThreadAPI_Join(pool->workers[i].thread, &thread_result) != THREADAPI_OK)
+        {
+            LogError("ThreadAPI_Join() returned an error for pool worker %zu.", i);
+        }
+    }
+
+    for (i = 0; i < pool->worker_count; i++)
+    {
+        Lock_Deinit(pool->workers[i].lock);
+    }
+    Condition_Deinit(pool->cond);
+    Lock_Deinit(pool->lock);
+    free(pool->workers);
+    free(pool);
+}
+
+static BROKER_RESULT init_module(BROKER_MODULEINFO* module_info, const MODULE* module, const BROKER_QUEUE_CONFIG* queue_config)
+{
+    size_t capacity = (queue_config == NULL) ? 0 : queue_config->capacity;
+
     BROKER_RESULT result;
 
     /*Codes_SRS_BROKER_13_107: The function shall assign the `module` handle to `BROKER_MODULEINFO::module`.*/
@@ -281,41 +741,69 @@ static BROKER_RESULT init_module(BROKER_MODULEINFO* module_info, const MODULE* m
     {
         module_info->module->module_apis = module->module_apis;
         module_info->module->module_handle = module->module_handle;
+        module_info->quit_worker = false;
+        module_info->detaching = false;
+        module_info->queue_policy = (queue_config == NULL) ? BROKER_QUEUE_POLICY_DROP_OLDEST : queue_config->policy;
+        module_info->dropped_messages = 0;
+        module_info->mq_space_cond = NULL;
+        module_info->home_worker = NULL;
+        module_info->scheduled = false;
+        module_info->next_ready = NULL;
 
-        /*Codes_SRS_BROKER_13_099: [The function shall initialize BROKER_MODULEINFO::socket_lock with a valid lock handle.]*/
-        module_info->socket_lock = Lock_Init();
-        if (module_info->socket_lock == NULL)
+        /*Codes_SRS_BROKER_13_099: [The function shall initialize BROKER_MODULEINFO::mq_lock with a valid lock handle.]*/
+        module_info->mq_lock = Lock_Init();
+        if (module_info->mq_lock == NULL)
         {
             /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
-            LogError("Lock_Init for socket lock failed");
+            LogError("Lock_Init for queue lock failed");
             result = BROKER_ERROR;
         }
         else
         {
-            char uuid[BROKER_GUID_SIZE];
-            memset(uuid, 0, BROKER_GUID_SIZE);
-            /*Codes_SRS_BROKER_17_020: [ The function shall create a unique ID used as a quit signal. ]*/
-            if (UniqueId_Generate(uuid, BROKER_GUID_SIZE) != UNIQUEID_OK)
+            /*Codes_SRS_BROKER_17_043: [ The function shall initialize BROKER_MODULEINFO::mq_cond with a valid condition handle. ]*/
+            module_info->mq_cond = Condition_Init();
+            if (module_info->mq_cond == NULL)
             {
                 /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
-                LogError("Lock_Init for socket lock failed");
-                Lock_Deinit(module_info->socket_lock);
+                LogError("Condition_Init for queue condition failed");
+                Lock_Deinit(module_info->mq_lock);
                 result = BROKER_ERROR;
             }
             else
             {
-                module_info->quit_message_guid = STRING_construct(uuid);
-                if (module_info->quit_message_guid == NULL)
+                /*Codes_SRS_BROKER_17_044: [ The function shall create BROKER_MODULEINFO::mq, an empty queue of messages waiting to be delivered to the module. ]*/
+                /*Codes_SRS_BROKER_17_061: [ If queue_config is NULL or its capacity is 0 the queue shall be unbounded, otherwise the function shall create the queue with MESSAGE_QUEUE_create_bounded. ]*/
+                module_info->mq = (capacity == 0) ? MESSAGE_QUEUE_create() : MESSAGE_QUEUE_create_bounded(capacity);
+                if (module_info->mq == NULL)
                 {
                     /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
-                    LogError("String construct failed for module guid");
-                    Lock_Deinit(module_info->socket_lock);
+                    LogError("unable to create a queue of capacity %zu", capacity);
+                    Condition_Deinit(module_info->mq_cond);
+                    Lock_Deinit(module_info->mq_lock);
                     result = BROKER_ERROR;
                 }
-                else
+                else if (capacity == 0 || module_info->queue_policy != BROKER_QUEUE_POLICY_BLOCK)
                 {
                     result = BROKER_OK;
                 }
+                else
+                {
+                    /*Codes_SRS_BROKER_17_062: [ If the queue is bounded and its policy is BROKER_QUEUE_POLICY_BLOCK, the function shall initialize BROKER_MODULEINFO::mq_space_cond with a valid condition handle. ]*/
+                    module_info->mq_space_cond = Condition_Init();
+                    if (module_info->mq_space_cond == NULL)
+                    {
+                        /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+                        LogError("Condition_Init for queue space condition failed");
+                        MESSAGE_QUEUE_destroy(module_info->mq);
+                        Condition_Deinit(module_info->mq_cond);
+                        Lock_Deinit(module_info->mq_lock);
+                        result = BROKER_ERROR;
+                    }
+                    else
+                    {
+                        result = BROKER_OK;
+                    }
+                }
             }
         }
     }
@@ -325,131 +813,320 @@ static BROKER_RESULT init_module(BROKER_MODULEINFO* module_info, const MODULE* m
 static void deinit_module(BROKER_MODULEINFO* module_info)
 {
     /*Codes_SRS_BROKER_13_057: [The function shall free all members of the MODULE_INFO object.]*/
-    Lock_Deinit(module_info->socket_lock);
-    STRING_delete(module_info->quit_message_guid);
+    /* any message still queued for the module is destroyed along with the queue */
+    MESSAGE_QUEUE_destroy(module_info->mq);
+    if (module_info->mq_space_cond != NULL)
+    {
+        Condition_Deinit(module_info->mq_space_cond);
+    }
+    Condition_Deinit(module_info->mq_cond);
+    Lock_Deinit(module_info->mq_lock);
     free(module_info->module);
 }
 
-static BROKER_RESULT start_module(BROKER_MODULEINFO* module_info, STRING_HANDLE url)
+static BROKER_RESULT start_module(BROKER_HANDLE_DATA* broker_data, BROKER_MODULEINFO* module_info, const BROKER_QUEUE_CONFIG* queue_config)
 {
     BROKER_RESULT result;
 
-    /* Connect to pub/sub */
-    /*Codes_SRS_BROKER_17_013: [ The function shall create a nanomsg socket for reception. ]*/
-    module_info->receive_socket = nn_socket(AF_SP, NN_SUB);
-    if (module_info->receive_socket < 0)
+    /*a publisher blocked on a full queue must not hold up the pool thread that would drain it*/
+    bool dedicated_thread = (queue_config != NULL) &&
+        (queue_config->dedicated_thread || (queue_config->capacity > 0 && queue_config->policy == BROKER_QUEUE_POLICY_BLOCK));
+
+    if (broker_data->pool != NULL && !dedicated_thread)
+    {
+        /*Codes_SRS_BROKER_17_075: [ If the broker has a thread pool, the function shall assign the module to a pool thread instead of creating a thread for it, unless queue_config asks for a dedicated thread or its queue uses BROKER_QUEUE_POLICY_BLOCK. ]*/
+        module_info->home_worker = &broker_data->pool->workers[broker_data->next_pool_worker % broker_data->pool->worker_count];
+        broker_data->next_pool_worker++;
+        result = BROKER_OK;
+    }
+    /*Codes_SRS_BROKER_13_102: [The function shall create a new thread for the module by calling ThreadAPI_Create using module_worker as the thread callback and using the newly allocated BROKER_MODULEINFO object as the thread context.*/
+    else if (ThreadAPI_Create(
+        &(module_info->thread),
+        module_worker,
+        (void*)module_info
+    ) != THREADAPI_OK)
     {
         /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
-        LogError("module receive socket create failed");
+        LogError("ThreadAPI_Create failed");
         result = BROKER_ERROR;
     }
     else
     {
-        /*Codes_SRS_BROKER_17_014: [ The function shall bind the socket to the the BROKER_HANDLE_DATA::url. ]*/
-        int connect_result = nn_connect(module_info->receive_socket, STRING_c_str(url));
-        if (connect_result < 0)
+        result = BROKER_OK;
+    }
+
+    return result;
+}
+
+/*stops delivering messages to a module run by the pool: once this returns no pool thread holds the module*/
+/*returns 0 if success, otherwise __LINE__*/
+static int stop_pooled_module(BROKER_MODULEINFO* module_info)
+{
+    int result;
+
+    if (Lock(module_info->mq_lock) != LOCK_OK)
+    {
+        LogError("unable to lock queue for module [%p]", module_info);
+        result = __LINE__;
+    }
+    else
+    {
+        /*Codes_SRS_BROKER_17_080: [ If the module is run by the thread pool, Broker_RemoveModule shall set BROKER_MODULEINFO::quit_worker and wait on BROKER_MODULEINFO::mq_cond until no pool thread holds the module. ]*/
+        module_info->quit_worker = true;
+        result = 0;
+        while (result == 0 && module_info->scheduled)
         {
-            /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
-            LogError("nn_connect failed");
-            nn_close(module_info->receive_socket);
-            module_info->receive_socket = -1;
-            result = BROKER_ERROR;
+            if (Condition_Wait(module_info->mq_cond, module_info->mq_lock, 0) != COND_OK)
+            {
+                LogError("unable to wait for the pool to let go of module [%p]", module_info);
+                result = __LINE__;
+            }
+        }
+        (void)Unlock(module_info->mq_lock);
+    }
+
+    return result;
+}
+
+/*stop module means: stop the thread that feeds messages to Module_Receive function*/
+/*returns 0 if success, otherwise __LINE__*/
+static int stop_module(BROKER_MODULEINFO* module_info)
+{
+    int thread_result, result;
+
+    /*Codes_SRS_BROKER_02_001: [ Broker_RemoveModule shall lock BROKER_MODULEINFO::mq_lock. ]*/
+    if (Lock(module_info->mq_lock) != LOCK_OK)
+    {
+        /* the worker checks the flag under the lock; without it we still set the flag and wake the thread */
+        LogError("unable to lock queue for module [%p], signaling the worker without the lock", module_info);
+        module_info->quit_worker = true;
+        (void)Condition_Post(module_info->mq_cond);
+    }
+    else
+    {
+        /*Codes_SRS_BROKER_17_049: [ This function shall signal the worker thread to quit by setting BROKER_MODULEINFO::quit_worker and posting BROKER_MODULEINFO::mq_cond. ]*/
+        module_info->quit_worker = true;
+        if (Condition_Post(module_info->mq_cond) != COND_OK)
+        {
+            LogError("unable to signal worker thread for module [%p]", module_info);
+        }
+        if (module_info->mq_space_cond != NULL)
+        {
+            /*wake any publisher still blocked on a full queue*/
+            (void)Condition_Post(module_info->mq_space_cond);
+        }
+        /*Codes_SRS_BROKER_02_003: [ After signaling the worker, Broker_RemoveModule shall unlock BROKER_MODULEINFO::mq_lock. ]*/
+        if (Unlock(module_info->mq_lock) != LOCK_OK)
+        {
+            LogError("unable to unlock queue lock");
+        }
+    }
+    /*Codes_SRS_BROKER_13_104: [The function shall wait for the module's thread to exit by joining BROKER_MODULEINFO::thread via ThreadAPI_Join. ]*/
+    if (ThreadAPI_Join(module_info->thread, &thread_result) != THREADAPI_OK)
+    {
+        result = __LINE__;
+        LogError("ThreadAPI_Join() returned an error.");
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
+/*returns the current routing table; every call must be paired with routing_release*/
+static const BROKER_ROUTING_TABLE* routing_acquire(BROKER_HANDLE_DATA* broker_data, long* epoch)
+{
+    /*announce the reader in the current epoch; if the epoch moved on in the meantime the writer
+     *may not have seen the announcement, so try again in the new one*/
+    for (;;)
+    {
+        long current = ROUTING_ATOMIC_LOAD(&broker_data->routing_epoch);
+        (void)ROUTING_ATOMIC_INC(&broker_data->routing_readers[current & 1]);
+        if (ROUTING_ATOMIC_LOAD(&broker_data->routing_epoch) == current)
+        {
+            *epoch = current;
+            break;
+        }
+        (void)ROUTING_ATOMIC_DEC(&broker_data->routing_readers[current & 1]);
+    }
+
+    return (const BROKER_ROUTING_TABLE*)ROUTING_ATOMIC_LOAD_PTR(&broker_data->routing);
+}
+
+static void routing_release(BROKER_HANDLE_DATA* broker_data, long epoch)
+{
+    (void)ROUTING_ATOMIC_DEC(&broker_data->routing_readers[epoch & 1]);
+}
+
+/*allocates a table with room for route_count routes, returns NULL when route_count is 0 or on failure*/
+static BROKER_ROUTING_TABLE* routing_table_create(size_t route_count)
+{
+    BROKER_ROUTING_TABLE* result;
+    if (route_count == 0)
+    {
+        result = NULL;
+    }
+    else
+    {
+        /*there are never more sources than routes, so the source index lives in the same block*/
+        result = (BROKER_ROUTING_TABLE*)malloc(sizeof(BROKER_ROUTING_TABLE) + route_count * (sizeof(BROKER_ROUTE) + sizeof(BROKER_SOURCE_ROUTES)));
+        if (result == NULL)
+        {
+            LogError("unable to allocate routing table for %zu routes", route_count);
         }
         else
         {
-            /* Codes_SRS_BROKER_17_028: [ The function shall subscribe BROKER_MODULEINFO::receive_socket to the quit signal GUID. ]*/
-            if (nn_setsockopt(
-                module_info->receive_socket, NN_SUB, NN_SUB_SUBSCRIBE, STRING_c_str(module_info->quit_message_guid), STRING_length(module_info->quit_message_guid)) < 0)
-            {
-                /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
-                LogError("nn_setsockopt failed");
-                nn_close(module_info->receive_socket);
-                module_info->receive_socket = -1;
-                result = BROKER_ERROR;
-            }
-            else
-            {
-                /*Codes_SRS_BROKER_13_102: [The function shall create a new thread for the module by calling ThreadAPI_Create using module_worker as the thread callback and using the newly allocated BROKER_MODULEINFO object as the thread context.*/
-                if (ThreadAPI_Create(
-                    &(module_info->thread),
-                    module_worker,
-                    (void*)module_info
-                ) != THREADAPI_OK)
-                {
-                    /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
-                    LogError("ThreadAPI_Create failed");
-                    nn_close(module_info->receive_socket);
-                    result = BROKER_ERROR;
-                }
-                else
-                {
-                    result = BROKER_OK;
-                }
-            }
+            result->route_count = route_count;
+            result->routes = (BROKER_ROUTE*)(result + 1);
+            result->source_count = 0;
+            result->sources = (BROKER_SOURCE_ROUTES*)(result->routes + route_count);
+        }
+    }
+    return result;
+}
+
+static int compare_handles(MODULE_HANDLE left, MODULE_HANDLE right)
+{
+    return ((uintptr_t)left < (uintptr_t)right) ? -1 : (((uintptr_t)left > (uintptr_t)right) ? 1 : 0);
+}
+
+static int compare_source_routes(const void* key, const void* element)
+{
+    return compare_handles(*(const MODULE_HANDLE*)key, ((const BROKER_SOURCE_ROUTES*)element)->source);
+}
+
+/*returns the sinks of source or NULL if nothing is linked to source*/
+static const BROKER_SOURCE_ROUTES* routing_table_lookup(const BROKER_ROUTING_TABLE* routing, MODULE_HANDLE source)
+{
+    const BROKER_SOURCE_ROUTES* result;
+    if (routing == NULL)
+    {
+        result = NULL;
+    }
+    else
+    {
+        result = (const BROKER_SOURCE_ROUTES*)bsearch(&source, routing->sources, routing->source_count, sizeof(BROKER_SOURCE_ROUTES), compare_source_routes);
+    }
+    return result;
+}
+
+/*returns the index of the route from source to sink or route_count if there isn't one*/
+static size_t routing_table_find(const BROKER_ROUTING_TABLE* routing, MODULE_HANDLE source, const BROKER_MODULEINFO* sink)
+{
+    size_t result;
+    const BROKER_SOURCE_ROUTES* source_routes = routing_table_lookup(routing, source);
+    if (source_routes == NULL)
+    {
+        result = (routing == NULL) ? 0 : routing->route_count;
+    }
+    else
+    {
+        size_t end = source_routes->first_route + source_routes->route_count;
+        result = source_routes->first_route;
+        while (result < end && routing->routes[result].sink != sink)
+        {
+            result++;
+        }
+        if (result == end)
+        {
+            result = routing->route_count;
         }
     }
-
     return result;
 }
 
-/*stop module means: stop the thread that feeds messages to Module_Receive function + deletion of all queued messages */
-/*returns 0 if success, otherwise __LINE__*/
-static int stop_module(int publish_socket, BROKER_MODULEINFO* module_info)
+/*returns the index at which a new route from source keeps the routes ordered by source*/
+static size_t routing_table_insert_position(const BROKER_ROUTING_TABLE* routing, MODULE_HANDLE source)
 {
-    int  quit_result, close_result, thread_result, result;
-
-    /*Codes_SRS_BROKER_17_021: [ This function shall send a quit signal to the worker thread by sending BROKER_MODULEINFO::quit_message_guid to the publish_socket. ]*/
-    /* send the unique quite id for this module */
-    if ((quit_result = nn_send(publish_socket, STRING_c_str(module_info->quit_message_guid), BROKER_GUID_SIZE, 0)) < 0)
+    size_t result = 0;
+    if (routing != NULL)
     {
-        /*Codes_SRS_BROKER_17_015: [ This function shall close the BROKER_MODULEINFO::receive_socket. ]*/
-        /* at the cost of a data race, we will close the socket to terminate the thread */
-        nn_close(module_info->receive_socket);
-        LogError("unable to peacefully close thread for module [%p], nn_send error [%d], taking harsher methods", module_info, quit_result);
+        while (result < routing->route_count && compare_handles(routing->routes[result].source, source) <= 0)
+        {
+            result++;
+        }
     }
-    else
+    return result;
+}
+
+/*builds the per-source index over the routes of a table that is about to be published*/
+static void routing_table_index(BROKER_ROUTING_TABLE* routing)
+{
+    size_t i;
+    routing->source_count = 0;
+    for (i = 0; i < routing->route_count; i++)
     {
-        /*Codes_SRS_BROKER_02_001: [ Broker_RemoveModule shall lock BROKER_MODULEINFO::socket_lock. ]*/
-        if (Lock(module_info->socket_lock) != LOCK_OK)
+        if (i == 0 || routing->routes[i].source != routing->routes[i - 1].source)
         {
-            /*Codes_SRS_BROKER_17_015: [ This function shall close the BROKER_MODULEINFO::receive_socket. ]*/
-            /* at the cost of a data race, we will close the socket to terminate the thread */
-            nn_close(module_info->receive_socket);
-            LogError("unable to peacefully close thread for module [%p], Lock error, taking harsher methods", module_info );
+            BROKER_SOURCE_ROUTES* source_routes = &routing->sources[routing->source_count++];
+            source_routes->source = routing->routes[i].source;
+            source_routes->first_route = i;
+            source_routes->route_count = 0;
         }
-        else
+        routing->sources[routing->source_count - 1].route_count++;
+    }
+}
+
+static size_t routing_table_count(const BROKER_ROUTING_TABLE* routing)
+{
+    return (routing == NULL) ? 0 : routing->route_count;
+}
+
+/*wakes the publishers blocked on a full queue of any sink of routing; they hold the epoch in which they read
+ *routing and give up once they see the epoch has moved on*/
+static void wake_blocked_publishers(const BROKER_ROUTING_TABLE* routing)
+{
+    size_t route_count = routing_table_count(routing);
+    size_t i;
+    for (i = 0; i < route_count; i++)
+    {
+        BROKER_MODULEINFO* sink = routing->routes[i].sink;
+        if (sink->mq_space_cond != NULL && Lock(sink->mq_lock) == LOCK_OK)
         {
-            /*Codes_SRS_BROKER_17_015: [ This function shall close the BROKER_MODULEINFO::receive_socket. ]*/
-            close_result = nn_close(module_info->receive_socket);
-            if (close_result < 0)
-            {
-                LogError("Receive socket close failed for module at  item [%p] failed", module_info);
-            }
-            else
-            {
-                /*all is fine, thread will eventually stop and be joined*/
-            }
-            /*Codes_SRS_BROKER_02_003: [ After closing the socket, Broker_RemoveModule shall unlock BROKER_MODULEINFO::info_lock. ]*/
-            if (Unlock(module_info->socket_lock) != LOCK_OK)
-            {
-                LogError("unable to unlock socket lock");
-            }
+            (void)Condition_Post(sink->mq_space_cond);
+            (void)Unlock(sink->mq_lock);
         }
     }
-    /*Codes_SRS_BROKER_13_104: [The function shall wait for the module's thread to exit by joining BROKER_MODULEINFO::thread via ThreadAPI_Join. ]*/
-    if (ThreadAPI_Join(module_info->thread, &thread_result) != THREADAPI_OK)
+}
+
+/*makes new_routing the table seen by Broker_Publish and frees the old one; modules_lock must be held*/
+static void routing_table_replace(BROKER_HANDLE_DATA* broker_data, BROKER_ROUTING_TABLE* new_routing)
+{
+    BROKER_ROUTING_TABLE* old_routing;
+
+    if (new_routing != NULL)
     {
-        result = __LINE__;
-        LogError("ThreadAPI_Join() returned an error.");
+        /*Codes_SRS_BROKER_17_058: [ Whenever the routing table is replaced, the new table shall index the sinks of every source, ordered by source. ]*/
+        routing_table_index(new_routing);
     }
-    else
+
+    old_routing = (BROKER_ROUTING_TABLE*)ROUTING_ATOMIC_EXCHANGE_PTR(&broker_data->routing, new_routing);
+
+    /*Codes_SRS_BROKER_17_055: [ When the routing table is replaced, the previous table shall not be freed until every Broker_Publish call that could be reading it has returned. ]*/
+    /*readers that start from now on announce themselves in the new epoch and see new_routing*/
+    long previous_epoch = ROUTING_ATOMIC_LOAD(&broker_data->routing_epoch);
+    (void)ROUTING_ATOMIC_INC(&broker_data->routing_epoch);
+    while (ROUTING_ATOMIC_LOAD(&broker_data->routing_readers[previous_epoch & 1]) != 0)
     {
-        result = 0;
+        /*Codes_SRS_BROKER_17_086: [ While waiting for the Broker_Publish calls reading the previous table, the routing table replacement shall post BROKER_MODULEINFO::mq_space_cond of every sink in the previous table that has one, while holding BROKER_MODULEINFO::mq_lock. ]*/
+        wake_blocked_publishers(old_routing);
+        ThreadAPI_Sleep(0);
+    }
+
+    if (old_routing != NULL)
+    {
+        free(old_routing);
     }
-    return result;
 }
 
 BROKER_RESULT Broker_AddModule(BROKER_HANDLE broker, const MODULE* module)
+{
+    /*Codes_SRS_BROKER_17_060: [ Broker_AddModule shall add the module with an unbounded queue, as Broker_AddModuleWithQueue does when queue_config is NULL. ]*/
+    return Broker_AddModuleWithQueue(broker, module, NULL);
+}
+
+BROKER_RESULT Broker_AddModuleWithQueue(BROKER_HANDLE broker, const MODULE* module, const BROKER_QUEUE_CONFIG* queue_config)
 {
     BROKER_RESULT result;
 
@@ -465,6 +1142,15 @@ BROKER_RESULT Broker_AddModule(BROKER_HANDLE broker, const MODULE* module)
         result = BROKER_INVALIDARG;
         LogError("invalid parameter (NULL).");
     }
+    /*Codes_SRS_BROKER_17_063: [ If queue_config->policy is not a valid BROKER_QUEUE_POLICY the function shall return BROKER_INVALIDARG. ]*/
+    else if (queue_config != NULL &&
+        queue_config->policy != BROKER_QUEUE_POLICY_DROP_OLDEST &&
+        queue_config->policy != BROKER_QUEUE_POLICY_DROP_NEWEST &&
+        queue_config->policy != BROKER_QUEUE_POLICY_BLOCK)
+    {
+        result = BROKER_INVALIDARG;
+        LogError("invalid queue policy (%d).", (int)queue_config->policy);
+    }
     else
     {
         BROKER_MODULEINFO* module_info = (BROKER_MODULEINFO*)malloc(sizeof(BROKER_MODULEINFO));
@@ -475,7 +1161,7 @@ BROKER_RESULT Broker_AddModule(BROKER_HANDLE broker, const MODULE* module)
         }
         else
         {
-            if (init_module(module_info, module) != BROKER_OK)
+            if (init_module(module_info, module, queue_config) != BROKER_OK)
             {
                 /*Codes_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
                 LogError("start_module failed");
@@ -509,7 +1195,7 @@ BROKER_RESULT Broker_AddModule(BROKER_HANDLE broker, const MODULE* module)
                     }
                     else
                     {
-                        if (start_module(module_info, broker_data->url) != BROKER_OK)
+                        if (start_module(broker_data, module_info, queue_config) != BROKER_OK)
                         {
                             LogError("start_module failed");
                             deinit_module(module_info);
@@ -541,6 +1227,80 @@ static bool find_module_predicate(LIST_ITEM_HANDLE list_item, const void* value)
     return element->module->module_handle == ((MODULE*)value)->module_handle;
 }
 
+/*stops publishers from blocking on the full queue of module_info and wakes those already waiting; a blocked
+ *publisher holds its routing epoch, so the routing table cannot be replaced until it lets go*/
+static void release_blocked_publishers(BROKER_MODULEINFO* module_info)
+{
+    if (module_info->mq_space_cond != NULL)
+    {
+        if (Lock(module_info->mq_lock) != LOCK_OK)
+        {
+            /* publishers check the flag under the lock; without it we still set the flag and wake them */
+            LogError("unable to lock queue for module [%p], waking publishers without the lock", module_info);
+            module_info->detaching = true;
+            (void)Condition_Post(module_info->mq_space_cond);
+        }
+        else
+        {
+            module_info->detaching = true;
+            if (Condition_Post(module_info->mq_space_cond) != COND_OK)
+            {
+                LogError("unable to wake publishers blocked on module [%p]", module_info);
+            }
+            (void)Unlock(module_info->mq_lock);
+        }
+    }
+}
+
+/*drops every route delivering to sink, returns 0 on success, otherwise __LINE__; modules_lock must be held*/
+static int remove_routes_to(BROKER_HANDLE_DATA* broker_data, BROKER_MODULEINFO* sink)
+{
+    int result;
+    const BROKER_ROUTING_TABLE* routing = broker_data->routing;
+    size_t route_count = routing_table_count(routing);
+    size_t remaining = 0;
+    size_t i;
+
+    for (i = 0; i < route_count; i++)
+    {
+        if (routing->routes[i].sink != sink)
+        {
+            remaining++;
+        }
+    }
+
+    if (remaining == route_count)
+    {
+        /*no published table references the module, nothing to wait for*/
+        result = 0;
+    }
+    else
+    {
+        BROKER_ROUTING_TABLE* new_routing = routing_table_create(remaining);
+        if (new_routing == NULL && remaining > 0)
+        {
+            result = __LINE__;
+        }
+        else
+        {
+            size_t j = 0;
+            for (i = 0; i < route_count; i++)
+            {
+                if (routing->routes[i].sink != sink)
+                {
+                    new_routing->routes[j++] = routing->routes[i];
+                }
+            }
+            /*Codes_SRS_BROKER_17_084: [ Before replacing the routing table, Broker_RemoveModule shall set BROKER_MODULEINFO::detaching and post BROKER_MODULEINFO::mq_space_cond, if any, while holding BROKER_MODULEINFO::mq_lock. ]*/
+            release_blocked_publishers(sink);
+            routing_table_replace(broker_data, new_routing);
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
 BROKER_RESULT Broker_RemoveModule(BROKER_HANDLE broker, const MODULE* module)
 {
     /*Codes_SRS_BROKER_13_048: [If `broker` or `module` is NULL the function shall return BROKER_INVALIDARG.]*/
@@ -575,21 +1335,35 @@ BROKER_RESULT Broker_RemoveModule(BROKER_HANDLE broker, const MODULE* module)
             else
             {
                 BROKER_MODULEINFO* module_info = (BROKER_MODULEINFO*)singlylinkedlist_item_get_value(module_info_item);
-                if (stop_module(broker_data->publish_socket, module_info) == 0)
+
+                /*Codes_SRS_BROKER_17_056: [ Broker_RemoveModule shall remove every route to the module from the routing table before stopping the module. ]*/
+                if (remove_routes_to(broker_data, module_info) != 0)
                 {
-                    deinit_module(module_info);
+                    /*Codes_SRS_BROKER_17_057: [ If the routing table cannot be replaced, Broker_RemoveModule shall leave the module attached and return BROKER_ERROR. ]*/
+                    LogError("unable to remove routes to module [%p]", module_info);
+                    result = BROKER_ERROR;
                 }
                 else
                 {
-                    LogError("unable to stop module");
-                }
+                    int stop_result = (module_info->home_worker != NULL) ?
+                        stop_pooled_module(module_info) :
+                        stop_module(module_info);
+                    if (stop_result == 0)
+                    {
+                        deinit_module(module_info);
+                    }
+                    else
+                    {
+                        LogError("unable to stop module");
+                    }
 
-                /*Codes_SRS_BROKER_13_052: [The function shall remove the module from BROKER_HANDLE_DATA::modules.]*/
-                singlylinkedlist_remove(broker_data->modules, module_info_item);
-                free(module_info);
+                    /*Codes_SRS_BROKER_13_052: [The function shall remove the module from BROKER_HANDLE_DATA::modules.]*/
+                    singlylinkedlist_remove(broker_data->modules, module_info_item);
+                    free(module_info);
 
-                /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
-                result = BROKER_OK;
+                    /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
+                    result = BROKER_OK;
+                }
             }
 
             /*Codes_SRS_BROKER_13_054: [This function shall release the lock on BROKER_HANDLE_DATA::modules_lock.]*/
@@ -600,6 +1374,55 @@ BROKER_RESULT Broker_RemoveModule(BROKER_HANDLE broker, const MODULE* module)
     return result;
 }
 
+BROKER_RESULT Broker_GetDroppedMessageCount(BROKER_HANDLE broker, const MODULE* module, size_t* dropped_messages)
+{
+    BROKER_RESULT result;
+    /*Codes_SRS_BROKER_17_069: [ If broker, module or dropped_messages is NULL, Broker_GetDroppedMessageCount shall return BROKER_INVALIDARG. ]*/
+    if (broker == NULL || module == NULL || dropped_messages == NULL)
+    {
+        result = BROKER_INVALIDARG;
+        LogError("invalid parameter (NULL).");
+    }
+    else
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        if (Lock(broker_data->modules_lock) != LOCK_OK)
+        {
+            /*Codes_SRS_BROKER_17_070: [ Broker_GetDroppedMessageCount shall return BROKER_ERROR if the module is not attached to the broker or an underlying API call fails. ]*/
+            LogError("Lock on broker_data->modules_lock failed");
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            LIST_ITEM_HANDLE module_info_item = singlylinkedlist_find(broker_data->modules, find_module_predicate, module);
+            if (module_info_item == NULL)
+            {
+                /*Codes_SRS_BROKER_17_070: [ Broker_GetDroppedMessageCount shall return BROKER_ERROR if the module is not attached to the broker or an underlying API call fails. ]*/
+                LogError("Supplied module is not attached to the broker");
+                result = BROKER_ERROR;
+            }
+            else
+            {
+                BROKER_MODULEINFO* module_info = (BROKER_MODULEINFO*)singlylinkedlist_item_get_value(module_info_item);
+                if (Lock(module_info->mq_lock) != LOCK_OK)
+                {
+                    LogError("unable to lock queue for module [%p]", module_info);
+                    result = BROKER_ERROR;
+                }
+                else
+                {
+                    /*Codes_SRS_BROKER_17_071: [ Otherwise Broker_GetDroppedMessageCount shall write the number of messages discarded by the module's queue policy to dropped_messages and return BROKER_OK. ]*/
+                    *dropped_messages = module_info->dropped_messages;
+                    (void)Unlock(module_info->mq_lock);
+                    result = BROKER_OK;
+                }
+            }
+            Unlock(broker_data->modules_lock);
+        }
+    }
+    return result;
+}
+
 BROKER_MODULEINFO* broker_locate_handle(BROKER_HANDLE_DATA* broker_data, MODULE_HANDLE handle)
 {
     BROKER_MODULEINFO* result;
@@ -661,17 +1484,41 @@ BROKER_RESULT Broker_AddLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link)
                 }
                 else
                 {
-                    /*Codes_SRS_BROKER_17_032: [ Broker_AddLink shall subscribe module_info->receive_socket to the link->source module handle. ]*/
-                    if (nn_setsockopt(
-                        module_info->receive_socket, NN_SUB, NN_SUB_SUBSCRIBE, &(link->module_source_handle), sizeof(MODULE_HANDLE)) < 0)
+                    const BROKER_ROUTING_TABLE* routing = broker_data->routing;
+                    size_t route_count = routing_table_count(routing);
+                    if (routing_table_find(routing, link->module_source_handle, module_info) < route_count)
                     {
-                        /*Codes_SRS_BROKER_17_034: [ Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR ]*/
-                        LogError("Unable to make link in Broker");
-                        result = BROKER_ADD_LINK_ERROR;
+                        /*Codes_SRS_BROKER_17_052: [ If the sink is already linked to the source, Broker_AddLink shall return BROKER_OK. ]*/
+                        result = BROKER_OK;
                     }
                     else
                     {
-                        result = BROKER_OK;
+                        /*Codes_SRS_BROKER_17_032: [ Broker_AddLink shall replace the routing table with a copy that also routes messages from link->module_source_handle to the sink. ]*/
+                        BROKER_ROUTING_TABLE* new_routing = routing_table_create(route_count + 1);
+                        if (new_routing == NULL)
+                        {
+                            /*Codes_SRS_BROKER_17_034: [ Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR ]*/
+                            LogError("Unable to make link in Broker");
+                            result = BROKER_ADD_LINK_ERROR;
+                        }
+                        else
+                        {
+                            /*the new route goes after the existing sinks of the same source*/
+                            size_t position = routing_table_insert_position(routing, link->module_source_handle);
+                            size_t i;
+                            for (i = 0; i < position; i++)
+                            {
+                                new_routing->routes[i] = routing->routes[i];
+                            }
+                            new_routing->routes[position].source = link->module_source_handle;
+                            new_routing->routes[position].sink = module_info;
+                            for (i = position; i < route_count; i++)
+                            {
+                                new_routing->routes[i + 1] = routing->routes[i];
+                            }
+                            routing_table_replace(broker_data, new_routing);
+                            result = BROKER_OK;
+                        }
                     }
                 }
             }
@@ -723,17 +1570,38 @@ BROKER_RESULT Broker_RemoveLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* li
                 }
                 else
                 {
-                    /*Codes_SRS_BROKER_17_038: [ Broker_RemoveLink shall unsubscribe module_info->receive_socket from the link->module_source_handle module handle. ]*/
-                    if (nn_setsockopt(
-                        module_info->receive_socket, NN_SUB, NN_SUB_UNSUBSCRIBE, &(link->module_source_handle), sizeof(MODULE_HANDLE)) < 0)
+                    const BROKER_ROUTING_TABLE* routing = broker_data->routing;
+                    size_t route_count = routing_table_count(routing);
+                    size_t index = routing_table_find(routing, link->module_source_handle, module_info);
+                    if (index == route_count)
                     {
-                        /*Codes_SRS_BROKER_17_040: [ Upon an error, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR. ]*/
-                        LogError("Unable to make link in Broker");
+                        /*Codes_SRS_BROKER_17_053: [ If the sink is not linked to the source, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR. ]*/
+                        LogError("Unable to remove link in Broker, link does not exist");
                         result = BROKER_REMOVE_LINK_ERROR;
                     }
                     else
                     {
-                        result = BROKER_OK;
+                        /*Codes_SRS_BROKER_17_038: [ Broker_RemoveLink shall replace the routing table with a copy that no longer routes messages from link->module_source_handle to the sink. ]*/
+                        BROKER_ROUTING_TABLE* new_routing = routing_table_create(route_count - 1);
+                        if (new_routing == NULL && route_count > 1)
+                        {
+                            /*Codes_SRS_BROKER_17_040: [ Upon an error, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR. ]*/
+                            LogError("Unable to remove link in Broker");
+                            result = BROKER_REMOVE_LINK_ERROR;
+                        }
+                        else
+                        {
+                            size_t i, j = 0;
+                            for (i = 0; i < route_count; i++)
+                            {
+                                if (i != index)
+                                {
+                                    new_routing->routes[j++] = routing->routes[i];
+                                }
+                            }
+                            routing_table_replace(broker_data, new_routing);
+                            result = BROKER_OK;
+                        }
                     }
                 }
             }
@@ -758,10 +1626,16 @@ static void broker_decrement_ref(BROKER_HANDLE broker)
             {
                 LogError("WARNING: There are still active modules attached to the broker and the broker is being destroyed.");
             }
-            /* May want to do nn_shutdown first for cleanliness. */
-            nn_close(broker_data->publish_socket);
-            STRING_delete(broker_data->url);
             singlylinkedlist_destroy(broker_data->modules);
+            if (broker_data->routing != NULL)
+            {
+                free(broker_data->routing);
+            }
+            if (broker_data->pool != NULL)
+            {
+                /*Codes_SRS_BROKER_17_081: [ If the broker has a thread pool, Broker_Destroy shall stop and join every pool thread. ]*/
+                pool_destroy(broker_data->pool, broker_data->pool->worker_count);
+            }
             Lock_Deinit(broker_data->modules_lock);
             free(broker_data);
         }
@@ -783,6 +1657,146 @@ extern void Broker_DecRef(BROKER_HANDLE broker)
     broker_decrement_ref(broker);
 }
 
+/*applies the queue policy of module_info to msg when its queue is full; mq_lock must be held and the caller must
+ *hold the routing epoch epoch. Returns 0
+ *when msg was queued or discarded by the policy, otherwise __LINE__. The message discarded by the policy,
+ *if any, is returned in *dropped and must be destroyed once mq_lock is released.*/
+static int enqueue_on_full_queue(BROKER_HANDLE_DATA* broker_data, long epoch, BROKER_MODULEINFO* module_info, MESSAGE_HANDLE msg, MESSAGE_HANDLE* dropped)
+{
+    int result;
+    bool routing_replaced = false;
+
+    switch (module_info->queue_policy)
+    {
+    case BROKER_QUEUE_POLICY_DROP_NEWEST:
+        /*Codes_SRS_BROKER_17_065: [ If the sink's queue is full and its policy is BROKER_QUEUE_POLICY_DROP_NEWEST, Broker_Publish shall discard the clone. ]*/
+        *dropped = msg;
+        result = 0;
+        break;
+    case BROKER_QUEUE_POLICY_DROP_OLDEST:
+        /*Codes_SRS_BROKER_17_064: [ If the sink's queue is full and its policy is BROKER_QUEUE_POLICY_DROP_OLDEST, Broker_Publish shall discard the oldest queued message and queue the clone. ]*/
+        *dropped = MESSAGE_QUEUE_pop(module_info->mq);
+        result = MESSAGE_QUEUE_push(module_info->mq, msg);
+        break;
+    default:
+        /*Codes_SRS_BROKER_17_066: [ If the sink's queue is full and its policy is BROKER_QUEUE_POLICY_BLOCK, Broker_Publish shall wait on BROKER_MODULEINFO::mq_space_cond until the queue has room or the worker is asked to quit, then queue the clone. ]*/
+        result = 0;
+        while (result == 0 && !module_info->quit_worker && !module_info->detaching && MESSAGE_QUEUE_is_full(module_info->mq))
+        {
+            /*the caller holds epoch, a routing table replacement waits for it to let go*/
+            if (ROUTING_ATOMIC_LOAD(&broker_data->routing_epoch) != epoch)
+            {
+                routing_replaced = true;
+                break;
+            }
+            if (Condition_Wait(module_info->mq_space_cond, module_info->mq_lock, 0) != COND_OK)
+            {
+                LogError("unable to wait for room in the queue of module [%p]", module_info);
+                result = __LINE__;
+            }
+        }
+        if (result == 0)
+        {
+            if (module_info->detaching)
+            {
+                /*Codes_SRS_BROKER_17_085: [ If the sink's policy is BROKER_QUEUE_POLICY_BLOCK and BROKER_MODULEINFO::detaching is set, Broker_Publish shall stop waiting and discard the clone. ]*/
+                *dropped = msg;
+            }
+            else if (routing_replaced)
+            {
+                /*Codes_SRS_BROKER_17_087: [ If the sink's policy is BROKER_QUEUE_POLICY_BLOCK and the routing table is replaced while the queue is full, Broker_Publish shall stop waiting and discard the clone. ]*/
+                *dropped = msg;
+            }
+            else
+            {
+                result = MESSAGE_QUEUE_push(module_info->mq, msg);
+            }
+        }
+        break;
+    }
+
+    if (*dropped != NULL)
+    {
+        /*Codes_SRS_BROKER_17_067: [ Broker_Publish shall count every message discarded by a queue policy in BROKER_MODULEINFO::dropped_messages. ]*/
+        module_info->dropped_messages++;
+        /*log the first drop and then progressively less often*/
+        if ((module_info->dropped_messages & (module_info->dropped_messages - 1)) == 0)
+        {
+            LogError("queue of module [%p] is full, %zu messages dropped so far", module_info, module_info->dropped_messages);
+        }
+    }
+
+    return result;
+}
+
+/*queues a reference to message for delivery to module_info, returns 0 on success, otherwise __LINE__*/
+static int enqueue_message(BROKER_HANDLE_DATA* broker_data, long epoch, BROKER_MODULEINFO* module_info, MESSAGE_HANDLE message)
+{
+    int result;
+
+    /*Codes_SRS_BROKER_17_007: [ Broker_Publish shall clone the message for every module linked to source. ]*/
+    MESSAGE_HANDLE msg = Message_Clone(message);
+    if (msg == NULL)
+    {
+        LogError("unable to clone message [%p]", message);
+        result = __LINE__;
+    }
+    else if (Lock(module_info->mq_lock) != LOCK_OK)
+    {
+        /*Codes_SRS_BROKER_17_051: [ If the message cannot be queued, Broker_Publish shall destroy the clone, continue delivering to the remaining sinks and return BROKER_ERROR. ]*/
+        LogError("unable to lock queue for module [%p]", module_info);
+        Message_Destroy(msg);
+        result = __LINE__;
+    }
+    else
+    {
+        MESSAGE_HANDLE dropped = NULL;
+        bool schedule = false;
+
+        /*Codes_SRS_BROKER_17_050: [ Broker_Publish shall push the clone onto the sink's BROKER_MODULEINFO::mq while holding BROKER_MODULEINFO::mq_lock and signal BROKER_MODULEINFO::mq_cond. ]*/
+        int push_result = MESSAGE_QUEUE_push(module_info->mq, msg);
+        if (push_result != 0 && MESSAGE_QUEUE_is_full(module_info->mq))
+        {
+            push_result = enqueue_on_full_queue(broker_data, epoch, module_info, msg, &dropped);
+        }
+
+        if (push_result != 0)
+        {
+            /*Codes_SRS_BROKER_17_051: [ If the message cannot be queued, Broker_Publish shall destroy the clone, continue delivering to the remaining sinks and return BROKER_ERROR. ]*/
+            LogError("unable to queue message [%p] for module [%p]", msg, module_info);
+            Message_Destroy(msg);
+            result = __LINE__;
+        }
+        else
+        {
+            if (module_info->home_worker == NULL)
+            {
+                (void)Condition_Post(module_info->mq_cond);
+            }
+            else if (!module_info->scheduled)
+            {
+                /*Codes_SRS_BROKER_17_076: [ If the sink is run by the thread pool and is not already scheduled, Broker_Publish shall mark it as scheduled and hand it to the pool instead of signaling BROKER_MODULEINFO::mq_cond. ]*/
+                module_info->scheduled = true;
+                schedule = true;
+            }
+            result = 0;
+        }
+        (void)Unlock(module_info->mq_lock);
+
+        if (schedule)
+        {
+            pool_schedule(module_info);
+        }
+
+        if (dropped != NULL)
+        {
+            Message_Destroy(dropped);
+        }
+    }
+
+    return result;
+}
+
 BROKER_RESULT Broker_Publish(BROKER_HANDLE broker, MODULE_HANDLE source, MESSAGE_HANDLE message)
 {
     BROKER_RESULT result;
@@ -795,72 +1809,35 @@ BROKER_RESULT Broker_Publish(BROKER_HANDLE broker, MODULE_HANDLE source, MESSAGE
     else
     {
         BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
-        /*Codes_SRS_BROKER_17_022: [ Broker_Publish shall Lock the modules lock. ]*/
-        if (Lock(broker_data->modules_lock) != LOCK_OK)
-        {
-            /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
-            LogError("Lock on broker_data->modules_lock failed");
-            result = BROKER_ERROR;
-        }
-        else
+        long epoch;
+
+        /*Codes_SRS_BROKER_17_022: [ Broker_Publish shall acquire the current routing table without taking the modules lock. ]*/
+        const BROKER_ROUTING_TABLE* routing = routing_acquire(broker_data, &epoch);
+
+        /*Codes_SRS_BROKER_17_059: [ Broker_Publish shall look up the sinks of source in the routing table and visit only those sinks. ]*/
+        const BROKER_SOURCE_ROUTES* source_routes = routing_table_lookup(routing, source);
+
+        result = BROKER_OK;
+
+        if (source_routes != NULL)
         {
-            int32_t msg_size;
-            int32_t buf_size;
-            /*Codes_SRS_BROKER_17_007: [ Broker_Publish shall clone the message. ]*/
-            MESSAGE_HANDLE msg = Message_Clone(message);
-            /*Codes_SRS_BROKER_17_008: [ Broker_Publish shall serialize the message. ]*/
-            msg_size = Message_ToByteArray(message, NULL, 0);
-            if (msg_size < 0)
-            {
-                /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
-                LogError("unable to serialize a message [%p]", msg);
-                Message_Destroy(msg);
-                result = BROKER_ERROR;
-            }
-            else
+            size_t i;
+            size_t end = source_routes->first_route + source_routes->route_count;
+
+            /* messages never leave the process here, so every sink gets a reference to the same message */
+            for (i = source_routes->first_route; i < end; i++)
             {
-                /*Codes_SRS_BROKER_17_025: [ Broker_Publish shall allocate a nanomsg buffer the size of the serialized message + sizeof(MODULE_HANDLE). ]*/
-                buf_size = msg_size + sizeof(MODULE_HANDLE);
-                void* nn_msg = nn_allocmsg(buf_size, 0);
-                if (nn_msg == NULL)
+                if (enqueue_message(broker_data, epoch, routing->routes[i].sink, message) != 0)
                 {
-                    /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
-                    LogError("unable to serialize a message [%p]", msg);
+                    /*Codes_SRS_BROKER_13_037: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
                     result = BROKER_ERROR;
                 }
-                else
-                {
-                    /*Codes_SRS_BROKER_17_026: [ Broker_Publish shall copy source into the beginning of the nanomsg buffer. ]*/
-                    unsigned char *nn_msg_bytes = (unsigned char *)nn_msg;
-                    memcpy(nn_msg_bytes, &source, sizeof(MODULE_HANDLE));
-                    /*Codes_SRS_BROKER_17_027: [ Broker_Publish shall serialize the message into the remainder of the nanomsg buffer. ]*/
-                    nn_msg_bytes += sizeof(MODULE_HANDLE);
-                    Message_ToByteArray(message, nn_msg_bytes, msg_size);
-
-                    /*Codes_SRS_BROKER_17_010: [ Broker_Publish shall send a message on the publish_socket. ]*/
-                    int nbytes = nn_send(broker_data->publish_socket, &nn_msg, NN_MSG, 0);
-                    if (nbytes != buf_size)
-                    {
-                        /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
-                        LogError("unable to send a message [%p]", msg);
-                        /*Codes_SRS_BROKER_17_012: [ Broker_Publish shall free the message. ]*/
-                        nn_freemsg(nn_msg);
-                        result = BROKER_ERROR;
-                    }
-                    else
-                    {
-                        result = BROKER_OK;
-                    }
-                }
-                /*Codes_SRS_BROKER_17_012: [ Broker_Publish shall free the message. ]*/
-                Message_Destroy(msg);
-                /*Codes_SRS_BROKER_17_011: [ Broker_Publish shall free the serialized message data. ]*/
             }
-            /*Codes_SRS_BROKER_17_023: [ Broker_Publish shall Unlock the modules lock. ]*/
-            Unlock(broker_data->modules_lock);
         }
 
+        /*Codes_SRS_BROKER_17_023: [ Broker_Publish shall release the routing table. ]*/
+        routing_release(broker_data, epoch);
     }
     /*Codes_SRS_BROKER_13_037: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
     return result;
-}
\ No newline at end of file
+}
@@ -2,6 +2,8 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/macro_utils.h"
@@ -20,6 +22,12 @@
 #define LOADER_ENTRYPOINT_KEY "entrypoint"
 #define MODULE_PATH_KEY "module.path"
 #define ARG_KEY "args"
+#define QUEUE_KEY "queue"
+#define QUEUE_CAPACITY_KEY "capacity"
+#define QUEUE_POLICY_KEY "policy"
+#define DEDICATED_THREAD_KEY "dedicated_thread"
+#define SCHEDULER_KEY "scheduler"
+#define SCHEDULER_THREADS_KEY "threads"
 
 #define LINKS_KEY "links"
 #define SOURCE_KEY "source"
@@ -67,6 +75,7 @@ GATEWAY_HANDLE Gateway_CreateFromJson(const char* file_path)
                 {
                     properties->gateway_modules = NULL;
                     properties->gateway_links = NULL;
+                    properties->scheduler_threads = 0;
                     if ((parse_json_internal(properties, root_value) == PARSE_JSON_SUCCESS) && properties->gateway_modules != NULL && properties->gateway_links != NULL)
                     {
                         /*Codes_SRS_GATEWAY_JSON_14_007: [The function shall use the GATEWAY_PROPERTIES instance to create and return a GATEWAY_HANDLE using the lower level API.]*/
@@ -186,6 +195,7 @@ GATEWAY_UPDATE_FROM_JSON_RESULT Gateway_UpdateFromJson(GATEWAY_HANDLE gw, const
             {
                 properties->gateway_modules = NULL;
                 properties->gateway_links = NULL;
+                properties->scheduler_threads = 0;
                 /* Codes_SRS_GATEWAY_JSON_04_007: [ The function shall traverse the JSON_Value object to initialize a GATEWAY_PROPERTIES instance. ] */
                 /* Codes_SRS_GATEWAY_JSON_04_011: [ The function shall be able to add just `modules`, just `links` or both. ] */
                 if (parse_json_internal(properties, root_value) != PARSE_JSON_SUCCESS)
@@ -446,6 +456,88 @@ static PARSE_JSON_RESULT parse_loader(JSON_Object* loader_json, GATEWAY_MODULE_L
     return result;
 }
 
+static PARSE_JSON_RESULT parse_queue(JSON_Object* queue_json, BROKER_QUEUE_CONFIG* queue_config)
+{
+    PARSE_JSON_RESULT result;
+
+    queue_config->capacity = 0;
+    queue_config->policy = BROKER_QUEUE_POLICY_DROP_OLDEST;
+    queue_config->dedicated_thread = false;
+
+    if (queue_json == NULL)
+    {
+        /*Codes_SRS_GATEWAY_JSON_17_015: [ If a module has no "queue" object, the module's messages shall be queued without bound. ]*/
+        result = PARSE_JSON_SUCCESS;
+    }
+    else
+    {
+        /*Codes_SRS_GATEWAY_JSON_17_016: [ The function shall parse "queue.capacity", a positive integer, and "queue.policy", one of "drop_oldest", "drop_newest" or "block", which defaults to "drop_oldest". ]*/
+        double capacity = json_object_get_number(queue_json, QUEUE_CAPACITY_KEY);
+        const char* policy = json_object_get_string(queue_json, QUEUE_POLICY_KEY);
+        if (capacity < 1 || capacity > INT_MAX || capacity != (double)(int)capacity)
+        {
+            /*Codes_SRS_GATEWAY_JSON_17_017: [ If "queue.capacity" or "queue.policy" are invalid, the function shall fail and return NULL. ]*/
+            LogError("\"queue.capacity\" must be a positive integer.");
+            result = PARSE_JSON_MISSING_OR_MISCONFIGURED_CONFIG;
+        }
+        else
+        {
+            queue_config->capacity = (size_t)capacity;
+            result = PARSE_JSON_SUCCESS;
+            if (policy == NULL || strcmp(policy, "drop_oldest") == 0)
+            {
+                queue_config->policy = BROKER_QUEUE_POLICY_DROP_OLDEST;
+            }
+            else if (strcmp(policy, "drop_newest") == 0)
+            {
+                queue_config->policy = BROKER_QUEUE_POLICY_DROP_NEWEST;
+            }
+            else if (strcmp(policy, "block") == 0)
+            {
+                queue_config->policy = BROKER_QUEUE_POLICY_BLOCK;
+            }
+            else
+            {
+                /*Codes_SRS_GATEWAY_JSON_17_017: [ If "queue.capacity" or "queue.policy" are invalid, the function shall fail and return NULL. ]*/
+                LogError("\"queue.policy\" has an unknown value - %s.", policy);
+                result = PARSE_JSON_MISSING_OR_MISCONFIGURED_CONFIG;
+            }
+        }
+    }
+
+    return result;
+}
+
+static PARSE_JSON_RESULT parse_scheduler(JSON_Object* scheduler_json, size_t* scheduler_threads)
+{
+    PARSE_JSON_RESULT result;
+
+    if (scheduler_json == NULL)
+    {
+        /*Codes_SRS_GATEWAY_JSON_17_018: [ If there is no "scheduler" object, every module shall get a thread of its own. ]*/
+        *scheduler_threads = 0;
+        result = PARSE_JSON_SUCCESS;
+    }
+    else
+    {
+        /*Codes_SRS_GATEWAY_JSON_17_019: [ The function shall parse "scheduler.threads", a non-negative integer, as the number of threads shared by the modules. ]*/
+        double threads = json_object_get_number(scheduler_json, SCHEDULER_THREADS_KEY);
+        if (threads < 0 || threads > INT_MAX || threads != (double)(int)threads)
+        {
+            /*Codes_SRS_GATEWAY_JSON_17_020: [ If "scheduler.threads" is invalid, the function shall fail and return NULL. ]*/
+            LogError("\"scheduler.threads\" must be a non-negative integer.");
+            result = PARSE_JSON_MISSING_OR_MISCONFIGURED_CONFIG;
+        }
+        else
+        {
+            *scheduler_threads = (size_t)threads;
+            result = PARSE_JSON_SUCCESS;
+        }
+    }
+
+    return result;
+}
+
 static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties, JSON_Value *root)
 {
     PARSE_JSON_RESULT result;
@@ -462,7 +554,12 @@ static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties,
             JSON_Array *modules_array = json_object_get_array(json_document, MODULES_KEY);
             JSON_Array *links_array = json_object_get_array(json_document, LINKS_KEY);
 
-            if (modules_array != NULL || links_array != NULL)
+            if (parse_scheduler(json_object_get_object(json_document, SCHEDULER_KEY), &out_properties->scheduler_threads) != PARSE_JSON_SUCCESS)
+            {
+                result = PARSE_JSON_MISSING_OR_MISCONFIGURED_CONFIG;
+                LogError("\"scheduler\" in input JSON configuration is misconfigured.");
+            }
+            else if (modules_array != NULL || links_array != NULL)
             {
                 if (modules_array != NULL)
                 {
@@ -489,8 +586,19 @@ static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties,
                             else
                             {
                                 const char* module_name = json_object_get_string(module, MODULE_NAME_KEY);
-                                if (module_name != NULL)
+                                BROKER_QUEUE_CONFIG queue_config;
+                                if (module_name != NULL && parse_queue(json_object_get_object(module, QUEUE_KEY), &queue_config) != PARSE_JSON_SUCCESS)
                                 {
+                                    loader_info.loader->api->FreeEntrypoint(loader_info.loader, loader_info.entrypoint);
+                                    result = PARSE_JSON_MISSING_OR_MISCONFIGURED_CONFIG;
+                                    LogError("\"queue\" of module %s in input JSON configuration is misconfigured.", module_name);
+                                    break;
+                                }
+                                else if (module_name != NULL)
+                                {
+                                    /*Codes_SRS_GATEWAY_JSON_17_021: [ The function shall give a module a thread of its own when its "dedicated_thread" value is true. ]*/
+                                    queue_config.dedicated_thread = (json_object_get_boolean(module, DEDICATED_THREAD_KEY) == 1);
+
                                     /*Codes_SRS_GATEWAY_JSON_14_005: [The function shall set the value of const void* module_properties in the GATEWAY_PROPERTIES instance to a char* representing the serialized args value for the particular module.]*/
                                     JSON_Value *args = json_object_get_value(module, ARG_KEY);
                                     char* args_str = json_serialize_to_string(args);
@@ -498,7 +606,8 @@ static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties,
                                     GATEWAY_MODULES_ENTRY entry = {
                                         module_name,
                                         loader_info,
-                                        args_str
+                                        args_str,
+                                        queue_config
                                     };
 
                                     /*Codes_SRS_GATEWAY_JSON_14_006: [The function shall return NULL if the JSON_Value contains incomplete information.]*/
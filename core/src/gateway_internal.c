@@ -147,7 +147,10 @@ GATEWAY_HANDLE gateway_create_internal(const GATEWAY_PROPERTIES* properties, boo
         memset(gateway, 0, sizeof(GATEWAY_HANDLE_DATA));
 
         /*Codes_SRS_GATEWAY_14_003: [This function shall create a new BROKER_HANDLE for the gateway representing this gateway's message broker. ]*/
-        gateway->broker = Broker_Create();
+        /*Codes_SRS_GATEWAY_17_023: [ If GATEWAY_PROPERTIES's scheduler_threads is not 0, the function shall create the broker with Broker_CreateWithThreadPool. ]*/
+        gateway->broker = (properties != NULL && properties->scheduler_threads > 0) ?
+            Broker_CreateWithThreadPool(properties->scheduler_threads) :
+            Broker_Create();
         if (gateway->broker == NULL)
         {
             /*Codes_SRS_GATEWAY_14_004: [This function shall return NULL if a BROKER_HANDLE cannot be created.]*/
@@ -445,9 +448,9 @@ MODULE_HANDLE gateway_addmodule_internal(GATEWAY_HANDLE_DATA* gateway_handle, co
                         module.module_apis = module_apis;
                         module.module_handle = module_handle;
 
-                        /*Codes_SRS_GATEWAY_14_017: [The function shall attach the module to the GATEWAY_HANDLE_DATA's broker using a call to Broker_AddModule. ]*/
+                        /*Codes_SRS_GATEWAY_14_017: [The function shall attach the module to the GATEWAY_HANDLE_DATA's broker using a call to Broker_AddModuleWithQueue with the GATEWAY_MODULES_ENTRY's queue_configuration. ]*/
                         /*Codes_SRS_GATEWAY_14_018: [If the function cannot attach the module to the message broker, the function shall return NULL.]*/
-                        if (Broker_AddModule(gateway_handle->broker, &module) != BROKER_OK)
+                        if (Broker_AddModuleWithQueue(gateway_handle->broker, &module, &module_entry->queue_configuration) != BROKER_OK)
                         {
                             free(new_module_data);
                             module_result = NULL;
@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include <stddef.h>
+#include <string.h>
 #include <inttypes.h>
 #include "azure_c_shared_utility/gballoc.h"
 
@@ -12,26 +13,63 @@
 #include "azure_c_shared_utility/constmap.h"
 #include "azure_c_shared_utility/xlogging.h"
 
-#include "azure_c_shared_utility/refcount.h"
-
 #define FIRST_MESSAGE_BYTE 0xA1  /*0xA1 comes from (A)zure (I)oT*/
 #define SECOND_MESSAGE_BYTE 0x60 /*0x60 comes from (G)ateway*/
 
 #define MIN_MESSAGE_BUFFER_LENGTH 14 /*14 is the minimum message length that is still valid*/
 
+/*content up to this size is stored in the same memory block as the message*/
+#define MESSAGE_INLINE_CONTENT_MAX 1024
+
+/*messages are reference counted and parts of them are built lazily by whichever thread needs them first*/
+#ifdef _WIN32
+#include <windows.h>
+#define MESSAGE_ATOMIC_INC(p)                   InterlockedIncrement(p)
+#define MESSAGE_ATOMIC_DEC(p)                   InterlockedDecrement(p)
+#define MESSAGE_ATOMIC_LOAD_PTR(p)              InterlockedCompareExchangePointer((PVOID volatile*)(p), NULL, NULL)
+#define MESSAGE_ATOMIC_CAS_PTR(p, expected, v)  InterlockedCompareExchangePointer((PVOID volatile*)(p), (v), (expected))
+#else
+#define MESSAGE_ATOMIC_INC(p)                   __atomic_add_fetch((p), 1, __ATOMIC_SEQ_CST)
+#define MESSAGE_ATOMIC_DEC(p)                   __atomic_sub_fetch((p), 1, __ATOMIC_SEQ_CST)
+#define MESSAGE_ATOMIC_LOAD_PTR(p)              __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define MESSAGE_ATOMIC_CAS_PTR(p, expected, v)  __sync_val_compare_and_swap((p), (expected), (v))
+#endif
+
+/*properties are kept exactly as they are serialized by Message_ToByteArray
+(name\0value\0name\0value\0...) together with a pointer to where each name starts.
+The CONSTMAP is only built if somebody asks for it.*/
+typedef struct MESSAGE_PROPERTY_INDEX_TAG
+{
+    size_t count;
+    size_t size;            /*number of serialized bytes at encoded*/
+    const char** names;     /*the value of property i starts right after the '\0' of names[i]*/
+    char* encoded;
+}MESSAGE_PROPERTY_INDEX;
+
+/*a message is allocated as a single block:
+    MESSAGE_HANDLE_DATA | index.names | index.encoded | content (if not bigger than MESSAGE_INLINE_CONTENT_MAX)
+so that in the common case creating a message costs one allocation and destroying it one free*/
 typedef struct MESSAGE_HANDLE_DATA_TAG
 {
-    CONSTMAP_HANDLE properties;
-    CONSTBUFFER_HANDLE content;
+    volatile long refCount;
+    CONSTMAP_HANDLE properties;         /*NULL until first needed*/
+    CONSTBUFFER content;                /*what Message_GetContent returns*/
+    CONSTBUFFER_HANDLE contentHandle;   /*NULL until first needed if the content is not held by a CONSTBUFFER*/
+    MESSAGE_CONTENT_DEALLOCATOR contentDeallocator; /*non-NULL if the content was adopted by Message_CreateWithOwnership*/
+    void* contentDeallocatorContext;
+    struct MESSAGE_HANDLE_DATA_TAG* parent; /*non-NULL if created by Message_CreateDerived, content and unchanged properties live there*/
+    CONSTBUFFER* serialized;            /*NULL until first needed, what Message_ToByteArray writes, the bytes follow the CONSTBUFFER*/
+    MESSAGE_PROPERTY_INDEX index;
 }MESSAGE_HANDLE_DATA;
 
-DEFINE_REFCOUNT_TYPE(MESSAGE_HANDLE_DATA);
-
-static MESSAGE_HANDLE_DATA* Message_CreateImpl(const MESSAGE_CONFIG * cfg)
+/*allocates a message with room for the serialized properties. The content is cloned from sourceContent
+or, if sourceContent is NULL, copied from source*/
+static MESSAGE_HANDLE_DATA* Message_CreateImpl(size_t propertyCount, size_t propertiesSize, const unsigned char* source, size_t size, CONSTBUFFER_HANDLE sourceContent)
 {
     MESSAGE_HANDLE_DATA* result;
-    /*Codes_SRS_MESSAGE_02_006: [Otherwise, Message_Create shall return a non-NULL handle and shall set the internal ref count to "1".]*/
-    result = REFCOUNT_TYPE_CREATE(MESSAGE_HANDLE_DATA);
+    int isInline = (sourceContent == NULL) && (size <= MESSAGE_INLINE_CONTENT_MAX);
+
+    result = (MESSAGE_HANDLE_DATA*)malloc(sizeof(MESSAGE_HANDLE_DATA) + propertyCount * sizeof(const char*) + propertiesSize + (isInline ? size : 0));
     if (result == NULL)
     {
         LogError("malloc returned NULL");
@@ -39,31 +77,356 @@ static MESSAGE_HANDLE_DATA* Message_CreateImpl(const MESSAGE_CONFIG * cfg)
     }
     else
     {
-        /*Codes_SRS_MESSAGE_02_004: [Mesages shall be allowed to be created from zero-size content.]*/
-        /*Codes_SRS_MESSAGE_02_015: [The MESSAGE_CONTENT's field size shall have the same value as the cfg's field size.]*/
-        /*Codes_SRS_MESSAGE_17_003: [Message_Create shall copy the source to a readonly CONSTBUFFER.]*/
-        result->content = CONSTBUFFER_Create(cfg->source, cfg->size);
-        if (result->content == NULL)
+        result->refCount = 1;
+        result->properties = NULL;
+        result->serialized = NULL;
+        result->contentDeallocator = NULL;
+        result->contentDeallocatorContext = NULL;
+        result->parent = NULL;
+        result->index.count = propertyCount;
+        result->index.size = propertiesSize;
+        result->index.names = (const char**)(result + 1);
+        result->index.encoded = (char*)(result->index.names + propertyCount);
+
+        if (isInline)
         {
-            LogError("CONSBUFFER_Create failed");
-            free(result);
-            result = NULL;
+            /*Codes_SRS_MESSAGE_17_030: [ Content of at most 1024 bytes shall be copied into the same memory block as the message. ]*/
+            /*Codes_SRS_MESSAGE_02_004: [Mesages shall be allowed to be created from zero-size content.]*/
+            /*Codes_SRS_MESSAGE_02_015: [The MESSAGE_CONTENT's field size shall have the same value as the cfg's field size.]*/
+            result->contentHandle = NULL;
+            result->content.size = size;
+            if (size == 0)
+            {
+                result->content.buffer = NULL;
+            }
+            else
+            {
+                unsigned char* inlineContent = (unsigned char*)(result->index.encoded + propertiesSize);
+                memcpy(inlineContent, source, size);
+                result->content.buffer = inlineContent;
+            }
         }
         else
         {
-            /*Codes_SRS_MESSAGE_02_019: [Message_Create shall clone the sourceProperties to a readonly CONSTMAP.]*/
-            result->properties = ConstMap_Create(cfg->sourceProperties);
-            if (result->properties == NULL)
+            if (sourceContent != NULL)
+            {
+                /*Codes_SRS_MESSAGE_17_013: [Message_CreateFromBuffer shall clone the CONSTBUFFER sourceBuffer.]*/
+                result->contentHandle = CONSTBUFFER_Clone(sourceContent);
+            }
+            else
+            {
+                /*Codes_SRS_MESSAGE_17_003: [Message_Create shall copy the source to a readonly CONSTBUFFER if it is bigger than 1024 bytes.]*/
+                result->contentHandle = CONSTBUFFER_Create(source, size);
+            }
+
+            if (result->contentHandle == NULL)
             {
-                /*Codes_SRS_MESSAGE_02_005: [If Message_Create encounters an error while building the internal structures of the message, then it shall return NULL.] */
-                LogError("ConstMap_Create failed");
-                CONSTBUFFER_Destroy(result->content);
+                LogError("unable to create the content CONSTBUFFER");
                 free(result);
                 result = NULL;
             }
             else
             {
-                /*all is fine, return as is.*/
+                result->content = *CONSTBUFFER_GetContent(result->contentHandle);
+            }
+        }
+    }
+    return result;
+}
+
+/*fills in where every property name starts, the serialized properties have already been validated*/
+static void Message_IndexProperties(MESSAGE_HANDLE_DATA* messageData)
+{
+    size_t i;
+    const char* name = messageData->index.encoded;
+    for (i = 0; i < messageData->index.count; i++)
+    {
+        messageData->index.names[i] = name;
+        name += strlen(name) + 1; /*skip the name*/
+        name += strlen(name) + 1; /*skip the value*/
+    }
+}
+
+/*computes the serialized size of the properties of a MAP_HANDLE*/
+static int Message_GetPropertiesSize(MAP_HANDLE sourceProperties, const char* const** keys, const char* const** values, size_t* count, size_t* size)
+{
+    int result;
+    if (Map_GetInternals(sourceProperties, keys, values, count) != MAP_OK)
+    {
+        LogError("unable to get the keys and values of the properties");
+        result = __LINE__;
+    }
+    else
+    {
+        size_t i;
+        *size = 0;
+        for (i = 0; i < *count; i++)
+        {
+            *size += (strlen((*keys)[i]) + 1) + (strlen((*values)[i]) + 1);
+        }
+        result = 0;
+    }
+    return result;
+}
+
+static void Message_EncodeProperties(MESSAGE_HANDLE_DATA* messageData, const char* const* keys, const char* const* values)
+{
+    size_t i;
+    char* position = messageData->index.encoded;
+    for (i = 0; i < messageData->index.count; i++)
+    {
+        size_t nameLength = strlen(keys[i]) + 1;/*the +1 will take care of copying '\0' too*/
+        size_t valueLength = strlen(values[i]) + 1;/*the +1 will take care of copying '\0' too*/
+
+        messageData->index.names[i] = position;
+        memcpy(position, keys[i], nameLength);
+        position += nameLength;
+        memcpy(position, values[i], valueLength);
+        position += valueLength;
+    }
+}
+
+static const char* Message_FindProperty(const MESSAGE_PROPERTY_INDEX* index, const char* name)
+{
+    const char* result = NULL;
+    size_t i;
+    for (i = 0; i < index->count; i++)
+    {
+        if (strcmp(index->names[i], name) == 0)
+        {
+            result = index->names[i] + strlen(index->names[i]) + 1;
+            break;
+        }
+    }
+    return result;
+}
+
+/*returns the serialized size of the property starting at name*/
+static size_t Message_PropertySize(const char* name, const char* value)
+{
+    return (strlen(name) + 1) + (strlen(value) + 1);
+}
+
+/*returns the last edit of the property called name, or NULL if no edit names it*/
+static const MESSAGE_PROPERTY_EDIT* Message_FindEdit(const MESSAGE_PROPERTY_EDIT* edits, size_t editCount, const char* name)
+{
+    const MESSAGE_PROPERTY_EDIT* result = NULL;
+    size_t i = editCount;
+    while (i > 0)
+    {
+        i--;
+        if (strcmp(edits[i].name, name) == 0)
+        {
+            result = &edits[i];
+            break;
+        }
+    }
+    return result;
+}
+
+/*walks the properties a derived message ends up with. If derived is NULL it only counts them, otherwise
+it fills in its index: unchanged properties point into parent, added and replaced ones are written to derived*/
+static void Message_ApplyEdits(const MESSAGE_HANDLE_DATA* parent, const MESSAGE_PROPERTY_EDIT* edits, size_t editCount, MESSAGE_HANDLE_DATA* derived, size_t* count, size_t* ownSize, size_t* totalSize)
+{
+    size_t i;
+    char* position = (derived == NULL) ? NULL : derived->index.encoded;
+    *count = 0;
+    *ownSize = 0;
+    *totalSize = 0;
+
+    /*Codes_SRS_MESSAGE_17_044: [ Message_CreateDerived shall keep the properties of message that no edit names, in the same order, without copying them. ]*/
+    /*Codes_SRS_MESSAGE_17_045: [ Message_CreateDerived shall replace the value of a property of message named by an edit with a non-NULL value, in the same position. ]*/
+    /*Codes_SRS_MESSAGE_17_046: [ Message_CreateDerived shall remove a property of message named by an edit with a NULL value. ]*/
+    for (i = 0; i < parent->index.count; i++)
+    {
+        const char* name = parent->index.names[i];
+        const MESSAGE_PROPERTY_EDIT* edit = Message_FindEdit(edits, editCount, name);
+        if (edit == NULL)
+        {
+            if (derived != NULL)
+            {
+                derived->index.names[*count] = name;
+            }
+            (*count)++;
+            *totalSize += Message_PropertySize(name, name + strlen(name) + 1);
+        }
+        else if (edit->value != NULL)
+        {
+            size_t size = Message_PropertySize(name, edit->value);
+            if (derived != NULL)
+            {
+                size_t nameLength = strlen(name) + 1;
+                derived->index.names[*count] = position;
+                memcpy(position, name, nameLength);
+                memcpy(position + nameLength, edit->value, size - nameLength);
+                position += size;
+            }
+            (*count)++;
+            *ownSize += size;
+            *totalSize += size;
+        }
+        else
+        {
+            /*removed*/
+        }
+    }
+
+    /*Codes_SRS_MESSAGE_17_047: [ Message_CreateDerived shall add the properties named by edits with a non-NULL value that message does not have, after the properties of message, in the order of edits. ]*/
+    /*Codes_SRS_MESSAGE_17_048: [ If several edits name the same property, Message_CreateDerived shall only apply the last one. ]*/
+    for (i = 0; i < editCount; i++)
+    {
+        if (
+            (edits[i].value != NULL) &&
+            (Message_FindEdit(edits + i, editCount - i, edits[i].name) == &edits[i]) &&
+            (Message_FindProperty(&parent->index, edits[i].name) == NULL)
+            )
+        {
+            size_t size = Message_PropertySize(edits[i].name, edits[i].value);
+            if (derived != NULL)
+            {
+                size_t nameLength = strlen(edits[i].name) + 1;
+                derived->index.names[*count] = position;
+                memcpy(position, edits[i].name, nameLength);
+                memcpy(position + nameLength, edits[i].value, size - nameLength);
+                position += size;
+            }
+            (*count)++;
+            *ownSize += size;
+            *totalSize += size;
+        }
+    }
+}
+
+/*returns the CONSTMAP of the message without cloning it, building it first if needed*/
+static CONSTMAP_HANDLE Message_GetPropertiesImpl(MESSAGE_HANDLE_DATA* messageData)
+{
+    CONSTMAP_HANDLE result = MESSAGE_ATOMIC_LOAD_PTR(&messageData->properties);
+    if (result == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_022: [ If the properties of the message have not been decoded yet, Message_GetProperties shall create a MAP_HANDLE, add all the serialized properties to it and copy it to a readonly CONSTMAP. ]*/
+        MAP_HANDLE map = Map_Create(NULL);
+        if (map == NULL)
+        {
+            /*Codes_SRS_MESSAGE_17_023: [ If decoding the properties fails, Message_GetProperties shall return NULL. ]*/
+            LogError("failed to create a MAP_HANDLE");
+        }
+        else
+        {
+            size_t i;
+            for (i = 0; i < messageData->index.count; i++)
+            {
+                const char* name = messageData->index.names[i];
+                if (Map_Add(map, name, name + strlen(name) + 1) != MAP_OK)
+                {
+                    LogError("Map_Add failed");
+                    break;
+                }
+            }
+
+            if (i == messageData->index.count)
+            {
+                CONSTMAP_HANDLE created = ConstMap_Create(map);
+                if (created == NULL)
+                {
+                    LogError("ConstMap_Create failed");
+                }
+                else
+                {
+                    /*Codes_SRS_MESSAGE_17_024: [ If several threads decode the properties at the same time, only the first CONSTMAP shall be kept and the others shall be destroyed. ]*/
+                    result = MESSAGE_ATOMIC_CAS_PTR(&messageData->properties, NULL, created);
+                    if (result != NULL)
+                    {
+                        ConstMap_Destroy(created);
+                    }
+                    else
+                    {
+                        result = created;
+                    }
+                }
+            }
+            Map_Destroy(map);
+        }
+    }
+    return result;
+}
+
+/*returns the content of the message as a CONSTBUFFER_HANDLE without cloning it, building it first if needed*/
+static CONSTBUFFER_HANDLE Message_GetContentHandleImpl(MESSAGE_HANDLE_DATA* messageData)
+{
+    CONSTBUFFER_HANDLE result = MESSAGE_ATOMIC_LOAD_PTR(&messageData->contentHandle);
+    if (result == NULL)
+    {
+        CONSTBUFFER_HANDLE created;
+        if (messageData->parent != NULL)
+        {
+            /*Codes_SRS_MESSAGE_17_050: [ The CONSTBUFFER_HANDLE of a message created by Message_CreateDerived shall be a clone of the CONSTBUFFER_HANDLE of the message it derives from. ]*/
+            CONSTBUFFER_HANDLE parentContent = Message_GetContentHandleImpl(messageData->parent);
+            created = (parentContent == NULL) ? NULL : CONSTBUFFER_Clone(parentContent);
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_17_032: [ If the content is not held by a CONSTBUFFER, the first call to Message_GetContentHandle shall copy it to a readonly CONSTBUFFER that is kept by the message. ]*/
+            created = CONSTBUFFER_Create(messageData->content.buffer, messageData->content.size);
+        }
+        if (created == NULL)
+        {
+            /*Codes_SRS_MESSAGE_17_033: [ If creating the CONSTBUFFER fails, Message_GetContentHandle shall return NULL. ]*/
+            LogError("CONSTBUFFER_Create failed");
+        }
+        else
+        {
+            result = MESSAGE_ATOMIC_CAS_PTR(&messageData->contentHandle, NULL, created);
+            if (result != NULL)
+            {
+                CONSTBUFFER_Destroy(created);
+            }
+            else
+            {
+                result = created;
+            }
+        }
+    }
+    return result;
+}
+
+/*returns the serialized message kept by messageData, serializing it first if needed*/
+static const CONSTBUFFER* Message_GetSerializedImpl(MESSAGE_HANDLE_DATA* messageData)
+{
+    CONSTBUFFER* result = MESSAGE_ATOMIC_LOAD_PTR(&messageData->serialized);
+    if (result == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_055: [ The first call to Message_GetSerialized shall serialize the message with Message_ToByteArray into a single allocation that is kept by the message. ]*/
+        int32_t size = Message_ToByteArray((MESSAGE_HANDLE)messageData, NULL, 0);
+        CONSTBUFFER* created = (size < 0) ? NULL : (CONSTBUFFER*)malloc(sizeof(CONSTBUFFER) + (size_t)size);
+        if (created == NULL)
+        {
+            /*Codes_SRS_MESSAGE_17_056: [ If serializing the message fails, Message_GetSerialized shall return NULL. ]*/
+            LogError("unable to allocate the serialized message");
+        }
+        else
+        {
+            unsigned char* bytes = (unsigned char*)(created + 1);
+            if (Message_ToByteArray((MESSAGE_HANDLE)messageData, bytes, size) != size)
+            {
+                /*Codes_SRS_MESSAGE_17_056: [ If serializing the message fails, Message_GetSerialized shall return NULL. ]*/
+                LogError("Message_ToByteArray failed");
+                free(created);
+            }
+            else
+            {
+                created->buffer = bytes;
+                created->size = size;
+
+                /*Codes_SRS_MESSAGE_17_057: [ If several threads serialize the message at the same time, only the first serialization shall be kept and the others shall be freed. ]*/
+                result = MESSAGE_ATOMIC_CAS_PTR(&messageData->serialized, NULL, created);
+                if (result != NULL)
+                {
+                    free(created);
+                }
+                else
+                {
+                    result = created;
+                }
             }
         }
     }
@@ -87,8 +450,25 @@ MESSAGE_HANDLE Message_Create(const MESSAGE_CONFIG * cfg)
     }
     else
     {
-        /*delegate to internal function that does not do validation*/
-        result = Message_CreateImpl(cfg);
+        const char* const* keys;
+        const char* const* values;
+        size_t count;
+        size_t propertiesSize;
+        if (Message_GetPropertiesSize(cfg->sourceProperties, &keys, &values, &count, &propertiesSize) != 0)
+        {
+            /*Codes_SRS_MESSAGE_02_005: [If Message_Create encounters an error while building the internal structures of the message, then it shall return NULL.] */
+            result = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_02_006: [Otherwise, Message_Create shall return a non-NULL handle and shall set the internal ref count to "1".]*/
+            result = Message_CreateImpl(count, propertiesSize, cfg->source, cfg->size, NULL);
+            if (result != NULL)
+            {
+                /*Codes_SRS_MESSAGE_17_029: [ Message_Create shall serialize the sourceProperties into the memory block of the message. ]*/
+                Message_EncodeProperties(result, keys, values);
+            }
+        }
     }
     return (MESSAGE_HANDLE)result;
 }
@@ -116,39 +496,133 @@ MESSAGE_HANDLE Message_CreateFromBuffer(const MESSAGE_BUFFER_CONFIG* cfg)
     }
     else
     {
-        /*Codes_SRS_MESSAGE_17_011: [If Message_CreateFromBuffer encounters an error while building the internal structures of the message, then it shall return NULL.]*/
-        /*Codes_SRS_MESSAGE_17_014: [On success, Message_CreateFromBuffer shall return a non-NULL handle and set the internal ref count to "1".]*/
-        result = REFCOUNT_TYPE_CREATE(MESSAGE_HANDLE_DATA);
-        if (result == NULL)
+        const char* const* keys;
+        const char* const* values;
+        size_t count;
+        size_t propertiesSize;
+        if (Message_GetPropertiesSize(cfg->sourceProperties, &keys, &values, &count, &propertiesSize) != 0)
         {
-            LogError("malloc returned NULL");
-            /*return as is*/
+            /*Codes_SRS_MESSAGE_17_011: [If Message_CreateFromBuffer encounters an error while building the internal structures of the message, then it shall return NULL.]*/
+            result = NULL;
         }
         else
         {
-            /*Codes_SRS_MESSAGE_17_013: [Message_CreateFromBuffer shall clone the CONSTBUFFER sourceBuffer.]*/
-            result->content = CONSTBUFFER_Clone(cfg->sourceContent);
-            if (result->content == NULL)
+            /*Codes_SRS_MESSAGE_17_014: [On success, Message_CreateFromBuffer shall return a non-NULL handle and set the internal ref count to "1".]*/
+            result = Message_CreateImpl(count, propertiesSize, NULL, 0, cfg->sourceContent);
+            if (result != NULL)
             {
-                LogError("CONSBUFFER Clone failed");
-                free(result);
-                result = NULL;
+                /*Codes_SRS_MESSAGE_17_012: [Message_CreateFromBuffer shall serialize the sourceProperties into the memory block of the message.]*/
+                Message_EncodeProperties(result, keys, values);
+            }
+        }
+    }
+    return (MESSAGE_HANDLE)result;
+}
+
+MESSAGE_HANDLE Message_CreateWithOwnership(const MESSAGE_OWNERSHIP_CONFIG* cfg)
+{
+    MESSAGE_HANDLE_DATA* result;
+    /*Codes_SRS_MESSAGE_17_034: [ If cfg is NULL then Message_CreateWithOwnership shall return NULL. ]*/
+    if (cfg == NULL)
+    {
+        result = NULL;
+        LogError("invalid parameter (NULL).");
+    }
+    /*Codes_SRS_MESSAGE_17_035: [ If field source, deallocator or sourceProperties of cfg is NULL, then Message_CreateWithOwnership shall fail and return NULL. ]*/
+    else if (
+        (cfg->source == NULL) ||
+        (cfg->deallocator == NULL) ||
+        (cfg->sourceProperties == NULL)
+        )
+    {
+        result = NULL;
+        LogError("invalid parameter combination cfg->source=%p, cfg->deallocator=%p, cfg->sourceProperties=%p", cfg->source, (void*)cfg->deallocator, cfg->sourceProperties);
+    }
+    else
+    {
+        const char* const* keys;
+        const char* const* values;
+        size_t count;
+        size_t propertiesSize;
+        if (Message_GetPropertiesSize(cfg->sourceProperties, &keys, &values, &count, &propertiesSize) != 0)
+        {
+            /*Codes_SRS_MESSAGE_17_036: [ If Message_CreateWithOwnership encounters an error while building the internal structures of the message, then it shall return NULL and shall not call deallocator. ]*/
+            result = NULL;
+        }
+        else
+        {
+            /*the content is not copied, so the block is allocated as for a message with no content*/
+            result = Message_CreateImpl(count, propertiesSize, NULL, 0, NULL);
+            if (result != NULL)
+            {
+                /*Codes_SRS_MESSAGE_17_037: [ Message_CreateWithOwnership shall serialize the sourceProperties into the memory block of the message. ]*/
+                Message_EncodeProperties(result, keys, values);
+
+                /*Codes_SRS_MESSAGE_17_038: [ Message_CreateWithOwnership shall use source as the content of the message without copying it. ]*/
+                result->content.buffer = cfg->source;
+                result->content.size = cfg->size;
+                result->contentDeallocator = cfg->deallocator;
+                result->contentDeallocatorContext = cfg->deallocatorContext;
+                /*Codes_SRS_MESSAGE_17_039: [ On success, Message_CreateWithOwnership shall return a non-NULL handle and set the internal ref count to "1". ]*/
+            }
+        }
+    }
+    return (MESSAGE_HANDLE)result;
+}
+
+MESSAGE_HANDLE Message_CreateDerived(MESSAGE_HANDLE message, const MESSAGE_PROPERTY_EDIT* edits, size_t editCount)
+{
+    MESSAGE_HANDLE_DATA* result;
+    size_t i;
+    /*Codes_SRS_MESSAGE_17_041: [ If message is NULL, or edits is NULL and editCount is not zero, then Message_CreateDerived shall return NULL. ]*/
+    if (
+        (message == NULL) ||
+        ((edits == NULL) && (editCount > 0))
+        )
+    {
+        result = NULL;
+        LogError("invalid parameter combination message=%p, edits=%p, editCount=%zu", message, edits, editCount);
+    }
+    else
+    {
+        for (i = 0; i < editCount; i++)
+        {
+            if (edits[i].name == NULL)
+            {
+                break;
+            }
+        }
+
+        if (i < editCount)
+        {
+            /*Codes_SRS_MESSAGE_17_042: [ If the name of any edit is NULL, then Message_CreateDerived shall return NULL. ]*/
+            result = NULL;
+            LogError("edit %zu has no property name", i);
+        }
+        else
+        {
+            MESSAGE_HANDLE_DATA* parent = (MESSAGE_HANDLE_DATA*)message;
+            size_t count;
+            size_t ownSize;
+            size_t totalSize;
+            Message_ApplyEdits(parent, edits, editCount, NULL, &count, &ownSize, &totalSize);
+
+            /*Codes_SRS_MESSAGE_17_043: [ Message_CreateDerived shall allocate a message with room for the added and replaced properties only. ]*/
+            result = Message_CreateImpl(count, ownSize, NULL, 0, NULL);
+            if (result == NULL)
+            {
+                /*Codes_SRS_MESSAGE_17_051: [ If Message_CreateDerived encounters an error while building the internal structures of the message, then it shall return NULL. ]*/
+                LogError("unable to create the derived message");
             }
             else
             {
-                /*Codes_SRS_MESSAGE_17_012: [Message_CreateFromBuffer shall copy the sourceProperties to a readonly CONSTMAP.]*/
-                result->properties = ConstMap_Create(cfg->sourceProperties);
-                if (result->properties == NULL)
-                {
-                    LogError("ConstMap_Create failed");
-                    CONSTBUFFER_Destroy(result->content);
-                    free(result);
-                    result = NULL;
-                }
-                else
-                {
-                    /*all is fine, return as is.*/
-				}
+                Message_ApplyEdits(parent, edits, editCount, result, &count, &ownSize, &totalSize);
+                result->index.size = totalSize;
+
+                /*Codes_SRS_MESSAGE_17_049: [ Message_CreateDerived shall share the content of message without copying it and shall keep a reference to message until the new message is destroyed. ]*/
+                result->content = parent->content;
+                result->parent = (MESSAGE_HANDLE_DATA*)Message_Clone(message);
+                /*Codes_SRS_MESSAGE_17_052: [ On success, Message_CreateDerived shall return a non-NULL handle and set the internal ref count to "1". ]*/
             }
         }
     }
@@ -165,12 +639,8 @@ MESSAGE_HANDLE Message_Clone(MESSAGE_HANDLE message)
     else
     {
         /*Codes_SRS_MESSAGE_02_008: [Otherwise, Message_Clone shall increment the internal ref count.] */
-        INC_REF(MESSAGE_HANDLE_DATA, message);
-        MESSAGE_HANDLE_DATA* messageData = (MESSAGE_HANDLE_DATA*)message;
-        /*Codes_SRS_MESSAGE_17_001: [Message_Clone shall clone the CONSTMAP handle.]*/
-        (void)ConstMap_Clone(messageData->properties);
-        /*Codes_SRS_MESSAGE_17_004: [Message_Clone shall clone the CONSTBUFFER handle]*/
-        (void)CONSTBUFFER_Clone(messageData->content);
+        /*Codes_SRS_MESSAGE_17_020: [ Message_Clone shall not clone the CONSTMAP nor the CONSTBUFFER handles, they are shared by all the references to the message. ]*/
+        (void)MESSAGE_ATOMIC_INC(&((MESSAGE_HANDLE_DATA*)message)->refCount);
     }
     /*Codes_SRS_MESSAGE_02_010: [Message_Clone shall return messageHandle.]*/
     return message;
@@ -189,7 +659,31 @@ CONSTMAP_HANDLE Message_GetProperties(MESSAGE_HANDLE message)
     {
         /*Codes_SRS_MESSAGE_02_012: [Otherwise, Message_GetProperties shall shall clone and return the CONSTMAP handle representing the properties of the message.]*/
         MESSAGE_HANDLE_DATA* messageData = (MESSAGE_HANDLE_DATA*)message;
-        result = ConstMap_Clone(messageData->properties);
+        result = Message_GetPropertiesImpl(messageData);
+        if (result != NULL)
+        {
+            result = ConstMap_Clone(result);
+        }
+    }
+    return result;
+}
+
+const char* Message_GetProperty(MESSAGE_HANDLE message, const char* name)
+{
+    const char* result;
+    /*Codes_SRS_MESSAGE_17_026: [ If message or name is NULL then Message_GetProperty shall return NULL. ]*/
+    if (
+        (message == NULL) ||
+        (name == NULL)
+        )
+    {
+        LogError("invalid arg: message=%p name=%p", message, name);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_17_027: [ Message_GetProperty shall look the property up in the serialized properties without decoding them. ]*/
+        result = Message_FindProperty(&((MESSAGE_HANDLE_DATA*)message)->index, name);
     }
     return result;
 }
@@ -207,7 +701,7 @@ const CONSTBUFFER * Message_GetContent(MESSAGE_HANDLE message)
     {
         /*Codes_SRS_MESSAGE_02_014: [Otherwise, Message_GetContent shall return a non-NULL const pointer to a structure of type MESSAGE_CONTENT.]*/
         /*Codes_SRS_MESSAGE_02_016: [The CONSTBUFFER's field buffer shall compare equal byte-by-byte to the cfg's field source.]*/
-        result = CONSTBUFFER_GetContent(((MESSAGE_HANDLE_DATA*)message)->content);
+        result = &((MESSAGE_HANDLE_DATA*)message)->content;
     }
     return result;
 }
@@ -224,7 +718,28 @@ CONSTBUFFER_HANDLE Message_GetContentHandle(MESSAGE_HANDLE message)
     else
     {
         /*Codes_SRS_MESSAGE_17_007: [Otherwise, Message_GetContentHandle shall shall clone and return the CONSTBUFFER_HANDLE representing the message content.]*/
-        result = CONSTBUFFER_Clone(((MESSAGE_HANDLE_DATA*)message)->content);
+        result = Message_GetContentHandleImpl((MESSAGE_HANDLE_DATA*)message);
+        if (result != NULL)
+        {
+            result = CONSTBUFFER_Clone(result);
+        }
+    }
+    return result;
+}
+
+const CONSTBUFFER* Message_GetSerialized(MESSAGE_HANDLE message)
+{
+    const CONSTBUFFER* result;
+    if (message == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_054: [ If message is NULL then Message_GetSerialized shall return NULL. ]*/
+        LogError("invalid argument, message is NULL");
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_17_058: [ Otherwise Message_GetSerialized shall return the serialized message, byte for byte what Message_ToByteArray writes, without copying it. ]*/
+        result = Message_GetSerializedImpl((MESSAGE_HANDLE_DATA*)message);
     }
     return result;
 }
@@ -239,13 +754,33 @@ void Message_Destroy(MESSAGE_HANDLE message)
     else
     {
         MESSAGE_HANDLE_DATA* messageData = (MESSAGE_HANDLE_DATA*)message;
-        /*Codes_SRS_MESSAGE_17_002: [Message_Destroy shall destroy the CONSTMAP properties.]*/
-        ConstMap_Destroy(messageData->properties);
-        /*Codes_SRS_MESSAGE_17_005: [Message_Destroy shall destroy the CONSTBUFFER.]*/
-        CONSTBUFFER_Destroy(messageData->content);
         /*Codes_SRS_MESSAGE_02_020: [Otherwise, Message_Destroy shall decrement the internal ref count of the message.]*/
-        if (DEC_REF(MESSAGE_HANDLE_DATA, message) == DEC_RETURN_ZERO)
+        if (MESSAGE_ATOMIC_DEC(&messageData->refCount) == 0)
         {
+            /*Codes_SRS_MESSAGE_17_021: [ If the ref count is zero, Message_Destroy shall destroy the CONSTMAP properties and the CONSTBUFFER content, if they exist. ]*/
+            if (messageData->properties != NULL)
+            {
+                ConstMap_Destroy(messageData->properties);
+            }
+            if (messageData->contentHandle != NULL)
+            {
+                CONSTBUFFER_Destroy(messageData->contentHandle);
+            }
+            /*Codes_SRS_MESSAGE_17_059: [ If the ref count is zero, Message_Destroy shall free the serialized message, if it exists. ]*/
+            if (messageData->serialized != NULL)
+            {
+                free(messageData->serialized);
+            }
+            /*Codes_SRS_MESSAGE_17_040: [ If the ref count is zero and the content was adopted by Message_CreateWithOwnership, Message_Destroy shall call deallocator with deallocatorContext, source and size. ]*/
+            if (messageData->contentDeallocator != NULL)
+            {
+                messageData->contentDeallocator(messageData->contentDeallocatorContext, (unsigned char*)messageData->content.buffer, messageData->content.size);
+            }
+            /*Codes_SRS_MESSAGE_17_053: [ If the ref count is zero and the message was created by Message_CreateDerived, Message_Destroy shall destroy the reference it holds to the message it derives from. ]*/
+            if (messageData->parent != NULL)
+            {
+                Message_Destroy((MESSAGE_HANDLE)messageData->parent);
+            }
             /*Codes_SRS_MESSAGE_02_021: [If the ref count is zero then the allocated resources are freed.]*/
             free(message);
         }
@@ -299,6 +834,25 @@ static int parse_null_terminated_const_char(const unsigned char* source, int32_t
 }
 
 /*creates a MESSAGE_HANDLE from a serialized byte array*/
+/*returns non-zero if one of the count properties serialized from first on is called name. The properties have already been validated*/
+static int Message_IsSerializedProperty(const char* first, int32_t count, const char* name)
+{
+    int result = 0;
+    int32_t i;
+    const char* current = first;
+    for (i = 0; i < count; i++)
+    {
+        if (strcmp(current, name) == 0)
+        {
+            result = 1;
+            break;
+        }
+        current += strlen(current) + 1; /*skip the name*/
+        current += strlen(current) + 1; /*skip the value*/
+    }
+    return result;
+}
+
 MESSAGE_HANDLE Message_CreateFromByteArray(const unsigned char* source, int32_t size)
 {
     MESSAGE_HANDLE_DATA* result;
@@ -344,113 +898,105 @@ MESSAGE_HANDLE Message_CreateFromByteArray(const unsigned char* source, int32_t
 				}
 				else
 				{
-					/*Codes_SRS_MESSAGE_02_026: [ A MAP_HANDLE shall be created. ]*/
-					MAP_HANDLE configMap = Map_Create(NULL);
-					if (configMap == NULL)
+					/*only validate the properties here, they are decoded when (and if) they are needed*/
+					int32_t propertiesCount;
+					if (parse_int32_t(source, size, currentPosition, &parsed, &propertiesCount) != 0)
 					{
-						/*Codes_SRS_MESSAGE_02_030: [ If any of the above steps fails, then Message_CreateFromByteArray shall fail and return NULL. ]*/
-						LogError("failed to create a MAP_HANDLE");
+						LogError("unable to parse an int32_t");
 						result = NULL;
 					}
 					else
 					{
-						/*add all the properties to the map*/
-						int32_t propertiesCount;
-						if (parse_int32_t(source, size, currentPosition, &parsed, &propertiesCount) != 0)
+						currentPosition += parsed;
+
+						if (
+							(propertiesCount < 0) ||
+							(propertiesCount == INT32_MAX)
+							)
 						{
-							LogError("unable to parse an int32_t");
+							/*Codes_SRS_MESSAGE_02_030: [ If any of the above steps fails, then Message_CreateFromByteArray shall fail and return NULL. ]*/
+							LogError("invalid message detected with wrong number of properties =%" PRId32, propertiesCount);
 							result = NULL;
 						}
 						else
 						{
-							currentPosition += parsed;
+							int32_t propertiesStart = currentPosition;
+							int32_t i;
 
-							if (
-								(propertiesCount < 0) ||
-								(propertiesCount == INT32_MAX)
-								)
-							{
-								/*Codes_SRS_MESSAGE_02_030: [ If any of the above steps fails, then Message_CreateFromByteArray shall fail and return NULL. ]*/
-								LogError("invalid message detected with wrong number of properties =%" PRId32, propertiesCount);
-								result = NULL;
-							}
-							else
+							for (i = 0; i < propertiesCount; i++)
 							{
-								int32_t i;
-
-								for (i = 0; i < propertiesCount; i++)
+								const char* keyName;
+								if (parse_null_terminated_const_char(source, size, currentPosition, &parsed, &keyName) != 0)
+								{
+									LogError("unable to parse the name string of the property");
+									break;
+								}
+								/*Codes_SRS_MESSAGE_17_060: [ If two properties have the same name then Message_CreateFromByteArray shall fail and return NULL. ]*/
+								else if (Message_IsSerializedProperty((const char*)source + propertiesStart, i, keyName) != 0)
+								{
+									LogError("property %s appears more than once", keyName);
+									break;
+								}
+								else
 								{
-									const char* keyName;
-									if (parse_null_terminated_const_char(source, size, currentPosition, &parsed, &keyName) != 0)
+									const char* keyValue;
+									currentPosition += parsed;
+									if (parse_null_terminated_const_char(source, size, currentPosition, &parsed, &keyValue) != 0)
 									{
 										LogError("unable to parse the name string of the property");
 										break;
 									}
 									else
 									{
-										const char* keyValue;
+										/*all is fine, proceed to the next property*/
 										currentPosition += parsed;
-										if (parse_null_terminated_const_char(source, size, currentPosition, &parsed, &keyValue) != 0)
-										{
-											LogError("unable to parse the name string of the property");
-											break;
-										}
-										else
-										{
-											currentPosition += parsed;
-											/*Codes_SRS_MESSAGE_02_027: [ All the properties of the byte array shall be added to the MAP_HANDLE. ]*/
-											if (Map_Add(configMap, keyName, keyValue) != MAP_OK)
-											{
-												LogError("Map_Add failed\n");
-												break;
-											}
-											else
-											{
-												/*all is fine, proceed to the next property*/
-											}
-										}
 									}
 								}
+							}
+
+							if (i != propertiesCount)
+							{
+								result = NULL;
+							}
+							else
+							{
+								/*all is fine*/
+								int32_t propertiesEnd = currentPosition;
+								int32_t messageContentSize;
 
-								if (i != propertiesCount)
+								if (parse_int32_t(source, size, currentPosition, &parsed, &messageContentSize) != 0)
 								{
+									LogError("no space to read the number of bytes making the message");
 									result = NULL;
 								}
 								else
 								{
-									/*all is fine*/
-									int32_t messageContentSize;
-
-									if (parse_int32_t(source, size, currentPosition, &parsed, &messageContentSize) != 0)
+									currentPosition += parsed;
+									if (currentPosition + messageContentSize != messageSize)
 									{
-										LogError("no space to read the number of bytes making the message");
+										LogError("the message content doesn't up to the message size %" PRId32 " %" PRId32 "\n", (int32_t)(currentPosition + messageContentSize), messageSize);
 										result = NULL;
 									}
 									else
 									{
-										currentPosition += parsed;
-										if (currentPosition + messageContentSize != messageSize)
+										/*Codes_SRS_MESSAGE_17_019: [ Message_CreateFromByteArray shall copy the message content into the message the same way Message_Create does. ]*/
+										result = Message_CreateImpl((size_t)propertiesCount, (size_t)(propertiesEnd - propertiesStart), source + currentPosition, (size_t)messageContentSize, NULL);
+										if (result == NULL)
 										{
-											LogError("the message content doesn't up to the message size %" PRId32 " %" PRId32 "\n", (int32_t)(currentPosition + messageContentSize), messageSize);
-											result = NULL;
+											/*Codes_SRS_MESSAGE_02_030: [ If any of the above steps fails, then Message_CreateFromByteArray shall fail and return NULL. ]*/
+											LogError("unable to create the message");
 										}
 										else
 										{
-											/*Codes_SRS_MESSAGE_02_028: [ A structure of type MESSAGE_CONFIG shall be populated with the MAP_HANDLE previously constructed and the message content ]*/
-											MESSAGE_CONFIG msgConfig = { (size_t)messageContentSize, source + currentPosition, configMap };
-
-											/*Codes_SRS_MESSAGE_02_029: [ A MESSAGE_HANDLE shall be constructed from the MESSAGE_CONFIG. ]*/
+											/*Codes_SRS_MESSAGE_17_018: [ Message_CreateFromByteArray shall not decode the properties; it shall copy the serialized properties into the message together with an index of where each property starts. ]*/
+											memcpy(result->index.encoded, source + propertiesStart, result->index.size);
+											Message_IndexProperties(result);
 											/*Codes_SRS_MESSAGE_02_031: [ Otherwise Message_CreateFromByteArray shall succeed and return a non-NULL handle. ]*/
-											result = Message_CreateImpl(&msgConfig);
-
-											/*return as is*/
-
 										}
 									}
 								}
 							}
 						}
-						Map_Destroy(configMap);
 					}
 				}
 			}
@@ -492,85 +1038,72 @@ extern int32_t Message_ToByteArray(MESSAGE_HANDLE messageHandle, unsigned char*
             + 0 /*an unknown at this moment number of bytes for message content*/
             ;
         
-        const char* const * keys;
-        const char* const * values;
-        size_t nProperties;
+        /*Codes_SRS_MESSAGE_17_025: [ Message_ToByteArray shall copy the serialized properties of the message as they are. ]*/
+        size_t nProperties = messageHandleData->index.count;
+        const CONSTBUFFER* messageContent = &messageHandleData->content;
+        byteArraySize += messageHandleData->index.size;
+        byteArraySize += messageContent->size;
 
-        /*Codes_SRS_MESSAGE_02_035: [ If any of the above steps fails then Message_ToByteArray shall fail and return -1. ]*/
-        if (ConstMap_GetInternals(messageHandleData->properties, &keys, &values, &nProperties) != CONSTMAP_OK)
+        if (size == 0)
+        {
+            /*Codes_SRS_MESSAGE_17_016: [ If buf is NULL and size is equal to zero, Message_ToByteArray shall return the needed memory size. ]*/
+            result = byteArraySize;
+        }
+        else if (byteArraySize > (size_t)size)
         {
-            LogError("failed to get the keys and values from the message properties");
+            /*Codes_SRS_MESSAGE_17_017: [ If buf is not NULL and size is less than the needed memory size, Message_ToByteArray shall return -1; ]*/
+            LogError("message is %zu bytes, won't fit in buffer of %" PRId32 " bytes", byteArraySize, size);
             result = -1;
         }
         else
         {
-            size_t i;
-            for (i = 0;i < nProperties;i++)
-            {
-                /*add to the needed size the name and value of property i*/
-                byteArraySize += (strlen(keys[i]) + 1) + (strlen(values[i]) + 1);
-            }
+            /*Codes_SRS_MESSAGE_02_034: [ Message_ToByteArray shall populate the memory with values as indicated in the implementation details. ]*/
 
-            const CONSTBUFFER* messageContent = CONSTBUFFER_GetContent(messageHandleData->content);
-            byteArraySize += messageContent->size;
-            
-            if (size == 0)
-            {
-                /*Codes_SRS_MESSAGE_17_016: [ If buf is NULL and size is equal to zero, Message_ToByteArray shall return the needed memory size. ]*/
-                result = byteArraySize;
-            }
-            else if (byteArraySize > (size_t)size)
+            size_t currentPosition; /*always points to the byte we are about to write*/
+            /*a header formed of the following hex characters in this order: 0xA1 0x60*/
+            buf[0] = FIRST_MESSAGE_BYTE;
+            buf[1] = SECOND_MESSAGE_BYTE;
+            /*4 bytes in MSB order representing the total size of the byte array. */
+            buf[2] = byteArraySize >> 24;
+            buf[3] = (byteArraySize >> 16) & 0xFF;
+            buf[4] = (byteArraySize >> 8) & 0xFF;
+            buf[5] = (byteArraySize) & 0xFF;
+            /*4 bytes in MSB order representing the number of properties*/
+            buf[6] = nProperties >> 24;
+            buf[7] = (nProperties >> 16) & 0xFF;
+            buf[8] = (nProperties >> 8) & 0xFF;
+            buf[9] = nProperties & 0xFF;
+            /*for every property, 2 arrays of null terminated characters representing the name of the property and the value.*/
+				currentPosition = 10;
+            if (messageHandleData->parent == NULL)
             {
-                /*Codes_SRS_MESSAGE_17_017: [ If buf is not NULL and size is less than the needed memory size, Message_ToByteArray shall return -1; ]*/
-                LogError("message is %u bytes, won't fit in buffer of %u bytes", byteArraySize, size);
-                result = -1;
+                memcpy(buf + currentPosition, messageHandleData->index.encoded, messageHandleData->index.size);
+                currentPosition += messageHandleData->index.size;
             }
             else
             {
-                /*Codes_SRS_MESSAGE_02_034: [ Message_ToByteArray shall populate the memory with values as indicated in the implementation details. ]*/
-
-                size_t currentPosition; /*always points to the byte we are about to write*/
-                /*a header formed of the following hex characters in this order: 0xA1 0x60*/
-                buf[0] = FIRST_MESSAGE_BYTE;
-                buf[1] = SECOND_MESSAGE_BYTE;
-                /*4 bytes in MSB order representing the total size of the byte array. */
-                buf[2] = byteArraySize >> 24;
-                buf[3] = (byteArraySize >> 16) & 0xFF;
-                buf[4] = (byteArraySize >> 8) & 0xFF;
-                buf[5] = (byteArraySize) & 0xFF;
-                /*4 bytes in MSB order representing the number of properties*/
-                buf[6] = nProperties >> 24;
-                buf[7] = (nProperties >> 16) & 0xFF;
-                buf[8] = (nProperties >> 8) & 0xFF;
-                buf[9] = nProperties & 0xFF;
-                /*for every property, 2 arrays of null terminated characters representing the name of the property and the value.*/
-				currentPosition = 10;
-                for (i = 0;i < nProperties;i++)
+                /*the properties of a derived message are spread between it and the message it derives from*/
+                size_t i;
+                for (i = 0; i < nProperties; i++)
                 {
-                    size_t nameLength = strlen(keys[i]) + 1;/*the +1 will take care of copying '\0' too*/
-                    size_t valueLength = strlen(values[i]) + 1;/*the +1 will take care of copying '\0' too*/
-
-                    /*copy name*/
-                    memcpy(buf + currentPosition, keys[i], nameLength);
-                    currentPosition += nameLength;
-                    
-                    /*copy value*/
-                    memcpy(buf + currentPosition, values[i], valueLength);
-                    currentPosition += valueLength;
+                    const char* name = messageHandleData->index.names[i];
+                    size_t propertySize = Message_PropertySize(name, name + strlen(name) + 1);
+                    memcpy(buf + currentPosition, name, propertySize);
+                    currentPosition += propertySize;
                 }
+            }
 
-                /*4 bytes in MSB order representing the number of bytes in the message content array*/
-                buf[currentPosition++] = (messageContent->size) >> 24;
-                buf[currentPosition++] = ((messageContent->size) >> 16) & 0xFF;
-                buf[currentPosition++] = ((messageContent->size) >> 8) & 0xFF;
-                buf[currentPosition++] = (messageContent->size) & 0xFF;
+            /*4 bytes in MSB order representing the number of bytes in the message content array*/
+            buf[currentPosition++] = (messageContent->size) >> 24;
+            buf[currentPosition++] = ((messageContent->size) >> 16) & 0xFF;
+            buf[currentPosition++] = ((messageContent->size) >> 8) & 0xFF;
+            buf[currentPosition++] = (messageContent->size) & 0xFF;
 
-                /*n bytes of message content follows.*/
-                memcpy(buf + currentPosition, messageContent->buffer, messageContent->size);
+            /*n bytes of message content follows.*/
+            memcpy(buf + currentPosition, messageContent->buffer, messageContent->size);
 
-                /*Codes_SRS_MESSAGE_02_036: [ Otherwise Message_ToByteArray shall succeed, and return the byte array size. ]*/
-                result = byteArraySize;
-            }
+            /*Codes_SRS_MESSAGE_02_036: [ Otherwise Message_ToByteArray shall succeed, and return the byte array size. ]*/
+            result = byteArraySize;
         }
     }
     return result;
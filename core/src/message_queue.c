@@ -2,43 +2,80 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include "azure_c_shared_utility/gballoc.h"
-#include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/xlogging.h"
 
-#include "azure_c_shared_utility/doublylinkedlist.h"
 #include "message.h"
 #include "message_queue.h"
 
-typedef struct MESSAGE_QUEUE_STORAGE_TAG
-{
-    DLIST_ENTRY queue_entry;
-    MESSAGE_HANDLE message;
-} MESSAGE_QUEUE_STORAGE;
+/*number of slots allocated by the first push onto an unbounded queue*/
+#define MESSAGE_QUEUE_INITIAL_SLOTS 16
 
+/*A ring buffer of message handles. Messages live in slots[head] through
+ *slots[(head + count - 1) % allocated]. A bounded queue allocates its slots
+ *together with the queue and never grows; an unbounded queue doubles its
+ *slots whenever it runs out of room.*/
 typedef struct MESSAGE_QUEUE_TAG
 {
-    MESSAGE_QUEUE_STORAGE queue_head;
+    MESSAGE_HANDLE* slots;
+    size_t allocated;
+    size_t head;
+    size_t count;
+    /** Maximum number of messages held by the queue, 0 if unbounded */
+    size_t capacity;
 } MESSAGE_QUEUE_HANDLE_DATA;
 
 static MESSAGE_HANDLE message_pop(MESSAGE_QUEUE_HANDLE_DATA* handle)
 {
     MESSAGE_HANDLE result;
-	if (DList_IsListEmpty((PDLIST_ENTRY)&(handle->queue_head)))
-	{
+    if (handle->count == 0)
+    {
         /*Codes_SRS_MESSAGE_QUEUE_17_013: [ MESSAGE_QUEUE_pop shall return NULL on an empty message queue. ]*/
-		result = NULL;
-	}
-	else
-	{
+        result = NULL;
+    }
+    else
+    {
         /*Codes_SRS_MESSAGE_QUEUE_17_014: [ MESSAGE_QUEUE_pop shall remove messages from the queue in a first-in-first-out order. ]*/
         /*Codes_SRS_MESSAGE_QUEUE_17_015: [ A successful call to MESSAGE_QUEUE_pop on a queue with one message will cause the message queue to be empty. ]*/
-		MESSAGE_QUEUE_STORAGE* entry =
-		(MESSAGE_QUEUE_STORAGE*)DList_RemoveHeadList( (PDLIST_ENTRY)&(handle->queue_head));
+        result = handle->slots[handle->head];
+        handle->head = (handle->head + 1) % handle->allocated;
+        handle->count--;
+    }
+    return result;
+}
 
-        result = ((MESSAGE_QUEUE_STORAGE*)entry)->message;
-        /*Codes_SRS_MESSAGE_QUEUE_17_006: [ MESSAGE_QUEUE_destroy shall free all allocated resources. ]*/
-        free(entry);
+/*doubles the slots of an unbounded queue, returns 0 on success, otherwise __LINE__*/
+static int message_queue_grow(MESSAGE_QUEUE_HANDLE_DATA* handle)
+{
+    int result;
+    size_t new_allocated = (handle->allocated == 0) ? MESSAGE_QUEUE_INITIAL_SLOTS : handle->allocated * 2;
+    if (new_allocated < handle->allocated || new_allocated > SIZE_MAX / sizeof(MESSAGE_HANDLE))
+    {
+        LogError("message queue cannot grow past %zu messages", handle->allocated);
+        result = __LINE__;
+    }
+    else
+    {
+        MESSAGE_HANDLE* new_slots = (MESSAGE_HANDLE*)realloc(handle->slots, new_allocated * sizeof(MESSAGE_HANDLE));
+        if (new_slots == NULL)
+        {
+            LogError("realloc failed.");
+            result = __LINE__;
+        }
+        else
+        {
+            /*messages that wrapped around the end of the old slots move right after them*/
+            size_t wrapped = (handle->head + handle->count > handle->allocated) ? (handle->head + handle->count - handle->allocated) : 0;
+            if (wrapped > 0)
+            {
+                (void)memcpy(new_slots + handle->allocated, new_slots, wrapped * sizeof(MESSAGE_HANDLE));
+            }
+            handle->slots = new_slots;
+            handle->allocated = new_allocated;
+            result = 0;
+        }
     }
     return result;
 }
@@ -57,8 +94,44 @@ MESSAGE_QUEUE_HANDLE MESSAGE_QUEUE_create()
     {
         /*Codes_SRS_MESSAGE_QUEUE_17_001: [ On a successful call, MESSAGE_QUEUE_create shall return a non-NULL value in MESSAGE_QUEUE_HANDLE. ]*/
         /*Codes_SRS_MESSAGE_QUEUE_17_002: [ A newly created message queue shall be empty. ]*/
-        DList_InitializeListHead((PDLIST_ENTRY)&(result->queue_head));
-        result->queue_head.message = NULL;
+        /*slots are allocated by the first push*/
+        result->slots = NULL;
+        result->allocated = 0;
+        result->head = 0;
+        result->count = 0;
+        result->capacity = 0;
+    }
+    return result;
+}
+
+MESSAGE_QUEUE_HANDLE MESSAGE_QUEUE_create_bounded(size_t capacity)
+{
+    MESSAGE_QUEUE_HANDLE_DATA* result;
+
+    if (capacity == 0 || capacity > (SIZE_MAX - sizeof(MESSAGE_QUEUE_HANDLE_DATA)) / sizeof(MESSAGE_HANDLE))
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_024: [ MESSAGE_QUEUE_create_bounded shall return NULL if capacity is 0 or too large to allocate. ]*/
+        LogError("invalid argument capacity(%zu).", capacity);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_025: [ MESSAGE_QUEUE_create_bounded shall allocate room for capacity messages along with the queue. ]*/
+        result = (MESSAGE_QUEUE_HANDLE_DATA*)malloc(sizeof(MESSAGE_QUEUE_HANDLE_DATA) + capacity * sizeof(MESSAGE_HANDLE));
+        if (result == NULL)
+        {
+            /*Codes_SRS_MESSAGE_QUEUE_17_026: [ On a failure, MESSAGE_QUEUE_create_bounded shall return NULL. ]*/
+            LogError("malloc failed.");
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_QUEUE_17_023: [ On a successful call, MESSAGE_QUEUE_create_bounded shall return a non-NULL, empty message queue holding at most capacity messages. ]*/
+            result->slots = (MESSAGE_HANDLE*)(result + 1);
+            result->allocated = capacity;
+            result->head = 0;
+            result->count = 0;
+            result->capacity = capacity;
+        }
     }
     return result;
 }
@@ -80,6 +153,10 @@ void MESSAGE_QUEUE_destroy(MESSAGE_QUEUE_HANDLE handle)
             Message_Destroy(message);
         }
         /*Codes_SRS_MESSAGE_QUEUE_17_006: [ MESSAGE_QUEUE_destroy shall free all allocated resources. ]*/
+        if (mq->capacity == 0 && mq->slots != NULL)
+        {
+            free(mq->slots);
+        }
         free(handle);
     }
 }
@@ -96,24 +173,24 @@ int MESSAGE_QUEUE_push(MESSAGE_QUEUE_HANDLE handle, MESSAGE_HANDLE element)
         LogError("invalid argument - handle(%p), element(%p).", handle, element);
         result = __LINE__;
     }
+    else if (handle->capacity != 0 && handle->count == handle->capacity)
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_027: [ MESSAGE_QUEUE_push shall return a non-zero value and leave the queue unchanged if a bounded queue is full. ]*/
+        result = __LINE__;
+    }
+    else if (handle->count == handle->allocated && message_queue_grow(handle) != 0)
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_009: [ MESSAGE_QUEUE_push shall return a non-zero value if any system call fails. ]*/
+        LogError("unable to grow message queue.");
+        result = __LINE__;
+    }
     else
     {
-		MESSAGE_QUEUE_STORAGE* temp = (MESSAGE_QUEUE_STORAGE*)malloc(sizeof(MESSAGE_QUEUE_STORAGE));
-        if (temp == NULL)
-        {
-            /*Codes_SRS_MESSAGE_QUEUE_17_009: [ MESSAGE_QUEUE_push shall return a non-zero value if any system call fails. ]*/
-            LogError("malloc failed.");
-            result = __LINE__;
-        }
-        else
-        {
-            DList_InitializeListHead((PDLIST_ENTRY)temp);
-            temp->message = element;
-            /*Codes_SRS_MESSAGE_QUEUE_17_011: [ Messages shall be pushed into the queue in a first-in-first-out order. ]*/
-            DList_AppendTailList((PDLIST_ENTRY)&(handle->queue_head), (PDLIST_ENTRY)temp);
-            /*Codes_SRS_MESSAGE_QUEUE_17_008: [ MESSAGE_QUEUE_push shall return zero on success. ]*/
-            result = 0;
-        }
+        /*Codes_SRS_MESSAGE_QUEUE_17_011: [ Messages shall be pushed into the queue in a first-in-first-out order. ]*/
+        handle->slots[(handle->head + handle->count) % handle->allocated] = element;
+        handle->count++;
+        /*Codes_SRS_MESSAGE_QUEUE_17_008: [ MESSAGE_QUEUE_push shall return zero on success. ]*/
+        result = 0;
     }
     return result;
 }
@@ -153,11 +230,28 @@ bool MESSAGE_QUEUE_is_empty(MESSAGE_QUEUE_HANDLE handle)
 	{
         /*Codes_SRS_MESSAGE_QUEUE_17_017: [ MESSAGE_QUEUE_is_empty shall return true if there are no messages on the queue. ]*/
         /*Codes_SRS_MESSAGE_QUEUE_17_018: [ MESSAGE_QUEUE_is_empty shall return false if one or more messages have been pushed on the queue. ]*/
-		result = (DList_IsListEmpty((PDLIST_ENTRY)&(handle->queue_head)));
+		result = (handle->count == 0);
 	}
 	return result;
 }
 
+bool MESSAGE_QUEUE_is_full(MESSAGE_QUEUE_HANDLE handle)
+{
+    bool result;
+    if (handle == NULL)
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_028: [ MESSAGE_QUEUE_is_full shall return false if handle is NULL. ]*/
+        LogError("invalid argument handle (NULL).");
+        result = false;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_029: [ MESSAGE_QUEUE_is_full shall return true if the queue is bounded and holds capacity messages, false otherwise. ]*/
+        result = (handle->capacity != 0 && handle->count == handle->capacity);
+    }
+    return result;
+}
+
 MESSAGE_HANDLE MESSAGE_QUEUE_front(MESSAGE_QUEUE_HANDLE handle)
 {
     MESSAGE_HANDLE result;
@@ -170,20 +264,16 @@ MESSAGE_HANDLE MESSAGE_QUEUE_front(MESSAGE_QUEUE_HANDLE handle)
     else
     {
         /*Codes_SRS_MESSAGE_QUEUE_17_020: [ MESSAGE_QUEUE_front shall return NULL if the message queue is empty. ]*/
-        if (DList_IsListEmpty((PDLIST_ENTRY)&(handle->queue_head)))
+        if (handle->count == 0)
         {
             result = NULL;
         }
         else
         {
             /*Codes_SRS_MESSAGE_QUEUE_17_021: [ On a non-empty queue, MESSAGE_QUEUE_front shall return the first remaining element that was pushed onto the message queue. ]*/
-            
-            MESSAGE_QUEUE_STORAGE* entry = (MESSAGE_QUEUE_STORAGE*)DList_RemoveHeadList((PDLIST_ENTRY)&(handle->queue_head));
-            result = entry->message;
             /*Codes_SRS_MESSAGE_QUEUE_17_022: [ The content of the message queue shall not be changed after calling MESSAGE_QUEUE_front. ]*/
-            DList_InsertHeadList((PDLIST_ENTRY)&(handle->queue_head), (PDLIST_ENTRY)entry);
+            result = handle->slots[handle->head];
         }
     }
     return result;
 }
-
@@ -0,0 +1,195 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+
+#include "base64_encoder.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+#ifdef _MSC_VER
+#pragma warning(disable:4505)
+#endif
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+/*the test vectors of RFC 4648*/
+static const char* const test_vectors[][2] =
+{
+    { "", "" },
+    { "f", "Zg==" },
+    { "fo", "Zm8=" },
+    { "foo", "Zm9v" },
+    { "foob", "Zm9vYg==" },
+    { "fooba", "Zm9vYmE=" },
+    { "foobar", "Zm9vYmFy" }
+};
+
+static const char reference_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/*encodes one byte at a time, the way the vector encoders are checked against*/
+static size_t reference_encode(const unsigned char* source, size_t size, char* destination)
+{
+    size_t written = 0;
+    size_t i;
+    for (i = 0; i < size; i += 3)
+    {
+        uint32_t group = (uint32_t)source[i] << 16;
+        if (i + 1 < size) group |= (uint32_t)source[i + 1] << 8;
+        if (i + 2 < size) group |= (uint32_t)source[i + 2];
+        destination[written++] = reference_alphabet[(group >> 18) & 0x3F];
+        destination[written++] = reference_alphabet[(group >> 12) & 0x3F];
+        destination[written++] = (i + 1 < size) ? reference_alphabet[(group >> 6) & 0x3F] : '=';
+        destination[written++] = (i + 2 < size) ? reference_alphabet[group & 0x3F] : '=';
+    }
+    return written;
+}
+
+BEGIN_TEST_SUITE(base64_encoder_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    TEST_MUTEX_DESTROY(g_testByTest);
+    umock_c_deinit();
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest) != 0)
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_BASE64_ENCODER_17_001: [ `Base64Encoder_GetEncodedSize` shall return 4 characters for every 3 bytes of `size`, rounded up. ]*/
+TEST_FUNCTION(Base64Encoder_GetEncodedSize_rounds_up_to_whole_groups)
+{
+    ///act
+    size_t result0 = Base64Encoder_GetEncodedSize(0);
+    size_t result1 = Base64Encoder_GetEncodedSize(1);
+    size_t result3 = Base64Encoder_GetEncodedSize(3);
+    size_t result4 = Base64Encoder_GetEncodedSize(4);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 0, result0);
+    ASSERT_ARE_EQUAL(size_t, 4, result1);
+    ASSERT_ARE_EQUAL(size_t, 4, result3);
+    ASSERT_ARE_EQUAL(size_t, 8, result4);
+}
+
+/*Tests_SRS_BASE64_ENCODER_17_002: [ If the encoding of `size` bytes does not fit a `size_t`, `Base64Encoder_GetEncodedSize` shall return 0. ]*/
+TEST_FUNCTION(Base64Encoder_GetEncodedSize_with_too_many_bytes_fails)
+{
+    ///act
+    size_t result = Base64Encoder_GetEncodedSize(SIZE_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 0, result);
+}
+
+/*Tests_SRS_BASE64_ENCODER_17_003: [ If `destination` is `NULL`, or `source` is `NULL` and `size` is not 0, `Base64Encoder_Encode` shall write nothing and return 0. ]*/
+TEST_FUNCTION(Base64Encoder_Encode_with_bad_arguments_fails)
+{
+    ///arrange
+    char destination[4] = { 'x', 'x', 'x', 'x' };
+
+    ///act
+    size_t result1 = Base64Encoder_Encode(NULL, 1, destination);
+    size_t result2 = Base64Encoder_Encode((const unsigned char*)"f", 1, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 0, result1);
+    ASSERT_ARE_EQUAL(size_t, 0, result2);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(destination, "xxxx", 4));
+}
+
+/*Tests_SRS_BASE64_ENCODER_17_004: [ `Base64Encoder_Encode` shall write the Base64 encoding of the `size` bytes of `source` to `destination`, with the alphabet and the padding of RFC 4648, without a terminating '\0'. ]*/
+/*Tests_SRS_BASE64_ENCODER_17_006: [ `Base64Encoder_Encode` shall return the number of characters written. ]*/
+TEST_FUNCTION(Base64Encoder_Encode_encodes_the_rfc_4648_test_vectors)
+{
+    size_t i;
+    for (i = 0; i < sizeof(test_vectors) / sizeof(test_vectors[0]); i++)
+    {
+        ///arrange
+        char destination[16];
+        size_t size = strlen(test_vectors[i][0]);
+        (void)memset(destination, '!', sizeof(destination));
+
+        ///act
+        size_t result = Base64Encoder_Encode((const unsigned char*)test_vectors[i][0], size, destination);
+
+        ///assert
+        ASSERT_ARE_EQUAL(size_t, strlen(test_vectors[i][1]), result);
+        ASSERT_ARE_EQUAL(size_t, Base64Encoder_GetEncodedSize(size), result);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(test_vectors[i][1], destination, result));
+        ASSERT_ARE_EQUAL(char, '!', destination[result]);
+    }
+}
+
+/*Tests_SRS_BASE64_ENCODER_17_004: [ `Base64Encoder_Encode` shall write the Base64 encoding of the `size` bytes of `source` to `destination`, with the alphabet and the padding of RFC 4648, without a terminating '\0'. ]*/
+TEST_FUNCTION(Base64Encoder_Encode_with_NULL_source_and_no_bytes_succeeds)
+{
+    ///arrange
+    char destination[1] = { '!' };
+
+    ///act
+    size_t result = Base64Encoder_Encode(NULL, 0, destination);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 0, result);
+    ASSERT_ARE_EQUAL(char, '!', destination[0]);
+}
+
+/*Tests_SRS_BASE64_ENCODER_17_005: [ `Base64Encoder_Encode` shall encode with SSSE3 or NEON instructions when the processor has them, and write the same characters either way. ]*/
+TEST_FUNCTION(Base64Encoder_Encode_matches_a_byte_at_a_time_encoder_for_every_length)
+{
+    ///arrange
+    unsigned char source[300];
+    char expected[400];
+    char actual[400];
+    size_t size;
+    for (size = 0; size < sizeof(source); size++)
+    {
+        source[size] = (unsigned char)((size * 151) + 7);
+    }
+
+    for (size = 0; size <= sizeof(source); size++)
+    {
+        ///act
+        size_t expectedSize = reference_encode(source, size, expected);
+        size_t result = Base64Encoder_Encode(source, size, actual);
+
+        ///assert
+        ASSERT_ARE_EQUAL(size_t, expectedSize, result);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(expected, actual, result));
+    }
+}
+
+END_TEST_SUITE(base64_encoder_ut)
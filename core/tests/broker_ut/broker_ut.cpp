@@ -4,19 +4,17 @@
 #include <cstdlib>
 #include <cstddef>
 #include <cstdbool>
+#include <deque>
 #include "testrunnerswitcher.h"
 #include "micromock.h"
 #include "micromockcharstararenullterminatedstrings.h"
 #include "azure_c_shared_utility/lock.h"
-#include "azure_c_shared_utility/vector.h"
-#include "azure_c_shared_utility/vector_types_internal.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
+#include "azure_c_shared_utility/condition.h"
 #include "message.h"
+#include "message_queue.h"
 #include "azure_c_shared_utility/threadapi.h"
-#include "azure_c_shared_utility/uniqueid.h"
 #include "azure_c_shared_utility/xlogging.h"
-#include "nanomsg/nn.h"
-#include "nanomsg/pubsub.h"
 
 static MICROMOCK_MUTEX_HANDLE g_testByTest;
 static MICROMOCK_GLOBAL_SEMAPHORE_HANDLE g_dllByDll;
@@ -41,8 +39,6 @@ namespace BASEIMPLEMENTATION
 #undef Unlock
 #undef Lock_Init
 #undef Lock_Deinit
-#include "vector.c"
-#include "strings.c"
 };
 
 #include "broker.h"
@@ -53,15 +49,6 @@ DEFINE_MICROMOCK_ENUM_TO_STRING(BROKER_RESULT, BROKER_RESULT_VALUES);
 static size_t currentmalloc_call;
 static size_t whenShallmalloc_fail;
 
-static size_t currentVECTOR_create_call;
-static size_t whenShallVECTOR_create_fail;
-
-static size_t currentVECTOR_push_back_call;
-static size_t whenShallVECTOR_push_back_fail;
-
-static size_t currentVECTOR_find_if_call;
-static size_t whenShallVECTOR_find_if_fail;
-
 static size_t currentsinglylinkedlist_find_call;
 static size_t whenShallsinglylinkedlist_find_fail;
 
@@ -80,17 +67,24 @@ static size_t whenShallLock_fail;
 
 static size_t currentUnlock_call;
 
-static size_t currentCond_Init_call;
-static size_t whenShallCond_Init_fail;
+static size_t currentCondition_Init_call;
+static size_t whenShallCondition_Init_fail;
+
+static size_t currentCondition_Wait_call;
+static size_t whenShallCondition_Wait_fail;
 
-static size_t currentCond_Post_call;
-static size_t whenShallCond_Post_fail;
+static size_t currentMESSAGE_QUEUE_create_call;
+static size_t whenShallMESSAGE_QUEUE_create_fail;
+
+static size_t currentMESSAGE_QUEUE_push_call;
+static size_t whenShallMESSAGE_QUEUE_push_fail;
+
+static size_t currentMessage_Clone_call;
+static size_t whenShallMessage_Clone_fail;
 
 static size_t currentThreadAPI_Create_call;
 static size_t whenShallThreadAPI_Create_fail;
 
-static size_t nn_current_msg_size;
-
 typedef struct LIST_ITEM_INSTANCE_TAG
 {
     const void* item;
@@ -108,11 +102,21 @@ struct ListNode
     ListNode *next, *prev;
 };
 
-static int current_nn_socket_index;
-static void* nn_socket_memory[10];
+/*capacity is 0 for an unbounded queue*/
+struct FAKE_MESSAGE_QUEUE : std::deque<MESSAGE_HANDLE>
+{
+    size_t capacity = 0;
+
+    bool is_full() const
+    {
+        return (capacity > 0) && (size() >= capacity);
+    }
+};
 
 static THREAD_START_FUNC thread_func_to_call;
 static void* thread_func_args;
+/*when set, ThreadAPI_Join runs the worker to completion, as if the thread had been waiting*/
+static bool run_worker_on_join;
 
 struct FakeModule_Receive_Call_Status
 {
@@ -137,9 +141,9 @@ static void FakeModule_Destroy(MODULE_HANDLE module)
 
 static void FakeModule_Receive(MODULE_HANDLE module, MESSAGE_HANDLE messageHandle)
 {
-    (void)messageHandle;
     call_status_for_FakeModule_Receive.was_called = true;
     ASSERT_ARE_EQUAL(void_ptr, module, call_status_for_FakeModule_Receive.module);
+    ASSERT_ARE_EQUAL(void_ptr, messageHandle, call_status_for_FakeModule_Receive.messageHandle);
 }
 
 static MODULE_API_1 fake_module_apis =
@@ -159,6 +163,46 @@ MODULE fake_module =
     fake_module_handle
 };
 
+static MODULE_HANDLE fake_module_handle_2 = (MODULE_HANDLE)0x43;
+
+/*number of Module_ReceiveBatch calls and the size of the last one*/
+static size_t batch_calls;
+static size_t last_batch_count;
+
+static void FakeModule_ReceiveBatch(MODULE_HANDLE module, MESSAGE_HANDLE* messageHandles, size_t count)
+{
+    ASSERT_ARE_EQUAL(void_ptr, module, call_status_for_FakeModule_Receive.module);
+    ASSERT_IS_NOT_NULL(messageHandles);
+    batch_calls++;
+    last_batch_count = count;
+}
+
+static MODULE_API_2 fake_batch_module_apis =
+{
+    {
+        { MODULE_API_VERSION_2 },
+        NULL,
+        NULL,
+        FakeModule_Create,
+        FakeModule_Destroy,
+        FakeModule_Receive,
+        NULL
+    },
+    FakeModule_ReceiveBatch
+};
+
+MODULE fake_batch_module =
+{
+    (const MODULE_API *)&fake_batch_module_apis,
+    fake_module_handle
+};
+
+MODULE fake_module_2 =
+{
+    (const MODULE_API *)&fake_module_apis,
+    fake_module_handle_2
+};
+
 class RefCountObject
 {
 private:
@@ -243,112 +287,169 @@ public:
         auto result2 = LOCK_OK;
     MOCK_METHOD_END(LOCK_RESULT, result2)
 
-    MOCK_STATIC_METHOD_1(, VECTOR_HANDLE, VECTOR_create, size_t, elementSize)
-        VECTOR_HANDLE result2;
-        ++currentVECTOR_create_call;
-        if ((whenShallVECTOR_create_fail > 0) &&
-            (currentVECTOR_create_call == whenShallVECTOR_create_fail))
+    MOCK_STATIC_METHOD_3(, THREADAPI_RESULT, ThreadAPI_Create, THREAD_HANDLE*, threadHandle, THREAD_START_FUNC, func, void*, arg)
+        THREADAPI_RESULT result2;
+        ++currentThreadAPI_Create_call;
+        if ((whenShallThreadAPI_Create_fail > 0) &&
+            (currentThreadAPI_Create_call == whenShallThreadAPI_Create_fail))
         {
-            result2 = NULL;
+            result2 = THREADAPI_ERROR;
         }
         else
         {
-            result2 = BASEIMPLEMENTATION::VECTOR_create(elementSize);
+            *threadHandle = (THREAD_HANDLE*)malloc(3);
+            thread_func_to_call = func;
+            thread_func_args = arg;
+
+            result2 = THREADAPI_OK;
+        }
+    MOCK_METHOD_END(THREADAPI_RESULT, result2)
+
+    MOCK_STATIC_METHOD_2(, THREADAPI_RESULT, ThreadAPI_Join, THREAD_HANDLE, threadHandle, int*, res)
+        if (run_worker_on_join)
+        {
+            *res = thread_func_to_call(thread_func_args);
         }
-    MOCK_METHOD_END(VECTOR_HANDLE, result2)
+        free(threadHandle);
+        auto result2 = THREADAPI_OK;
+    MOCK_METHOD_END(THREADAPI_RESULT, result2)
 
-    MOCK_STATIC_METHOD_1(, void, VECTOR_destroy, VECTOR_HANDLE, vector)
-        BASEIMPLEMENTATION::VECTOR_destroy(vector);
+    MOCK_STATIC_METHOD_1(, void, ThreadAPI_Sleep, unsigned int, milliseconds)
     MOCK_VOID_METHOD_END()
 
-    MOCK_STATIC_METHOD_3(, int, VECTOR_push_back, VECTOR_HANDLE, vector, const void*, elements, size_t, numElements)
-        int result2;
-        ++currentVECTOR_push_back_call;
-        if ((whenShallVECTOR_push_back_fail > 0) &&
-            (currentVECTOR_push_back_call == whenShallVECTOR_push_back_fail))
+    MOCK_STATIC_METHOD_1(, MESSAGE_HANDLE, Message_Create, const MESSAGE_CONFIG*, cfg)
+        MESSAGE_HANDLE result2 = (MESSAGE_HANDLE)(new RefCountObject());
+    MOCK_METHOD_END(MESSAGE_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, MESSAGE_HANDLE, Message_Clone, MESSAGE_HANDLE, message)
+        MESSAGE_HANDLE result2;
+        ++currentMessage_Clone_call;
+        if ((whenShallMessage_Clone_fail > 0) &&
+            (currentMessage_Clone_call == whenShallMessage_Clone_fail))
         {
-            result2 = __LINE__;
+            result2 = NULL;
         }
         else
         {
-            result2 = BASEIMPLEMENTATION::VECTOR_push_back(vector, elements, numElements);
+            ((RefCountObject*)message)->inc_ref();
+            result2 = message;
         }
-    MOCK_METHOD_END(int, result2)
+    MOCK_METHOD_END(MESSAGE_HANDLE, result2)
 
-    MOCK_STATIC_METHOD_3(, void, VECTOR_erase, VECTOR_HANDLE, vector, void*, elements, size_t, numElements)
-        BASEIMPLEMENTATION::VECTOR_erase(vector, elements, numElements);
+    MOCK_STATIC_METHOD_1(, void, Message_Destroy, MESSAGE_HANDLE, message)
+        ((RefCountObject*)message)->dec_ref();
     MOCK_VOID_METHOD_END()
 
-    MOCK_STATIC_METHOD_2(, void*, VECTOR_element, VECTOR_HANDLE, vector, size_t, index)
-        void* result2 = BASEIMPLEMENTATION::VECTOR_element(vector, index);
-    MOCK_METHOD_END(void*, result2)
-
-    MOCK_STATIC_METHOD_1(, void*, VECTOR_front, VECTOR_HANDLE, vector)
-        void* result2 = BASEIMPLEMENTATION::VECTOR_front(vector);
-    MOCK_METHOD_END(void*, result2)
+    // condition.h
 
-    MOCK_STATIC_METHOD_1(, void*, VECTOR_back, const VECTOR_HANDLE, vector)
-        void* result2 = BASEIMPLEMENTATION::VECTOR_back(vector);
-    MOCK_METHOD_END(void*, result2)
-
-    MOCK_STATIC_METHOD_3(, void*, VECTOR_find_if, VECTOR_HANDLE, vector, PREDICATE_FUNCTION, pred, const void*, value)
-        void* result2;
-        ++currentVECTOR_find_if_call;
-        if ((whenShallVECTOR_find_if_fail > 0) &&
-            (currentVECTOR_find_if_call == whenShallVECTOR_find_if_fail))
+    MOCK_STATIC_METHOD_0(, COND_HANDLE, Condition_Init)
+        COND_HANDLE result2;
+        ++currentCondition_Init_call;
+        if ((whenShallCondition_Init_fail > 0) &&
+            (currentCondition_Init_call == whenShallCondition_Init_fail))
         {
             result2 = NULL;
         }
         else
         {
-            result2 = BASEIMPLEMENTATION::VECTOR_find_if(vector, pred, value);
+            result2 = (COND_HANDLE)malloc(1);
         }
-    MOCK_METHOD_END(void*, result2)
+    MOCK_METHOD_END(COND_HANDLE, result2)
 
-    MOCK_STATIC_METHOD_1(, size_t, VECTOR_size, VECTOR_HANDLE, vector)
-        size_t result2 = BASEIMPLEMENTATION::VECTOR_size(vector);
-    MOCK_METHOD_END(size_t, result2)
+    MOCK_STATIC_METHOD_1(, COND_RESULT, Condition_Post, COND_HANDLE, handle)
+        auto result2 = COND_OK;
+    MOCK_METHOD_END(COND_RESULT, result2)
 
-    MOCK_STATIC_METHOD_3(, THREADAPI_RESULT, ThreadAPI_Create, THREAD_HANDLE*, threadHandle, THREAD_START_FUNC, func, void*, arg)
-        THREADAPI_RESULT result2;
-        ++currentThreadAPI_Create_call;
-        if ((whenShallThreadAPI_Create_fail > 0) &&
-            (currentThreadAPI_Create_call == whenShallThreadAPI_Create_fail))
+    MOCK_STATIC_METHOD_3(, COND_RESULT, Condition_Wait, COND_HANDLE, handle, LOCK_HANDLE, lock, int, timeout_milliseconds)
+        COND_RESULT result2;
+        ++currentCondition_Wait_call;
+        if ((whenShallCondition_Wait_fail > 0) &&
+            (currentCondition_Wait_call == whenShallCondition_Wait_fail))
         {
-            result2 = THREADAPI_ERROR;
+            result2 = COND_ERROR;
         }
         else
         {
-            *threadHandle = (THREAD_HANDLE*)malloc(3);
-            thread_func_to_call = func;
-            thread_func_args = arg;
-
-            result2 = THREADAPI_OK;
+            result2 = COND_OK;
         }
-    MOCK_METHOD_END(THREADAPI_RESULT, result2)
+    MOCK_METHOD_END(COND_RESULT, result2)
 
-    MOCK_STATIC_METHOD_2(, THREADAPI_RESULT, ThreadAPI_Join, THREAD_HANDLE, threadHandle, int*, res)
-        free(threadHandle);
-        auto result2 = THREADAPI_OK;
-    MOCK_METHOD_END(THREADAPI_RESULT, result2)
-
-    MOCK_STATIC_METHOD_1(, MESSAGE_HANDLE, Message_Create, const MESSAGE_CONFIG*, cfg)
-        MESSAGE_HANDLE result2 = (MESSAGE_HANDLE)(new RefCountObject());
-    MOCK_METHOD_END(MESSAGE_HANDLE, result2)
+    MOCK_STATIC_METHOD_1(, void, Condition_Deinit, COND_HANDLE, handle)
+        free(handle);
+    MOCK_VOID_METHOD_END()
 
-    MOCK_STATIC_METHOD_1(, MESSAGE_HANDLE, Message_Clone, MESSAGE_HANDLE, message)
-        ((RefCountObject*)message)->inc_ref();
-    MOCK_METHOD_END(MESSAGE_HANDLE, message)
+    // message_queue.h
 
-    MOCK_STATIC_METHOD_1(, void, Message_Destroy, MESSAGE_HANDLE, message)
-        ((RefCountObject*)message)->dec_ref();
+    MOCK_STATIC_METHOD_0(, MESSAGE_QUEUE_HANDLE, MESSAGE_QUEUE_create)
+        MESSAGE_QUEUE_HANDLE result2;
+        ++currentMESSAGE_QUEUE_create_call;
+        if ((whenShallMESSAGE_QUEUE_create_fail > 0) &&
+            (currentMESSAGE_QUEUE_create_call == whenShallMESSAGE_QUEUE_create_fail))
+        {
+            result2 = NULL;
+        }
+        else
+        {
+            result2 = (MESSAGE_QUEUE_HANDLE)new FAKE_MESSAGE_QUEUE();
+        }
+    MOCK_METHOD_END(MESSAGE_QUEUE_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, MESSAGE_QUEUE_HANDLE, MESSAGE_QUEUE_create_bounded, size_t, capacity)
+        FAKE_MESSAGE_QUEUE* queue = new FAKE_MESSAGE_QUEUE();
+        queue->capacity = capacity;
+        MESSAGE_QUEUE_HANDLE result2 = (MESSAGE_QUEUE_HANDLE)queue;
+    MOCK_METHOD_END(MESSAGE_QUEUE_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, void, MESSAGE_QUEUE_destroy, MESSAGE_QUEUE_HANDLE, handle)
+        FAKE_MESSAGE_QUEUE* queue = (FAKE_MESSAGE_QUEUE*)handle;
+        /*the real queue destroys whatever is still in it*/
+        for (auto it = queue->begin(); it != queue->end(); ++it)
+        {
+            ((RefCountObject*)(*it))->dec_ref();
+        }
+        delete queue;
     MOCK_VOID_METHOD_END()
 
-    MOCK_STATIC_METHOD_2(, MESSAGE_HANDLE, Message_CreateFromByteArray, const unsigned char*, source, int32_t, size)
-    MOCK_METHOD_END(MESSAGE_HANDLE, (MESSAGE_HANDLE)(new RefCountObject()))
+    MOCK_STATIC_METHOD_2(, int, MESSAGE_QUEUE_push, MESSAGE_QUEUE_HANDLE, handle, MESSAGE_HANDLE, element)
+        int result2;
+        ++currentMESSAGE_QUEUE_push_call;
+        if ((whenShallMESSAGE_QUEUE_push_fail > 0) &&
+            (currentMESSAGE_QUEUE_push_call == whenShallMESSAGE_QUEUE_push_fail))
+        {
+            result2 = __LINE__;
+        }
+        else if (((FAKE_MESSAGE_QUEUE*)handle)->is_full())
+        {
+            result2 = __LINE__;
+        }
+        else
+        {
+            ((FAKE_MESSAGE_QUEUE*)handle)->push_back(element);
+            result2 = 0;
+        }
+    MOCK_METHOD_END(int, result2)
+
+    MOCK_STATIC_METHOD_1(, MESSAGE_HANDLE, MESSAGE_QUEUE_pop, MESSAGE_QUEUE_HANDLE, handle)
+        MESSAGE_HANDLE result2;
+        FAKE_MESSAGE_QUEUE* queue = (FAKE_MESSAGE_QUEUE*)handle;
+        if (queue->empty())
+        {
+            result2 = NULL;
+        }
+        else
+        {
+            result2 = queue->front();
+            queue->pop_front();
+        }
+    MOCK_METHOD_END(MESSAGE_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, bool, MESSAGE_QUEUE_is_full, MESSAGE_QUEUE_HANDLE, handle)
+        bool result2 = ((FAKE_MESSAGE_QUEUE*)handle)->is_full();
+    MOCK_METHOD_END(bool, result2)
 
-    MOCK_STATIC_METHOD_3(, int32_t, Message_ToByteArray, MESSAGE_HANDLE, messageHandle, unsigned char *, buffer, int32_t, size)
-    MOCK_METHOD_END(int32_t, (int32_t)1)
+    MOCK_STATIC_METHOD_1(, bool, MESSAGE_QUEUE_is_empty, MESSAGE_QUEUE_HANDLE, handle)
+        bool result2 = ((FAKE_MESSAGE_QUEUE*)handle)->empty();
+    MOCK_METHOD_END(bool, result2)
 
     // list.h
 
@@ -487,91 +588,6 @@ public:
             result1 = (LIST_ITEM_HANDLE)(((ListNode*)item_handle)->item);
         }
     MOCK_METHOD_END(const void*, result1)
-
-    MOCK_STATIC_METHOD_1(, void, STRING_delete, STRING_HANDLE, s)
-        BASEIMPLEMENTATION::STRING_delete(s);
-    MOCK_VOID_METHOD_END()
-
-    MOCK_STATIC_METHOD_1(, STRING_HANDLE, STRING_construct, const char*, source)
-        STRING_HANDLE result2;
-        result2 = BASEIMPLEMENTATION::STRING_construct(source);
-    MOCK_METHOD_END(STRING_HANDLE, result2)
-
-    MOCK_STATIC_METHOD_2(, int, STRING_concat, STRING_HANDLE, s1, const char*, s2)
-        int result1 = BASEIMPLEMENTATION::STRING_concat(s1, s2);
-    MOCK_METHOD_END(int, result1);
-
-    MOCK_STATIC_METHOD_1(, const char*, STRING_c_str, STRING_HANDLE, s)
-    MOCK_METHOD_END(const char*, BASEIMPLEMENTATION::STRING_c_str(s))
-
-    MOCK_STATIC_METHOD_1(, size_t, STRING_length, STRING_HANDLE, s)
-    MOCK_METHOD_END(size_t, BASEIMPLEMENTATION::STRING_length(s))
-
-    MOCK_STATIC_METHOD_2(, UNIQUEID_RESULT, UniqueId_Generate, char*, uid, size_t, bufferSize)
-        for (size_t i = 0; i < bufferSize; i++)
-        {
-            if (i == (bufferSize - 1))
-                uid[i] = '\0';
-            else
-                uid[i] = 'u';
-        }
-    MOCK_METHOD_END(UNIQUEID_RESULT, UNIQUEID_OK)
-
-
-    MOCK_STATIC_METHOD_2(, void *, nn_allocmsg, size_t, size, int, type)
-        nn_current_msg_size = size;
-    MOCK_METHOD_END(void*, malloc(size))
-
-    MOCK_STATIC_METHOD_1(, int, nn_freemsg, void*, msg)
-        free(msg);
-    MOCK_METHOD_END(int, 0)
-
-    MOCK_STATIC_METHOD_2(, int, nn_socket, int, domain, int, protocol)
-        current_nn_socket_index++;
-        nn_socket_memory[current_nn_socket_index] = malloc(1);
-    MOCK_METHOD_END(int, current_nn_socket_index)
-
-    MOCK_STATIC_METHOD_1(, int, nn_close, int, s)
-        free(nn_socket_memory[s]);
-    MOCK_METHOD_END(int, 0)
-
-    MOCK_STATIC_METHOD_2(, int, nn_bind, int, s, const char *, addr)
-    MOCK_METHOD_END(int, 1)
-
-    MOCK_STATIC_METHOD_2(, int, nn_connect, int, s, const char *, addr)
-    MOCK_METHOD_END(int, 1)
-
-    MOCK_STATIC_METHOD_5(, int, nn_setsockopt, int, s, int, level, int, option, const void *, optval, size_t, optvallen)
-    MOCK_METHOD_END(int, 1)
-
-
-    MOCK_STATIC_METHOD_4(, int, nn_send, int, s, const void*, buf, size_t, len, int, flags)
-        int send_length;
-        if (len == NN_MSG)
-        {
-            send_length = (int)nn_current_msg_size;
-            free(*(void**)buf); // send is supposed to free auto created buffer on success
-        }
-        else
-        {
-            send_length = len;
-        }
-    MOCK_METHOD_END(int, send_length)
-
-    MOCK_STATIC_METHOD_4(, int, nn_recv, int, s, void*, buf, size_t, len, int, flags)
-        int rcv_length;
-        if (len == NN_MSG)
-        {
-            char * text = (char*)"nn_recv";
-            (*(void**)buf) = malloc(8);
-            memcpy((*(void**)buf), text, 8);
-            rcv_length = 8;
-        }
-        else
-        {
-            rcv_length = (int)len;
-        }
-    MOCK_METHOD_END(int, rcv_length)
 };
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void*, gballoc_malloc, size_t, size);
@@ -582,24 +598,29 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , LOCK_RESULT, Lock, LOCK_HANDLE, loc
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , LOCK_RESULT, Unlock, LOCK_HANDLE, lock);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , LOCK_RESULT, Lock_Deinit, LOCK_HANDLE, lock);
 
-DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , VECTOR_HANDLE, VECTOR_create, size_t, elementSize);
-DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, VECTOR_destroy, VECTOR_HANDLE, vector);
-DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , int, VECTOR_push_back, VECTOR_HANDLE, vector, const void*, elements, size_t, numElements);
-DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , void, VECTOR_erase, VECTOR_HANDLE, vector, void*, elements, size_t, numElements);
-DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , void*, VECTOR_element, VECTOR_HANDLE, vector, size_t, index);
-DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void*, VECTOR_front, VECTOR_HANDLE, vector);
-DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void*, VECTOR_back, VECTOR_HANDLE, vector);
-DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , void*, VECTOR_find_if, VECTOR_HANDLE, vector, PREDICATE_FUNCTION, pred, const void*, value);
-DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , size_t, VECTOR_size, VECTOR_HANDLE, vector);
 
 DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , THREADAPI_RESULT, ThreadAPI_Create, THREAD_HANDLE*, threadHandle, THREAD_START_FUNC, func, void*, arg);
 DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , THREADAPI_RESULT, ThreadAPI_Join, THREAD_HANDLE, threadHandle, int*, res);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, ThreadAPI_Sleep, unsigned int, milliseconds);
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , MESSAGE_HANDLE, Message_Create, const MESSAGE_CONFIG*, cfg);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , MESSAGE_HANDLE, Message_Clone, MESSAGE_HANDLE, message);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, Message_Destroy, MESSAGE_HANDLE, message);
-DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , MESSAGE_HANDLE, Message_CreateFromByteArray, const unsigned char*, source, int32_t, size);
-DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , int32_t, Message_ToByteArray, MESSAGE_HANDLE, messageHandle, unsigned char *, buffer, int32_t, size);
+
+// condition.h
+DECLARE_GLOBAL_MOCK_METHOD_0(CBrokerMocks, , COND_HANDLE, Condition_Init);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , COND_RESULT, Condition_Post, COND_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , COND_RESULT, Condition_Wait, COND_HANDLE, handle, LOCK_HANDLE, lock, int, timeout_milliseconds);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, Condition_Deinit, COND_HANDLE, handle);
+
+// message_queue.h
+DECLARE_GLOBAL_MOCK_METHOD_0(CBrokerMocks, , MESSAGE_QUEUE_HANDLE, MESSAGE_QUEUE_create);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , MESSAGE_QUEUE_HANDLE, MESSAGE_QUEUE_create_bounded, size_t, capacity);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, MESSAGE_QUEUE_destroy, MESSAGE_QUEUE_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , int, MESSAGE_QUEUE_push, MESSAGE_QUEUE_HANDLE, handle, MESSAGE_HANDLE, element);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , MESSAGE_HANDLE, MESSAGE_QUEUE_pop, MESSAGE_QUEUE_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , bool, MESSAGE_QUEUE_is_full, MESSAGE_QUEUE_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , bool, MESSAGE_QUEUE_is_empty, MESSAGE_QUEUE_HANDLE, handle);
 
 // singlylinkedlist.h
 DECLARE_GLOBAL_MOCK_METHOD_0(CBrokerMocks, , SINGLYLINKEDLIST_HANDLE, singlylinkedlist_create);
@@ -611,26 +632,6 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , LIST_ITEM_HANDLE, singlylinkedlist_
 DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , LIST_ITEM_HANDLE, singlylinkedlist_find, SINGLYLINKEDLIST_HANDLE, list, LIST_MATCH_FUNCTION, match_function, const void*, match_context);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , const void*, singlylinkedlist_item_get_value, LIST_ITEM_HANDLE, item_handle);
 
-//strings.h
-DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, STRING_delete, STRING_HANDLE, s)
-DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , STRING_HANDLE, STRING_construct, const char*, source)
-DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , int, STRING_concat, STRING_HANDLE, s1, const char*, s2)
-DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , const char*, STRING_c_str, STRING_HANDLE, s)
-DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , size_t, STRING_length, STRING_HANDLE, s)
-
-// unique id
-DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , UNIQUEID_RESULT, UniqueId_Generate, char*, uid, size_t, bufferSize)
-DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , void *, nn_allocmsg, size_t, size, int, type)
-// nn.h
-DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , int, nn_freemsg, void*, msg)
-DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , int, nn_socket, int, domain, int, protocol)
-DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , int, nn_close, int, s)
-DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , int, nn_bind, int, s, const char *, addr)
-DECLARE_GLOBAL_MOCK_METHOD_5(CBrokerMocks, , int, nn_setsockopt, int, s, int, level, int, option, const void *, optval, size_t, optvallen)
-DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , int, nn_connect, int, s, const char *, addr)
-DECLARE_GLOBAL_MOCK_METHOD_4(CBrokerMocks, , int, nn_send, int, s, const void*, buf, size_t, len, int, flags)
-DECLARE_GLOBAL_MOCK_METHOD_4(CBrokerMocks, , int, nn_recv, int, s, void*, buf, size_t, len, int, flags)
-
 BEGIN_TEST_SUITE(broker_ut)
 
 TEST_SUITE_INITIALIZE(TestClassInitialize)
@@ -656,15 +657,6 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     currentmalloc_call = 0;
     whenShallmalloc_fail = 0;
 
-    currentVECTOR_create_call = 0;
-    whenShallVECTOR_create_fail = 0;
-
-    currentVECTOR_push_back_call = 0;
-    whenShallVECTOR_push_back_fail = 0;
-
-    currentVECTOR_find_if_call = 0;
-    whenShallVECTOR_find_if_fail = 0;
-
     currentLock_Init_call = 0;
     whenShallLock_Init_fail = 0;
 
@@ -682,26 +674,30 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
 
     currentUnlock_call = 0;
 
-    currentCond_Init_call = 0;
-    whenShallCond_Init_fail = 0;
+    currentCondition_Init_call = 0;
+    whenShallCondition_Init_fail = 0;
 
-    currentCond_Post_call = 0;
-    whenShallCond_Post_fail = 0;
+    currentCondition_Wait_call = 0;
+    whenShallCondition_Wait_fail = 0;
 
-    currentThreadAPI_Create_call = 0;
-    whenShallThreadAPI_Create_fail = 0;
+    currentMESSAGE_QUEUE_create_call = 0;
+    whenShallMESSAGE_QUEUE_create_fail = 0;
 
-    current_nn_socket_index = 0;
-    for (int l = 0; l < 10; l++)
-    {
-        nn_socket_memory[l] = NULL;
-    }
+    currentMESSAGE_QUEUE_push_call = 0;
+    whenShallMESSAGE_QUEUE_push_fail = 0;
 
-    nn_current_msg_size = 0;
+    currentMessage_Clone_call = 0;
+    whenShallMessage_Clone_fail = 0;
+
+    currentThreadAPI_Create_call = 0;
+    whenShallThreadAPI_Create_fail = 0;
 
     thread_func_to_call = NULL;
     thread_func_args = NULL;
+    run_worker_on_join = false;
 
+    batch_calls = 0;
+    last_batch_count = 0;
 
     call_status_for_FakeModule_Receive.messageHandle = NULL;
     call_status_for_FakeModule_Receive.module = NULL;
@@ -719,10 +715,7 @@ TEST_FUNCTION_CLEANUP(TestMethodCleanup)
 //Tests_SRS_BROKER_13_001: [This API shall yield a BROKER_HANDLE representing the newly created message broker. This handle value shall not be equal to NULL when the API call is successful.]
 //Tests_SRS_BROKER_13_007: [Broker_Create shall initialize BROKER_HANDLE_DATA::modules with a valid VECTOR_HANDLE.]
 //Tests_SRS_BROKER_13_023: [Broker_Create shall initialize BROKER_HANDLE_DATA::modules_lock with a valid LOCK_HANDLE.]
-//Tests_SRS_BROKER_17_001: [ Broker_Create shall initialize a socket for publishing messages. ]
-//Tests_SRS_BROKER_17_002: [ Broker_Create shall create a unique id. ]
-//Tests_SRS_BROKER_17_003: [ Broker_Create shall initialize a url consisting of "inproc://" + unique id. ]
-//Tests_SRS_BROKER_17_004: [ Broker_Create shall bind the socket to the BROKER_HANDLE_DATA::url. ]
+//Tests_SRS_BROKER_17_054: [ Broker_Create shall initialize BROKER_HANDLE_DATA::routing to an empty routing table. ]
 TEST_FUNCTION(Broker_Create_succeeds)
 {
     ///arrange
@@ -732,18 +725,7 @@ TEST_FUNCTION(Broker_Create_succeeds)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_create());
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
-    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PUB));
-    STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("inproc://"));
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, nn_bind(IGNORED_NUM_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+
     ///act
     auto r = Broker_Create();
 
@@ -825,195 +807,129 @@ TEST_FUNCTION(Broker_Create_fails_when_Lock_Init_fails)
     ///cleanup
 }
 
-
-//Tests_SRS_BROKER_13_003: [This function shall return NULL if an underlying API call to the platform causes an error.]
-TEST_FUNCTION(Broker_Create_fails_when_socket_fails)
+//Tests_SRS_BROKER_17_072: [ Broker_CreateWithThreadPool shall behave as Broker_Create when thread_count is 0. ]
+TEST_FUNCTION(Broker_CreateWithThreadPool_with_zero_threads_starts_no_pool)
 {
     ///arrange
     CBrokerMocks mocks;
 
     STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_create());
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
-    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PUB))
-        .SetFailReturn(-1);
 
     ///act
-    auto r = Broker_Create();
+    auto r = Broker_CreateWithThreadPool(0);
 
     ///assert
-    ASSERT_IS_NULL(r);
+    ASSERT_IS_NOT_NULL(r);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     Broker_Destroy(r);
 }
 
-
-//Tests_SRS_BROKER_13_003: [This function shall return NULL if an underlying API call to the platform causes an error.]
-TEST_FUNCTION(Broker_Create_fails_when_uuid_fails)
+//Tests_SRS_BROKER_17_073: [ Broker_CreateWithThreadPool shall start a pool of thread_count threads shared by the modules of the broker. ]
+//Tests_SRS_BROKER_17_081: [ If the broker has a thread pool, Broker_Destroy shall stop and join every pool thread. ]
+TEST_FUNCTION(Broker_CreateWithThreadPool_succeeds)
 {
     ///arrange
     CBrokerMocks mocks;
 
     STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_create());
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
-    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the pool*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PUB));
-    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the pool workers*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
-        .IgnoreArgument(1)
-        .SetFailReturn(UNIQUEID_ERROR);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
 
     ///act
-    auto r = Broker_Create();
+    auto r = Broker_CreateWithThreadPool(2);
 
     ///assert
-    ASSERT_IS_NULL(r);
+    ASSERT_IS_NOT_NULL(r);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     Broker_Destroy(r);
 }
 
-
-//Tests_SRS_BROKER_13_003: [This function shall return NULL if an underlying API call to the platform causes an error.]
-TEST_FUNCTION(Broker_Create_fails_when_url_create_fails)
+//Tests_SRS_BROKER_17_074: [ If the pool cannot be started, Broker_CreateWithThreadPool shall free all resources and return NULL. ]
+TEST_FUNCTION(Broker_CreateWithThreadPool_fails_when_ThreadAPI_Create_fails)
 {
     ///arrange
     CBrokerMocks mocks;
 
     STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_create());
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_destroy(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the pool*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the pool workers*/
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    whenShallThreadAPI_Create_fail = 2;
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    // the thread that did start is stopped and joined
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PUB));
-    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("inproc://"))
-        .SetFailReturn((STRING_HANDLE)NULL);
-
-
-    ///act
-    auto r = Broker_Create();
-
-    ///assert
-    ASSERT_IS_NULL(r);
-    mocks.AssertActualAndExpectedCalls();
-
-    ///cleanup
-    Broker_Destroy(r);
-}
-
-//Tests_SRS_BROKER_13_003: [This function shall return NULL if an underlying API call to the platform causes an error.]
-TEST_FUNCTION(Broker_Create_fails_when_url_concat_fails)
-{
-    ///arrange
-    CBrokerMocks mocks;
-
-    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_create());
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_destroy(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+
+    // and so is the broker
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PUB));
-    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("inproc://"));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .SetFailReturn(1);
 
     ///act
-    auto r = Broker_Create();
+    auto r = Broker_CreateWithThreadPool(2);
 
     ///assert
     ASSERT_IS_NULL(r);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
-    Broker_Destroy(r);
 }
 
-//Tests_SRS_BROKER_13_003: [This function shall return NULL if an underlying API call to the platform causes an error.]
-TEST_FUNCTION(Broker_Create_fails_when_bind_fails)
-{
-    ///arrange
-    CBrokerMocks mocks;
-
-    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_create());
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Lock_Init());
-    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PUB));
-    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("inproc://"));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, nn_bind(IGNORED_NUM_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .SetFailReturn(-1);
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    ///act
-    auto r = Broker_Create();
-
-    ///assert
-    ASSERT_IS_NULL(r);
-    mocks.AssertActualAndExpectedCalls();
-
-    ///cleanup
-    Broker_Destroy(r);
-}
-
-//Tests_SRS_BROKER_99_013: [ If broker or module is NULL the function shall return BROKER_INVALIDARG. ]
-TEST_FUNCTION(Broker_AddModule_fails_with_null_broker)
+//Tests_SRS_BROKER_99_013: [ If broker or module is NULL the function shall return BROKER_INVALIDARG. ]
+TEST_FUNCTION(Broker_AddModule_fails_with_null_broker)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -1088,6 +1004,7 @@ TEST_FUNCTION(Broker_AddModule_fails_with_null_module_handle)
 
     ///cleanup
 }
+
 //Tests_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
 TEST_FUNCTION(Broker_AddModule_fails_when_alloc_module_info_fails)
 {
@@ -1096,8 +1013,6 @@ TEST_FUNCTION(Broker_AddModule_fails_when_alloc_module_info_fails)
     auto broker = Broker_Create();
     mocks.ResetAllCalls();
 
-
-
     // this is for the Broker_AddModule call
     whenShallmalloc_fail = currentmalloc_call + 1;
     STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module_info*/
@@ -1127,11 +1042,10 @@ TEST_FUNCTION(Broker_AddModule_fails_when_module_struct_alloc_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    whenShallmalloc_fail = currentmalloc_call + 2;
     STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module struct*/
-        .IgnoreArgument(1)
-        .SetFailReturn(nullptr);
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(NULL))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(NULL));
 
     ///act
     auto result = Broker_AddModule(broker, &fake_module);
@@ -1176,7 +1090,7 @@ TEST_FUNCTION(Broker_AddModule_fails_when_Lock_Init_fails)
 }
 
 //Tests_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_AddModule_fails_quit_uuid_fails)
+TEST_FUNCTION(Broker_AddModule_fails_when_Condition_Init_fails)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -1195,9 +1109,8 @@ TEST_FUNCTION(Broker_AddModule_fails_quit_uuid_fails)
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
-        .IgnoreArgument(1)
-        .SetFailReturn(UNIQUEID_ERROR);
+    whenShallCondition_Init_fail = currentCondition_Init_call + 1;
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
 
     ///act
     auto result = Broker_AddModule(broker, &fake_module);
@@ -1211,7 +1124,7 @@ TEST_FUNCTION(Broker_AddModule_fails_quit_uuid_fails)
 }
 
 //Tests_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_AddModule_fails_string_construct_fails)
+TEST_FUNCTION(Broker_AddModule_fails_when_MESSAGE_QUEUE_create_fails)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -1230,11 +1143,11 @@ TEST_FUNCTION(Broker_AddModule_fails_string_construct_fails)
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .SetFailReturn((STRING_HANDLE)NULL);
+    whenShallMESSAGE_QUEUE_create_fail = currentMESSAGE_QUEUE_create_call + 1;
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_create());
 
     ///act
     auto result = Broker_AddModule(broker, &fake_module);
@@ -1267,11 +1180,11 @@ TEST_FUNCTION(Broker_AddModule_fails_Lock_modules_lock_fails)
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_create());
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1)
@@ -1308,17 +1221,17 @@ TEST_FUNCTION(Broker_AddModule_fails_when_singlylinkedlist_add_fails)
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_create());
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    whenShallsinglylinkedlist_add_fail = 1;
+    whenShallsinglylinkedlist_add_fail = currentsinglylinkedlist_add_call + 1;
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
 
@@ -1333,9 +1246,8 @@ TEST_FUNCTION(Broker_AddModule_fails_when_singlylinkedlist_add_fails)
     Broker_Destroy(broker);
 }
 
-
 //Tests_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_AddModule_fails_when_nn_socket_fails)
+TEST_FUNCTION(Broker_AddModule_fails_when_ThreadAPI_Create_fails)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -1354,11 +1266,11 @@ TEST_FUNCTION(Broker_AddModule_fails_when_nn_socket_fails)
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_create());
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
@@ -1368,8 +1280,9 @@ TEST_FUNCTION(Broker_AddModule_fails_when_nn_socket_fails)
         .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_SUB))
-        .SetFailReturn(-1);
+    whenShallThreadAPI_Create_fail = 1;
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
 
     ///act
     auto result = Broker_AddModule(broker, &fake_module);
@@ -1382,8 +1295,16 @@ TEST_FUNCTION(Broker_AddModule_fails_when_nn_socket_fails)
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_AddModule_fails_when_nn_connect_fails)
+//Tests_SRS_BROKER_13_107 : [The function shall assign the module handle to BROKER_MODULEINFO::module.]
+//Tests_SRS_BROKER_13_099: [ The function shall initialize BROKER_MODULEINFO::mq_lock with a valid lock handle. ]
+//Tests_SRS_BROKER_17_043: [ The function shall initialize BROKER_MODULEINFO::mq_cond with a valid condition handle. ]
+//Tests_SRS_BROKER_17_044: [ The function shall create BROKER_MODULEINFO::mq, an empty queue of messages waiting to be delivered to the module. ]
+//Tests_SRS_BROKER_13_102 : [The function shall create a new thread for the module by calling ThreadAPI_Create using module_worker as the thread callback and using the newly allocated BROKER_MODULEINFO object as the thread context.]
+//Tests_SRS_BROKER_13_039 : [This function shall acquire the lock on BROKER_HANDLE_DATA::modules_lock.]
+//Tests_SRS_BROKER_13_045 : [Broker_AddModule shall append the new instance of BROKER_MODULEINFO to BROKER_HANDLE_DATA::modules.]
+//Tests_SRS_BROKER_13_046 : [This function shall release the lock on BROKER_HANDLE_DATA::modules_lock.]
+//Tests_SRS_BROKER_13_047 : [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
+TEST_FUNCTION(Broker_AddModule_succeeds)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -1393,226 +1314,134 @@ TEST_FUNCTION(Broker_AddModule_fails_when_nn_connect_fails)
     // this is for the Broker_AddModule call
     STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module_info*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module struct*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
-    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_create());
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_SUB));
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_connect(IGNORED_NUM_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments()
-        .SetFailReturn(-1);
-    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
     ///act
     auto result = Broker_AddModule(broker, &fake_module);
 
     ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_AddModule_fails_when_nn_setSocketOpts_fails)
+//Tests_SRS_BROKER_17_061: [ If queue_config is NULL or its capacity is 0 the queue shall be unbounded, otherwise the function shall create the queue with MESSAGE_QUEUE_create_bounded. ]
+TEST_FUNCTION(Broker_AddModuleWithQueue_creates_a_bounded_queue)
 {
     ///arrange
     CBrokerMocks mocks;
     auto broker = Broker_Create();
+    BROKER_QUEUE_CONFIG queue_config = { 10, BROKER_QUEUE_POLICY_DROP_OLDEST };
     mocks.ResetAllCalls();
 
-    // this is for the Broker_AddModule call
     STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module_info*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module struct*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
-    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_create_bounded(10));
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_SUB));
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_connect(IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_SUBSCRIBE, IGNORED_PTR_ARG, 36))
-        .IgnoreArgument(1)
-        .IgnoreArgument(4)
-        .SetFailReturn(-1);
-    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
     ///act
-    auto result = Broker_AddModule(broker, &fake_module);
+    auto result = Broker_AddModuleWithQueue(broker, &fake_module, &queue_config);
 
     ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_AddModule_fails_when_ThreadAPI_Create_fails)
+//Tests_SRS_BROKER_17_061: [ If queue_config is NULL or its capacity is 0 the queue shall be unbounded, otherwise the function shall create the queue with MESSAGE_QUEUE_create_bounded. ]
+TEST_FUNCTION(Broker_AddModuleWithQueue_with_zero_capacity_creates_an_unbounded_queue)
 {
     ///arrange
     CBrokerMocks mocks;
     auto broker = Broker_Create();
+    BROKER_QUEUE_CONFIG queue_config = { 0, BROKER_QUEUE_POLICY_BLOCK };
     mocks.ResetAllCalls();
 
-    // this is for the Broker_AddModule call
-    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module_info*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module_info*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module struct*/
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
-    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_create());
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_SUB));
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_connect(IGNORED_NUM_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_SUBSCRIBE, IGNORED_PTR_ARG, 36))
-        .IgnoreArgument(1)
-        .IgnoreArgument(4);
-    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
-    whenShallThreadAPI_Create_fail = 1;
     STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     ///act
-    auto result = Broker_AddModule(broker, &fake_module);
+    auto result = Broker_AddModuleWithQueue(broker, &fake_module, &queue_config);
 
     ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
     Broker_Destroy(broker);
 }
 
-
-
-//Tests_SRS_BROKER_13_107 : [The function shall assign the module handle to BROKER_MODULEINFO::module.]
-//Tests_SRS_BROKER_17_013: [ The function shall create a nanomsg socket for reception. ]
-//Tests_SRS_BROKER_17_014: [ The function shall bind the socket to the the BROKER_HANDLE_DATA::url. ]
-//Tests_SRS_BROKER_13_099: [ The function shall initialize BROKER_MODULEINFO::socket_lock with a valid lock handle. ]
-//Tests_SRS_BROKER_17_020: [ The function shall create a unique ID used as a quit signal. ]
-//Tests_SRS_BROKER_13_102 : [The function shall create a new thread for the module by calling ThreadAPI_Create using module_publish_worker as the thread callback and using the newly allocated BROKER_MODULEINFO object as the thread context.]
-//Tests_SRS_BROKER_13_039 : [This function shall acquire the lock on BROKER_HANDLE_DATA::modules_lock.]
-//Tests_SRS_BROKER_13_045 : [Broker_AddModule shall append the new instance of BROKER_MODULEINFO to BROKER_HANDLE_DATA::modules.]
-//Tests_SRS_BROKER_13_046 : [This function shall release the lock on BROKER_HANDLE_DATA::modules_lock.]
-//Tests_SRS_BROKER_13_047 : [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-//Tests_SRS_BROKER_17_028: [ The function shall subscribe BROKER_MODULEINFO::receive_socket to the quit signal GUID. ]
-TEST_FUNCTION(Broker_AddModule_succeeds)
+//Tests_SRS_BROKER_17_062: [ If the queue is bounded and its policy is BROKER_QUEUE_POLICY_BLOCK, the function shall initialize BROKER_MODULEINFO::mq_space_cond with a valid condition handle. ]
+TEST_FUNCTION(Broker_AddModuleWithQueue_block_policy_creates_space_condition)
 {
     ///arrange
     CBrokerMocks mocks;
     auto broker = Broker_Create();
+    BROKER_QUEUE_CONFIG queue_config = { 10, BROKER_QUEUE_POLICY_BLOCK };
     mocks.ResetAllCalls();
 
-    // this is for the Broker_AddModule call
     STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module_info*/
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module struct*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
-    STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Init())
+        .ExpectedTimesExactly(2);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_create_bounded(10));
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_SUB));
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_connect(IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_SUBSCRIBE, IGNORED_PTR_ARG, 36))
-        .IgnoreArgument(1)
-        .IgnoreArgument(4);
     STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     ///act
-    auto result = Broker_AddModule(broker, &fake_module);
+    auto result = Broker_AddModuleWithQueue(broker, &fake_module, &queue_config);
 
     ///assert
     ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
@@ -1623,114 +1452,74 @@ TEST_FUNCTION(Broker_AddModule_succeeds)
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_13_026: [ This function shall assign user_data to a local variable called module_info of type BROKER_MODULEINFO*. ]
-//Tests_SRS_BROKER_13_089: [ This function shall acquire the lock on module_info->socket_lock. ]
-//Tests_SRS_BROKER_13_068: [ This function shall run a loop that keeps running until module_info->quit_message_guid is sent to the thread. ]
-//Tests_SRS_BROKER_13_091: [ The function shall unlock module_info->socket_lock. ]
-//Tests_SRS_BROKER_17_005: [ For every iteration of the loop, the function shall wait on the receive_socket for messages. ]
-//Tests_SRS_BROKER_17_017: [ The function shall deserialize the message received. ]
-//Tests_SRS_BROKER_13_092: [ The function shall deliver the message to the module's callback function via module_info->module_apis. ]
-//Tests_SRS_BROKER_13_093: [ The function shall destroy the message that was dequeued by calling Message_Destroy. ]
-//Tests_SRS_BROKER_17_019: [ The function shall free the buffer received on the receive_socket. ]
-//Tests_SRS_BROKER_17_024: [ The function shall strip off the topic from the message. ]
-TEST_FUNCTION(module_publish_worker_calls_receive_once_then_exits_on_quit_msg)
+//Tests_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]
+TEST_FUNCTION(Broker_AddModuleWithQueue_fails_when_space_Condition_Init_fails)
 {
+    ///arrange
     CBrokerMocks mocks;
     auto broker = Broker_Create();
-
-    // setup fake module's validation data
-    unsigned char fake;
-    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
-    auto message = Message_Create(&c);
-    call_status_for_FakeModule_Receive.module = fake_module.module_handle;
-    call_status_for_FakeModule_Receive.messageHandle = message;
-
-    (void)Broker_AddModule(broker, &fake_module);
-
+    BROKER_QUEUE_CONFIG queue_config = { 10, BROKER_QUEUE_POLICY_BLOCK };
     mocks.ResetAllCalls();
 
-    //loop 1
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module_info*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module struct*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Message_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    //loop 2
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+    whenShallCondition_Init_fail = currentCondition_Init_call + 2;
+    STRICT_EXPECTED_CALL(mocks, Condition_Init())
+        .ExpectedTimesExactly(2);
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .SetReturn(37);
-    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_create_bounded(10));
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    // buf from nn_recv will always be "nn_recv", so match this here to let it
-    // recognize quit message
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .SetFailReturn("nn_recv");
-
 
-    auto result = thread_func_to_call(thread_func_args);
+    ///act
+    auto result = Broker_AddModuleWithQueue(broker, &fake_module, &queue_config);
 
-    ASSERT_ARE_EQUAL(int, result, 0);
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
-    Message_Destroy(message);
-    Broker_RemoveModule(broker, &fake_module);
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_02_004: [ If acquiring the lock fails, then module_publish_worker shall return. ]
-TEST_FUNCTION(module_publish_worker_exits_on_lock_fail)
+//Tests_SRS_BROKER_17_063: [ If queue_config->policy is not a valid BROKER_QUEUE_POLICY the function shall return BROKER_INVALIDARG. ]
+TEST_FUNCTION(Broker_AddModuleWithQueue_fails_with_invalid_policy)
 {
+    ///arrange
     CBrokerMocks mocks;
     auto broker = Broker_Create();
-
-    // setup fake module's validation data
-    unsigned char fake;
-    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
-    auto message = Message_Create(&c);
-    call_status_for_FakeModule_Receive.module = fake_module.module_handle;
-    call_status_for_FakeModule_Receive.messageHandle = message;
-
-    (void)Broker_AddModule(broker, &fake_module);
-
+    BROKER_QUEUE_CONFIG queue_config = { 10, (BROKER_QUEUE_POLICY)42 };
     mocks.ResetAllCalls();
 
-    //loop 1
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .SetFailReturn(LOCK_ERROR);
-
-
-    auto result = thread_func_to_call(thread_func_args);
+    ///act
+    auto result = Broker_AddModuleWithQueue(broker, &fake_module, &queue_config);
 
-    ASSERT_ARE_EQUAL(int, result, 0);
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_INVALIDARG);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
-    Message_Destroy(message);
-    Broker_RemoveModule(broker, &fake_module);
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_13_091: [ The function shall unlock module_info->socket_lock. ]
-//Tests_SRS_BROKER_17_016: [ If releasing the lock fails, then module_publish_worker shall return. ]
-TEST_FUNCTION(module_publish_worker_exits_on_Unlock_fail)
+//Tests_SRS_BROKER_13_026: [ This function shall assign user_data to a local variable called module_info of type BROKER_MODULEINFO*. ]
+//Tests_SRS_BROKER_13_089: [ This function shall acquire the lock on module_info->mq_lock. ]
+//Tests_SRS_BROKER_17_048: [ The function shall pop the next message from module_info->mq. ]
+//Tests_SRS_BROKER_13_091: [ The function shall unlock module_info->mq_lock. ]
+//Tests_SRS_BROKER_13_092: [ The function shall deliver the message to the module's callback function via module_info->module_apis. ]
+//Tests_SRS_BROKER_13_093: [ The function shall destroy the message that was dequeued by calling Message_Destroy. ]
+//Tests_SRS_BROKER_17_046: [ If module_info->mq is empty and module_info->quit_worker is not set, the function shall wait on module_info->mq_cond. ]
+//Tests_SRS_BROKER_17_047: [ If waiting on module_info->mq_cond fails, then module_worker shall return. ]
+TEST_FUNCTION(module_worker_delivers_queued_message_then_waits)
 {
     CBrokerMocks mocks;
     auto broker = Broker_Create();
@@ -1742,26 +1531,42 @@ TEST_FUNCTION(module_publish_worker_exits_on_Unlock_fail)
     call_status_for_FakeModule_Receive.module = fake_module.module_handle;
     call_status_for_FakeModule_Receive.messageHandle = message;
 
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
     (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddLink(broker, &bld);
+    (void)Broker_Publish(broker, fake_module_handle, message);
 
     mocks.ResetAllCalls();
 
     //loop 1
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .SetFailReturn(LOCK_ERROR);
-    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
+
+    //loop 2
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    whenShallCondition_Wait_fail = currentCondition_Wait_call + 1;
+    STRICT_EXPECTED_CALL(mocks, Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 0))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-
     auto result = thread_func_to_call(thread_func_args);
 
     ASSERT_ARE_EQUAL(int, result, 0);
+    ASSERT_IS_TRUE(call_status_for_FakeModule_Receive.was_called);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
@@ -1770,47 +1575,166 @@ TEST_FUNCTION(module_publish_worker_exits_on_Unlock_fail)
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_17_006: [ An error on receiving a message shall terminate the loop. ]
-TEST_FUNCTION(module_publish_worker_exits_on_nn_recv_error)
+//Tests_SRS_BROKER_17_082: [ If the module implements Module_ReceiveBatch, the function shall take up to BROKER_RECEIVE_BATCH_MAX messages off module_info->mq at once, otherwise one. ]
+//Tests_SRS_BROKER_17_083: [ The function shall deliver the messages it took in one call to Module_ReceiveBatch when the module implements it. ]
+TEST_FUNCTION(module_worker_delivers_queued_messages_in_one_batch)
 {
     CBrokerMocks mocks;
     auto broker = Broker_Create();
 
-    // setup fake module's validation data
     unsigned char fake;
     MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
     auto message = Message_Create(&c);
-    call_status_for_FakeModule_Receive.module = fake_module.module_handle;
-    call_status_for_FakeModule_Receive.messageHandle = message;
+    call_status_for_FakeModule_Receive.module = fake_batch_module.module_handle;
 
-    (void)Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    (void)Broker_AddModule(broker, &fake_batch_module);
+    (void)Broker_AddLink(broker, &bld);
+    (void)Broker_Publish(broker, fake_module_handle, message);
+    (void)Broker_Publish(broker, fake_module_handle, message);
+    (void)Broker_Publish(broker, fake_module_handle, message);
 
     mocks.ResetAllCalls();
 
-    //loop 1
+    //loop 1 takes every queued message under one lock
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
+
+    //loop 2
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    whenShallCondition_Wait_fail = currentCondition_Wait_call + 1;
+    STRICT_EXPECTED_CALL(mocks, Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 0))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .SetFailReturn(-1);
-
 
     auto result = thread_func_to_call(thread_func_args);
 
     ASSERT_ARE_EQUAL(int, result, 0);
+    ASSERT_ARE_EQUAL(size_t, 1, batch_calls);
+    ASSERT_ARE_EQUAL(size_t, 3, last_batch_count);
+    ASSERT_IS_FALSE(call_status_for_FakeModule_Receive.was_called);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_batch_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_13_068: [ This function shall run a loop that keeps running until module_info->quit_worker is set. ]
+TEST_FUNCTION(module_worker_exits_when_quit_worker_is_set)
+{
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+
+    (void)Broker_AddModule(broker, &fake_module);
+
+    mocks.ResetAllCalls();
+
+    // Broker_RemoveModule
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, &fake_module))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    // the worker sees quit_worker on its first iteration and never pops
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    run_worker_on_join = true;
+
+    ///act
+    auto result = Broker_RemoveModule(broker, &fake_module);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    ASSERT_IS_FALSE(call_status_for_FakeModule_Receive.was_called);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_02_004: [ If acquiring the lock fails, then module_worker shall return. ]
+TEST_FUNCTION(module_worker_exits_on_lock_fail)
+{
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+
+    (void)Broker_AddModule(broker, &fake_module);
+
+    mocks.ResetAllCalls();
+
+    //loop 1
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn(LOCK_ERROR);
+
+    auto result = thread_func_to_call(thread_func_args);
+
+    ASSERT_ARE_EQUAL(int, result, 0);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
     Broker_RemoveModule(broker, &fake_module);
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_13_068: [ This function shall run a loop that keeps running until module_info->quit_message_guid is sent to the thread. ]
-TEST_FUNCTION(module_publish_worker_message_size_matches_but_not_quit_for_me)
+//Tests_SRS_BROKER_13_091: [ The function shall unlock module_info->mq_lock. ]
+//Tests_SRS_BROKER_17_016: [ If releasing the lock fails, then module_worker shall return. ]
+TEST_FUNCTION(module_worker_exits_on_Unlock_fail_and_destroys_message)
 {
     CBrokerMocks mocks;
     auto broker = Broker_Create();
@@ -1822,65 +1746,221 @@ TEST_FUNCTION(module_publish_worker_message_size_matches_but_not_quit_for_me)
     call_status_for_FakeModule_Receive.module = fake_module.module_handle;
     call_status_for_FakeModule_Receive.messageHandle = message;
 
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
     (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddLink(broker, &bld);
+    (void)Broker_Publish(broker, fake_module_handle, message);
 
     mocks.ResetAllCalls();
 
     //loop 1
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_pop(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .SetReturn(37);
-    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+        .SetFailReturn(LOCK_ERROR);
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
+
+    auto result = thread_func_to_call(thread_func_args);
+
+    ASSERT_ARE_EQUAL(int, result, 0);
+    ASSERT_IS_FALSE(call_status_for_FakeModule_Receive.was_called);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_047: [ If waiting on module_info->mq_cond fails, then module_worker shall return. ]
+TEST_FUNCTION(module_worker_exits_on_Condition_Wait_fail)
+{
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+
+    (void)Broker_AddModule(broker, &fake_module);
+
+    mocks.ResetAllCalls();
+
+    //loop 1
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    // buf from nn_recv will always be "nn_recv", so force a mismatch
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .SetFailReturn("nn_send");
-    STRICT_EXPECTED_CALL(mocks, Message_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    whenShallCondition_Wait_fail = currentCondition_Wait_call + 1;
+    STRICT_EXPECTED_CALL(mocks, Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 0))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    //loop 2
+    auto result = thread_func_to_call(thread_func_args);
+
+    ASSERT_ARE_EQUAL(int, result, 0);
+    ASSERT_IS_FALSE(call_status_for_FakeModule_Receive.was_called);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_075: [ If the broker has a thread pool, the function shall assign the module to a pool thread instead of creating a thread for it, unless queue_config asks for a dedicated thread or its queue uses BROKER_QUEUE_POLICY_BLOCK. ]
+TEST_FUNCTION(Broker_AddModule_on_pooled_broker_creates_no_thread)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_CreateWithThreadPool(1);
+    mocks.ResetAllCalls();
+
+    // this is for the Broker_AddModule call
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module_info*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module struct*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_create());
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .SetReturn(37);
-    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+
+    ///act
+    auto result = Broker_AddModule(broker, &fake_module);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_075: [ If the broker has a thread pool, the function shall assign the module to a pool thread instead of creating a thread for it, unless queue_config asks for a dedicated thread or its queue uses BROKER_QUEUE_POLICY_BLOCK. ]
+TEST_FUNCTION(Broker_AddModuleWithQueue_dedicated_thread_creates_a_thread_on_pooled_broker)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_CreateWithThreadPool(1);
+    BROKER_QUEUE_CONFIG queue_config = { 0, BROKER_QUEUE_POLICY_DROP_OLDEST, true };
+    mocks.ResetAllCalls();
+
+    // this is for the Broker_AddModuleWithQueue call
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module_info*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module struct*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_create());
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    // buf from nn_recv will always be "nn_recv", so match this here to let it
-    // recognize quit message
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .SetFailReturn("nn_recv");
 
+    ///act
+    auto result = Broker_AddModuleWithQueue(broker, &fake_module, &queue_config);
 
-    auto result = thread_func_to_call(thread_func_args);
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
 
-    ASSERT_ARE_EQUAL(int, result, 0);
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_076: [ If the sink is run by the thread pool and is not already scheduled, Broker_Publish shall mark it as scheduled and hand it to the pool instead of signaling BROKER_MODULEINFO::mq_cond. ]
+TEST_FUNCTION(Broker_Publish_schedules_a_pooled_module_once)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_CreateWithThreadPool(1);
+
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+    call_status_for_FakeModule_Receive.module = fake_module.module_handle;
+    call_status_for_FakeModule_Receive.messageHandle = message;
+
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddLink(broker, &bld);
+
+    mocks.ResetAllCalls();
+
+    // first publish queues the message and hands the module to the pool
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_push(IGNORED_PTR_ARG, message))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting the run queue*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting the pool*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    // second publish only queues the message
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_push(IGNORED_PTR_ARG, message))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result1 = Broker_Publish(broker, fake_module_handle, message);
+    auto result2 = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result1, BROKER_OK);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result2, BROKER_OK);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
+    // let the pool thread deliver both messages so the module can be removed
+    whenShallCondition_Wait_fail = currentCondition_Wait_call + 1;
+    (void)thread_func_to_call(thread_func_args);
     Message_Destroy(message);
     Broker_RemoveModule(broker, &fake_module);
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_17_018: [ If the deserialization is not successful, the message loop shall continue. ]
-TEST_FUNCTION(module_publish_worker_continue_on_CreateFromByteArray_fails)
+//Tests_SRS_BROKER_17_077: [ A pool thread shall run the modules of its own run queue first and take a module from the run queue of another pool thread when its own is empty. ]
+//Tests_SRS_BROKER_17_078: [ A pool thread shall deliver the messages of a module in the order they were queued, at most BROKER_POOL_QUANTUM at a time, then put the module back on its run queue if more messages are waiting or mark it as not scheduled otherwise. ]
+//Tests_SRS_BROKER_17_079: [ A pool thread shall wait on the pool condition while no module is ready, and exit when the pool is asked to quit or waiting fails. ]
+TEST_FUNCTION(pool_worker_delivers_queued_message_then_waits)
 {
     CBrokerMocks mocks;
-    auto broker = Broker_Create();
+    auto broker = Broker_CreateWithThreadPool(1);
 
     // setup fake module's validation data
     unsigned char fake;
@@ -1889,46 +1969,64 @@ TEST_FUNCTION(module_publish_worker_continue_on_CreateFromByteArray_fails)
     call_status_for_FakeModule_Receive.module = fake_module.module_handle;
     call_status_for_FakeModule_Receive.messageHandle = message;
 
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
     (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddLink(broker, &bld);
+    (void)Broker_Publish(broker, fake_module_handle, message);
 
     mocks.ResetAllCalls();
 
-    //loop 1
+    // take the module off the run queue
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Message_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .SetFailReturn((MESSAGE_HANDLE)NULL);
 
-    //loop 2
+    // deliver the message
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .SetReturn(37);
-    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
+
+    // the queue is empty, let go of the module
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_is_empty(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    // buf from nn_recv will always be "nn_recv", so match this here to let it
-    // recognize quit message
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .SetFailReturn("nn_recv");
 
+    // nothing else is ready, wait for work
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    whenShallCondition_Wait_fail = currentCondition_Wait_call + 1;
+    STRICT_EXPECTED_CALL(mocks, Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 0))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     auto result = thread_func_to_call(thread_func_args);
 
     ASSERT_ARE_EQUAL(int, result, 0);
+    ASSERT_IS_TRUE(call_status_for_FakeModule_Receive.was_called);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
@@ -1937,6 +2035,55 @@ TEST_FUNCTION(module_publish_worker_continue_on_CreateFromByteArray_fails)
     Broker_Destroy(broker);
 }
 
+//Tests_SRS_BROKER_17_080: [ If the module is run by the thread pool, Broker_RemoveModule shall set BROKER_MODULEINFO::quit_worker and wait on BROKER_MODULEINFO::mq_cond until no pool thread holds the module. ]
+TEST_FUNCTION(Broker_RemoveModule_on_pooled_broker_joins_no_thread)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_CreateWithThreadPool(1);
+    (void)Broker_AddModule(broker, &fake_module);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, &fake_module))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = Broker_RemoveModule(broker, &fake_module);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
 //Tests_SRS_BROKER_13_048: [If broker or module is NULL the function shall return BROKER_INVALIDARG.]
 TEST_FUNCTION(Broker_RemoveModule_fails_with_null_broker)
 {
@@ -1944,10 +2091,10 @@ TEST_FUNCTION(Broker_RemoveModule_fails_with_null_broker)
     CBrokerMocks mocks;
 
     ///act
-    auto r1 = Broker_RemoveModule(NULL, (MODULE*)0x1);
+    auto result = Broker_RemoveModule(NULL, &fake_module);
 
     ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, r1, BROKER_INVALIDARG);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_INVALIDARG);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
@@ -1960,27 +2107,25 @@ TEST_FUNCTION(Broker_RemoveModule_fails_with_null_module)
     CBrokerMocks mocks;
 
     ///act
-    auto r1 = Broker_RemoveModule((BROKER_HANDLE)0x1, NULL);
+    auto result = Broker_RemoveModule((BROKER_HANDLE)0x1, NULL);
 
     ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, r1, BROKER_INVALIDARG);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_INVALIDARG);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
 }
 
-//Tests_SRS_BROKER_13_088 : [This function shall acquire the lock on BROKER_HANDLE_DATA::modules_lock.]
-//Tests_SRS_BROKER_13_049 : [Broker_RemoveModule shall perform a linear search for module in BROKER_HANDLE_DATA::modules.]
-//Tests_SRS_BROKER_13_050 : [Broker_RemoveModule shall unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_ERROR if the module is not found in BROKER_HANDLE_DATA::modules.]
-//Tests_SRS_BROKER_13_052 : [The function shall remove the module from BROKER_HANDLE_DATA::modules.]
-//Tests_SRS_BROKER_13_054 : [This function shall release the lock on BROKER_HANDLE_DATA::modules_lock.]
-//Tests_SRS_BROKER_17_021: [ This function shall send a quit signal to the worker thread by sending BROKER_MODULEINFO::quit_message_guid to the publish_socket. ]
-//Tests_SRS_BROKER_02_001: [ Broker_RemoveModule shall lock BROKER_MODULEINFO::socket_lock. ]
-//Tests_SRS_BROKER_17_015: [ This function shall close the BROKER_MODULEINFO::receive_socket. ]
-//Tests_SRS_BROKER_02_003: [ After closing the socket, Broker_RemoveModule shall unlock BROKER_MODULEINFO::info_lock. ]
-//Tests_SRS_BROKER_13_104 : [The function shall wait for the module's thread to exit by joining BROKER_MODULEINFO::thread via ThreadAPI_Join. ]
-//Tests_SRS_BROKER_13_057 : [The function shall free all members of the BROKER_MODULEINFO object.]
-//Tests_SRS_BROKER_13_053 : [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
+//Tests_SRS_BROKER_13_088: [This function shall acquire the lock on BROKER_HANDLE_DATA::modules_lock.]
+//Tests_SRS_BROKER_13_049: [Broker_RemoveModule shall perform a linear search for module in BROKER_HANDLE_DATA::modules.]
+//Tests_SRS_BROKER_13_052: [The function shall remove the module from BROKER_HANDLE_DATA::modules.]
+//Tests_SRS_BROKER_13_054: [This function shall release the lock on BROKER_HANDLE_DATA::modules_lock.]
+//Tests_SRS_BROKER_02_001: [ Broker_RemoveModule shall lock BROKER_MODULEINFO::mq_lock. ]
+//Tests_SRS_BROKER_17_049: [ This function shall signal the worker thread to quit by setting BROKER_MODULEINFO::quit_worker and posting BROKER_MODULEINFO::mq_cond. ]
+//Tests_SRS_BROKER_02_003: [ After signaling the worker, Broker_RemoveModule shall unlock BROKER_MODULEINFO::mq_lock. ]
+//Tests_SRS_BROKER_13_104: [The function shall wait for the module's thread to exit by joining BROKER_MODULEINFO::thread via ThreadAPI_Join. ]
+//Tests_SRS_BROKER_13_057: [The function shall free all members of the MODULE_INFO object.]
+//Tests_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
 TEST_FUNCTION(Broker_RemoveModule_succeeds)
 {
     ///arrange
@@ -2002,23 +2147,20 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 37, 0))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq_lock*/
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
@@ -2028,7 +2170,6 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds)
     STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-
     ///act
     result = Broker_RemoveModule(broker, &fake_module);
 
@@ -2040,6 +2181,41 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds)
     Broker_Destroy(broker);
 }
 
+//Tests_SRS_BROKER_13_057: [The function shall free all members of the MODULE_INFO object.]
+TEST_FUNCTION(Broker_RemoveModule_destroys_undelivered_messages)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddLink(broker, &bld);
+    (void)Broker_Publish(broker, fake_module_handle, message);
+    (void)Broker_Publish(broker, fake_module_handle, message);
+
+    // the queue now holds the only references to the message
+    Message_Destroy(message);
+
+    ///act
+    auto result = Broker_RemoveModule(broker, &fake_module);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    ASSERT_IS_FALSE(call_status_for_FakeModule_Receive.was_called);
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
 //Tests_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
 TEST_FUNCTION(Broker_RemoveModule_fails_when_Lock_fails)
 {
@@ -2050,9 +2226,9 @@ TEST_FUNCTION(Broker_RemoveModule_fails_when_Lock_fails)
     mocks.ResetAllCalls();
 
     // this is for the Broker_RemoveModule call
-    whenShallLock_fail = currentLock_call + 1;
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+        .IgnoreArgument(1)
+        .SetFailReturn(LOCK_ERROR);
 
     ///act
     result = Broker_RemoveModule(broker, &fake_module);
@@ -2066,7 +2242,6 @@ TEST_FUNCTION(Broker_RemoveModule_fails_when_Lock_fails)
     Broker_Destroy(broker);
 }
 
-
 //Tests_SRS_BROKER_13_050: [Broker_RemoveModule shall unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_ERROR if the module is not found in BROKER_HANDLE_DATA::modules.]
 TEST_FUNCTION(Broker_RemoveModule_fails_when_singlylinkedlist_find_fails)
 {
@@ -2081,7 +2256,7 @@ TEST_FUNCTION(Broker_RemoveModule_fails_when_singlylinkedlist_find_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    whenShallsinglylinkedlist_find_fail = 1;
+    whenShallsinglylinkedlist_find_fail = currentsinglylinkedlist_find_call + 1;
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, &fake_module))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
@@ -2097,9 +2272,9 @@ TEST_FUNCTION(Broker_RemoveModule_fails_when_singlylinkedlist_find_fails)
     Broker_RemoveModule(broker, &fake_module);
     Broker_Destroy(broker);
 }
-//Tests_SRS_BROKER_13_050: [Broker_RemoveModule shall unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_ERROR if the module is not found in BROKER_HANDLE_DATA::modules.]
 
-TEST_FUNCTION(Broker_RemoveModule_succeeds_when_nn_send_fails)
+//Tests_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
+TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_mq_Lock_fails)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -2120,20 +2295,19 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds_when_nn_send_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 37, 0))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .SetFailReturn(-1);
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+    whenShallLock_fail = currentLock_call + 2;
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
@@ -2154,13 +2328,20 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds_when_nn_send_fails)
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_13_050: [Broker_RemoveModule shall unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_ERROR if the module is not found in BROKER_HANDLE_DATA::modules.s]
-TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_Lock_fails)
+//Tests_SRS_BROKER_17_056: [ Broker_RemoveModule shall remove every route to the module from the routing table before stopping the module. ]
+//Tests_SRS_BROKER_17_055: [ When the routing table is replaced, the previous table shall not be freed until every Broker_Publish call that could be reading it has returned. ]
+TEST_FUNCTION(Broker_RemoveModule_removes_routes_to_the_module)
 {
     ///arrange
     CBrokerMocks mocks;
     auto broker = Broker_Create();
     auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    result = Broker_AddLink(broker, &bld);
     mocks.ResetAllCalls();
 
     // this is for the Broker_RemoveModule call
@@ -2176,22 +2357,22 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_Lock_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 37, 0))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this is for the previous routing table*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq_lock*/
-        .IgnoreArgument(1)
-        .SetFailReturn(LOCK_ERROR);
-    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
@@ -2212,13 +2393,20 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_Lock_fails)
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_13_050: [Broker_RemoveModule shall unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_ERROR if the module is not found in BROKER_HANDLE_DATA::modules.]
-TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_nn_close_fails)
+//Tests_SRS_BROKER_17_084: [ Before replacing the routing table, Broker_RemoveModule shall set BROKER_MODULEINFO::detaching and post BROKER_MODULEINFO::mq_space_cond, if any, while holding BROKER_MODULEINFO::mq_lock. ]
+TEST_FUNCTION(Broker_RemoveModule_wakes_blocked_publishers_before_removing_routes)
 {
     ///arrange
     CBrokerMocks mocks;
     auto broker = Broker_Create();
-    auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_QUEUE_CONFIG queue_config = { 1, BROKER_QUEUE_POLICY_BLOCK };
+    auto result = Broker_AddModuleWithQueue(broker, &fake_module, &queue_config);
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    result = Broker_AddLink(broker, &bld);
     mocks.ResetAllCalls();
 
     // this is for the Broker_RemoveModule call
@@ -2234,24 +2422,30 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_nn_close_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 37, 0))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq, taken to wake blocked publishers*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq_lock*/
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG)) /*this is for mq_space_cond*/
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this is for the previous routing table*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq, taken to stop the worker*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .SetReturn(-1);
+        .ExpectedTimesExactly(2);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .ExpectedTimesExactly(2);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
@@ -2272,21 +2466,33 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_nn_close_fails)
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_13_050: [Broker_RemoveModule shall unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_ERROR if the module is not found in BROKER_HANDLE_DATA::modules.]
-TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_unlock_fails)
+//Tests_SRS_BROKER_17_057: [ If the routing table cannot be replaced, Broker_RemoveModule shall leave the module attached and return BROKER_ERROR. ]
+TEST_FUNCTION(Broker_RemoveModule_fails_when_routing_table_alloc_fails)
 {
     ///arrange
     CBrokerMocks mocks;
     auto broker = Broker_Create();
     auto result = Broker_AddModule(broker, &fake_module);
+    result = Broker_AddModule(broker, &fake_module_2);
+    BROKER_LINK_DATA bld1 =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    BROKER_LINK_DATA bld2 =
+    {
+        fake_module_handle,
+        fake_module_handle_2
+    };
+    result = Broker_AddLink(broker, &bld1);
+    result = Broker_AddLink(broker, &bld2);
     mocks.ResetAllCalls();
 
     // this is for the Broker_RemoveModule call
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .SetFailReturn(LOCK_ERROR);
+        .IgnoreArgument(1);
 
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, &fake_module))
         .IgnoreArgument(1)
@@ -2295,40 +2501,20 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_unlock_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 37, 0))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq_lock*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+    whenShallmalloc_fail = currentmalloc_call + 1;
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the new routing table*/
         .IgnoreArgument(1);
 
     ///act
     result = Broker_RemoveModule(broker, &fake_module);
 
     ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
+    Broker_RemoveModule(broker, &fake_module_2);
+    Broker_RemoveModule(broker, &fake_module);
     Broker_Destroy(broker);
 }
 
@@ -2422,7 +2608,7 @@ TEST_FUNCTION(Broker_AddLink_null_sink_fails)
 //Tests_SRS_BROKER_17_030: [ Broker_AddLink shall lock the modules_lock. ]
 //Tests_SRS_BROKER_17_031: [ Broker_AddLink shall find the BROKER_HANDLE_DATA::module_info for link->module_sink_handle. ]
 //Tests_SRS_BROKER_17_041: [ Broker_AddLink shall find the BROKER_HANDLE_DATA::module_info for link->module_source_handle. ]
-//Tests_SRS_BROKER_17_032: [ Broker_AddLink shall subscribe module_info->receive_socket to the link->module_source_handle module handle. ]
+//Tests_SRS_BROKER_17_032: [ Broker_AddLink shall replace the routing table with a copy that also routes messages from link->module_source_handle to the sink. ]
 //Tests_SRS_BROKER_17_033: [ Broker_AddLink shall unlock the modules_lock. ]
 TEST_FUNCTION(Broker_AddLink_succeeds)
 {
@@ -2452,9 +2638,8 @@ TEST_FUNCTION(Broker_AddLink_succeeds)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_SUBSCRIBE, IGNORED_PTR_ARG, sizeof(MODULE_HANDLE)))
-        .IgnoreArgument(1)
-        .IgnoreArgument(4);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the new routing table*/
+        .IgnoreArgument(1);
 
     BROKER_LINK_DATA bld =
     {
@@ -2474,13 +2659,19 @@ TEST_FUNCTION(Broker_AddLink_succeeds)
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_17_034: [ Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR ]
-TEST_FUNCTION(Broker_AddLink_fails_setsocketoption_fails)
+//Tests_SRS_BROKER_17_052: [ If the sink is already linked to the source, Broker_AddLink shall return BROKER_OK. ]
+TEST_FUNCTION(Broker_AddLink_twice_does_not_duplicate_the_link)
 {
     ///arrange
     CBrokerMocks mocks;
     auto broker = Broker_Create();
     auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    result = Broker_AddLink(broker, &bld);
     mocks.ResetAllCalls();
 
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
@@ -2503,10 +2694,51 @@ TEST_FUNCTION(Broker_AddLink_fails_setsocketoption_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_SUBSCRIBE, IGNORED_PTR_ARG, sizeof(MODULE_HANDLE)))
+
+    ///act
+    result = Broker_AddLink(broker, &bld);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_034: [ Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR ]
+TEST_FUNCTION(Broker_AddLink_fails_when_routing_table_alloc_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(4)
-        .SetFailReturn(-1);
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    whenShallmalloc_fail = currentmalloc_call + 1;
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the new routing table*/
+        .IgnoreArgument(1);
 
     BROKER_LINK_DATA bld =
     {
@@ -2547,11 +2779,11 @@ TEST_FUNCTION(Broker_AddLink_fails_source_find_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    whenShallsinglylinkedlist_find_fail = currentsinglylinkedlist_find_call + 2;
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2)
-        .IgnoreArgument(3)
-        .SetFailReturn((LIST_ITEM_HANDLE)NULL);
+        .IgnoreArgument(3);
 
     BROKER_LINK_DATA bld =
     {
@@ -2584,11 +2816,11 @@ TEST_FUNCTION(Broker_AddLink_fails_singlylinkedlist_find_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    whenShallsinglylinkedlist_find_fail = currentsinglylinkedlist_find_call + 1;
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2)
-        .IgnoreArgument(3)
-        .SetFailReturn((LIST_ITEM_HANDLE)NULL);
+        .IgnoreArgument(3);
 
     BROKER_LINK_DATA bld =
     {
@@ -2729,7 +2961,7 @@ TEST_FUNCTION(Broker_RemoveLink_null_sink_fails)
 //Tests_SRS_BROKER_17_036: [ Broker_RemoveLink shall lock the modules_lock. ]
 //Tests_SRS_BROKER_17_037: [ Broker_RemoveLink shall find the module_info for link->module_sink_handle. ]
 //Tests_SRS_BROKER_17_042: [ Broker_RemoveLink shall find the module_info for link->module_source_handle. ]
-//Tests_SRS_BROKER_17_038: [ Broker_RemoveLink shall unsubscribe module_info->receive_socket from the link->module_source_handle module handle. ]
+//Tests_SRS_BROKER_17_038: [ Broker_RemoveLink shall replace the routing table with a copy that no longer routes messages from link->module_source_handle to the sink. ]
 //Tests_SRS_BROKER_17_039: [ Broker_RemoveLink shall unlock the modules_lock. ]
 TEST_FUNCTION(Broker_RemoveLink_succeeds)
 {
@@ -2743,7 +2975,6 @@ TEST_FUNCTION(Broker_RemoveLink_succeeds)
         fake_module_handle
     };
     result = Broker_AddLink(broker, &bld);
-
     mocks.ResetAllCalls();
 
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
@@ -2766,10 +2997,8 @@ TEST_FUNCTION(Broker_RemoveLink_succeeds)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-
-    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_UNSUBSCRIBE, IGNORED_PTR_ARG, sizeof(MODULE_HANDLE)))
-        .IgnoreArgument(1)
-        .IgnoreArgument(4);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this is for the previous routing table*/
+        .IgnoreArgument(1);
 
     ///act
     result = Broker_RemoveLink(broker, &bld);
@@ -2783,20 +3012,13 @@ TEST_FUNCTION(Broker_RemoveLink_succeeds)
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_17_040: [ Upon an error, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR. ]
-TEST_FUNCTION(Broker_RemoveLink_fails_sockopt_fails)
+//Tests_SRS_BROKER_17_053: [ If the sink is not linked to the source, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR. ]
+TEST_FUNCTION(Broker_RemoveLink_fails_when_not_linked)
 {
     ///arrange
     CBrokerMocks mocks;
     auto broker = Broker_Create();
     auto result = Broker_AddModule(broker, &fake_module);
-    BROKER_LINK_DATA bld =
-    {
-        fake_module_handle,
-        fake_module_handle
-    };
-    result = Broker_AddLink(broker, &bld);
-
     mocks.ResetAllCalls();
 
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
@@ -2819,10 +3041,12 @@ TEST_FUNCTION(Broker_RemoveLink_fails_sockopt_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_UNSUBSCRIBE, IGNORED_PTR_ARG, sizeof(MODULE_HANDLE)))
-        .IgnoreArgument(1)
-        .IgnoreArgument(4)
-        .SetFailReturn(-1);
+
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
 
     ///act
     result = Broker_RemoveLink(broker, &bld);
@@ -2836,19 +3060,13 @@ TEST_FUNCTION(Broker_RemoveLink_fails_sockopt_fails)
     Broker_Destroy(broker);
 }
 
+//Tests_SRS_BROKER_17_040: [ Upon an error, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR. ]
 TEST_FUNCTION(Broker_RemoveLink_fails_source_find_fails)
 {
     ///arrange
     CBrokerMocks mocks;
     auto broker = Broker_Create();
     auto result = Broker_AddModule(broker, &fake_module);
-    BROKER_LINK_DATA bld =
-    {
-        fake_module_handle,
-        fake_module_handle
-    };
-    result = Broker_AddLink(broker, &bld);
-
     mocks.ResetAllCalls();
 
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
@@ -2863,11 +3081,17 @@ TEST_FUNCTION(Broker_RemoveLink_fails_source_find_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    whenShallsinglylinkedlist_find_fail = currentsinglylinkedlist_find_call + 2;
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2)
-        .IgnoreArgument(3)
-        .SetFailReturn(nullptr);
+        .IgnoreArgument(3);
+
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
 
     ///act
     result = Broker_RemoveLink(broker, &bld);
@@ -2881,7 +3105,6 @@ TEST_FUNCTION(Broker_RemoveLink_fails_source_find_fails)
     Broker_Destroy(broker);
 }
 
-
 //Tests_SRS_BROKER_17_040: [ Upon an error, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR. ]
 TEST_FUNCTION(Broker_RemoveLink_fails_singlylinkedlist_find_fails)
 {
@@ -2889,24 +3112,23 @@ TEST_FUNCTION(Broker_RemoveLink_fails_singlylinkedlist_find_fails)
     CBrokerMocks mocks;
     auto broker = Broker_Create();
     auto result = Broker_AddModule(broker, &fake_module);
-    BROKER_LINK_DATA bld =
-    {
-        fake_module_handle,
-        fake_module_handle
-    };
-    result = Broker_AddLink(broker, &bld);
-
     mocks.ResetAllCalls();
 
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    whenShallsinglylinkedlist_find_fail = currentsinglylinkedlist_find_call + 1;
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2)
-        .IgnoreArgument(3)
-        .SetFailReturn(nullptr);
+        .IgnoreArgument(3);
+
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
 
     ///act
     result = Broker_RemoveLink(broker, &bld);
@@ -2927,19 +3149,18 @@ TEST_FUNCTION(Broker_RemoveLink_fails_lock_fails)
     CBrokerMocks mocks;
     auto broker = Broker_Create();
     auto result = Broker_AddModule(broker, &fake_module);
-    BROKER_LINK_DATA bld =
-    {
-        fake_module_handle,
-        fake_module_handle
-    };
-    result = Broker_AddLink(broker, &bld);
-
     mocks.ResetAllCalls();
 
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .SetFailReturn(LOCK_ERROR);
 
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+
     ///act
     result = Broker_RemoveLink(broker, &bld);
 
@@ -3046,10 +3267,6 @@ TEST_FUNCTION(Broker_Destroy_works)
     // these are for Broker_Destroy
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_get_head_item(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_destroy(IGNORED_PTR_ARG))
@@ -3078,75 +3295,350 @@ TEST_FUNCTION(Broker_DecRef_works)
     // these are for Broker_Destroy
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_get_head_item(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    Broker_DecRef(broker);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+}
+
+//Tests_SRS_BROKER_13_030: [If broker or message is NULL the function shall return BROKER_INVALIDARG.]
+TEST_FUNCTION(Broker_Publish_fails_with_null_broker)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    ///act
+    auto r1 = Broker_Publish(NULL, fake_module_handle, (MESSAGE_HANDLE)0x1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, r1, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+}
+
+//Tests_SRS_BROKER_13_030: [If broker or message is NULL the function shall return BROKER_INVALIDARG.]
+TEST_FUNCTION(Broker_Publish_fails_with_null_message)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    ///act
+    auto r1 = Broker_Publish((BROKER_HANDLE)0x1, fake_module_handle, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, r1, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+}
+
+//Tests_SRS_BROKER_13_030: [If broker or message is NULL the function shall return BROKER_INVALIDARG.]
+TEST_FUNCTION(Broker_Publish_fails_with_null_source)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    ///act
+    auto r1 = Broker_Publish((BROKER_HANDLE)0x1, NULL, (MESSAGE_HANDLE)0x1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, r1, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+}
+
+//Tests_SRS_BROKER_13_037: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
+TEST_FUNCTION(Broker_Publish_without_links_queues_nothing)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    auto broker = Broker_Create();
+
+    // create a message to send
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+
+    auto result = Broker_AddModule(broker, &fake_module);
+
+    mocks.ResetAllCalls();
+
+    // this is for Broker_Publish
+
+    ///act
+    result = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_051: [ If the message cannot be queued, Broker_Publish shall destroy the clone, continue delivering to the remaining sinks and return BROKER_ERROR. ]
+TEST_FUNCTION(Broker_Publish_fails_when_Message_Clone_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    auto broker = Broker_Create();
+
+    // create a message to send
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    auto result = Broker_AddModule(broker, &fake_module);
+    result = Broker_AddLink(broker, &bld);
+
+    mocks.ResetAllCalls();
+
+    // this is for Broker_Publish
+    whenShallMessage_Clone_fail = currentMessage_Clone_call + 1;
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
+
+    ///act
+    result = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_051: [ If the message cannot be queued, Broker_Publish shall destroy the clone, continue delivering to the remaining sinks and return BROKER_ERROR. ]
+TEST_FUNCTION(Broker_Publish_fails_when_mq_Lock_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    auto broker = Broker_Create();
+
+    // create a message to send
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    auto result = Broker_AddModule(broker, &fake_module);
+    result = Broker_AddLink(broker, &bld);
+
+    mocks.ResetAllCalls();
+
+    // this is for Broker_Publish
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
+    whenShallLock_fail = currentLock_call + 1;
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
+
+    ///act
+    result = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_051: [ If the message cannot be queued, Broker_Publish shall destroy the clone, continue delivering to the remaining sinks and return BROKER_ERROR. ]
+TEST_FUNCTION(Broker_Publish_fails_when_MESSAGE_QUEUE_push_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    auto broker = Broker_Create();
+
+    // create a message to send
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    auto result = Broker_AddModule(broker, &fake_module);
+    result = Broker_AddLink(broker, &bld);
+
+    mocks.ResetAllCalls();
+
+    // this is for Broker_Publish
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_get_head_item(IGNORED_PTR_ARG))
+    whenShallMESSAGE_QUEUE_push_fail = currentMESSAGE_QUEUE_push_call + 1;
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_push(IGNORED_PTR_ARG, message))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_destroy(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_is_full(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
     ///act
-    Broker_DecRef(broker);
+    result = Broker_Publish(broker, fake_module_handle, message);
 
     ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_13_030: [If broker or message is NULL the function shall return BROKER_INVALIDARG.]
-TEST_FUNCTION(Broker_Publish_fails_with_null_broker)
+//Tests_SRS_BROKER_17_022: [ Broker_Publish shall acquire the current routing table without taking the modules lock. ]
+//Tests_SRS_BROKER_17_007: [ Broker_Publish shall clone the message for every module linked to source. ]
+//Tests_SRS_BROKER_17_050: [ Broker_Publish shall push the clone onto the sink's BROKER_MODULEINFO::mq while holding BROKER_MODULEINFO::mq_lock and signal BROKER_MODULEINFO::mq_cond. ]
+//Tests_SRS_BROKER_17_023: [ Broker_Publish shall release the routing table. ]
+//Tests_SRS_BROKER_13_037 : [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
+TEST_FUNCTION(Broker_Publish_succeeds)
 {
     ///arrange
     CBrokerMocks mocks;
 
-    ///act
-    auto r1 = Broker_Publish(NULL, fake_module_handle, (MESSAGE_HANDLE)0x1);
+    auto broker = Broker_Create();
 
-    ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, r1, BROKER_INVALIDARG);
-    mocks.AssertActualAndExpectedCalls();
+    // create a message to send
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
 
-    ///cleanup
-}
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    auto result = Broker_AddModule(broker, &fake_module);
+    result = Broker_AddLink(broker, &bld);
 
-//Tests_SRS_BROKER_13_030: [If broker or message is NULL the function shall return BROKER_INVALIDARG.]
-TEST_FUNCTION(Broker_Publish_fails_with_null_message)
-{
-    ///arrange
-    CBrokerMocks mocks;
+    mocks.ResetAllCalls();
+
+    // this is for Broker_Publish
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_push(IGNORED_PTR_ARG, message))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     ///act
-    auto r1 = Broker_Publish((BROKER_HANDLE)0x1, fake_module_handle, NULL);
+    result = Broker_Publish(broker, fake_module_handle, message);
 
     ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, r1, BROKER_INVALIDARG);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_13_030: [If broker or message is NULL the function shall return BROKER_INVALIDARG.]
-TEST_FUNCTION(Broker_Publish_fails_with_null_source)
+//Tests_SRS_BROKER_17_007: [ Broker_Publish shall clone the message for every module linked to source. ]
+//Tests_SRS_BROKER_17_050: [ Broker_Publish shall push the clone onto the sink's BROKER_MODULEINFO::mq while holding BROKER_MODULEINFO::mq_lock and signal BROKER_MODULEINFO::mq_cond. ]
+TEST_FUNCTION(Broker_Publish_queues_same_message_for_every_sink)
 {
     ///arrange
     CBrokerMocks mocks;
 
+    auto broker = Broker_Create();
+
+    // create a message to send
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+
+    BROKER_LINK_DATA bld1 =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    BROKER_LINK_DATA bld2 =
+    {
+        fake_module_handle,
+        fake_module_handle_2
+    };
+    auto result = Broker_AddModule(broker, &fake_module);
+    result = Broker_AddModule(broker, &fake_module_2);
+    result = Broker_AddLink(broker, &bld1);
+    result = Broker_AddLink(broker, &bld2);
+
+    mocks.ResetAllCalls();
+
+    // this is for Broker_Publish
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(message))
+        .ExpectedTimesExactly(2);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*these are the locks protecting each mq*/
+        .IgnoreArgument(1)
+        .ExpectedTimesExactly(2);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_push(IGNORED_PTR_ARG, message))
+        .IgnoreArgument(1)
+        .ExpectedTimesExactly(2);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .ExpectedTimesExactly(2);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .ExpectedTimesExactly(2);
+
     ///act
-    auto r1 = Broker_Publish((BROKER_HANDLE)0x1, NULL, (MESSAGE_HANDLE)0x1);
+    result = Broker_Publish(broker, fake_module_handle, message);
 
     ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, r1, BROKER_INVALIDARG);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_RemoveModule(broker, &fake_module_2);
+    Broker_Destroy(broker);
 }
-//Tests_SRS_BROKER_13_037: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_Publish_fails_when_Lock_fails)
+
+
+//Tests_SRS_BROKER_17_058: [ Whenever the routing table is replaced, the new table shall index the sinks of every source, ordered by source. ]
+//Tests_SRS_BROKER_17_059: [ Broker_Publish shall look up the sinks of source in the routing table and visit only those sinks. ]
+TEST_FUNCTION(Broker_Publish_queues_only_for_sinks_of_source)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -3158,30 +3650,57 @@ TEST_FUNCTION(Broker_Publish_fails_when_Lock_fails)
     MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
     auto message = Message_Create(&c);
 
+    BROKER_LINK_DATA bld1 =
+    {
+        fake_module_handle_2,
+        fake_module_handle
+    };
+    BROKER_LINK_DATA bld2 =
+    {
+        fake_module_handle,
+        fake_module_handle_2
+    };
+    BROKER_LINK_DATA bld3 =
+    {
+        fake_module_handle_2,
+        fake_module_handle_2
+    };
     auto result = Broker_AddModule(broker, &fake_module);
+    result = Broker_AddModule(broker, &fake_module_2);
+    result = Broker_AddLink(broker, &bld1);
+    result = Broker_AddLink(broker, &bld2);
+    result = Broker_AddLink(broker, &bld3);
 
     mocks.ResetAllCalls();
 
-    // this is for Broker_Publish
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .SetFailReturn(LOCK_ERROR);
+    // this is for Broker_Publish, only the link from fake_module_handle is visited
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_push(IGNORED_PTR_ARG, message))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     ///act
     result = Broker_Publish(broker, fake_module_handle, message);
 
     ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     Message_Destroy(message);
     Broker_RemoveModule(broker, &fake_module);
+    Broker_RemoveModule(broker, &fake_module_2);
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_13_037: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_Publish_fails_when_Message_ToByteArray_fails)
+//Tests_SRS_BROKER_17_065: [ If the sink's queue is full and its policy is BROKER_QUEUE_POLICY_DROP_NEWEST, Broker_Publish shall discard the clone. ]
+//Tests_SRS_BROKER_17_067: [ Broker_Publish shall count every message discarded by a queue policy in BROKER_MODULEINFO::dropped_messages. ]
+TEST_FUNCTION(Broker_Publish_drop_newest_discards_the_clone_when_queue_is_full)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -3193,26 +3712,41 @@ TEST_FUNCTION(Broker_Publish_fails_when_Message_ToByteArray_fails)
     MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
     auto message = Message_Create(&c);
 
-    auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    BROKER_QUEUE_CONFIG queue_config = { 1, BROKER_QUEUE_POLICY_DROP_NEWEST };
+    auto result = Broker_AddModuleWithQueue(broker, &fake_module, &queue_config);
+    result = Broker_AddLink(broker, &bld);
+    result = Broker_Publish(broker, fake_module_handle, message); /*fills the queue*/
 
     mocks.ResetAllCalls();
 
     // this is for Broker_Publish
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_push(IGNORED_PTR_ARG, message))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_is_full(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
     STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
-    STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(message, NULL, 0))
-        .SetFailReturn(-1);
 
     ///act
     result = Broker_Publish(broker, fake_module_handle, message);
 
     ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
     mocks.AssertActualAndExpectedCalls();
+    size_t dropped = 0;
+    ASSERT_ARE_EQUAL(BROKER_RESULT, Broker_GetDroppedMessageCount(broker, &fake_module, &dropped), BROKER_OK);
+    ASSERT_ARE_EQUAL(size_t, 1, dropped);
 
     ///cleanup
     Message_Destroy(message);
@@ -3220,8 +3754,9 @@ TEST_FUNCTION(Broker_Publish_fails_when_Message_ToByteArray_fails)
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_13_037: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_Publish_fails_when_allocmsg_fails)
+//Tests_SRS_BROKER_17_064: [ If the sink's queue is full and its policy is BROKER_QUEUE_POLICY_DROP_OLDEST, Broker_Publish shall discard the oldest queued message and queue the clone. ]
+//Tests_SRS_BROKER_17_067: [ Broker_Publish shall count every message discarded by a queue policy in BROKER_MODULEINFO::dropped_messages. ]
+TEST_FUNCTION(Broker_Publish_drop_oldest_replaces_the_oldest_message_when_queue_is_full)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -3233,27 +3768,44 @@ TEST_FUNCTION(Broker_Publish_fails_when_allocmsg_fails)
     MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
     auto message = Message_Create(&c);
 
-    auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    BROKER_QUEUE_CONFIG queue_config = { 1, BROKER_QUEUE_POLICY_DROP_OLDEST };
+    auto result = Broker_AddModuleWithQueue(broker, &fake_module, &queue_config);
+    result = Broker_AddLink(broker, &bld);
+    result = Broker_Publish(broker, fake_module_handle, message); /*fills the queue*/
 
     mocks.ResetAllCalls();
 
     // this is for Broker_Publish
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_push(IGNORED_PTR_ARG, message))
+        .IgnoreArgument(1)
+        .ExpectedTimesExactly(2);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_is_full(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
     STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
-    STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(message, NULL, 0));
-    STRICT_EXPECTED_CALL(mocks, nn_allocmsg(1 + sizeof(MODULE_HANDLE), 0))
-        .SetFailReturn(nullptr);
 
     ///act
     result = Broker_Publish(broker, fake_module_handle, message);
 
     ///assert
-    ASSERT_ARE_EQUAL(int, result, BROKER_ERROR);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
     mocks.AssertActualAndExpectedCalls();
+    size_t dropped = 0;
+    ASSERT_ARE_EQUAL(BROKER_RESULT, Broker_GetDroppedMessageCount(broker, &fake_module, &dropped), BROKER_OK);
+    ASSERT_ARE_EQUAL(size_t, 1, dropped);
 
     ///cleanup
     Message_Destroy(message);
@@ -3261,8 +3813,9 @@ TEST_FUNCTION(Broker_Publish_fails_when_allocmsg_fails)
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_13_037: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_Publish_fails_when_send_fails)
+//Tests_SRS_BROKER_17_066: [ If the sink's queue is full and its policy is BROKER_QUEUE_POLICY_BLOCK, Broker_Publish shall wait on BROKER_MODULEINFO::mq_space_cond until the queue has room or the worker is asked to quit, then queue the clone. ]
+//Tests_SRS_BROKER_17_051: [ If the message cannot be queued, Broker_Publish shall destroy the clone, continue delivering to the remaining sinks and return BROKER_ERROR. ]
+TEST_FUNCTION(Broker_Publish_block_fails_when_waiting_for_room_fails)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -3274,28 +3827,34 @@ TEST_FUNCTION(Broker_Publish_fails_when_send_fails)
     MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
     auto message = Message_Create(&c);
 
-    auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    BROKER_QUEUE_CONFIG queue_config = { 1, BROKER_QUEUE_POLICY_BLOCK };
+    auto result = Broker_AddModuleWithQueue(broker, &fake_module, &queue_config);
+    result = Broker_AddLink(broker, &bld);
+    result = Broker_Publish(broker, fake_module_handle, message); /*fills the queue*/
 
     mocks.ResetAllCalls();
 
     // this is for Broker_Publish
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
-    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
-    STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(message, NULL, 0));
-    STRICT_EXPECTED_CALL(mocks, nn_allocmsg(1 + sizeof(MODULE_HANDLE), 0))
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_push(IGNORED_PTR_ARG, message))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(message, IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_is_full(IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .SetFailReturn((int)-1);
+        .ExpectedTimesExactly(2);
+    whenShallCondition_Wait_fail = currentCondition_Wait_call + 1;
+    STRICT_EXPECTED_CALL(mocks, Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 0))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     ///act
     result = Broker_Publish(broker, fake_module_handle, message);
@@ -3310,62 +3869,153 @@ TEST_FUNCTION(Broker_Publish_fails_when_send_fails)
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_17_022: [ Broker_Publish shall Lock the modules lock. ]
-//Tests_SRS_BROKER_17_007: [Broker_Publish shall clone the message.]
-//Tests_SRS_BROKER_17_008: [ Broker_Publish shall serialize the message. ]
-//Tests_SRS_BROKER_17_025: [ Broker_Publish shall allocate a nanomsg buffer the size of the serialized message + sizeof(MODULE_HANDLE). ]
-//Tests_SRS_BROKER_17_026: [ Broker_Publish shall copy source into the beginning of the nanomsg buffer. ]
-//Tests_SRS_BROKER_17_027: [ Broker_Publish shall serialize the message into the remainder of the nanomsg buffer. ]
-//Tests_SRS_BROKER_17_010: [ Broker_Publish shall send a message on the publish_socket. ]
-//Tests_SRS_BROKER_17_011: [ Broker_Publish shall free the serialized message data. ]
-//Tests_SRS_BROKER_17_012: [ Broker_Publish shall free the message. ]
-//Tests_SRS_BROKER_17_023: [ Broker_Publish shall Unlock the modules lock. ]
-//Tests_SRS_BROKER_13_037 : [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_Publish_succeeds)
+//Tests_SRS_BROKER_17_068: [ After taking a message off a full queue, the function shall signal module_info->mq_space_cond if publishers block on the queue. ]
+TEST_FUNCTION(module_worker_signals_space_after_popping_from_a_full_queue)
 {
-    ///arrange
     CBrokerMocks mocks;
-
     auto broker = Broker_Create();
 
-    // create a message to send
+    // setup fake module's validation data
     unsigned char fake;
     MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
     auto message = Message_Create(&c);
+    call_status_for_FakeModule_Receive.module = fake_module.module_handle;
+    call_status_for_FakeModule_Receive.messageHandle = message;
 
-    auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    BROKER_QUEUE_CONFIG queue_config = { 1, BROKER_QUEUE_POLICY_BLOCK };
+    (void)Broker_AddModuleWithQueue(broker, &fake_module, &queue_config);
+    (void)Broker_AddLink(broker, &bld);
+    (void)Broker_Publish(broker, fake_module_handle, message);
 
     mocks.ResetAllCalls();
 
-    // this is for Broker_Publish
+    //loop 1
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_is_full(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
     STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
-    STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(message, NULL, 0));
-    STRICT_EXPECTED_CALL(mocks, nn_allocmsg(1 + sizeof(MODULE_HANDLE), 0))
+
+    //loop 2
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(message, IGNORED_PTR_ARG, 1))
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_is_full(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_QUEUE_pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    whenShallCondition_Wait_fail = currentCondition_Wait_call + 1;
+    STRICT_EXPECTED_CALL(mocks, Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 0))
+        .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    auto result = thread_func_to_call(thread_func_args);
+
+    ASSERT_ARE_EQUAL(int, result, 0);
+    ASSERT_IS_TRUE(call_status_for_FakeModule_Receive.was_called);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_069: [ If broker, module or dropped_messages is NULL, Broker_GetDroppedMessageCount shall return BROKER_INVALIDARG. ]
+TEST_FUNCTION(Broker_GetDroppedMessageCount_fails_with_null_arguments)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    size_t dropped;
+
+    ///act
+    auto result1 = Broker_GetDroppedMessageCount(NULL, &fake_module, &dropped);
+    auto result2 = Broker_GetDroppedMessageCount((BROKER_HANDLE)0x1, NULL, &dropped);
+    auto result3 = Broker_GetDroppedMessageCount((BROKER_HANDLE)0x1, &fake_module, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result1, BROKER_INVALIDARG);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result2, BROKER_INVALIDARG);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result3, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+}
+
+//Tests_SRS_BROKER_17_070: [ Broker_GetDroppedMessageCount shall return BROKER_ERROR if the module is not attached to the broker or an underlying API call fails. ]
+TEST_FUNCTION(Broker_GetDroppedMessageCount_fails_when_module_is_not_attached)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    size_t dropped;
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, &fake_module))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = Broker_GetDroppedMessageCount(broker, &fake_module, &dropped);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_071: [ Otherwise Broker_GetDroppedMessageCount shall write the number of messages discarded by the module's queue policy to dropped_messages and return BROKER_OK. ]
+TEST_FUNCTION(Broker_GetDroppedMessageCount_succeeds)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    size_t dropped = 42;
+    mocks.ResetAllCalls();
 
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .ExpectedTimesExactly(2);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, &fake_module))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG)) /*one for the predicate, one for the module_info*/
+        .IgnoreArgument(1)
+        .ExpectedTimesExactly(2);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .ExpectedTimesExactly(2);
 
     ///act
-    result = Broker_Publish(broker, fake_module_handle, message);
+    auto result = Broker_GetDroppedMessageCount(broker, &fake_module, &dropped);
 
     ///assert
     ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    ASSERT_ARE_EQUAL(size_t, 0, dropped);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
-    Message_Destroy(message);
     Broker_RemoveModule(broker, &fake_module);
     Broker_Destroy(broker);
 }
 
-
 END_TEST_SUITE(broker_ut)
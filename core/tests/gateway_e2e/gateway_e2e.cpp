@@ -154,6 +154,11 @@ BEGIN_TEST_SUITE(gateway_e2e)
         iotHubConfig.IoTHubName = IoTHubAccount_GetIoTHubName(g_iothubAcctInfo);
         iotHubConfig.IoTHubSuffix = IoTHubAccount_GetIoTHubSuffix(g_iothubAcctInfo);
         iotHubConfig.transportProvider = HTTP_Protocol;
+        iotHubConfig.maxDevices = 0;
+        iotHubConfig.deviceIdleTimeout = 0;
+        iotHubConfig.batchMaxMessages = 0;
+        iotHubConfig.batchMaxBytes = 0;
+        iotHubConfig.batchMaxAge = 0;
 
 
         E2EMODULE_CONFIG e2eModuleConfiguration;
@@ -182,8 +187,9 @@ BEGIN_TEST_SUITE(gateway_e2e)
                 ASSERT_FAIL("Could not push data into vector for identity map configuration.");
             }
         }
+        IDENTITY_MAP_MODULE_CONFIG e2eModuleMappingConfig = { e2eModuleMappingVector, NULL };
         
-        GATEWAY_MODULES_ENTRY modules[3];
+        GATEWAY_MODULES_ENTRY modules[3] = {};
 		DYNAMIC_LOADER_ENTRYPOINT loader_info[3];
         GATEWAY_LINK_ENTRY links[2];
 		
@@ -194,7 +200,7 @@ BEGIN_TEST_SUITE(gateway_e2e)
 		modules[0].module_loader_info.entrypoint = (void*)&(loader_info[0]);
 
 		modules[1].module_name = GW_IDMAP_MODULE;
-		modules[1].module_configuration = e2eModuleMappingVector;
+		modules[1].module_configuration = &e2eModuleMappingConfig;
 		modules[1].module_loader_info.loader = DynamicLoader_Get();
 		loader_info[1].moduleLibraryFileName = STRING_construct(identity_map_module_path());
 		modules[1].module_loader_info.entrypoint = (void*)&(loader_info[1]);
@@ -211,7 +217,7 @@ BEGIN_TEST_SUITE(gateway_e2e)
         links[1].module_source = GW_IDMAP_MODULE;
         links[1].module_sink = "IoTHub";
         
-        GATEWAY_PROPERTIES m6GatewayProperties;
+        GATEWAY_PROPERTIES m6GatewayProperties = {};
         VECTOR_HANDLE gatewayProps = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
         VECTOR_HANDLE gatewayLinks = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
 
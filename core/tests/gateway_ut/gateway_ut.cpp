@@ -130,6 +130,11 @@ public:
     }
     MOCK_METHOD_END(BROKER_HANDLE, result1);
 
+    MOCK_STATIC_METHOD_1(, BROKER_HANDLE, Broker_CreateWithThreadPool, size_t, thread_count)
+        ++currentBroker_ref_count;
+        BROKER_HANDLE result1 = (BROKER_HANDLE)BASEIMPLEMENTATION::gballoc_malloc(1);
+    MOCK_METHOD_END(BROKER_HANDLE, result1);
+
     MOCK_STATIC_METHOD_1(, void, Broker_Destroy, BROKER_HANDLE, broker)
         if (currentBroker_ref_count > 0)
         {
@@ -141,7 +146,7 @@ public:
         }
     MOCK_VOID_METHOD_END();
 
-    MOCK_STATIC_METHOD_2(, BROKER_RESULT, Broker_AddModule, BROKER_HANDLE, handle, const MODULE*, module)
+    MOCK_STATIC_METHOD_3(, BROKER_RESULT, Broker_AddModuleWithQueue, BROKER_HANDLE, handle, const MODULE*, module, const BROKER_QUEUE_CONFIG*, queue_config)
         currentBroker_AddModule_call++;
         BROKER_RESULT result1  = BROKER_ERROR;
         if (handle != NULL && module != NULL)
@@ -332,8 +337,9 @@ DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , void, mock_Module_Receive, MODUL
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , void, mock_Module_Start, MODULE_HANDLE, moduleHandle);
 
 DECLARE_GLOBAL_MOCK_METHOD_0(CGatewayLLMocks, , BROKER_HANDLE, Broker_Create);
+DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , BROKER_HANDLE, Broker_CreateWithThreadPool, size_t, thread_count);
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , void, Broker_Destroy, BROKER_HANDLE, broker);
-DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , BROKER_RESULT, Broker_AddModule, BROKER_HANDLE, handle, const MODULE*, module);
+DECLARE_GLOBAL_MOCK_METHOD_3(CGatewayLLMocks, , BROKER_RESULT, Broker_AddModuleWithQueue, BROKER_HANDLE, handle, const MODULE*, module, const BROKER_QUEUE_CONFIG*, queue_config);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , BROKER_RESULT, Broker_RemoveModule, BROKER_HANDLE, handle, const MODULE*, module);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , BROKER_RESULT, Broker_AddLink, BROKER_HANDLE, handle, const BROKER_LINK_DATA*, link);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , BROKER_RESULT, Broker_RemoveLink, BROKER_HANDLE, handle, const BROKER_LINK_DATA*, link);
@@ -503,6 +509,7 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     dummyProps = (GATEWAY_PROPERTIES*)malloc(sizeof(GATEWAY_PROPERTIES));
     dummyProps->gateway_modules = BASEIMPLEMENTATION::VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
     dummyProps->gateway_links = BASEIMPLEMENTATION::VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+    dummyProps->scheduler_threads = 0;
     BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry, 1);
 }
 
@@ -560,6 +567,39 @@ TEST_FUNCTION(Gateway_Create_Creates_Handle_Success)
     Gateway_Destroy(gateway);
 }
 
+/*Tests_SRS_GATEWAY_17_023: [ If GATEWAY_PROPERTIES's scheduler_threads is not 0, the function shall create the broker with Broker_CreateWithThreadPool. ]*/
+TEST_FUNCTION(Gateway_Create_with_scheduler_threads_creates_pooled_broker)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+
+    GATEWAY_PROPERTIES props;
+    props.gateway_modules = NULL;
+    props.gateway_links = NULL;
+    props.scheduler_threads = 4;
+
+    //Expectations
+    STRICT_EXPECTED_CALL(mocks, ModuleLoader_Initialize());
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Broker_CreateWithThreadPool(4));
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    expectEventSystemInit(mocks);
+
+    //Act
+    GATEWAY_HANDLE gateway = Gateway_Create(&props);
+
+    //Assert
+    ASSERT_IS_NOT_NULL(gateway);
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_Destroy(gateway);
+}
+
 /*Tests_SRS_GATEWAY_14_011: [ If gw, entry, or GATEWAY_MODULES_ENTRY's loader_configuration or loader_api is NULL the function shall return NULL. ]*/
 /*Tests_SRS_GATEWAY_17_017: [ This function shall destroy the default module loaders upon any failure. ]*/
 TEST_FUNCTION(Gateway_Create_returns_null_on_bad_module_api_entry)
@@ -591,6 +631,7 @@ TEST_FUNCTION(Gateway_Create_returns_null_on_bad_module_api_entry)
     ASSERT_IS_NOT_NULL(newdummyProps.gateway_modules);
     BASEIMPLEMENTATION::VECTOR_push_back(newdummyProps.gateway_modules, &dummyEntry2, 1);
     newdummyProps.gateway_links = NULL;
+    newdummyProps.scheduler_threads = 0;
 
 
     //Expectations
@@ -825,9 +866,10 @@ TEST_FUNCTION(Gateway_Create_VECTOR_push_back_Fails_To_Add_All_Modules_In_Props)
 	STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Broker_AddModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddModuleWithQueue(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
     STRICT_EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
@@ -861,9 +903,10 @@ TEST_FUNCTION(Gateway_Create_VECTOR_push_back_Fails_To_Add_All_Modules_In_Props)
 	STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Broker_AddModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddModuleWithQueue(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
     STRICT_EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     whenShallVECTOR_push_back_fail = 2;
@@ -975,9 +1018,10 @@ TEST_FUNCTION(Gateway_Create_Broker_AddModule_Fails_To_Add_All_Modules_In_Props)
 	STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Broker_AddModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddModuleWithQueue(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
     STRICT_EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
@@ -1010,9 +1054,10 @@ TEST_FUNCTION(Gateway_Create_Broker_AddModule_Fails_To_Add_All_Modules_In_Props)
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
     whenShallBroker_AddModule_fail = 2;
-    STRICT_EXPECTED_CALL(mocks, Broker_AddModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddModuleWithQueue(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
     EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(mocks, mock_Module_Destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
@@ -1117,9 +1162,10 @@ TEST_FUNCTION(Gateway_Create_AddModule_WithDuplicatedModuleName_Fails)
 	STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Broker_AddModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddModuleWithQueue(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
     STRICT_EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
@@ -1233,9 +1279,10 @@ TEST_FUNCTION(Gateway_Create_Adds_All_Modules_In_Props_Success)
 	STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Broker_AddModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddModuleWithQueue(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
     STRICT_EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
@@ -1266,9 +1313,10 @@ TEST_FUNCTION(Gateway_Create_Adds_All_Modules_In_Props_Success)
 	STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Broker_AddModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddModuleWithQueue(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
     STRICT_EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
@@ -1365,9 +1413,10 @@ TEST_FUNCTION(Gateway_Create_Adds_All_Modules_And_All_Links_In_Props_Success)
 	STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Broker_AddModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddModuleWithQueue(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
     STRICT_EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
@@ -1399,9 +1448,10 @@ TEST_FUNCTION(Gateway_Create_Adds_All_Modules_And_All_Links_In_Props_Success)
 	STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Broker_AddModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddModuleWithQueue(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
     STRICT_EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
@@ -1488,9 +1538,10 @@ TEST_FUNCTION(Gateway_Create_Adds_All_Modules_And_Links_fromNonExistingModule_Fa
 	STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Broker_AddModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddModuleWithQueue(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
     STRICT_EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
@@ -1860,7 +1911,7 @@ TEST_FUNCTION(Gateway_AddModule_Returns_Null_For_star_module_name)
 /*Tests_SRS_GATEWAY_14_012: [ The function shall load the module located at GATEWAY_MODULES_ENTRY's module_path into a MODULE_LIBRARY_HANDLE. ]*/
 /*Tests_SRS_GATEWAY_14_013: [ The function shall get the const MODULE_API* from the MODULE_LIBRARY_HANDLE. ]*/
 /*Tests_SRS_GATEWAY_17_015: [ The function shall use GATEWAY_PROPERTIES::loader_api->Load and each GATEWAY_PROPERTIES::loader_configuration to get each module's MODULE_LIBRARY_HANDLE. ]*/
-/*Tests_SRS_GATEWAY_14_017: [ The function shall attach the module to the GATEWAY_HANDLE_DATA's broker using a call to Broker_AddModule. ]*/
+/*Tests_SRS_GATEWAY_14_017: [ The function shall attach the module to the GATEWAY_HANDLE_DATA's broker using a call to Broker_AddModuleWithQueue with the GATEWAY_MODULES_ENTRY's queue_configuration. ]*/
 /*Tests_SRS_GATEWAY_14_029: [ The function shall create a new MODULE_DATA containing the MODULE_HANDLE, MODULE_LOADER_API and MODULE_LIBRARY_HANDLE if the module was successfully linked to the message broker. ]*/
 /*Tests_SRS_GATEWAY_14_032: [ The function shall add the new MODULE_DATA to GATEWAY_HANDLE_DATA's modules if the module was successfully linked to the message broker. ]*/
 /*Tests_SRS_GATEWAY_14_019: [ The function shall return the newly created MODULE_HANDLE only if each API call returns successfully. ]*/
@@ -1896,9 +1947,10 @@ TEST_FUNCTION(Gateway_AddModule_Loads_Module_From_Library_Path)
     STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Broker_AddModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddModuleWithQueue(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
     STRICT_EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
@@ -2015,9 +2067,10 @@ TEST_FUNCTION(Gateway_AddModule_Creates_Module_Using_Module_Properties)
     STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
 		.IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Broker_AddModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddModuleWithQueue(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
     STRICT_EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
@@ -2154,9 +2207,10 @@ TEST_FUNCTION(Gateway_AddModule_Broker_AddModule_Fails)
         .IgnoreArgument(1)
         .IgnoreArgument(2);
     whenShallBroker_AddModule_fail = 1;
-    STRICT_EXPECTED_CALL(mocks, Broker_AddModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddModuleWithQueue(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
     STRICT_EXPECTED_CALL(mocks, mock_Module_Destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_Unload(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -2205,9 +2259,10 @@ TEST_FUNCTION(Gateway_AddModule_Internal_API_Fail_Rollback_Module)
 	STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Broker_AddModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddModuleWithQueue(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
     STRICT_EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     whenShallVECTOR_push_back_fail = 1;
@@ -3484,9 +3539,10 @@ TEST_FUNCTION(Gateway_AddModule_Creates_Module_with_star_links)
     STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Broker_AddModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddModuleWithQueue(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
     STRICT_EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
@@ -3580,9 +3636,10 @@ TEST_FUNCTION(Gateway_AddModule_Creates_Module_star_2nd_addLink_fails)
     STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Broker_AddModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddModuleWithQueue(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
     STRICT_EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
@@ -3708,9 +3765,10 @@ TEST_FUNCTION(Gateway_AddModule_Creates_Module_star_2nd_find_fails)
     STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Broker_AddModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddModuleWithQueue(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
     STRICT_EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
@@ -4407,6 +4465,7 @@ TEST_FUNCTION(Gateway_GetModuleList_Links_basic_tree)
     GATEWAY_PROPERTIES props;
     props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
     props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+    props.scheduler_threads = 0;
     VECTOR_push_back(props.gateway_modules, module_entries, module_count);
     VECTOR_push_back(props.gateway_links, link_entries, link_count);
 
@@ -4477,6 +4536,7 @@ TEST_FUNCTION(Gateway_GetModuleList_links_cycle)
     GATEWAY_PROPERTIES props;
     props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
     props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+    props.scheduler_threads = 0;
     VECTOR_push_back(props.gateway_modules, module_entries, module_count);
     VECTOR_push_back(props.gateway_links, link_entries, link_count);
 
@@ -4536,6 +4596,7 @@ TEST_FUNCTION(Gateway_GetModuleList_links_to_itself)
     GATEWAY_PROPERTIES props;
     props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
     props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+    props.scheduler_threads = 0;
     VECTOR_push_back(props.gateway_modules, module_entries, module_count);
     VECTOR_push_back(props.gateway_links, link_entries, link_count);
 
@@ -4615,6 +4676,7 @@ TEST_FUNCTION(Gateway_GetModuleList_links_star)
     GATEWAY_PROPERTIES props;
     props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
     props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+    props.scheduler_threads = 0;
     VECTOR_push_back(props.gateway_modules, module_entries, module_count);
     VECTOR_push_back(props.gateway_links, link_entries, link_count);
 
@@ -4663,6 +4725,7 @@ TEST_FUNCTION(Gateway_GetModuleList_calloc_fail)
     GATEWAY_PROPERTIES props;
     props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
     props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+    props.scheduler_threads = 0;
     VECTOR_push_back(props.gateway_modules, module_entries, module_count);
     VECTOR_push_back(props.gateway_links, link_entries, link_count);
 
@@ -4712,6 +4775,7 @@ TEST_FUNCTION(Gateway_modules_sources_vector_create_fail)
     GATEWAY_PROPERTIES props;
     props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
     props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+    props.scheduler_threads = 0;
     VECTOR_push_back(props.gateway_modules, module_entries, module_count);
     VECTOR_push_back(props.gateway_links, link_entries, link_count);
 
@@ -4768,6 +4832,7 @@ TEST_FUNCTION(Gateway_GetModuleList_link_push_back_fail)
     GATEWAY_PROPERTIES props;
     props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
     props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+    props.scheduler_threads = 0;
     VECTOR_push_back(props.gateway_modules, module_entries, module_count);
     VECTOR_push_back(props.gateway_links, link_entries, link_count);
 
@@ -4838,6 +4903,7 @@ TEST_FUNCTION(Gateway_DestroyModuleList_basic)
     GATEWAY_PROPERTIES props;
     props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
     props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+    props.scheduler_threads = 0;
     VECTOR_push_back(props.gateway_modules, module_entries, module_count);
     VECTOR_push_back(props.gateway_links, link_entries, link_count);
 
@@ -5039,6 +5105,7 @@ TEST_FUNCTION(Gateway_RemoveModule_removes_links)
     GATEWAY_PROPERTIES props;
     props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
     props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+    props.scheduler_threads = 0;
     VECTOR_push_back(props.gateway_modules, modules, 3);
     VECTOR_push_back(props.gateway_links, links, 3);
 
@@ -5164,6 +5231,7 @@ TEST_FUNCTION(Gateway_AddModule_name_is_copied)
     GATEWAY_PROPERTIES props;
     props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
     props.gateway_links = NULL;
+    props.scheduler_threads = 0;
     VECTOR_push_back(props.gateway_modules, &module, 1);
 
     // Act
@@ -5206,7 +5274,7 @@ TEST_FUNCTION(Gateway_AddModule_malloc_name_fail)
 	STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_FreeModuleConfiguration(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 		.IgnoreArgument(1)
         .IgnoreArgument(2);
-    EXPECTED_CALL(mocks, Broker_AddModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, Broker_AddModuleWithQueue(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .SetFailReturn(0);
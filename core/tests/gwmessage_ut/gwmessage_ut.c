@@ -64,6 +64,28 @@ static void my_gballoc_free(void* ptr)
     free(ptr);
 }
 
+static size_t test_deallocator_calls;
+static void* test_deallocator_context;
+static unsigned char* test_deallocator_buffer;
+static size_t test_deallocator_size;
+
+static void test_deallocator(void* context, unsigned char* buffer, size_t size)
+{
+    test_deallocator_calls++;
+    test_deallocator_context = context;
+    test_deallocator_buffer = buffer;
+    test_deallocator_size = size;
+}
+
+static MAP_RESULT my_Map_GetInternals(MAP_HANDLE handle, const char*const** keys, const char*const** values, size_t* count)
+{
+    (void)handle;
+    *keys = NULL;
+    *values = NULL;
+    *count = 0;
+    return MAP_OK;
+}
+
 static CONSTMAP_HANDLE my_ConstMap_Create(MAP_HANDLE sourceMap)
 {
     (void)sourceMap;
@@ -330,6 +352,8 @@ static const unsigned char fail_whenThereIsOnly1ByteOfcontentSize[] =
     0x00                    /*not enough bytes for contentSize*/
 };
 
+static const unsigned char bigContent[1025] = { 0 };
+
 #define TEST_MAP_HANDLE ((MAP_HANDLE)(1))
 #define TEST_CONSTBUFFER_HANDLE ((CONSTBUFFER_HANDLE)2)
 #define TEST_CONSTMAP_HANDLE ((CONSTMAP_HANDLE)3)
@@ -357,6 +381,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
         REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
 
+        REGISTER_GLOBAL_MOCK_HOOK(Map_GetInternals, my_Map_GetInternals);
         REGISTER_GLOBAL_MOCK_HOOK(ConstMap_Create, my_ConstMap_Create);
         REGISTER_GLOBAL_MOCK_HOOK(ConstMap_Clone, my_ConstMap_Clone);
         REGISTER_GLOBAL_MOCK_HOOK(ConstMap_Destroy, my_ConstMap_Destroy);
@@ -411,6 +436,10 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         currentCONSTBUFFER_Clone_call = 0;
         whenShallCONSTBUFFER_Clone_fail = 0;
 
+        test_deallocator_calls = 0;
+        test_deallocator_context = NULL;
+        test_deallocator_buffer = NULL;
+        test_deallocator_size = 0;
     }
 
     TEST_FUNCTION_CLEANUP(TestMethodCleanup)
@@ -450,21 +479,21 @@ BEGIN_TEST_SUITE(gwmessage_ut)
     }
 
     /*Tests_SRS_MESSAGE_02_006: [Otherwise, Message_Create shall return a non-NULL handle and shall set the internal ref count to "1".]*/
-    /*Tests_SRS_MESSAGE_02_019: [Message_Create shall clone the sourceProperties to a readonly CONSTMAP.] */
-    /*Tests_SRS_MESSAGE_17_003: [Message_Create shall copy the source to a readonly CONSTBUFFER.]*/
+    /*Tests_SRS_MESSAGE_17_029: [ Message_Create shall serialize the sourceProperties into the memory block of the message. ]*/
+    /*Tests_SRS_MESSAGE_17_030: [ Content of at most 1024 bytes shall be copied into the same memory block as the message. ]*/
     TEST_FUNCTION(Message_Create_happy_path)
     {
         ///arrange
         unsigned char fake;
         MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake};
 
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+        STRICT_EXPECTED_CALL(Map_GetInternals((MAP_HANDLE)&fake, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure, the properties and the content*/
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(&fake, 1)); /*this is copying the buffer*/
-
-        STRICT_EXPECTED_CALL(ConstMap_Create((MAP_HANDLE)&fake)); /*this is copying the properties*/
-
         ///act
         MESSAGE_HANDLE r = Message_Create(&c);
 
@@ -483,13 +512,13 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         unsigned char fake;
         MESSAGE_CONFIG c = { 0, &fake, (MAP_HANDLE)&fake };
 
+        STRICT_EXPECTED_CALL(Map_GetInternals((MAP_HANDLE)&fake, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
         STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(&fake, 0)); /* this is copying the (empty buffer)*/
-
-        STRICT_EXPECTED_CALL(ConstMap_Create((MAP_HANDLE)&fake)); /*this is copying the properties*/
-
         ///act
         MESSAGE_HANDLE r = Message_Create(&c);
 
@@ -508,12 +537,43 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         unsigned char fake;
         MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&fake }; /*<---- this is NULL , in the testbefore it was non-NULL*/
 
+        STRICT_EXPECTED_CALL(Map_GetInternals((MAP_HANDLE)&fake, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
         STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(NULL, 0)); /* this is copying the (empty buffer)*/
+        ///act
+        MESSAGE_HANDLE r = Message_Create(&c);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(r);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(r);
+    }
 
-        STRICT_EXPECTED_CALL(ConstMap_Create((MAP_HANDLE)&fake)); /*this is copying the properties*/
+    /*Tests_SRS_MESSAGE_17_029: [ Message_Create shall serialize the sourceProperties into the memory block of the message. ]*/
+    TEST_FUNCTION(Message_Create_serializes_the_properties)
+    {
+        ///arrange
+        unsigned char fake;
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&fake };
+        size_t two = 2;
+        const char* keys[] = { "3", "ab" };
+        const char* values[] = { "3", "a" };
+        const char* const* pkeys = keys;
+        const char* const* pvalues = values;
+        unsigned char buf[sizeof(notFail__2Property_0bytes)];
+
+        STRICT_EXPECTED_CALL(Map_GetInternals((MAP_HANDLE)&fake, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer_keys(&pkeys, sizeof(pkeys))
+            .CopyOutArgumentBuffer_values(&pvalues, sizeof(pvalues))
+            .CopyOutArgumentBuffer_count(&two, sizeof(two));
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure and the properties*/
+            .IgnoreArgument(1);
 
         ///act
         MESSAGE_HANDLE r = Message_Create(&c);
@@ -521,53 +581,56 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         ///assert
         ASSERT_IS_NOT_NULL(r);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(char_ptr, "3", Message_GetProperty(r, "3"));
+        ASSERT_ARE_EQUAL(char_ptr, "a", Message_GetProperty(r, "ab"));
+        ASSERT_ARE_EQUAL(int32_t, sizeof(notFail__2Property_0bytes), Message_ToByteArray(r, buf, sizeof(buf)));
+        ASSERT_ARE_EQUAL(int, 0, memcmp(buf, notFail__2Property_0bytes, sizeof(buf)));
 
         ///cleanup
         Message_Destroy(r);
     }
 
-    /*Tests_SRS_MESSAGE_02_005: [If Message_Create encounters an error while building the internal structures of the message, then it shall return NULL.]*/
-    TEST_FUNCTION(Message_Create_zero_size_fails_when_Map_Clone_fails)
+    /*Tests_SRS_MESSAGE_17_003: [Message_Create shall copy the source to a readonly CONSTBUFFER if it is bigger than 1024 bytes.]*/
+    TEST_FUNCTION(Message_Create_copies_big_content_to_a_CONSTBUFFER)
     {
         ///arrange
         unsigned char fake;
-        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&fake }; /*<---- this is NULL , in the testbefore it was non-NULL*/
+        MESSAGE_CONFIG c = { sizeof(bigContent), bigContent, (MAP_HANDLE)&fake };
 
+        STRICT_EXPECTED_CALL(Map_GetInternals((MAP_HANDLE)&fake, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
         STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
             .IgnoreArgument(1);
-        {
-            STRICT_EXPECTED_CALL(CONSTBUFFER_Create(NULL, 0)); /* this is copying the (empty buffer)*/
-            {
-                whenShallConstMap_Create_fail = 1;
-                STRICT_EXPECTED_CALL(ConstMap_Create((MAP_HANDLE)&fake)) /*this is copying the properties*/
-                    .IgnoreArgument(1);
-
-                STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG)) /* this is copying the (empty buffer)*/
-                    .IgnoreArgument(1);
-            }
-            STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
-                .IgnoreArgument(1);
-        }
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(bigContent, sizeof(bigContent))); /*this is copying the buffer*/
+        STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
         ///act
         MESSAGE_HANDLE r = Message_Create(&c);
 
         ///assert
-        ASSERT_IS_NULL(r);
+        ASSERT_IS_NOT_NULL(r);
+        ASSERT_ARE_EQUAL(size_t, sizeof(bigContent), Message_GetContent(r)->size);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
+        Message_Destroy(r);
     }
 
     /*Tests_SRS_MESSAGE_02_005: [If Message_Create encounters an error while building the internal structures of the message, then it shall return NULL.]*/
-    TEST_FUNCTION(Message_Create_zero_size_fails_when_malloc_fails)
+    TEST_FUNCTION(Message_Create_fails_when_Map_GetInternals_fails)
     {
         ///arrange
         unsigned char fake;
-        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&fake }; /*<---- this is NULL , in the testbefore it was non-NULL*/
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&fake };
 
-        whenShallmalloc_fail = 1;
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
-            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(Map_GetInternals((MAP_HANDLE)&fake, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count()
+            .SetReturn(MAP_ERROR);
 
         ///act
         MESSAGE_HANDLE r = Message_Create(&c);
@@ -580,27 +643,20 @@ BEGIN_TEST_SUITE(gwmessage_ut)
     }
 
     /*Tests_SRS_MESSAGE_02_005: [If Message_Create encounters an error while building the internal structures of the message, then it shall return NULL.]*/
-    TEST_FUNCTION(Message_Create_nonzero_size_fails_when_Map_Clone_fails)
+    TEST_FUNCTION(Message_Create_zero_size_fails_when_malloc_fails)
     {
         ///arrange
         unsigned char fake;
-        MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&fake }; /*<---- this is NULL , in the testbefore it was non-NULL*/
 
+        STRICT_EXPECTED_CALL(Map_GetInternals((MAP_HANDLE)&fake, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
+        whenShallmalloc_fail = 1;
         STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
             .IgnoreArgument(1);
-        {
-            STRICT_EXPECTED_CALL(CONSTBUFFER_Create(&fake, 1)); /* this is copying the buffer*/
-            {
-
-                whenShallConstMap_Create_fail = 1;
-                STRICT_EXPECTED_CALL(ConstMap_Create((MAP_HANDLE)&fake)); /*this is copying the properties*/
 
-                STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG))
-                    .IgnoreArgument(1);
-            }
-            STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
-                .IgnoreArgument(1);
-        }
         ///act
         MESSAGE_HANDLE r = Message_Create(&c);
 
@@ -612,17 +668,21 @@ BEGIN_TEST_SUITE(gwmessage_ut)
     }
 
     /*Tests_SRS_MESSAGE_02_005: [If Message_Create encounters an error while building the internal structures of the message, then it shall return NULL.]*/
-    TEST_FUNCTION(Message_Create_nonzero_size_fails_when_CONSTBUFFER_fails_1)
+    TEST_FUNCTION(Message_Create_big_content_fails_when_CONSTBUFFER_fails)
     {
         ///arrange
         unsigned char fake;
-        MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+        MESSAGE_CONFIG c = { sizeof(bigContent), bigContent, (MAP_HANDLE)&fake };
 
+        STRICT_EXPECTED_CALL(Map_GetInternals((MAP_HANDLE)&fake, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
         STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
             .IgnoreArgument(1);
 
         whenShallCONSTBUFFER_Create_fail = 1;
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(&fake, 1)); /* this is copying the buffer*/
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(bigContent, sizeof(bigContent))); /* this is copying the buffer*/
         STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
@@ -644,6 +704,10 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         unsigned char fake;
         MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
 
+        STRICT_EXPECTED_CALL(Map_GetInternals((MAP_HANDLE)&fake, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
         whenShallmalloc_fail = 1;
         STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
             .IgnoreArgument(1);
@@ -725,7 +789,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
     }
 
     /*Tests_SRS_MESSAGE_17_014: [On success, Message_CreateFromBuffer shall return a non-NULL handle and set the internal ref count to "1".]*/
-    /*Tests_SRS_MESSAGE_17_012: [Message_CreateFromBuffer shall copy the sourceProperties to a readonly CONSTMAP.]*/
+    /*Tests_SRS_MESSAGE_17_012: [Message_CreateFromBuffer shall serialize the sourceProperties into the memory block of the message.]*/
     /*Tests_SRS_MESSAGE_17_013: [Message_CreateFromBuffer shall clone the CONSTBUFFER sourceBuffer.]*/
     TEST_FUNCTION(Message_CreateFromBuffer_Success)
     {
@@ -740,12 +804,15 @@ BEGIN_TEST_SUITE(gwmessage_ut)
 
         umock_c_reset_all_calls();
 
+        STRICT_EXPECTED_CALL(Map_GetInternals((MAP_HANDLE)&fake, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
         STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
             .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(CONSTBUFFER_Clone(buffer)); /*this is copying the buffer*/
-
-        STRICT_EXPECTED_CALL(ConstMap_Create((MAP_HANDLE)&fake)); /*this is copying the properties*/
+        STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(buffer));
 
 
         ///act
@@ -777,6 +844,10 @@ BEGIN_TEST_SUITE(gwmessage_ut)
 
         umock_c_reset_all_calls();
 
+        STRICT_EXPECTED_CALL(Map_GetInternals((MAP_HANDLE)&fake, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
         STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
             .IgnoreArgument(1);
 
@@ -807,6 +878,10 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         whenShallCONSTBUFFER_Clone_fail = 1;
         umock_c_reset_all_calls();
 
+        STRICT_EXPECTED_CALL(Map_GetInternals((MAP_HANDLE)&fake, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
         STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
             .IgnoreArgument(1);
 
@@ -837,23 +912,13 @@ BEGIN_TEST_SUITE(gwmessage_ut)
             (MAP_HANDLE)&fake
         };
 
-        whenShallConstMap_Create_fail = 1;
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
-            .IgnoreArgument(1);
-        {
-            
-            STRICT_EXPECTED_CALL(CONSTBUFFER_Clone(buffer)); /*this is copying the buffer*/
-            {
-                STRICT_EXPECTED_CALL(ConstMap_Create((MAP_HANDLE)&fake)); /*this is copying the properties*/
-                STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(buffer));
-            }
-
-            STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
-                .IgnoreArgument(1);
-        }
-
+        STRICT_EXPECTED_CALL(Map_GetInternals((MAP_HANDLE)&fake, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count()
+            .SetReturn(MAP_ERROR);
 
         ///act
         MESSAGE_HANDLE r = Message_CreateFromBuffer(&cfg);
@@ -866,6 +931,205 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         CONSTBUFFER_Destroy(buffer);
     }
 
+    /*Tests_SRS_MESSAGE_17_034: [ If cfg is NULL then Message_CreateWithOwnership shall return NULL. ]*/
+    TEST_FUNCTION(Message_CreateWithOwnership_with_NULL_parameter_fails)
+    {
+        ///arrange
+
+        ///act
+        MESSAGE_HANDLE r = Message_CreateWithOwnership(NULL);
+
+        ///assert
+        ASSERT_IS_NULL(r);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_035: [ If field source, deallocator or sourceProperties of cfg is NULL, then Message_CreateWithOwnership shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateWithOwnership_with_NULL_source_fails)
+    {
+        ///arrange
+        unsigned char fake;
+        MESSAGE_OWNERSHIP_CONFIG c = { 1, NULL, test_deallocator, NULL, (MAP_HANDLE)&fake };
+
+        ///act
+        MESSAGE_HANDLE r = Message_CreateWithOwnership(&c);
+
+        ///assert
+        ASSERT_IS_NULL(r);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_035: [ If field source, deallocator or sourceProperties of cfg is NULL, then Message_CreateWithOwnership shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateWithOwnership_with_NULL_deallocator_fails)
+    {
+        ///arrange
+        unsigned char fake;
+        MESSAGE_OWNERSHIP_CONFIG c = { 1, &fake, NULL, NULL, (MAP_HANDLE)&fake };
+
+        ///act
+        MESSAGE_HANDLE r = Message_CreateWithOwnership(&c);
+
+        ///assert
+        ASSERT_IS_NULL(r);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_035: [ If field source, deallocator or sourceProperties of cfg is NULL, then Message_CreateWithOwnership shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateWithOwnership_with_NULL_properties_fails)
+    {
+        ///arrange
+        unsigned char fake;
+        MESSAGE_OWNERSHIP_CONFIG c = { 1, &fake, test_deallocator, NULL, NULL };
+
+        ///act
+        MESSAGE_HANDLE r = Message_CreateWithOwnership(&c);
+
+        ///assert
+        ASSERT_IS_NULL(r);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_037: [ Message_CreateWithOwnership shall serialize the sourceProperties into the memory block of the message. ]*/
+    /*Tests_SRS_MESSAGE_17_038: [ Message_CreateWithOwnership shall use source as the content of the message without copying it. ]*/
+    /*Tests_SRS_MESSAGE_17_039: [ On success, Message_CreateWithOwnership shall return a non-NULL handle and set the internal ref count to "1". ]*/
+    TEST_FUNCTION(Message_CreateWithOwnership_happy_path)
+    {
+        ///arrange
+        unsigned char fake;
+        MESSAGE_OWNERSHIP_CONFIG c = { sizeof(bigContent), (unsigned char*)bigContent, test_deallocator, &fake, (MAP_HANDLE)&fake };
+
+        STRICT_EXPECTED_CALL(Map_GetInternals((MAP_HANDLE)&fake, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure and the properties*/
+            .IgnoreArgument(1);
+
+        ///act
+        MESSAGE_HANDLE r = Message_CreateWithOwnership(&c);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(r);
+        ASSERT_ARE_EQUAL(void_ptr, bigContent, Message_GetContent(r)->buffer);
+        ASSERT_ARE_EQUAL(size_t, sizeof(bigContent), Message_GetContent(r)->size);
+        ASSERT_ARE_EQUAL(size_t, 0, test_deallocator_calls);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(r);
+    }
+
+    /*Tests_SRS_MESSAGE_17_036: [ If Message_CreateWithOwnership encounters an error while building the internal structures of the message, then it shall return NULL and shall not call deallocator. ]*/
+    TEST_FUNCTION(Message_CreateWithOwnership_fails_when_Map_GetInternals_fails)
+    {
+        ///arrange
+        unsigned char fake;
+        MESSAGE_OWNERSHIP_CONFIG c = { 1, &fake, test_deallocator, NULL, (MAP_HANDLE)&fake };
+
+        STRICT_EXPECTED_CALL(Map_GetInternals((MAP_HANDLE)&fake, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count()
+            .SetReturn(MAP_ERROR);
+
+        ///act
+        MESSAGE_HANDLE r = Message_CreateWithOwnership(&c);
+
+        ///assert
+        ASSERT_IS_NULL(r);
+        ASSERT_ARE_EQUAL(size_t, 0, test_deallocator_calls);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_036: [ If Message_CreateWithOwnership encounters an error while building the internal structures of the message, then it shall return NULL and shall not call deallocator. ]*/
+    TEST_FUNCTION(Message_CreateWithOwnership_fails_when_malloc_fails)
+    {
+        ///arrange
+        unsigned char fake;
+        MESSAGE_OWNERSHIP_CONFIG c = { 1, &fake, test_deallocator, NULL, (MAP_HANDLE)&fake };
+
+        STRICT_EXPECTED_CALL(Map_GetInternals((MAP_HANDLE)&fake, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
+        whenShallmalloc_fail = 1;
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+            .IgnoreArgument(1);
+
+        ///act
+        MESSAGE_HANDLE r = Message_CreateWithOwnership(&c);
+
+        ///assert
+        ASSERT_IS_NULL(r);
+        ASSERT_ARE_EQUAL(size_t, 0, test_deallocator_calls);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_040: [ If the ref count is zero and the content was adopted by Message_CreateWithOwnership, Message_Destroy shall call deallocator with deallocatorContext, source and size. ]*/
+    TEST_FUNCTION(Message_Destroy_calls_the_deallocator_of_adopted_content)
+    {
+        ///arrange
+        unsigned char fake;
+        unsigned char content[3] = { 1, 2, 3 };
+        MESSAGE_OWNERSHIP_CONFIG c = { sizeof(content), content, test_deallocator, &fake, (MAP_HANDLE)&fake };
+        MESSAGE_HANDLE msg = Message_CreateWithOwnership(&c);
+        MESSAGE_HANDLE clone = Message_Clone(msg);
+        Message_Destroy(clone);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is the handle*/
+            .IgnoreArgument(1);
+
+        ///act
+        Message_Destroy(msg);
+
+        ///assert
+        ASSERT_ARE_EQUAL(size_t, 1, test_deallocator_calls);
+        ASSERT_ARE_EQUAL(void_ptr, &fake, test_deallocator_context);
+        ASSERT_ARE_EQUAL(void_ptr, content, test_deallocator_buffer);
+        ASSERT_ARE_EQUAL(size_t, sizeof(content), test_deallocator_size);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_032: [ If the content is not held by a CONSTBUFFER, the first call to Message_GetContentHandle shall copy it to a readonly CONSTBUFFER that is kept by the message. ]*/
+    TEST_FUNCTION(Message_GetContentHandle_copies_adopted_content)
+    {
+        ///arrange
+        unsigned char fake;
+        unsigned char content[3] = { 1, 2, 3 };
+        MESSAGE_OWNERSHIP_CONFIG c = { sizeof(content), content, test_deallocator, NULL, (MAP_HANDLE)&fake };
+        MESSAGE_HANDLE msg = Message_CreateWithOwnership(&c);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(content, sizeof(content)));
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Clone(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        CONSTBUFFER_HANDLE handle = Message_GetContentHandle(msg);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        CONSTBUFFER_Destroy(handle);
+        Message_Destroy(msg);
+    }
     /*Tests_SRS_MESSAGE_02_007: [If messageHandle is NULL then Message_Clone shall return NULL.] */
     TEST_FUNCTION(Message_Clone_with_NULL_argument_returns_NULL)
     {
@@ -882,8 +1146,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
     }
 
     /*Tests_SRS_MESSAGE_02_010: [Message_Clone shall return messageHandle.]*/
-    /*Tests_SRS_MESSAGE_17_001: [Message_Clone shall clone the CONSTMAP handle.]*/
-    /*Tests_SRS_MESSAGE_17_004: [Message_Clone shall clone the CONSTBUFFER handle]*/
+    /*Tests_SRS_MESSAGE_17_020: [ Message_Clone shall not clone the CONSTMAP nor the CONSTBUFFER handles, they are shared by all the references to the message. ]*/
     TEST_FUNCTION(Message_Clone_increments_ref_count_1)
     {
         ///arrange
@@ -891,11 +1154,6 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         MESSAGE_HANDLE aMessage = Message_Create(&c);
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(ConstMap_Clone(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Clone(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
         ///act
         MESSAGE_HANDLE r = Message_Clone(aMessage);
 
@@ -917,11 +1175,6 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         MESSAGE_HANDLE r = Message_Clone(aMessage);
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
         ///act
         Message_Destroy(r);
 
@@ -933,6 +1186,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
     }
 
     /*Tests_SRS_MESSAGE_02_008: [Otherwise, Message_Clone shall increment the internal ref count.] */
+    /*Tests_SRS_MESSAGE_02_021: [If the ref count is zero then the allocated resources are freed.]*/
     TEST_FUNCTION(Message_Clone_increments_ref_count_3)
     {
         ///arrange
@@ -942,11 +1196,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         Message_Destroy(r);
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*only 1 because the message is 0 size*/
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*only 1 because the message is a single block*/
             .IgnoreArgument(1);
 
         ///act
@@ -975,6 +1225,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
     }
 
     /*Tests_SRS_MESSAGE_02_012: [Otherwise, Message_GetProperties shall shall clone and return the CONSTMAP handle representing the properties of the message.]*/
+    /*Tests_SRS_MESSAGE_17_022: [ If the properties of the message have not been decoded yet, Message_GetProperties shall create a MAP_HANDLE, add all the serialized properties to it and copy it to a readonly CONSTMAP. ]*/
     TEST_FUNCTION(Message_GetProperties_happy_path)
     {
         ///arrange
@@ -982,6 +1233,11 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         MESSAGE_HANDLE aMessage = Message_Create(&c);
         umock_c_reset_all_calls();
 
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
         STRICT_EXPECTED_CALL(ConstMap_Clone(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
         ///act
@@ -1021,9 +1277,6 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         MESSAGE_HANDLE msg = Message_Create(&c);
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
         ///act
         const CONSTBUFFER* content = Message_GetContent(msg);
 
@@ -1048,9 +1301,6 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         MESSAGE_HANDLE msg = Message_Create(&c);
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
         ///act
         const CONSTBUFFER* content = Message_GetContent(msg);
 
@@ -1080,6 +1330,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
     }
 
     /*Tests_SRS_MESSAGE_17_007: [Otherwise, Message_GetContentHandle shall shall clone and return the CONSTBUFFER_HANDLE representing the message content.]*/
+    /*Tests_SRS_MESSAGE_17_032: [ If the content is not held by a CONSTBUFFER, the first call to Message_GetContentHandle shall copy it to a readonly CONSTBUFFER that is kept by the message. ]*/
     TEST_FUNCTION(Message_GetContentHandle_with_non_NULL_message_zero_size_succeeds)
     {
         ///arrange
@@ -1087,6 +1338,8 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         MESSAGE_HANDLE msg = Message_Create(&c);
         umock_c_reset_all_calls();
 
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 0))
+            .IgnoreArgument_source();
         STRICT_EXPECTED_CALL(CONSTBUFFER_Clone(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
@@ -1108,6 +1361,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
     }
 
     /*Tests_SRS_MESSAGE_17_007: [Otherwise, Message_GetContentHandle shall shall clone and return the CONSTBUFFER_HANDLE representing the message content.]*/
+    /*Tests_SRS_MESSAGE_17_032: [ If the content is not held by a CONSTBUFFER, the first call to Message_GetContentHandle shall copy it to a readonly CONSTBUFFER that is kept by the message. ]*/
     TEST_FUNCTION(Message_GetContentHandle_with_non_NULL_message_nonzero_size_succeeds)
     {
         ///arrange
@@ -1116,6 +1370,8 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         MESSAGE_HANDLE msg = Message_Create(&c);
         umock_c_reset_all_calls();
 
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 1))
+            .IgnoreArgument_source();
         STRICT_EXPECTED_CALL(CONSTBUFFER_Clone(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
@@ -1135,8 +1391,58 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         CONSTBUFFER_Destroy(content);
     }
 
-    /*Tests_SRS_MESSAGE_02_017: [If message is NULL then Message_Destroy shall do nothing.] */
-    TEST_FUNCTION(Message_Destroy_with_NULL_argument_does_nothing)
+
+    /*Tests_SRS_MESSAGE_17_032: [ If the content is not held by a CONSTBUFFER, the first call to Message_GetContentHandle shall copy it to a readonly CONSTBUFFER that is kept by the message. ]*/
+    TEST_FUNCTION(Message_GetContentHandle_creates_the_CONSTBUFFER_only_once)
+    {
+        ///arrange
+        char t = '3';
+        MESSAGE_CONFIG c = { sizeof(t), (unsigned char*)&t, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE msg = Message_Create(&c);
+        CONSTBUFFER_HANDLE first = Message_GetContentHandle(msg);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Clone(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        CONSTBUFFER_HANDLE second = Message_GetContentHandle(msg);
+
+        ///assert
+        ASSERT_ARE_EQUAL(void_ptr, first, second);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        CONSTBUFFER_Destroy(first);
+        CONSTBUFFER_Destroy(second);
+        Message_Destroy(msg);
+    }
+
+    /*Tests_SRS_MESSAGE_17_033: [ If creating the CONSTBUFFER fails, Message_GetContentHandle shall return NULL. ]*/
+    TEST_FUNCTION(Message_GetContentHandle_fails_when_CONSTBUFFER_Create_fails)
+    {
+        ///arrange
+        char t = '3';
+        MESSAGE_CONFIG c = { sizeof(t), (unsigned char*)&t, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE msg = Message_Create(&c);
+        umock_c_reset_all_calls();
+
+        whenShallCONSTBUFFER_Create_fail = 1;
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 1))
+            .IgnoreArgument_source();
+
+        ///act
+        CONSTBUFFER_HANDLE content = Message_GetContentHandle(msg);
+
+        ///assert
+        ASSERT_IS_NULL(content);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(msg);
+    }
+    /*Tests_SRS_MESSAGE_02_017: [If message is NULL then Message_Destroy shall do nothing.] */
+    TEST_FUNCTION(Message_Destroy_with_NULL_argument_does_nothing)
     {
         ///arrange
 
@@ -1152,8 +1458,6 @@ BEGIN_TEST_SUITE(gwmessage_ut)
 
     /*Tests_SRS_MESSAGE_02_020: [Otherwise, Message_Destroy shall decrement the internal ref count of the message.]*/
     /*Tests_SRS_MESSAGE_02_021: [If the ref count is zero then the allocated resources are freed.]*/
-    /*Tests_SRS_MESSAGE_17_002: [Message_Destroy shall destroy the CONSTMAP properties.]*/
-    /*Tests_SRS_MESSAGE_17_005: [Message_Destroy shall destroy the CONSTBUFFER.]*/
     TEST_FUNCTION(Message_Destroy_happy_path)
     {
         ///arrange
@@ -1162,20 +1466,430 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         MESSAGE_HANDLE msg = Message_Create(&c);
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(ConstMap_Destroy(IGNORED_PTR_ARG)) /*this is the map*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG)) /*this is the buffer*/
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is the handle*/
+            .IgnoreArgument(1);
+
+        ///act
+        Message_Destroy(msg);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_021: [ If the ref count is zero, Message_Destroy shall destroy the CONSTMAP properties and the CONSTBUFFER content, if they exist. ]*/
+    TEST_FUNCTION(Message_Destroy_destroys_the_CONSTMAP_and_the_CONSTBUFFER)
+    {
+        ///arrange
+        char t = '3';
+        MESSAGE_CONFIG c = { sizeof(t), (unsigned char*)&t, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE msg = Message_Create(&c);
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        CONSTMAP_HANDLE properties = Message_GetProperties(msg);
+        CONSTBUFFER_HANDLE content = Message_GetContentHandle(msg);
+        ConstMap_Destroy(properties);
+        CONSTBUFFER_Destroy(content);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(ConstMap_Destroy(IGNORED_PTR_ARG)) /*this is the map*/
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG)) /*this is the buffer*/
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is the handle*/
+            .IgnoreArgument(1);
+
+        ///act
+        Message_Destroy(msg);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_022: [ If the properties of the message have not been decoded yet, Message_GetProperties shall create a MAP_HANDLE, add all the serialized properties to it and copy it to a readonly CONSTMAP. ]*/
+    TEST_FUNCTION(Message_GetProperties_decodes_the_serialized_properties)
+    {
+        ///arrange
+        MESSAGE_HANDLE msg = Message_CreateFromByteArray(notFail__2Property_0bytes, sizeof(notFail__2Property_0bytes));
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "3", "3"))
+            .SetReturn(MAP_OK);
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "ab", "a"))
+            .SetReturn(MAP_OK);
+        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(ConstMap_Clone(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        CONSTMAP_HANDLE theProperties = Message_GetProperties(msg);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(theProperties);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        ConstMap_Destroy(theProperties);
+        Message_Destroy(msg);
+    }
+
+    /*Tests_SRS_MESSAGE_17_022: [ If the properties of the message have not been decoded yet, Message_GetProperties shall create a MAP_HANDLE, add all the serialized properties to it and copy it to a readonly CONSTMAP. ]*/
+    TEST_FUNCTION(Message_GetProperties_decodes_the_serialized_properties_only_once)
+    {
+        ///arrange
+        MESSAGE_HANDLE msg = Message_CreateFromByteArray(notFail__1Property_0bytes, sizeof(notFail__1Property_0bytes));
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "3", "3"))
+            .SetReturn(MAP_OK);
+        CONSTMAP_HANDLE first = Message_GetProperties(msg);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(ConstMap_Clone(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        CONSTMAP_HANDLE second = Message_GetProperties(msg);
+
+        ///assert
+        ASSERT_ARE_EQUAL(void_ptr, first, second);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        ConstMap_Destroy(first);
+        ConstMap_Destroy(second);
+        Message_Destroy(msg);
+    }
+
+    /*Tests_SRS_MESSAGE_17_023: [ If decoding the properties fails, Message_GetProperties shall return NULL. ]*/
+    TEST_FUNCTION(Message_GetProperties_fails_when_Map_Add_fails)
+    {
+        ///arrange
+        MESSAGE_HANDLE msg = Message_CreateFromByteArray(notFail__1Property_0bytes, sizeof(notFail__1Property_0bytes));
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "3", "3"))
+            .SetReturn(MAP_ERROR);
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        CONSTMAP_HANDLE theProperties = Message_GetProperties(msg);
+
+        ///assert
+        ASSERT_IS_NULL(theProperties);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(msg);
+    }
+
+    /*Tests_SRS_MESSAGE_17_023: [ If decoding the properties fails, Message_GetProperties shall return NULL. ]*/
+    TEST_FUNCTION(Message_GetProperties_fails_when_ConstMap_Create_fails)
+    {
+        ///arrange
+        MESSAGE_HANDLE msg = Message_CreateFromByteArray(notFail____minimalMessage, sizeof(notFail____minimalMessage));
+        umock_c_reset_all_calls();
+
+        whenShallConstMap_Create_fail = 1;
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        CONSTMAP_HANDLE theProperties = Message_GetProperties(msg);
+
+        ///assert
+        ASSERT_IS_NULL(theProperties);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(msg);
+    }
+
+    /*Tests_SRS_MESSAGE_17_026: [ If message or name is NULL then Message_GetProperty shall return NULL. ]*/
+    TEST_FUNCTION(Message_GetProperty_with_NULL_message_returns_NULL)
+    {
+        ///arrange
+
+        ///act
+        const char* value = Message_GetProperty(NULL, "3");
+
+        ///assert
+        ASSERT_IS_NULL(value);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_026: [ If message or name is NULL then Message_GetProperty shall return NULL. ]*/
+    TEST_FUNCTION(Message_GetProperty_with_NULL_name_returns_NULL)
+    {
+        ///arrange
+        MESSAGE_HANDLE msg = Message_CreateFromByteArray(notFail__1Property_0bytes, sizeof(notFail__1Property_0bytes));
+        umock_c_reset_all_calls();
+
+        ///act
+        const char* value = Message_GetProperty(msg, NULL);
+
+        ///assert
+        ASSERT_IS_NULL(value);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(msg);
+    }
+
+    /*Tests_SRS_MESSAGE_17_027: [ Message_GetProperty shall look the property up in the serialized properties without decoding them. ]*/
+    TEST_FUNCTION(Message_GetProperty_reads_the_serialized_properties)
+    {
+        ///arrange
+        MESSAGE_HANDLE msg = Message_CreateFromByteArray(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes));
+        umock_c_reset_all_calls();
+
+        ///act
+        const char* value1 = Message_GetProperty(msg, "Azure IoT Gateway is");
+        const char* value2 = Message_GetProperty(msg, "BleedingEdge");
+        const char* value3 = Message_GetProperty(msg, "Bleeding");
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, "awesome", value1);
+        ASSERT_ARE_EQUAL(char_ptr, "rocks", value2);
+        ASSERT_IS_NULL(value3);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(msg);
+    }
+
+    /*Tests_SRS_MESSAGE_17_041: [ If message is NULL, or edits is NULL and editCount is not zero, then Message_CreateDerived shall return NULL. ]*/
+    TEST_FUNCTION(Message_CreateDerived_with_NULL_message_fails)
+    {
+        ///arrange
+        MESSAGE_PROPERTY_EDIT edits[] = { { "name", "value" } };
+
+        ///act
+        MESSAGE_HANDLE r = Message_CreateDerived(NULL, edits, 1);
+
+        ///assert
+        ASSERT_IS_NULL(r);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_041: [ If message is NULL, or edits is NULL and editCount is not zero, then Message_CreateDerived shall return NULL. ]*/
+    TEST_FUNCTION(Message_CreateDerived_with_NULL_edits_fails)
+    {
+        ///arrange
+        MESSAGE_HANDLE msg = Message_CreateFromByteArray(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes));
+        umock_c_reset_all_calls();
+
+        ///act
+        MESSAGE_HANDLE r = Message_CreateDerived(msg, NULL, 1);
+
+        ///assert
+        ASSERT_IS_NULL(r);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(msg);
+    }
+
+    /*Tests_SRS_MESSAGE_17_042: [ If the name of any edit is NULL, then Message_CreateDerived shall return NULL. ]*/
+    TEST_FUNCTION(Message_CreateDerived_with_NULL_edit_name_fails)
+    {
+        ///arrange
+        MESSAGE_PROPERTY_EDIT edits[] = { { "name", "value" }, { NULL, "value" } };
+        MESSAGE_HANDLE msg = Message_CreateFromByteArray(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes));
+        umock_c_reset_all_calls();
+
+        ///act
+        MESSAGE_HANDLE r = Message_CreateDerived(msg, edits, 2);
+
+        ///assert
+        ASSERT_IS_NULL(r);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(msg);
+    }
+
+    /*Tests_SRS_MESSAGE_17_043: [ Message_CreateDerived shall allocate a message with room for the added and replaced properties only. ]*/
+    /*Tests_SRS_MESSAGE_17_044: [ Message_CreateDerived shall keep the properties of message that no edit names, in the same order, without copying them. ]*/
+    /*Tests_SRS_MESSAGE_17_045: [ Message_CreateDerived shall replace the value of a property of message named by an edit with a non-NULL value, in the same position. ]*/
+    /*Tests_SRS_MESSAGE_17_046: [ Message_CreateDerived shall remove a property of message named by an edit with a NULL value. ]*/
+    /*Tests_SRS_MESSAGE_17_047: [ Message_CreateDerived shall add the properties named by edits with a non-NULL value that message does not have, after the properties of message, in the order of edits. ]*/
+    /*Tests_SRS_MESSAGE_17_049: [ Message_CreateDerived shall share the content of message without copying it and shall keep a reference to message until the new message is destroyed. ]*/
+    /*Tests_SRS_MESSAGE_17_052: [ On success, Message_CreateDerived shall return a non-NULL handle and set the internal ref count to "1". ]*/
+    TEST_FUNCTION(Message_CreateDerived_happy_path)
+    {
+        ///arrange
+        const unsigned char expected[] =
+        {
+            0xA1, 0x60,             /*header*/
+            0x00, 0x00, 0x00, 53,   /*size of this array*/
+            0x00, 0x00, 0x00, 0x02, /*two properties*/
+            'A', 'z','u','r','e',' ','I','o','T',' ','G','a','t','e','w','a','y',' ','i','s','\0','g','r','e','a','t','\0',
+            'n','e','w','\0','v','a','l','u','e','\0',
+            0x00, 0x00, 0x00, 0x02,  /*2 message content size*/
+            '3', '4'
+        };
+        unsigned char buf[sizeof(expected)];
+        MESSAGE_PROPERTY_EDIT edits[] =
+        {
+            { "new", "value" },
+            { "BleedingEdge", NULL },
+            { "Azure IoT Gateway is", "great" }
+        };
+        MESSAGE_HANDLE msg = Message_CreateFromByteArray(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes));
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure and the edited properties*/
+            .IgnoreArgument(1);
+
+        ///act
+        MESSAGE_HANDLE r = Message_CreateDerived(msg, edits, sizeof(edits) / sizeof(edits[0]));
+
+        ///assert
+        ASSERT_IS_NOT_NULL(r);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(void_ptr, Message_GetContent(msg)->buffer, Message_GetContent(r)->buffer);
+        ASSERT_ARE_EQUAL(size_t, Message_GetContent(msg)->size, Message_GetContent(r)->size);
+        ASSERT_IS_NULL(Message_GetProperty(r, "BleedingEdge"));
+        ASSERT_ARE_EQUAL(char_ptr, "great", Message_GetProperty(r, "Azure IoT Gateway is"));
+        ASSERT_ARE_EQUAL(char_ptr, "value", Message_GetProperty(r, "new"));
+        ASSERT_ARE_EQUAL(char_ptr, "rocks", Message_GetProperty(msg, "BleedingEdge"));
+        ASSERT_ARE_EQUAL(char_ptr, "awesome", Message_GetProperty(msg, "Azure IoT Gateway is"));
+        ASSERT_ARE_EQUAL(int32_t, sizeof(expected), Message_ToByteArray(r, buf, sizeof(buf)));
+        ASSERT_ARE_EQUAL(int, 0, memcmp(expected, buf, sizeof(expected)));
+
+        ///cleanup
+        Message_Destroy(r);
+        Message_Destroy(msg);
+    }
+
+    /*Tests_SRS_MESSAGE_17_048: [ If several edits name the same property, Message_CreateDerived shall only apply the last one. ]*/
+    TEST_FUNCTION(Message_CreateDerived_applies_the_last_edit_of_a_property)
+    {
+        ///arrange
+        MESSAGE_PROPERTY_EDIT edits[] =
+        {
+            { "BleedingEdge", "first" },
+            { "new", "first" },
+            { "BleedingEdge", "last" },
+            { "new", NULL }
+        };
+        MESSAGE_HANDLE msg = Message_CreateFromByteArray(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes));
+        umock_c_reset_all_calls();
+
+        ///act
+        MESSAGE_HANDLE r = Message_CreateDerived(msg, edits, sizeof(edits) / sizeof(edits[0]));
+
+        ///assert
+        ASSERT_IS_NOT_NULL(r);
+        ASSERT_ARE_EQUAL(char_ptr, "last", Message_GetProperty(r, "BleedingEdge"));
+        ASSERT_IS_NULL(Message_GetProperty(r, "new"));
+        ASSERT_ARE_EQUAL(int32_t, sizeof(notFail__2Property_2bytes) - 1, Message_ToByteArray(r, NULL, 0)); /*"last" is one byte shorter than "rocks"*/
+
+        ///cleanup
+        Message_Destroy(r);
+        Message_Destroy(msg);
+    }
+
+    /*Tests_SRS_MESSAGE_17_051: [ If Message_CreateDerived encounters an error while building the internal structures of the message, then it shall return NULL. ]*/
+    TEST_FUNCTION(Message_CreateDerived_fails_when_malloc_fails)
+    {
+        ///arrange
+        MESSAGE_PROPERTY_EDIT edits[] = { { "new", "value" } };
+        MESSAGE_HANDLE msg = Message_CreateFromByteArray(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes));
+        umock_c_reset_all_calls();
+
+        whenShallmalloc_fail = currentmalloc_call + 1;
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure and the edited properties*/
+            .IgnoreArgument(1);
+
+        ///act
+        MESSAGE_HANDLE r = Message_CreateDerived(msg, edits, 1);
+
+        ///assert
+        ASSERT_IS_NULL(r);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(msg);
+    }
+
+    /*Tests_SRS_MESSAGE_17_049: [ Message_CreateDerived shall share the content of message without copying it and shall keep a reference to message until the new message is destroyed. ]*/
+    /*Tests_SRS_MESSAGE_17_053: [ If the ref count is zero and the message was created by Message_CreateDerived, Message_Destroy shall destroy the reference it holds to the message it derives from. ]*/
+    TEST_FUNCTION(Message_CreateDerived_outlives_the_message_it_derives_from)
+    {
+        ///arrange
+        MESSAGE_PROPERTY_EDIT edits[] = { { "new", "value" } };
+        MESSAGE_HANDLE msg = Message_CreateFromByteArray(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes));
+        MESSAGE_HANDLE r = Message_CreateDerived(msg, edits, 1);
+        Message_Destroy(msg);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is the derived message*/
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is the message it derives from*/
+            .IgnoreArgument(1);
+
+        ///act
+        const char* kept = Message_GetProperty(r, "BleedingEdge");
+        const CONSTBUFFER* content = Message_GetContent(r);
+        ASSERT_ARE_EQUAL(char_ptr, "rocks", kept);
+        ASSERT_ARE_EQUAL(size_t, 2, content->size);
+        ASSERT_ARE_EQUAL(int, 0, memcmp("34", content->buffer, 2));
+        Message_Destroy(r);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_050: [ The CONSTBUFFER_HANDLE of a message created by Message_CreateDerived shall be a clone of the CONSTBUFFER_HANDLE of the message it derives from. ]*/
+    TEST_FUNCTION(Message_GetContentHandle_of_derived_message_clones_the_content_handle)
+    {
+        ///arrange
+        unsigned char fake;
+        MESSAGE_CONFIG c = { sizeof(bigContent), bigContent, (MAP_HANDLE)&fake };
+        MESSAGE_HANDLE msg = Message_Create(&c);
+        MESSAGE_HANDLE r = Message_CreateDerived(msg, NULL, 0);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Clone(IGNORED_PTR_ARG)) /*this is kept by the derived message*/
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is the handle*/
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Clone(IGNORED_PTR_ARG)) /*this is returned*/
             .IgnoreArgument(1);
 
         ///act
-        Message_Destroy(msg);
+        CONSTBUFFER_HANDLE content = Message_GetContentHandle(r);
 
         ///assert
+        ASSERT_IS_NOT_NULL(content);
+        ASSERT_ARE_EQUAL(size_t, sizeof(bigContent), CONSTBUFFER_GetContent(content)->size);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
+        CONSTBUFFER_Destroy(content);
+        Message_Destroy(r);
+        Message_Destroy(msg);
     }
 
     /*Tests_SRS_MESSAGE_02_022: [ If source is NULL then Message_CreateFromByteArray shall fail and return NULL. ]*/
@@ -1216,22 +1930,14 @@ BEGIN_TEST_SUITE(gwmessage_ut)
     }
 
     /*Tests_SRS_MESSAGE_02_031: [ Otherwise Message_CreateFromByteArray shall succeed and return a non-NULL handle. ]*/
-    /*Tests_SRS_MESSAGE_02_026: [ A MAP_HANDLE shall be created. ]*/
-    /*Tests_SRS_MESSAGE_02_028: [ A structure of type MESSAGE_CONFIG shall be populated with the MAP_HANDLE previously constructed and the message content ]*/
-    /*Tests_SRS_MESSAGE_02_029: [ A MESSAGE_HANDLE shall be constructed from the MESSAGE_CONFIG. ]*/
+    /*Tests_SRS_MESSAGE_17_019: [ Message_CreateFromByteArray shall copy the message content into the message the same way Message_Create does. ]*/
     TEST_FUNCTION(Message_CreateFromByteArray_notFail____minimalMessage)
     {
 
         ///arrange
 
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
         EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
             .IgnoreAllCalls();
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(notFail____minimalMessage + 14, 0));
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
         MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail____minimalMessage, sizeof(notFail____minimalMessage));
@@ -1245,24 +1951,15 @@ BEGIN_TEST_SUITE(gwmessage_ut)
     }
 
     /*Tests_SRS_MESSAGE_02_031: [ Otherwise Message_CreateFromByteArray shall succeed and return a non-NULL handle. ]*/
-    /*Tests_SRS_MESSAGE_02_027: [ All the properties of the byte array shall be added to the MAP_HANDLE. ]*/
+    /*Tests_SRS_MESSAGE_17_018: [ Message_CreateFromByteArray shall not decode the properties; it shall copy the serialized properties into the message together with an index of where each property starts. ]*/
     TEST_FUNCTION(Message_CreateFromByteArray_notFail__1Property_0bytes)
     {
 
         ///arrange
 
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "3", "3"))
-            .SetReturn(MAP_OK);
 
         EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
             .IgnoreAllCalls();
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 0))
-            .IgnoreArgument_source();
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
         MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__1Property_0bytes, sizeof(notFail__1Property_0bytes));
@@ -1281,20 +1978,9 @@ BEGIN_TEST_SUITE(gwmessage_ut)
 
         ///arrange
 
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "3", "3"))
-            .SetReturn(MAP_OK);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "ab", "a"))
-            .SetReturn(MAP_OK);
 
         EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
             .IgnoreAllCalls();
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 0))
-            .IgnoreArgument_source();
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
         MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__2Property_0bytes, sizeof(notFail__2Property_0bytes));
@@ -1313,16 +1999,9 @@ BEGIN_TEST_SUITE(gwmessage_ut)
 
         ///arrange
 
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
 
         EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
             .IgnoreAllCalls();
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 1))
-            .IgnoreArgument_source();
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
         MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__0Property_1bytes, sizeof(notFail__0Property_1bytes));
@@ -1342,23 +2021,17 @@ BEGIN_TEST_SUITE(gwmessage_ut)
 
         ///arrange
 
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "Azure IoT Gateway is", "awesome"));
 
         EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
             .IgnoreAllCalls();
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 1))
-            .ValidateArgumentBuffer(1, "3", 1);
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
         MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__1Property_1bytes, sizeof(notFail__1Property_1bytes));
 
         ///assert
         ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(size_t, 1, Message_GetContent(handle)->size);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(Message_GetContent(handle)->buffer, "3", 1));
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
@@ -1372,24 +2045,17 @@ BEGIN_TEST_SUITE(gwmessage_ut)
 
         ///arrange
 
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "Azure IoT Gateway is", "awesome"));
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "BleedingEdge", "rocks"));
 
         EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
             .IgnoreAllCalls();
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 1))
-            .ValidateArgumentBuffer(1, "3", 1);
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
         MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__2Property_1bytes, sizeof(notFail__2Property_1bytes));
 
         ///assert
         ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(size_t, 1, Message_GetContent(handle)->size);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(Message_GetContent(handle)->buffer, "3", 1));
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
@@ -1402,22 +2068,17 @@ BEGIN_TEST_SUITE(gwmessage_ut)
 
         ///arrange
 
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
 
         EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
             .IgnoreAllCalls();
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 2))
-            .ValidateArgumentBuffer(1, "34", 2);
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
         MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__0Property_2bytes, sizeof(notFail__0Property_2bytes));
 
         ///assert
         ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(size_t, 2, Message_GetContent(handle)->size);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(Message_GetContent(handle)->buffer, "34", 2));
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
@@ -1430,22 +2091,16 @@ BEGIN_TEST_SUITE(gwmessage_ut)
 
         ///arrange
 
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "Azure IoT Gateway is", "awesome"));
         EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
             .IgnoreAllCalls();
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 2))
-            .ValidateArgumentBuffer(1, "34", 2);
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
         MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__1Property_2bytes, sizeof(notFail__1Property_2bytes));
 
         ///assert
         ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(size_t, 2, Message_GetContent(handle)->size);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(Message_GetContent(handle)->buffer, "34", 2));
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
@@ -1458,23 +2113,16 @@ BEGIN_TEST_SUITE(gwmessage_ut)
 
         ///arrange
 
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "BleedingEdge", "rocks"));
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "Azure IoT Gateway is", "awesome"));
         EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
             .IgnoreAllCalls();
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 2))
-            .ValidateArgumentBuffer(1, "34", 2);
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
         MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes));
 
         ///assert
         ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(size_t, 2, Message_GetContent(handle)->size);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(Message_GetContent(handle)->buffer, "34", 2));
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
@@ -1533,11 +2181,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
     TEST_FUNCTION(Message_CreateFromByteArray_with_1_property_when_1st_property_doesnt_end_fails)
     {
         ///arrange
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
 
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
         MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_firstPropertyNameTooBig, sizeof(fail_firstPropertyNameTooBig));
@@ -1553,11 +2197,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
     TEST_FUNCTION(Message_CreateFromByteArray_with_1_property_when_1st_property_value_doesnt_start_fails)
     {
         ///arrange
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
 
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
         MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_firstPropertyValueDoesNotExist, sizeof(fail_firstPropertyValueDoesNotExist));
@@ -1573,11 +2213,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
     TEST_FUNCTION(Message_CreateFromByteArray_with_1_property_when_1st_property_value_doesnt_end_fails)
     {
         ///arrange
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
 
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
         MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_firstPropertyValueDoesNotEnd, sizeof(fail_firstPropertyValueDoesNotEnd));
@@ -1593,11 +2229,6 @@ BEGIN_TEST_SUITE(gwmessage_ut)
     TEST_FUNCTION(Message_CreateFromByteArray_with_1_byte_of_content_size_fails)
     {
         ///arrange
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "333", "333"));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
         MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_whenThereIsOnly1ByteOfcontentSize, sizeof(fail_whenThereIsOnly1ByteOfcontentSize));
@@ -1624,11 +2255,6 @@ BEGIN_TEST_SUITE(gwmessage_ut)
             0x00, 0x00              /*not enough bytes for contentSize*/
         };
 
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "333", "333"));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
         MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_whenThereIsOnly2ByteOfcontentSize, sizeof(fail_whenThereIsOnly2ByteOfcontentSize));
@@ -1655,11 +2281,6 @@ BEGIN_TEST_SUITE(gwmessage_ut)
             0x00, 0x00, 0x00        /*not enough bytes for contentSize*/
         };
 
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "333", "333"));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
         MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_whenThereIsOnly3ByteOfcontentSize, sizeof(fail_whenThereIsOnly3ByteOfcontentSize));
@@ -1686,11 +2307,6 @@ BEGIN_TEST_SUITE(gwmessage_ut)
             0x00, 0x00, 0x00, 0x01  /*no further content*/
         };
 
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "333", "333"));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
         MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_whenThereIsNotEnoughContent, sizeof(fail_whenThereIsNotEnoughContent));
@@ -1718,11 +2334,6 @@ BEGIN_TEST_SUITE(gwmessage_ut)
             '3', '3'
         };
 
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "333", "333"));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
         MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_whenThereIsTooMuchContent, sizeof(fail_whenThereIsTooMuchContent));
@@ -1735,21 +2346,11 @@ BEGIN_TEST_SUITE(gwmessage_ut)
     }
 
     /*Tests_SRS_MESSAGE_02_030: [ If any of the above steps fails, then Message_CreateFromByteArray shall fail and return NULL. ]*/
-    TEST_FUNCTION(Message_CreateFromByteArray_fails_when_Map_Create_fails)
+    TEST_FUNCTION(Message_CreateFromByteArray_fails_when_malloc_fails)
     {
         ///arrange
-
-        const unsigned char notFail____minimalMessage[] =
-        {
-            0xA1, 0x60,             /*header*/
-            0x00, 0x00, 0x00, 14,   /*size of this array*/
-            0x00, 0x00, 0x00, 0x00, /*zero properties*/
-            0x00, 0x00, 0x00, 0x00  /*zero message content size*/
-        };
-
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(NULL);
+        whenShallmalloc_fail = 1;
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*this is the message*/
 
         ///act
         MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail____minimalMessage, sizeof(notFail____minimalMessage));
@@ -1774,10 +2375,6 @@ BEGIN_TEST_SUITE(gwmessage_ut)
             0x00, 0x00, 0x00, 0x00  /*zero message content size*/
         };
 
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
         MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail____minimalMessage, sizeof(notFail____minimalMessage));
@@ -1802,11 +2399,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
             0x00, 0x00, 0x00, 0x00  /*zero message content size*/
         };
 
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
 
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
         MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail____minimalMessage, sizeof(notFail____minimalMessage));
@@ -1818,29 +2411,30 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         ///cleanup
     }
 
-    /*Tests_SRS_MESSAGE_02_030: [ If any of the above steps fails, then Message_CreateFromByteArray shall fail and return NULL. ]*/
-    TEST_FUNCTION(Message_CreateFromByteArray_fails_when_Map_Add_fails)
+    /*Tests_SRS_MESSAGE_17_060: [ If two properties have the same name then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_fails_when_a_property_name_repeats)
     {
-
         ///arrange
 
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "3", "3"))
-            .SetReturn(MAP_ERROR);
-
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+        const unsigned char fail_duplicateProperty[] =
+        {
+            0xA1, 0x60,             /*header*/
+            0x00, 0x00, 0x00, 26,   /*size of this array*/
+            0x00, 0x00, 0x00, 0x03, /*three properties*/
+            'a', '\0', '1', '\0',
+            'b', '\0', '2', '\0',
+            'a', '\0', '3', '\0',
+            0x00, 0x00, 0x00, 0x00  /*zero message content size*/
+        };
 
         ///act
-        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__1Property_0bytes, sizeof(notFail__1Property_0bytes));
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_duplicateProperty, sizeof(fail_duplicateProperty));
 
         ///assert
         ASSERT_IS_NULL(handle);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
-        Message_Destroy(handle);
     }
 
     /*Tests_SRS_MESSAGE_02_032: [ If messageHandle is NULL then Message_ToByteArray shall fail and return NULL. ]*/
@@ -1899,30 +2493,11 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         int32_t size = 0;
         unsigned char * buf = NULL;
 
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
         EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
             .IgnoreAllCalls();
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 0))
-            .IgnoreArgument_source();
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail____minimalMessage, sizeof(notFail____minimalMessage));
 
-        size_t zero = 0;
-        const CONSTBUFFER bufferContent = { NULL, 0 };
-
-        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument_handle()
-            .IgnoreArgument_keys()
-            .IgnoreArgument_values()
-            .CopyOutArgumentBuffer(4, &zero, sizeof(zero));
-        STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
-            .IgnoreArgument_constbufferHandle()
-            .SetReturn(&bufferContent);
-
 
         ///act
         int32_t nbytes = Message_ToByteArray(messageHandle, buf, size);
@@ -1947,30 +2522,11 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         ASSERT_IS_NOT_NULL(buf);
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
         EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
             .IgnoreAllCalls();
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 0))
-            .IgnoreArgument_source();
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail____minimalMessage, sizeof(notFail____minimalMessage));
 
-        size_t zero = 0;
-        const CONSTBUFFER bufferContent = { NULL, 0 };
-
-        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument_handle()
-            .IgnoreArgument_keys()
-            .IgnoreArgument_values()
-            .CopyOutArgumentBuffer(4, &zero, sizeof(zero));
-        STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
-            .IgnoreArgument_constbufferHandle()
-            .SetReturn(&bufferContent);
-
 
         ///act
         int32_t nbytes = Message_ToByteArray(messageHandle, buf, size);
@@ -1997,39 +2553,11 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         ASSERT_IS_NOT_NULL(buf);
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
         EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
             .IgnoreAllCalls();
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 2))
-            .IgnoreArgument_source();
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes));
 
-        size_t two = 2;
-        const char* keys[] = { "BleedingEdge", "Azure IoT Gateway is" };
-        const char* values[] = { "rocks", "awesome" };
-        const char* const* *pkeys = (const char* const* *)&keys;
-        const char* const* *pvalues = (const char* const* *)&values;
-
-        const CONSTBUFFER bufferContent = { (const unsigned char*)"34", 2 };
-
-        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument_handle()
-            .CopyOutArgumentBuffer(2, &pkeys, sizeof(char**))
-            .CopyOutArgumentBuffer(3, &pvalues, sizeof(char**))
-            .CopyOutArgumentBuffer(4, &two, sizeof(two));
-        STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
-            .IgnoreArgument_constbufferHandle()
-            .SetReturn(&bufferContent);
-
         ///act
         int32_t nbytes = Message_ToByteArray(messageHandle, buf, size);
 
@@ -2044,45 +2572,21 @@ BEGIN_TEST_SUITE(gwmessage_ut)
     }
 
 
-    /*Tests_SRS_MESSAGE_02_035: [ If any of the above steps fails then Message_ToByteArray shall fail and return NULL. ]*/
-    TEST_FUNCTION(Message_ToByteArray_with_properties_and_content_fails_when_ConstMap_GetInternals_fails)
+    /*Tests_SRS_MESSAGE_17_017: [ If buf is not NULL and size is less than the needed memory size, Message_ToByteArray shall return -1; ]*/
+    TEST_FUNCTION(Message_ToByteArray_with_properties_and_content_fails_size_too_small)
     {
 
         ///arrange
-        int32_t size = sizeof(notFail__2Property_2bytes);
+        int32_t size = sizeof(notFail__2Property_2bytes)-1;
         unsigned char * buf = (unsigned char *)malloc(sizeof(notFail__2Property_2bytes));
         ASSERT_IS_NOT_NULL(buf);
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
         EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
             .IgnoreAllCalls();
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 2))
-            .IgnoreArgument_source();
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes));
 
-        size_t two = 2;
-        const char* keys[] = { "BleedingEdge", "Azure IoT Gateway is" };
-        const char* values[] = { "rocks", "awesome" };
-        const char* const* *pkeys = (const char* const* *)&keys;
-        const char* const* *pvalues = (const char* const* *)&values;
-
-        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument_handle()
-            .CopyOutArgumentBuffer(2, &pkeys, sizeof(char**))
-            .CopyOutArgumentBuffer(3, &pvalues, sizeof(char**))
-            .CopyOutArgumentBuffer(4, &two, sizeof(two))
-            .SetReturn(CONSTMAP_ERROR);
-
         ///act
         int32_t nbytes = Message_ToByteArray(messageHandle, buf, size);
 
@@ -2095,59 +2599,109 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         Message_Destroy(messageHandle);
     }
 
-    /*Tests_SRS_MESSAGE_17_017: [ If buf is not NULL and size is less than the needed memory size, Message_ToByteArray shall return -1; ]*/
-    TEST_FUNCTION(Message_ToByteArray_with_properties_and_content_fails_size_too_small)
+    /*Tests_SRS_MESSAGE_17_054: [ If message is NULL then Message_GetSerialized shall return NULL. ]*/
+    TEST_FUNCTION(Message_GetSerialized_with_NULL_message_returns_NULL)
+    {
+        ///arrange
+
+        ///act
+        const CONSTBUFFER* serialized = Message_GetSerialized(NULL);
+
+        ///assert
+        ASSERT_IS_NULL(serialized);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_055: [ The first call to Message_GetSerialized shall serialize the message with Message_ToByteArray into a single allocation that is kept by the message. ]*/
+    /*Tests_SRS_MESSAGE_17_058: [ Otherwise Message_GetSerialized shall return the serialized message, byte for byte what Message_ToByteArray writes, without copying it. ]*/
+    TEST_FUNCTION(Message_GetSerialized_happy_path)
     {
+        ///arrange
+        MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes));
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        const CONSTBUFFER* serialized = Message_GetSerialized(messageHandle);
 
+        ///assert
+        ASSERT_IS_NOT_NULL(serialized);
+        ASSERT_ARE_EQUAL(size_t, sizeof(notFail__2Property_2bytes), serialized->size);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(serialized->buffer, notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes)));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(messageHandle);
+    }
+
+    /*Tests_SRS_MESSAGE_17_055: [ The first call to Message_GetSerialized shall serialize the message with Message_ToByteArray into a single allocation that is kept by the message. ]*/
+    TEST_FUNCTION(Message_GetSerialized_serializes_only_once)
+    {
         ///arrange
-        int32_t size = sizeof(notFail__2Property_2bytes)-1;
-        unsigned char * buf = (unsigned char *)malloc(sizeof(notFail__2Property_2bytes));
-        ASSERT_IS_NOT_NULL(buf);
+        MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes));
+        MESSAGE_HANDLE clone = Message_Clone(messageHandle);
+        const CONSTBUFFER* first = Message_GetSerialized(messageHandle);
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-            .IgnoreAllCalls();
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 2))
-            .IgnoreArgument_source();
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+        ///act
+        const CONSTBUFFER* second = Message_GetSerialized(clone);
+
+        ///assert
+        ASSERT_ARE_EQUAL(void_ptr, first, second);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
+        ///cleanup
+        Message_Destroy(clone);
+        Message_Destroy(messageHandle);
+    }
+
+    /*Tests_SRS_MESSAGE_17_056: [ If serializing the message fails, Message_GetSerialized shall return NULL. ]*/
+    TEST_FUNCTION(Message_GetSerialized_fails_when_malloc_fails)
+    {
+        ///arrange
         MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes));
+        umock_c_reset_all_calls();
 
-        size_t two = 2;
-        const char* keys[] = { "BleedingEdge", "Azure IoT Gateway is" };
-        const char* values[] = { "rocks", "awesome" };
-        const char* const* *pkeys = (const char* const* *)&keys;
-        const char* const* *pvalues = (const char* const* *)&values;
-
-        const CONSTBUFFER bufferContent = { (const unsigned char*)"34", 2 };
-
-        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument_handle()
-            .CopyOutArgumentBuffer(2, &pkeys, sizeof(char**))
-            .CopyOutArgumentBuffer(3, &pvalues, sizeof(char**))
-            .CopyOutArgumentBuffer(4, &two, sizeof(two));
-        STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
-            .IgnoreArgument_constbufferHandle()
-            .SetReturn(&bufferContent);
+        whenShallmalloc_fail = currentmalloc_call + 1;
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
 
         ///act
-        int32_t nbytes = Message_ToByteArray(messageHandle, buf, size);
+        const CONSTBUFFER* serialized = Message_GetSerialized(messageHandle);
 
         ///assert
-        ASSERT_IS_TRUE(nbytes < 0);
+        ASSERT_IS_NULL(serialized);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
-        free((void*)buf);
+        whenShallmalloc_fail = 0;
+        Message_Destroy(messageHandle);
+    }
+
+    /*Tests_SRS_MESSAGE_17_059: [ If the ref count is zero, Message_Destroy shall free the serialized message, if it exists. ]*/
+    TEST_FUNCTION(Message_Destroy_frees_the_serialized_message)
+    {
+        ///arrange
+        MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes));
+        (void)Message_GetSerialized(messageHandle);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is the serialized message*/
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is the handle*/
+            .IgnoreArgument(1);
+
+        ///act
         Message_Destroy(messageHandle);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
     }
 
 END_TEST_SUITE(gwmessage_ut)
@@ -0,0 +1,282 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+
+#include "message_batch.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+#ifdef _MSC_VER
+#pragma warning(disable:4505)
+#endif
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+static const unsigned char first_message[] = { 0xA1, 0x60, 0x01, 0x02, 0x03 };
+static const unsigned char second_message[] = { 0xA1, 0x60, 0x04 };
+
+static int32_t write_test_batch(unsigned char* batch)
+{
+    int32_t size = MessageBatch_WriteHeader(batch, 2);
+    size += MessageBatch_WriteEntryHeader(batch + size, sizeof(first_message));
+    memcpy(batch + size, first_message, sizeof(first_message));
+    size += sizeof(first_message);
+    size += MessageBatch_WriteEntryHeader(batch + size, sizeof(second_message));
+    memcpy(batch + size, second_message, sizeof(second_message));
+    size += sizeof(second_message);
+    return size;
+}
+
+BEGIN_TEST_SUITE(message_batch_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    TEST_MUTEX_DESTROY(g_testByTest);
+    umock_c_deinit();
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest) != 0)
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_001: [ If destination is NULL, MessageBatch_WriteHeader shall return 0. ]*/
+TEST_FUNCTION(MessageBatch_WriteHeader_with_NULL_destination_fails)
+{
+    ///act
+    int32_t result = MessageBatch_WriteHeader(NULL, 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int32_t, 0, result);
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_002: [ MessageBatch_WriteHeader shall write the bytes 0xA1 0x6B followed by message_count in network byte order. ]*/
+/*Tests_SRS_MESSAGE_BATCH_17_003: [ MessageBatch_WriteHeader shall return MESSAGE_BATCH_HEADER_SIZE. ]*/
+TEST_FUNCTION(MessageBatch_WriteHeader_succeeds)
+{
+    ///arrange
+    const unsigned char expected[MESSAGE_BATCH_HEADER_SIZE] = { 0xA1, 0x6B, 0x00, 0x00, 0x01, 0x02 };
+    unsigned char header[MESSAGE_BATCH_HEADER_SIZE];
+
+    ///act
+    int32_t result = MessageBatch_WriteHeader(header, 0x102);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int32_t, MESSAGE_BATCH_HEADER_SIZE, result);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(expected, header, sizeof(expected)));
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_004: [ If destination is NULL or message_size is negative, MessageBatch_WriteEntryHeader shall return 0. ]*/
+TEST_FUNCTION(MessageBatch_WriteEntryHeader_with_bad_arguments_fails)
+{
+    ///arrange
+    unsigned char entry[MESSAGE_BATCH_ENTRY_HEADER_SIZE];
+
+    ///act
+    int32_t result1 = MessageBatch_WriteEntryHeader(NULL, 1);
+    int32_t result2 = MessageBatch_WriteEntryHeader(entry, -1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int32_t, 0, result1);
+    ASSERT_ARE_EQUAL(int32_t, 0, result2);
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_005: [ MessageBatch_WriteEntryHeader shall write message_size in network byte order and return MESSAGE_BATCH_ENTRY_HEADER_SIZE. ]*/
+TEST_FUNCTION(MessageBatch_WriteEntryHeader_succeeds)
+{
+    ///arrange
+    const unsigned char expected[MESSAGE_BATCH_ENTRY_HEADER_SIZE] = { 0x01, 0x02, 0x03, 0x04 };
+    unsigned char entry[MESSAGE_BATCH_ENTRY_HEADER_SIZE];
+
+    ///act
+    int32_t result = MessageBatch_WriteEntryHeader(entry, 0x01020304);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int32_t, MESSAGE_BATCH_ENTRY_HEADER_SIZE, result);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(expected, entry, sizeof(expected)));
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_006: [ MessageBatch_IsBatch shall return true if source holds at least MESSAGE_BATCH_HEADER_SIZE bytes starting with 0xA1 0x6B, and false otherwise. ]*/
+TEST_FUNCTION(MessageBatch_IsBatch_tells_batches_from_messages)
+{
+    ///arrange
+    unsigned char batch[MESSAGE_BATCH_HEADER_SIZE];
+    (void)MessageBatch_WriteHeader(batch, 0);
+
+    ///act
+    bool is_batch = MessageBatch_IsBatch(batch, sizeof(batch));
+    bool is_short_batch = MessageBatch_IsBatch(batch, sizeof(batch) - 1);
+    bool is_message = MessageBatch_IsBatch(first_message, sizeof(first_message));
+    bool is_null = MessageBatch_IsBatch(NULL, sizeof(batch));
+
+    ///assert
+    ASSERT_IS_TRUE(is_batch);
+    ASSERT_IS_FALSE(is_short_batch);
+    ASSERT_IS_FALSE(is_message);
+    ASSERT_IS_FALSE(is_null);
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_007: [ If position or message is NULL, or source is not a batch, MessageBatch_GetNext shall return a negative value. ]*/
+TEST_FUNCTION(MessageBatch_GetNext_with_bad_arguments_fails)
+{
+    ///arrange
+    unsigned char batch[64];
+    int32_t size = write_test_batch(batch);
+    int32_t position = 0;
+    const unsigned char* message;
+
+    ///act
+    int32_t result1 = MessageBatch_GetNext(batch, size, NULL, &message);
+    int32_t result2 = MessageBatch_GetNext(batch, size, &position, NULL);
+    int32_t result3 = MessageBatch_GetNext(first_message, sizeof(first_message), &position, &message);
+
+    ///assert
+    ASSERT_IS_TRUE(result1 < 0);
+    ASSERT_IS_TRUE(result2 < 0);
+    ASSERT_IS_TRUE(result3 < 0);
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_008: [ If *position is 0, MessageBatch_GetNext shall start with the first message, right after the batch header. ]*/
+/*Tests_SRS_MESSAGE_BATCH_17_010: [ If *position is at the end of the batch, MessageBatch_GetNext shall return 0. ]*/
+/*Tests_SRS_MESSAGE_BATCH_17_012: [ MessageBatch_GetNext shall set *message to the serialized message, advance *position past it and return its size. ]*/
+TEST_FUNCTION(MessageBatch_GetNext_walks_the_batch)
+{
+    ///arrange
+    unsigned char batch[64];
+    int32_t size = write_test_batch(batch);
+    int32_t position = 0;
+    const unsigned char* message1;
+    const unsigned char* message2;
+    const unsigned char* message3 = NULL;
+
+    ///act
+    int32_t result1 = MessageBatch_GetNext(batch, size, &position, &message1);
+    int32_t result2 = MessageBatch_GetNext(batch, size, &position, &message2);
+    int32_t result3 = MessageBatch_GetNext(batch, size, &position, &message3);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int32_t, sizeof(first_message), result1);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(first_message, message1, sizeof(first_message)));
+    ASSERT_ARE_EQUAL(int32_t, sizeof(second_message), result2);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(second_message, message2, sizeof(second_message)));
+    ASSERT_ARE_EQUAL(int32_t, 0, result3);
+    ASSERT_IS_NULL(message3);
+    ASSERT_ARE_EQUAL(int32_t, size, position);
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_009: [ If *position is outside the batch, MessageBatch_GetNext shall return a negative value. ]*/
+TEST_FUNCTION(MessageBatch_GetNext_with_position_outside_batch_fails)
+{
+    ///arrange
+    unsigned char batch[64];
+    int32_t size = write_test_batch(batch);
+    int32_t before = 1;
+    int32_t after = size + 1;
+    const unsigned char* message;
+
+    ///act
+    int32_t result1 = MessageBatch_GetNext(batch, size, &before, &message);
+    int32_t result2 = MessageBatch_GetNext(batch, size, &after, &message);
+
+    ///assert
+    ASSERT_IS_TRUE(result1 < 0);
+    ASSERT_IS_TRUE(result2 < 0);
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_011: [ If the rest of the batch is too short for the entry header or for the message it announces, MessageBatch_GetNext shall return a negative value. ]*/
+TEST_FUNCTION(MessageBatch_GetNext_with_truncated_batch_fails)
+{
+    ///arrange
+    unsigned char batch[64];
+    int32_t size = write_test_batch(batch);
+    int32_t position1 = 0;
+    int32_t position2 = 0;
+    const unsigned char* message;
+
+    ///act
+    int32_t result1 = MessageBatch_GetNext(batch, MESSAGE_BATCH_HEADER_SIZE + 2, &position1, &message);
+    int32_t result2 = MessageBatch_GetNext(batch, size - (int32_t)sizeof(second_message) - MESSAGE_BATCH_ENTRY_HEADER_SIZE - 1, &position2, &message);
+
+    ///assert
+    ASSERT_IS_TRUE(result1 < 0);
+    ASSERT_IS_TRUE(result2 < 0);
+    ASSERT_ARE_EQUAL(int32_t, 0, position2);
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_013: [ If *position is 0, MessageBatch_GetNext shall return a negative value, before it returns any message, if the messages do not end exactly at the end of the batch or are not as many as the batch header says. ]*/
+TEST_FUNCTION(MessageBatch_GetNext_with_wrong_message_count_fails)
+{
+    ///arrange
+    unsigned char batch[64];
+    int32_t size = write_test_batch(batch);
+    int32_t position1 = 0;
+    int32_t position2 = 0;
+    const unsigned char* message = NULL;
+    int32_t result1;
+    int32_t result2;
+
+    ///act
+    (void)MessageBatch_WriteHeader(batch, 3);
+    result1 = MessageBatch_GetNext(batch, size, &position1, &message);
+    (void)MessageBatch_WriteHeader(batch, 1);
+    result2 = MessageBatch_GetNext(batch, size, &position2, &message);
+
+    ///assert
+    ASSERT_IS_TRUE(result1 < 0);
+    ASSERT_IS_TRUE(result2 < 0);
+    ASSERT_ARE_EQUAL(int32_t, 0, position1);
+    ASSERT_ARE_EQUAL(int32_t, 0, position2);
+    ASSERT_IS_NULL(message);
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_013: [ If *position is 0, MessageBatch_GetNext shall return a negative value, before it returns any message, if the messages do not end exactly at the end of the batch or are not as many as the batch header says. ]*/
+TEST_FUNCTION(MessageBatch_GetNext_with_trailing_bytes_fails)
+{
+    ///arrange
+    unsigned char batch[64];
+    int32_t size = write_test_batch(batch);
+    int32_t position = 0;
+    const unsigned char* message = NULL;
+    int32_t result;
+
+    ///act
+    batch[size] = 0;
+    result = MessageBatch_GetNext(batch, size + 1, &position, &message);
+
+    ///assert
+    ASSERT_IS_TRUE(result < 0);
+    ASSERT_ARE_EQUAL(int32_t, 0, position);
+    ASSERT_IS_NULL(message);
+}
+
+END_TEST_SUITE(message_batch_ut)
@@ -29,6 +29,23 @@ void* my_gballoc_malloc(size_t size)
     return result;
 }
 
+static bool realloc_will_fail = false;
+
+void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    void* result;
+    if (realloc_will_fail == true)
+    {
+        result = NULL;
+    }
+    else
+    {
+        result = realloc(ptr, size);
+    }
+
+    return result;
+}
+
 void my_gballoc_free(void* ptr)
 {
     free(ptr);
@@ -46,77 +63,10 @@ void my_gballoc_free(void* ptr)
 #define GATEWAY_EXPORT
 
 #include "message.h"
-#include "azure_c_shared_utility/doublylinkedlist.h"
 #include "azure_c_shared_utility/gballoc.h"
 
 #undef ENABLE_MOCKS
 
-// Well, this was the easiest way to "mock" DList.
-void real_DList_InitializeListHead(PDLIST_ENTRY ListHead)
-{
-	ListHead->Flink = ListHead->Blink = ListHead;
-	return;
-}
-
-int real_DList_IsListEmpty(const PDLIST_ENTRY ListHead)
-{
-	return (ListHead->Flink == ListHead);
-}
-
-int real_DList_RemoveEntryList(PDLIST_ENTRY Entry)
-{
-	PDLIST_ENTRY Blink;
-	PDLIST_ENTRY Flink;
-
-	Flink = Entry->Flink;
-	Blink = Entry->Blink;
-	Blink->Flink = Flink;
-	Flink->Blink = Blink;
-	return (Flink == Blink);
-}
-
-PDLIST_ENTRY real_DList_RemoveHeadList(PDLIST_ENTRY ListHead)
-{
-	PDLIST_ENTRY Flink;
-	PDLIST_ENTRY Entry;
-
-	Entry = ListHead->Flink;
-	Flink = Entry->Flink;
-	ListHead->Flink = Flink;
-	Flink->Blink = ListHead;
-	return Entry;
-}
-
-void real_DList_InsertTailList(PDLIST_ENTRY ListHead, PDLIST_ENTRY Entry)
-{
-	PDLIST_ENTRY Blink;
-	Blink = ListHead->Blink;
-	Entry->Flink = ListHead;
-	Entry->Blink = Blink;
-	Blink->Flink = Entry;
-	ListHead->Blink = Entry;
-	return;
-}
-
-
-void real_DList_AppendTailList(PDLIST_ENTRY ListHead,PDLIST_ENTRY ListToAppend)
-{
-	PDLIST_ENTRY ListEnd = ListHead->Blink;
-	ListHead->Blink->Flink = ListToAppend;
-	ListHead->Blink = ListToAppend->Blink;
-	ListToAppend->Blink->Flink = ListHead;
-	ListToAppend->Blink = ListEnd;
-	return;
-}
-
-void real_DList_InsertHeadList(PDLIST_ENTRY listHead, PDLIST_ENTRY entry)
-{
-	entry->Blink = listHead;
-	entry->Flink = listHead->Flink;
-	listHead->Flink->Blink = entry;
-	listHead->Flink = entry;
-}
-
 #include "message_queue.h"
 //=============================================================================
 //Globals
@@ -145,21 +95,11 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 
 
 	REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_HANDLE, void*);
-	REGISTER_UMOCK_ALIAS_TYPE(PDLIST_ENTRY, void *);
-	REGISTER_UMOCK_ALIAS_TYPE(const PDLIST_ENTRY, const void*);
 
 	// malloc/free hooks
 	REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+	REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
 	REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
-
-	//doubly linked list hooks
-	REGISTER_GLOBAL_MOCK_HOOK(DList_InitializeListHead, real_DList_InitializeListHead);
-	REGISTER_GLOBAL_MOCK_HOOK(DList_IsListEmpty, real_DList_IsListEmpty);
-	REGISTER_GLOBAL_MOCK_HOOK(DList_InsertTailList, real_DList_InsertTailList);
-	REGISTER_GLOBAL_MOCK_HOOK(DList_InsertHeadList, real_DList_InsertHeadList);
-	REGISTER_GLOBAL_MOCK_HOOK(DList_AppendTailList, real_DList_AppendTailList);
-	REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveEntryList, real_DList_RemoveEntryList);
-	REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveHeadList, real_DList_RemoveHeadList);
 }
 
 TEST_SUITE_CLEANUP(TestClassCleanup)
@@ -181,6 +121,7 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
 	malloc_will_fail = false;
 	malloc_fail_count = 0;
 	malloc_count = 0;
+	realloc_will_fail = false;
 }
 
 TEST_FUNCTION_CLEANUP(TestMethodCleanup)
@@ -194,8 +135,6 @@ TEST_FUNCTION(MESSAGE_QUEUE_create_success)
 	///arrange
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
 
 	///act
 	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
@@ -249,14 +188,8 @@ TEST_FUNCTION(MESSAGE_QUEUE_destroy_does_something_with_a_nonempty_queue)
 	MESSAGE_QUEUE_push(mq, mh);
 	umock_c_reset_all_calls();
 
-	STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Message_Destroy(mh));
-	STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
@@ -277,8 +210,6 @@ TEST_FUNCTION(MESSAGE_QUEUE_destroy_does_something_with_an_empty_queue)
 	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
 	umock_c_reset_all_calls();
 
-	STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 
@@ -318,12 +249,8 @@ TEST_FUNCTION(MESSAGE_QUEUE_push_success)
 	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
 	umock_c_reset_all_calls();
 
-	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(DList_AppendTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG))
+		.IgnoreArgument(2);
 
 	///act
 	int mp1 = MESSAGE_QUEUE_push(mq, element);
@@ -346,10 +273,9 @@ TEST_FUNCTION(MESSAGE_QUEUE_push_alloc_element_fails)
 	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
 	umock_c_reset_all_calls();
 
-	malloc_will_fail = true;
-	malloc_fail_count = malloc_count +1;
-	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-		.IgnoreArgument(1);
+	realloc_will_fail = true;
+	STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG))
+		.IgnoreArgument(2);
 
 	///act
 	int mp1 = MESSAGE_QUEUE_push(mq, element);
@@ -385,9 +311,6 @@ TEST_FUNCTION(MESSAGE_QUEUE_pop_returns_null_on_empty_queue)
 	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
 	umock_c_reset_all_calls();
 
-	STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-
 	///act
 	MESSAGE_HANDLE mh1 = MESSAGE_QUEUE_pop(mq);
 
@@ -409,13 +332,6 @@ TEST_FUNCTION(MESSAGE_QUEUE_pop_success)
 	MESSAGE_QUEUE_push(mq, mh);
 	umock_c_reset_all_calls();
 
-	STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-
 	///act
 	MESSAGE_HANDLE mh1 = MESSAGE_QUEUE_pop(mq);
 
@@ -448,8 +364,6 @@ TEST_FUNCTION(MESSAGE_QUEUE_is_empty_returns_true_with_empty_queue)
 	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
 	umock_c_reset_all_calls();
 
-	STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
 	///act
 	bool is_empty = MESSAGE_QUEUE_is_empty(mq);
 	///assert
@@ -469,8 +383,6 @@ TEST_FUNCTION(MESSAGE_QUEUE_is_empty_returns_true_with_non_empty_queue)
 	MESSAGE_QUEUE_push(mq, mh);
 	umock_c_reset_all_calls();
 
-	STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
 	///act
 	bool is_empty = MESSAGE_QUEUE_is_empty(mq);
 	///assert
@@ -507,14 +419,6 @@ TEST_FUNCTION(MESSAGE_QUEUE_front_returns_front_of_queue)
 	MESSAGE_QUEUE_push(mq, mh2);
 	umock_c_reset_all_calls();
 
-	STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(DList_InsertHeadList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreArgument(1)
-		.IgnoreArgument(2);
-
 	///act
 	MESSAGE_HANDLE mh1_front = MESSAGE_QUEUE_front(mq);
 
@@ -527,14 +431,6 @@ TEST_FUNCTION(MESSAGE_QUEUE_front_returns_front_of_queue)
 
 	umock_c_reset_all_calls();
 
-	STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(DList_InsertHeadList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreArgument(1)
-		.IgnoreArgument(2);
-
 	///act
 	MESSAGE_HANDLE mh2_front = MESSAGE_QUEUE_front(mq);
 
@@ -553,9 +449,6 @@ TEST_FUNCTION(MESSAGE_QUEUE_front_returns_null_empty_queue)
 	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
 	umock_c_reset_all_calls();
 
-	STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-
 	///act
 	MESSAGE_HANDLE front = MESSAGE_QUEUE_front(mq);
 
@@ -567,10 +460,185 @@ TEST_FUNCTION(MESSAGE_QUEUE_front_returns_null_empty_queue)
 	MESSAGE_QUEUE_destroy(mq);
 }
 
+/*Tests_SRS_MESSAGE_QUEUE_17_011: [ Messages shall be pushed into the queue in a first-in-first-out order. ]*/
+/*Tests_SRS_MESSAGE_QUEUE_17_014: [ MESSAGE_QUEUE_pop shall remove messages from the queue in a first-in-first-out order. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_keeps_order_when_growing_a_wrapped_queue)
+{
+	///arrange
+	size_t next_in = 1;
+	size_t next_out = 1;
+	size_t i;
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
+	for (i = 0; i < 16; i++)
+	{
+		ASSERT_ARE_EQUAL(int, 0, MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)next_in++));
+	}
+	for (i = 0; i < 10; i++)
+	{
+		ASSERT_IS_TRUE((MESSAGE_QUEUE_pop(mq) == (MESSAGE_HANDLE)next_out++));
+	}
+	umock_c_reset_all_calls();
+
+	///act
+	for (i = 0; i < 20; i++)
+	{
+		ASSERT_ARE_EQUAL(int, 0, MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)next_in++));
+	}
+
+	///assert
+	while (!MESSAGE_QUEUE_is_empty(mq))
+	{
+		ASSERT_IS_TRUE((MESSAGE_QUEUE_pop(mq) == (MESSAGE_HANDLE)next_out++));
+	}
+	ASSERT_ARE_EQUAL(size_t, next_in, next_out);
+
+	///ablutions
+	MESSAGE_QUEUE_destroy(mq);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_023: [ On a successful call, MESSAGE_QUEUE_create_bounded shall return a non-NULL, empty message queue holding at most capacity messages. ]*/
+/*Tests_SRS_MESSAGE_QUEUE_17_025: [ MESSAGE_QUEUE_create_bounded shall allocate room for capacity messages along with the queue. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_create_bounded_success)
+{
+	///arrange
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+
+	///act
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create_bounded(2);
+
+	///assert
+	ASSERT_IS_NOT_NULL(mq);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_IS_TRUE(MESSAGE_QUEUE_is_empty(mq));
+
+	///ablutions
+	MESSAGE_QUEUE_destroy(mq);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_024: [ MESSAGE_QUEUE_create_bounded shall return NULL if capacity is 0 or too large to allocate. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_create_bounded_fails_with_zero_capacity)
+{
+	///arrange
+	///act
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create_bounded(0);
+
+	///assert
+	ASSERT_IS_NULL(mq);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_026: [ On a failure, MESSAGE_QUEUE_create_bounded shall return NULL. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_create_bounded_fails_with_alloc_fail)
+{
+	///arrange
+	malloc_will_fail = true;
+	malloc_fail_count = 1;
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+
+	///act
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create_bounded(2);
+
+	///assert
+	ASSERT_IS_NULL(mq);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_027: [ MESSAGE_QUEUE_push shall return a non-zero value and leave the queue unchanged if a bounded queue is full. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_push_fails_on_a_full_bounded_queue)
+{
+	///arrange
+	MESSAGE_HANDLE mh1 = (MESSAGE_HANDLE)(0x42);
+	MESSAGE_HANDLE mh2 = (MESSAGE_HANDLE)(0x43);
+	MESSAGE_HANDLE mh3 = (MESSAGE_HANDLE)(0x44);
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create_bounded(2);
+	MESSAGE_QUEUE_push(mq, mh1);
+	MESSAGE_QUEUE_push(mq, mh2);
+	umock_c_reset_all_calls();
+
+	///act
+	int mp3 = MESSAGE_QUEUE_push(mq, mh3);
+
+	///assert
+	ASSERT_ARE_NOT_EQUAL(int, 0, mp3);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_IS_TRUE((MESSAGE_QUEUE_pop(mq) == mh1));
+	ASSERT_IS_TRUE((MESSAGE_QUEUE_pop(mq) == mh2));
+	ASSERT_IS_TRUE(MESSAGE_QUEUE_is_empty(mq));
+
+	///ablutions
+	MESSAGE_QUEUE_destroy(mq);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_006: [ MESSAGE_QUEUE_destroy shall free all allocated resources. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_destroy_frees_a_bounded_queue_once)
+{
+	///arrange
+	MESSAGE_HANDLE mh = (MESSAGE_HANDLE)(0x42);
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create_bounded(2);
+	MESSAGE_QUEUE_push(mq, mh);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Message_Destroy(mh));
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	///act
+	MESSAGE_QUEUE_destroy(mq);
+
+	///assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_028: [ MESSAGE_QUEUE_is_full shall return false if handle is NULL. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_is_full_returns_false_with_null)
+{
+	///arrange
+	///act
+	bool is_full = MESSAGE_QUEUE_is_full(NULL);
+	///assert
+	ASSERT_IS_FALSE(is_full);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	///ablutions
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_029: [ MESSAGE_QUEUE_is_full shall return true if the queue is bounded and holds capacity messages, false otherwise. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_is_full_returns_true_with_full_bounded_queue)
+{
+	///arrange
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create_bounded(1);
+	MESSAGE_QUEUE_HANDLE unbounded = MESSAGE_QUEUE_create();
+	MESSAGE_QUEUE_push(unbounded, (MESSAGE_HANDLE)(0x42));
+	umock_c_reset_all_calls();
+
+	///act
+	bool was_full = MESSAGE_QUEUE_is_full(mq);
+	MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)(0x43));
+	bool is_full = MESSAGE_QUEUE_is_full(mq);
+	bool unbounded_is_full = MESSAGE_QUEUE_is_full(unbounded);
+
+	///assert
+	ASSERT_IS_FALSE(was_full);
+	ASSERT_IS_TRUE(is_full);
+	ASSERT_IS_FALSE(unbounded_is_full);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+	(void)MESSAGE_QUEUE_pop(mq);
+	(void)MESSAGE_QUEUE_pop(unbounded);
+	MESSAGE_QUEUE_destroy(mq);
+	MESSAGE_QUEUE_destroy(unbounded);
+}
+
 ///arrange
 ///act
 ///assert
 ///ablutions
 END_TEST_SUITE(message_q_ut);
-
-
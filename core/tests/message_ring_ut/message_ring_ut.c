@@ -0,0 +1,550 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+
+#include "message_ring.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+#define TEST_RING_NAME "message_ring_ut"
+#define TEST_RING_SIZE 256
+
+static size_t currentmalloc_call;
+static size_t whenShallmalloc_fail;
+
+static void* my_gballoc_malloc(size_t size)
+{
+    void* result;
+    currentmalloc_call++;
+    if (whenShallmalloc_fail > 0)
+    {
+        if (currentmalloc_call == whenShallmalloc_fail)
+        {
+            result = NULL;
+        }
+        else
+        {
+            result = malloc(size);
+        }
+    }
+    else
+    {
+        result = malloc(size);
+    }
+    return result;
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#undef ENABLE_MOCKS
+
+#ifdef _MSC_VER
+#pragma warning(disable:4505)
+#endif
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+static MESSAGE_RING_HANDLE write_message(MESSAGE_RING_HANDLE ring, unsigned char fill, int32_t size)
+{
+    unsigned char* buffer = MessageRing_BeginWrite(ring, size, 0);
+    if (buffer != NULL)
+    {
+        memset(buffer, fill, size);
+        MessageRing_EndWrite(ring);
+    }
+    return (buffer == NULL) ? NULL : ring;
+}
+
+BEGIN_TEST_SUITE(message_ring_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, (LOCK_HANDLE)0x42);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Deinit, LOCK_OK);
+
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    TEST_MUTEX_DESTROY(g_testByTest);
+    umock_c_deinit();
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest) != 0)
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+
+    currentmalloc_call = 0;
+    whenShallmalloc_fail = 0;
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_MESSAGE_RING_17_001: [ If name is NULL, MessageRing_Create shall return NULL. ]*/
+TEST_FUNCTION(MessageRing_Create_with_NULL_name_fails)
+{
+    ///act
+    MESSAGE_RING_HANDLE ring = MessageRing_Create(NULL, TEST_RING_SIZE);
+
+    ///assert
+    ASSERT_IS_NULL(ring);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_MESSAGE_RING_17_027: [ If size rounded up to a multiple of 8 does not fit in 32 bits, MessageRing_Create shall return NULL. ]*/
+TEST_FUNCTION(MessageRing_Create_with_size_that_wraps_when_aligned_fails)
+{
+    ///act
+    MESSAGE_RING_HANDLE ring = MessageRing_Create(TEST_RING_NAME, UINT32_MAX);
+
+    ///assert
+    ASSERT_IS_NULL(ring);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_MESSAGE_RING_17_002: [ MessageRing_Create shall create a shared memory segment called '/' followed by name, replacing any segment of the same name, large enough for a ring header and size bytes rounded up to a multiple of 8, or MESSAGE_RING_DEFAULT_SIZE bytes if size is 0. ]*/
+/*Tests_SRS_MESSAGE_RING_17_003: [ MessageRing_Create shall initialize two process shared semaphores in the segment, one to wake the reader and one to wake the writer. ]*/
+/*Tests_SRS_MESSAGE_RING_17_006: [ MessageRing_Open shall map the shared memory segment created by MessageRing_Create for name. ]*/
+TEST_FUNCTION(MessageRing_Create_and_Open_succeed)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(strlen(TEST_RING_NAME) + 2));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(gballoc_malloc(strlen(TEST_RING_NAME) + 2));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    MESSAGE_RING_HANDLE writer = MessageRing_Create(TEST_RING_NAME, TEST_RING_SIZE);
+    MESSAGE_RING_HANDLE reader = MessageRing_Open(TEST_RING_NAME);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(writer);
+    ASSERT_IS_NOT_NULL(reader);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    MessageRing_Destroy(reader);
+    MessageRing_Destroy(writer);
+}
+
+/*Tests_SRS_MESSAGE_RING_17_004: [ If any step fails, MessageRing_Create shall release everything it acquired, remove the segment and return NULL. ]*/
+TEST_FUNCTION(MessageRing_Create_fails_when_malloc_fails)
+{
+    size_t i;
+    for (i = 1; i <= 2; i++)
+    {
+        ///arrange
+        currentmalloc_call = 0;
+        whenShallmalloc_fail = i;
+
+        ///act
+        MESSAGE_RING_HANDLE ring = MessageRing_Create(TEST_RING_NAME, TEST_RING_SIZE);
+
+        ///assert
+        ASSERT_IS_NULL(ring);
+    }
+
+    whenShallmalloc_fail = 0;
+    ASSERT_IS_NULL(MessageRing_Open(TEST_RING_NAME));
+}
+
+/*Tests_SRS_MESSAGE_RING_17_004: [ If any step fails, MessageRing_Create shall release everything it acquired, remove the segment and return NULL. ]*/
+TEST_FUNCTION(MessageRing_Create_fails_when_Lock_Init_fails)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(strlen(TEST_RING_NAME) + 2));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock_Init())
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    MESSAGE_RING_HANDLE ring = MessageRing_Create(TEST_RING_NAME, TEST_RING_SIZE);
+
+    ///assert
+    ASSERT_IS_NULL(ring);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_MESSAGE_RING_17_005: [ If name is NULL, MessageRing_Open shall return NULL. ]*/
+TEST_FUNCTION(MessageRing_Open_with_NULL_name_fails)
+{
+    ///act
+    MESSAGE_RING_HANDLE ring = MessageRing_Open(NULL);
+
+    ///assert
+    ASSERT_IS_NULL(ring);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_MESSAGE_RING_17_007: [ If the segment does not exist or does not hold a ring, MessageRing_Open shall return NULL. ]*/
+TEST_FUNCTION(MessageRing_Open_fails_when_there_is_no_ring)
+{
+    ///act
+    MESSAGE_RING_HANDLE ring = MessageRing_Open(TEST_RING_NAME "_missing");
+
+    ///assert
+    ASSERT_IS_NULL(ring);
+}
+
+/*Tests_SRS_MESSAGE_RING_17_008: [ If ring is NULL or size is negative, MessageRing_BeginWrite shall return NULL. ]*/
+TEST_FUNCTION(MessageRing_BeginWrite_with_invalid_args_fails)
+{
+    ///arrange
+    MESSAGE_RING_HANDLE ring = MessageRing_Create(TEST_RING_NAME, TEST_RING_SIZE);
+    umock_c_reset_all_calls();
+
+    ///act
+    unsigned char* r1 = MessageRing_BeginWrite(NULL, 8, 0);
+    unsigned char* r2 = MessageRing_BeginWrite(ring, -1, 0);
+
+    ///assert
+    ASSERT_IS_NULL(r1);
+    ASSERT_IS_NULL(r2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    MessageRing_Destroy(ring);
+}
+
+/*Tests_SRS_MESSAGE_RING_17_009: [ If a record of size bytes can never fit in the ring, MessageRing_BeginWrite shall return NULL. ]*/
+TEST_FUNCTION(MessageRing_BeginWrite_fails_when_message_is_larger_than_ring)
+{
+    ///arrange
+    MESSAGE_RING_HANDLE ring = MessageRing_Create(TEST_RING_NAME, TEST_RING_SIZE);
+    umock_c_reset_all_calls();
+
+    ///act
+    unsigned char* result = MessageRing_BeginWrite(ring, TEST_RING_SIZE, 0);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    MessageRing_Destroy(ring);
+}
+
+/*Tests_SRS_MESSAGE_RING_17_010: [ MessageRing_BeginWrite shall lock the ring for writing, and return NULL if this fails. ]*/
+TEST_FUNCTION(MessageRing_BeginWrite_fails_when_Lock_fails)
+{
+    ///arrange
+    MESSAGE_RING_HANDLE ring = MessageRing_Create(TEST_RING_NAME, TEST_RING_SIZE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(LOCK_ERROR);
+
+    ///act
+    unsigned char* result = MessageRing_BeginWrite(ring, 8, 0);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    MessageRing_Destroy(ring);
+}
+
+/*Tests_SRS_MESSAGE_RING_17_013: [ MessageRing_BeginWrite shall return a pointer to size bytes following the record's header. ]*/
+/*Tests_SRS_MESSAGE_RING_17_015: [ MessageRing_EndWrite shall mark any bytes skipped at the end of the ring as padding, write the record's size, publish the record, wake the reader if it is waiting and unlock the ring. ]*/
+/*Tests_SRS_MESSAGE_RING_17_020: [ MessageRing_BeginRead shall set *buffer to the oldest message and return its size. ]*/
+/*Tests_SRS_MESSAGE_RING_17_022: [ MessageRing_EndRead shall release the record and wake the writer if it is waiting. ]*/
+TEST_FUNCTION(MessageRing_message_written_is_read_back)
+{
+    ///arrange
+    MESSAGE_RING_HANDLE writer = MessageRing_Create(TEST_RING_NAME, TEST_RING_SIZE);
+    MESSAGE_RING_HANDLE reader = MessageRing_Open(TEST_RING_NAME);
+    const unsigned char* buffer = NULL;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    unsigned char* destination = MessageRing_BeginWrite(writer, 5, 0);
+    ASSERT_IS_NOT_NULL(destination);
+    memcpy(destination, "hello", 5);
+    MessageRing_EndWrite(writer);
+    int32_t size = MessageRing_BeginRead(reader, &buffer, 0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int32_t, 5, size);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(buffer, "hello", 5));
+    MessageRing_EndRead(reader);
+    ASSERT_ARE_EQUAL(int32_t, 0, MessageRing_BeginRead(reader, &buffer, 0));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    MessageRing_Destroy(reader);
+    MessageRing_Destroy(writer);
+}
+
+/*Tests_SRS_MESSAGE_RING_17_011: [ If the record does not fit between the end of the ring's data and the end of the ring, MessageRing_BeginWrite shall place it at the start of the ring. ]*/
+/*Tests_SRS_MESSAGE_RING_17_018: [ MessageRing_BeginRead shall skip padding. ]*/
+TEST_FUNCTION(MessageRing_messages_wrap_around_the_ring)
+{
+    ///arrange
+    MESSAGE_RING_HANDLE writer = MessageRing_Create(TEST_RING_NAME, TEST_RING_SIZE);
+    MESSAGE_RING_HANDLE reader = MessageRing_Open(TEST_RING_NAME);
+    int i;
+
+    ///act
+    for (i = 0; i < 100; i++)
+    {
+        const unsigned char* buffer = NULL;
+        int32_t expected_size = 10 + (i * 7) % 90;
+        ASSERT_IS_NOT_NULL(write_message(writer, (unsigned char)i, expected_size));
+
+        int32_t size = MessageRing_BeginRead(reader, &buffer, 0);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int32_t, expected_size, size);
+        ASSERT_ARE_EQUAL(uint8_t, (unsigned char)i, buffer[0]);
+        ASSERT_ARE_EQUAL(uint8_t, (unsigned char)i, buffer[size - 1]);
+        MessageRing_EndRead(reader);
+    }
+
+    ///cleanup
+    MessageRing_Destroy(reader);
+    MessageRing_Destroy(writer);
+}
+
+/*Tests_SRS_MESSAGE_RING_17_028: [ If a record runs past the end of the ring's data, MessageRing_BeginRead shall return a negative value. ]*/
+TEST_FUNCTION(MessageRing_BeginRead_fails_when_record_runs_past_the_end_of_the_ring)
+{
+    ///arrange
+    MESSAGE_RING_HANDLE writer = MessageRing_Create(TEST_RING_NAME, TEST_RING_SIZE);
+    MESSAGE_RING_HANDLE reader = MessageRing_Open(TEST_RING_NAME);
+    const unsigned char* buffer = NULL;
+    uint32_t corrupted_size = 100;
+
+    /*leave a 48 byte record at the end of the ring followed by one at the start, so more than
+     *corrupted_size bytes are published past the first record*/
+    ASSERT_IS_NOT_NULL(write_message(writer, 1, TEST_RING_SIZE - 56));
+    ASSERT_IS_TRUE(MessageRing_BeginRead(reader, &buffer, 0) > 0);
+    MessageRing_EndRead(reader);
+    unsigned char* last = MessageRing_BeginWrite(writer, 40, 0);
+    ASSERT_IS_NOT_NULL(last);
+    MessageRing_EndWrite(writer);
+    ASSERT_IS_NOT_NULL(write_message(writer, 3, 100));
+
+    /*the record's size lives in the 8 byte header in front of its data*/
+    memcpy(last - 8, &corrupted_size, sizeof(corrupted_size));
+    umock_c_reset_all_calls();
+
+    ///act
+    int32_t size = MessageRing_BeginRead(reader, &buffer, 0);
+
+    ///assert
+    ASSERT_IS_TRUE(size < 0);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    MessageRing_Destroy(reader);
+    MessageRing_Destroy(writer);
+}
+
+/*Tests_SRS_MESSAGE_RING_17_012: [ If there is not enough free space, MessageRing_BeginWrite shall wait up to timeout_ms milliseconds for the reader, and if there still is not, unlock the ring and return NULL. ]*/
+TEST_FUNCTION(MessageRing_BeginWrite_fails_when_ring_stays_full)
+{
+    ///arrange
+    MESSAGE_RING_HANDLE writer = MessageRing_Create(TEST_RING_NAME, TEST_RING_SIZE);
+    while (write_message(writer, 0, 56) != NULL)
+    {
+    }
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    unsigned char* result = MessageRing_BeginWrite(writer, 56, 10);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    MessageRing_Destroy(writer);
+}
+
+/*Tests_SRS_MESSAGE_RING_17_012: [ If there is not enough free space, MessageRing_BeginWrite shall wait up to timeout_ms milliseconds for the reader, and if there still is not, unlock the ring and return NULL. ]*/
+TEST_FUNCTION(MessageRing_BeginWrite_succeeds_once_reader_makes_room)
+{
+    ///arrange
+    MESSAGE_RING_HANDLE writer = MessageRing_Create(TEST_RING_NAME, TEST_RING_SIZE);
+    MESSAGE_RING_HANDLE reader = MessageRing_Open(TEST_RING_NAME);
+    const unsigned char* buffer = NULL;
+    while (write_message(writer, 0, 56) != NULL)
+    {
+    }
+    ASSERT_ARE_EQUAL(int32_t, 56, MessageRing_BeginRead(reader, &buffer, 0));
+    MessageRing_EndRead(reader);
+
+    ///act
+    unsigned char* result = MessageRing_BeginWrite(writer, 56, 0);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(result);
+
+    ///cleanup
+    MessageRing_EndWrite(writer);
+    MessageRing_Destroy(reader);
+    MessageRing_Destroy(writer);
+}
+
+/*Tests_SRS_MESSAGE_RING_17_014: [ If ring is NULL or no write is in progress, MessageRing_EndWrite shall do nothing. ]*/
+/*Tests_SRS_MESSAGE_RING_17_021: [ If ring is NULL or no read is in progress, MessageRing_EndRead shall do nothing. ]*/
+TEST_FUNCTION(MessageRing_End_without_Begin_does_nothing)
+{
+    ///arrange
+    MESSAGE_RING_HANDLE ring = MessageRing_Create(TEST_RING_NAME, TEST_RING_SIZE);
+    const unsigned char* buffer = NULL;
+    umock_c_reset_all_calls();
+
+    ///act
+    MessageRing_EndWrite(NULL);
+    MessageRing_EndWrite(ring);
+    MessageRing_EndRead(NULL);
+    MessageRing_EndRead(ring);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int32_t, 0, MessageRing_BeginRead(ring, &buffer, 0));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    MessageRing_Destroy(ring);
+}
+
+/*Tests_SRS_MESSAGE_RING_17_016: [ If ring or buffer is NULL, MessageRing_BeginRead shall return a negative value. ]*/
+TEST_FUNCTION(MessageRing_BeginRead_with_invalid_args_fails)
+{
+    ///arrange
+    MESSAGE_RING_HANDLE ring = MessageRing_Create(TEST_RING_NAME, TEST_RING_SIZE);
+    const unsigned char* buffer = NULL;
+    umock_c_reset_all_calls();
+
+    ///act
+    int32_t r1 = MessageRing_BeginRead(NULL, &buffer, 0);
+    int32_t r2 = MessageRing_BeginRead(ring, NULL, 0);
+
+    ///assert
+    ASSERT_IS_TRUE(r1 < 0);
+    ASSERT_IS_TRUE(r2 < 0);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    MessageRing_Destroy(ring);
+}
+
+/*Tests_SRS_MESSAGE_RING_17_017: [ If the ring is empty, MessageRing_BeginRead shall wait up to timeout_ms milliseconds for the writer, and return 0 if it stays empty. ]*/
+TEST_FUNCTION(MessageRing_BeginRead_returns_0_when_ring_stays_empty)
+{
+    ///arrange
+    MESSAGE_RING_HANDLE ring = MessageRing_Create(TEST_RING_NAME, TEST_RING_SIZE);
+    const unsigned char* buffer = NULL;
+    umock_c_reset_all_calls();
+
+    ///act
+    int32_t result = MessageRing_BeginRead(ring, &buffer, 10);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int32_t, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    MessageRing_Destroy(ring);
+}
+
+/*Tests_SRS_MESSAGE_RING_17_023: [ If ring is NULL, MessageRing_Destroy shall do nothing. ]*/
+TEST_FUNCTION(MessageRing_Destroy_with_NULL_does_nothing)
+{
+    ///act
+    MessageRing_Destroy(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_MESSAGE_RING_17_024: [ If the ring was created by MessageRing_Create, MessageRing_Destroy shall destroy its semaphores and remove its segment. ]*/
+/*Tests_SRS_MESSAGE_RING_17_025: [ MessageRing_Destroy shall unmap the ring and free its handle. ]*/
+TEST_FUNCTION(MessageRing_Destroy_removes_created_ring)
+{
+    ///arrange
+    MESSAGE_RING_HANDLE ring = MessageRing_Create(TEST_RING_NAME, TEST_RING_SIZE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    MessageRing_Destroy(ring);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(MessageRing_Open(TEST_RING_NAME));
+}
+
+END_TEST_SUITE(message_ring_ut)
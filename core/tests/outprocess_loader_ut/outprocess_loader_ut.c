@@ -620,6 +620,15 @@ TEST_FUNCTION(OutprocessModuleLoader_ParseEntrypointFromJson_returns_NULL_when_u
 	STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(OUTPROCESS_LOADER_ENTRYPOINT)));
 	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "timeout"))
 		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.count"));
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.bytes"));
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.linger"));
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "queue.capacity"));
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "queue.policy"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "ring.size"));
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "transport"))
+		.SetReturn(NULL);
 	STRICT_EXPECTED_CALL(STRING_construct(control_id))
 		.SetReturn(NULL);
 	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
@@ -660,6 +669,201 @@ TEST_FUNCTION(OutprocessModuleLoader_ParseEntrypointFromJson_succeeds)
 	STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(OUTPROCESS_LOADER_ENTRYPOINT)));
 	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "timeout"))
 		.SetReturn(2000);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.count"));
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.bytes"));
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.linger"));
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "queue.capacity"));
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "queue.policy"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "ring.size"));
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "transport"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(STRING_construct(control_id));
+	STRICT_EXPECTED_CALL(STRING_construct(NULL));
+
+	// act
+	void* result = OutprocessModuleLoader_ParseEntrypointFromJson(NULL, (JSON_Value*)0x42);
+
+	// assert
+	ASSERT_IS_NOT_NULL(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(int, OUTPROCESS_LOADER_TRANSPORT_IPC, ((OUTPROCESS_LOADER_ENTRYPOINT*)result)->transport);
+	OutprocessModuleLoader_FreeEntrypoint(NULL, result);
+}
+
+/*Tests_SRS_OUTPROCESS_LOADER_17_045: [ This function shall read the "transport" value. ]*/
+/*Tests_SRS_OUTPROCESS_LOADER_17_046: [ This function shall assign the entrypoint transport to OUTPROCESS_LOADER_TRANSPORT_SHM if "transport" is "shm", and to OUTPROCESS_LOADER_TRANSPORT_IPC otherwise. ]*/
+/*Tests_SRS_OUTPROCESS_LOADER_17_057: [ This function shall assign ring_size to the "ring.size" value, or to 0 if it is missing, negative or above INT32_MAX. ]*/
+TEST_FUNCTION(OutprocessModuleLoader_ParseEntrypointFromJson_succeeds_with_shm_transport)
+{
+	// arrange
+	char * activation_type = "none";
+	char * control_id = "a url";
+
+	STRICT_EXPECTED_CALL(json_value_get_type((JSON_Value*)0x42))
+		.SetReturn(JSONObject);
+	STRICT_EXPECTED_CALL(json_value_get_object((JSON_Value*)0x42))
+		.SetReturn((JSON_Object*)0x43);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "activation.type"))
+		.SetReturn(activation_type);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "control.id"))
+		.SetReturn(control_id);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "message.id"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(OUTPROCESS_LOADER_ENTRYPOINT)));
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "timeout"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.count"));
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.bytes"));
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.linger"));
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "queue.capacity"));
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "queue.policy"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "ring.size"))
+		.SetReturn(4194304);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "transport"))
+		.SetReturn("shm");
+	STRICT_EXPECTED_CALL(STRING_construct(control_id));
+	STRICT_EXPECTED_CALL(STRING_construct(NULL));
+
+	// act
+	void* result = OutprocessModuleLoader_ParseEntrypointFromJson(NULL, (JSON_Value*)0x42);
+
+	// assert
+	ASSERT_IS_NOT_NULL(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(int, OUTPROCESS_LOADER_TRANSPORT_SHM, ((OUTPROCESS_LOADER_ENTRYPOINT*)result)->transport);
+	ASSERT_ARE_EQUAL(int, 4194304, ((OUTPROCESS_LOADER_ENTRYPOINT*)result)->ring_size);
+	OutprocessModuleLoader_FreeEntrypoint(NULL, result);
+}
+
+/*Tests_SRS_OUTPROCESS_LOADER_17_049: [ This function shall read the "batch.count", "batch.bytes" and "batch.linger" values. ]*/
+/*Tests_SRS_OUTPROCESS_LOADER_17_050: [ This function shall assign batch_max_count, batch_max_bytes and batch_max_linger to these values, or to 0 if a value is missing, negative or above its limit. ]*/
+TEST_FUNCTION(OutprocessModuleLoader_ParseEntrypointFromJson_succeeds_with_batching)
+{
+	// arrange
+	char * activation_type = "none";
+	char * control_id = "a url";
+
+	STRICT_EXPECTED_CALL(json_value_get_type((JSON_Value*)0x42))
+		.SetReturn(JSONObject);
+	STRICT_EXPECTED_CALL(json_value_get_object((JSON_Value*)0x42))
+		.SetReturn((JSON_Object*)0x43);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "activation.type"))
+		.SetReturn(activation_type);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "control.id"))
+		.SetReturn(control_id);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "message.id"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(OUTPROCESS_LOADER_ENTRYPOINT)));
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "timeout"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.count"))
+		.SetReturn(64);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.bytes"))
+		.SetReturn(65536);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.linger"))
+		.SetReturn(-5);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "queue.capacity"));
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "queue.policy"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "ring.size"));
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "transport"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(STRING_construct(control_id));
+	STRICT_EXPECTED_CALL(STRING_construct(NULL));
+
+	// act
+	void* result = OutprocessModuleLoader_ParseEntrypointFromJson(NULL, (JSON_Value*)0x42);
+
+	// assert
+	ASSERT_IS_NOT_NULL(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(int, 64, ((OUTPROCESS_LOADER_ENTRYPOINT*)result)->batch_max_count);
+	ASSERT_ARE_EQUAL(int, 65536, ((OUTPROCESS_LOADER_ENTRYPOINT*)result)->batch_max_bytes);
+	ASSERT_ARE_EQUAL(int, 0, ((OUTPROCESS_LOADER_ENTRYPOINT*)result)->batch_max_linger);
+	OutprocessModuleLoader_FreeEntrypoint(NULL, result);
+}
+
+/*Tests_SRS_OUTPROCESS_LOADER_17_050: [ This function shall assign batch_max_count, batch_max_bytes and batch_max_linger to these values, or to 0 if a value is missing, negative or above its limit. ]*/
+TEST_FUNCTION(OutprocessModuleLoader_ParseEntrypointFromJson_ignores_batching_values_above_limits)
+{
+	// arrange
+	char * activation_type = "none";
+	char * control_id = "a url";
+
+	STRICT_EXPECTED_CALL(json_value_get_type((JSON_Value*)0x42))
+		.SetReturn(JSONObject);
+	STRICT_EXPECTED_CALL(json_value_get_object((JSON_Value*)0x42))
+		.SetReturn((JSON_Object*)0x43);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "activation.type"))
+		.SetReturn(activation_type);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "control.id"))
+		.SetReturn(control_id);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "message.id"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(OUTPROCESS_LOADER_ENTRYPOINT)));
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "timeout"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.count"))
+		.SetReturn(1025);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.bytes"))
+		.SetReturn(1e12);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.linger"))
+		.SetReturn(1000001);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "queue.capacity"));
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "queue.policy"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "ring.size"));
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "transport"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(STRING_construct(control_id));
+	STRICT_EXPECTED_CALL(STRING_construct(NULL));
+
+	// act
+	void* result = OutprocessModuleLoader_ParseEntrypointFromJson(NULL, (JSON_Value*)0x42);
+
+	// assert
+	ASSERT_IS_NOT_NULL(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(int, 0, ((OUTPROCESS_LOADER_ENTRYPOINT*)result)->batch_max_count);
+	ASSERT_ARE_EQUAL(int, 0, ((OUTPROCESS_LOADER_ENTRYPOINT*)result)->batch_max_bytes);
+	ASSERT_ARE_EQUAL(int, 0, ((OUTPROCESS_LOADER_ENTRYPOINT*)result)->batch_max_linger);
+	OutprocessModuleLoader_FreeEntrypoint(NULL, result);
+}
+
+/*Tests_SRS_OUTPROCESS_LOADER_17_052: [ This function shall read the "queue.capacity" and "queue.policy" values. ]*/
+/*Tests_SRS_OUTPROCESS_LOADER_17_053: [ This function shall assign queue_capacity to "queue.capacity", or to 0 if it is missing, negative or above INT32_MAX. ]*/
+/*Tests_SRS_OUTPROCESS_LOADER_17_054: [ This function shall assign queue_policy to BROKER_QUEUE_POLICY_DROP_OLDEST, BROKER_QUEUE_POLICY_DROP_NEWEST or BROKER_QUEUE_POLICY_BLOCK when "queue.policy" is "drop_oldest", "drop_newest" or "block", and to BROKER_QUEUE_POLICY_DROP_OLDEST when it is missing. ]*/
+TEST_FUNCTION(OutprocessModuleLoader_ParseEntrypointFromJson_succeeds_with_bounded_queue)
+{
+	// arrange
+	char * activation_type = "none";
+	char * control_id = "a url";
+
+	STRICT_EXPECTED_CALL(json_value_get_type((JSON_Value*)0x42))
+		.SetReturn(JSONObject);
+	STRICT_EXPECTED_CALL(json_value_get_object((JSON_Value*)0x42))
+		.SetReturn((JSON_Object*)0x43);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "activation.type"))
+		.SetReturn(activation_type);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "control.id"))
+		.SetReturn(control_id);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "message.id"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(OUTPROCESS_LOADER_ENTRYPOINT)));
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "timeout"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.count"));
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.bytes"));
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.linger"));
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "queue.capacity"))
+		.SetReturn(100);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "queue.policy"))
+		.SetReturn("block");
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "ring.size"));
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "transport"))
+		.SetReturn(NULL);
 	STRICT_EXPECTED_CALL(STRING_construct(control_id));
 	STRICT_EXPECTED_CALL(STRING_construct(NULL));
 
@@ -669,9 +873,92 @@ TEST_FUNCTION(OutprocessModuleLoader_ParseEntrypointFromJson_succeeds)
 	// assert
 	ASSERT_IS_NOT_NULL(result);
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(int, 100, ((OUTPROCESS_LOADER_ENTRYPOINT*)result)->queue_capacity);
+	ASSERT_ARE_EQUAL(int, BROKER_QUEUE_POLICY_BLOCK, ((OUTPROCESS_LOADER_ENTRYPOINT*)result)->queue_policy);
 	OutprocessModuleLoader_FreeEntrypoint(NULL, result);
 }
 
+/*Tests_SRS_OUTPROCESS_LOADER_17_055: [ This function shall return NULL if "queue.policy" has any other value. ]*/
+TEST_FUNCTION(OutprocessModuleLoader_ParseEntrypointFromJson_returns_NULL_with_unknown_queue_policy)
+{
+	// arrange
+	char * activation_type = "none";
+	char * control_id = "a url";
+
+	STRICT_EXPECTED_CALL(json_value_get_type((JSON_Value*)0x42))
+		.SetReturn(JSONObject);
+	STRICT_EXPECTED_CALL(json_value_get_object((JSON_Value*)0x42))
+		.SetReturn((JSON_Object*)0x43);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "activation.type"))
+		.SetReturn(activation_type);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "control.id"))
+		.SetReturn(control_id);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "message.id"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(OUTPROCESS_LOADER_ENTRYPOINT)));
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "timeout"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.count"));
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.bytes"));
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.linger"));
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "queue.capacity"))
+		.SetReturn(100);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "queue.policy"))
+		.SetReturn("drop_all");
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "ring.size"));
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "transport"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	// act
+	void* result = OutprocessModuleLoader_ParseEntrypointFromJson(NULL, (JSON_Value*)0x42);
+
+	// assert
+	ASSERT_IS_NULL(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_OUTPROCESS_LOADER_17_047: [ This function shall return NULL if "transport" is neither "ipc" nor "shm". ]*/
+TEST_FUNCTION(OutprocessModuleLoader_ParseEntrypointFromJson_returns_NULL_with_unknown_transport)
+{
+	// arrange
+	char * activation_type = "none";
+	char * control_id = "a url";
+
+	STRICT_EXPECTED_CALL(json_value_get_type((JSON_Value*)0x42))
+		.SetReturn(JSONObject);
+	STRICT_EXPECTED_CALL(json_value_get_object((JSON_Value*)0x42))
+		.SetReturn((JSON_Object*)0x43);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "activation.type"))
+		.SetReturn(activation_type);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "control.id"))
+		.SetReturn(control_id);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "message.id"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(OUTPROCESS_LOADER_ENTRYPOINT)));
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "timeout"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.count"));
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.bytes"));
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.linger"));
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "queue.capacity"));
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "queue.policy"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "ring.size"));
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "transport"))
+		.SetReturn("tcp");
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	// act
+	void* result = OutprocessModuleLoader_ParseEntrypointFromJson(NULL, (JSON_Value*)0x42);
+
+	// assert
+	ASSERT_IS_NULL(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
 /*Tests_SRS_OUTPROCESS_LOADER_17_023: [ This function shall release all resources allocated by OutprocessModuleLoader_ParseEntrypointFromJson. ]*/
 TEST_FUNCTION(OutprocessModuleLoader_FreeEntrypoint_does_nothing_when_entrypoint_is_NULL)
 {
@@ -772,6 +1059,8 @@ TEST_FUNCTION(OutprocessModuleLoader_BuildModuleConfiguration_returns_null_on_nu
 /*Tests_SRS_OUTPROCESS_LOADER_17_034: [ This function shall allocate and copy the module_configuration string and assign it the OUTPROCESS_MODULE_CONFIG::outprocess_module_args field. ]*/
 /*Tests_SRS_OUTPROCESS_LOADER_17_035: [ Upon success, this function shall return a valid pointer to an OUTPROCESS_MODULE_CONFIG structure. ]*/
 /*Tests_SRS_OUTPROCESS_LOADER_17_027: [ This function shall allocate a OUTPROCESS_MODULE_CONFIG structure. ]*/
+/*Tests_SRS_OUTPROCESS_LOADER_17_051: [ This function shall copy the entrypoint's batch_max_count, batch_max_bytes and batch_max_linger into the module configuration. ]*/
+/*Tests_SRS_OUTPROCESS_LOADER_17_056: [ This function shall copy the entrypoint's queue_capacity, queue_policy and ring_size into the module configuration. ]*/
 TEST_FUNCTION(OutprocessModuleLoader_BuildModuleConfiguration_success_with_msg_url)
 {
 	//arrange
@@ -782,6 +1071,12 @@ TEST_FUNCTION(OutprocessModuleLoader_BuildModuleConfiguration_success_with_msg_u
 		STRING_construct("message_id"),
 		0
 	};
+	ep.batch_max_count = 32;
+	ep.batch_max_bytes = 4096;
+	ep.batch_max_linger = 500;
+	ep.queue_capacity = 16;
+	ep.queue_policy = BROKER_QUEUE_POLICY_DROP_NEWEST;
+	ep.ring_size = 65536;
 	STRING_HANDLE mc = STRING_construct("message config");
 
 	umock_c_reset_all_calls();
@@ -801,6 +1096,50 @@ TEST_FUNCTION(OutprocessModuleLoader_BuildModuleConfiguration_success_with_msg_u
 	ASSERT_ARE_EQUAL(char_ptr, STRING_c_str(omc->control_uri), "ipc://control_id");
 	ASSERT_ARE_EQUAL(char_ptr, STRING_c_str(omc->message_uri), "ipc://message_id");
 	ASSERT_ARE_EQUAL(char_ptr, STRING_c_str(omc->outprocess_module_args), STRING_c_str(mc));
+	ASSERT_ARE_EQUAL(int, 32, omc->batch_max_count);
+	ASSERT_ARE_EQUAL(int, 4096, omc->batch_max_bytes);
+	ASSERT_ARE_EQUAL(int, 500, omc->batch_max_linger);
+	ASSERT_ARE_EQUAL(int, 16, omc->queue_capacity);
+	ASSERT_ARE_EQUAL(int, BROKER_QUEUE_POLICY_DROP_NEWEST, omc->queue_policy);
+	ASSERT_ARE_EQUAL(int, 65536, omc->ring_size);
+
+	//cleanup
+	OutprocessModuleLoader_FreeModuleConfiguration(NULL, result);
+	STRING_delete(ep.control_id);
+	STRING_delete(ep.message_id);
+	STRING_delete(mc);
+}
+
+/*Tests_SRS_OUTPROCESS_LOADER_17_048: [ If the entrypoint's transport is OUTPROCESS_LOADER_TRANSPORT_SHM, the message uri shall start with "shm://" instead of "ipc://". ]*/
+TEST_FUNCTION(OutprocessModuleLoader_BuildModuleConfiguration_success_with_shm_transport)
+{
+	//arrange
+	OUTPROCESS_LOADER_ENTRYPOINT ep =
+	{
+		OUTPROCESS_LOADER_ACTIVATION_NONE,
+		STRING_construct("control_id"),
+		STRING_construct("message_id"),
+		0,
+		OUTPROCESS_LOADER_TRANSPORT_SHM
+	};
+	STRING_HANDLE mc = STRING_construct("message config");
+
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(OUTPROCESS_MODULE_CONFIG)));
+	STRICT_EXPECTED_CALL(STRING_c_str(ep.message_id));
+	STRICT_EXPECTED_CALL(STRING_c_str(ep.control_id));
+	STRICT_EXPECTED_CALL(STRING_clone(mc));
+
+	//act
+	void * result = OutprocessModuleLoader_BuildModuleConfiguration(NULL, &ep, mc);
+	OUTPROCESS_MODULE_CONFIG *omc = (OUTPROCESS_MODULE_CONFIG*)result;
+
+	//assert
+	ASSERT_IS_NOT_NULL(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(char_ptr, STRING_c_str(omc->control_uri), "ipc://control_id");
+	ASSERT_ARE_EQUAL(char_ptr, STRING_c_str(omc->message_uri), "shm://message_id");
 
 	//cleanup
 	OutprocessModuleLoader_FreeModuleConfiguration(NULL, result);
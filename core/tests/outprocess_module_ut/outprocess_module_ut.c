@@ -47,6 +47,8 @@ void my_gballoc_free(void* ptr)
 #include <nanomsg/reqrep.h>
 
 #include "message.h"
+#include "message_ring.h"
+#include "message_batch.h"
 #include "real_strings.h"
 
 
@@ -56,6 +58,7 @@ void my_gballoc_free(void* ptr)
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 #include "broker.h"
 #include "module_loader.h"
 #include "message_queue.h"
@@ -292,6 +295,18 @@ LOCK_RESULT my_Lock_Deinit(LOCK_HANDLE handle)
 	return result;
 }
 
+/* Condition mocks
+ */
+COND_HANDLE my_Condition_Init(void)
+{
+	return (COND_HANDLE)my_gballoc_malloc(2);
+}
+
+void my_Condition_Deinit(COND_HANDLE handle)
+{
+	my_gballoc_free(handle);
+}
+
 /*  Control Message Mocks
  */
 
@@ -330,9 +345,11 @@ uint8_t *counter = (uint8_t*)m2;
 *counter = 1;
 MOCK_FUNCTION_END(m2)
 
-MOCK_FUNCTION_WITH_CODE(, int32_t, Message_ToByteArray, MESSAGE_HANDLE, messageHandle, unsigned char*, buf, int32_t, size)
-int32_t array_size = default_serialized_size;
-MOCK_FUNCTION_END(array_size)
+static unsigned char serialized_message_bytes[16];
+static CONSTBUFFER serialized_message = { serialized_message_bytes, 0 };
+MOCK_FUNCTION_WITH_CODE(, const CONSTBUFFER*, Message_GetSerialized, MESSAGE_HANDLE, message)
+serialized_message.size = default_serialized_size;
+MOCK_FUNCTION_END(&serialized_message)
 
 MOCK_FUNCTION_WITH_CODE(, void, Message_Destroy, MESSAGE_HANDLE, message)
 uint8_t *counter = (uint8_t*)message;
@@ -345,6 +362,42 @@ MOCK_FUNCTION_END()
 MOCK_FUNCTION_WITH_CODE(, BROKER_RESULT, Broker_Publish, BROKER_HANDLE, broker, MODULE_HANDLE, source, MESSAGE_HANDLE, message)
 MOCK_FUNCTION_END(BROKER_OK)
 
+/*  Message ring mocks
+ */
+
+static int current_MessageRing_Create_index;
+static int when_shall_MessageRing_Create_fail;
+static int message_ring_count;
+static unsigned char message_ring_bytes[16];
+
+MOCK_FUNCTION_WITH_CODE(, MESSAGE_RING_HANDLE, MessageRing_Create, const char*, name, uint32_t, size)
+MESSAGE_RING_HANDLE ring = NULL;
+current_MessageRing_Create_index++;
+if (when_shall_MessageRing_Create_fail != current_MessageRing_Create_index)
+{
+	ring = (MESSAGE_RING_HANDLE)my_gballoc_malloc(1);
+	message_ring_count++;
+}
+MOCK_FUNCTION_END(ring)
+
+MOCK_FUNCTION_WITH_CODE(, unsigned char*, MessageRing_BeginWrite, MESSAGE_RING_HANDLE, ring, int32_t, size, unsigned int, timeout_ms)
+MOCK_FUNCTION_END(message_ring_bytes)
+
+MOCK_FUNCTION_WITH_CODE(, void, MessageRing_EndWrite, MESSAGE_RING_HANDLE, ring)
+MOCK_FUNCTION_END()
+
+MOCK_FUNCTION_WITH_CODE(, int32_t, MessageRing_BeginRead, MESSAGE_RING_HANDLE, ring, const unsigned char**, buffer, unsigned int, timeout_ms)
+*buffer = message_ring_bytes;
+MOCK_FUNCTION_END(default_serialized_size)
+
+MOCK_FUNCTION_WITH_CODE(, void, MessageRing_EndRead, MESSAGE_RING_HANDLE, ring)
+MOCK_FUNCTION_END()
+
+MOCK_FUNCTION_WITH_CODE(, void, MessageRing_Destroy, MESSAGE_RING_HANDLE, ring)
+my_gballoc_free(ring);
+message_ring_count--;
+MOCK_FUNCTION_END()
+
 BEGIN_TEST_SUITE(OutprocessModule_UnitTests)
 
 TEST_SUITE_INITIALIZE(TestClassInitialize)
@@ -362,9 +415,13 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 	REGISTER_UMOCK_ALIAS_TYPE(MODULE_HANDLE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(BROKER_HANDLE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_HANDLE, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(const CONSTBUFFER*, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_QUEUE_HANDLE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+	REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(COND_RESULT, int);
+	REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_RING_HANDLE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(MODULE_API_VERSION, int);
@@ -392,8 +449,15 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 	REGISTER_GLOBAL_MOCK_HOOK(Unlock, my_Unlock);
 	REGISTER_GLOBAL_MOCK_HOOK(Lock_Deinit, my_Lock_Deinit);
 
+	//Condition Hooks
+	REGISTER_GLOBAL_MOCK_HOOK(Condition_Init, my_Condition_Init);
+	REGISTER_GLOBAL_MOCK_HOOK(Condition_Deinit, my_Condition_Deinit);
+	REGISTER_GLOBAL_MOCK_RETURN(Condition_Post, COND_OK);
+	REGISTER_GLOBAL_MOCK_RETURN(Condition_Wait, COND_OK);
+
 	// message queue
 	REGISTER_GLOBAL_MOCK_RETURNS(MESSAGE_QUEUE_create, (MESSAGE_QUEUE_HANDLE)0x40, NULL);
+	REGISTER_GLOBAL_MOCK_RETURNS(MESSAGE_QUEUE_create_bounded, (MESSAGE_QUEUE_HANDLE)0x40, NULL);
 
 
 	Module_ParseConfigurationFromJson = Outprocess_Module_API_all.Module_ParseConfigurationFromJson;
@@ -446,6 +510,10 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
 	default_message_size = 1;
 	default_serialized_size = 1;
 
+	current_MessageRing_Create_index = 0;
+	when_shall_MessageRing_Create_fail = 0;
+	message_ring_count = 0;
+
 	currentThreadAPI_Create_call = 0;
 	whenShallThreadAPI_Create_fail = 0;
 	currentThreadAPI_join_call = 0;
@@ -538,6 +606,28 @@ static void setup_create_config(OUTPROCESS_MODULE_CONFIG* config)
 	umock_c_reset_all_calls();
 }
 
+static void setup_create_shm_config(OUTPROCESS_MODULE_CONFIG* config)
+{
+	OUTPROCESS_MODULE_CONFIG new_config =
+	{
+		OUTPROCESS_LIFECYCLE_SYNC,
+		STRING_construct("control_uri"),
+		STRING_construct("shm://message_uri"),
+		STRING_construct("outprocess_module_args"),
+		0
+	};
+	*config = new_config;
+	umock_c_reset_all_calls();
+}
+
+static void setup_create_batch_config(OUTPROCESS_MODULE_CONFIG* config, unsigned int batch_max_bytes)
+{
+	setup_create_config(config);
+	config->batch_max_count = 4;
+	config->batch_max_bytes = batch_max_bytes;
+	config->batch_max_linger = 1000;
+}
+
 static void cleanup_create_config(OUTPROCESS_MODULE_CONFIG* config)
 {
 	STRING_delete(config->control_uri);
@@ -550,9 +640,9 @@ static void setup_create_connections(OUTPROCESS_MODULE_CONFIG* config)
 	const char * real_message_uri = real_STRING_c_str(config->message_uri);
 	const char * real_control_uri = real_STRING_c_str(config->control_uri);
 
-	STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
 	STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
 		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
 	// assuming the nanomsg mock starts socket at 1
 	STRICT_EXPECTED_CALL(nn_connect(1, real_message_uri));
 	STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
@@ -631,6 +721,76 @@ TEST_FUNCTION(Outprocess_Create_success)
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Condition_Init());
+
+	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
+	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
+	STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
+
+	//create thread
+	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	call_thread_function_on_join[1] = 1;
+	STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+
+	//join on the create thread.
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	setup_create_create_message(&config);
+
+	STRICT_EXPECTED_CALL(nn_setsockopt(2, NN_SOL_SOCKET, NN_RCVTIMEO, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+		.IgnoreArgument(4).IgnoreArgument(5);
+	STRICT_EXPECTED_CALL(nn_send(2, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(nn_recv(2, IGNORED_PTR_ARG, NN_MSG, 0))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(ControlMessage_CreateFromByteArray(IGNORED_PTR_ARG, 8))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(ControlMessage_Destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	// act
+	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x42, &config);
+
+	// assert
+
+	ASSERT_IS_NOT_NULL(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// ablution
+	Module_Destroy(result);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_079: [ If queue_capacity is not 0, this function shall create the queue by calling MESSAGE_QUEUE_create_bounded with queue_capacity. ]*/
+TEST_FUNCTION(Outprocess_Create_with_queue_capacity_creates_bounded_queue)
+{
+	// arrange
+	global_control_msg.base.type = CONTROL_MESSAGE_TYPE_MODULE_REPLY;
+	global_control_msg.base.version = CONTROL_MESSAGE_VERSION_CURRENT;
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 0;
+
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+	config.queue_capacity = 2;
+
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock_Init());
+
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(2))
+		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
+
+	setup_create_connections(&config);
+
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Condition_Init());
 
 	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
@@ -697,6 +857,7 @@ TEST_FUNCTION(Outprocess_Create_success_on_2nd_recv)
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Condition_Init());
 
 	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
@@ -719,7 +880,7 @@ TEST_FUNCTION(Outprocess_Create_success_on_2nd_recv)
 	STRICT_EXPECTED_CALL(nn_send(2, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
 		.IgnoreArgument(2);
 	malloc_will_fail = true;
-	malloc_fail_count = 11;
+	malloc_fail_count = 12;
 	STRICT_EXPECTED_CALL(nn_recv(2, IGNORED_PTR_ARG, NN_MSG, 0))
 		.IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(nn_errno()).SetReturn(EAGAIN);
@@ -769,6 +930,7 @@ TEST_FUNCTION(Outprocess_Create_success_async)
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Condition_Init());
 	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
@@ -810,6 +972,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_wrong_message_type_response)
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Condition_Init());
 	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
@@ -849,6 +1012,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_wrong_message_type_response)
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
@@ -886,6 +1050,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_wrong_message_status_response)
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Condition_Init());
 	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
@@ -925,6 +1090,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_wrong_message_status_response)
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
@@ -959,6 +1125,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_reponse_not_a_message)
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Condition_Init());
 	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
@@ -998,6 +1165,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_reponse_not_a_message)
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
@@ -1031,6 +1199,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_nn_recv_fails)
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Condition_Init());
 	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
@@ -1052,7 +1221,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_nn_recv_fails)
 	STRICT_EXPECTED_CALL(nn_send(2, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
 		.IgnoreArgument(2);
 	malloc_will_fail = true; // we malloc to create the byte array.
-	malloc_fail_count = 11;
+	malloc_fail_count = 12;
 	STRICT_EXPECTED_CALL(nn_recv(2, IGNORED_PTR_ARG, NN_MSG, 0))
 		.IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(nn_errno()).SetReturn(43);
@@ -1069,6 +1238,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_nn_recv_fails)
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
@@ -1103,6 +1273,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_thread_join_fails)
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Condition_Init());
 	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
@@ -1126,6 +1297,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_thread_join_fails)
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
@@ -1159,6 +1331,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_thread_create_fails)
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Condition_Init());
 	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
@@ -1179,6 +1352,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_thread_create_fails)
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
@@ -1212,6 +1386,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_nn_send_fails)
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Condition_Init());
 	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
@@ -1246,6 +1421,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_nn_send_fails)
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
@@ -1279,6 +1455,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_nn_send_try_again)
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Condition_Init());
 	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
@@ -1323,6 +1500,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_nn_send_try_again)
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
@@ -1356,6 +1534,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_sockopt_fails)
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Condition_Init());
 	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
@@ -1386,6 +1565,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_sockopt_fails)
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
@@ -1419,6 +1599,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_nn_allocmsg_fails)
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Condition_Init());
 	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
@@ -1445,7 +1626,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_nn_allocmsg_fails)
 	STRICT_EXPECTED_CALL(ControlMessage_ToByteArray(IGNORED_PTR_ARG, NULL, 0))
 		.IgnoreArgument(1);
 	malloc_will_fail = true; // we malloc to create the message.
-	malloc_fail_count = 10;
+	malloc_fail_count = 11;
 	STRICT_EXPECTED_CALL(nn_allocmsg(default_serialized_size, 0));	
 
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
@@ -1460,6 +1641,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_nn_allocmsg_fails)
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
@@ -1492,6 +1674,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_Message_ToByteArray_fails)
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Condition_Init());
 	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
@@ -1530,6 +1713,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_Message_ToByteArray_fails)
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
@@ -1562,6 +1746,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_badargs_null)
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Condition_Init());
 	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
@@ -1597,6 +1782,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_badargs_null)
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
@@ -1629,6 +1815,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_badargs_length)
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Condition_Init());
 	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
@@ -1664,6 +1851,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_badargs_length)
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
@@ -1696,6 +1884,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_baduri_null)
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Condition_Init());
 	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
@@ -1731,6 +1920,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_baduri_null)
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
@@ -1763,6 +1953,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_baduri_length)
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Condition_Init());
 	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
@@ -1798,6 +1989,52 @@ TEST_FUNCTION(Outprocess_Create_returns_null_baduri_length)
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
+	// act
+	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x42, &config);
+
+	// assert
+
+	ASSERT_IS_NULL(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// ablution
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_016: [ If any step in the creation fails, this function shall deallocate all resources and return NULL. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_061: [ This function shall initialize a condition to signal the outgoing gateway message thread when a message is queued. ]*/
+TEST_FUNCTION(Outprocess_Create_returns_null_condition_init_fail)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
+	setup_create_connections(&config);
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Lock_Init());
+	malloc_will_fail = true;
+	malloc_fail_count = 9;
+	STRICT_EXPECTED_CALL(Condition_Init());
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(nn_close(1));
+	STRICT_EXPECTED_CALL(nn_close(2));
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_destroy((MESSAGE_QUEUE_HANDLE)0x40));
+	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
@@ -1985,6 +2222,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_clone_args_fail)
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Condition_Init());
 	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args))
@@ -2001,11 +2239,12 @@ TEST_FUNCTION(Outprocess_Create_returns_null_clone_args_fail)
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	umock_c_negative_tests_snapshot();
 
-	umock_c_negative_tests_fail_call(15);
+	umock_c_negative_tests_fail_call(16);
 
 	// act
 	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x42, &config);
@@ -2038,6 +2277,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_clone_msg_uri_fails)
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Condition_Init());
 	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri)).SetFailReturn(NULL);
 
@@ -2051,11 +2291,12 @@ TEST_FUNCTION(Outprocess_Create_returns_null_clone_msg_uri_fails)
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	umock_c_negative_tests_snapshot();
 
-	umock_c_negative_tests_fail_call(14);
+	umock_c_negative_tests_fail_call(15);
 
 	// act
 	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x42, &config);
@@ -2088,6 +2329,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_clone_control_uri_fails)
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Condition_Init());
 	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri)).SetFailReturn(NULL);
 
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
@@ -2099,11 +2341,12 @@ TEST_FUNCTION(Outprocess_Create_returns_null_clone_control_uri_fails)
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	umock_c_negative_tests_snapshot();
 
-	umock_c_negative_tests_fail_call(13);
+	umock_c_negative_tests_fail_call(14);
 
 	// act
 	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x42, &config);
@@ -2131,8 +2374,8 @@ TEST_FUNCTION(Outprocess_Create_returns_null_control_connect_fails)
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
-	STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
 	STRICT_EXPECTED_CALL(STRING_c_str(config.message_uri));
+	STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
 	// assuming the nanomsg mock starts socket at 1
 	STRICT_EXPECTED_CALL(nn_connect(1, real_message_uri));
 	STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
@@ -2163,8 +2406,8 @@ TEST_FUNCTION(Outprocess_Create_returns_null_control_connect_fails)
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
-	STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
 	STRICT_EXPECTED_CALL(STRING_c_str(config.message_uri));
+	STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
 	// assuming the nanomsg mock starts socket at 3
 	STRICT_EXPECTED_CALL(nn_connect(3, real_message_uri));
 	STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
@@ -2208,8 +2451,8 @@ TEST_FUNCTION(Outprocess_Create_returns_null_control_socket_fails)
 	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 
-	STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
 	STRICT_EXPECTED_CALL(STRING_c_str(config.message_uri));
+	STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
 	// assuming the nanomsg mock starts socket at 1
 	STRICT_EXPECTED_CALL(nn_connect(1, real_message_uri));
 	when_shall_nn_socket_fail = 2;
@@ -2249,8 +2492,8 @@ TEST_FUNCTION(Outprocess_Create_returns_null_message_connect_fails)
 	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 
-	STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
 	STRICT_EXPECTED_CALL(STRING_c_str(config.message_uri));
+	STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
 	// assuming the nanomsg mock starts socket at 1
 	when_shall_nn_connect_fail = 1;
 	STRICT_EXPECTED_CALL(nn_connect(1, real_message_uri));
@@ -2279,8 +2522,8 @@ TEST_FUNCTION(Outprocess_Create_returns_null_message_connect_fails)
 	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 
-	STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
 	STRICT_EXPECTED_CALL(STRING_c_str(config.message_uri)).SetReturn(NULL);
+	STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
 	// assuming the nanomsg mock starts socket at 1
 	when_shall_nn_connect_fail = 2;
 	STRICT_EXPECTED_CALL(nn_connect(2, NULL));
@@ -2317,6 +2560,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_message_socket_fails)
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
+	STRICT_EXPECTED_CALL(STRING_c_str(config.message_uri));
 	when_shall_nn_socket_fail = 1;
 	STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
 	
@@ -2339,74 +2583,281 @@ TEST_FUNCTION(Outprocess_Create_returns_null_message_socket_fails)
 	cleanup_create_config(&config);
 }
 
-/*Tests_SRS_OUTPROCESS_MODULE_17_016: [ If any step in the creation fails, this function shall deallocate all resources and return NULL. ]*/
-TEST_FUNCTION(Outprocess_Create_returns_null_message_queue_fails)
+/*Tests_SRS_OUTPROCESS_MODULE_17_069: [ If the message_uri starts with "shm://", this function shall create a message ring named after the rest of the uri followed by "_to_module" for gateway messages to the module host, and one followed by "_to_gateway" for gateway messages from the module host. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_085: [ Each message ring shall reserve ring_size bytes for messages, or MESSAGE_RING_DEFAULT_SIZE bytes if ring_size is 0. ]*/
+TEST_FUNCTION(Outprocess_Create_with_shm_uri_creates_message_rings)
 {
 	// arrange
+	global_control_msg.base.type = CONTROL_MESSAGE_TYPE_MODULE_REPLY;
+	global_control_msg.base.version = CONTROL_MESSAGE_VERSION_CURRENT;
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 0;
+
 	OUTPROCESS_MODULE_CONFIG config;
-	setup_create_config(&config);
+	setup_create_shm_config(&config);
+	const char * real_control_uri = real_STRING_c_str(config.control_uri);
+
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
-		.SetReturn(NULL);
+		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 
-	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(STRING_c_str(config.message_uri));
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MessageRing_Create("message_uri_to_module", 0));
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MessageRing_Create("message_uri_to_gateway", 0));
 	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	// only the control channel uses a socket
+	STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
+	STRICT_EXPECTED_CALL(STRING_c_str(config.control_uri));
+	STRICT_EXPECTED_CALL(nn_connect(1, real_control_uri));
 
-	// act
-	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x42, &config);
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Condition_Init());
 
-	// assert
+	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
+	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
+	STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
 
-	ASSERT_IS_NULL(result);
-	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	//create thread
+	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	call_thread_function_on_join[1] = 1;
+	STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
 
-	// ablution
-	cleanup_create_config(&config);
-}
+	//join on the create thread.
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	setup_create_create_message(&config);
 
-/*Tests_SRS_OUTPROCESS_MODULE_17_016: [ If any step in the creation fails, this function shall deallocate all resources and return NULL. ]*/
-TEST_FUNCTION(Outprocess_Create_returns_null_lock_init_fails)
-{
-	// arrange
-	OUTPROCESS_MODULE_CONFIG config;
-	setup_create_config(&config);
-	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+	STRICT_EXPECTED_CALL(nn_setsockopt(1, NN_SOL_SOCKET, NN_RCVTIMEO, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+		.IgnoreArgument(4).IgnoreArgument(5);
+	STRICT_EXPECTED_CALL(nn_send(1, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(nn_recv(1, IGNORED_PTR_ARG, NN_MSG, 0))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(ControlMessage_CreateFromByteArray(IGNORED_PTR_ARG, 8))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(ControlMessage_Destroy(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-	malloc_will_fail = true;
-	malloc_fail_count = 2;
-	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
 	// act
 	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x42, &config);
 
 	// assert
 
-	ASSERT_IS_NULL(result);
+	ASSERT_IS_NOT_NULL(result);
+	ASSERT_ARE_EQUAL(int, 2, message_ring_count);
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
 	// ablution
+	Module_Destroy(result);
 	cleanup_create_config(&config);
 }
 
-/*Tests_SRS_OUTPROCESS_MODULE_17_016: [ If any step in the creation fails, this function shall deallocate all resources and return NULL. ]*/
-TEST_FUNCTION(Outprocess_Create_returns_null_malloc_fails)
+/*Tests_SRS_OUTPROCESS_MODULE_17_085: [ Each message ring shall reserve ring_size bytes for messages, or MESSAGE_RING_DEFAULT_SIZE bytes if ring_size is 0. ]*/
+TEST_FUNCTION(Outprocess_Create_with_ring_size_creates_message_rings_of_that_size)
 {
 	// arrange
+	global_control_msg.base.type = CONTROL_MESSAGE_TYPE_MODULE_REPLY;
+	global_control_msg.base.version = CONTROL_MESSAGE_VERSION_CURRENT;
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 0;
+
 	OUTPROCESS_MODULE_CONFIG config;
-	setup_create_config(&config);
+	setup_create_shm_config(&config);
+	config.ring_size = 4194304;
+	const char * real_control_uri = real_STRING_c_str(config.control_uri);
 
-	malloc_will_fail = true;
-	malloc_fail_count = 1;
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 
-	// act
-	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x42, &config);
-
-	// assert
+	STRICT_EXPECTED_CALL(STRING_c_str(config.message_uri));
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MessageRing_Create("message_uri_to_module", 4194304));
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MessageRing_Create("message_uri_to_gateway", 4194304));
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	// only the control channel uses a socket
+	STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
+	STRICT_EXPECTED_CALL(STRING_c_str(config.control_uri));
+	STRICT_EXPECTED_CALL(nn_connect(1, real_control_uri));
+
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Condition_Init());
+
+	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
+	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
+	STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
+
+	//create thread
+	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	call_thread_function_on_join[1] = 1;
+	STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+
+	//join on the create thread.
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	setup_create_create_message(&config);
+
+	STRICT_EXPECTED_CALL(nn_setsockopt(1, NN_SOL_SOCKET, NN_RCVTIMEO, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+		.IgnoreArgument(4).IgnoreArgument(5);
+	STRICT_EXPECTED_CALL(nn_send(1, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(nn_recv(1, IGNORED_PTR_ARG, NN_MSG, 0))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(ControlMessage_CreateFromByteArray(IGNORED_PTR_ARG, 8))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(ControlMessage_Destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	// act
+	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x42, &config);
+
+	// assert
+
+	ASSERT_IS_NOT_NULL(result);
+	ASSERT_ARE_EQUAL(int, 2, message_ring_count);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// ablution
+	Module_Destroy(result);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_016: [ If any step in the creation fails, this function shall deallocate all resources and return NULL. ]*/
+TEST_FUNCTION(Outprocess_Create_returns_null_message_ring_create_fails)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_shm_config(&config);
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
+
+	STRICT_EXPECTED_CALL(STRING_c_str(config.message_uri));
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MessageRing_Create("message_uri_to_module", 0));
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	when_shall_MessageRing_Create_fail = 2;
+	STRICT_EXPECTED_CALL(MessageRing_Create("message_uri_to_gateway", 0));
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MessageRing_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_destroy((MESSAGE_QUEUE_HANDLE)0x40));
+	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
+	// act
+	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x42, &config);
+
+	// assert
+
+	ASSERT_IS_NULL(result);
+	ASSERT_ARE_EQUAL(int, 0, message_ring_count);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// ablution
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_016: [ If any step in the creation fails, this function shall deallocate all resources and return NULL. ]*/
+TEST_FUNCTION(Outprocess_Create_returns_null_message_queue_fails)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+		.SetReturn(NULL);
+
+	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
+	// act
+	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x42, &config);
+
+	// assert
+
+	ASSERT_IS_NULL(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// ablution
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_016: [ If any step in the creation fails, this function shall deallocate all resources and return NULL. ]*/
+TEST_FUNCTION(Outprocess_Create_returns_null_lock_init_fails)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	malloc_will_fail = true;
+	malloc_fail_count = 2;
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
+	// act
+	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x42, &config);
+
+	// assert
+
+	ASSERT_IS_NULL(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// ablution
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_016: [ If any step in the creation fails, this function shall deallocate all resources and return NULL. ]*/
+TEST_FUNCTION(Outprocess_Create_returns_null_malloc_fails)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+
+	malloc_will_fail = true;
+	malloc_fail_count = 1;
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+
+	// act
+	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x42, &config);
+
+	// assert
 
 	ASSERT_IS_NULL(result);
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
@@ -2613,7 +3064,7 @@ TEST_FUNCTION(Outprocess_Destroy_does_nothing_with_nothing)
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
-static void teardown_a_thread(bool needs_join, bool lock_fail)
+static void teardown_a_thread(bool needs_join, bool lock_fail, bool needs_wake)
 {
 	if (lock_fail)
 	{
@@ -2624,6 +3075,12 @@ static void teardown_a_thread(bool needs_join, bool lock_fail)
 		STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 		STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	}
+	if (needs_wake)
+	{
+		STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(Condition_Post(IGNORED_PTR_ARG)).IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	}
 	if (needs_join)
 	{
 		STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -2642,6 +3099,7 @@ static void teardown_a_thread(bool needs_join, bool lock_fail)
 /*Tests_SRS_OUTPROCESS_MODULE_17_033: [ This function shall wait for the messaging thread to complete. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_034: [ This function shall release all resources created by this module. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_049: [ This function shall signal the outgoing gateway message thread to close. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_064: [ This function shall signal the outgoing message condition to wake up the outgoing gateway message thread. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_050: [ This function shall signal the control thread to close. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_051: [ This function shall wait for the outgoing gateway message thread to complete. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_052: [ This function shall wait for the control thread to complete. ]*/
@@ -2671,7 +3129,7 @@ TEST_FUNCTION(Outprocess_Destroy_success)
 	call_thread_function_on_join[2] = 2;
 	call_thread_function_on_join[3] = 3;
 	call_thread_function_on_join[4] = 4;
-	//teardown_a_thread(true, false);
+	//teardown_a_thread(true, false, false);
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -2682,8 +3140,11 @@ TEST_FUNCTION(Outprocess_Destroy_success)
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	//teardown_a_thread(true, false);
+	//teardown_a_thread(true, false, true);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Post(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 		.IgnoreArgument(1)
@@ -2691,7 +3152,7 @@ TEST_FUNCTION(Outprocess_Destroy_success)
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	//teardown_a_thread(true, false);
+	//teardown_a_thread(true, false, false);
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -2700,10 +3161,11 @@ TEST_FUNCTION(Outprocess_Destroy_success)
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	teardown_a_thread(false, false); //async should be closed and NULL
+	teardown_a_thread(false, false, false); //async should be closed and NULL
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
@@ -2718,6 +3180,31 @@ TEST_FUNCTION(Outprocess_Destroy_success)
 }
 
 
+/*Tests_SRS_OUTPROCESS_MODULE_17_070: [ This function shall destroy the message rings, if any, after all threads have completed. ]*/
+TEST_FUNCTION(Outprocess_Destroy_destroys_message_rings)
+{
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_shm_config(&config);
+	global_control_msg.base.type = CONTROL_MESSAGE_TYPE_MODULE_REPLY;
+	global_control_msg.base.version = CONTROL_MESSAGE_VERSION_CURRENT;
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 0;
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	Module_Start(module);
+	ASSERT_ARE_EQUAL(int, 2, message_ring_count);
+
+	umock_c_reset_all_calls();
+
+	// act
+	Module_Destroy(module);
+
+	// assert
+	ASSERT_ARE_EQUAL(int, 0, message_ring_count);
+
+	// ablution
+	cleanup_create_config(&config);
+}
+
 /*Tests_SRS_OUTPROCESS_MODULE_17_027: [ This function shall ensure thread safety on execution. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_032: [ This function shall signal the messaging thread to close. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_048: [ There is a possibility the module host process is no longer operational, therefore sending the destroy the Destroy Message shall be a best effort attempt. ]*/
@@ -2758,13 +3245,14 @@ TEST_FUNCTION(Outprocess_Destroy_send_lock_join_fails)
 	thread_join_result[1] = THREADAPI_ERROR;
 	thread_join_result[2] = THREADAPI_ERROR;
 	thread_join_result[3] = THREADAPI_ERROR;
-	teardown_a_thread(true, true);
-	teardown_a_thread(true, true);
-	teardown_a_thread(true, true);
-	teardown_a_thread(true, true); //async won't be closed.
+	teardown_a_thread(true, true, false);
+	teardown_a_thread(true, true, true);
+	teardown_a_thread(true, true, false);
+	teardown_a_thread(true, true, false); //async won't be closed.
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
@@ -2803,13 +3291,14 @@ TEST_FUNCTION(Outprocess_Destroy_destroy_message_alloc_fails)
 	STRICT_EXPECTED_CALL(nn_close(1));
 	STRICT_EXPECTED_CALL(nn_close(2));
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	teardown_a_thread(true, false);
-	teardown_a_thread(true, false);
-	teardown_a_thread(true, false);
-	teardown_a_thread(false, false);
+	teardown_a_thread(true, false, false);
+	teardown_a_thread(true, false, true);
+	teardown_a_thread(true, false, false);
+	teardown_a_thread(false, false, false);
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
@@ -2845,13 +3334,14 @@ TEST_FUNCTION(Outprocess_Destroy_destroy_message_to_array_fails)
 	STRICT_EXPECTED_CALL(nn_close(1));
 	STRICT_EXPECTED_CALL(nn_close(2));
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	teardown_a_thread(true, false);
-	teardown_a_thread(true, false);
-	teardown_a_thread(true, false);
-	teardown_a_thread(false, false);
+	teardown_a_thread(true, false, false);
+	teardown_a_thread(true, false, true);
+	teardown_a_thread(true, false, false);
+	teardown_a_thread(false, false, false);
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
@@ -2879,6 +3369,7 @@ TEST_FUNCTION(Outprocess_Receive_does_nothing_with_nothing)
 /*Tests_SRS_OUTPROCESS_MODULE_17_045: [ This function shall ensure thread safety for the module data. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_047: [ This function shall push the message onto the end of the outgoing gateway message queue. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_046: [ This function shall clone the message to ensure the message is kept allocated until forwarded to module host. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_062: [ This function shall signal the outgoing message condition after queueing the message. ]*/
 TEST_FUNCTION(Outprocess_Receive_success)
 {
 	// arrange
@@ -2893,6 +3384,7 @@ TEST_FUNCTION(Outprocess_Receive_success)
 	STRICT_EXPECTED_CALL(Message_Clone(msg));
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_push(IGNORED_PTR_ARG, msg)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Post(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
 	// act
@@ -2938,21 +3430,30 @@ TEST_FUNCTION(Outprocess_Receive_push_queue_fails)
 	cleanup_create_config(&config);
 }
 
-/*Tests_SRS_OUTPROCESS_MODULE_17_047: [ This function shall push the message onto the end of the outgoing gateway message queue. ]*/
-TEST_FUNCTION(Outprocess_Receive_Lock_fails)
+/*Tests_SRS_OUTPROCESS_MODULE_17_080: [ If the queue is full and queue_policy is BROKER_QUEUE_POLICY_DROP_OLDEST, this function shall discard the oldest queued message and queue the clone. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_083: [ This function shall count the messages discarded by the queue policy and log the first discarded message and then progressively less often. ]*/
+TEST_FUNCTION(Outprocess_Receive_stalled_remote_drop_oldest_discards_oldest_message)
 {
 	// arrange
 	OUTPROCESS_MODULE_CONFIG config;
 	setup_create_config(&config);
+	config.queue_capacity = 2;
+	config.queue_policy = BROKER_QUEUE_POLICY_DROP_OLDEST;
 
 	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
 	Module_Start(module);
+	MESSAGE_HANDLE oldest = Message_Create((const MESSAGE_CONFIG*)(0x42));
 	MESSAGE_HANDLE msg = Message_Create((const MESSAGE_CONFIG*)(0x42));
 	umock_c_reset_all_calls();
 
 	STRICT_EXPECTED_CALL(Message_Clone(msg));
-	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1).SetReturn(LOCK_ERROR);
-	STRICT_EXPECTED_CALL(Message_Destroy(msg));
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_full(IGNORED_PTR_ARG)).IgnoreArgument(1).SetReturn(true);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop(IGNORED_PTR_ARG)).IgnoreArgument(1).SetReturn(oldest);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_push(IGNORED_PTR_ARG, msg)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Post(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Message_Destroy(oldest));
 
 	// act
 	Module_Receive(module, msg);
@@ -2962,23 +3463,30 @@ TEST_FUNCTION(Outprocess_Receive_Lock_fails)
 
 	//ablution
 	Message_Destroy(msg);
+	Message_Destroy(msg);
 	Module_Destroy(module);
 	cleanup_create_config(&config);
 }
 
-/*Tests_SRS_OUTPROCESS_MODULE_17_047: [ This function shall push the message onto the end of the outgoing gateway message queue. ]*/
-TEST_FUNCTION(Outprocess_Receive_Message_Clone_fails)
+/*Tests_SRS_OUTPROCESS_MODULE_17_081: [ If the queue is full and queue_policy is BROKER_QUEUE_POLICY_DROP_NEWEST, this function shall discard the clone. ]*/
+TEST_FUNCTION(Outprocess_Receive_stalled_remote_drop_newest_discards_message)
 {
 	// arrange
 	OUTPROCESS_MODULE_CONFIG config;
 	setup_create_config(&config);
+	config.queue_capacity = 2;
+	config.queue_policy = BROKER_QUEUE_POLICY_DROP_NEWEST;
 
 	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
 	Module_Start(module);
 	MESSAGE_HANDLE msg = Message_Create((const MESSAGE_CONFIG*)(0x42));
 	umock_c_reset_all_calls();
 
-	STRICT_EXPECTED_CALL(Message_Clone(msg)).SetReturn(NULL);
+	STRICT_EXPECTED_CALL(Message_Clone(msg));
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_full(IGNORED_PTR_ARG)).IgnoreArgument(1).SetReturn(true);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Message_Destroy(msg));
 
 	// act
 	Module_Receive(module, msg);
@@ -2988,81 +3496,83 @@ TEST_FUNCTION(Outprocess_Receive_Message_Clone_fails)
 
 	//ablution
 	Message_Destroy(msg);
-	Message_Destroy(msg);
 	Module_Destroy(module);
 	cleanup_create_config(&config);
 }
 
-TEST_FUNCTION(Outprocess_outgoing_thread_does_nothing_with_nothing)
+/*Tests_SRS_OUTPROCESS_MODULE_17_082: [ If the queue is full and queue_policy is BROKER_QUEUE_POLICY_BLOCK, this function shall wait on the outgoing message condition until the queue has room, and discard the clone if the outgoing thread is not running or the wait fails. ]*/
+TEST_FUNCTION(Outprocess_Receive_stalled_remote_block_waits_for_room)
 {
+	// arrange
 	OUTPROCESS_MODULE_CONFIG config;
 	setup_create_config(&config);
+	config.queue_capacity = 2;
+	config.queue_policy = BROKER_QUEUE_POLICY_BLOCK;
 
 	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
 	Module_Start(module);
+	MESSAGE_HANDLE msg = Message_Create((const MESSAGE_CONFIG*)(0x42));
 	umock_c_reset_all_calls();
 
-	// act
-	thread_func_to_call[3](NULL);
+	STRICT_EXPECTED_CALL(Message_Clone(msg));
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_full(IGNORED_PTR_ARG)).IgnoreArgument(1).SetReturn(true);
+	STRICT_EXPECTED_CALL(Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 100)).IgnoreArgument(1).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_full(IGNORED_PTR_ARG)).IgnoreArgument(1).SetReturn(true);
+	STRICT_EXPECTED_CALL(Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 100)).IgnoreArgument(1).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_full(IGNORED_PTR_ARG)).IgnoreArgument(1).SetReturn(false);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_push(IGNORED_PTR_ARG, msg)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Post(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
+	// act
+	Module_Receive(module, msg);
 
 	// assert 
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
 	//ablution
+	Message_Destroy(msg);
+	Message_Destroy(msg);
 	Module_Destroy(module);
 	cleanup_create_config(&config);
 }
 
-/*Tests_SRS_OUTPROCESS_MODULE_17_053: [ This thread shall ensure thread safety on the module data. ]*/
-/*Tests_SRS_OUTPROCESS_MODULE_17_054: [ This function shall remove the oldest message from the outgoing gateway message queue. ]*/
-/*Tests_SRS_OUTPROCESS_MODULE_17_023: [ This function shall serialize the message for transmission on the message channel. ]*/
-/*Tests_SRS_OUTPROCESS_MODULE_17_024: [ This function shall send the message on the message channel. ]*/
-/*Tests_SRS_OUTPROCESS_MODULE_17_055: [ This function shall Destroy the message once successfully transmitted. ]*/
-/*Tests_SRS_OUTPROCESS_MODULE_17_025: [ This function shall free any resources created. ]*/
-TEST_FUNCTION(Outprocess_outgoing_thread_success)
+/*Tests_SRS_OUTPROCESS_MODULE_17_082: [ If the queue is full and queue_policy is BROKER_QUEUE_POLICY_BLOCK, this function shall wait on the outgoing message condition until the queue has room, and discard the clone if the outgoing thread is not running or the wait fails. ]*/
+TEST_FUNCTION(Outprocess_Receive_stalled_remote_block_discards_message_when_wait_fails)
 {
 	// arrange
 	OUTPROCESS_MODULE_CONFIG config;
 	setup_create_config(&config);
+	config.queue_capacity = 2;
+	config.queue_policy = BROKER_QUEUE_POLICY_BLOCK;
 
 	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
 	Module_Start(module);
 	MESSAGE_HANDLE msg = Message_Create((const MESSAGE_CONFIG*)(0x42));
 	umock_c_reset_all_calls();
 
+	STRICT_EXPECTED_CALL(Message_Clone(msg));
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_full(IGNORED_PTR_ARG)).IgnoreArgument(1).SetReturn(true);
+	STRICT_EXPECTED_CALL(Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 100)).IgnoreArgument(1).IgnoreArgument(2).SetReturn(COND_ERROR);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_empty(IGNORED_PTR_ARG)).IgnoreArgument(1)
-		.SetReturn(false);
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop(IGNORED_PTR_ARG)).IgnoreArgument(1)
-		.SetReturn(msg);
-	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Message_ToByteArray(msg, NULL, 0));
-	STRICT_EXPECTED_CALL(nn_allocmsg(default_serialized_size, 0));
-	STRICT_EXPECTED_CALL(Message_ToByteArray(msg, IGNORED_PTR_ARG, default_serialized_size))
-		.IgnoreArgument(2);
-	STRICT_EXPECTED_CALL(nn_send(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(Message_Destroy(msg));
-	STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
-	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1)
-		.SetReturn(LOCK_ERROR);
 
 	// act
-	//third thread created is outgoing message thread
-	thread_func_to_call[3](thread_func_args[3]);
+	Module_Receive(module, msg);
 
 	// assert 
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
 	//ablution
+	Message_Destroy(msg);
 	Module_Destroy(module);
 	cleanup_create_config(&config);
 }
 
-/*Tests_SRS_OUTPROCESS_MODULE_17_053: [ This thread shall ensure thread safety on the module data. ]*/
-TEST_FUNCTION(Outprocess_outgoing_thread_nn_send_1st_unlock_fails)
+/*Tests_SRS_OUTPROCESS_MODULE_17_047: [ This function shall push the message onto the end of the outgoing gateway message queue. ]*/
+TEST_FUNCTION(Outprocess_Receive_Lock_fails)
 {
 	// arrange
 	OUTPROCESS_MODULE_CONFIG config;
@@ -3073,42 +3583,277 @@ TEST_FUNCTION(Outprocess_outgoing_thread_nn_send_1st_unlock_fails)
 	MESSAGE_HANDLE msg = Message_Create((const MESSAGE_CONFIG*)(0x42));
 	umock_c_reset_all_calls();
 
-	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_empty(IGNORED_PTR_ARG)).IgnoreArgument(1)
-		.SetReturn(false);
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop(IGNORED_PTR_ARG)).IgnoreArgument(1)
-		.SetReturn(msg);
-	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Message_ToByteArray(msg, NULL, 0));
-	STRICT_EXPECTED_CALL(nn_allocmsg(default_serialized_size, 0));
-	STRICT_EXPECTED_CALL(Message_ToByteArray(msg, IGNORED_PTR_ARG, default_serialized_size))
-		.IgnoreArgument(2);
-	should_nn_send_fail = true;
-	current_nn_send_index = 0;
-	when_shall_nn_send_fail = 1;
-	STRICT_EXPECTED_CALL(nn_send(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
-	STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Message_Clone(msg));
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1).SetReturn(LOCK_ERROR);
 	STRICT_EXPECTED_CALL(Message_Destroy(msg));
-	STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
-	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1)
-		.SetReturn(LOCK_ERROR);
 
 	// act
-	//third thread created is outgoing message thread
-	thread_func_to_call[3](thread_func_args[3]);
+	Module_Receive(module, msg);
 
 	// assert 
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
 	//ablution
+	Message_Destroy(msg);
 	Module_Destroy(module);
 	cleanup_create_config(&config);
 }
 
-/*Tests_SRS_OUTPROCESS_MODULE_17_053: [ This thread shall ensure thread safety on the module data. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_047: [ This function shall push the message onto the end of the outgoing gateway message queue. ]*/
+TEST_FUNCTION(Outprocess_Receive_Message_Clone_fails)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	Module_Start(module);
+	MESSAGE_HANDLE msg = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Message_Clone(msg)).SetReturn(NULL);
+
+	// act
+	Module_Receive(module, msg);
+
+	// assert 
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	//ablution
+	Message_Destroy(msg);
+	Message_Destroy(msg);
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+TEST_FUNCTION(Outprocess_outgoing_thread_does_nothing_with_nothing)
+{
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	Module_Start(module);
+	umock_c_reset_all_calls();
+
+	// act
+	thread_func_to_call[3](NULL);
+
+
+	// assert 
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	//ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_053: [ This thread shall ensure thread safety on the module data. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_054: [ This function shall remove the oldest message from the outgoing gateway message queue. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_023: [ This function shall serialize the message for transmission on the message channel. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_024: [ This function shall send the message on the message channel. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_055: [ This function shall Destroy the message once successfully transmitted. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_025: [ This function shall free any resources created. ]*/
+TEST_FUNCTION(Outprocess_outgoing_thread_success)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	Module_Start(module);
+	MESSAGE_HANDLE msg = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_empty(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(false);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(msg);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Message_GetSerialized(msg));
+	STRICT_EXPECTED_CALL(nn_allocmsg(default_serialized_size, 0));
+	STRICT_EXPECTED_CALL(nn_send(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Message_Destroy(msg));
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(LOCK_ERROR);
+
+	// act
+	//third thread created is outgoing message thread
+	thread_func_to_call[3](thread_func_args[3]);
+
+	// assert 
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	//ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_068: [ If the message channel is a pair of message rings, this function shall serialize the message directly into the outgoing ring, waiting at most remote_message_wait milliseconds for room. ]*/
+TEST_FUNCTION(Outprocess_outgoing_thread_writes_to_message_ring)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_shm_config(&config);
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	Module_Start(module);
+	MESSAGE_HANDLE msg = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_empty(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(false);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(msg);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Message_GetSerialized(msg));
+	STRICT_EXPECTED_CALL(MessageRing_BeginWrite(IGNORED_PTR_ARG, default_serialized_size, IGNORED_NUM_ARG))
+		.IgnoreArgument(1).IgnoreArgument(3);
+	STRICT_EXPECTED_CALL(MessageRing_EndWrite(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Message_Destroy(msg));
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(LOCK_ERROR);
+
+	// act
+	//third thread created is outgoing message thread
+	thread_func_to_call[3](thread_func_args[3]);
+
+	// assert 
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	//ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_055: [ This function shall Destroy the message once successfully transmitted. ]*/
+TEST_FUNCTION(Outprocess_outgoing_thread_drops_message_when_ring_full)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_shm_config(&config);
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	Module_Start(module);
+	MESSAGE_HANDLE msg = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_empty(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(false);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(msg);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Message_GetSerialized(msg));
+	STRICT_EXPECTED_CALL(MessageRing_BeginWrite(IGNORED_PTR_ARG, default_serialized_size, IGNORED_NUM_ARG))
+		.IgnoreArgument(1).IgnoreArgument(3)
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(Message_Destroy(msg));
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(LOCK_ERROR);
+
+	// act
+	thread_func_to_call[3](thread_func_args[3]);
+
+	// assert 
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	//ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_086: [ If the message channel is a pair of message rings and the serialized message is larger than the ring, this function shall log an error and drop the message without waiting for room. ]*/
+TEST_FUNCTION(Outprocess_outgoing_thread_drops_message_larger_than_ring)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_shm_config(&config);
+	config.ring_size = 64;
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	Module_Start(module);
+	MESSAGE_HANDLE msg = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	default_serialized_size = 65;
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_empty(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(false);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(msg);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Message_GetSerialized(msg));
+	STRICT_EXPECTED_CALL(Message_Destroy(msg));
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(LOCK_ERROR);
+
+	// act
+	thread_func_to_call[3](thread_func_args[3]);
+
+	// assert 
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	//ablution
+	default_serialized_size = 1;
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_053: [ This thread shall ensure thread safety on the module data. ]*/
+TEST_FUNCTION(Outprocess_outgoing_thread_nn_send_1st_unlock_fails)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	Module_Start(module);
+	MESSAGE_HANDLE msg = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_empty(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(false);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(msg);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Message_GetSerialized(msg));
+	STRICT_EXPECTED_CALL(nn_allocmsg(default_serialized_size, 0));
+	should_nn_send_fail = true;
+	current_nn_send_index = 0;
+	when_shall_nn_send_fail = 1;
+	STRICT_EXPECTED_CALL(nn_send(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Message_Destroy(msg));
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(LOCK_ERROR);
+
+	// act
+	//third thread created is outgoing message thread
+	thread_func_to_call[3](thread_func_args[3]);
+
+	// assert 
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	//ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_053: [ This thread shall ensure thread safety on the module data. ]*/
 TEST_FUNCTION(Outprocess_outgoing_thread_nn_alloc_2nd_lock_fails)
 {
 	// arrange
@@ -3128,12 +3873,11 @@ TEST_FUNCTION(Outprocess_outgoing_thread_nn_alloc_2nd_lock_fails)
 	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop(IGNORED_PTR_ARG)).IgnoreArgument(1)
 		.SetReturn(msg);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Message_ToByteArray(msg, NULL, 0));
+	STRICT_EXPECTED_CALL(Message_GetSerialized(msg));
 	malloc_will_fail = true;
 	malloc_fail_count = malloc_count + 1;
 	STRICT_EXPECTED_CALL(nn_allocmsg(default_serialized_size, 0));
 	STRICT_EXPECTED_CALL(Message_Destroy(msg));
-	STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1)
@@ -3152,6 +3896,7 @@ TEST_FUNCTION(Outprocess_outgoing_thread_nn_alloc_2nd_lock_fails)
 }
 
 /*Tests_SRS_OUTPROCESS_MODULE_17_053: [ This thread shall ensure thread safety on the module data. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_063: [ If the outgoing gateway message queue is empty, this function shall wait on the outgoing message condition until a message is queued or the thread is asked to stop. ]*/
 TEST_FUNCTION(Outprocess_outgoing_thread_serialize_2nd_unlock_fails)
 {
 	// arrange
@@ -3171,14 +3916,15 @@ TEST_FUNCTION(Outprocess_outgoing_thread_serialize_2nd_unlock_fails)
 	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop(IGNORED_PTR_ARG)).IgnoreArgument(1)
 		.SetReturn(msg);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Message_ToByteArray(msg, NULL, 0)).SetReturn(-1);
+	STRICT_EXPECTED_CALL(Message_GetSerialized(msg)).SetReturn(NULL);
 	STRICT_EXPECTED_CALL(Message_Destroy(msg));
-	STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_empty(IGNORED_PTR_ARG)).IgnoreArgument(1)
 		.SetReturn(true);
+	STRICT_EXPECTED_CALL(Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1).IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1)
 		.SetReturn(LOCK_ERROR);
 
@@ -3194,6 +3940,39 @@ TEST_FUNCTION(Outprocess_outgoing_thread_serialize_2nd_unlock_fails)
 	cleanup_create_config(&config);
 }
 
+/*Tests_SRS_OUTPROCESS_MODULE_17_063: [ If the outgoing gateway message queue is empty, this function shall wait on the outgoing message condition until a message is queued or the thread is asked to stop. ]*/
+TEST_FUNCTION(Outprocess_outgoing_thread_condition_wait_fails)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	Module_Start(module);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_empty(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(true);
+	STRICT_EXPECTED_CALL(Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1).IgnoreArgument(2)
+		.SetReturn(COND_ERROR);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
+	// act
+	//third thread created is outgoing message thread
+	thread_func_to_call[3](thread_func_args[3]);
+
+	// assert 
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	//ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
 /*Tests_SRS_OUTPROCESS_MODULE_17_054: [ This function shall remove the oldest message from the outgoing gateway message queue. ]*/
 TEST_FUNCTION(Outprocess_outgoing_thread_queue_has_null_msg_fails)
 {
@@ -3228,6 +4007,172 @@ TEST_FUNCTION(Outprocess_outgoing_thread_queue_has_null_msg_fails)
 	cleanup_create_config(&config);
 }
 
+static void expected_calls_outgoing_batch_loop_start(void)
+{
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_empty(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(false);
+}
+
+static void expected_calls_take_outgoing_messages(MESSAGE_HANDLE* messages, size_t count)
+{
+	size_t i;
+	for (i = 0; i < count; i++)
+	{
+		STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_empty(IGNORED_PTR_ARG)).IgnoreArgument(1)
+			.SetReturn(false);
+		STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop(IGNORED_PTR_ARG)).IgnoreArgument(1)
+			.SetReturn(messages[i]);
+	}
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_empty(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(true);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_071: [ If batch_max_count is greater than 1 and the message channel is not a pair of message rings, the outgoing thread shall send gateway messages in batches. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_072: [ The batching thread shall remove up to batch_max_count of the oldest messages from the outgoing gateway message queue. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_076: [ A frame holding several messages shall be a message batch with the serialized messages in the order they were queued. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_055: [ This function shall Destroy the message once successfully transmitted. ]*/
+TEST_FUNCTION(Outprocess_outgoing_batch_thread_sends_queued_messages_in_one_frame)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_batch_config(&config, 0);
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	Module_Start(module);
+	MESSAGE_HANDLE msgs[2];
+	msgs[0] = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	msgs[1] = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	int32_t frame_size = MESSAGE_BATCH_HEADER_SIZE + 2 * (MESSAGE_BATCH_ENTRY_HEADER_SIZE + default_serialized_size);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)).IgnoreArgument(1);
+	expected_calls_outgoing_batch_loop_start();
+	expected_calls_take_outgoing_messages(msgs, 2);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Message_GetSerialized(msgs[0]));
+	STRICT_EXPECTED_CALL(Message_GetSerialized(msgs[1]));
+	STRICT_EXPECTED_CALL(nn_allocmsg(frame_size, 0));
+	STRICT_EXPECTED_CALL(nn_send(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Message_Destroy(msgs[0]));
+	STRICT_EXPECTED_CALL(Message_Destroy(msgs[1]));
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(LOCK_ERROR);
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
+	// act
+	//third thread created is outgoing message thread
+	thread_func_to_call[3](thread_func_args[3]);
+
+	// assert 
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	//ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_073: [ If the batch is not full and the previous batch held more than one message, the batching thread shall wait once, up to batch_max_linger microseconds rounded up to whole milliseconds, for more messages before sending the batch. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_075: [ A frame holding a single message shall carry the serialized message alone. ]*/
+TEST_FUNCTION(Outprocess_outgoing_batch_thread_lingers_after_a_full_frame)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_batch_config(&config, 0);
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	Module_Start(module);
+	MESSAGE_HANDLE msgs[3];
+	msgs[0] = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	msgs[1] = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	msgs[2] = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	int32_t frame_size = MESSAGE_BATCH_HEADER_SIZE + 2 * (MESSAGE_BATCH_ENTRY_HEADER_SIZE + default_serialized_size);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)).IgnoreArgument(1);
+	expected_calls_outgoing_batch_loop_start();
+	expected_calls_take_outgoing_messages(msgs, 2);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Message_GetSerialized(msgs[0]));
+	STRICT_EXPECTED_CALL(Message_GetSerialized(msgs[1]));
+	STRICT_EXPECTED_CALL(nn_allocmsg(frame_size, 0));
+	STRICT_EXPECTED_CALL(nn_send(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Message_Destroy(msgs[0]));
+	STRICT_EXPECTED_CALL(Message_Destroy(msgs[1]));
+	expected_calls_outgoing_batch_loop_start();
+	expected_calls_take_outgoing_messages(msgs + 2, 1);
+	STRICT_EXPECTED_CALL(Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(1).IgnoreArgument(2)
+		.SetReturn(COND_TIMEOUT);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_empty(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(true);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Message_GetSerialized(msgs[2]));
+	STRICT_EXPECTED_CALL(nn_allocmsg(default_serialized_size, 0));
+	STRICT_EXPECTED_CALL(nn_send(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Message_Destroy(msgs[2]));
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(LOCK_ERROR);
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
+	// act
+	thread_func_to_call[3](thread_func_args[3]);
+
+	// assert 
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	//ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_074: [ The batching thread shall pack consecutive messages into one frame for as long as the frame stays within batch_max_bytes, if set; a message larger than batch_max_bytes shall be sent in a frame of its own. ]*/
+TEST_FUNCTION(Outprocess_outgoing_batch_thread_splits_frames_at_batch_max_bytes)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	int32_t frame_size = MESSAGE_BATCH_HEADER_SIZE + 2 * (MESSAGE_BATCH_ENTRY_HEADER_SIZE + default_serialized_size);
+	setup_create_batch_config(&config, (unsigned int)frame_size);
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	Module_Start(module);
+	MESSAGE_HANDLE msgs[3];
+	msgs[0] = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	msgs[1] = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	msgs[2] = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)).IgnoreArgument(1);
+	expected_calls_outgoing_batch_loop_start();
+	expected_calls_take_outgoing_messages(msgs, 3);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Message_GetSerialized(msgs[0]));
+	STRICT_EXPECTED_CALL(Message_GetSerialized(msgs[1]));
+	STRICT_EXPECTED_CALL(Message_GetSerialized(msgs[2]));
+	STRICT_EXPECTED_CALL(nn_allocmsg(frame_size, 0));
+	STRICT_EXPECTED_CALL(nn_send(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(nn_allocmsg(default_serialized_size, 0));
+	STRICT_EXPECTED_CALL(nn_send(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Message_Destroy(msgs[0]));
+	STRICT_EXPECTED_CALL(Message_Destroy(msgs[1]));
+	STRICT_EXPECTED_CALL(Message_Destroy(msgs[2]));
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(LOCK_ERROR);
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
+	// act
+	thread_func_to_call[3](thread_func_args[3]);
+
+	// assert 
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	//ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
 /*Tests_SRS_OUTPROCESS_MODULE_17_037: [ This function shall receive the module handle data as the thread parameter. ]*/
 TEST_FUNCTION(Outprocess_incoming_thread_does_nothing_null_input)
 {
@@ -3370,7 +4315,6 @@ TEST_FUNCTION(Outprocess_incoming_thread_ends_nn_recv_fails)
 	should_nn_recv_fail = true;
 	STRICT_EXPECTED_CALL(nn_recv(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(nn_errno()).SetReturn(37);
-	STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
 
 	int function_result = (*thread_func_to_call[2])(thread_func_args[2]);
 
@@ -3388,6 +4332,7 @@ TEST_FUNCTION(Outprocess_incoming_thread_ends_nn_recv_fails)
 /*Tests_SRS_OUTPROCESS_MODULE_17_038: [ This function shall read from the message channel for gateway messages from the module host. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_039: [ Upon successful receiving a gateway message, this function shall deserialize the message. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_040: [This function shall publish any successfully created gateway message to the broker.]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_065: [ This function shall not wait between messages; it shall only block on the message channel. ]*/
 TEST_FUNCTION(Outprocess_messaging_thread_ends_one_loop_then_fails)
 {
 	OUTPROCESS_MODULE_CONFIG config;
@@ -3409,7 +4354,6 @@ TEST_FUNCTION(Outprocess_messaging_thread_ends_one_loop_then_fails)
 		.IgnoreAllArguments();
 	STRICT_EXPECTED_CALL(Message_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1).SetReturn(LOCK_ERROR);
 
 	int function_result = (*thread_func_to_call[2])(thread_func_args[2]);
@@ -3423,6 +4367,72 @@ TEST_FUNCTION(Outprocess_messaging_thread_ends_one_loop_then_fails)
 	cleanup_create_config(&config);
 }
 
+/*Tests_SRS_OUTPROCESS_MODULE_17_066: [ If the message channel is a pair of message rings, this function shall wait on the incoming ring for gateway messages from the module host. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_067: [ This function shall deserialize the gateway message directly from the incoming ring, publish it to the broker and then release it from the ring. ]*/
+TEST_FUNCTION(Outprocess_incoming_thread_reads_from_message_ring)
+{
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_shm_config(&config);
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	Module_Start(module);
+
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MessageRing_BeginRead(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(Message_CreateFromByteArray(message_ring_bytes, default_serialized_size));
+	STRICT_EXPECTED_CALL(Broker_Publish((BROKER_HANDLE)0x42, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(2).IgnoreArgument(3);
+	STRICT_EXPECTED_CALL(Message_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MessageRing_EndRead(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1).SetReturn(LOCK_ERROR);
+
+	int function_result = (*thread_func_to_call[2])(thread_func_args[2]);
+
+	// assert
+	ASSERT_ARE_EQUAL(int, function_result, 0);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_066: [ If the message channel is a pair of message rings, this function shall wait on the incoming ring for gateway messages from the module host. ]*/
+TEST_FUNCTION(Outprocess_incoming_thread_ends_message_ring_read_fails)
+{
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_shm_config(&config);
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	Module_Start(module);
+
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MessageRing_BeginRead(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+		.IgnoreAllArguments()
+		.SetReturn(-1);
+
+	int function_result = (*thread_func_to_call[2])(thread_func_args[2]);
+
+	// assert
+	ASSERT_ARE_EQUAL(int, function_result, 0);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
 TEST_FUNCTION(Outprocess_control_thread_does_nothing_with_nothing)
 {
 	// arrange
@@ -17,6 +17,9 @@ typedef struct AZURE_FUNCTIONS_CONFIG_TAG
     STRING_HANDLE hostAddress;
     STRING_HANDLE relativePath;
     STRING_HANDLE securityKey;
+    size_t connections;     /*0 posts each message from the broker thread, on a connection of its own*/
+    size_t maxInFlight;
+    size_t batchSize;
 } AZURE_FUNCTIONS_CONFIG;
 
 MODULE_EXPORT const MODULE_API* MODULE_STATIC_GETAPI(AZUREFUNCTIONS_MODULE)(MODULE_API_VERSION gateway_api_version);
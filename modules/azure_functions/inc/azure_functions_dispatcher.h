@@ -0,0 +1,79 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       azure_functions_dispatcher.h
+ *  @brief      Posts the messages of the azure_functions module to the
+ *              function from a pool of worker threads.
+ *
+ *  @details    The module hands every message it receives to the dispatcher
+ *              and returns to the broker right away. Each worker thread owns
+ *              an HTTPAPIEX handle, its headers and its request path for its
+ *              whole life, so the connection to the function is kept alive
+ *              from one request to the next instead of being opened for each
+ *              message. At most @c maxInFlight messages are queued or being
+ *              posted at any time, past that #AzureFunctionsDispatcher_Send
+ *              waits for a request to complete.
+ *
+ *              With a @c batchSize of 1 a message is posted as the JSON
+ *              object {"content":"<Base64 content>"}. With a larger
+ *              @c batchSize a worker posts up to that many queued messages
+ *              at once, as a JSON array of those objects. A worker never
+ *              waits for a batch to fill, batches only form while every
+ *              worker is busy.
+ */
+
+#ifndef AZURE_FUNCTIONS_DISPATCHER_H
+#define AZURE_FUNCTIONS_DISPATCHER_H
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C"
+{
+#else
+#include <stddef.h>
+#endif
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#include "message.h"
+#include "azure_functions.h"
+
+/** @brief  Messages that can be queued or posted at once when the
+ *          configuration asks for no limit.
+ */
+#define AZURE_FUNCTIONS_DISPATCHER_DEFAULT_MAX_IN_FLIGHT 64
+
+/** @brief  Longest time, in milliseconds, a worker or a sender waits before
+ *          it checks again whether it should stop.
+ */
+#define AZURE_FUNCTIONS_DISPATCHER_PERIOD_MS 1000
+
+typedef struct AZURE_FUNCTIONS_DISPATCHER_TAG* AZURE_FUNCTIONS_DISPATCHER_HANDLE;
+
+/** @brief      Connects the workers to the function named in @c config and
+ *              starts them.
+ *
+ *  @param      config  An #AZURE_FUNCTIONS_CONFIG with at least one
+ *                      connection.
+ *
+ *  @return     A non-NULL #AZURE_FUNCTIONS_DISPATCHER_HANDLE on success, NULL
+ *              on failure.
+ */
+MOCKABLE_FUNCTION(, AZURE_FUNCTIONS_DISPATCHER_HANDLE, AzureFunctionsDispatcher_Create, const AZURE_FUNCTIONS_CONFIG*, config);
+
+/** @brief      Queues @c message to be posted by the next free worker.
+ *
+ *  @return     0 on success, a non-zero value otherwise.
+ */
+MOCKABLE_FUNCTION(, int, AzureFunctionsDispatcher_Send, AZURE_FUNCTIONS_DISPATCHER_HANDLE, dispatcher, MESSAGE_HANDLE, message);
+
+/** @brief      Posts the messages still queued, stops the workers and frees
+ *              all resources.
+ */
+MOCKABLE_FUNCTION(, void, AzureFunctionsDispatcher_Destroy, AZURE_FUNCTIONS_DISPATCHER_HANDLE, dispatcher);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*AZURE_FUNCTIONS_DISPATCHER_H*/
@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include <stddef.h>
+#include <string.h>
 #include <ctype.h>
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/strings.h"
@@ -16,7 +17,8 @@
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/httpapiex.h"
-#include "azure_c_shared_utility/base64.h"
+#include "base64_encoder.h"
+#include "azure_functions_dispatcher.h"
 
 #include <parson.h>
 
@@ -24,8 +26,17 @@ typedef struct AZURE_FUNCTIONS_DATA_TAG
 {
     BROKER_HANDLE broker;
     AZURE_FUNCTIONS_CONFIG *azureFunctionsConfiguration;
+    AZURE_FUNCTIONS_DISPATCHER_HANDLE dispatcher;
 } AZURE_FUNCTIONS_DATA;
 
+#define AZURE_FUNCTIONS_CONNECTIONS_NAME "connections"
+#define AZURE_FUNCTIONS_MAX_IN_FLIGHT_NAME "maxInFlight"
+#define AZURE_FUNCTIONS_BATCH_SIZE_NAME "batchSize"
+
+#define JSON_BODY_START "{\"content\":\""
+#define JSON_BODY_END "\"}"
+#define CONST_STRLEN(s) (sizeof(s) - 1)
+
 #define AZURE_FUNCTIONS_RESULT_VALUES \
     AZURE_FUNCTIONS_OK, \
     AZURE_FUNCTIONS_ERROR, \
@@ -67,6 +78,7 @@ static MODULE_HANDLE AzureFunctions_Create(BROKER_HANDLE broker, const void* con
             }
             else
             {
+                result->dispatcher = NULL;
                 /* Codes_SRS_AZUREFUNCTIONS_04_001: [ Upon success, this function shall return a valid pointer to a MODULE_HANDLE. ] */
                 result->azureFunctionsConfiguration = (AZURE_FUNCTIONS_CONFIG*)malloc(sizeof(AZURE_FUNCTIONS_CONFIG));
                 if (result->azureFunctionsConfiguration == NULL)
@@ -77,6 +89,9 @@ static MODULE_HANDLE AzureFunctions_Create(BROKER_HANDLE broker, const void* con
                 }
                 else
                 {
+                    result->azureFunctionsConfiguration->connections = config->connections;
+                    result->azureFunctionsConfiguration->maxInFlight = config->maxInFlight;
+                    result->azureFunctionsConfiguration->batchSize = config->batchSize;
                     result->azureFunctionsConfiguration->hostAddress = STRING_clone(config->hostAddress);
                     if (result->azureFunctionsConfiguration->hostAddress == NULL)
                     {
@@ -130,6 +145,23 @@ static MODULE_HANDLE AzureFunctions_Create(BROKER_HANDLE broker, const void* con
                     }
                 }
             }
+
+            if ((result != NULL) && (config->connections != 0))
+            {
+                /* Codes_SRS_AZUREFUNCTIONS_17_008: [ If `connections` is not 0, AzureFunctions_Create shall create a dispatcher by calling AzureFunctionsDispatcher_Create with the cloned configuration. ] */
+                result->dispatcher = AzureFunctionsDispatcher_Create(result->azureFunctionsConfiguration);
+                if (result->dispatcher == NULL)
+                {
+                    /* Codes_SRS_AZUREFUNCTIONS_17_009: [ If AzureFunctionsDispatcher_Create fails, AzureFunctions_Create shall release everything it allocated and return NULL. ] */
+                    LogError("unable to create the dispatcher.");
+                    STRING_delete(result->azureFunctionsConfiguration->securityKey);
+                    STRING_delete(result->azureFunctionsConfiguration->relativePath);
+                    STRING_delete(result->azureFunctionsConfiguration->hostAddress);
+                    free(result->azureFunctionsConfiguration);
+                    free(result);
+                    result = NULL;
+                }
+            }
         }
     }
     return result;
@@ -213,18 +245,35 @@ static void * AzureFunctions_ParseConfigurationFromJson(const char* configuratio
                             }
                             else
                             {
-                                /* Codes_SRS_AZUREFUNCTIONS_17_001: [ AzureFunctions_ParseConfigurationFromJson shall allocate an AZURE_FUNCTIONS_CONFIG structure. ]*/
-								result = malloc(sizeof(AZURE_FUNCTIONS_CONFIG));
-								if (result == NULL)
-								{
-                                    /*Codes_SRS_AZUREFUNCTIONS_17_003: [ AzureFunctions_ParseConfigurationFromJson shall return NULL on failure. ]*/
-									LogError("could not allocate AZURE_FUNCTIONS_CONFIG");
-								}
-								else
-								{
-                                    /*Codes_SRS_AZUREFUNCTIONS_17_002: [ AzureFunctions_ParseConfigurationFromJson shall fill the structure with the constructed strings and return it upon success. ]*/
-									*result = config;
-								}
+                                /* Codes_SRS_AZUREFUNCTIONS_17_006: [ AzureFunctions_ParseConfigurationFromJson shall read the optional numbers "connections", "maxInFlight" and "batchSize", taking 0 for any that is not there. ] */
+                                double connections = json_object_get_number(obj, AZURE_FUNCTIONS_CONNECTIONS_NAME);
+                                double maxInFlight = json_object_get_number(obj, AZURE_FUNCTIONS_MAX_IN_FLIGHT_NAME);
+                                double batchSize = json_object_get_number(obj, AZURE_FUNCTIONS_BATCH_SIZE_NAME);
+                                if ((connections < 0) || (maxInFlight < 0) || (batchSize < 0))
+                                {
+                                    /* Codes_SRS_AZUREFUNCTIONS_17_007: [ If any of them is negative, AzureFunctions_ParseConfigurationFromJson shall fail and return NULL. ] */
+                                    LogError("connections, maxInFlight and batchSize cannot be negative.");
+                                    result = NULL;
+                                }
+                                else
+                                {
+                                    config.connections = (size_t)connections;
+                                    config.maxInFlight = (size_t)maxInFlight;
+                                    config.batchSize = (size_t)batchSize;
+
+                                    /* Codes_SRS_AZUREFUNCTIONS_17_001: [ AzureFunctions_ParseConfigurationFromJson shall allocate an AZURE_FUNCTIONS_CONFIG structure. ]*/
+                                    result = malloc(sizeof(AZURE_FUNCTIONS_CONFIG));
+                                    if (result == NULL)
+                                    {
+                                        /*Codes_SRS_AZUREFUNCTIONS_17_003: [ AzureFunctions_ParseConfigurationFromJson shall return NULL on failure. ]*/
+                                        LogError("could not allocate AZURE_FUNCTIONS_CONFIG");
+                                    }
+                                    else
+                                    {
+                                        /*Codes_SRS_AZUREFUNCTIONS_17_002: [ AzureFunctions_ParseConfigurationFromJson shall fill the structure with the constructed strings and return it upon success. ]*/
+                                        *result = config;
+                                    }
+                                }
                             }
                         }
 						if (result == NULL)
@@ -269,6 +318,11 @@ static void AzureFunctions_Destroy(MODULE_HANDLE moduleHandle)
     {
         /* Codes_SRS_AZUREFUNCTIONS_04_009: [ azureFunctions_Destroy shall release all resources allocated for the module. ] */
         AZURE_FUNCTIONS_DATA * moduleData = (AZURE_FUNCTIONS_DATA*)moduleHandle;
+        if (moduleData->dispatcher != NULL)
+        {
+            /* Codes_SRS_AZUREFUNCTIONS_17_010: [ AzureFunctions_Destroy shall destroy the dispatcher, if there is one, before it releases the configuration. ] */
+            AzureFunctionsDispatcher_Destroy(moduleData->dispatcher);
+        }
         STRING_delete(moduleData->azureFunctionsConfiguration->hostAddress);
         STRING_delete(moduleData->azureFunctionsConfiguration->relativePath);
         STRING_delete(moduleData->azureFunctionsConfiguration->securityKey);
@@ -290,6 +344,14 @@ static void AzureFunctions_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE me
         /* Codes_SRS_AZUREFUNCTIONS_04_011: [ If messageHandle is NULL than azureFunctions_Receive shall fail and return. ] */
         LogError("Received NULL arguments: module = %p, massage = %p", moduleHandle, messageHandle);
     }
+    else if (((AZURE_FUNCTIONS_DATA*)moduleHandle)->dispatcher != NULL)
+    {
+        /* Codes_SRS_AZUREFUNCTIONS_17_011: [ If there is a dispatcher, AzureFunctions_Receive shall hand the message to AzureFunctionsDispatcher_Send and return. ] */
+        if (AzureFunctionsDispatcher_Send(((AZURE_FUNCTIONS_DATA*)moduleHandle)->dispatcher, messageHandle) != 0)
+        {
+            LogError("unable to hand the message to the dispatcher.");
+        }
+    }
     else
     {
         AZURE_FUNCTIONS_DATA*module_data = (AZURE_FUNCTIONS_DATA*)moduleHandle;
@@ -303,41 +365,34 @@ static void AzureFunctions_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE me
         }
         else
         {
-            /* Codes_SRS_AZUREFUNCTIONS_04_013: [ AzureFunctions_Receive shall base64 encode by calling Base64_Encode_Bytes, if it fails it shall fail and return. ] */
-			STRING_HANDLE contentAsJSON;
-			if (content->buffer == NULL)
-			{
-				contentAsJSON = STRING_construct_n("", 0);
-			}
-			else
-			{
-				contentAsJSON = Base64_Encode_Bytes(content->buffer, content->size);
-			}
-
-			/* NULL value here will be an error.*/
-            if (contentAsJSON == NULL)
+            /* Codes_SRS_AZUREFUNCTIONS_04_013: [ AzureFunctions_Receive shall size the JSON body with Base64Encoder_GetEncodedSize and allocate it by calling BUFFER_new and BUFFER_pre_build, if it fails it shall fail and return. ] */
+            size_t contentLength = Base64Encoder_GetEncodedSize(content->size);
+            if (((content->buffer == NULL) && (content->size != 0)) ||
+                ((content->size != 0) && (contentLength == 0)))
             {
-                LogError("unable to Base64_Encode_Bytes");
+                LogError("unable to encode message content of size %zu.", content->size);
             }
             else
             {
-                STRING_HANDLE jsonToBeAppended = STRING_construct("{");
-                if (jsonToBeAppended == NULL)
+                BUFFER_HANDLE postContent = BUFFER_new();
+                if (postContent == NULL)
                 {
-                    LogError("unable to STRING_construct");
+                    LogError("Error building post content.");
                 }
                 else
                 {
-                    /* Codes_SRS_AZUREFUNCTIONS_04_024: [ AzureFunctions_Receive shall create a JSON STRING with the content of the message received. If it fails it shall fail and return. ] */
-                    if (!((STRING_concat(jsonToBeAppended, "\"content\":\"") == 0) &&
-                        (STRING_concat_with_STRING(jsonToBeAppended, contentAsJSON) == 0) &&
-                        (STRING_concat(jsonToBeAppended, "\"}") == 0)
-                        ))
+                    if (BUFFER_pre_build(postContent, CONST_STRLEN(JSON_BODY_START) + contentLength + CONST_STRLEN(JSON_BODY_END)) != 0)
                     {
-                        LogError("STRING concatenation error");
+                        LogError("Error building post content.");
                     }
                     else
                     {
+                        /* Codes_SRS_AZUREFUNCTIONS_04_024: [ AzureFunctions_Receive shall write the JSON body {"content":"<content>"} into the buffer, encoding the content of the message straight into it with Base64Encoder_Encode. ] */
+                        unsigned char* body = BUFFER_u_char(postContent);
+                        (void)memcpy(body, JSON_BODY_START, CONST_STRLEN(JSON_BODY_START));
+                        (void)Base64Encoder_Encode(content->buffer, content->size, (char*)body + CONST_STRLEN(JSON_BODY_START));
+                        (void)memcpy(body + CONST_STRLEN(JSON_BODY_START) + contentLength, JSON_BODY_END, CONST_STRLEN(JSON_BODY_END));
+
                         /* Codes_SRS_AZUREFUNCTIONS_04_014: [ azureFunctions_Receive shall call HTTPAPIEX_Create, passing hostAddress, it if fails it shall fail and return. ] */
                         HTTPAPIEX_HANDLE myHTTPEXHandle = HTTPAPIEX_Create(STRING_c_str(module_data->azureFunctionsConfiguration->hostAddress));
                         if (myHTTPEXHandle == NULL)
@@ -391,31 +446,18 @@ static void AzureFunctions_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE me
                                             }
                                             else
                                             {
+                                                unsigned int statuscodeBack = 0;
+                                                /* Codes_SRS_AZUREFUNCTIONS_04_017: [ azureFunctions_Receive shall HTTPAPIEX_ExecuteRequest to send the HTTP POST to Azure Functions. If it fail it shall fail and return. ] */
+                                                HTTPAPIEX_RESULT requestResult = HTTPAPIEX_ExecuteRequest(myHTTPEXHandle, HTTPAPI_REQUEST_POST, STRING_c_str(relativePathInfoForRequest), httpHeaders, postContent, &statuscodeBack, NULL, myResponseBuffer);
 
-                                                //Add here the content on the body.
-                                                size_t appendLength = STRING_length(jsonToBeAppended);
-                                                BUFFER_HANDLE postContent = BUFFER_create((const unsigned char*)STRING_c_str(jsonToBeAppended), appendLength);
-
-                                                if (postContent == NULL)
+                                                if (requestResult != HTTPAPIEX_OK || statuscodeBack != 200)
                                                 {
-                                                    LogError("Error building post content.");
+                                                    LogError("Error Sending Request. Status Code: %d", statuscodeBack);
                                                 }
                                                 else
                                                 {
-                                                    unsigned int statuscodeBack = 0;
-                                                    /* Codes_SRS_AZUREFUNCTIONS_04_017: [ azureFunctions_Receive shall HTTPAPIEX_ExecuteRequest to send the HTTP POST to Azure Functions. If it fail it shall fail and return. ] */
-                                                    HTTPAPIEX_RESULT requestResult = HTTPAPIEX_ExecuteRequest(myHTTPEXHandle, HTTPAPI_REQUEST_POST, STRING_c_str(relativePathInfoForRequest), httpHeaders, postContent, &statuscodeBack, NULL, myResponseBuffer);
-
-                                                    if (requestResult != HTTPAPIEX_OK || statuscodeBack != 200)
-                                                    {
-                                                        LogError("Error Sending Request. Status Code: %d", statuscodeBack);
-                                                    }
-                                                    else
-                                                    {
-                                                        /* Codes_SRS_AZUREFUNCTIONS_04_018: [ Upon success azureFunctions_Receive shall log the response from HTTP POST and return. ] */
-                                                        LogInfo("Request Sent to Function Succesfully. Response from Functions: %s", BUFFER_u_char(myResponseBuffer));
-                                                    }
-                                                    BUFFER_delete(postContent);
+                                                    /* Codes_SRS_AZUREFUNCTIONS_04_018: [ Upon success azureFunctions_Receive shall log the response from HTTP POST and return. ] */
+                                                    LogInfo("Request Sent to Function Succesfully. Response from Functions: %s", BUFFER_u_char(myResponseBuffer));
                                                 }
                                             }
                                             /* Codes_SRS_AZUREFUNCTIONS_04_019: [ azureFunctions_Receive shall destroy any allocated memory before returning. ] */
@@ -433,10 +475,8 @@ static void AzureFunctions_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE me
                         }
                     }
                     /* Codes_SRS_AZUREFUNCTIONS_04_019: [ azureFunctions_Receive shall destroy any allocated memory before returning. ] */
-                    STRING_delete(jsonToBeAppended);
+                    BUFFER_delete(postContent);
                 }
-                /* Codes_SRS_AZUREFUNCTIONS_04_019: [ azureFunctions_Receive shall destroy any allocated memory before returning. ] */
-                STRING_delete(contentAsJSON);
             }
         }
     }
@@ -0,0 +1,538 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "azure_functions_dispatcher.h"
+#include "base64_encoder.h"
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/buffer_.h"
+#include "azure_c_shared_utility/httpapiex.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
+
+#define REQUEST_NAME "?name=myGatewayDevice"
+
+#define JSON_ARRAY_START "["
+#define JSON_ARRAY_SEPARATOR ","
+#define JSON_ARRAY_END "]"
+#define JSON_BODY_START "{\"content\":\""
+#define JSON_BODY_END "\"}"
+#define CONST_STRLEN(s) (sizeof(s) - 1)
+
+struct AZURE_FUNCTIONS_DISPATCHER_TAG;
+
+typedef struct AZURE_FUNCTIONS_CONNECTION_TAG
+{
+    struct AZURE_FUNCTIONS_DISPATCHER_TAG* dispatcher;
+    /*only the worker thread uses the fields below once it runs*/
+    HTTPAPIEX_HANDLE httpApiEx;
+    HTTP_HEADERS_HANDLE headers;
+    BUFFER_HANDLE response;
+    MESSAGE_HANDLE* batch;
+    const CONSTBUFFER** contents;
+    THREAD_HANDLE thread;
+    bool threadStarted;
+} AZURE_FUNCTIONS_CONNECTION;
+
+typedef struct AZURE_FUNCTIONS_DISPATCHER_TAG
+{
+    STRING_HANDLE path;
+    size_t batchSize;
+    size_t connectionCount;
+    AZURE_FUNCTIONS_CONNECTION* connections;
+    /*the fields below are guarded by lock*/
+    MESSAGE_HANDLE* queue;
+    size_t capacity;
+    size_t head;
+    size_t count;               /*messages queued*/
+    size_t inFlight;            /*messages taken by a worker and not posted yet*/
+    bool stopThreads;
+    LOCK_HANDLE lock;
+    COND_HANDLE dataAvailable;
+    COND_HANDLE spaceAvailable;
+} AZURE_FUNCTIONS_DISPATCHER;
+
+/*sizes the request for the messages of a batch and gets their content, a message that cannot be posted is left out*/
+static size_t AzureFunctionsDispatcher_GetBodySize(AZURE_FUNCTIONS_DISPATCHER* dispatcher, AZURE_FUNCTIONS_CONNECTION* connection, size_t count, size_t* posted)
+{
+    size_t result = (dispatcher->batchSize == 1) ? 0 : CONST_STRLEN(JSON_ARRAY_START) + CONST_STRLEN(JSON_ARRAY_END);
+    size_t i;
+    *posted = 0;
+    for (i = 0; i < count; i++)
+    {
+        const CONSTBUFFER* content = Message_GetContent(connection->batch[i]);
+        size_t contentLength = (content == NULL) ? 0 : Base64Encoder_GetEncodedSize(content->size);
+        size_t overhead = CONST_STRLEN(JSON_BODY_START) + CONST_STRLEN(JSON_BODY_END) + ((*posted == 0) ? 0 : CONST_STRLEN(JSON_ARRAY_SEPARATOR));
+        if (
+            (content == NULL) ||
+            ((content->buffer == NULL) && (content->size != 0)) ||
+            ((content->size != 0) && (contentLength == 0)) ||
+            (contentLength > SIZE_MAX - overhead) ||
+            (contentLength + overhead > SIZE_MAX - result)
+            )
+        {
+            /*Codes_SRS_AZURE_FUNCTIONS_DISPATCHER_17_015: [ A worker shall leave out a message whose content cannot be had or encoded. ]*/
+            LogError("unable to encode the content of a message, it is not posted");
+        }
+        else
+        {
+            connection->contents[*posted] = content;
+            (*posted)++;
+            result += contentLength + overhead;
+        }
+    }
+    return result;
+}
+
+static void AzureFunctionsDispatcher_WriteBody(AZURE_FUNCTIONS_DISPATCHER* dispatcher, AZURE_FUNCTIONS_CONNECTION* connection, size_t posted, unsigned char* body)
+{
+    char* out = (char*)body;
+    size_t i;
+    if (dispatcher->batchSize != 1)
+    {
+        (void)memcpy(out, JSON_ARRAY_START, CONST_STRLEN(JSON_ARRAY_START));
+        out += CONST_STRLEN(JSON_ARRAY_START);
+    }
+
+    for (i = 0; i < posted; i++)
+    {
+        if (i != 0)
+        {
+            (void)memcpy(out, JSON_ARRAY_SEPARATOR, CONST_STRLEN(JSON_ARRAY_SEPARATOR));
+            out += CONST_STRLEN(JSON_ARRAY_SEPARATOR);
+        }
+        (void)memcpy(out, JSON_BODY_START, CONST_STRLEN(JSON_BODY_START));
+        out += CONST_STRLEN(JSON_BODY_START);
+        out += Base64Encoder_Encode(connection->contents[i]->buffer, connection->contents[i]->size, out);
+        (void)memcpy(out, JSON_BODY_END, CONST_STRLEN(JSON_BODY_END));
+        out += CONST_STRLEN(JSON_BODY_END);
+    }
+
+    if (dispatcher->batchSize != 1)
+    {
+        (void)memcpy(out, JSON_ARRAY_END, CONST_STRLEN(JSON_ARRAY_END));
+    }
+}
+
+static void AzureFunctionsDispatcher_Post(AZURE_FUNCTIONS_DISPATCHER* dispatcher, AZURE_FUNCTIONS_CONNECTION* connection, size_t count)
+{
+    size_t posted;
+    size_t bodySize = AzureFunctionsDispatcher_GetBodySize(dispatcher, connection, count, &posted);
+    if (posted == 0)
+    {
+        LogError("none of the %zu messages taken can be posted", count);
+    }
+    else
+    {
+        BUFFER_HANDLE body = BUFFER_new();
+        if (body == NULL)
+        {
+            LogError("unable to create the body of a request");
+        }
+        else
+        {
+            if (BUFFER_pre_build(body, bodySize) != 0)
+            {
+                LogError("unable to allocate a body of %zu bytes", bodySize);
+            }
+            else
+            {
+                unsigned int statusCode = 0;
+                /*Codes_SRS_AZURE_FUNCTIONS_DISPATCHER_17_013: [ If `batchSize` is 1, a worker shall post the message as the JSON object `{"content":"<content>"}`, encoding the content with `Base64Encoder_Encode` straight into a buffer sized beforehand. ]*/
+                /*Codes_SRS_AZURE_FUNCTIONS_DISPATCHER_17_014: [ If `batchSize` is larger than 1, a worker shall post the messages it took as one JSON array of those objects. ]*/
+                AzureFunctionsDispatcher_WriteBody(dispatcher, connection, posted, BUFFER_u_char(body));
+
+                /*Codes_SRS_AZURE_FUNCTIONS_DISPATCHER_17_016: [ A worker shall post the body with `HTTPAPIEX_ExecuteRequest` on its own HTTPAPIEX handle, its own headers and the request path, and log a request that fails or gets a status code other than 200. ]*/
+                if (
+                    (HTTPAPIEX_ExecuteRequest(connection->httpApiEx, HTTPAPI_REQUEST_POST, STRING_c_str(dispatcher->path), connection->headers, body, &statusCode, NULL, connection->response) != HTTPAPIEX_OK) ||
+                    (statusCode != 200)
+                    )
+                {
+                    LogError("Error Sending Request. Status Code: %u", statusCode);
+                }
+                else
+                {
+                    LogInfo("%zu messages sent to the function", posted);
+                }
+            }
+            BUFFER_delete(body);
+        }
+    }
+}
+
+static int AzureFunctionsDispatcher_Thread(void* param)
+{
+    AZURE_FUNCTIONS_CONNECTION* connection = (AZURE_FUNCTIONS_CONNECTION*)param;
+    AZURE_FUNCTIONS_DISPATCHER* dispatcher = connection->dispatcher;
+    bool isStopping = false;
+    while (!isStopping)
+    {
+        size_t taken = 0;
+        if (Lock(dispatcher->lock) != LOCK_OK)
+        {
+            LogError("unable to lock, the worker stops");
+            isStopping = true;
+        }
+        else
+        {
+            /*Codes_SRS_AZURE_FUNCTIONS_DISPATCHER_17_012: [ A worker shall wait until messages are queued or `AZURE_FUNCTIONS_DISPATCHER_PERIOD_MS` milliseconds pass, and take up to `batchSize` queued messages under the lock. ]*/
+            if ((dispatcher->count == 0) && !dispatcher->stopThreads)
+            {
+                (void)Condition_Wait(dispatcher->dataAvailable, dispatcher->lock, AZURE_FUNCTIONS_DISPATCHER_PERIOD_MS);
+            }
+
+            while ((taken < dispatcher->batchSize) && (dispatcher->count != 0))
+            {
+                connection->batch[taken++] = dispatcher->queue[dispatcher->head];
+                dispatcher->head = (dispatcher->head + 1) % dispatcher->capacity;
+                dispatcher->count--;
+            }
+
+            if (taken != 0)
+            {
+                dispatcher->inFlight += taken;
+            }
+            else
+            {
+                /*Codes_SRS_AZURE_FUNCTIONS_DISPATCHER_17_018: [ A worker shall return once it is asked to stop and no message is queued. ]*/
+                isStopping = dispatcher->stopThreads;
+            }
+            (void)Unlock(dispatcher->lock);
+        }
+
+        if (taken != 0)
+        {
+            size_t i;
+            AzureFunctionsDispatcher_Post(dispatcher, connection, taken);
+
+            /*Codes_SRS_AZURE_FUNCTIONS_DISPATCHER_17_017: [ Once the request completes, a worker shall destroy the messages it took, give their room back under the lock and wake a waiting sender. ]*/
+            for (i = 0; i < taken; i++)
+            {
+                Message_Destroy(connection->batch[i]);
+            }
+
+            if (Lock(dispatcher->lock) != LOCK_OK)
+            {
+                LogError("unable to lock, %zu messages keep their room", taken);
+            }
+            else
+            {
+                dispatcher->inFlight -= taken;
+                (void)Condition_Post(dispatcher->spaceAvailable);
+                (void)Unlock(dispatcher->lock);
+            }
+        }
+    }
+    return 0;
+}
+
+static int AzureFunctionsConnection_Start(AZURE_FUNCTIONS_DISPATCHER* dispatcher, AZURE_FUNCTIONS_CONNECTION* connection, const AZURE_FUNCTIONS_CONFIG* config)
+{
+    int result;
+    connection->dispatcher = dispatcher;
+    if ((connection->httpApiEx = HTTPAPIEX_Create(STRING_c_str(config->hostAddress))) == NULL)
+    {
+        LogError("unable to create an HTTPAPIEX handle");
+        result = __LINE__;
+    }
+    else if ((connection->headers = HTTPHeaders_Alloc()) == NULL)
+    {
+        LogError("unable to create the headers");
+        result = __LINE__;
+    }
+    else if (
+        (HTTPHeaders_AddHeaderNameValuePair(connection->headers, "Content-Type", "application/json") != HTTP_HEADERS_OK) ||
+        ((config->securityKey != NULL) && (HTTPHeaders_AddHeaderNameValuePair(connection->headers, "x-functions-key", STRING_c_str(config->securityKey)) != HTTP_HEADERS_OK))
+        )
+    {
+        LogError("unable to add the headers");
+        result = __LINE__;
+    }
+    else if ((connection->response = BUFFER_new()) == NULL)
+    {
+        LogError("unable to create the response buffer");
+        result = __LINE__;
+    }
+    else if (
+        ((connection->batch = (MESSAGE_HANDLE*)malloc(dispatcher->batchSize * sizeof(MESSAGE_HANDLE))) == NULL) ||
+        ((connection->contents = (const CONSTBUFFER**)malloc(dispatcher->batchSize * sizeof(const CONSTBUFFER*))) == NULL)
+        )
+    {
+        LogError("unable to allocate a batch of %zu messages", dispatcher->batchSize);
+        result = __LINE__;
+    }
+    else if (ThreadAPI_Create(&connection->thread, AzureFunctionsDispatcher_Thread, connection) != THREADAPI_OK)
+    {
+        LogError("unable to start a worker");
+        result = __LINE__;
+    }
+    else
+    {
+        connection->threadStarted = true;
+        result = 0;
+    }
+    return result;
+}
+
+static void AzureFunctionsDispatcher_Stop(AZURE_FUNCTIONS_DISPATCHER* dispatcher)
+{
+    size_t i;
+    if (Lock(dispatcher->lock) != LOCK_OK)
+    {
+        LogError("unable to lock, stopping the workers anyway");
+        dispatcher->stopThreads = true;
+    }
+    else
+    {
+        dispatcher->stopThreads = true;
+        for (i = 0; i < dispatcher->connectionCount; i++)
+        {
+            (void)Condition_Post(dispatcher->dataAvailable);
+        }
+        (void)Unlock(dispatcher->lock);
+    }
+
+    for (i = 0; i < dispatcher->connectionCount; i++)
+    {
+        int notUsed;
+        if (dispatcher->connections[i].threadStarted)
+        {
+            if (ThreadAPI_Join(dispatcher->connections[i].thread, &notUsed) != THREADAPI_OK)
+            {
+                LogError("unable to join a worker");
+            }
+            dispatcher->connections[i].threadStarted = false;
+        }
+    }
+}
+
+static void AzureFunctionsDispatcher_Free(AZURE_FUNCTIONS_DISPATCHER* dispatcher)
+{
+    size_t i;
+    if (dispatcher->connections != NULL)
+    {
+        for (i = 0; i < dispatcher->connectionCount; i++)
+        {
+            AZURE_FUNCTIONS_CONNECTION* connection = &dispatcher->connections[i];
+            free((void*)connection->contents);
+            free(connection->batch);
+            if (connection->response != NULL)
+            {
+                BUFFER_delete(connection->response);
+            }
+            if (connection->headers != NULL)
+            {
+                HTTPHeaders_Free(connection->headers);
+            }
+            if (connection->httpApiEx != NULL)
+            {
+                HTTPAPIEX_Destroy(connection->httpApiEx);
+            }
+        }
+        free(dispatcher->connections);
+    }
+    if (dispatcher->spaceAvailable != NULL)
+    {
+        Condition_Deinit(dispatcher->spaceAvailable);
+    }
+    if (dispatcher->dataAvailable != NULL)
+    {
+        Condition_Deinit(dispatcher->dataAvailable);
+    }
+    if (dispatcher->lock != NULL)
+    {
+        (void)Lock_Deinit(dispatcher->lock);
+    }
+    free(dispatcher->queue);
+    STRING_delete(dispatcher->path);
+    free(dispatcher);
+}
+
+AZURE_FUNCTIONS_DISPATCHER_HANDLE AzureFunctionsDispatcher_Create(const AZURE_FUNCTIONS_CONFIG* config)
+{
+    AZURE_FUNCTIONS_DISPATCHER* result;
+    if (
+        (config == NULL) ||
+        (config->hostAddress == NULL) ||
+        (config->relativePath == NULL) ||
+        (config->connections == 0)
+        )
+    {
+        /*Codes_SRS_AZURE_FUNCTIONS_DISPATCHER_17_001: [ If `config` is `NULL`, names no `hostAddress` or `relativePath`, or asks for no `connections`, `AzureFunctionsDispatcher_Create` shall fail and return `NULL`. ]*/
+        LogError("invalid arg config=%p", config);
+        result = NULL;
+    }
+    else if ((result = (AZURE_FUNCTIONS_DISPATCHER*)malloc(sizeof(AZURE_FUNCTIONS_DISPATCHER))) == NULL)
+    {
+        /*Codes_SRS_AZURE_FUNCTIONS_DISPATCHER_17_005: [ If any step fails, `AzureFunctionsDispatcher_Create` shall stop the workers it started, release everything it acquired and return `NULL`. ]*/
+        LogError("malloc failed");
+    }
+    else
+    {
+        (void)memset(result, 0, sizeof(AZURE_FUNCTIONS_DISPATCHER));
+        /*Codes_SRS_AZURE_FUNCTIONS_DISPATCHER_17_002: [ `AzureFunctionsDispatcher_Create` shall let up to `maxInFlight` messages, or `AZURE_FUNCTIONS_DISPATCHER_DEFAULT_MAX_IN_FLIGHT` if it is 0, be queued or posted at once, and post up to `batchSize` messages, or 1 if it is 0, per request. ]*/
+        result->capacity = (config->maxInFlight == 0) ? AZURE_FUNCTIONS_DISPATCHER_DEFAULT_MAX_IN_FLIGHT : config->maxInFlight;
+        result->batchSize = (config->batchSize == 0) ? 1 : config->batchSize;
+
+        /*Codes_SRS_AZURE_FUNCTIONS_DISPATCHER_17_003: [ `AzureFunctionsDispatcher_Create` shall build the request path once, as `relativePath` followed by `?name=myGatewayDevice`. ]*/
+        if (
+            ((result->path = STRING_clone(config->relativePath)) == NULL) ||
+            (STRING_concat(result->path, REQUEST_NAME) != 0)
+            )
+        {
+            /*Codes_SRS_AZURE_FUNCTIONS_DISPATCHER_17_005: [ If any step fails, `AzureFunctionsDispatcher_Create` shall stop the workers it started, release everything it acquired and return `NULL`. ]*/
+            LogError("unable to build the request path");
+            AzureFunctionsDispatcher_Free(result);
+            result = NULL;
+        }
+        else if (
+            (result->capacity > SIZE_MAX / sizeof(MESSAGE_HANDLE)) ||
+            (result->batchSize > SIZE_MAX / sizeof(MESSAGE_HANDLE)) ||
+            (config->connections > SIZE_MAX / sizeof(AZURE_FUNCTIONS_CONNECTION)) ||
+            ((result->queue = (MESSAGE_HANDLE*)malloc(result->capacity * sizeof(MESSAGE_HANDLE))) == NULL) ||
+            ((result->connections = (AZURE_FUNCTIONS_CONNECTION*)malloc(config->connections * sizeof(AZURE_FUNCTIONS_CONNECTION))) == NULL)
+            )
+        {
+            /*Codes_SRS_AZURE_FUNCTIONS_DISPATCHER_17_005: [ If any step fails, `AzureFunctionsDispatcher_Create` shall stop the workers it started, release everything it acquired and return `NULL`. ]*/
+            LogError("unable to allocate the queue and the connections");
+            AzureFunctionsDispatcher_Free(result);
+            result = NULL;
+        }
+        else if (
+            ((result->lock = Lock_Init()) == NULL) ||
+            ((result->dataAvailable = Condition_Init()) == NULL) ||
+            ((result->spaceAvailable = Condition_Init()) == NULL)
+            )
+        {
+            /*Codes_SRS_AZURE_FUNCTIONS_DISPATCHER_17_005: [ If any step fails, `AzureFunctionsDispatcher_Create` shall stop the workers it started, release everything it acquired and return `NULL`. ]*/
+            LogError("unable to create the lock and the conditions");
+            AzureFunctionsDispatcher_Free(result);
+            result = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_AZURE_FUNCTIONS_DISPATCHER_17_004: [ For each of `connections`, `AzureFunctionsDispatcher_Create` shall create an HTTPAPIEX handle for `hostAddress`, headers with `Content-Type: application/json` and, if there is a `securityKey`, `x-functions-key: <securityKey>`, a response buffer and a worker thread, all kept until the dispatcher is destroyed. ]*/
+            size_t i;
+            (void)memset(result->connections, 0, config->connections * sizeof(AZURE_FUNCTIONS_CONNECTION));
+            result->connectionCount = config->connections;
+            for (i = 0; i < result->connectionCount; i++)
+            {
+                if (AzureFunctionsConnection_Start(result, &result->connections[i], config) != 0)
+                {
+                    break;
+                }
+            }
+
+            if (i < result->connectionCount)
+            {
+                /*Codes_SRS_AZURE_FUNCTIONS_DISPATCHER_17_005: [ If any step fails, `AzureFunctionsDispatcher_Create` shall stop the workers it started, release everything it acquired and return `NULL`. ]*/
+                LogError("unable to start connection %zu of %zu", i, result->connectionCount);
+                AzureFunctionsDispatcher_Stop(result);
+                AzureFunctionsDispatcher_Free(result);
+                result = NULL;
+            }
+            else
+            {
+                /*Codes_SRS_AZURE_FUNCTIONS_DISPATCHER_17_006: [ Otherwise `AzureFunctionsDispatcher_Create` shall return a non-`NULL` handle. ]*/
+            }
+        }
+    }
+    return result;
+}
+
+int AzureFunctionsDispatcher_Send(AZURE_FUNCTIONS_DISPATCHER_HANDLE dispatcher, MESSAGE_HANDLE message)
+{
+    int result;
+    if ((dispatcher == NULL) || (message == NULL))
+    {
+        /*Codes_SRS_AZURE_FUNCTIONS_DISPATCHER_17_007: [ If `dispatcher` or `message` is `NULL`, `AzureFunctionsDispatcher_Send` shall fail and return a non-zero value. ]*/
+        LogError("invalid arg dispatcher=%p message=%p", dispatcher, message);
+        result = __LINE__;
+    }
+    else
+    {
+        MESSAGE_HANDLE clone = Message_Clone(message);
+        if (clone == NULL)
+        {
+            /*Codes_SRS_AZURE_FUNCTIONS_DISPATCHER_17_010: [ If any step fails, `AzureFunctionsDispatcher_Send` shall release the clone of `message` and return a non-zero value. ]*/
+            LogError("unable to clone the message");
+            result = __LINE__;
+        }
+        else if (Lock(dispatcher->lock) != LOCK_OK)
+        {
+            /*Codes_SRS_AZURE_FUNCTIONS_DISPATCHER_17_010: [ If any step fails, `AzureFunctionsDispatcher_Send` shall release the clone of `message` and return a non-zero value. ]*/
+            LogError("unable to lock");
+            Message_Destroy(clone);
+            result = __LINE__;
+        }
+        else
+        {
+            result = 0;
+            while ((result == 0) && (dispatcher->count + dispatcher->inFlight >= dispatcher->capacity))
+            {
+                /*Codes_SRS_AZURE_FUNCTIONS_DISPATCHER_17_009: [ If `maxInFlight` messages are queued or being posted, `AzureFunctionsDispatcher_Send` shall wait until a worker completes a request. ]*/
+                if (Condition_Wait(dispatcher->spaceAvailable, dispatcher->lock, AZURE_FUNCTIONS_DISPATCHER_PERIOD_MS) == COND_ERROR)
+                {
+                    LogError("unable to wait for a worker");
+                    result = __LINE__;
+                }
+            }
+
+            if (result == 0)
+            {
+                /*Codes_SRS_AZURE_FUNCTIONS_DISPATCHER_17_008: [ `AzureFunctionsDispatcher_Send` shall queue a clone of `message` under the lock and wake a worker. ]*/
+                dispatcher->queue[(dispatcher->head + dispatcher->count) % dispatcher->capacity] = clone;
+                dispatcher->count++;
+                (void)Condition_Post(dispatcher->dataAvailable);
+            }
+            (void)Unlock(dispatcher->lock);
+
+            if (result != 0)
+            {
+                /*Codes_SRS_AZURE_FUNCTIONS_DISPATCHER_17_010: [ If any step fails, `AzureFunctionsDispatcher_Send` shall release the clone of `message` and return a non-zero value. ]*/
+                Message_Destroy(clone);
+            }
+            else
+            {
+                /*Codes_SRS_AZURE_FUNCTIONS_DISPATCHER_17_011: [ Otherwise `AzureFunctionsDispatcher_Send` shall return 0. ]*/
+            }
+        }
+    }
+    return result;
+}
+
+void AzureFunctionsDispatcher_Destroy(AZURE_FUNCTIONS_DISPATCHER_HANDLE dispatcher)
+{
+    if (dispatcher == NULL)
+    {
+        /*Codes_SRS_AZURE_FUNCTIONS_DISPATCHER_17_019: [ If `dispatcher` is `NULL`, `AzureFunctionsDispatcher_Destroy` shall return. ]*/
+        LogError("invalid arg dispatcher=NULL");
+    }
+    else
+    {
+        /*Codes_SRS_AZURE_FUNCTIONS_DISPATCHER_17_020: [ `AzureFunctionsDispatcher_Destroy` shall ask the workers to stop, wake them up and join them, so the messages queued before are posted. ]*/
+        AzureFunctionsDispatcher_Stop(dispatcher);
+
+        /*Codes_SRS_AZURE_FUNCTIONS_DISPATCHER_17_021: [ `AzureFunctionsDispatcher_Destroy` shall destroy the messages the workers left behind and free all resources. ]*/
+        if (dispatcher->count != 0)
+        {
+            LogError("%zu messages were not posted", dispatcher->count);
+            while (dispatcher->count != 0)
+            {
+                Message_Destroy(dispatcher->queue[dispatcher->head]);
+                dispatcher->head = (dispatcher->head + 1) % dispatcher->capacity;
+                dispatcher->count--;
+            }
+        }
+        AzureFunctionsDispatcher_Free(dispatcher);
+    }
+}
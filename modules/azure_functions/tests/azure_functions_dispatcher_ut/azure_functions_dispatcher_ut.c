@@ -0,0 +1,679 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define GATEWAY_EXPORT_H
+#define GATEWAY_EXPORT
+
+void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/buffer_.h"
+#include "azure_c_shared_utility/httpapiex.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "message.h"
+
+#undef ENABLE_MOCKS
+
+#include "azure_functions_dispatcher.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+#ifdef _MSC_VER
+#pragma warning(disable:4505)
+#endif
+
+#define TEST_HOST_ADDRESS ((STRING_HANDLE)0x50)
+#define TEST_RELATIVE_PATH ((STRING_HANDLE)0x51)
+#define TEST_SECURITY_KEY ((STRING_HANDLE)0x52)
+#define TEST_REQUEST_PATH ((STRING_HANDLE)0x60)
+#define TEST_HTTPAPIEX_HANDLE ((HTTPAPIEX_HANDLE)0x61)
+#define TEST_HTTP_HEADERS_HANDLE ((HTTP_HEADERS_HANDLE)0x62)
+
+/*messages are handles 0x42 and up, the content of each is below, the last one has none*/
+#define TEST_MESSAGE(index) ((MESSAGE_HANDLE)(uintptr_t)(0x42 + (index)))
+#define TEST_MESSAGE_WITHOUT_CONTENT TEST_MESSAGE(3)
+
+static const unsigned char content_bytes[] = { 0x01, 0x02, 0x03 };
+static const CONSTBUFFER test_contents[] =
+{
+    { (const unsigned char*)"123", 3 },     /*"MTIz"*/
+    { content_bytes, sizeof(content_bytes) }, /*"AQID"*/
+    { NULL, 0 }                               /*""*/
+};
+
+#define TEST_MAX_THREADS 4
+#define TEST_MAX_POSTS 8
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+/*the workers run when they are joined, so a test sees every request they made once AzureFunctionsDispatcher_Destroy returns*/
+static THREAD_START_FUNC thread_funcs[TEST_MAX_THREADS];
+static void* thread_args[TEST_MAX_THREADS];
+static size_t thread_count;
+static size_t thread_create_fails_at;
+
+static THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
+{
+    THREADAPI_RESULT result;
+    if (thread_count == thread_create_fails_at)
+    {
+        result = THREADAPI_ERROR;
+    }
+    else
+    {
+        ASSERT_IS_TRUE(thread_count < TEST_MAX_THREADS);
+        thread_funcs[thread_count] = func;
+        thread_args[thread_count] = arg;
+        thread_count++;
+        *threadHandle = (THREAD_HANDLE)(uintptr_t)thread_count;
+        result = THREADAPI_OK;
+    }
+    return result;
+}
+
+static THREADAPI_RESULT my_ThreadAPI_Join(THREAD_HANDLE threadHandle, int* res)
+{
+    size_t index = (size_t)(uintptr_t)threadHandle - 1;
+    int thread_result = (*thread_funcs[index])(thread_args[index]);
+    if (res != NULL)
+    {
+        *res = thread_result;
+    }
+    return THREADAPI_OK;
+}
+
+static LOCK_HANDLE my_Lock_Init(void)
+{
+    return (LOCK_HANDLE)my_gballoc_malloc(1);
+}
+
+static LOCK_RESULT my_Lock_Deinit(LOCK_HANDLE handle)
+{
+    my_gballoc_free(handle);
+    return LOCK_OK;
+}
+
+static COND_HANDLE my_Condition_Init(void)
+{
+    return (COND_HANDLE)my_gballoc_malloc(1);
+}
+
+static void my_Condition_Deinit(COND_HANDLE handle)
+{
+    my_gballoc_free(handle);
+}
+
+static COND_RESULT condition_wait_result;
+
+static COND_RESULT my_Condition_Wait(COND_HANDLE handle, LOCK_HANDLE lock, int timeout_milliseconds)
+{
+    (void)handle;
+    (void)lock;
+    (void)timeout_milliseconds;
+    return condition_wait_result;
+}
+
+static const char* my_STRING_c_str(STRING_HANDLE handle)
+{
+    return
+        (handle == TEST_HOST_ADDRESS) ? "host" :
+        (handle == TEST_SECURITY_KEY) ? "key" :
+        (handle == TEST_REQUEST_PATH) ? "path?name=myGatewayDevice" :
+        "path";
+}
+
+/*BUFFER handles are the bytes and the size they hold*/
+typedef struct TEST_BUFFER_TAG
+{
+    unsigned char* data;
+    size_t size;
+} TEST_BUFFER;
+
+static BUFFER_HANDLE my_BUFFER_new(void)
+{
+    TEST_BUFFER* buffer = (TEST_BUFFER*)my_gballoc_malloc(sizeof(TEST_BUFFER));
+    buffer->data = NULL;
+    buffer->size = 0;
+    return (BUFFER_HANDLE)buffer;
+}
+
+static int my_BUFFER_pre_build(BUFFER_HANDLE handle, size_t size)
+{
+    TEST_BUFFER* buffer = (TEST_BUFFER*)handle;
+    buffer->data = (unsigned char*)my_gballoc_malloc(size);
+    buffer->size = size;
+    return 0;
+}
+
+static unsigned char* my_BUFFER_u_char(BUFFER_HANDLE handle)
+{
+    return ((TEST_BUFFER*)handle)->data;
+}
+
+static void my_BUFFER_delete(BUFFER_HANDLE handle)
+{
+    TEST_BUFFER* buffer = (TEST_BUFFER*)handle;
+    my_gballoc_free(buffer->data);
+    my_gballoc_free(buffer);
+}
+
+static size_t httpapiex_create_count;
+
+static HTTPAPIEX_HANDLE my_HTTPAPIEX_Create(const char* hostName)
+{
+    (void)hostName;
+    httpapiex_create_count++;
+    return TEST_HTTPAPIEX_HANDLE;
+}
+
+/*every request is kept as the path and the body it posted*/
+static char posted_paths[TEST_MAX_POSTS][64];
+static char posted_bodies[TEST_MAX_POSTS][128];
+static size_t post_count;
+
+static HTTPAPIEX_RESULT my_HTTPAPIEX_ExecuteRequest(HTTPAPIEX_HANDLE handle, HTTPAPI_REQUEST_TYPE requestType, const char* relativePath,
+    HTTP_HEADERS_HANDLE requestHttpHeadersHandle, BUFFER_HANDLE requestContent, unsigned int* statusCode,
+    HTTP_HEADERS_HANDLE responseHttpHeadersHandle, BUFFER_HANDLE responseContent)
+{
+    TEST_BUFFER* body = (TEST_BUFFER*)requestContent;
+    ASSERT_ARE_EQUAL(void_ptr, TEST_HTTPAPIEX_HANDLE, handle);
+    ASSERT_ARE_EQUAL(int, (int)HTTPAPI_REQUEST_POST, (int)requestType);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_HTTP_HEADERS_HANDLE, requestHttpHeadersHandle);
+    ASSERT_IS_NULL(responseHttpHeadersHandle);
+    ASSERT_IS_NOT_NULL(responseContent);
+    ASSERT_IS_TRUE(post_count < TEST_MAX_POSTS);
+    ASSERT_IS_TRUE(body->size < sizeof(posted_bodies[0]));
+    (void)strcpy(posted_paths[post_count], relativePath);
+    (void)memcpy(posted_bodies[post_count], body->data, body->size);
+    posted_bodies[post_count][body->size] = '\0';
+    post_count++;
+    *statusCode = 200;
+    return HTTPAPIEX_OK;
+}
+
+static const CONSTBUFFER* my_Message_GetContent(MESSAGE_HANDLE message)
+{
+    return (message == TEST_MESSAGE_WITHOUT_CONTENT) ? NULL : &test_contents[(uintptr_t)message - 0x42];
+}
+
+static MESSAGE_HANDLE my_Message_Clone(MESSAGE_HANDLE message)
+{
+    return message;
+}
+
+static AZURE_FUNCTIONS_CONFIG make_config(size_t connections, size_t maxInFlight, size_t batchSize)
+{
+    AZURE_FUNCTIONS_CONFIG config;
+    (void)memset(&config, 0, sizeof(config));
+    config.hostAddress = TEST_HOST_ADDRESS;
+    config.relativePath = TEST_RELATIVE_PATH;
+    config.securityKey = TEST_SECURITY_KEY;
+    config.connections = connections;
+    config.maxInFlight = maxInFlight;
+    config.batchSize = batchSize;
+    return config;
+}
+
+BEGIN_TEST_SUITE(azure_functions_dispatcher_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+    umocktypes_charptr_register_types();
+    umocktypes_stdint_register_types();
+
+    REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTPAPI_REQUEST_TYPE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTP_HEADERS_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTP_HEADERS_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
+
+    // malloc/free hooks
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    // thread hooks
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Join, my_ThreadAPI_Join);
+
+    //Lock Hooks
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Init, my_Lock_Init);
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Deinit, my_Lock_Deinit);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+
+    //Condition Hooks
+    REGISTER_GLOBAL_MOCK_HOOK(Condition_Init, my_Condition_Init);
+    REGISTER_GLOBAL_MOCK_HOOK(Condition_Deinit, my_Condition_Deinit);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Post, COND_OK);
+    REGISTER_GLOBAL_MOCK_HOOK(Condition_Wait, my_Condition_Wait);
+
+    // STRING, BUFFER and HTTP
+    REGISTER_GLOBAL_MOCK_RETURN(STRING_clone, TEST_REQUEST_PATH);
+    REGISTER_GLOBAL_MOCK_RETURN(STRING_concat, 0);
+    REGISTER_GLOBAL_MOCK_HOOK(STRING_c_str, my_STRING_c_str);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_new, my_BUFFER_new);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_pre_build, my_BUFFER_pre_build);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_u_char, my_BUFFER_u_char);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_delete, my_BUFFER_delete);
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_Create, my_HTTPAPIEX_Create);
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, my_HTTPAPIEX_ExecuteRequest);
+    REGISTER_GLOBAL_MOCK_RETURN(HTTPHeaders_Alloc, TEST_HTTP_HEADERS_HANDLE);
+    REGISTER_GLOBAL_MOCK_RETURN(HTTPHeaders_AddHeaderNameValuePair, HTTP_HEADERS_OK);
+
+    // message
+    REGISTER_GLOBAL_MOCK_HOOK(Message_GetContent, my_Message_GetContent);
+    REGISTER_GLOBAL_MOCK_HOOK(Message_Clone, my_Message_Clone);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest) != 0)
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+    thread_count = 0;
+    thread_create_fails_at = TEST_MAX_THREADS;
+    condition_wait_result = COND_OK;
+    httpapiex_create_count = 0;
+    post_count = 0;
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_AZURE_FUNCTIONS_DISPATCHER_17_001: [ If `config` is `NULL`, names no `hostAddress` or `relativePath`, or asks for no `connections`, `AzureFunctionsDispatcher_Create` shall fail and return `NULL`. ]*/
+TEST_FUNCTION(AzureFunctionsDispatcher_Create_with_bad_config_fails)
+{
+    ///arrange
+    AZURE_FUNCTIONS_CONFIG noConnections = make_config(0, 0, 0);
+    AZURE_FUNCTIONS_CONFIG noHostAddress = make_config(1, 0, 0);
+    AZURE_FUNCTIONS_CONFIG noRelativePath = make_config(1, 0, 0);
+    noHostAddress.hostAddress = NULL;
+    noRelativePath.relativePath = NULL;
+
+    ///act
+    AZURE_FUNCTIONS_DISPATCHER_HANDLE result1 = AzureFunctionsDispatcher_Create(NULL);
+    AZURE_FUNCTIONS_DISPATCHER_HANDLE result2 = AzureFunctionsDispatcher_Create(&noConnections);
+    AZURE_FUNCTIONS_DISPATCHER_HANDLE result3 = AzureFunctionsDispatcher_Create(&noHostAddress);
+    AZURE_FUNCTIONS_DISPATCHER_HANDLE result4 = AzureFunctionsDispatcher_Create(&noRelativePath);
+
+    ///assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+    ASSERT_IS_NULL(result3);
+    ASSERT_IS_NULL(result4);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_AZURE_FUNCTIONS_DISPATCHER_17_002: [ `AzureFunctionsDispatcher_Create` shall let up to `maxInFlight` messages, or `AZURE_FUNCTIONS_DISPATCHER_DEFAULT_MAX_IN_FLIGHT` if it is 0, be queued or posted at once, and post up to `batchSize` messages, or 1 if it is 0, per request. ]*/
+/*Tests_SRS_AZURE_FUNCTIONS_DISPATCHER_17_003: [ `AzureFunctionsDispatcher_Create` shall build the request path once, as `relativePath` followed by `?name=myGatewayDevice`. ]*/
+/*Tests_SRS_AZURE_FUNCTIONS_DISPATCHER_17_004: [ For each of `connections`, `AzureFunctionsDispatcher_Create` shall create an HTTPAPIEX handle for `hostAddress`, headers with `Content-Type: application/json` and, if there is a `securityKey`, `x-functions-key: <securityKey>`, a response buffer and a worker thread, all kept until the dispatcher is destroyed. ]*/
+/*Tests_SRS_AZURE_FUNCTIONS_DISPATCHER_17_006: [ Otherwise `AzureFunctionsDispatcher_Create` shall return a non-`NULL` handle. ]*/
+TEST_FUNCTION(AzureFunctionsDispatcher_Create_succeeds)
+{
+    ///arrange
+    AZURE_FUNCTIONS_CONFIG config = make_config(1, 0, 0);
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*the dispatcher*/
+    STRICT_EXPECTED_CALL(STRING_clone(TEST_RELATIVE_PATH));
+    STRICT_EXPECTED_CALL(STRING_concat(TEST_REQUEST_PATH, "?name=myGatewayDevice"));
+    STRICT_EXPECTED_CALL(gballoc_malloc(AZURE_FUNCTIONS_DISPATCHER_DEFAULT_MAX_IN_FLIGHT * sizeof(MESSAGE_HANDLE)));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*the connections*/
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_HOST_ADDRESS));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create("host"));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(TEST_HTTP_HEADERS_HANDLE, "Content-Type", "application/json"));
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_SECURITY_KEY));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(TEST_HTTP_HEADERS_HANDLE, "x-functions-key", "key"));
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(MESSAGE_HANDLE)));
+    STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(const CONSTBUFFER*)));
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    ///act
+    AZURE_FUNCTIONS_DISPATCHER_HANDLE result = AzureFunctionsDispatcher_Create(&config);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, thread_count);
+
+    ///cleanup
+    AzureFunctionsDispatcher_Destroy(result);
+}
+
+/*Tests_SRS_AZURE_FUNCTIONS_DISPATCHER_17_005: [ If any step fails, `AzureFunctionsDispatcher_Create` shall stop the workers it started, release everything it acquired and return `NULL`. ]*/
+TEST_FUNCTION(AzureFunctionsDispatcher_Create_fails_when_a_worker_cannot_start)
+{
+    ///arrange
+    AZURE_FUNCTIONS_CONFIG config = make_config(2, 0, 0);
+    thread_create_fails_at = 1;
+
+    ///act
+    AZURE_FUNCTIONS_DISPATCHER_HANDLE result = AzureFunctionsDispatcher_Create(&config);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(size_t, 2, httpapiex_create_count);
+    ASSERT_ARE_EQUAL(size_t, 0, post_count);
+}
+
+/*Tests_SRS_AZURE_FUNCTIONS_DISPATCHER_17_007: [ If `dispatcher` or `message` is `NULL`, `AzureFunctionsDispatcher_Send` shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(AzureFunctionsDispatcher_Send_with_NULL_args_fails)
+{
+    ///arrange
+    AZURE_FUNCTIONS_CONFIG config = make_config(1, 0, 0);
+    AZURE_FUNCTIONS_DISPATCHER_HANDLE dispatcher = AzureFunctionsDispatcher_Create(&config);
+    umock_c_reset_all_calls();
+
+    ///act
+    int result1 = AzureFunctionsDispatcher_Send(NULL, TEST_MESSAGE(0));
+    int result2 = AzureFunctionsDispatcher_Send(dispatcher, NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    AzureFunctionsDispatcher_Destroy(dispatcher);
+}
+
+/*Tests_SRS_AZURE_FUNCTIONS_DISPATCHER_17_008: [ `AzureFunctionsDispatcher_Send` shall queue a clone of `message` under the lock and wake a worker. ]*/
+/*Tests_SRS_AZURE_FUNCTIONS_DISPATCHER_17_011: [ Otherwise `AzureFunctionsDispatcher_Send` shall return 0. ]*/
+TEST_FUNCTION(AzureFunctionsDispatcher_Send_queues_a_clone_of_the_message)
+{
+    ///arrange
+    AZURE_FUNCTIONS_CONFIG config = make_config(1, 0, 0);
+    AZURE_FUNCTIONS_DISPATCHER_HANDLE dispatcher = AzureFunctionsDispatcher_Create(&config);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Message_Clone(TEST_MESSAGE(0)));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Post(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    ///act
+    int result = AzureFunctionsDispatcher_Send(dispatcher, TEST_MESSAGE(0));
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    AzureFunctionsDispatcher_Destroy(dispatcher);
+}
+
+/*Tests_SRS_AZURE_FUNCTIONS_DISPATCHER_17_010: [ If any step fails, `AzureFunctionsDispatcher_Send` shall release the clone of `message` and return a non-zero value. ]*/
+TEST_FUNCTION(AzureFunctionsDispatcher_Send_fails_when_the_message_cannot_be_cloned)
+{
+    ///arrange
+    AZURE_FUNCTIONS_CONFIG config = make_config(1, 0, 0);
+    AZURE_FUNCTIONS_DISPATCHER_HANDLE dispatcher = AzureFunctionsDispatcher_Create(&config);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Message_Clone(TEST_MESSAGE(0)))
+        .SetReturn(NULL);
+
+    ///act
+    int result = AzureFunctionsDispatcher_Send(dispatcher, TEST_MESSAGE(0));
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    AzureFunctionsDispatcher_Destroy(dispatcher);
+    ASSERT_ARE_EQUAL(size_t, 0, post_count);
+}
+
+/*Tests_SRS_AZURE_FUNCTIONS_DISPATCHER_17_009: [ If `maxInFlight` messages are queued or being posted, `AzureFunctionsDispatcher_Send` shall wait until a worker completes a request. ]*/
+/*Tests_SRS_AZURE_FUNCTIONS_DISPATCHER_17_010: [ If any step fails, `AzureFunctionsDispatcher_Send` shall release the clone of `message` and return a non-zero value. ]*/
+TEST_FUNCTION(AzureFunctionsDispatcher_Send_waits_for_room_when_maxInFlight_messages_are_queued)
+{
+    ///arrange
+    AZURE_FUNCTIONS_CONFIG config = make_config(1, 1, 0);
+    AZURE_FUNCTIONS_DISPATCHER_HANDLE dispatcher = AzureFunctionsDispatcher_Create(&config);
+    ASSERT_ARE_EQUAL(int, 0, AzureFunctionsDispatcher_Send(dispatcher, TEST_MESSAGE(0)));
+    umock_c_reset_all_calls();
+    condition_wait_result = COND_ERROR;
+
+    STRICT_EXPECTED_CALL(Message_Clone(TEST_MESSAGE(1)));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, AZURE_FUNCTIONS_DISPATCHER_PERIOD_MS));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Message_Destroy(TEST_MESSAGE(1)));
+
+    ///act
+    int result = AzureFunctionsDispatcher_Send(dispatcher, TEST_MESSAGE(1));
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    condition_wait_result = COND_OK;
+    AzureFunctionsDispatcher_Destroy(dispatcher);
+    ASSERT_ARE_EQUAL(size_t, 1, post_count);
+}
+
+/*Tests_SRS_AZURE_FUNCTIONS_DISPATCHER_17_012: [ A worker shall wait until messages are queued or `AZURE_FUNCTIONS_DISPATCHER_PERIOD_MS` milliseconds pass, and take up to `batchSize` queued messages under the lock. ]*/
+/*Tests_SRS_AZURE_FUNCTIONS_DISPATCHER_17_013: [ If `batchSize` is 1, a worker shall post the message as the JSON object `{"content":"<content>"}`, encoding the content with `Base64Encoder_Encode` straight into a buffer sized beforehand. ]*/
+/*Tests_SRS_AZURE_FUNCTIONS_DISPATCHER_17_016: [ A worker shall post the body with `HTTPAPIEX_ExecuteRequest` on its own HTTPAPIEX handle, its own headers and the request path, and log a request that fails or gets a status code other than 200. ]*/
+TEST_FUNCTION(AzureFunctionsDispatcher_worker_posts_a_message_as_a_json_object)
+{
+    ///arrange
+    AZURE_FUNCTIONS_CONFIG config = make_config(1, 0, 0);
+    AZURE_FUNCTIONS_DISPATCHER_HANDLE dispatcher = AzureFunctionsDispatcher_Create(&config);
+    ASSERT_ARE_EQUAL(int, 0, AzureFunctionsDispatcher_Send(dispatcher, TEST_MESSAGE(0)));
+
+    ///act
+    AzureFunctionsDispatcher_Destroy(dispatcher);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, post_count);
+    ASSERT_ARE_EQUAL(char_ptr, "path?name=myGatewayDevice", posted_paths[0]);
+    ASSERT_ARE_EQUAL(char_ptr, "{\"content\":\"MTIz\"}", posted_bodies[0]);
+}
+
+/*Tests_SRS_AZURE_FUNCTIONS_DISPATCHER_17_016: [ A worker shall post the body with `HTTPAPIEX_ExecuteRequest` on its own HTTPAPIEX handle, its own headers and the request path, and log a request that fails or gets a status code other than 200. ]*/
+/*Tests_SRS_AZURE_FUNCTIONS_DISPATCHER_17_017: [ Once the request completes, a worker shall destroy the messages it took, give their room back under the lock and wake a waiting sender. ]*/
+TEST_FUNCTION(AzureFunctionsDispatcher_worker_keeps_its_connection_from_one_request_to_the_next)
+{
+    ///arrange
+    AZURE_FUNCTIONS_CONFIG config = make_config(1, 2, 1);
+    AZURE_FUNCTIONS_DISPATCHER_HANDLE dispatcher = AzureFunctionsDispatcher_Create(&config);
+    ASSERT_ARE_EQUAL(int, 0, AzureFunctionsDispatcher_Send(dispatcher, TEST_MESSAGE(0)));
+    ASSERT_ARE_EQUAL(int, 0, AzureFunctionsDispatcher_Send(dispatcher, TEST_MESSAGE(1)));
+
+    ///act
+    AzureFunctionsDispatcher_Destroy(dispatcher);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, httpapiex_create_count);
+    ASSERT_ARE_EQUAL(size_t, 2, post_count);
+    ASSERT_ARE_EQUAL(char_ptr, "{\"content\":\"MTIz\"}", posted_bodies[0]);
+    ASSERT_ARE_EQUAL(char_ptr, "{\"content\":\"AQID\"}", posted_bodies[1]);
+}
+
+/*Tests_SRS_AZURE_FUNCTIONS_DISPATCHER_17_014: [ If `batchSize` is larger than 1, a worker shall post the messages it took as one JSON array of those objects. ]*/
+TEST_FUNCTION(AzureFunctionsDispatcher_worker_posts_queued_messages_as_one_json_array)
+{
+    ///arrange
+    AZURE_FUNCTIONS_CONFIG config = make_config(1, 0, 4);
+    AZURE_FUNCTIONS_DISPATCHER_HANDLE dispatcher = AzureFunctionsDispatcher_Create(&config);
+    ASSERT_ARE_EQUAL(int, 0, AzureFunctionsDispatcher_Send(dispatcher, TEST_MESSAGE(0)));
+    ASSERT_ARE_EQUAL(int, 0, AzureFunctionsDispatcher_Send(dispatcher, TEST_MESSAGE(1)));
+    ASSERT_ARE_EQUAL(int, 0, AzureFunctionsDispatcher_Send(dispatcher, TEST_MESSAGE(2)));
+
+    ///act
+    AzureFunctionsDispatcher_Destroy(dispatcher);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, post_count);
+    ASSERT_ARE_EQUAL(char_ptr, "[{\"content\":\"MTIz\"},{\"content\":\"AQID\"},{\"content\":\"\"}]", posted_bodies[0]);
+}
+
+/*Tests_SRS_AZURE_FUNCTIONS_DISPATCHER_17_012: [ A worker shall wait until messages are queued or `AZURE_FUNCTIONS_DISPATCHER_PERIOD_MS` milliseconds pass, and take up to `batchSize` queued messages under the lock. ]*/
+/*Tests_SRS_AZURE_FUNCTIONS_DISPATCHER_17_014: [ If `batchSize` is larger than 1, a worker shall post the messages it took as one JSON array of those objects. ]*/
+TEST_FUNCTION(AzureFunctionsDispatcher_worker_posts_at_most_batchSize_messages_per_request)
+{
+    ///arrange
+    AZURE_FUNCTIONS_CONFIG config = make_config(1, 0, 2);
+    AZURE_FUNCTIONS_DISPATCHER_HANDLE dispatcher = AzureFunctionsDispatcher_Create(&config);
+    ASSERT_ARE_EQUAL(int, 0, AzureFunctionsDispatcher_Send(dispatcher, TEST_MESSAGE(0)));
+    ASSERT_ARE_EQUAL(int, 0, AzureFunctionsDispatcher_Send(dispatcher, TEST_MESSAGE(1)));
+    ASSERT_ARE_EQUAL(int, 0, AzureFunctionsDispatcher_Send(dispatcher, TEST_MESSAGE(2)));
+
+    ///act
+    AzureFunctionsDispatcher_Destroy(dispatcher);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 2, post_count);
+    ASSERT_ARE_EQUAL(char_ptr, "[{\"content\":\"MTIz\"},{\"content\":\"AQID\"}]", posted_bodies[0]);
+    ASSERT_ARE_EQUAL(char_ptr, "[{\"content\":\"\"}]", posted_bodies[1]);
+}
+
+/*Tests_SRS_AZURE_FUNCTIONS_DISPATCHER_17_015: [ A worker shall leave out a message whose content cannot be had or encoded. ]*/
+TEST_FUNCTION(AzureFunctionsDispatcher_worker_leaves_out_a_message_without_content)
+{
+    ///arrange
+    AZURE_FUNCTIONS_CONFIG config = make_config(1, 0, 2);
+    AZURE_FUNCTIONS_DISPATCHER_HANDLE dispatcher = AzureFunctionsDispatcher_Create(&config);
+    ASSERT_ARE_EQUAL(int, 0, AzureFunctionsDispatcher_Send(dispatcher, TEST_MESSAGE_WITHOUT_CONTENT));
+    ASSERT_ARE_EQUAL(int, 0, AzureFunctionsDispatcher_Send(dispatcher, TEST_MESSAGE(0)));
+    ASSERT_ARE_EQUAL(int, 0, AzureFunctionsDispatcher_Send(dispatcher, TEST_MESSAGE_WITHOUT_CONTENT));
+
+    ///act
+    AzureFunctionsDispatcher_Destroy(dispatcher);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, post_count);
+    ASSERT_ARE_EQUAL(char_ptr, "[{\"content\":\"MTIz\"}]", posted_bodies[0]);
+}
+
+/*Tests_SRS_AZURE_FUNCTIONS_DISPATCHER_17_018: [ A worker shall return once it is asked to stop and no message is queued. ]*/
+/*Tests_SRS_AZURE_FUNCTIONS_DISPATCHER_17_020: [ `AzureFunctionsDispatcher_Destroy` shall ask the workers to stop, wake them up and join them, so the messages queued before are posted. ]*/
+TEST_FUNCTION(AzureFunctionsDispatcher_Destroy_posts_the_queued_messages_with_every_worker_stopped)
+{
+    ///arrange
+    AZURE_FUNCTIONS_CONFIG config = make_config(2, 0, 0);
+    AZURE_FUNCTIONS_DISPATCHER_HANDLE dispatcher = AzureFunctionsDispatcher_Create(&config);
+    ASSERT_ARE_EQUAL(int, 0, AzureFunctionsDispatcher_Send(dispatcher, TEST_MESSAGE(0)));
+    ASSERT_ARE_EQUAL(int, 0, AzureFunctionsDispatcher_Send(dispatcher, TEST_MESSAGE(1)));
+    umock_c_reset_all_calls();
+
+    ///act
+    AzureFunctionsDispatcher_Destroy(dispatcher);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 2, thread_count);
+    ASSERT_ARE_EQUAL(size_t, 2, post_count);
+}
+
+/*Tests_SRS_AZURE_FUNCTIONS_DISPATCHER_17_019: [ If `dispatcher` is `NULL`, `AzureFunctionsDispatcher_Destroy` shall return. ]*/
+TEST_FUNCTION(AzureFunctionsDispatcher_Destroy_with_NULL_does_nothing)
+{
+    ///act
+    AzureFunctionsDispatcher_Destroy(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_AZURE_FUNCTIONS_DISPATCHER_17_021: [ `AzureFunctionsDispatcher_Destroy` shall destroy the messages the workers left behind and free all resources. ]*/
+TEST_FUNCTION(AzureFunctionsDispatcher_Destroy_destroys_the_messages_no_worker_could_take)
+{
+    ///arrange
+    AZURE_FUNCTIONS_CONFIG config = make_config(1, 0, 0);
+    AZURE_FUNCTIONS_DISPATCHER_HANDLE dispatcher = AzureFunctionsDispatcher_Create(&config);
+    ASSERT_ARE_EQUAL(int, 0, AzureFunctionsDispatcher_Send(dispatcher, TEST_MESSAGE(0)));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Post(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)) /*the worker cannot lock and stops*/
+        .SetReturn(LOCK_ERROR);
+    STRICT_EXPECTED_CALL(Message_Destroy(TEST_MESSAGE(0)));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(TEST_HTTP_HEADERS_HANDLE));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(TEST_HTTPAPIEX_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(TEST_REQUEST_PATH));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    ///act
+    AzureFunctionsDispatcher_Destroy(dispatcher);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, post_count);
+}
+
+END_TEST_SUITE(azure_functions_dispatcher_ut)
@@ -3,8 +3,12 @@
 
 #ifdef __cplusplus
 #include <cstdlib>
+#include <cstdint>
+#include <cstring>
 #else
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #endif
 
 #include "testrunnerswitcher.h"
@@ -37,12 +41,14 @@ static void my_gballoc_free(void* s)
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/httpapiex.h"
 #include "message.h"
-#include "azure_c_shared_utility/base64.h"
+#include "azure_c_shared_utility/buffer_.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "parson.h"
+#include "azure_functions_dispatcher.h"
 
 MOCKABLE_FUNCTION(, JSON_Value*, json_parse_string, const char *, string);
 MOCKABLE_FUNCTION(, const char*, json_object_get_string, const JSON_Object *, object, const char *, name);
+MOCKABLE_FUNCTION(, double, json_object_get_number, const JSON_Object *, object, const char *, name);
 MOCKABLE_FUNCTION(, void, json_value_free, JSON_Value *, value);
 MOCKABLE_FUNCTION(, JSON_Object*, json_value_get_object, const JSON_Value *, value);
 
@@ -51,6 +57,20 @@ MOCKABLE_FUNCTION(, JSON_Object*, json_value_get_object, const JSON_Value *, val
 
 #include "azure_functions.h"
 
+/*"12345" with its '\0' takes 8 characters in Base64*/
+#define TEST_BODY "{\"content\":\"MTIzNDUA\"}"
+#define TEST_BODY_SIZE (sizeof(TEST_BODY) - 1)
+#define TEST_EMPTY_BODY "{\"content\":\"\"}"
+#define TEST_EMPTY_BODY_SIZE (sizeof(TEST_EMPTY_BODY) - 1)
+
+static unsigned char test_post_content[64];
+
+static unsigned char* my_BUFFER_u_char(BUFFER_HANDLE handle)
+{
+    (void)handle;
+    return test_post_content;
+}
+
 
 static TEST_MUTEX_HANDLE g_testByTest;
 static TEST_MUTEX_HANDLE g_dllByDll;
@@ -78,6 +98,7 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_u_char, my_BUFFER_u_char);
 
     REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
 
@@ -96,6 +117,8 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(HTTPAPI_REQUEST_TYPE, int);
 
     REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_RESULT, int);
+
+    REGISTER_UMOCK_ALIAS_TYPE(AZURE_FUNCTIONS_DISPATCHER_HANDLE, void*);
 }
 
 TEST_SUITE_CLEANUP(suite_cleanup)
@@ -390,6 +413,13 @@ TEST_FUNCTION(AZUREFUNCTIONS_CreateFromJson_returns_NULL_when_alloc_fails)
         .IgnoreAllArguments()
         .SetReturn((STRING_HANDLE)0x42);
 
+    STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x42, "connections"))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x42, "maxInFlight"))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x42, "batchSize"))
+        .IgnoreArgument(2);
+
     STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(AZURE_FUNCTIONS_CONFIG)))
         .SetReturn(NULL);
 
@@ -459,6 +489,13 @@ TEST_FUNCTION(AZUREFUNCTIONS_CreateFromJson_happy_path)
         .IgnoreAllArguments()
         .SetReturn((STRING_HANDLE)0x42);
 
+    STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x42, "connections"))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x42, "maxInFlight"))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x42, "batchSize"))
+        .IgnoreArgument(2);
+
     STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(AZURE_FUNCTIONS_CONFIG)));
 
     STRICT_EXPECTED_CALL(json_value_free((JSON_Value*)0x42));
@@ -520,6 +557,13 @@ TEST_FUNCTION(AZURE_FUNCTIONS_FreeConfiguration_frees_config)
 		.IgnoreAllArguments()
 		.SetReturn((STRING_HANDLE)0x42);
 
+	STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x42, "connections"))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x42, "maxInFlight"))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x42, "batchSize"))
+		.IgnoreArgument(2);
+
 	STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(AZURE_FUNCTIONS_CONFIG)));
 
 	STRICT_EXPECTED_CALL(json_value_free((JSON_Value*)0x42));
@@ -547,6 +591,107 @@ TEST_FUNCTION(AZURE_FUNCTIONS_FreeConfiguration_frees_config)
 
 }
 
+/*Tests_SRS_AZUREFUNCTIONS_17_006: [ AzureFunctions_ParseConfigurationFromJson shall read the optional numbers "connections", "maxInFlight" and "batchSize", taking 0 for any that is not there. ]*/
+TEST_FUNCTION(AZUREFUNCTIONS_CreateFromJson_reads_connections_maxInFlight_and_batchSize)
+{
+    // arrange
+    const MODULE_API* apis = Module_GetApi(MODULE_API_VERSION_1);
+
+    STRICT_EXPECTED_CALL(json_parse_string((const char*)0x42))
+        .SetReturn((JSON_Value*)0x42);
+    STRICT_EXPECTED_CALL(json_value_get_object((JSON_Value*)0x42))
+        .SetReturn((JSON_Object*)0x42);
+    STRICT_EXPECTED_CALL(json_object_get_string((const JSON_Object*)0x42, "hostname"))
+        .IgnoreArgument(2)
+        .SetReturn("HostName42");
+    STRICT_EXPECTED_CALL(json_object_get_string((const JSON_Object*)0x42, "relativePath"))
+        .IgnoreArgument(2)
+        .SetReturn("relativePath42");
+    STRICT_EXPECTED_CALL(json_object_get_string((const JSON_Object*)0x42, "key"))
+        .IgnoreArgument(2)
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .SetReturn((STRING_HANDLE)0x42);
+    STRICT_EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .SetReturn((STRING_HANDLE)0x42);
+    STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x42, "connections"))
+        .IgnoreArgument(2)
+        .SetReturn(4);
+    STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x42, "maxInFlight"))
+        .IgnoreArgument(2)
+        .SetReturn(64);
+    STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x42, "batchSize"))
+        .IgnoreArgument(2)
+        .SetReturn(16);
+    STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(AZURE_FUNCTIONS_CONFIG)));
+    STRICT_EXPECTED_CALL(json_value_free((JSON_Value*)0x42));
+
+    // act
+    AZURE_FUNCTIONS_CONFIG* result = (AZURE_FUNCTIONS_CONFIG*)MODULE_PARSE_CONFIGURATION_FROM_JSON(apis)((const char*)0x42);
+
+    //assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 4, result->connections);
+    ASSERT_ARE_EQUAL(size_t, 64, result->maxInFlight);
+    ASSERT_ARE_EQUAL(size_t, 16, result->batchSize);
+
+    //cleanup
+    MODULE_FREE_CONFIGURATION(apis)(result);
+}
+
+/*Tests_SRS_AZUREFUNCTIONS_17_007: [ If any of them is negative, AzureFunctions_ParseConfigurationFromJson shall fail and return NULL. ]*/
+TEST_FUNCTION(AZUREFUNCTIONS_CreateFromJson_returns_NULL_when_a_number_is_negative)
+{
+    // arrange
+    const MODULE_API* apis = Module_GetApi(MODULE_API_VERSION_1);
+
+    STRICT_EXPECTED_CALL(json_parse_string((const char*)0x42))
+        .SetReturn((JSON_Value*)0x42);
+    STRICT_EXPECTED_CALL(json_value_get_object((JSON_Value*)0x42))
+        .SetReturn((JSON_Object*)0x42);
+    STRICT_EXPECTED_CALL(json_object_get_string((const JSON_Object*)0x42, "hostname"))
+        .IgnoreArgument(2)
+        .SetReturn("HostName42");
+    STRICT_EXPECTED_CALL(json_object_get_string((const JSON_Object*)0x42, "relativePath"))
+        .IgnoreArgument(2)
+        .SetReturn("relativePath42");
+    STRICT_EXPECTED_CALL(json_object_get_string((const JSON_Object*)0x42, "key"))
+        .IgnoreArgument(2)
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .SetReturn((STRING_HANDLE)0x42);
+    STRICT_EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .SetReturn((STRING_HANDLE)0x42);
+    STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x42, "connections"))
+        .IgnoreArgument(2)
+        .SetReturn(4);
+    STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x42, "maxInFlight"))
+        .IgnoreArgument(2)
+        .SetReturn(-1);
+    STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x42, "batchSize"))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
+    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
+    STRICT_EXPECTED_CALL(STRING_delete(NULL));
+    STRICT_EXPECTED_CALL(json_value_free((JSON_Value*)0x42));
+
+    // act
+    void* result = MODULE_PARSE_CONFIGURATION_FROM_JSON(apis)((const char*)0x42);
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
 /* Tests_SRS_AZUREFUNCTIONS_04_001: [ Upon success, this function shall return a valid pointer to a MODULE_HANDLE. ] */
 TEST_FUNCTION(AZURE_FUNCTIONS_Create_happy_Path_with_key)
 {
@@ -555,6 +700,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Create_happy_Path_with_key)
 
 
     AZURE_FUNCTIONS_CONFIG config;
+    (void)memset(&config, 0, sizeof(config));
     config.relativePath = (STRING_HANDLE)0x42;
     config.hostAddress = (STRING_HANDLE)0x42;
     config.securityKey = (STRING_HANDLE)0x42;
@@ -601,6 +747,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Create_happy_Path_without_key)
 
 
     AZURE_FUNCTIONS_CONFIG config;
+    (void)memset(&config, 0, sizeof(config));
     config.relativePath = (STRING_HANDLE)0x42;
     config.hostAddress = (STRING_HANDLE)0x42;
     config.securityKey = NULL;
@@ -673,6 +820,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Create_returns_NULL_when_hostAddress_is_NULL)
 
 
     AZURE_FUNCTIONS_CONFIG config;
+    (void)memset(&config, 0, sizeof(config));
     config.relativePath = (STRING_HANDLE)0x42;
     config.hostAddress = NULL;
 
@@ -694,6 +842,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Create_returns_NULL_when_relativePath_is_NULL)
 
 
     AZURE_FUNCTIONS_CONFIG config;
+    (void)memset(&config, 0, sizeof(config));
     config.relativePath = NULL;
     config.hostAddress = (STRING_HANDLE)0x42;
 
@@ -715,6 +864,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Create_returns_NULL_failed_To_Allocate_Handle)
 
 
     AZURE_FUNCTIONS_CONFIG config;
+    (void)memset(&config, 0, sizeof(config));
     config.relativePath = (STRING_HANDLE)0x42;
     config.hostAddress = (STRING_HANDLE)0x42;
     
@@ -740,6 +890,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Create_returns_NULL_failed_To_Allocate_configurati
 
 
     AZURE_FUNCTIONS_CONFIG config;
+    (void)memset(&config, 0, sizeof(config));
     config.relativePath = (STRING_HANDLE)0x42;
     config.hostAddress = (STRING_HANDLE)0x42;
 
@@ -771,6 +922,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Create_returns_NULL_failed_to_clone_hostAddress)
 
 
     AZURE_FUNCTIONS_CONFIG config;
+    (void)memset(&config, 0, sizeof(config));
     config.relativePath = (STRING_HANDLE)0x42;
     config.hostAddress = (STRING_HANDLE)0x42;
 
@@ -808,6 +960,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Create_returns_NULL_failed_to_clone_relativePath)
 
 
     AZURE_FUNCTIONS_CONFIG config;
+    (void)memset(&config, 0, sizeof(config));
     config.relativePath = (STRING_HANDLE)0x42;
     config.hostAddress = (STRING_HANDLE)0x42;
 
@@ -850,6 +1003,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Create_returns_NULL_failed_to_clone_securityKey)
     const MODULE_API* apis = Module_GetApi(MODULE_API_VERSION_1);
 
     AZURE_FUNCTIONS_CONFIG config;
+    (void)memset(&config, 0, sizeof(config));
     config.relativePath = (STRING_HANDLE)0x42;
     config.hostAddress = (STRING_HANDLE)0x42;
     config.securityKey = (STRING_HANDLE)0x42;
@@ -912,6 +1066,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Destroy_happy_path_with_securityKey)
     const MODULE_API* apis = Module_GetApi(MODULE_API_VERSION_1);
 
     AZURE_FUNCTIONS_CONFIG config;
+    (void)memset(&config, 0, sizeof(config));
     config.relativePath = (STRING_HANDLE)0x42;
     config.hostAddress = (STRING_HANDLE)0x42;
     config.securityKey = (STRING_HANDLE)0x42;
@@ -964,6 +1119,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Destroy_happy_path_without_securityKey)
     const MODULE_API* apis = Module_GetApi(MODULE_API_VERSION_1);
 
     AZURE_FUNCTIONS_CONFIG config;
+    (void)memset(&config, 0, sizeof(config));
     config.relativePath = (STRING_HANDLE)0x42;
     config.hostAddress = (STRING_HANDLE)0x42;
     config.securityKey = NULL;
@@ -1005,98 +1161,172 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Destroy_happy_path_without_securityKey)
 }
 
 
-/* Tests_SRS_AZUREFUNCTIONS_04_010: [If moduleHandle is NULL than azure_functions_Receive shall fail and return.] */
-TEST_FUNCTION(AZURE_FUNCTIONS_Receive_doesNothing_if_moduleHandleIsNull)
+/*creates a module that hands its messages to a dispatcher*/
+static MODULE_HANDLE create_module_with_dispatcher(const MODULE_API* apis)
+{
+    MODULE_HANDLE result;
+    AZURE_FUNCTIONS_CONFIG config;
+    (void)memset(&config, 0, sizeof(config));
+    config.relativePath = (STRING_HANDLE)0x42;
+    config.hostAddress = (STRING_HANDLE)0x42;
+    config.connections = 2;
+
+    STRICT_EXPECTED_CALL(STRING_clone((STRING_HANDLE)0x42))
+        .SetReturn((STRING_HANDLE)0x42);
+    STRICT_EXPECTED_CALL(STRING_clone((STRING_HANDLE)0x42))
+        .SetReturn((STRING_HANDLE)0x42);
+    STRICT_EXPECTED_CALL(AzureFunctionsDispatcher_Create(IGNORED_PTR_ARG))
+        .SetReturn((AZURE_FUNCTIONS_DISPATCHER_HANDLE)0x44);
+
+    result = MODULE_CREATE(apis)((BROKER_HANDLE)0x42, (const void*)&config);
+    ASSERT_IS_NOT_NULL(result);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+/* Tests_SRS_AZUREFUNCTIONS_17_008: [ If `connections` is not 0, AzureFunctions_Create shall create a dispatcher by calling AzureFunctionsDispatcher_Create with the cloned configuration. ] */
+TEST_FUNCTION(AZURE_FUNCTIONS_Create_with_connections_creates_a_dispatcher)
 {
     // arrange
     const MODULE_API* apis = Module_GetApi(MODULE_API_VERSION_1);
 
+    AZURE_FUNCTIONS_CONFIG config;
+    (void)memset(&config, 0, sizeof(config));
+    config.relativePath = (STRING_HANDLE)0x42;
+    config.hostAddress = (STRING_HANDLE)0x42;
+    config.connections = 2;
+    config.maxInFlight = 8;
+    config.batchSize = 4;
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(AZURE_FUNCTIONS_CONFIG)));
+    STRICT_EXPECTED_CALL(STRING_clone((STRING_HANDLE)0x42))
+        .SetReturn((STRING_HANDLE)0x42);
+    STRICT_EXPECTED_CALL(STRING_clone((STRING_HANDLE)0x42))
+        .SetReturn((STRING_HANDLE)0x42);
+    STRICT_EXPECTED_CALL(AzureFunctionsDispatcher_Create(IGNORED_PTR_ARG))
+        .SetReturn((AZURE_FUNCTIONS_DISPATCHER_HANDLE)0x44);
+
     //act
-    MODULE_RECEIVE(apis)(NULL, (MESSAGE_HANDLE)0x42);
+    MODULE_HANDLE result = MODULE_CREATE(apis)((BROKER_HANDLE)0x42, (const void*)&config);
 
     //assert
+    ASSERT_IS_NOT_NULL(result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    MODULE_DESTROY(apis)(result);
 }
 
-/* Tests_SRS_AZUREFUNCTIONS_04_011: [ If messageHandle is NULL than azure_functions_Receive shall fail and return. ] */
-TEST_FUNCTION(AZURE_FUNCTIONS_Receive_doesNothing_if_messageHandleIsNull)
+/* Tests_SRS_AZUREFUNCTIONS_17_009: [ If AzureFunctionsDispatcher_Create fails, AzureFunctions_Create shall release everything it allocated and return NULL. ] */
+TEST_FUNCTION(AZURE_FUNCTIONS_Create_returns_NULL_when_the_dispatcher_cannot_be_created)
 {
     // arrange
     const MODULE_API* apis = Module_GetApi(MODULE_API_VERSION_1);
 
+    AZURE_FUNCTIONS_CONFIG config;
+    (void)memset(&config, 0, sizeof(config));
+    config.relativePath = (STRING_HANDLE)0x42;
+    config.hostAddress = (STRING_HANDLE)0x42;
+    config.connections = 2;
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(AZURE_FUNCTIONS_CONFIG)));
+    STRICT_EXPECTED_CALL(STRING_clone((STRING_HANDLE)0x42))
+        .SetReturn((STRING_HANDLE)0x42);
+    STRICT_EXPECTED_CALL(STRING_clone((STRING_HANDLE)0x42))
+        .SetReturn((STRING_HANDLE)0x42);
+    STRICT_EXPECTED_CALL(AzureFunctionsDispatcher_Create(IGNORED_PTR_ARG))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(STRING_delete(NULL));
+    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
+    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
     //act
-    MODULE_RECEIVE(apis)((MODULE_HANDLE)0x42, NULL);
+    MODULE_HANDLE result = MODULE_CREATE(apis)((BROKER_HANDLE)0x42, (const void*)&config);
 
     //assert
+    ASSERT_IS_NULL(result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
-/* Tests_SRS_AZUREFUNCTIONS_04_012: [ azure_functions_Receive shall get the message content by calling Message_GetContent, if it fails it shall fail and return. ] */
-TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fails_when_Message_getContent_fail)
+/* Tests_SRS_AZUREFUNCTIONS_17_010: [ AzureFunctions_Destroy shall destroy the dispatcher, if there is one, before it releases the configuration. ] */
+TEST_FUNCTION(AZURE_FUNCTIONS_Destroy_destroys_the_dispatcher)
 {
     // arrange
     const MODULE_API* apis = Module_GetApi(MODULE_API_VERSION_1);
+    MODULE_HANDLE module = create_module_with_dispatcher(apis);
 
-    STRICT_EXPECTED_CALL(Message_GetContent((MESSAGE_HANDLE)0x42))
-        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(AzureFunctionsDispatcher_Destroy((AZURE_FUNCTIONS_DISPATCHER_HANDLE)0x44));
+    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
+    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
+    STRICT_EXPECTED_CALL(STRING_delete(NULL));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 
     //act
-    MODULE_RECEIVE(apis)((MODULE_HANDLE)0x42, (MESSAGE_HANDLE)0x42);
+    MODULE_DESTROY(apis)(module);
 
     //assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
-/* Tests_SRS_AZUREFUNCTIONS_04_013: [ azure_functions_Receive shall base64 encode by calling Base64_Encode_Bytes, if it fails it shall fail and return. ] */
-TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fails_when_Base64_Encode_fail)
+/* Tests_SRS_AZUREFUNCTIONS_17_011: [ If there is a dispatcher, AzureFunctions_Receive shall hand the message to AzureFunctionsDispatcher_Send and return. ] */
+TEST_FUNCTION(AZURE_FUNCTIONS_Receive_with_a_dispatcher_hands_the_message_to_it)
 {
     // arrange
     const MODULE_API* apis = Module_GetApi(MODULE_API_VERSION_1);
+    MODULE_HANDLE module = create_module_with_dispatcher(apis);
 
-    CONSTBUFFER buffer;
-    buffer.buffer = (const unsigned char*)"12345";
-    buffer.size = sizeof("12345");
-    
-    umock_c_reset_all_calls();
-
-    STRICT_EXPECTED_CALL(Message_GetContent((MESSAGE_HANDLE)0x42))
-        .SetReturn(&buffer);
-
-    STRICT_EXPECTED_CALL(Base64_Encode_Bytes(buffer.buffer, buffer.size))
-        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(AzureFunctionsDispatcher_Send((AZURE_FUNCTIONS_DISPATCHER_HANDLE)0x44, (MESSAGE_HANDLE)0x42))
+        .SetReturn(0);
 
     //act
-    MODULE_RECEIVE(apis)((MODULE_HANDLE)0x42, (MESSAGE_HANDLE)0x42);
+    MODULE_RECEIVE(apis)(module, (MESSAGE_HANDLE)0x42);
 
     //assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-}
 
+    //cleanup
+    MODULE_DESTROY(apis)(module);
+}
 
-/* Tests_SRS_AZUREFUNCTIONS_04_024: [ AzureFunctions_Receive shall create a JSON STRING with the content of the message received. If it fails it shall fail and return. ] */
-TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fails_when_STRING_construct_fail)
+/* Tests_SRS_AZUREFUNCTIONS_04_010: [If moduleHandle is NULL than azure_functions_Receive shall fail and return.] */
+TEST_FUNCTION(AZURE_FUNCTIONS_Receive_doesNothing_if_moduleHandleIsNull)
 {
     // arrange
     const MODULE_API* apis = Module_GetApi(MODULE_API_VERSION_1);
 
-    CONSTBUFFER buffer;
-    buffer.buffer = (const unsigned char*)"12345";
-    buffer.size = sizeof("12345");
+    //act
+    MODULE_RECEIVE(apis)(NULL, (MESSAGE_HANDLE)0x42);
 
-    umock_c_reset_all_calls();
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
 
-    STRICT_EXPECTED_CALL(Message_GetContent((MESSAGE_HANDLE)0x42))
-        .SetReturn(&buffer);
+/* Tests_SRS_AZUREFUNCTIONS_04_011: [ If messageHandle is NULL than azure_functions_Receive shall fail and return. ] */
+TEST_FUNCTION(AZURE_FUNCTIONS_Receive_doesNothing_if_messageHandleIsNull)
+{
+    // arrange
+    const MODULE_API* apis = Module_GetApi(MODULE_API_VERSION_1);
 
-    STRICT_EXPECTED_CALL(Base64_Encode_Bytes(buffer.buffer, buffer.size))
-        .SetReturn((STRING_HANDLE)0x42);
+    //act
+    MODULE_RECEIVE(apis)((MODULE_HANDLE)0x42, NULL);
 
-    STRICT_EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG))
-        .IgnoreAllArguments()
-        .SetReturn(NULL);
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
 
-    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
+/* Tests_SRS_AZUREFUNCTIONS_04_012: [ azure_functions_Receive shall get the message content by calling Message_GetContent, if it fails it shall fail and return. ] */
+TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fails_when_Message_getContent_fail)
+{
+    // arrange
+    const MODULE_API* apis = Module_GetApi(MODULE_API_VERSION_1);
 
+    STRICT_EXPECTED_CALL(Message_GetContent((MESSAGE_HANDLE)0x42))
+        .SetReturn(NULL);
 
     //act
     MODULE_RECEIVE(apis)((MODULE_HANDLE)0x42, (MESSAGE_HANDLE)0x42);
@@ -1105,37 +1335,21 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fails_when_STRING_construct_fail)
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
-/* Tests_SRS_AZUREFUNCTIONS_04_024: [ AzureFunctions_Receive shall create a JSON STRING with the content of the message received. If it fails it shall fail and return. ] */
-TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fails_when_STRING_concat1_fail)
+/* Tests_SRS_AZUREFUNCTIONS_04_013: [ AzureFunctions_Receive shall size the JSON body with Base64Encoder_GetEncodedSize and allocate it by calling BUFFER_new and BUFFER_pre_build, if it fails it shall fail and return. ] */
+TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fails_when_content_is_too_large_to_encode)
 {
     // arrange
     const MODULE_API* apis = Module_GetApi(MODULE_API_VERSION_1);
 
     CONSTBUFFER buffer;
     buffer.buffer = (const unsigned char*)"12345";
-    buffer.size = sizeof("12345");
+    buffer.size = SIZE_MAX;
 
     umock_c_reset_all_calls();
 
     STRICT_EXPECTED_CALL(Message_GetContent((MESSAGE_HANDLE)0x42))
         .SetReturn(&buffer);
 
-    STRICT_EXPECTED_CALL(Base64_Encode_Bytes(buffer.buffer, buffer.size))
-        .SetReturn((STRING_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG))
-        .IgnoreAllArguments()
-        .SetReturn((STRING_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(STRING_concat((STRING_HANDLE)0x42, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .SetReturn(-1);
-
-    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
-
-    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
-
-
     //act
     MODULE_RECEIVE(apis)((MODULE_HANDLE)0x42, (MESSAGE_HANDLE)0x42);
 
@@ -1143,8 +1357,8 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fails_when_STRING_concat1_fail)
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
-/* Tests_SRS_AZUREFUNCTIONS_04_024: [ AzureFunctions_Receive shall create a JSON STRING with the content of the message received. If it fails it shall fail and return. ] */
-TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fails_when_STRING_concat_with_STRING_fail)
+/* Tests_SRS_AZUREFUNCTIONS_04_013: [ AzureFunctions_Receive shall size the JSON body with Base64Encoder_GetEncodedSize and allocate it by calling BUFFER_new and BUFFER_pre_build, if it fails it shall fail and return. ] */
+TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fails_when_BUFFER_new_fail)
 {
     // arrange
     const MODULE_API* apis = Module_GetApi(MODULE_API_VERSION_1);
@@ -1158,24 +1372,8 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fails_when_STRING_concat_with_STRING_fail)
     STRICT_EXPECTED_CALL(Message_GetContent((MESSAGE_HANDLE)0x42))
         .SetReturn(&buffer);
 
-    STRICT_EXPECTED_CALL(Base64_Encode_Bytes(buffer.buffer, buffer.size))
-        .SetReturn((STRING_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG))
-        .IgnoreAllArguments()
-        .SetReturn((STRING_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(STRING_concat((STRING_HANDLE)0x42, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .SetReturn(0);
-
-    STRICT_EXPECTED_CALL(STRING_concat_with_STRING((STRING_HANDLE)0x42, (STRING_HANDLE)0x42))
-        .SetReturn(-1);
-
-    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
-
-    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
-
+    STRICT_EXPECTED_CALL(BUFFER_new())
+        .SetReturn(NULL);
 
     //act
     MODULE_RECEIVE(apis)((MODULE_HANDLE)0x42, (MESSAGE_HANDLE)0x42);
@@ -1184,8 +1382,8 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fails_when_STRING_concat_with_STRING_fail)
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
-/* Tests_SRS_AZUREFUNCTIONS_04_024: [ AzureFunctions_Receive shall create a JSON STRING with the content of the message received. If it fails it shall fail and return. ] */
-TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fails_when_STRING_concat2_fail)
+/* Tests_SRS_AZUREFUNCTIONS_04_013: [ AzureFunctions_Receive shall size the JSON body with Base64Encoder_GetEncodedSize and allocate it by calling BUFFER_new and BUFFER_pre_build, if it fails it shall fail and return. ] */
+TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fails_when_BUFFER_pre_build_fail)
 {
     // arrange
     const MODULE_API* apis = Module_GetApi(MODULE_API_VERSION_1);
@@ -1199,28 +1397,13 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fails_when_STRING_concat2_fail)
     STRICT_EXPECTED_CALL(Message_GetContent((MESSAGE_HANDLE)0x42))
         .SetReturn(&buffer);
 
-    STRICT_EXPECTED_CALL(Base64_Encode_Bytes(buffer.buffer, buffer.size))
-        .SetReturn((STRING_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG))
-        .IgnoreAllArguments()
-        .SetReturn((STRING_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(STRING_concat((STRING_HANDLE)0x42, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .SetReturn(0);
-
-    STRICT_EXPECTED_CALL(STRING_concat_with_STRING((STRING_HANDLE)0x42, (STRING_HANDLE)0x42))
-        .SetReturn(0);
-
-    STRICT_EXPECTED_CALL(STRING_concat((STRING_HANDLE)0x42, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .SetReturn(-1);
-
-    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
+    STRICT_EXPECTED_CALL(BUFFER_new())
+        .SetReturn((BUFFER_HANDLE)0x43);
 
-    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
+    STRICT_EXPECTED_CALL(BUFFER_pre_build((BUFFER_HANDLE)0x43, TEST_BODY_SIZE))
+        .SetReturn(1);
 
+    STRICT_EXPECTED_CALL(BUFFER_delete((BUFFER_HANDLE)0x43));
 
     //act
     MODULE_RECEIVE(apis)((MODULE_HANDLE)0x42, (MESSAGE_HANDLE)0x42);
@@ -1240,6 +1423,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fail_when_HTTPAPIEX_create_Fail)
     buffer.size = sizeof("12345");
     
     AZURE_FUNCTIONS_CONFIG config;
+    (void)memset(&config, 0, sizeof(config));
     config.relativePath = (STRING_HANDLE)0x42;
     config.hostAddress = (STRING_HANDLE)0x42;
     config.securityKey = (STRING_HANDLE)0x42;
@@ -1268,23 +1452,13 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fail_when_HTTPAPIEX_create_Fail)
     STRICT_EXPECTED_CALL(Message_GetContent((MESSAGE_HANDLE)0x42))
         .SetReturn(&buffer);
 
-    STRICT_EXPECTED_CALL(Base64_Encode_Bytes(buffer.buffer, buffer.size))
-        .SetReturn((STRING_HANDLE)0x42);
+    STRICT_EXPECTED_CALL(BUFFER_new())
+        .SetReturn((BUFFER_HANDLE)0x43);
 
-    STRICT_EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG))
-        .IgnoreAllArguments()
-        .SetReturn((STRING_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(STRING_concat((STRING_HANDLE)0x42, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .SetReturn(0);
-
-    STRICT_EXPECTED_CALL(STRING_concat_with_STRING((STRING_HANDLE)0x42, (STRING_HANDLE)0x42))
+    STRICT_EXPECTED_CALL(BUFFER_pre_build((BUFFER_HANDLE)0x43, TEST_BODY_SIZE))
         .SetReturn(0);
 
-    STRICT_EXPECTED_CALL(STRING_concat((STRING_HANDLE)0x42, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .SetReturn(0);
+    STRICT_EXPECTED_CALL(BUFFER_u_char((BUFFER_HANDLE)0x43));
 
     STRICT_EXPECTED_CALL(STRING_c_str((STRING_HANDLE)0x42))
         .SetReturn("AnyContent42");
@@ -1293,9 +1467,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fail_when_HTTPAPIEX_create_Fail)
         .IgnoreAllArguments()
         .SetReturn(NULL);
 
-    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
-
-    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
+    STRICT_EXPECTED_CALL(BUFFER_delete((BUFFER_HANDLE)0x43));
 
 
     //act
@@ -1319,6 +1491,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fail_if_buffer_new_fails)
     buffer.size = sizeof("12345");
 
     AZURE_FUNCTIONS_CONFIG config;
+    (void)memset(&config, 0, sizeof(config));
     config.relativePath = (STRING_HANDLE)0x42;
     config.hostAddress = (STRING_HANDLE)0x42;
     config.securityKey = (STRING_HANDLE)0x42;
@@ -1347,23 +1520,13 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fail_if_buffer_new_fails)
     STRICT_EXPECTED_CALL(Message_GetContent((MESSAGE_HANDLE)0x42))
         .SetReturn(&buffer);
 
-    STRICT_EXPECTED_CALL(Base64_Encode_Bytes(buffer.buffer, buffer.size))
-        .SetReturn((STRING_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG))
-        .IgnoreAllArguments()
-        .SetReturn((STRING_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(STRING_concat((STRING_HANDLE)0x42, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .SetReturn(0);
+    STRICT_EXPECTED_CALL(BUFFER_new())
+        .SetReturn((BUFFER_HANDLE)0x43);
 
-    STRICT_EXPECTED_CALL(STRING_concat_with_STRING((STRING_HANDLE)0x42, (STRING_HANDLE)0x42))
+    STRICT_EXPECTED_CALL(BUFFER_pre_build((BUFFER_HANDLE)0x43, TEST_BODY_SIZE))
         .SetReturn(0);
 
-    STRICT_EXPECTED_CALL(STRING_concat((STRING_HANDLE)0x42, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .SetReturn(0);
+    STRICT_EXPECTED_CALL(BUFFER_u_char((BUFFER_HANDLE)0x43));
 
     STRICT_EXPECTED_CALL(STRING_c_str((STRING_HANDLE)0x42))
         .SetReturn("AnyContent42");
@@ -1377,9 +1540,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fail_if_buffer_new_fails)
 
     STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy((HTTPAPIEX_HANDLE)0x42));
 
-    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
-
-    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
+    STRICT_EXPECTED_CALL(BUFFER_delete((BUFFER_HANDLE)0x43));
 
 
     //act
@@ -1403,6 +1564,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fail_when_String_clone_fails)
     buffer.size = sizeof("12345");
 
     AZURE_FUNCTIONS_CONFIG config;
+    (void)memset(&config, 0, sizeof(config));
     config.relativePath = (STRING_HANDLE)0x42;
     config.hostAddress = (STRING_HANDLE)0x42;
     config.securityKey = (STRING_HANDLE)0x42;
@@ -1431,23 +1593,13 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fail_when_String_clone_fails)
     STRICT_EXPECTED_CALL(Message_GetContent((MESSAGE_HANDLE)0x42))
         .SetReturn(&buffer);
 
-    STRICT_EXPECTED_CALL(Base64_Encode_Bytes(buffer.buffer, buffer.size))
-        .SetReturn((STRING_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG))
-        .IgnoreAllArguments()
-        .SetReturn((STRING_HANDLE)0x42);
+    STRICT_EXPECTED_CALL(BUFFER_new())
+        .SetReturn((BUFFER_HANDLE)0x43);
 
-    STRICT_EXPECTED_CALL(STRING_concat((STRING_HANDLE)0x42, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
+    STRICT_EXPECTED_CALL(BUFFER_pre_build((BUFFER_HANDLE)0x43, TEST_BODY_SIZE))
         .SetReturn(0);
 
-    STRICT_EXPECTED_CALL(STRING_concat_with_STRING((STRING_HANDLE)0x42, (STRING_HANDLE)0x42))
-        .SetReturn(0);
-
-    STRICT_EXPECTED_CALL(STRING_concat((STRING_HANDLE)0x42, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .SetReturn(0);
+    STRICT_EXPECTED_CALL(BUFFER_u_char((BUFFER_HANDLE)0x43));
 
     STRICT_EXPECTED_CALL(STRING_c_str((STRING_HANDLE)0x42))
         .SetReturn("AnyContent42");
@@ -1467,9 +1619,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fail_when_String_clone_fails)
 
     STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy((HTTPAPIEX_HANDLE)0x42));
 
-    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
-
-    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
+    STRICT_EXPECTED_CALL(BUFFER_delete((BUFFER_HANDLE)0x43));
 
 
     //act
@@ -1493,6 +1643,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fail_when_String_concat1_fails)
     buffer.size = sizeof("12345");
 
     AZURE_FUNCTIONS_CONFIG config;
+    (void)memset(&config, 0, sizeof(config));
     config.relativePath = (STRING_HANDLE)0x42;
     config.hostAddress = (STRING_HANDLE)0x42;
     config.securityKey = (STRING_HANDLE)0x42;
@@ -1521,23 +1672,13 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fail_when_String_concat1_fails)
     STRICT_EXPECTED_CALL(Message_GetContent((MESSAGE_HANDLE)0x42))
         .SetReturn(&buffer);
 
-    STRICT_EXPECTED_CALL(Base64_Encode_Bytes(buffer.buffer, buffer.size))
-        .SetReturn((STRING_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG))
-        .IgnoreAllArguments()
-        .SetReturn((STRING_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(STRING_concat((STRING_HANDLE)0x42, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .SetReturn(0);
+    STRICT_EXPECTED_CALL(BUFFER_new())
+        .SetReturn((BUFFER_HANDLE)0x43);
 
-    STRICT_EXPECTED_CALL(STRING_concat_with_STRING((STRING_HANDLE)0x42, (STRING_HANDLE)0x42))
+    STRICT_EXPECTED_CALL(BUFFER_pre_build((BUFFER_HANDLE)0x43, TEST_BODY_SIZE))
         .SetReturn(0);
 
-    STRICT_EXPECTED_CALL(STRING_concat((STRING_HANDLE)0x42, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .SetReturn(0);
+    STRICT_EXPECTED_CALL(BUFFER_u_char((BUFFER_HANDLE)0x43));
 
     STRICT_EXPECTED_CALL(STRING_c_str((STRING_HANDLE)0x42))
         .SetReturn("AnyContent42");
@@ -1562,9 +1703,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fail_when_String_concat1_fails)
 
     STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy((HTTPAPIEX_HANDLE)0x42));
 
-    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
-
-    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
+    STRICT_EXPECTED_CALL(BUFFER_delete((BUFFER_HANDLE)0x43));
 
 
     //act
@@ -1588,6 +1727,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fail_when_HTTPHeaders_Alloc_fails)
     buffer.size = sizeof("12345");
 
     AZURE_FUNCTIONS_CONFIG config;
+    (void)memset(&config, 0, sizeof(config));
     config.relativePath = (STRING_HANDLE)0x42;
     config.hostAddress = (STRING_HANDLE)0x42;
     config.securityKey = (STRING_HANDLE)0x42;
@@ -1616,23 +1756,13 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fail_when_HTTPHeaders_Alloc_fails)
     STRICT_EXPECTED_CALL(Message_GetContent((MESSAGE_HANDLE)0x42))
         .SetReturn(&buffer);
 
-    STRICT_EXPECTED_CALL(Base64_Encode_Bytes(buffer.buffer, buffer.size))
-        .SetReturn((STRING_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG))
-        .IgnoreAllArguments()
-        .SetReturn((STRING_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(STRING_concat((STRING_HANDLE)0x42, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .SetReturn(0);
+    STRICT_EXPECTED_CALL(BUFFER_new())
+        .SetReturn((BUFFER_HANDLE)0x43);
 
-    STRICT_EXPECTED_CALL(STRING_concat_with_STRING((STRING_HANDLE)0x42, (STRING_HANDLE)0x42))
+    STRICT_EXPECTED_CALL(BUFFER_pre_build((BUFFER_HANDLE)0x43, TEST_BODY_SIZE))
         .SetReturn(0);
 
-    STRICT_EXPECTED_CALL(STRING_concat((STRING_HANDLE)0x42, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .SetReturn(0);
+    STRICT_EXPECTED_CALL(BUFFER_u_char((BUFFER_HANDLE)0x43));
 
     STRICT_EXPECTED_CALL(STRING_c_str((STRING_HANDLE)0x42))
         .SetReturn("AnyContent42");
@@ -1660,9 +1790,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fail_when_HTTPHeaders_Alloc_fails)
 
     STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy((HTTPAPIEX_HANDLE)0x42));
 
-    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
-
-    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
+    STRICT_EXPECTED_CALL(BUFFER_delete((BUFFER_HANDLE)0x43));
 
 
     //act
@@ -1686,6 +1814,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fail_when_HTTPHeaders_AddHeaderNameValuePa
     buffer.size = sizeof("12345");
 
     AZURE_FUNCTIONS_CONFIG config;
+    (void)memset(&config, 0, sizeof(config));
     config.relativePath = (STRING_HANDLE)0x42;
     config.hostAddress = (STRING_HANDLE)0x42;
     config.securityKey = (STRING_HANDLE)0x42;
@@ -1714,23 +1843,13 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fail_when_HTTPHeaders_AddHeaderNameValuePa
     STRICT_EXPECTED_CALL(Message_GetContent((MESSAGE_HANDLE)0x42))
         .SetReturn(&buffer);
 
-    STRICT_EXPECTED_CALL(Base64_Encode_Bytes(buffer.buffer, buffer.size))
-        .SetReturn((STRING_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG))
-        .IgnoreAllArguments()
-        .SetReturn((STRING_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(STRING_concat((STRING_HANDLE)0x42, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .SetReturn(0);
+    STRICT_EXPECTED_CALL(BUFFER_new())
+        .SetReturn((BUFFER_HANDLE)0x43);
 
-    STRICT_EXPECTED_CALL(STRING_concat_with_STRING((STRING_HANDLE)0x42, (STRING_HANDLE)0x42))
+    STRICT_EXPECTED_CALL(BUFFER_pre_build((BUFFER_HANDLE)0x43, TEST_BODY_SIZE))
         .SetReturn(0);
 
-    STRICT_EXPECTED_CALL(STRING_concat((STRING_HANDLE)0x42, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .SetReturn(0);
+    STRICT_EXPECTED_CALL(BUFFER_u_char((BUFFER_HANDLE)0x43));
 
     STRICT_EXPECTED_CALL(STRING_c_str((STRING_HANDLE)0x42))
         .SetReturn("AnyContent42");
@@ -1765,9 +1884,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fail_when_HTTPHeaders_AddHeaderNameValuePa
 
     STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy((HTTPAPIEX_HANDLE)0x42));
 
-    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
-
-    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
+    STRICT_EXPECTED_CALL(BUFFER_delete((BUFFER_HANDLE)0x43));
 
     //act
     MODULE_RECEIVE(apis)(moduleInfo, (MESSAGE_HANDLE)0x42);
@@ -1790,6 +1907,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fail_when_HTTPHeaders_AddHeaderNameValuePa
     buffer.size = sizeof("12345");
 
     AZURE_FUNCTIONS_CONFIG config;
+    (void)memset(&config, 0, sizeof(config));
     config.relativePath = (STRING_HANDLE)0x42;
     config.hostAddress = (STRING_HANDLE)0x42;
     config.securityKey = (STRING_HANDLE)0x42;
@@ -1818,135 +1936,13 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fail_when_HTTPHeaders_AddHeaderNameValuePa
     STRICT_EXPECTED_CALL(Message_GetContent((MESSAGE_HANDLE)0x42))
         .SetReturn(&buffer);
 
-    STRICT_EXPECTED_CALL(Base64_Encode_Bytes(buffer.buffer, buffer.size))
-        .SetReturn((STRING_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG))
-        .IgnoreAllArguments()
-        .SetReturn((STRING_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(STRING_concat((STRING_HANDLE)0x42, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .SetReturn(0);
-
-    STRICT_EXPECTED_CALL(STRING_concat_with_STRING((STRING_HANDLE)0x42, (STRING_HANDLE)0x42))
-        .SetReturn(0);
-
-    STRICT_EXPECTED_CALL(STRING_concat((STRING_HANDLE)0x42, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .SetReturn(0);
-
-    STRICT_EXPECTED_CALL(STRING_c_str((STRING_HANDLE)0x42))
-        .SetReturn("AnyContent42");
-
-    STRICT_EXPECTED_CALL(HTTPAPIEX_Create(IGNORED_PTR_ARG))
-        .IgnoreAllArguments()
-        .SetReturn((HTTPAPIEX_HANDLE)0x42);
-
     STRICT_EXPECTED_CALL(BUFFER_new())
-        .SetReturn((BUFFER_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(STRING_clone((STRING_HANDLE)0x42))
-        .SetReturn((STRING_HANDLE)0x42);
+        .SetReturn((BUFFER_HANDLE)0x43);
 
-    STRICT_EXPECTED_CALL(STRING_concat((STRING_HANDLE)0x42, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
+    STRICT_EXPECTED_CALL(BUFFER_pre_build((BUFFER_HANDLE)0x43, TEST_BODY_SIZE))
         .SetReturn(0);
 
-    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc())
-        .SetReturn((HTTP_HEADERS_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair((HTTP_HEADERS_HANDLE)0x42, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3)
-        .SetReturn(HTTP_HEADERS_OK);
-
-    STRICT_EXPECTED_CALL(STRING_c_str((STRING_HANDLE)0x42))
-        .SetReturn("AnyContent42");
-
-    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair((HTTP_HEADERS_HANDLE)0x42, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3)
-        .SetReturn(HTTP_HEADERS_ERROR);
-
-    STRICT_EXPECTED_CALL(HTTPHeaders_Free((HTTP_HEADERS_HANDLE)0x42));
-
-    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
-
-    STRICT_EXPECTED_CALL(BUFFER_delete((BUFFER_HANDLE)0x42));
-
-    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy((HTTPAPIEX_HANDLE)0x42));
-
-    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
-
-    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
-
-    //act
-    MODULE_RECEIVE(apis)(moduleInfo, (MESSAGE_HANDLE)0x42);
-
-    //assert
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-    //cleanup 
-    MODULE_DESTROY(apis)(moduleInfo);
-}
-
-/* Tests_SRS_AZUREFUNCTIONS_04_017: [ azure_functions_Receive shall HTTPAPIEX_ExecuteRequest to send the HTTP POST to Azure Functions. If it fail it shall fail and return. ] */
-TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fail_when_BUFFER_create_PostContent_fails)
-{
-    // arrange
-    const MODULE_API* apis = Module_GetApi(MODULE_API_VERSION_1);
-
-    CONSTBUFFER buffer;
-    buffer.buffer = (const unsigned char*)"12345";
-    buffer.size = sizeof("12345");
-
-    AZURE_FUNCTIONS_CONFIG config;
-    config.relativePath = (STRING_HANDLE)0x42;
-    config.hostAddress = (STRING_HANDLE)0x42;
-    config.securityKey = (STRING_HANDLE)0x42;
-
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
-
-    STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(AZURE_FUNCTIONS_CONFIG)));
-
-    STRICT_EXPECTED_CALL(STRING_clone((STRING_HANDLE)IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .SetReturn((STRING_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(STRING_clone((STRING_HANDLE)IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .SetReturn((STRING_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(STRING_clone((STRING_HANDLE)IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .SetReturn((STRING_HANDLE)0x42);
-
-    MODULE_HANDLE moduleInfo = MODULE_CREATE(apis)((BROKER_HANDLE)0x42, &config);
-
-    umock_c_reset_all_calls();
-
-    STRICT_EXPECTED_CALL(Message_GetContent((MESSAGE_HANDLE)0x42))
-        .SetReturn(&buffer);
-
-    STRICT_EXPECTED_CALL(Base64_Encode_Bytes(buffer.buffer, buffer.size))
-        .SetReturn((STRING_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG))
-        .IgnoreAllArguments()
-        .SetReturn((STRING_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(STRING_concat((STRING_HANDLE)0x42, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .SetReturn(0);
-
-    STRICT_EXPECTED_CALL(STRING_concat_with_STRING((STRING_HANDLE)0x42, (STRING_HANDLE)0x42))
-        .SetReturn(0);
-
-    STRICT_EXPECTED_CALL(STRING_concat((STRING_HANDLE)0x42, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .SetReturn(0);
+    STRICT_EXPECTED_CALL(BUFFER_u_char((BUFFER_HANDLE)0x43));
 
     STRICT_EXPECTED_CALL(STRING_c_str((STRING_HANDLE)0x42))
         .SetReturn("AnyContent42");
@@ -1979,18 +1975,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fail_when_BUFFER_create_PostContent_fails)
     STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair((HTTP_HEADERS_HANDLE)0x42, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3)
-        .SetReturn(HTTP_HEADERS_OK);
-
-
-    STRICT_EXPECTED_CALL(STRING_length((STRING_HANDLE)0x42))
-        .SetReturn(42);
-
-    STRICT_EXPECTED_CALL(STRING_c_str((STRING_HANDLE)0x42))
-        .SetReturn("AnyContent42");
-
-    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreAllArguments()
-        .SetReturn(NULL);
+        .SetReturn(HTTP_HEADERS_ERROR);
 
     STRICT_EXPECTED_CALL(HTTPHeaders_Free((HTTP_HEADERS_HANDLE)0x42));
 
@@ -2000,10 +1985,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fail_when_BUFFER_create_PostContent_fails)
 
     STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy((HTTPAPIEX_HANDLE)0x42));
 
-    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
-
-    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
-
+    STRICT_EXPECTED_CALL(BUFFER_delete((BUFFER_HANDLE)0x43));
 
     //act
     MODULE_RECEIVE(apis)(moduleInfo, (MESSAGE_HANDLE)0x42);
@@ -2026,6 +2008,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fail_when_httpapiex_executeRequest_fail)
     buffer.size = sizeof("12345");
 
     AZURE_FUNCTIONS_CONFIG config;
+    (void)memset(&config, 0, sizeof(config));
     config.relativePath = (STRING_HANDLE)0x42;
     config.hostAddress = (STRING_HANDLE)0x42;
     config.securityKey = (STRING_HANDLE)0x42;
@@ -2054,23 +2037,13 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fail_when_httpapiex_executeRequest_fail)
     STRICT_EXPECTED_CALL(Message_GetContent((MESSAGE_HANDLE)0x42))
         .SetReturn(&buffer);
 
-    STRICT_EXPECTED_CALL(Base64_Encode_Bytes(buffer.buffer, buffer.size))
-        .SetReturn((STRING_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG))
-        .IgnoreAllArguments()
-        .SetReturn((STRING_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(STRING_concat((STRING_HANDLE)0x42, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .SetReturn(0);
+    STRICT_EXPECTED_CALL(BUFFER_new())
+        .SetReturn((BUFFER_HANDLE)0x43);
 
-    STRICT_EXPECTED_CALL(STRING_concat_with_STRING((STRING_HANDLE)0x42, (STRING_HANDLE)0x42))
+    STRICT_EXPECTED_CALL(BUFFER_pre_build((BUFFER_HANDLE)0x43, TEST_BODY_SIZE))
         .SetReturn(0);
 
-    STRICT_EXPECTED_CALL(STRING_concat((STRING_HANDLE)0x42, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .SetReturn(0);
+    STRICT_EXPECTED_CALL(BUFFER_u_char((BUFFER_HANDLE)0x43));
 
     STRICT_EXPECTED_CALL(STRING_c_str((STRING_HANDLE)0x42))
         .SetReturn("AnyContent42");
@@ -2106,26 +2079,14 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fail_when_httpapiex_executeRequest_fail)
         .SetReturn(HTTP_HEADERS_OK);
 
 
-    STRICT_EXPECTED_CALL(STRING_length((STRING_HANDLE)0x42))
-        .SetReturn(42);
-
     STRICT_EXPECTED_CALL(STRING_c_str((STRING_HANDLE)0x42))
         .SetReturn("AnyContent42");
 
-    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreAllArguments()
-        .SetReturn((BUFFER_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(STRING_c_str((STRING_HANDLE)0x42))
-        .SetReturn("AnyContent42");
-
-    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest((HTTPAPIEX_HANDLE)0x42, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, (HTTP_HEADERS_HANDLE)0x42, (BUFFER_HANDLE)0x42, IGNORED_PTR_ARG, NULL, (BUFFER_HANDLE)0x42))
+    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest((HTTPAPIEX_HANDLE)0x42, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, (HTTP_HEADERS_HANDLE)0x42, (BUFFER_HANDLE)0x43, IGNORED_PTR_ARG, NULL, (BUFFER_HANDLE)0x42))
         .IgnoreArgument(3)
         .IgnoreArgument(6)
         .SetReturn(HTTPAPIEX_ERROR);
 
-    STRICT_EXPECTED_CALL(BUFFER_delete((BUFFER_HANDLE)0x42));
-
     STRICT_EXPECTED_CALL(HTTPHeaders_Free((HTTP_HEADERS_HANDLE)0x42));
 
     STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
@@ -2134,9 +2095,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fail_when_httpapiex_executeRequest_fail)
 
     STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy((HTTPAPIEX_HANDLE)0x42));
 
-    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
-
-    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
+    STRICT_EXPECTED_CALL(BUFFER_delete((BUFFER_HANDLE)0x43));
 
 
     //act
@@ -2150,14 +2109,15 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_fail_when_httpapiex_executeRequest_fail)
 }
 
 /* Tests_SRS_AZUREFUNCTIONS_04_025: [ AzureFunctions_Receive shall add 2 HTTP Headers to POST Request. Content-Type:application/json and, if securityKey exists x-functions-key:securityKey. If it fails it shall fail and return. ] */
-/* Tests_SRS_AZUREFUNCTIONS_04_024: [ AzureFunctions_Receive shall create a JSON STRING with the content of the message received. If it fails it shall fail and return. ] */
+/* Tests_SRS_AZUREFUNCTIONS_04_024: [ AzureFunctions_Receive shall write the JSON body {"content":"<content>"} into the buffer, encoding the content of the message straight into it with Base64Encoder_Encode. ] */
 /* Tests_SRS_AZUREFUNCTIONS_04_019: [ azure_functions_Receive shall destroy any allocated memory before returning. ] */
 /* Tests_SRS_AZUREFUNCTIONS_04_018: [ Upon success azure_functions_Receive shall log the response from HTTP POST and return. ] */
 /* Tests_SRS_AZUREFUNCTIONS_04_017: [ azure_functions_Receive shall HTTPAPIEX_ExecuteRequest to send the HTTP POST to Azure Functions. If it fail it shall fail and return. ] */
 /* Tests_SRS_AZUREFUNCTIONS_04_016: [ azure_functions_Receive shall add name and content parameter to relative path, if it fail it shall fail and return. ] */
 /* Tests_SRS_AZUREFUNCTIONS_04_015: [ azure_functions_Receive shall call allocate memory to receive data from HTTPAPI by calling BUFFER_new, if it fail it shall fail and return. ] */
 /* Tests_SRS_AZUREFUNCTIONS_04_014: [ azure_functions_Receive shall call HTTPAPIEX_Create, passing hostAddress, it if fails it shall fail and return. ] */
-/* Tests_SRS_AZUREFUNCTIONS_04_013: [ azure_functions_Receive shall base64 encode by calling Base64_Encode_Bytes, if it fails it shall fail and return. ] */
+/* Tests_SRS_AZUREFUNCTIONS_04_013: [ AzureFunctions_Receive shall size the JSON body with Base64Encoder_GetEncodedSize and allocate it by calling BUFFER_new and BUFFER_pre_build, if it fails it shall fail and return. ] */
+/* Tests_SRS_AZUREFUNCTIONS_04_024: [ AzureFunctions_Receive shall write the JSON body {"content":"<content>"} into the buffer, encoding the content of the message straight into it with Base64Encoder_Encode. ] */
 /* Tests_SRS_AZUREFUNCTIONS_04_012: [ azure_functions_Receive shall get the message content by calling Message_GetContent, if it fails it shall fail and return. ] */
 TEST_FUNCTION(AZURE_FUNCTIONS_Receive_happy_path)
 {
@@ -2169,6 +2129,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_happy_path)
     buffer.size = sizeof("12345");
 
     AZURE_FUNCTIONS_CONFIG config;
+    (void)memset(&config, 0, sizeof(config));
     config.relativePath = (STRING_HANDLE)0x42;
     config.hostAddress = (STRING_HANDLE)0x42;
     config.securityKey = (STRING_HANDLE)0x42;
@@ -2197,23 +2158,13 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_happy_path)
     STRICT_EXPECTED_CALL(Message_GetContent((MESSAGE_HANDLE)0x42))
         .SetReturn(&buffer);
 
-    STRICT_EXPECTED_CALL(Base64_Encode_Bytes(buffer.buffer, buffer.size))
-        .SetReturn((STRING_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG))
-        .IgnoreAllArguments()
-        .SetReturn((STRING_HANDLE)0x42);
-
-    STRICT_EXPECTED_CALL(STRING_concat((STRING_HANDLE)0x42, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .SetReturn(0);
+    STRICT_EXPECTED_CALL(BUFFER_new())
+        .SetReturn((BUFFER_HANDLE)0x43);
 
-    STRICT_EXPECTED_CALL(STRING_concat_with_STRING((STRING_HANDLE)0x42, (STRING_HANDLE)0x42))
+    STRICT_EXPECTED_CALL(BUFFER_pre_build((BUFFER_HANDLE)0x43, TEST_BODY_SIZE))
         .SetReturn(0);
 
-    STRICT_EXPECTED_CALL(STRING_concat((STRING_HANDLE)0x42, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .SetReturn(0);
+    STRICT_EXPECTED_CALL(BUFFER_u_char((BUFFER_HANDLE)0x43));
 
     STRICT_EXPECTED_CALL(STRING_c_str((STRING_HANDLE)0x42))
         .SetReturn("AnyContent42");
@@ -2249,26 +2200,14 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_happy_path)
         .SetReturn(HTTP_HEADERS_OK);
 
 
-    STRICT_EXPECTED_CALL(STRING_length((STRING_HANDLE)0x42))
-        .SetReturn(42);
-
-    STRICT_EXPECTED_CALL(STRING_c_str((STRING_HANDLE)0x42))
-        .SetReturn("AnyContent42");
-
-    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreAllArguments()
-        .SetReturn((BUFFER_HANDLE)0x42);
-
     STRICT_EXPECTED_CALL(STRING_c_str((STRING_HANDLE)0x42))
         .SetReturn("AnyContent42");
 
-    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest((HTTPAPIEX_HANDLE)0x42, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, (HTTP_HEADERS_HANDLE)0x42, (BUFFER_HANDLE)0x42, IGNORED_PTR_ARG, NULL, (BUFFER_HANDLE)0x42))
+    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest((HTTPAPIEX_HANDLE)0x42, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, (HTTP_HEADERS_HANDLE)0x42, (BUFFER_HANDLE)0x43, IGNORED_PTR_ARG, NULL, (BUFFER_HANDLE)0x42))
         .IgnoreArgument(3)
         .IgnoreArgument(6)
         .SetReturn(HTTPAPIEX_OK);
 
-    STRICT_EXPECTED_CALL(BUFFER_delete((BUFFER_HANDLE)0x42));
-
     STRICT_EXPECTED_CALL(HTTPHeaders_Free((HTTP_HEADERS_HANDLE)0x42));
 
     STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
@@ -2277,15 +2216,14 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_happy_path)
 
     STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy((HTTPAPIEX_HANDLE)0x42));
 
-    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
-
-    STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
+    STRICT_EXPECTED_CALL(BUFFER_delete((BUFFER_HANDLE)0x43));
 
     //act
     MODULE_RECEIVE(apis)(moduleInfo, (MESSAGE_HANDLE)0x42);
 
     //assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, memcmp(TEST_BODY, test_post_content, TEST_BODY_SIZE));
 
     //cleanup 
     MODULE_DESTROY(apis)(moduleInfo);
@@ -2300,6 +2238,7 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_happy_path_empty_content)
 	CONSTBUFFER buffer = { NULL, 0 };
 
 	AZURE_FUNCTIONS_CONFIG config;
+	(void)memset(&config, 0, sizeof(config));
 	config.relativePath = (STRING_HANDLE)0x42;
 	config.hostAddress = (STRING_HANDLE)0x42;
 	config.securityKey = (STRING_HANDLE)0x42;
@@ -2328,23 +2267,13 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_happy_path_empty_content)
 	STRICT_EXPECTED_CALL(Message_GetContent((MESSAGE_HANDLE)0x42))
 		.SetReturn(&buffer);
 
-	STRICT_EXPECTED_CALL(STRING_construct_n(IGNORED_PTR_ARG, 0))
-		.IgnoreArgument(1).SetReturn((STRING_HANDLE)0x42);
-
-	STRICT_EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG))
-		.IgnoreAllArguments()
-		.SetReturn((STRING_HANDLE)0x42);
-
-	STRICT_EXPECTED_CALL(STRING_concat((STRING_HANDLE)0x42, IGNORED_PTR_ARG))
-		.IgnoreArgument(2)
-		.SetReturn(0);
+	STRICT_EXPECTED_CALL(BUFFER_new())
+		.SetReturn((BUFFER_HANDLE)0x43);
 
-	STRICT_EXPECTED_CALL(STRING_concat_with_STRING((STRING_HANDLE)0x42, (STRING_HANDLE)0x42))
+	STRICT_EXPECTED_CALL(BUFFER_pre_build((BUFFER_HANDLE)0x43, TEST_EMPTY_BODY_SIZE))
 		.SetReturn(0);
 
-	STRICT_EXPECTED_CALL(STRING_concat((STRING_HANDLE)0x42, IGNORED_PTR_ARG))
-		.IgnoreArgument(2)
-		.SetReturn(0);
+	STRICT_EXPECTED_CALL(BUFFER_u_char((BUFFER_HANDLE)0x43));
 
 	STRICT_EXPECTED_CALL(STRING_c_str((STRING_HANDLE)0x42))
 		.SetReturn("AnyContent42");
@@ -2380,26 +2309,14 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_happy_path_empty_content)
 		.SetReturn(HTTP_HEADERS_OK);
 
 
-	STRICT_EXPECTED_CALL(STRING_length((STRING_HANDLE)0x42))
-		.SetReturn(42);
-
-	STRICT_EXPECTED_CALL(STRING_c_str((STRING_HANDLE)0x42))
-		.SetReturn("AnyContent42");
-
-	STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-		.IgnoreAllArguments()
-		.SetReturn((BUFFER_HANDLE)0x42);
-
 	STRICT_EXPECTED_CALL(STRING_c_str((STRING_HANDLE)0x42))
 		.SetReturn("AnyContent42");
 
-	STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest((HTTPAPIEX_HANDLE)0x42, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, (HTTP_HEADERS_HANDLE)0x42, (BUFFER_HANDLE)0x42, IGNORED_PTR_ARG, NULL, (BUFFER_HANDLE)0x42))
+	STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest((HTTPAPIEX_HANDLE)0x42, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, (HTTP_HEADERS_HANDLE)0x42, (BUFFER_HANDLE)0x43, IGNORED_PTR_ARG, NULL, (BUFFER_HANDLE)0x42))
 		.IgnoreArgument(3)
 		.IgnoreArgument(6)
 		.SetReturn(HTTPAPIEX_OK);
 
-	STRICT_EXPECTED_CALL(BUFFER_delete((BUFFER_HANDLE)0x42));
-
 	STRICT_EXPECTED_CALL(HTTPHeaders_Free((HTTP_HEADERS_HANDLE)0x42));
 
 	STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
@@ -2408,15 +2325,14 @@ TEST_FUNCTION(AZURE_FUNCTIONS_Receive_happy_path_empty_content)
 
 	STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy((HTTPAPIEX_HANDLE)0x42));
 
-	STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
-
-	STRICT_EXPECTED_CALL(STRING_delete((STRING_HANDLE)0x42));
+	STRICT_EXPECTED_CALL(BUFFER_delete((BUFFER_HANDLE)0x43));
 
 	//act
 	MODULE_RECEIVE(apis)(moduleInfo, (MESSAGE_HANDLE)0x42);
 
 	//assert
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(int, 0, memcmp(TEST_EMPTY_BODY, test_post_content, TEST_EMPTY_BODY_SIZE));
 
 	//cleanup 
 	MODULE_DESTROY(apis)(moduleInfo);
@@ -8,6 +8,7 @@
 #define GW_SOURCE_PROPERTY                  "source"
 #define GW_DEVICENAME_PROPERTY              "deviceName"
 #define GW_DEVICEKEY_PROPERTY               "deviceKey"
+#define GW_MAPPING_UPDATE_PROPERTY          "mappingUpdate"
 
 #define GW_SOURCE_BLE_COMMAND               "bleCommand"
 #define GW_SOURCE_BLE_TELEMETRY             "bleTelemetry"
@@ -5,6 +5,7 @@
 #define IDENTITYMAP_H
 
 #include "module.h"
+#include "azure_c_shared_utility/vector.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -18,6 +19,19 @@ typedef struct IDENTITY_MAP_CONFIG_TAG
     const char* deviceKey;
 } IDENTITY_MAP_CONFIG;
 
+/*
+ * Configuration passed to the module's Create. Earlier releases took the
+ * mapping VECTOR_HANDLE itself; hosts building the configuration by hand
+ * must now wrap it here. mappingUpdateSource, or NULL to refuse mapping
+ * updates, is compared with the "source" property of update messages; it
+ * identifies the sender but does not authenticate it.
+ */
+typedef struct IDENTITY_MAP_MODULE_CONFIG_TAG
+{
+    VECTOR_HANDLE mapping;
+    const char* mappingUpdateSource;
+} IDENTITY_MAP_MODULE_CONFIG;
+
 MODULE_EXPORT const MODULE_API* MODULE_STATIC_GETAPI(IDENTITYMAP_MODULE)(MODULE_API_VERSION gateway_api_version);
 
 #ifdef __cplusplus
@@ -4,6 +4,8 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 #include "azure_c_shared_utility/gballoc.h"
 
 #include <stddef.h>
@@ -22,14 +24,40 @@
 
 #include <parson.h>
 
+/* A slot of an index holds the position of its entry plus one, 0 marks an empty slot. */
+typedef uint32_t IDENTITY_MAP_SLOT;
+
+typedef struct IDENTITY_MAP_ENTRY_TAG
+{
+    uint64_t mac;
+    size_t deviceIdHash;
+    IDENTITY_MAP_CONFIG config;
+} IDENTITY_MAP_ENTRY;
+
+/*
+ * Mapping triplets with an open addressing index on the parsed MAC address and
+ * another on the device id. The table, its entries and both indexes are a single
+ * allocation, so a new table can be built aside and swapped in whole.
+ */
+typedef struct IDENTITY_MAP_TABLE_TAG
+{
+    size_t mappingSize;
+    size_t slotMask;
+    IDENTITY_MAP_ENTRY * entries;
+    IDENTITY_MAP_SLOT * macIndex;
+    IDENTITY_MAP_SLOT * deviceIdIndex;
+} IDENTITY_MAP_TABLE;
+
 typedef struct IDENTITY_MAP_DATA_TAG
 {
     BROKER_HANDLE broker;
-    size_t mappingSize;
-    IDENTITY_MAP_CONFIG * macToDevIdArray;
-    IDENTITY_MAP_CONFIG * devIdToMacArray;
+    IDENTITY_MAP_TABLE * table;
+    char * mappingUpdateSource;
 } IDENTITY_MAP_DATA;
 
+#define MAC_ADDRESS_LENGTH 17
+#define ALIGN_TO_ENTRY(size) (((size) + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1))
+
 #define IDENTITYMAP_RESULT_VALUES \
     IDENTITYMAP_OK, \
     IDENTITYMAP_ERROR, \
@@ -42,6 +70,8 @@ DEFINE_ENUM_STRINGS(BROKER_RESULT, BROKER_RESULT_VALUES);
 #define MACADDR "macAddress"
 #define DEVICENAME "deviceId"
 #define DEVICEKEY "deviceKey"
+#define MAPPING "mapping"
+#define MAPPING_UPDATE_SOURCE "mappingUpdateSource"
 
 static IDENTITYMAP_RESULT IdentityMapConfig_CopyDeep(IDENTITY_MAP_CONFIG * dest, IDENTITY_MAP_CONFIG * source);
 static void IdentityMapConfig_Free(IDENTITY_MAP_CONFIG * element);
@@ -193,65 +223,236 @@ static void IdentityMapConfig_Free(IDENTITY_MAP_CONFIG * element)
     free((void*)element->deviceKey);
 }
 
-/*Codes_SRS_IDMAP_17_006: [If any macAddress string in configuration is not a MAC address in canonical form, this function shall fail and return NULL.]*/
-static bool IdentityMapConfig_IsCanonicalMAC(const char * macAddress)
+static int IdentityMapConfig_HexDigit(char c)
 {
-    /* Every MAC address must be in the form "XX:XX:XX:XX:XX:XX" X=[0-9,a-f,A-F] */
-    bool recognized;
-    const size_t fixedSize = 17;
-    const size_t numDigits = 12;
-    const size_t numColons = 5;
-    const size_t digits[] = { 0, 1, 3, 4, 6, 7, 9, 10, 12, 13, 15, 16 };
-    const size_t colons[] = { 2, 5, 8, 11, 14 };
-    size_t macSize = strlen(macAddress);
-    if (macSize != fixedSize)
+    int digit;
+    if (c >= '0' && c <= '9')
     {
-        recognized = false;
+        digit = c - '0';
+    }
+    else if (c >= 'a' && c <= 'f')
+    {
+        digit = c - 'a' + 10;
+    }
+    else if (c >= 'A' && c <= 'F')
+    {
+        digit = c - 'A' + 10;
     }
     else
     {
-        recognized = true;
-        size_t i;
-        for (i = 0; i < numDigits; i++)
+        digit = -1;
+    }
+    return digit;
+}
+
+/*
+ * @brief    Parse a MAC address in canonical form into its 48 bit value, so lookups
+ *            compare integers instead of strings. Returns false if not canonical.
+ */
+/*Codes_SRS_IDMAP_17_006: [If any macAddress string in configuration is not a MAC address in canonical form, this function shall fail and return NULL.]*/
+static bool IdentityMapConfig_ParseMAC(const char * macAddress, uint64_t * mac)
+{
+    /* Every MAC address must be in the form "XX:XX:XX:XX:XX:XX" X=[0-9,a-f,A-F] */
+    bool recognized = true;
+    uint64_t value = 0;
+    size_t i;
+    for (i = 0; (i < MAC_ADDRESS_LENGTH) && (recognized == true); i++)
+    {
+        if (i % 3 == 2)
+        {
+            recognized = (macAddress[i] == ':');
+        }
+        else
         {
-            if (!isxdigit(macAddress[digits[i]]))
+            int digit = IdentityMapConfig_HexDigit(macAddress[i]);
+            if (digit < 0)
             {
                 recognized = false;
-                break;
             }
-        }
-        if (recognized == true)
-        {
-            for (i = 0; i < numColons; i++)
+            else
             {
-                if (macAddress[colons[i]] != ':')
-                {
-                    recognized = false;
-                    break;
-                }
+                value = (value << 4) | (uint64_t)digit;
             }
         }
     }
+    if ((recognized == true) && (macAddress[MAC_ADDRESS_LENGTH] == '\0'))
+    {
+        *mac = value;
+    }
+    else
+    {
+        recognized = false;
+    }
     return recognized;
 }
 
+static size_t IdentityMap_HashMac(uint64_t mac)
+{
+    /* Fibonacci hashing, so devices sharing a vendor prefix still spread out */
+    return (size_t)((mac * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+static size_t IdentityMap_HashDeviceId(const char * deviceId)
+{
+    /* 32 bit FNV-1a */
+    uint32_t hash = 2166136261u;
+    while (*deviceId != '\0')
+    {
+        hash ^= (unsigned char)*deviceId++;
+        hash *= 16777619u;
+    }
+    return (size_t)hash;
+}
+
 /*
- * @brief    Comparison function by MAC address for two IDENTITY_MAP_CONFIG structures
+ * @brief    Find the triplet of a MAC address.
  */
-static int IdentityMapConfig_MacCompare(const void * a, const void * b)
+static IDENTITY_MAP_CONFIG * IdentityMapTable_FindByMac(const IDENTITY_MAP_TABLE * table, uint64_t mac)
 {
-    const IDENTITY_MAP_CONFIG * idA = a;
-    const IDENTITY_MAP_CONFIG * idB = b;
-    return strcmp(idA->macAddress, idB->macAddress);
+    IDENTITY_MAP_CONFIG * result = NULL;
+    size_t slot = IdentityMap_HashMac(mac) & table->slotMask;
+    IDENTITY_MAP_SLOT position;
+    /* indexes are never more than half full, so there is always an empty slot to stop on */
+    while ((position = table->macIndex[slot]) != 0)
+    {
+        if (table->entries[position - 1].mac == mac)
+        {
+            result = &(table->entries[position - 1].config);
+            break;
+        }
+        slot = (slot + 1) & table->slotMask;
+    }
+    return result;
 }
+
 /*
-* @brief    Comparison function by deviceId for two IDENTITY_MAP_CONFIG structures
-*/
-static int IdentityMapConfig_IdCompare(const void * a, const void * b)
+ * @brief    Find the triplet of a device id.
+ */
+static IDENTITY_MAP_CONFIG * IdentityMapTable_FindByDeviceId(const IDENTITY_MAP_TABLE * table, const char * deviceId)
 {
-    const IDENTITY_MAP_CONFIG * idA = a;
-    const IDENTITY_MAP_CONFIG * idB = b;
-    return strcmp(idA->deviceId, idB->deviceId);
+    IDENTITY_MAP_CONFIG * result = NULL;
+    size_t hash = IdentityMap_HashDeviceId(deviceId);
+    size_t slot = hash & table->slotMask;
+    IDENTITY_MAP_SLOT position;
+    while ((position = table->deviceIdIndex[slot]) != 0)
+    {
+        IDENTITY_MAP_ENTRY * entry = &(table->entries[position - 1]);
+        if ((entry->deviceIdHash == hash) && (strcmp(entry->config.deviceId, deviceId) == 0))
+        {
+            result = &(entry->config);
+            break;
+        }
+        slot = (slot + 1) & table->slotMask;
+    }
+    return result;
+}
+
+/*
+ * @brief    Add the entry at position to both indexes. A later triplet with the
+ *            same MAC address or device id replaces the earlier one.
+ */
+static void IdentityMapTable_Index(IDENTITY_MAP_TABLE * table, size_t position)
+{
+    IDENTITY_MAP_ENTRY * entry = &(table->entries[position]);
+    size_t slot = IdentityMap_HashMac(entry->mac) & table->slotMask;
+    while ((table->macIndex[slot] != 0) &&
+        (table->entries[table->macIndex[slot] - 1].mac != entry->mac))
+    {
+        slot = (slot + 1) & table->slotMask;
+    }
+    table->macIndex[slot] = (IDENTITY_MAP_SLOT)(position + 1);
+
+    slot = entry->deviceIdHash & table->slotMask;
+    while ((table->deviceIdIndex[slot] != 0) &&
+        ((table->entries[table->deviceIdIndex[slot] - 1].deviceIdHash != entry->deviceIdHash) ||
+        (strcmp(table->entries[table->deviceIdIndex[slot] - 1].config.deviceId, entry->config.deviceId) != 0)))
+    {
+        slot = (slot + 1) & table->slotMask;
+    }
+    table->deviceIdIndex[slot] = (IDENTITY_MAP_SLOT)(position + 1);
+}
+
+/*
+ * @brief    Release a mapping table and the strings it owns.
+ */
+static void IdentityMapTable_Destroy(IDENTITY_MAP_TABLE * table)
+{
+    size_t index;
+    for (index = 0; index < table->mappingSize; index++)
+    {
+        IdentityMapConfig_Free(&(table->entries[index].config));
+    }
+    free(table);
+}
+
+/*
+ * @brief    Build a mapping table from a validated mappingVector.
+ */
+static IDENTITY_MAP_TABLE * IdentityMapTable_Create(const VECTOR_HANDLE mappingVector)
+{
+    IDENTITY_MAP_TABLE * result;
+    /* validation ensures the vector is greater than zero */
+    size_t mappingSize = VECTOR_size(mappingVector);
+    size_t slotCount = 2;
+    while (slotCount < 2 * mappingSize)
+    {
+        slotCount <<= 1;
+    }
+
+    if (mappingSize > (UINT32_MAX >> 2))
+    {
+        /*Codes_SRS_IDMAP_17_011: [If IdentityMap_Create fails to create memory for the mapping table, then this function shall fail and return NULL.]*/
+        LogError("Too many mapping triplets: %zu", mappingSize);
+        result = NULL;
+    }
+    else
+    {
+        size_t entriesOffset = ALIGN_TO_ENTRY(sizeof(IDENTITY_MAP_TABLE));
+        size_t indexOffset = entriesOffset + mappingSize * sizeof(IDENTITY_MAP_ENTRY);
+        size_t indexSize = slotCount * sizeof(IDENTITY_MAP_SLOT);
+        unsigned char * block = (unsigned char *)malloc(indexOffset + 2 * indexSize);
+        if (block == NULL)
+        {
+            /*Codes_SRS_IDMAP_17_011: [If IdentityMap_Create fails to create memory for the mapping table, then this function shall fail and return NULL.]*/
+            LogError("Could not allocate mapping table");
+            result = NULL;
+        }
+        else
+        {
+            size_t index;
+            result = (IDENTITY_MAP_TABLE *)block;
+            result->mappingSize = 0;
+            result->slotMask = slotCount - 1;
+            result->entries = (IDENTITY_MAP_ENTRY *)(block + entriesOffset);
+            result->macIndex = (IDENTITY_MAP_SLOT *)(block + indexOffset);
+            result->deviceIdIndex = (IDENTITY_MAP_SLOT *)(block + indexOffset + indexSize);
+            (void)memset(result->macIndex, 0, 2 * indexSize);
+
+            for (index = 0; index < mappingSize; index++)
+            {
+                IDENTITY_MAP_CONFIG * element = (IDENTITY_MAP_CONFIG *)VECTOR_element(mappingVector, index);
+                IDENTITY_MAP_ENTRY * entry = &(result->entries[index]);
+                if (IdentityMapConfig_CopyDeep(&(entry->config), element) != IDENTITYMAP_OK)
+                {
+                    break;
+                }
+                /* validation ensures every MAC address is canonical */
+                (void)IdentityMapConfig_ParseMAC(entry->config.macAddress, &(entry->mac));
+                entry->deviceIdHash = IdentityMap_HashDeviceId(entry->config.deviceId);
+                result->mappingSize = index + 1;
+                IdentityMapTable_Index(result, index);
+            }
+
+            if (result->mappingSize < mappingSize)
+            {
+                /*Codes_SRS_IDMAP_17_012: [If IdentityMap_Create fails to add a MAC address triplet to the mapping table, then this function shall fail, release all resources, and return NULL.]*/
+                LogError("Could not copy mapping triplet %zu", result->mappingSize);
+                IdentityMapTable_Destroy(result);
+                result = NULL;
+            }
+        }
+    }
+    return result;
 }
 
 /*
@@ -286,7 +487,8 @@ static bool IdentityMap_ValidateConfig(const VECTOR_HANDLE mappingVector)
             }
             else
             {
-                if (IdentityMapConfig_IsCanonicalMAC(element->macAddress) == false)
+                uint64_t mac;
+                if (IdentityMapConfig_ParseMAC(element->macAddress, &mac) == false)
                 {
                     /*Codes_SRS_IDMAP_17_006: [If any macAddress string in configuration is not a MAC address in canonical form, this function shall fail and return NULL.]*/
                     LogError("Non-canonical MAC Address: %s", element->macAddress);
@@ -312,9 +514,16 @@ static MODULE_HANDLE IdentityMap_Create(BROKER_HANDLE broker, const void* config
         LogError("invalid parameter (NULL).");
         result = NULL;
     }
+    else if (((const IDENTITY_MAP_MODULE_CONFIG*)configuration)->mapping == NULL)
+    {
+        /*Codes_SRS_IDMAP_17_005: [If the configuration is NULL, this function shall fail and return NULL.]*/
+        LogError("invalid parameter (NULL mapping).");
+        result = NULL;
+    }
     else
     {
-        VECTOR_HANDLE mappingVector = (VECTOR_HANDLE)configuration;
+        const IDENTITY_MAP_MODULE_CONFIG * config = (const IDENTITY_MAP_MODULE_CONFIG*)configuration;
+        VECTOR_HANDLE mappingVector = config->mapping;
         if (IdentityMap_ValidateConfig(mappingVector) == false)
         {
             LogError("unable to validate mapping table");
@@ -330,77 +539,27 @@ static MODULE_HANDLE IdentityMap_Create(BROKER_HANDLE broker, const void* config
             }
             else
             {
-                size_t mappingSize = VECTOR_size(mappingVector);
-                /* validation ensures the vector is greater than zero */
-                result->macToDevIdArray = (IDENTITY_MAP_CONFIG*)malloc(mappingSize*sizeof(IDENTITY_MAP_CONFIG));
-                if (result->macToDevIdArray == NULL)
+                result->mappingUpdateSource = NULL;
+                result->table = IdentityMapTable_Create(mappingVector);
+                if (result->table == NULL)
+                {
+                    LogError("Could not build mapping table");
+                    free(result);
+                    result = NULL;
+                }
+                else if (config->mappingUpdateSource != NULL &&
+                    mallocAndStrcpy_s(&(result->mappingUpdateSource), config->mappingUpdateSource) != 0)
                 {
-                    /*Codes_SRS_IDMAP_17_011: [If IdentityMap_Create fails to create memory for the macToDeviceArray, then this function shall fail and return NULL.*/
-                    LogError("Could not allocate mac to device mapping table");
+                    /*Codes_SRS_IDMAP_17_072: [ If the configuration has a mappingUpdateSource, IdentityMap_Create shall copy it; if the copy fails, IdentityMap_Create shall fail, release all resources, and return NULL. ]*/
+                    LogError("Could not copy mapping update source");
+                    IdentityMapTable_Destroy(result->table);
                     free(result);
                     result = NULL;
                 }
                 else
                 {
-                    result->devIdToMacArray = (IDENTITY_MAP_CONFIG*)malloc(mappingSize*sizeof(IDENTITY_MAP_CONFIG));
-                    if (result->devIdToMacArray == NULL)
-                    {
-                        /*Codes_SRS_IDMAP_17_042: [ If IdentityMap_Create fails to create memory for the deviceToMacArray, then this function shall fail and return NULL. */
-                        LogError("Could not allocate devicee to mac mapping table");
-                        free(result->macToDevIdArray);
-                        free(result);
-                        result = NULL;
-                    }
-                    else
-                    {
-
-                        size_t index;
-                        size_t failureIndex = mappingSize;
-                        for (index = 0; index < mappingSize; index++)
-                        {
-                            IDENTITY_MAP_CONFIG * element = (IDENTITY_MAP_CONFIG *)VECTOR_element(mappingVector, index);
-                            IDENTITY_MAP_CONFIG * dest = &(result->macToDevIdArray[index]);
-                            IDENTITYMAP_RESULT copyResult;
-                            copyResult = IdentityMapConfig_CopyDeep(dest, element);
-                            if (copyResult != IDENTITYMAP_OK)
-                            {
-                                failureIndex = index;
-                                break;
-                            }
-                            dest = &(result->devIdToMacArray[index]);
-                            copyResult = IdentityMapConfig_CopyDeep(dest, element);
-                            if (copyResult != IDENTITYMAP_OK)
-                            {
-                                IdentityMapConfig_Free(&(result->macToDevIdArray[index]));
-                                failureIndex = index;
-                                break;
-                            }
-                        }
-                        if (failureIndex < mappingSize)
-                        {
-                            /*Codes_SRS_IDMAP_17_012: [If IdentityMap_Create fails to add a MAC address triplet to the macToDeviceArray, then this function shall fail, release all resources, and return NULL.]*/
-                            /*Codes_SRS_IDMAP_17_043: [ If IdentityMap_Create fails to add a MAC address triplet to the deviceToMacArray, then this function shall fail, release all resources, and return NULL. */
-                            for (index = 0; index < failureIndex; index++)
-                            {
-                                IdentityMapConfig_Free(&(result->macToDevIdArray[index]));
-                                IdentityMapConfig_Free(&(result->devIdToMacArray[index]));
-                            }
-                            free(result->macToDevIdArray);
-                            free(result->devIdToMacArray);
-                            free(result);
-                            result = NULL;
-                        }
-                        else
-                        {
-                            /*Codes_SRS_IDMAP_17_003: [Upon success, this function shall return a valid pointer to a MODULE_HANDLE.]*/
-                            qsort(result->macToDevIdArray, mappingSize, sizeof(IDENTITY_MAP_CONFIG),
-                                IdentityMapConfig_MacCompare);
-                            qsort(result->devIdToMacArray, mappingSize, sizeof(IDENTITY_MAP_CONFIG),
-                                IdentityMapConfig_IdCompare);
-                            result->mappingSize = mappingSize;
-                            result->broker = broker;
-                        }
-                    }
+                    /*Codes_SRS_IDMAP_17_003: [Upon success, this function shall return a valid pointer to a MODULE_HANDLE.]*/
+                    result->broker = broker;
                 }
             }
         }
@@ -408,12 +567,103 @@ static MODULE_HANDLE IdentityMap_Create(BROKER_HANDLE broker, const void* config
     return result;
 }
 
+/*
+* @brief    Parse a JSON array of mapping triplets into a vector of IDENTITY_MAP_CONFIG.
+*/
+static VECTOR_HANDLE IdentityMap_ParseMappingArray(JSON_Array * jsonArray)
+{
+    VECTOR_HANDLE result;
+    /*Codes_SRS_IDMAP_17_060: [ IdentityMap_ParseConfigurationFromJson shall allocate memory for the configuration vector. ]*/
+    /*Codes_SRS_IDMAP_05_007: [ IdentityMap_ParseConfigurationFromJson shall call VECTOR_create to make the identity map module input vector. ]*/
+    result = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
+    if (result == NULL)
+    {
+        //Codes_SRS_IDMAP_17_061: [ If allocation fails, IdentityMap_ParseConfigurationFromJson shall fail and return NULL. ]
+        /*Codes_SRS_IDMAP_05_019: [ If creating the vector fails, then IdentityMap_ParseConfigurationFromJson shall fail and return NULL. ]*/
+        LogError("Failed to create the input vector");
+    }
+    else
+    {
+        size_t numberOfRecords = json_array_get_count(jsonArray);
+        size_t record;
+        bool arrayParsed = true;
+        /*Codes_SRS_IDMAP_05_008: [ IdentityMap_ParseConfigurationFromJson shall walk through each object of the array. ]*/
+        for (record = 0; record < numberOfRecords; record++)
+        {
+            /*Codes_SRS_IDMAP_05_006: [ IdentityMap_ParseConfigurationFromJson shall parse the configuration as a JSON array of objects. ]*/
+            if (addOneRecord(result, json_array_get_object(jsonArray, record)) != true)
+            {
+                arrayParsed = false;
+                break;
+            }
+        }
+        if (arrayParsed != true)
+        {
+            numberOfRecords = VECTOR_size(result);
+            for (record = 0; record < numberOfRecords; record++)
+            {
+                IDENTITY_MAP_CONFIG *element = (IDENTITY_MAP_CONFIG *)VECTOR_element(result, record);
+                IdentityMapConfig_Free(element);
+            }
+            VECTOR_destroy(result);
+            /*Codes_SRS_IDMAP_05_005: [ If configuration is not a JSON array of JSON objects, then IdentityMap_ParseConfigurationFromJson shall fail and return NULL. ]*/
+            result = NULL;
+        }
+    }
+    return result;
+}
+
+/*
+* @brief    Release a vector of IDENTITY_MAP_CONFIG and the strings it holds.
+*/
+static void IdentityMap_FreeMapping(VECTOR_HANDLE mappingVector)
+{
+    size_t map_size = VECTOR_size(mappingVector);
+    size_t record;
+    for (record = 0; record < map_size; record++)
+    {
+        /*Codes_SRS_IDMAP_05_016: [ IdentityMap_FreeConfiguration shall release all data IdentityMap_ParseConfigurationFromJson allocated. ]*/
+        IDENTITY_MAP_CONFIG * element = (IDENTITY_MAP_CONFIG *)VECTOR_element(mappingVector, record);
+        IdentityMapConfig_Free(element);
+    }
+    VECTOR_destroy(mappingVector);
+}
+
+/*
+* @brief    Parse a mapping update, a JSON array of mapping triplets.
+*/
+static VECTOR_HANDLE IdentityMap_ParseMapping(const char * mappingJson)
+{
+    VECTOR_HANDLE result;
+    JSON_Value* json = json_parse_string(mappingJson);
+    if (json == NULL)
+    {
+        LogError("Unable to parse json string");
+        result = NULL;
+    }
+    else
+    {
+        JSON_Array *jsonArray = json_value_get_array(json);
+        if (jsonArray == NULL)
+        {
+            LogError("Expected a JSON Array in mapping");
+            result = NULL;
+        }
+        else
+        {
+            result = IdentityMap_ParseMappingArray(jsonArray);
+        }
+        json_value_free(json);
+    }
+    return result;
+}
+
 /*
 * @brief    Parse configuration for identity map module.
 */
 static void * IdentityMap_ParseConfigurationFromJson(const char* configuration)
 {
-    VECTOR_HANDLE result;
+    IDENTITY_MAP_MODULE_CONFIG * result;
     if (configuration == NULL)
     {
         /*Codes_SRS_IDMAP_05_004: [ If configuration is NULL then IdentityMap_ParseConfigurationFromJson shall fail and return NULL. ]*/
@@ -432,8 +682,20 @@ static void * IdentityMap_ParseConfigurationFromJson(const char* configuration)
         }
         else
         {
+            const char * mappingUpdateSource = NULL;
             /*Codes_SRS_IDMAP_05_006: [ IdentityMap_ParseConfigurationFromJson shall parse the configuration as a JSON array of objects. ]*/
             JSON_Array *jsonArray = json_value_get_array(json);
+            if (jsonArray == NULL)
+            {
+                /*Codes_SRS_IDMAP_17_071: [ If configuration is a JSON object, IdentityMap_ParseConfigurationFromJson shall parse its "mapping" value as the JSON array of objects and shall use its "mappingUpdateSource" value, if any, as the mappingUpdateSource. ]*/
+                JSON_Object *jsonObject = json_value_get_object(json);
+                if (jsonObject != NULL)
+                {
+                    jsonArray = json_object_get_array(jsonObject, MAPPING);
+                    mappingUpdateSource = json_object_get_string(jsonObject, MAPPING_UPDATE_SOURCE);
+                }
+            }
+
             if (jsonArray == NULL)
             {
                 /*Codes_SRS_IDMAP_05_005: [ If configuration is not a JSON array of JSON objects, then IdentityMap_ParseConfigurationFromJson shall fail and return NULL. ]*/
@@ -442,51 +704,39 @@ static void * IdentityMap_ParseConfigurationFromJson(const char* configuration)
             }
             else
             {
-				/*Codes_SRS_IDMAP_17_060: [ IdentityMap_ParseConfigurationFromJson shall allocate memory for the configuration vector. ]*/
-				/*Codes_SRS_IDMAP_05_007: [ IdentityMap_ParseConfigurationFromJson shall call VECTOR_create to make the identity map module input vector. ]*/
-                result = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
-                if (result == NULL)
+                VECTOR_HANDLE mappingVector = IdentityMap_ParseMappingArray(jsonArray);
+                if (mappingVector == NULL)
                 {
-                    //Codes_SRS_IDMAP_17_061: [ If allocation fails, IdentityMap_ParseConfigurationFromJson shall fail and return NULL. ]
-                    /*Codes_SRS_IDMAP_05_019: [ If creating the vector fails, then IdentityMap_ParseConfigurationFromJson shall fail and return NULL. ]*/
-                    LogError("Failed to create the input vector");
                     result = NULL;
                 }
+                else if ((result = (IDENTITY_MAP_MODULE_CONFIG*)malloc(sizeof(IDENTITY_MAP_MODULE_CONFIG))) == NULL)
+                {
+                    //Codes_SRS_IDMAP_17_061: [ If allocation fails, IdentityMap_ParseConfigurationFromJson shall fail and return NULL. ]
+                    LogError("Failed to allocate the module configuration");
+                    IdentityMap_FreeMapping(mappingVector);
+                }
                 else
                 {
-                    size_t numberOfRecords = json_array_get_count(jsonArray);
-                    size_t record;
-                    bool arrayParsed = true;
-                    /*Codes_SRS_IDMAP_05_008: [ IdentityMap_ParseConfigurationFromJson shall walk through each object of the array. ]*/
-                    for (record = 0; record < numberOfRecords; record++)
+                    char * updateSource = NULL;
+                    if (mappingUpdateSource != NULL &&
+                        mallocAndStrcpy_s(&updateSource, mappingUpdateSource) != 0)
                     {
-                        /*Codes_SRS_IDMAP_05_006: [ IdentityMap_ParseConfigurationFromJson shall parse the configuration as a JSON array of objects. ]*/
-                        if (addOneRecord(result, json_array_get_object(jsonArray, record)) != true)
-                        {
-                            arrayParsed = false;
-                            break;
-                        }
-                    }
-                    if (arrayParsed != true)
-                    {
-                        numberOfRecords = VECTOR_size(result);
-                        for (record = 0; record < numberOfRecords; record++)
-                        {
-                            IDENTITY_MAP_CONFIG *element = (IDENTITY_MAP_CONFIG *)VECTOR_element(result, record);
-                            IdentityMapConfig_Free(element);
-                        }
-                        VECTOR_destroy(result);
-                        /*Codes_SRS_IDMAP_05_005: [ If configuration is not a JSON array of JSON objects, then IdentityMap_ParseConfigurationFromJson shall fail and return NULL. ]*/
+                        //Codes_SRS_IDMAP_17_061: [ If allocation fails, IdentityMap_ParseConfigurationFromJson shall fail and return NULL. ]
+                        LogError("Failed to copy the mapping update source");
+                        IdentityMap_FreeMapping(mappingVector);
+                        free(result);
                         result = NULL;
                     }
                     else
                     {
                         /*Codes_SRS_IDMAP_17_062: [ IdentityMap_ParseConfigurationFromJson shall return the pointer to the configuration vector on success. ]*/
+                        result->mapping = mappingVector;
+                        result->mappingUpdateSource = updateSource;
                     }
                 }
             }
-			json_value_free(json);
-		}
+            json_value_free(json);
+        }
     }
     return result;
 }
@@ -497,16 +747,11 @@ static void IdentityMap_FreeConfiguration(void * configuration)
     /*Codes_SRS_IDMAP_17_059: [ IdentityMap_FreeConfiguration shall do nothing if configuration is NULL. ]*/
     if (configuration != NULL)
     {
-        VECTOR_HANDLE map_vector = (VECTOR_HANDLE)configuration;
-        size_t map_size = VECTOR_size(map_vector);
-        size_t record;
-        for (record = 0; record < map_size; record++)
-        {
-            /*Codes_SRS_IDMAP_05_016: [ IdentityMap_FreeConfiguration shall release all data IdentityMap_ParseConfigurationFromJson allocated. ]*/
-            IDENTITY_MAP_CONFIG * element = (IDENTITY_MAP_CONFIG *)VECTOR_element(map_vector, record);
-            IdentityMapConfig_Free(element);
-        }
-        VECTOR_destroy(map_vector);
+        IDENTITY_MAP_MODULE_CONFIG * config = (IDENTITY_MAP_MODULE_CONFIG *)configuration;
+        /*Codes_SRS_IDMAP_05_016: [ IdentityMap_FreeConfiguration shall release all data IdentityMap_ParseConfigurationFromJson allocated. ]*/
+        IdentityMap_FreeMapping(config->mapping);
+        free((void*)config->mappingUpdateSource);
+        free(config);
     }
 }
 /*
@@ -519,53 +764,32 @@ static void IdentityMap_Destroy(MODULE_HANDLE moduleHandle)
     {
         /*Codes_SRS_IDMAP_17_015: [IdentityMap_Destroy shall release all resources allocated for the module.]*/
         IDENTITY_MAP_DATA * idModule = (IDENTITY_MAP_DATA*)moduleHandle;
-        for (size_t index = 0; index < idModule->mappingSize; index++)
-        {
-            IdentityMapConfig_Free(&(idModule->macToDevIdArray[index]));
-            IdentityMapConfig_Free(&(idModule->devIdToMacArray[index]));
-        }
-        free(idModule->macToDevIdArray);
-        free(idModule->devIdToMacArray);
+        IdentityMapTable_Destroy(idModule->table);
+        free(idModule->mappingUpdateSource);
         free(idModule);
     }
 }
 
-static void publish_with_new_properties(MAP_HANDLE newProperties, MESSAGE_HANDLE messageHandle, IDENTITY_MAP_DATA * idModule)
+static void publish_with_edited_properties(IDENTITY_MAP_DATA * idModule, MESSAGE_HANDLE messageHandle, const MESSAGE_PROPERTY_EDIT * edits, size_t editCount)
 {
-    /*Codes_SRS_IDMAP_17_034: [IdentityMap_Receive shall clone message content.] */
-    CONSTBUFFER_HANDLE content = Message_GetContentHandle(messageHandle);
-    if (content == NULL)
+    /*Codes_SRS_IDMAP_17_067: [ IdentityMap_Receive shall create the message to send by calling Message_CreateDerived with messageHandle and the property edits, so the content and the unchanged properties are not copied. ]*/
+    MESSAGE_HANDLE newMessage = Message_CreateDerived(messageHandle, edits, editCount);
+    if (newMessage == NULL)
     {
-        /*Codes_SRS_IDMAP_17_035: [If cloning message content fails, IdentityMap_Receive shall deallocate all resources and return.]*/
-        LogError("Could not extract message content");
+        /*Codes_SRS_IDMAP_17_068: [ If Message_CreateDerived fails, IdentityMap_Receive shall deallocate all resources and return. ]*/
+        LogError("Could not create new message to publish");
     }
     else
     {
-        MESSAGE_BUFFER_CONFIG newMessageConfig =
+        BROKER_RESULT brokerStatus;
+        /*Codes_SRS_IDMAP_17_038: [IdentityMap_Receive shall call Broker_Publish with broker and new message.]*/
+        brokerStatus = Broker_Publish(idModule->broker, (MODULE_HANDLE)idModule, newMessage);
+        if (brokerStatus != BROKER_OK)
         {
-            content,
-            newProperties
-        };
-        /*Codes_SRS_IDMAP_17_036: [IdentityMap_Receive shall create a new message by calling Message_CreateFromBuffer with new map and cloned content.]*/
-        MESSAGE_HANDLE newMessage = Message_CreateFromBuffer(&newMessageConfig);
-        if (newMessage == NULL)
-        {
-            /*Codes_SRS_IDMAP_17_037: [If creating new message fails, IdentityMap_Receive shall deallocate all resources and return.]*/
-            LogError("Could not create new message to publish");
-        }
-        else
-        {
-            BROKER_RESULT brokerStatus;
-            /*Codes_SRS_IDMAP_17_038: [IdentityMap_Receive shall call Broker_Publish with broker and new message.]*/
-            brokerStatus = Broker_Publish(idModule->broker, (MODULE_HANDLE)idModule, newMessage);
-            if (brokerStatus != BROKER_OK)
-            {
-                LogError("Message broker publish failure: %s", ENUM_TO_STRING(BROKER_RESULT, brokerStatus));
-            }
-            Message_Destroy(newMessage);
+            LogError("Message broker publish failure: %s", ENUM_TO_STRING(BROKER_RESULT, brokerStatus));
         }
         /*Codes_SRS_IDMAP_17_039: [IdentityMap_Receive will destroy all resources it created.]*/
-        CONSTBUFFER_Destroy(content);
+        Message_Destroy(newMessage);
     }
 }
 
@@ -577,55 +801,15 @@ static void IdentityMap_RepublishD2C(
     MESSAGE_HANDLE messageHandle,
     IDENTITY_MAP_CONFIG * match)
 {
-    CONSTMAP_HANDLE properties = Message_GetProperties(messageHandle);
-    if (properties == NULL)
-    {
-
-        LogError("Could not extract message properties");
-    }
-    else
+    /*Codes_SRS_IDMAP_17_069: [ On a D2C message, IdentityMap_Receive shall set "deviceName" to the found deviceId, "deviceKey" to the found deviceKey and "source" to "mapping", and shall remove "macAddress". ]*/
+    MESSAGE_PROPERTY_EDIT edits[] =
     {
-        /*Codes_SRS_IDMAP_17_026: [On a message which passes all checks, IdentityMap_Receive shall call ConstMap_CloneWriteable on the message properties.]*/
-        MAP_HANDLE newProperties = ConstMap_CloneWriteable(properties);
-        if (newProperties == NULL)
-        {
-            /*Codes_SRS_IDMAP_17_027: [If ConstMap_CloneWriteable fails, IdentityMap_Receive shall deallocate any resources and return.] */
-            LogError("Could not make writeable new properties map");
-        }
-        else
-        {
-            /*Codes_SRS_IDMAP_17_028: [IdentityMap_Receive shall call Map_AddOrUpdate with key of "deviceName" and value of found deviceId.]*/
-            if (Map_AddOrUpdate(newProperties, GW_DEVICENAME_PROPERTY, match->deviceId) != MAP_OK)
-            {
-                /*Codes_SRS_IDMAP_17_029: [If adding deviceName fails,IdentityMap_Receive shall deallocate all resources and return.]*/
-                LogError("Could not attach %s property to message", GW_DEVICENAME_PROPERTY);
-            }
-            /*Codes_SRS_IDMAP_17_030: [IdentityMap_Receive shall call Map_AddOrUpdate with key of "deviceKey" and value of found deviceKey.]*/
-            else if (Map_AddOrUpdate(newProperties, GW_DEVICEKEY_PROPERTY, match->deviceKey) != MAP_OK)
-            {
-                /*Codes_SRS_IDMAP_17_031: [If adding deviceKey fails, IdentityMap_Receive shall deallocate all resources and return.]*/
-                LogError("Could not attach %s property to message", GW_DEVICEKEY_PROPERTY);
-            }
-            /*Codes_SRS_IDMAP_17_032: [IdentityMap_Receive shall call Map_AddOrUpdate with key of "source" and value of "mapping".]*/
-            else if (Map_AddOrUpdate(newProperties, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE) != MAP_OK)
-            {
-                /*Codes_SRS_IDMAP_17_033: [If adding source fails, IdentityMap_Receive shall deallocate all resources and return.]*/
-                LogError("Could not attach %s property to message", GW_SOURCE_PROPERTY);
-            }
-            /*Codes_SRS_IDMAP_17_053: [ IdentityMap_Receive shall call Map_Delete to remove the "macAddress" property. ]*/
-            else if (Map_Delete(newProperties, GW_MAC_ADDRESS_PROPERTY) != MAP_OK)
-            {
-                /*Codes_SRS_IDMAP_17_054: [ If deleting the MAC Address fails, IdentityMap_Receive shall deallocate all resources and return. ]*/
-                LogError("Could not remove %s property from message", GW_MAC_ADDRESS_PROPERTY);
-            }
-            else
-            {
-                publish_with_new_properties(newProperties, messageHandle, idModule);
-            }
-            Map_Destroy(newProperties);
-        }
-        ConstMap_Destroy(properties);
-    }
+        { GW_DEVICENAME_PROPERTY, match->deviceId },
+        { GW_DEVICEKEY_PROPERTY, match->deviceKey },
+        { GW_SOURCE_PROPERTY, GW_IDMAP_MODULE },
+        { GW_MAC_ADDRESS_PROPERTY, NULL }
+    };
+    publish_with_edited_properties(idModule, messageHandle, edits, sizeof(edits) / sizeof(edits[0]));
 }
 
 /*
@@ -636,55 +820,15 @@ static void IdentityMap_RepublishC2D(
     MESSAGE_HANDLE messageHandle,
     IDENTITY_MAP_CONFIG * match)
 {
-    CONSTMAP_HANDLE properties = Message_GetProperties(messageHandle);
-    if (properties == NULL)
+    /*Codes_SRS_IDMAP_17_070: [ On a C2D message, IdentityMap_Receive shall set "macAddress" to the found macAddress and "source" to "mapping", and shall remove "deviceName" and "deviceKey", if present. ]*/
+    MESSAGE_PROPERTY_EDIT edits[] =
     {
-
-        LogError("Could not extract message properties");
-    }
-    else
-    {
-        /*Codes_SRS_IDMAP_17_049: [ On a C2D message received, IdentityMap_Receive shall call ConstMap_CloneWriteable on the message properties. ]*/
-        MAP_HANDLE newProperties = ConstMap_CloneWriteable(properties);
-        if (newProperties == NULL)
-        {
-            /*Codes_SRS_IDMAP_17_050: [ If ConstMap_CloneWriteable fails, IdentityMap_Receive shall deallocate any resources and return. ]*/
-            LogError("Could not make writeable new properties map");
-        }
-        else
-        {
-            /*Codes_SRS_IDMAP_17_051: [ IdentityMap_Receive shall call Map_AddOrUpdate with key of "macAddress" and value of found macAddress. ]*/
-            if (Map_AddOrUpdate(newProperties, GW_MAC_ADDRESS_PROPERTY, match->macAddress) != MAP_OK)
-            {
-                /*Codes_SRS_IDMAP_17_052: [ If adding macAddress fails, IdentityMap_Receive shall deallocate all resources and return. ]*/
-                LogError("Could not attach %s property to message", GW_MAC_ADDRESS_PROPERTY);
-            }
-            /*Codes_SRS_IDMAP_17_032: [IdentityMap_Receive shall call Map_AddOrUpdate with key of "source" and value of "mapping".]*/
-            else if (Map_AddOrUpdate(newProperties, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE) != MAP_OK)
-            {
-                /*Codes_SRS_IDMAP_17_033: [If adding source fails, IdentityMap_Receive shall deallocate all resources and return.]*/
-                LogError("Could not attach %s property to message", GW_SOURCE_PROPERTY);
-            }
-            /*Codes_SRS_IDMAP_17_055: [ IdentityMap_Receive shall call Map_Delete to remove the "deviceName" property. ]*/
-            else if (Map_Delete(newProperties, GW_DEVICENAME_PROPERTY) != MAP_OK)
-            {
-                /*Codes_SRS_IDMAP_17_056: [ If deleting the device name fails, IdentityMap_Receive shall deallocate all resources and return. ]*/
-                LogError("Could not remove %s property from message", GW_DEVICENAME_PROPERTY);
-            }
-            /*Codes_SRS_IDMAP_17_057: [ IdentityMap_Receive shall call Map_Delete to remove the "deviceKey" property. ]*/
-            else if (Map_Delete(newProperties, GW_DEVICEKEY_PROPERTY) == MAP_INVALIDARG)
-            {
-                /*Codes_SRS_IDMAP_17_058: [ If deleting the device key does not return MAP_OK or MAP_KEYNOTFOUND, IdentityMap_Receive shall deallocate all resources and return. ]*/
-                LogError("Could not remove %s property from message", GW_DEVICEKEY_PROPERTY);
-            }
-            else
-            {
-                publish_with_new_properties(newProperties, messageHandle, idModule);
-            }
-            Map_Destroy(newProperties);
-        }
-        ConstMap_Destroy(properties);
-    }
+        { GW_MAC_ADDRESS_PROPERTY, match->macAddress },
+        { GW_SOURCE_PROPERTY, GW_IDMAP_MODULE },
+        { GW_DEVICENAME_PROPERTY, NULL },
+        { GW_DEVICEKEY_PROPERTY, NULL }
+    };
+    publish_with_edited_properties(idModule, messageHandle, edits, sizeof(edits) / sizeof(edits[0]));
 }
 
 /* returns true if the message should continue to be processed, sets direction */
@@ -720,6 +864,64 @@ static bool determine_message_direction(const char * source, bool * isC2DMessage
     return result;
 }
 
+/*
+ * @brief    Replace the mapping table with the one carried by a mapping update
+ *            message. The new table is built aside, so messages are looked up in
+ *            either the old or the new table, never in a partial one.
+ */
+static void IdentityMap_UpdateMapping(IDENTITY_MAP_DATA * idModule, MESSAGE_HANDLE messageHandle)
+{
+    /*Codes_SRS_IDMAP_17_064: [ IdentityMap_Receive shall parse the message content as a JSON mapping array, in the same form as the module configuration. ]*/
+    const CONSTBUFFER * content = Message_GetContent(messageHandle);
+    char * mappingJson;
+    if (content == NULL)
+    {
+        /*Codes_SRS_IDMAP_17_066: [ If the new mapping cannot be parsed, validated or built, IdentityMap_Receive shall keep the current mapping table and return. ]*/
+        LogError("Could not get mapping update content");
+    }
+    else if ((mappingJson = (char*)malloc(content->size + 1)) == NULL)
+    {
+        /*Codes_SRS_IDMAP_17_066: [ If the new mapping cannot be parsed, validated or built, IdentityMap_Receive shall keep the current mapping table and return. ]*/
+        LogError("Could not allocate mapping update");
+    }
+    else
+    {
+        VECTOR_HANDLE mappingVector;
+        (void)memcpy(mappingJson, content->buffer, content->size);
+        mappingJson[content->size] = '\0';
+        mappingVector = IdentityMap_ParseMapping(mappingJson);
+        if (mappingVector == NULL)
+        {
+            /*Codes_SRS_IDMAP_17_066: [ If the new mapping cannot be parsed, validated or built, IdentityMap_Receive shall keep the current mapping table and return. ]*/
+            LogError("Could not parse mapping update");
+        }
+        else
+        {
+            IDENTITY_MAP_TABLE * newTable;
+            if (IdentityMap_ValidateConfig(mappingVector) == false)
+            {
+                /*Codes_SRS_IDMAP_17_066: [ If the new mapping cannot be parsed, validated or built, IdentityMap_Receive shall keep the current mapping table and return. ]*/
+                LogError("unable to validate mapping update");
+            }
+            else if ((newTable = IdentityMapTable_Create(mappingVector)) == NULL)
+            {
+                /*Codes_SRS_IDMAP_17_066: [ If the new mapping cannot be parsed, validated or built, IdentityMap_Receive shall keep the current mapping table and return. ]*/
+                LogError("Could not build mapping table from mapping update");
+            }
+            else
+            {
+                /*Codes_SRS_IDMAP_17_065: [ IdentityMap_Receive shall build a new mapping table, replace the current one with it, and release the current one. ]*/
+                IdentityMapTable_Destroy(idModule->table);
+                idModule->table = newTable;
+                LogInfo("Identity map reloaded with %zu triplets", newTable->mappingSize);
+            }
+            /*Codes_SRS_IDMAP_17_039: [IdentityMap_Receive will destroy all resources it created.]*/
+            IdentityMap_FreeMapping(mappingVector);
+        }
+        free(mappingJson);
+    }
+}
+
 /*
  * @brief    Receive a message from the message broker.
  */
@@ -738,7 +940,22 @@ static void IdentityMap_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messa
 
         const char * source = ConstMap_GetValue(properties, GW_SOURCE_PROPERTY);
         bool isC2DMessage;
-        if (determine_message_direction(source, &isC2DMessage))
+        if (ConstMap_GetValue(properties, GW_MAPPING_UPDATE_PROPERTY) != NULL)
+        {
+            if (idModule->mappingUpdateSource == NULL ||
+                source == NULL ||
+                strcmp(source, idModule->mappingUpdateSource) != 0)
+            {
+                /*Codes_SRS_IDMAP_17_073: [ If the module has no mappingUpdateSource, or the "source" property of a "mappingUpdate" message is missing or not equal to it, IdentityMap_Receive shall ignore the message. ]*/
+                LogError("Ignoring mapping update from source [%s]", (source == NULL) ? "" : source);
+            }
+            else
+            {
+                /*Codes_SRS_IDMAP_17_063: [ If messageHandle properties contains a "mappingUpdate" property, IdentityMap_Receive shall replace the mapping table with the mapping in the message content and shall not republish the message. ]*/
+                IdentityMap_UpdateMapping(idModule, messageHandle);
+            }
+        }
+        else if (determine_message_direction(source, &isC2DMessage))
         {
             if (isC2DMessage == true)
             {
@@ -746,15 +963,10 @@ static void IdentityMap_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messa
                 /*Codes_SRS_IDMAP_17_045: [ If messageHandle properties does not contain "deviceName" property, then the message shall not be marked as a C2D message. */
                 if (deviceName != NULL)
                 {
-                    IDENTITY_MAP_CONFIG key = { NULL,deviceName,NULL };
-
-                    IDENTITY_MAP_CONFIG * match = bsearch(&key,
-                        idModule->devIdToMacArray, idModule->mappingSize,
-                        sizeof(IDENTITY_MAP_CONFIG),
-                        IdentityMapConfig_IdCompare);
+                    IDENTITY_MAP_CONFIG * match = IdentityMapTable_FindByDeviceId(idModule->table, deviceName);
                     if (match == NULL)
                     {
-                        /*Codes_SRS_IDMAP_17_048: [ If the deviceName of the message is not found in deviceToMacArray, then the message shall not be marked as a C2D message. ]*/
+                        /*Codes_SRS_IDMAP_17_048: [ If the deviceName of the message is not found in the mapping table, then the message shall not be marked as a C2D message. ]*/
                         LogInfo("Did not find device Id [%s] of current message", deviceName);
                     }
                     else
@@ -765,8 +977,7 @@ static void IdentityMap_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messa
             }
             else
             {
-                const char * messageMac = IdentityMapConfig_ToUpperCase(
-                    ConstMap_GetValue(properties, GW_MAC_ADDRESS_PROPERTY));
+                const char * messageMac = ConstMap_GetValue(properties, GW_MAC_ADDRESS_PROPERTY);
 
                 /*Codes_SRS_IDMAP_17_021: [If messageHandle properties does not contain "macAddress" property, then the function shall return.]*/
                 if (messageMac != NULL)
@@ -775,22 +986,18 @@ static void IdentityMap_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messa
                     if ((ConstMap_GetValue(properties, GW_DEVICENAME_PROPERTY) == NULL ||
                         ConstMap_GetValue(properties, GW_DEVICEKEY_PROPERTY) == NULL))
                     {
-                        if (IdentityMapConfig_IsCanonicalMAC(messageMac) == false)
+                        uint64_t mac;
+                        if (IdentityMapConfig_ParseMAC(messageMac, &mac) == false)
                         {
                             /*Codes_SRS_IDMAP_17_040: [If the macAddress of the message is not in canonical form, then this function shall return.]*/
                             LogInfo("MAC address not valid: %s", messageMac);
                         }
                         else
                         {
-                            IDENTITY_MAP_CONFIG key = { messageMac,NULL,NULL };
-
-                            IDENTITY_MAP_CONFIG * match = bsearch(&key,
-                                idModule->macToDevIdArray, idModule->mappingSize,
-                                sizeof(IDENTITY_MAP_CONFIG),
-                                IdentityMapConfig_MacCompare);
+                            IDENTITY_MAP_CONFIG * match = IdentityMapTable_FindByMac(idModule->table, mac);
                             if (match == NULL)
                             {
-                                /*Codes_SRS_IDMAP_17_025: [If the macAddress of the message is not found in the macToDeviceArray list, then this function shall return.]*/
+                                /*Codes_SRS_IDMAP_17_025: [If the macAddress of the message is not found in the mapping table, then this function shall return.]*/
                                 LogInfo("Did not find message MAC Address: %s", messageMac);
                             }
                             else
@@ -799,8 +1006,6 @@ static void IdentityMap_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messa
                             }
                         }
                     }
-                    /*Codes_SRS_IDMAP_17_039: [IdentityMap_Receive will destroy all resources it created.]*/
-                    free((void*)messageMac);
                 }
             }
         }
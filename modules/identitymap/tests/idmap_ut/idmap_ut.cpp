@@ -67,6 +67,10 @@ static size_t whenShallConstMap_Clone_fail;
 static size_t currentConstMap_CloneWriteable_call;
 static size_t whenShallConstMap_CloneWriteable_fail;
 
+#define MAX_DERIVED_EDITS 8
+static MESSAGE_PROPERTY_EDIT derivedEdits[MAX_DERIVED_EDITS];
+static size_t derivedEditCount;
+
 static size_t currentCONSTBUFFER_Create_call;
 static size_t whenShallCONSTBUFFER_Create_fail;
 
@@ -110,9 +114,8 @@ public:
 typedef struct IDENTITY_MAP_DATA_TAG
 {
     BROKER_HANDLE broker;
-    size_t mappingSize;
-    IDENTITY_MAP_CONFIG * macToDevIdArray;
-    IDENTITY_MAP_CONFIG * devIdToMacArray;
+    struct IDENTITY_MAP_TABLE_TAG * table;
+    char * mappingUpdateSource;
 } IDENTITY_MAP_DATA;
 
 #define VALID_MAP_HANDLE    0xDEAF
@@ -126,10 +129,22 @@ static const char* macAddressProperties;
 static const char* sourceProperties;
 static const char* deviceNameProperties;
 static const char* deviceKeyProperties;
+static const char* mappingUpdateProperties;
 
 static VECTOR_HANDLE testVector1;
 static VECTOR_HANDLE testVector2;
 
+#define TEST_MAPPING_UPDATE_SOURCE "mappingWatcher"
+
+static IDENTITY_MAP_MODULE_CONFIG testModuleConfig;
+
+static const IDENTITY_MAP_MODULE_CONFIG * module_config(VECTOR_HANDLE mapping, const char * mappingUpdateSource)
+{
+    testModuleConfig.mapping = mapping;
+    testModuleConfig.mappingUpdateSource = mappingUpdateSource;
+    return &testModuleConfig;
+}
+
 TYPED_MOCK_CLASS(CIdentitymapMocks, CGlobalMock)
     {
     public:
@@ -235,6 +250,10 @@ TYPED_MOCK_CLASS(CIdentitymapMocks, CGlobalMock)
         {
             result5 = deviceKeyProperties;
         }
+        else if (strcmp(GW_MAPPING_UPDATE_PROPERTY, key) == 0)
+        {
+            result5 = mappingUpdateProperties;
+        }
     MOCK_METHOD_END(const char *, result5)
 
     // CONSTBUFFER mocks.
@@ -317,6 +336,24 @@ TYPED_MOCK_CLASS(CIdentitymapMocks, CGlobalMock)
         }
     MOCK_METHOD_END(MESSAGE_HANDLE, result1)
 
+    MOCK_STATIC_METHOD_3(, MESSAGE_HANDLE, Message_CreateDerived, MESSAGE_HANDLE, message, const MESSAGE_PROPERTY_EDIT*, edits, size_t, editCount)
+        MESSAGE_HANDLE result1;
+        derivedEditCount = (editCount < MAX_DERIVED_EDITS) ? editCount : MAX_DERIVED_EDITS;
+        for (size_t i = 0; i < derivedEditCount; i++)
+        {
+            derivedEdits[i] = edits[i];
+        }
+        currentMessage_call++;
+        if (currentMessage_call == whenShallMessage_fail)
+        {
+            result1 = NULL;
+        }
+        else
+        {
+            result1 = (MESSAGE_HANDLE)(new RefCountObject());
+        }
+    MOCK_METHOD_END(MESSAGE_HANDLE, result1)
+
     MOCK_STATIC_METHOD_1(, MESSAGE_HANDLE, Message_Clone, MESSAGE_HANDLE, message)
         ((RefCountObject*)message)->inc_ref();
     MOCK_METHOD_END(MESSAGE_HANDLE, message)
@@ -380,6 +417,22 @@ TYPED_MOCK_CLASS(CIdentitymapMocks, CGlobalMock)
         }
     MOCK_METHOD_END(JSON_Array*, object);
 
+    MOCK_STATIC_METHOD_1(, JSON_Object*, json_value_get_object, const JSON_Value*, value)
+        JSON_Object* object = NULL;
+        if (value != NULL)
+        {
+            object = (JSON_Object*)0x44;
+        }
+    MOCK_METHOD_END(JSON_Object*, object);
+
+    MOCK_STATIC_METHOD_2(, JSON_Array*, json_object_get_array, const JSON_Object*, object, const char*, name)
+        JSON_Array* array = NULL;
+        if (object != NULL)
+        {
+            array = (JSON_Array*)0x43;
+        }
+    MOCK_METHOD_END(JSON_Array*, array);
+
     MOCK_STATIC_METHOD_1(, size_t, json_array_get_count, const JSON_Array *, array)
     MOCK_METHOD_END(size_t, (size_t)0);
 
@@ -514,6 +567,7 @@ DECLARE_GLOBAL_MOCK_METHOD_2(CIdentitymapMocks, , MAP_RESULT, Map_Delete, MAP_HA
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , MESSAGE_HANDLE, Message_Create, const MESSAGE_CONFIG*, cfg);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , MESSAGE_HANDLE, Message_CreateFromBuffer, const MESSAGE_BUFFER_CONFIG*, cfg);
+DECLARE_GLOBAL_MOCK_METHOD_3(CIdentitymapMocks, , MESSAGE_HANDLE, Message_CreateDerived, MESSAGE_HANDLE, message, const MESSAGE_PROPERTY_EDIT*, edits, size_t, editCount);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , MESSAGE_HANDLE, Message_Clone, MESSAGE_HANDLE, message);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , CONSTMAP_HANDLE, Message_GetProperties, MESSAGE_HANDLE, message);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , const CONSTBUFFER*, Message_GetContent, MESSAGE_HANDLE, message);
@@ -524,6 +578,8 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , void, Message_Destroy, MESSAGE
 DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , JSON_Value*, json_parse_string, const char *, filename);
 DECLARE_GLOBAL_MOCK_METHOD_2(CIdentitymapMocks, , JSON_Object *, json_array_get_object, const JSON_Array *, array, size_t, index);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , JSON_Array*, json_value_get_array, const JSON_Value*, value);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , JSON_Object*, json_value_get_object, const JSON_Value*, value);
+DECLARE_GLOBAL_MOCK_METHOD_2(CIdentitymapMocks, , JSON_Array*, json_object_get_array, const JSON_Object*, object, const char*, name);
 DECLARE_GLOBAL_MOCK_METHOD_2(CIdentitymapMocks, , const char*, json_object_get_string, const JSON_Object*, object, const char*, name);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , size_t, json_array_get_count, const JSON_Array *, array);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , void, json_value_free, JSON_Value*, value);
@@ -588,10 +644,12 @@ BEGIN_TEST_SUITE(idmap_ut)
         sourceProperties = NULL;
         deviceNameProperties = NULL;
         deviceKeyProperties = NULL;
+        mappingUpdateProperties = NULL;
         currentMessage_call = 0;
         whenShallMessage_fail = 0;
         currentConstMap_CloneWriteable_call = 0;
         whenShallConstMap_CloneWriteable_fail = 0;
+        derivedEditCount = 0;
         currentMap_call = 0;
         whenShallMap_fail = 0;
         currentBrokerResult = BROKER_OK;
@@ -702,6 +760,7 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
             .IgnoreArgument(1)
             .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(sizeof(IDENTITY_MAP_MODULE_CONFIG)));
 
         STRICT_EXPECTED_CALL(mocks, json_value_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
@@ -719,6 +778,65 @@ BEGIN_TEST_SUITE(idmap_ut)
 	}
 
 
+    //Tests_SRS_IDMAP_17_071: [ If configuration is a JSON object, IdentityMap_ParseConfigurationFromJson shall parse its "mapping" value as the JSON array of objects and shall use its "mappingUpdateSource" value, if any, as the mappingUpdateSource. ]
+    TEST_FUNCTION(IdentityMap_ParseConfigurationFromJson_object_with_update_source_success)
+    {
+        ///Arrange
+        CIdentitymapMocks mocks;
+        const MODULE_API* theAPIS= Module_GetApi(MODULE_API_VERSION_1);
+        const char* config = "pretend this is a valid JSON string";
+
+        STRICT_EXPECTED_CALL(mocks, json_parse_string(config));
+        STRICT_EXPECTED_CALL(mocks, json_value_get_array(IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .SetFailReturn((JSON_Array*)NULL);
+        STRICT_EXPECTED_CALL(mocks, json_value_get_object(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_array(IGNORED_PTR_ARG, "mapping"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "mappingUpdateSource"))
+            .IgnoreArgument(1)
+            .SetReturn((const char*)TEST_MAPPING_UPDATE_SOURCE);
+        STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(IDENTITY_MAP_CONFIG)));
+        STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .SetReturn(1UL);
+        STRICT_EXPECTED_CALL(mocks, json_array_get_object(IGNORED_PTR_ARG, 0))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "macAddress"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "deviceId"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "deviceKey"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, "00:00:00:00:00:00"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, "id"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, "key"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+            .IgnoreArgument(1)
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(sizeof(IDENTITY_MAP_MODULE_CONFIG)));
+        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_MAPPING_UPDATE_SOURCE))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_value_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        //Act
+        auto n = (IDENTITY_MAP_MODULE_CONFIG*)MODULE_PARSE_CONFIGURATION_FROM_JSON(theAPIS)(config);
+
+        ///Assert
+        ASSERT_IS_NOT_NULL(n);
+        ASSERT_IS_NOT_NULL(n->mapping);
+        ASSERT_ARE_EQUAL(char_ptr, TEST_MAPPING_UPDATE_SOURCE, n->mappingUpdateSource);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///Cleanup
+        MODULE_FREE_CONFIGURATION(theAPIS)(n);
+    }
+
 	//Tests_SRS_IDMAP_05_020: [ If pushing into the vector is not successful, then IdentityMap_ParseConfigurationFromJson shall fail and return NULL. ]
 	TEST_FUNCTION(IdentityMap_ParseConfigurationFromJson_push_back_failed_returns_null)
 	{
@@ -1030,6 +1148,9 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, json_value_get_array(IGNORED_PTR_ARG))
             .IgnoreArgument(1)
             .SetFailReturn((JSON_Array*)NULL);
+        STRICT_EXPECTED_CALL(mocks, json_value_get_object(IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .SetFailReturn((JSON_Object*)NULL);
 
         //Act
         auto n = MODULE_PARSE_CONFIGURATION_FROM_JSON(theAPIS)(config);
@@ -1104,9 +1225,9 @@ BEGIN_TEST_SUITE(idmap_ut)
 
         STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*the triplet, the update source and the module configuration*/
             .IgnoreArgument(1)
-            .ExpectedTimesExactly(3);
+            .ExpectedTimesExactly(5);
         STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
@@ -1193,10 +1314,7 @@ BEGIN_TEST_SUITE(idmap_ut)
 
         STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the d2c internal array*/
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the c2d internal array*/
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the mapping table*/
             .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
@@ -1208,22 +1326,65 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device key*/
             .IgnoreAllArguments();
 
+        ///Act
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(testVector1, NULL));
+
+        ///Assert
+        ASSERT_IS_NOT_NULL(n);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///Ablution
+        MODULE_DESTROY(theAPIS)(n);
+    }
+
+    /*Tests_SRS_IDMAP_17_072: [ If the configuration has a mappingUpdateSource, IdentityMap_Create shall copy it; if the copy fails, IdentityMap_Create shall fail, release all resources, and return NULL. ]*/
+    TEST_FUNCTION(IdentityMap_Create_update_source_copy_fails)
+    {
+        ///Arrange
+        CIdentitymapMocks mocks;
+        const MODULE_API* theAPIS= Module_GetApi(MODULE_API_VERSION_1);
+        unsigned char fake;
+        BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
+
+        whenShallStrdup_fail = 4;
+
+        STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
+
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module struct*/
+            .IgnoreArgument(1);
+
+        STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the mapping table*/
+            .IgnoreArgument(1);
+
+        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
+
         STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the mac address*/
             .IgnoreAllArguments();
         STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device name*/
             .IgnoreAllArguments();
         STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device key*/
             .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_MAPPING_UPDATE_SOURCE)) /*this is for the mapping update source*/
+            .IgnoreArgument(1);
+
+        //mapping triplet, mapping table and module struct
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
         ///Act
-        auto n = MODULE_CREATE(theAPIS)(broker, testVector1);
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(testVector1, TEST_MAPPING_UPDATE_SOURCE));
 
         ///Assert
-        ASSERT_IS_NOT_NULL(n);
+        ASSERT_IS_NULL(n);
         mocks.AssertActualAndExpectedCalls();
 
         ///Ablution
-        MODULE_DESTROY(theAPIS)(n);
     }
 
     /*Tests_SRS_IDMAP_17_041: [If the configuration has no vector elements, this function shall fail and return NULL.]*/
@@ -1242,7 +1403,7 @@ BEGIN_TEST_SUITE(idmap_ut)
 
 
         ///Act
-        auto n = MODULE_CREATE(theAPIS)(broker, v);
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(v, NULL));
 
         ///Assert
         ASSERT_IS_NULL(n);
@@ -1294,11 +1455,11 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
 
         ///Act
-        auto n1 = MODULE_CREATE(theAPIS)(broker, v1);
+        auto n1 = MODULE_CREATE(theAPIS)(broker, module_config(v1, NULL));
         ASSERT_IS_NULL(n1);
-        auto n2 = MODULE_CREATE(theAPIS)(broker, v2);
+        auto n2 = MODULE_CREATE(theAPIS)(broker, module_config(v2, NULL));
         ASSERT_IS_NULL(n2);
-        auto n3 = MODULE_CREATE(theAPIS)(broker, v3);
+        auto n3 = MODULE_CREATE(theAPIS)(broker, module_config(v3, NULL));
         ASSERT_IS_NULL(n3);
 
         ///Assert
@@ -1335,7 +1496,7 @@ BEGIN_TEST_SUITE(idmap_ut)
 
 
         ///Act
-        auto n1 = MODULE_CREATE(theAPIS)(broker, v1);
+        auto n1 = MODULE_CREATE(theAPIS)(broker, module_config(v1, NULL));
         ASSERT_IS_NULL(n1);
 
 
@@ -1373,7 +1534,7 @@ BEGIN_TEST_SUITE(idmap_ut)
 
 
         ///Act
-        auto n2 = MODULE_CREATE(theAPIS)(broker, v2);
+        auto n2 = MODULE_CREATE(theAPIS)(broker, module_config(v2, NULL));
         ASSERT_IS_NULL(n2);
 
 
@@ -1411,7 +1572,7 @@ BEGIN_TEST_SUITE(idmap_ut)
 
         ///Act
 
-        auto n3 = MODULE_CREATE(theAPIS)(broker, v3);
+        auto n3 = MODULE_CREATE(theAPIS)(broker, module_config(v3, NULL));
         ASSERT_IS_NULL(n3);
 
         ///Assert
@@ -1440,7 +1601,7 @@ BEGIN_TEST_SUITE(idmap_ut)
 
 
         ///Act
-        auto n = MODULE_CREATE(theAPIS)(broker, testVector1);
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(testVector1, NULL));
 
         ///Assert
         ASSERT_IS_NULL(n);
@@ -1449,8 +1610,8 @@ BEGIN_TEST_SUITE(idmap_ut)
         ///Ablution
     }
 
-    /*Tests_SRS_IDMAP_17_011: [If IdentityMap_Create fails to create memory for the macToDeviceArray, then this function shall fail and return NULL.]*/
-    TEST_FUNCTION(IdentityMap_Create_internal_d2c_alloc_fail)
+    /*Tests_SRS_IDMAP_17_011: [If IdentityMap_Create fails to create memory for the mapping table, then this function shall fail and return NULL.]*/
+    TEST_FUNCTION(IdentityMap_Create_table_alloc_fail)
     {
         ///Arrange
         CIdentitymapMocks mocks;
@@ -1470,12 +1631,12 @@ BEGIN_TEST_SUITE(idmap_ut)
 
         STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the internal array*/
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the mapping table*/
             .IgnoreArgument(1);
 
 
         ///Act
-        auto n = MODULE_CREATE(theAPIS)(broker, testVector1);
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(testVector1, NULL));
 
         ///Assert
         ASSERT_IS_NULL(n);
@@ -1484,8 +1645,8 @@ BEGIN_TEST_SUITE(idmap_ut)
         ///Ablution
     }
 
-    /*Tests_SRS_IDMAP_17_042: [ If IdentityMap_Create fails to create memory for the deviceToMacArray, then this function shall fail and return NULL. */
-    TEST_FUNCTION(IdentityMap_Create_internal_c2d_alloc_fail)
+    /*Tests_SRS_IDMAP_17_012: [If IdentityMap_Create fails to add a MAC address triplet to the mapping table, then this function shall fail, release all resources, and return NULL.]*/
+    TEST_FUNCTION(IdentityMap_Create_DeepCopy_fail_mac1)
     {
         ///Arrange
         CIdentitymapMocks mocks;
@@ -1493,26 +1654,30 @@ BEGIN_TEST_SUITE(idmap_ut)
         unsigned char fake;
         BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
 
+        whenShallStrdup_fail = 1;
+
         STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1)).IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module struct*/
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
-
         STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the internal array*/
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the mapping table*/
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the internal array*/
-            .IgnoreArgument(1)
-            .SetFailReturn((void_ptr)NULL);
 
+        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
+
+        /* 1st vector element */
+        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the mac address*/
+            .IgnoreAllArguments();
 
         ///Act
-        auto n = MODULE_CREATE(theAPIS)(broker, testVector1);
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(testVector2, NULL));
 
         ///Assert
         ASSERT_IS_NULL(n);
@@ -1520,8 +1685,9 @@ BEGIN_TEST_SUITE(idmap_ut)
 
         ///Ablution
     }
-    /*Tests_SRS_IDMAP_17_012: [If IdentityMap_Create fails to add a MAC address triplet to the macToDeviceArray, then this function shall fail, release all resources, and return NULL.]*/
-    TEST_FUNCTION(IdentityMap_Create_DeepCopy_fail_mac1)
+
+    /*Tests_SRS_IDMAP_17_012: [If IdentityMap_Create fails to add a MAC address triplet to the mapping table, then this function shall fail, release all resources, and return NULL.]*/
+    TEST_FUNCTION(IdentityMap_Create_DeepCopy_fail_id1)
     {
         ///Arrange
         CIdentitymapMocks mocks;
@@ -1529,7 +1695,7 @@ BEGIN_TEST_SUITE(idmap_ut)
         unsigned char fake;
         BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
 
-        whenShallStrdup_fail =7;
+        whenShallStrdup_fail = 2;
 
         STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
@@ -1541,44 +1707,21 @@ BEGIN_TEST_SUITE(idmap_ut)
 
         STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the D2C internal array*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the C2D internal array*/
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the mapping table*/
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1)).IgnoreArgument(1);
 
         /* 1st vector element */
         STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the mac address*/
             .IgnoreAllArguments();
         STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device name*/
             .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device key*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the mac address*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device name*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device key*/
-            .IgnoreAllArguments();
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        /* 2nd vector element */
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the mac address*/
-            .IgnoreAllArguments();
 
         ///Act
-        auto n = MODULE_CREATE(theAPIS)(broker, testVector2);
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(testVector2, NULL));
 
         ///Assert
         ASSERT_IS_NULL(n);
@@ -1587,8 +1730,8 @@ BEGIN_TEST_SUITE(idmap_ut)
         ///Ablution
     }
 
-    //Tests_SRS_IDMAP_17_043: [ If IdentityMap_Create fails to add a MAC address triplet to the deviceToMacArray, then this function shall fail, release all resources, and return NULL. 
-    TEST_FUNCTION(IdentityMap_Create_DeepCopy_fail_mac2)
+    /*Tests_SRS_IDMAP_17_012: [If IdentityMap_Create fails to add a MAC address triplet to the mapping table, then this function shall fail, release all resources, and return NULL.]*/
+    TEST_FUNCTION(IdentityMap_Create_DeepCopy_fail_key1)
     {
         ///Arrange
         CIdentitymapMocks mocks;
@@ -1596,7 +1739,7 @@ BEGIN_TEST_SUITE(idmap_ut)
         unsigned char fake;
         BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
 
-        whenShallStrdup_fail = 10;
+        whenShallStrdup_fail = 3;
 
         STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
@@ -1608,16 +1751,11 @@ BEGIN_TEST_SUITE(idmap_ut)
 
         STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the D2C internal array*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the C2D internal array*/
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the mapping table*/
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1)).IgnoreArgument(1);
 
         /* 1st vector element */
         STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the mac address*/
@@ -1628,34 +1766,9 @@ BEGIN_TEST_SUITE(idmap_ut)
             .IgnoreAllArguments();
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the mac address*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device name*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device key*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        /* 2nd vector element */
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the mac address*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device name*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device key*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the mac address*/
-            .IgnoreAllArguments();
 
         ///Act
-        auto n = MODULE_CREATE(theAPIS)(broker, testVector2);
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(testVector2, NULL));
 
         ///Assert
         ASSERT_IS_NULL(n);
@@ -1664,8 +1777,8 @@ BEGIN_TEST_SUITE(idmap_ut)
         ///Ablution
     }
 
-    /*Tests_SRS_IDMAP_17_012: [If IdentityMap_Create fails to add a MAC address triplet to the macToDeviceArray, then this function shall fail, release all resources, and return NULL.]*/
-    TEST_FUNCTION(IdentityMap_Create_DeepCopy_fail_id1)
+    /*Tests_SRS_IDMAP_17_012: [If IdentityMap_Create fails to add a MAC address triplet to the mapping table, then this function shall fail, release all resources, and return NULL.]*/
+    TEST_FUNCTION(IdentityMap_Create_DeepCopy_fail_mac2)
     {
         ///Arrange
         CIdentitymapMocks mocks;
@@ -1673,8 +1786,7 @@ BEGIN_TEST_SUITE(idmap_ut)
         unsigned char fake;
         BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
 
-
-        whenShallStrdup_fail = 8;
+        whenShallStrdup_fail = 4;
 
         STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
@@ -1686,27 +1798,14 @@ BEGIN_TEST_SUITE(idmap_ut)
 
         STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the d2c internal array*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the c2d internal array*/
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the mapping table*/
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1)).IgnoreArgument(1);
 
-        //1st vector element
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the mac address*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device name*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device key*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        /* 1st vector element */
         STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the mac address*/
             .IgnoreAllArguments();
         STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device name*/
@@ -1718,14 +1817,11 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
         /* 2nd vector element */
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the mac address*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the mac address*/
             .IgnoreAllArguments();
 
         ///Act
-        auto n = MODULE_CREATE(theAPIS)(broker, testVector2);
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(testVector2, NULL));
 
         ///Assert
         ASSERT_IS_NULL(n);
@@ -1734,6 +1830,7 @@ BEGIN_TEST_SUITE(idmap_ut)
         ///Ablution
     }
 
+    /*Tests_SRS_IDMAP_17_012: [If IdentityMap_Create fails to add a MAC address triplet to the mapping table, then this function shall fail, release all resources, and return NULL.]*/
     TEST_FUNCTION(IdentityMap_Create_DeepCopy_fail_id2)
     {
         ///Arrange
@@ -1742,8 +1839,7 @@ BEGIN_TEST_SUITE(idmap_ut)
         unsigned char fake;
         BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
 
-
-        whenShallStrdup_fail = 11;
+        whenShallStrdup_fail = 5;
 
         STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
@@ -1755,27 +1851,14 @@ BEGIN_TEST_SUITE(idmap_ut)
 
         STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the d2c internal array*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the c2d internal array*/
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the mapping table*/
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1)).IgnoreArgument(1);
 
-        //1st vector element
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the mac address*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device name*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device key*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        /* 1st vector element */
         STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the mac address*/
             .IgnoreAllArguments();
         STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device name*/
@@ -1791,20 +1874,10 @@ BEGIN_TEST_SUITE(idmap_ut)
             .IgnoreAllArguments();
         STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device name*/
             .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device key*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the mac address*/
-            .IgnoreAllArguments();
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the mac address*/
-            .IgnoreAllArguments();
 
         ///Act
-        auto n = MODULE_CREATE(theAPIS)(broker, testVector2);
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(testVector2, NULL));
 
         ///Assert
         ASSERT_IS_NULL(n);
@@ -1813,9 +1886,8 @@ BEGIN_TEST_SUITE(idmap_ut)
         ///Ablution
     }
 
-
-    /*Tests_SRS_IDMAP_17_012: [If IdentityMap_Create fails to add a MAC address triplet to the macToDeviceArray, then this function shall fail, release all resources, and return NULL.]*/
-    TEST_FUNCTION(IdentityMap_Create_DeepCopy_fail_key1)
+    /*Tests_SRS_IDMAP_17_012: [If IdentityMap_Create fails to add a MAC address triplet to the mapping table, then this function shall fail, release all resources, and return NULL.]*/
+    TEST_FUNCTION(IdentityMap_Create_DeepCopy_fail_key2)
     {
         ///Arrange
         CIdentitymapMocks mocks;
@@ -1823,7 +1895,7 @@ BEGIN_TEST_SUITE(idmap_ut)
         unsigned char fake;
         BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
 
-        whenShallStrdup_fail = 9;
+        whenShallStrdup_fail = 6;
 
         STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
@@ -1835,18 +1907,14 @@ BEGIN_TEST_SUITE(idmap_ut)
 
         STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the D2C internal array*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the C2D internal array*/
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the mapping table*/
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1)).IgnoreArgument(1);
 
-        //1st vector element
+        /* 1st vector element */
         STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the mac address*/
             .IgnoreAllArguments();
         STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device name*/
@@ -1857,6 +1925,7 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
+        /* 2nd vector element */
         STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the mac address*/
             .IgnoreAllArguments();
         STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device name*/
@@ -1865,108 +1934,9 @@ BEGIN_TEST_SUITE(idmap_ut)
             .IgnoreAllArguments();
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        // 2nd vector element
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the mac address*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device name*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device key*/
-            .IgnoreAllArguments();
-
-
 
         ///Act
-        auto n = MODULE_CREATE(theAPIS)(broker, testVector2);
-
-        ///Assert
-        ASSERT_IS_NULL(n);
-        mocks.AssertActualAndExpectedCalls();
-
-        ///Ablution
-    }
-
-    TEST_FUNCTION(IdentityMap_Create_DeepCopy_fail_key2)
-    {
-        ///Arrange
-        CIdentitymapMocks mocks;
-        const MODULE_API* theAPIS= Module_GetApi(MODULE_API_VERSION_1);
-        unsigned char fake;
-        BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
-
-        whenShallStrdup_fail = 12;
-
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module struct*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the D2C internal array*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the C2D internal array*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1)).IgnoreArgument(1);
-
-        //1st vector element
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the mac address*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device name*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device key*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the mac address*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device name*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device key*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        // 2nd vector element
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the mac address*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device name*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device key*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the mac address*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device name*/
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device key*/
-            .IgnoreAllArguments();
-
-
-
-        ///Act
-        auto n = MODULE_CREATE(theAPIS)(broker, testVector2);
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(testVector2, NULL));
 
         ///Assert
         ASSERT_IS_NULL(n);
@@ -1999,7 +1969,7 @@ BEGIN_TEST_SUITE(idmap_ut)
         const MODULE_API* theAPIS= Module_GetApi(MODULE_API_VERSION_1);
         BROKER_HANDLE broker = Broker_Create();
 
-        auto n = MODULE_CREATE(theAPIS)(broker, testVector2);
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(testVector2, NULL));
 
         mocks.ResetAllCalls();
 
@@ -2007,19 +1977,13 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
         //2nd vector element
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
-        //internal struct and module data
+        //mapping table, mapping update source and module data
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
@@ -2062,7 +2026,7 @@ BEGIN_TEST_SUITE(idmap_ut)
 
         unsigned char fake;
         BROKER_HANDLE broker = Broker_Create();
-        auto n = MODULE_CREATE(theAPIS)(broker, testVector2);
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(testVector2, NULL));
 
         MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
         auto m = Message_Create(&cfg);
@@ -2072,6 +2036,8 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
         STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAPPING_UPDATE_PROPERTY))
+            .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
             .IgnoreArgument(1);
 
@@ -2097,7 +2063,7 @@ BEGIN_TEST_SUITE(idmap_ut)
 
         unsigned char fake;
         BROKER_HANDLE broker = Broker_Create();
-        auto n = MODULE_CREATE(theAPIS)(broker, testVector2);
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(testVector2, NULL));
 
         MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
         auto m = Message_Create(&cfg);
@@ -2109,12 +2075,12 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
         STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAPPING_UPDATE_PROPERTY))
+            .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
 
 
         ///Act
@@ -2139,7 +2105,7 @@ BEGIN_TEST_SUITE(idmap_ut)
 
         unsigned char fake;
         BROKER_HANDLE broker = Broker_Create();
-        auto n = MODULE_CREATE(theAPIS)(broker, testVector2);
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(testVector2, NULL));
 
         MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
         auto m = Message_Create(&cfg);
@@ -2154,13 +2120,12 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
         STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAPPING_UPDATE_PROPERTY))
+            .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY))
@@ -2189,7 +2154,7 @@ BEGIN_TEST_SUITE(idmap_ut)
 
         unsigned char fake;
         BROKER_HANDLE broker = Broker_Create();
-        auto n = MODULE_CREATE(theAPIS)(broker, testVector2);
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(testVector2, NULL));
 
         MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
         auto m = Message_Create(&cfg);
@@ -2204,13 +2169,12 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
         STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAPPING_UPDATE_PROPERTY))
+            .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY))
@@ -2240,7 +2204,7 @@ BEGIN_TEST_SUITE(idmap_ut)
 
         unsigned char fake;
         BROKER_HANDLE broker = Broker_Create();
-        auto n = MODULE_CREATE(theAPIS)(broker, testVector2);
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(testVector2, NULL));
 
         MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
         auto m = Message_Create(&cfg);
@@ -2254,13 +2218,12 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
         STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAPPING_UPDATE_PROPERTY))
+            .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY))
@@ -2281,7 +2244,7 @@ BEGIN_TEST_SUITE(idmap_ut)
 
     }
 
-    /*Tests_SRS_IDMAP_17_025: [If the macAddress of the message is not found in the macToDeviceArray list, then this function shall return.] */
+    /*Tests_SRS_IDMAP_17_025: [If the macAddress of the message is not found in the mapping table, then this function shall return.] */
     TEST_FUNCTION(IdentityMap_Receive_D2C_mac_not_found)
     {
         ///Arrange
@@ -2290,7 +2253,7 @@ BEGIN_TEST_SUITE(idmap_ut)
 
         unsigned char fake;
         BROKER_HANDLE broker = Broker_Create();
-        auto n = MODULE_CREATE(theAPIS)(broker, testVector1);
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(testVector1, NULL));
 
         MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
         auto m = Message_Create(&cfg);
@@ -2304,13 +2267,12 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
         STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAPPING_UPDATE_PROPERTY))
+            .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY))
@@ -2330,16 +2292,17 @@ BEGIN_TEST_SUITE(idmap_ut)
 
     }
 
-    /*Tests_SRS_IDMAP_17_021: [If messageHandle properties does not contain "macAddress" property, then the function shall return.]*/
-    TEST_FUNCTION(IdentityMap_Receive_D2C_get_properties_2_fail)
+    /*Tests_SRS_IDMAP_17_068: [ If Message_CreateDerived fails, IdentityMap_Receive shall deallocate all resources and return. ]*/
+    TEST_FUNCTION(IdentityMap_Receive_D2C_Message_CreateDerived_fail)
     {
         ///Arrange
         CIdentitymapMocks mocks;
         const MODULE_API* theAPIS= Module_GetApi(MODULE_API_VERSION_1);
+        
 
         unsigned char fake;
         BROKER_HANDLE broker = Broker_Create();
-        auto n = MODULE_CREATE(theAPIS)(broker, testVector2);
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(testVector2, NULL));
 
         MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
         auto m = Message_Create(&cfg);
@@ -2349,22 +2312,21 @@ BEGIN_TEST_SUITE(idmap_ut)
 
         mocks.ResetAllCalls();
 
+
         STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
         STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAPPING_UPDATE_PROPERTY))
+            .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
             .IgnoreArgument(1);
-
         whenShallMessage_fail = 2;
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-
+        STRICT_EXPECTED_CALL(mocks, Message_CreateDerived(m, IGNORED_PTR_ARG, 4))
+            .IgnoreArgument(2);
 
         ///Act
         MODULE_RECEIVE(theAPIS)(n, m);
@@ -2379,16 +2341,17 @@ BEGIN_TEST_SUITE(idmap_ut)
 
     }
 
-    /*Tests_SRS_IDMAP_17_027: [If ConstMap_CloneWriteable fails, IdentityMap_Receive shall deallocate any resources and return.]*/
-    TEST_FUNCTION(IdentityMap_Receive_D2C_CloneWriteable_fails)
+    /*Tests_SRS_IDMAP_17_038: [IdentityMap_Receive shall call Broker_Publish with broker and new message.]*/
+    TEST_FUNCTION(IdentityMap_Receive_D2C_Broker_Publish_fail)
     {
         ///Arrange
         CIdentitymapMocks mocks;
         const MODULE_API* theAPIS= Module_GetApi(MODULE_API_VERSION_1);
+        
 
         unsigned char fake;
         BROKER_HANDLE broker = Broker_Create();
-        auto n = MODULE_CREATE(theAPIS)(broker, testVector2);
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(testVector2, NULL));
 
         MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
         auto m = Message_Create(&cfg);
@@ -2399,24 +2362,24 @@ BEGIN_TEST_SUITE(idmap_ut)
         mocks.ResetAllCalls();
 
 
+
         STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
         STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAPPING_UPDATE_PROPERTY))
+            .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        whenShallConstMap_CloneWriteable_fail = 1;
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
+        STRICT_EXPECTED_CALL(mocks, Message_CreateDerived(m, IGNORED_PTR_ARG, 4))
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        currentBrokerResult = BROKER_ERROR;
+        STRICT_EXPECTED_CALL(mocks, Broker_Publish(broker, n, IGNORED_PTR_ARG))
+            .IgnoreArgument(3);
 
         ///Act
         MODULE_RECEIVE(theAPIS)(n, m);
@@ -2431,21 +2394,45 @@ BEGIN_TEST_SUITE(idmap_ut)
 
     }
 
-    /*Tests_SRS_IDMAP_17_029: [If adding deviceName fails,IdentityMap_Receive shall deallocate all resources and return.]*/
-    TEST_FUNCTION(IdentityMap_Receive_D2C_MapAdd1_fail)
+    /*Tests_SRS_IDMAP_17_067: [ IdentityMap_Receive shall create the message to send by calling Message_CreateDerived with messageHandle and the property edits, so the content and the unchanged properties are not copied. ]*/
+    /*Tests_SRS_IDMAP_17_069: [ On a D2C message, IdentityMap_Receive shall set "deviceName" to the found deviceId, "deviceKey" to the found deviceKey and "source" to "mapping", and shall remove "macAddress". ]*/
+    /*Tests_SRS_IDMAP_17_038: [IdentityMap_Receive shall call Broker_Publish with broker and new message.]*/
+    /*Tests_SRS_IDMAP_17_039: [IdentityMap_Receive will destroy all resources it created.]*/
+    TEST_FUNCTION(IdentityMap_Receive_D2C_Success)
     {
         ///Arrange
         CIdentitymapMocks mocks;
         const MODULE_API* theAPIS= Module_GetApi(MODULE_API_VERSION_1);
+        
 
         unsigned char fake;
-        BROKER_HANDLE broker = Broker_Create();
-        auto n = MODULE_CREATE(theAPIS)(broker, testVector2);
+        BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
+        VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
+
+        IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
+        IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
+        IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
+        IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
+        IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
+        IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
+        IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
+        IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08", "Sensor8", "theKeyFor8" };
+        IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9", "theKeyFor9" };
+        VECTOR_push_back(v, &c1, 1);
+        VECTOR_push_back(v, &c2, 1);
+        VECTOR_push_back(v, &c3, 1);
+        VECTOR_push_back(v, &c4, 1);
+        VECTOR_push_back(v, &c5, 1);
+        VECTOR_push_back(v, &c6, 1);
+        VECTOR_push_back(v, &c7, 1);
+        VECTOR_push_back(v, &c8, 1);
+        VECTOR_push_back(v, &c9, 1);
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(v, NULL));
 
         MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
         auto m = Message_Create(&cfg);
 
-        macAddressProperties = "aa:aa:bb:bb:cc:cc";
+        macAddressProperties = "07:07:07:07:07:07";
         sourceProperties = GW_SOURCE_BLE_TELEMETRY;
 
         mocks.ResetAllCalls();
@@ -2454,41 +2441,46 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
         STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAPPING_UPDATE_PROPERTY))
+            .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        whenShallMap_fail = 1;
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY, "aNiceDevice")).IgnoreArgument(1);
-
+        STRICT_EXPECTED_CALL(mocks, Message_CreateDerived(m, IGNORED_PTR_ARG, 4))
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Broker_Publish((BROKER_HANDLE)&fake, n, IGNORED_PTR_ARG))
+            .IgnoreArgument(3);
 
         ///Act
         MODULE_RECEIVE(theAPIS)(n, m);
 
         ///Assert
         mocks.AssertActualAndExpectedCalls();
+        ASSERT_ARE_EQUAL(size_t, 4, derivedEditCount);
+        ASSERT_ARE_EQUAL(char_ptr, GW_DEVICENAME_PROPERTY, derivedEdits[0].name);
+        ASSERT_ARE_EQUAL(char_ptr, "Sensor7", derivedEdits[0].value);
+        ASSERT_ARE_EQUAL(char_ptr, GW_DEVICEKEY_PROPERTY, derivedEdits[1].name);
+        ASSERT_ARE_EQUAL(char_ptr, "theKeyFor7", derivedEdits[1].value);
+        ASSERT_ARE_EQUAL(char_ptr, GW_SOURCE_PROPERTY, derivedEdits[2].name);
+        ASSERT_ARE_EQUAL(char_ptr, GW_IDMAP_MODULE, derivedEdits[2].value);
+        ASSERT_ARE_EQUAL(char_ptr, GW_MAC_ADDRESS_PROPERTY, derivedEdits[3].name);
+        ASSERT_IS_NULL(derivedEdits[3].value);
 
         ///Ablution
         Message_Destroy(m);
+        VECTOR_destroy(v);
         MODULE_DESTROY(theAPIS)(n);
-        Broker_Destroy(broker);
 
     }
 
-    /*Tests_SRS_IDMAP_17_031: [If adding deviceKey fails, IdentityMap_Receive shall deallocate all resources and return.]*/
-    TEST_FUNCTION(IdentityMap_Receive_D2C_MapAdd2_fail)
+    //Tests_SRS_IDMAP_17_067: [ IdentityMap_Receive shall create the message to send by calling Message_CreateDerived with messageHandle and the property edits, so the content and the unchanged properties are not copied. ]
+    //Tests_SRS_IDMAP_17_070: [ On a C2D message, IdentityMap_Receive shall set "macAddress" to the found macAddress and "source" to "mapping", and shall remove "deviceName" and "deviceKey", if present. ]
+    //Tests_SRS_IDMAP_17_038: [IdentityMap_Receive shall call Broker_Publish with broker and new message.]
+    TEST_FUNCTION(IdentityMap_Receive_C2D_Success)
     {
         ///Arrange
         CIdentitymapMocks mocks;
@@ -2496,14 +2488,34 @@ BEGIN_TEST_SUITE(idmap_ut)
         
 
         unsigned char fake;
-        BROKER_HANDLE broker = Broker_Create();
-        auto n = MODULE_CREATE(theAPIS)(broker, testVector2);
+        BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
+        VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
+
+        IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
+        IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
+        IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
+        IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
+        IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
+        IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
+        IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
+        IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08", "Sensor8", "theKeyFor8" };
+        IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9", "theKeyFor9" };
+        VECTOR_push_back(v, &c1, 1);
+        VECTOR_push_back(v, &c2, 1);
+        VECTOR_push_back(v, &c3, 1);
+        VECTOR_push_back(v, &c4, 1);
+        VECTOR_push_back(v, &c5, 1);
+        VECTOR_push_back(v, &c6, 1);
+        VECTOR_push_back(v, &c7, 1);
+        VECTOR_push_back(v, &c8, 1);
+        VECTOR_push_back(v, &c9, 1);
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(v, NULL));
 
         MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
         auto m = Message_Create(&cfg);
 
-        macAddressProperties = "aa:aa:bb:bb:cc:cc";
-        sourceProperties = GW_SOURCE_BLE_TELEMETRY;
+        deviceNameProperties = "Sensor7";
+        sourceProperties = GW_IOTHUB_MODULE;
 
         mocks.ResetAllCalls();
 
@@ -2511,41 +2523,42 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
         STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAPPING_UPDATE_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        whenShallMap_fail = 2;
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY, "aNiceDevice")).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY, "aNiceKey")).IgnoreArgument(1);
-
+        STRICT_EXPECTED_CALL(mocks, Message_CreateDerived(m, IGNORED_PTR_ARG, 4))
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Broker_Publish((BROKER_HANDLE)&fake, n, IGNORED_PTR_ARG))
+            .IgnoreArgument(3);
 
         ///Act
         MODULE_RECEIVE(theAPIS)(n, m);
 
         ///Assert
         mocks.AssertActualAndExpectedCalls();
+        ASSERT_ARE_EQUAL(size_t, 4, derivedEditCount);
+        ASSERT_ARE_EQUAL(char_ptr, GW_MAC_ADDRESS_PROPERTY, derivedEdits[0].name);
+        ASSERT_ARE_EQUAL(char_ptr, "07:07:07:07:07:07", derivedEdits[0].value);
+        ASSERT_ARE_EQUAL(char_ptr, GW_SOURCE_PROPERTY, derivedEdits[1].name);
+        ASSERT_ARE_EQUAL(char_ptr, GW_IDMAP_MODULE, derivedEdits[1].value);
+        ASSERT_ARE_EQUAL(char_ptr, GW_DEVICENAME_PROPERTY, derivedEdits[2].name);
+        ASSERT_IS_NULL(derivedEdits[2].value);
+        ASSERT_ARE_EQUAL(char_ptr, GW_DEVICEKEY_PROPERTY, derivedEdits[3].name);
+        ASSERT_IS_NULL(derivedEdits[3].value);
 
         ///Ablution
         Message_Destroy(m);
+        VECTOR_destroy(v);
         MODULE_DESTROY(theAPIS)(n);
-        Broker_Destroy(broker);
 
     }
 
-    /*Tests_SRS_IDMAP_17_033: [If adding source fails, IdentityMap_Receive shall deallocate all resources and return.]*/
-    TEST_FUNCTION(IdentityMap_Receive_D2C_MapAdd3_fail)
+    //Tests_SRS_IDMAP_17_068: [ If Message_CreateDerived fails, IdentityMap_Receive shall deallocate all resources and return. ]
+    TEST_FUNCTION(IdentityMap_Receive_C2D_Message_CreateDerived_fail)
     {
         ///Arrange
         CIdentitymapMocks mocks;
@@ -2553,14 +2566,34 @@ BEGIN_TEST_SUITE(idmap_ut)
         
 
         unsigned char fake;
-        BROKER_HANDLE broker = Broker_Create();
-        auto n = MODULE_CREATE(theAPIS)(broker, testVector2);
+        BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
+        VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
+
+        IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
+        IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
+        IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
+        IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
+        IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
+        IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
+        IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
+        IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08", "Sensor8", "theKeyFor8" };
+        IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9", "theKeyFor9" };
+        VECTOR_push_back(v, &c1, 1);
+        VECTOR_push_back(v, &c2, 1);
+        VECTOR_push_back(v, &c3, 1);
+        VECTOR_push_back(v, &c4, 1);
+        VECTOR_push_back(v, &c5, 1);
+        VECTOR_push_back(v, &c6, 1);
+        VECTOR_push_back(v, &c7, 1);
+        VECTOR_push_back(v, &c8, 1);
+        VECTOR_push_back(v, &c9, 1);
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(v, NULL));
 
         MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
         auto m = Message_Create(&cfg);
 
-        macAddressProperties = "aa:aa:bb:bb:cc:cc";
-        sourceProperties = GW_SOURCE_BLE_TELEMETRY;
+        deviceNameProperties = "Sensor7";
+        sourceProperties = GW_IOTHUB_MODULE;
 
         mocks.ResetAllCalls();
 
@@ -2568,25 +2601,15 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
         STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAPPING_UPDATE_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        whenShallMap_fail = 3;
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY, "aNiceDevice")).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY, "aNiceKey")).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE)).IgnoreArgument(1);
-
+        whenShallMessage_fail = 2;
+        STRICT_EXPECTED_CALL(mocks, Message_CreateDerived(m, IGNORED_PTR_ARG, 4))
+            .IgnoreArgument(2);
 
         ///Act
         MODULE_RECEIVE(theAPIS)(n, m);
@@ -2596,645 +2619,13 @@ BEGIN_TEST_SUITE(idmap_ut)
 
         ///Ablution
         Message_Destroy(m);
+        VECTOR_destroy(v);
         MODULE_DESTROY(theAPIS)(n);
-        Broker_Destroy(broker);
 
     }
 
-    /*Tests_SRS_IDMAP_17_035: [If cloning message content fails, IdentityMap_Receive shall deallocate all resources and return.]*/
-    TEST_FUNCTION(IdentityMap_Receive_D2C_Message_GetContent_fail)
-    {
-        ///Arrange
-        CIdentitymapMocks mocks;
-        const MODULE_API* theAPIS= Module_GetApi(MODULE_API_VERSION_1);
-        
-
-        unsigned char fake;
-        BROKER_HANDLE broker = Broker_Create();
-        auto n = MODULE_CREATE(theAPIS)(broker, testVector2);
-
-        MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
-        auto m = Message_Create(&cfg);
-
-        macAddressProperties = "aa:aa:bb:bb:cc:cc";
-        sourceProperties = GW_SOURCE_BLE_TELEMETRY;
-
-        mocks.ResetAllCalls();
-
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY, "aNiceDevice")).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY, "aNiceKey")).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-            .IgnoreArgument(1);
-        whenShallMessage_fail = 3;
-        STRICT_EXPECTED_CALL(mocks, Message_GetContentHandle(m));
-
-
-        ///Act
-        MODULE_RECEIVE(theAPIS)(n, m);
-
-        ///Assert
-        mocks.AssertActualAndExpectedCalls();
-
-        ///Ablution
-        Message_Destroy(m);
-        MODULE_DESTROY(theAPIS)(n);
-        Broker_Destroy(broker);
-
-    }
-
-    /*Tests_SRS_IDMAP_17_037: [If creating new message fails, IdentityMap_Receive shall deallocate all resources and return.]*/
-    TEST_FUNCTION(IdentityMap_Receive_D2C_Message_CreateFromBuffer_fail)
-    {
-        ///Arrange
-        CIdentitymapMocks mocks;
-        const MODULE_API* theAPIS= Module_GetApi(MODULE_API_VERSION_1);
-        
-
-        unsigned char fake;
-        BROKER_HANDLE broker = Broker_Create();
-        auto n = MODULE_CREATE(theAPIS)(broker, testVector2);
-
-        MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
-        auto m = Message_Create(&cfg);
-
-        macAddressProperties = "aa:aa:bb:bb:cc:cc";
-        sourceProperties = GW_SOURCE_BLE_TELEMETRY;
-
-        mocks.ResetAllCalls();
-
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY, "aNiceDevice"))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY, "aNiceKey"))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_GetContentHandle(m));
-        whenShallMessage_fail = 4;
-        STRICT_EXPECTED_CALL(mocks, Message_CreateFromBuffer(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-
-        ///Act
-        MODULE_RECEIVE(theAPIS)(n, m);
-
-        ///Assert
-        mocks.AssertActualAndExpectedCalls();
-
-        ///Ablution
-        Message_Destroy(m);
-        MODULE_DESTROY(theAPIS)(n);
-        Broker_Destroy(broker);
-
-    }
-
-    /*Tests_SRS_IDMAP_17_038: [IdentityMap_Receive shall call Broker_Publish with broker and new message.]*/
-    TEST_FUNCTION(IdentityMap_Receive_D2C_Broker_Publish_fail)
-    {
-        ///Arrange
-        CIdentitymapMocks mocks;
-        const MODULE_API* theAPIS= Module_GetApi(MODULE_API_VERSION_1);
-        
-
-        unsigned char fake;
-        BROKER_HANDLE broker = Broker_Create();
-        auto n = MODULE_CREATE(theAPIS)(broker, testVector2);
-
-        MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
-        auto m = Message_Create(&cfg);
-
-        macAddressProperties = "aa:aa:bb:bb:cc:cc";
-        sourceProperties = GW_SOURCE_BLE_TELEMETRY;
-
-        mocks.ResetAllCalls();
-
-
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY, "aNiceDevice"))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY, "aNiceKey"))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_GetContentHandle(m));
-        STRICT_EXPECTED_CALL(mocks, Message_CreateFromBuffer(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        currentBrokerResult = BROKER_ERROR;
-        STRICT_EXPECTED_CALL(mocks, Broker_Publish(broker, n, IGNORED_PTR_ARG))
-            .IgnoreArgument(3);
-
-
-        ///Act
-        MODULE_RECEIVE(theAPIS)(n, m);
-
-        ///Assert
-        mocks.AssertActualAndExpectedCalls();
-
-        ///Ablution
-        Message_Destroy(m);
-        MODULE_DESTROY(theAPIS)(n);
-        Broker_Destroy(broker);
-
-    }
-
-    //Tests_SRS_IDMAP_17_054: [ If deleting the MAC Address fails, IdentityMap_Receive shall deallocate all resources and return. ]
-    TEST_FUNCTION(IdentityMap_Receive_D2C_macaddress_delete_fails)
-    {
-        ///Arrange
-        CIdentitymapMocks mocks;
-        const MODULE_API* theAPIS= Module_GetApi(MODULE_API_VERSION_1);
-        
-
-        unsigned char fake;
-        BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
-        VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
-
-        IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
-        IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
-        IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
-        IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
-        IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
-        IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
-        IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
-        IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08", "Sensor8", "theKeyFor8" };
-        IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9", "theKeyFor9" };
-        VECTOR_push_back(v, &c1, 1);
-        VECTOR_push_back(v, &c2, 1);
-        VECTOR_push_back(v, &c3, 1);
-        VECTOR_push_back(v, &c4, 1);
-        VECTOR_push_back(v, &c5, 1);
-        VECTOR_push_back(v, &c6, 1);
-        VECTOR_push_back(v, &c7, 1);
-        VECTOR_push_back(v, &c8, 1);
-        VECTOR_push_back(v, &c9, 1);
-        auto n = MODULE_CREATE(theAPIS)(broker, v);
-
-        MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
-        auto m = Message_Create(&cfg);
-
-        macAddressProperties = "07:07:07:07:07:07";
-        sourceProperties = GW_SOURCE_BLE_TELEMETRY;
-
-        mocks.ResetAllCalls();
-
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY, "Sensor7"))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY, "theKeyFor7"))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-            .IgnoreArgument(1)
-            .SetFailReturn((MAP_RESULT)MAP_KEYNOTFOUND);
-
-
-        ///Act
-        MODULE_RECEIVE(theAPIS)(n, m);
-
-        ///Assert
-        mocks.AssertActualAndExpectedCalls();
-
-        ///Ablution
-        Message_Destroy(m);
-        VECTOR_destroy(v);
-        MODULE_DESTROY(theAPIS)(n);
-
-    }
-
-    /*Tests_SRS_IDMAP_17_026: [On a message which passes all checks, IdentityMap_Receive shall call ConstMap_CloneWriteable on the message properties.]*/
-    /*Tests_SRS_IDMAP_17_028: [IdentityMap_Receive shall call Map_AddOrUpdate with key of "deviceName" and value of found deviceId.]*/
-    /*Tests_SRS_IDMAP_17_032: [IdentityMap_Receive shall call Map_AddOrUpdate with key of "source" and value of "mapping".]*/
-    /*Tests_SRS_IDMAP_17_030: [IdentityMap_Receive shall call Map_AddOrUpdate with key of "deviceKey" and value of found deviceKey.]*/
-    /*Tests_SRS_IDMAP_17_053: [ IdentityMap_Receive shall call Map_Delete to remove the "macAddress" property. ]*/
-    /*Tests_SRS_IDMAP_17_034: [IdentityMap_Receive shall clone message content.]*/
-    /*Tests_SRS_IDMAP_17_036: [IdentityMap_Receive shall create a new message by calling Message_Create with new map and cloned content.]*/
-    /*Tests_SRS_IDMAP_17_038: [IdentityMap_Receive shall call Broker_Publish with broker and new message.]*/
-    /*Tests_SRS_IDMAP_17_039: [IdentityMap_Receive will destroy all resources it created.]*/
-    TEST_FUNCTION(IdentityMap_Receive_D2C_Success)
-    {
-        ///Arrange
-        CIdentitymapMocks mocks;
-        const MODULE_API* theAPIS= Module_GetApi(MODULE_API_VERSION_1);
-        
-
-        unsigned char fake;
-        BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
-        VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
-
-        IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
-        IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
-        IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
-        IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
-        IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
-        IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
-        IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
-        IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08", "Sensor8", "theKeyFor8" };
-        IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9", "theKeyFor9" };
-        VECTOR_push_back(v, &c1, 1);
-        VECTOR_push_back(v, &c2, 1);
-        VECTOR_push_back(v, &c3, 1);
-        VECTOR_push_back(v, &c4, 1);
-        VECTOR_push_back(v, &c5, 1);
-        VECTOR_push_back(v, &c6, 1);
-        VECTOR_push_back(v, &c7, 1);
-        VECTOR_push_back(v, &c8, 1);
-        VECTOR_push_back(v, &c9, 1);
-        auto n = MODULE_CREATE(theAPIS)(broker, v);
-
-        MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
-        auto m = Message_Create(&cfg);
-
-        macAddressProperties = "07:07:07:07:07:07";
-        sourceProperties = GW_SOURCE_BLE_TELEMETRY;
-
-        mocks.ResetAllCalls();
-
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY, "Sensor7"))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY, "theKeyFor7"))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_GetContentHandle(m));
-        STRICT_EXPECTED_CALL(mocks, Message_CreateFromBuffer(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Broker_Publish((BROKER_HANDLE)&fake, n, IGNORED_PTR_ARG))
-            .IgnoreArgument(3);
-
-
-        ///Act
-        MODULE_RECEIVE(theAPIS)(n, m);
-
-        ///Assert
-        mocks.AssertActualAndExpectedCalls();
-
-        ///Ablution
-        Message_Destroy(m);
-        VECTOR_destroy(v);
-        MODULE_DESTROY(theAPIS)(n);
-
-    }
-
-    //Tests_SRS_IDMAP_17_049: [ On a C2D message received, IdentityMap_Receive shall call ConstMap_CloneWriteable on the message properties. ]
-    //Tests_SRS_IDMAP_17_051: [ IdentityMap_Receive shall call Map_AddOrUpdate with key of "macAddress" and value of found macAddress. ]
-    //Tests_SRS_IDMAP_17_055: [ IdentityMap_Receive shall call Map_Delete to remove the "deviceName" property. ]
-    //Tests_SRS_IDMAP_17_057: [ IdentityMap_Receive shall call Map_Delete to remove the "deviceKey" property. ]
-    //Tests_SRS_IDMAP_17_032: [IdentityMap_Receive shall call Map_AddOrUpdate with key of "source" and value of "mapping".]
-    //Tests_SRS_IDMAP_17_034: [IdentityMap_Receive shall clone message content.]
-    //Tests_SRS_IDMAP_17_036: [IdentityMap_Receive shall create a new message by calling Message_CreateFromBuffer with new map and cloned content.]
-    //Tests_SRS_IDMAP_17_038: [IdentityMap_Receive shall call Broker_Publish with broker and new message.]
-    TEST_FUNCTION(IdentityMap_Receive_C2D_Success)
-    {
-        ///Arrange
-        CIdentitymapMocks mocks;
-        const MODULE_API* theAPIS= Module_GetApi(MODULE_API_VERSION_1);
-        
-
-        unsigned char fake;
-        BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
-        VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
-
-        IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
-        IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
-        IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
-        IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
-        IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
-        IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
-        IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
-        IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08", "Sensor8", "theKeyFor8" };
-        IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9", "theKeyFor9" };
-        VECTOR_push_back(v, &c1, 1);
-        VECTOR_push_back(v, &c2, 1);
-        VECTOR_push_back(v, &c3, 1);
-        VECTOR_push_back(v, &c4, 1);
-        VECTOR_push_back(v, &c5, 1);
-        VECTOR_push_back(v, &c6, 1);
-        VECTOR_push_back(v, &c7, 1);
-        VECTOR_push_back(v, &c8, 1);
-        VECTOR_push_back(v, &c9, 1);
-        auto n = MODULE_CREATE(theAPIS)(broker, v);
-
-        MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
-        auto m = Message_Create(&cfg);
-
-        deviceNameProperties = "Sensor7";
-        sourceProperties = GW_IOTHUB_MODULE;
-
-        mocks.ResetAllCalls();
-
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-            .IgnoreArgument(1);
-            
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY, "07:07:07:07:07:07"))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_GetContentHandle(m));
-        STRICT_EXPECTED_CALL(mocks, Message_CreateFromBuffer(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Broker_Publish((BROKER_HANDLE)&fake, n, IGNORED_PTR_ARG))
-            .IgnoreArgument(3);
-
-
-        ///Act
-        MODULE_RECEIVE(theAPIS)(n, m);
-
-        ///Assert
-        mocks.AssertActualAndExpectedCalls();
-
-        ///Ablution
-        Message_Destroy(m);
-        VECTOR_destroy(v);
-        MODULE_DESTROY(theAPIS)(n);
-
-    }
-
-    //Tests_SRS_IDMAP_17_057: [ IdentityMap_Receive shall call Map_Delete to remove the "deviceKey" property. ]
-    TEST_FUNCTION(IdentityMap_Receive_C2D_no_key_key_delete)
-    {
-        ///Arrange
-        CIdentitymapMocks mocks;
-        const MODULE_API* theAPIS= Module_GetApi(MODULE_API_VERSION_1);
-        
-
-        unsigned char fake;
-        BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
-        VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
-
-        IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
-        IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
-        IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
-        IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
-        IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
-        IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
-        IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
-        IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08", "Sensor8", "theKeyFor8" };
-        IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9", "theKeyFor9" };
-        VECTOR_push_back(v, &c1, 1);
-        VECTOR_push_back(v, &c2, 1);
-        VECTOR_push_back(v, &c3, 1);
-        VECTOR_push_back(v, &c4, 1);
-        VECTOR_push_back(v, &c5, 1);
-        VECTOR_push_back(v, &c6, 1);
-        VECTOR_push_back(v, &c7, 1);
-        VECTOR_push_back(v, &c8, 1);
-        VECTOR_push_back(v, &c9, 1);
-        auto n = MODULE_CREATE(theAPIS)(broker, v);
-
-        MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
-        auto m = Message_Create(&cfg);
-
-        deviceNameProperties = "Sensor7";
-        sourceProperties = GW_IOTHUB_MODULE;
-
-        mocks.ResetAllCalls();
-
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY, "07:07:07:07:07:07"))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY))
-            .IgnoreArgument(1)
-            .SetFailReturn((MAP_RESULT)MAP_KEYNOTFOUND);
-        STRICT_EXPECTED_CALL(mocks, Message_GetContentHandle(m));
-        STRICT_EXPECTED_CALL(mocks, Message_CreateFromBuffer(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Broker_Publish((BROKER_HANDLE)&fake, n, IGNORED_PTR_ARG))
-            .IgnoreArgument(3);
-
-
-        ///Act
-        MODULE_RECEIVE(theAPIS)(n, m);
-
-        ///Assert
-        mocks.AssertActualAndExpectedCalls();
-
-        ///Ablution
-        Message_Destroy(m);
-        VECTOR_destroy(v);
-        MODULE_DESTROY(theAPIS)(n);
-
-    }
-
-    //Tests_SRS_IDMAP_17_058: [ If deleting the device key does not return MAP_OK or MAP_KEYNOTFOUND, IdentityMap_Receive shall deallocate all resources and return. ]
-    TEST_FUNCTION(IdentityMap_Receive_C2D_key_delete_fails)
-    {
-        ///Arrange
-        CIdentitymapMocks mocks;
-        const MODULE_API* theAPIS= Module_GetApi(MODULE_API_VERSION_1);
-        
-
-        unsigned char fake;
-        BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
-        VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
-
-        IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
-        IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
-        IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
-        IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
-        IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
-        IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
-        IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
-        IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08", "Sensor8", "theKeyFor8" };
-        IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9", "theKeyFor9" };
-        VECTOR_push_back(v, &c1, 1);
-        VECTOR_push_back(v, &c2, 1);
-        VECTOR_push_back(v, &c3, 1);
-        VECTOR_push_back(v, &c4, 1);
-        VECTOR_push_back(v, &c5, 1);
-        VECTOR_push_back(v, &c6, 1);
-        VECTOR_push_back(v, &c7, 1);
-        VECTOR_push_back(v, &c8, 1);
-        VECTOR_push_back(v, &c9, 1);
-        auto n = MODULE_CREATE(theAPIS)(broker, v);
-
-        MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
-        auto m = Message_Create(&cfg);
-
-        deviceNameProperties = "Sensor7";
-        sourceProperties = GW_IOTHUB_MODULE;
-
-        mocks.ResetAllCalls();
-
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY, "07:07:07:07:07:07"))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY))
-            .IgnoreArgument(1)
-            .SetFailReturn((MAP_RESULT)MAP_INVALIDARG);
-
-        ///Act
-        MODULE_RECEIVE(theAPIS)(n, m);
-
-        ///Assert
-        mocks.AssertActualAndExpectedCalls();
-
-        ///Ablution
-        Message_Destroy(m);
-        VECTOR_destroy(v);
-        MODULE_DESTROY(theAPIS)(n);
-
-    }
-
-    //Tests_SRS_IDMAP_17_056: [ If deleting the device name fails, IdentityMap_Receive shall deallocate all resources and return. ]
-    TEST_FUNCTION(IdentityMap_Receive_C2D_devicename_delete_fails)
+    //Tests_SRS_IDMAP_17_048: [ If the deviceName of the message is not found in the mapping table, then the message shall not be marked as a C2D message. ]
+    TEST_FUNCTION(IdentityMap_Receive_C2D_id_no_match_no_new_msg)
     {
         ///Arrange
         CIdentitymapMocks mocks;
@@ -3263,12 +2654,12 @@ BEGIN_TEST_SUITE(idmap_ut)
         VECTOR_push_back(v, &c7, 1);
         VECTOR_push_back(v, &c8, 1);
         VECTOR_push_back(v, &c9, 1);
-        auto n = MODULE_CREATE(theAPIS)(broker, v);
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(v, NULL));
 
         MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
         auto m = Message_Create(&cfg);
 
-        deviceNameProperties = "Sensor7";
+        deviceNameProperties = "Sensor13";
         sourceProperties = GW_IOTHUB_MODULE;
 
         mocks.ResetAllCalls();
@@ -3277,100 +2668,13 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
         STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY, "07:07:07:07:07:07"))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE))
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAPPING_UPDATE_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-            .IgnoreArgument(1)
-            .SetFailReturn((MAP_RESULT)MAP_INVALIDARG);
-
-        ///Act
-        MODULE_RECEIVE(theAPIS)(n, m);
-
-        ///Assert
-        mocks.AssertActualAndExpectedCalls();
-
-        ///Ablution
-        Message_Destroy(m);
-        VECTOR_destroy(v);
-        MODULE_DESTROY(theAPIS)(n);
-
-    }
-
-    //Tests_SRS_IDMAP_17_044: [ If messageHandle properties contains a "source" property that is set to "mapping", the message shall not be marked as a D2C message. ] 
-    TEST_FUNCTION(IdentityMap_Receive_C2D_MapUpdate_source_fails)
-    {
-        ///Arrange
-        CIdentitymapMocks mocks;
-        const MODULE_API* theAPIS= Module_GetApi(MODULE_API_VERSION_1);
-        
-
-        unsigned char fake;
-        BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
-        VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
-
-        IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
-        IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
-        IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
-        IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
-        IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
-        IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
-        IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
-        IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08", "Sensor8", "theKeyFor8" };
-        IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9", "theKeyFor9" };
-        VECTOR_push_back(v, &c1, 1);
-        VECTOR_push_back(v, &c2, 1);
-        VECTOR_push_back(v, &c3, 1);
-        VECTOR_push_back(v, &c4, 1);
-        VECTOR_push_back(v, &c5, 1);
-        VECTOR_push_back(v, &c6, 1);
-        VECTOR_push_back(v, &c7, 1);
-        VECTOR_push_back(v, &c8, 1);
-        VECTOR_push_back(v, &c9, 1);
-        auto n = MODULE_CREATE(theAPIS)(broker, v);
-
-        MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
-        auto m = Message_Create(&cfg);
-
-        deviceNameProperties = "Sensor7";
-        sourceProperties = GW_IOTHUB_MODULE;
-
-        mocks.ResetAllCalls();
-
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY, "07:07:07:07:07:07"))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE))
-            .IgnoreArgument(1)
-            .SetFailReturn(MAP_ERROR);
-
-
         ///Act
         MODULE_RECEIVE(theAPIS)(n, m);
 
@@ -3384,9 +2688,9 @@ BEGIN_TEST_SUITE(idmap_ut)
 
     }
 
-    //Tests_SRS_IDMAP_17_052: [ If adding macAddress fails, IdentityMap_Receive shall deallocate all resources and return. ]
-
-    TEST_FUNCTION(IdentityMap_Receive_C2D_MapUpdate_mac_fails)
+    //Tests_SRS_IDMAP_17_048: [ If the deviceName of the message is not found in the mapping table, then the message shall not be marked as a C2D message. ]
+    //Tests_SRS_IDMAP_17_045: [ If messageHandle properties does not contain "deviceName" property, then the message shall not be marked as a C2D message. ]
+    TEST_FUNCTION(IdentityMap_Receive_C2D_no_id_no_new_msg)
     {
         ///Arrange
         CIdentitymapMocks mocks;
@@ -3415,12 +2719,12 @@ BEGIN_TEST_SUITE(idmap_ut)
         VECTOR_push_back(v, &c7, 1);
         VECTOR_push_back(v, &c8, 1);
         VECTOR_push_back(v, &c9, 1);
-        auto n = MODULE_CREATE(theAPIS)(broker, v);
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(v, NULL));
 
         MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
         auto m = Message_Create(&cfg);
 
-        deviceNameProperties = "Sensor7";
+        deviceNameProperties = NULL;
         sourceProperties = GW_IOTHUB_MODULE;
 
         mocks.ResetAllCalls();
@@ -3429,23 +2733,13 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
         STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAPPING_UPDATE_PROPERTY))
+            .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY, "07:07:07:07:07:07"))
-            .IgnoreArgument(1)
-            .SetFailReturn(MAP_ERROR);
-
-
         ///Act
         MODULE_RECEIVE(theAPIS)(n, m);
 
@@ -3459,8 +2753,8 @@ BEGIN_TEST_SUITE(idmap_ut)
 
     }
 
-    //Tests_SRS_IDMAP_17_050: [ If ConstMap_CloneWriteable fails, IdentityMap_Receive shall deallocate any resources and return. ]
-    TEST_FUNCTION(IdentityMap_Receive_C2D_clone_writeable_fails)
+    //Tests_SRS_IDMAP_17_047: [ If messageHandle property "source" is not equal to "iothub", then the message shall not be marked as a C2D message. ]
+    TEST_FUNCTION(IdentityMap_Receive_no_direction_no_new_msg)
     {
         ///Arrange
         CIdentitymapMocks mocks;
@@ -3489,13 +2783,13 @@ BEGIN_TEST_SUITE(idmap_ut)
         VECTOR_push_back(v, &c7, 1);
         VECTOR_push_back(v, &c8, 1);
         VECTOR_push_back(v, &c9, 1);
-        auto n = MODULE_CREATE(theAPIS)(broker, v);
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(v, NULL));
 
         MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
         auto m = Message_Create(&cfg);
 
         deviceNameProperties = "Sensor7";
-        sourceProperties = GW_IOTHUB_MODULE;
+        sourceProperties = NULL;
 
         mocks.ResetAllCalls();
 
@@ -3503,19 +2797,11 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
         STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAPPING_UPDATE_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .SetFailReturn((MAP_HANDLE)NULL);
-
 
         ///Act
         MODULE_RECEIVE(theAPIS)(n, m);
@@ -3530,8 +2816,8 @@ BEGIN_TEST_SUITE(idmap_ut)
 
     }
 
-    //Tests_SRS_IDMAP_17_046: [ If messageHandle properties does not contain a "source" property, then the message shall not be marked as a C2D message. ]
-    TEST_FUNCTION(IdentityMap_Receive_C2D_getproperties_fails)
+    //Tests_SRS_IDMAP_17_047: [ If messageHandle property "source" is not equal to "iothub", then the message shall not be marked as a C2D message. ]
+    TEST_FUNCTION(IdentityMap_Receive_mapping_ignore_mapping_msg)
     {
         ///Arrange
         CIdentitymapMocks mocks;
@@ -3560,13 +2846,15 @@ BEGIN_TEST_SUITE(idmap_ut)
         VECTOR_push_back(v, &c7, 1);
         VECTOR_push_back(v, &c8, 1);
         VECTOR_push_back(v, &c9, 1);
-        auto n = MODULE_CREATE(theAPIS)(broker, v);
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(v, NULL));
 
         MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
         auto m = Message_Create(&cfg);
 
+        macAddressProperties = "07:07:07:07:07:07";
         deviceNameProperties = "Sensor7";
-        sourceProperties = GW_IOTHUB_MODULE;
+        deviceKeyProperties = "theKeyFor7";
+        sourceProperties = GW_IDMAP_MODULE;
 
         mocks.ResetAllCalls();
 
@@ -3574,13 +2862,11 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
         STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAPPING_UPDATE_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m))
-            .SetFailReturn((CONSTMAP_HANDLE)NULL);
 
         ///Act
         MODULE_RECEIVE(theAPIS)(n, m);
@@ -3595,54 +2881,97 @@ BEGIN_TEST_SUITE(idmap_ut)
 
     }
 
-    //Tests_SRS_IDMAP_17_048: [ If the deviceName of the message is not found in deviceToMacArray, then the message shall not be marked as a C2D message. ]
-    TEST_FUNCTION(IdentityMap_Receive_C2D_id_no_match_no_new_msg)
+    /*Tests_SRS_IDMAP_17_063: [ If messageHandle properties contains a "mappingUpdate" property, IdentityMap_Receive shall replace the mapping table with the mapping in the message content and shall not republish the message. ]*/
+    /*Tests_SRS_IDMAP_17_064: [ IdentityMap_Receive shall parse the message content as a JSON mapping array, in the same form as the module configuration. ]*/
+    /*Tests_SRS_IDMAP_17_065: [ IdentityMap_Receive shall build a new mapping table, replace the current one with it, and release the current one. ]*/
+    TEST_FUNCTION(IdentityMap_Receive_mapping_update_replaces_table)
     {
         ///Arrange
         CIdentitymapMocks mocks;
         const MODULE_API* theAPIS= Module_GetApi(MODULE_API_VERSION_1);
-        
 
         unsigned char fake;
-        BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
-        VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
-
-        IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
-        IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
-        IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
-        IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
-        IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
-        IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
-        IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
-        IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08", "Sensor8", "theKeyFor8" };
-        IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9", "theKeyFor9" };
-        VECTOR_push_back(v, &c1, 1);
-        VECTOR_push_back(v, &c2, 1);
-        VECTOR_push_back(v, &c3, 1);
-        VECTOR_push_back(v, &c4, 1);
-        VECTOR_push_back(v, &c5, 1);
-        VECTOR_push_back(v, &c6, 1);
-        VECTOR_push_back(v, &c7, 1);
-        VECTOR_push_back(v, &c8, 1);
-        VECTOR_push_back(v, &c9, 1);
-        auto n = MODULE_CREATE(theAPIS)(broker, v);
+        BROKER_HANDLE broker = Broker_Create();
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(testVector1, TEST_MAPPING_UPDATE_SOURCE));
 
         MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
         auto m = Message_Create(&cfg);
 
-        deviceNameProperties = "Sensor13";
-        sourceProperties = GW_IOTHUB_MODULE;
+        const char * mapping = "pretend this is a valid JSON mapping";
+        messageContent.buffer = (const unsigned char *)mapping;
+        messageContent.size = strlen(mapping);
+        mappingUpdateProperties = "true";
+        sourceProperties = TEST_MAPPING_UPDATE_SOURCE;
+        macAddressProperties = "00:00:00:00:00:00";
 
         mocks.ResetAllCalls();
 
-
         STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
         STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAPPING_UPDATE_PROPERTY))
+            .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
+        STRICT_EXPECTED_CALL(mocks, Message_GetContent(m));
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(strlen(mapping) + 1)); /*this is for the mapping string*/
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
+        /* parse the new mapping */
+        STRICT_EXPECTED_CALL(mocks, json_parse_string(mapping));
+        STRICT_EXPECTED_CALL(mocks, json_value_get_array(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(IDENTITY_MAP_CONFIG)));
+        STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .SetReturn(1UL);
+        STRICT_EXPECTED_CALL(mocks, json_array_get_object(IGNORED_PTR_ARG, 0))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "macAddress"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "deviceId"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "deviceKey"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, "00:00:00:00:00:00"))
             .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, "id"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, "key"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+            .IgnoreArgument(1)
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, json_value_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        /* validate it and build the new table */
+        STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the mapping table*/
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the mac address*/
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device name*/
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is for the device key*/
+            .IgnoreAllArguments();
+
+        /* release the old table */
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
+        /* release the parsed mapping */
+        STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
         ///Act
         MODULE_RECEIVE(theAPIS)(n, m);
@@ -3651,61 +2980,49 @@ BEGIN_TEST_SUITE(idmap_ut)
         mocks.AssertActualAndExpectedCalls();
 
         ///Ablution
+        messageContent.buffer = NULL;
+        messageContent.size = 0;
         Message_Destroy(m);
-        VECTOR_destroy(v);
         MODULE_DESTROY(theAPIS)(n);
-
+        Broker_Destroy(broker);
     }
 
-    //Tests_SRS_IDMAP_17_048: [ If the deviceName of the message is not found in deviceToMacArray, then the message shall not be marked as a C2D message. ]
-    //Tests_SRS_IDMAP_17_045: [ If messageHandle properties does not contain "deviceName" property, then the message shall not be marked as a C2D message. ]
-    TEST_FUNCTION(IdentityMap_Receive_C2D_no_id_no_new_msg)
+    /*Tests_SRS_IDMAP_17_066: [ If the new mapping cannot be parsed, validated or built, IdentityMap_Receive shall keep the current mapping table and return. ]*/
+    TEST_FUNCTION(IdentityMap_Receive_mapping_update_parse_fails_keeps_table)
     {
         ///Arrange
         CIdentitymapMocks mocks;
         const MODULE_API* theAPIS= Module_GetApi(MODULE_API_VERSION_1);
-        
 
         unsigned char fake;
-        BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
-        VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
-
-        IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
-        IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
-        IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
-        IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
-        IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
-        IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
-        IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
-        IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08", "Sensor8", "theKeyFor8" };
-        IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9", "theKeyFor9" };
-        VECTOR_push_back(v, &c1, 1);
-        VECTOR_push_back(v, &c2, 1);
-        VECTOR_push_back(v, &c3, 1);
-        VECTOR_push_back(v, &c4, 1);
-        VECTOR_push_back(v, &c5, 1);
-        VECTOR_push_back(v, &c6, 1);
-        VECTOR_push_back(v, &c7, 1);
-        VECTOR_push_back(v, &c8, 1);
-        VECTOR_push_back(v, &c9, 1);
-        auto n = MODULE_CREATE(theAPIS)(broker, v);
+        BROKER_HANDLE broker = Broker_Create();
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(testVector1, TEST_MAPPING_UPDATE_SOURCE));
 
         MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
         auto m = Message_Create(&cfg);
 
-        deviceNameProperties = NULL;
-        sourceProperties = GW_IOTHUB_MODULE;
+        const char * mapping = "pretend this is a valid JSON mapping";
+        messageContent.buffer = (const unsigned char *)mapping;
+        messageContent.size = strlen(mapping);
+        mappingUpdateProperties = "true";
+        sourceProperties = TEST_MAPPING_UPDATE_SOURCE;
+        macAddressProperties = "00:00:00:00:00:00";
 
         mocks.ResetAllCalls();
 
-
         STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
         STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAPPING_UPDATE_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
             .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Message_GetContent(m));
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(strlen(mapping) + 1)); /*this is for the mapping string*/
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
+        STRICT_EXPECTED_CALL(mocks, json_parse_string(mapping))
+            .SetFailReturn((JSON_Value*)NULL);
 
         ///Act
         MODULE_RECEIVE(theAPIS)(n, m);
@@ -3714,59 +3031,46 @@ BEGIN_TEST_SUITE(idmap_ut)
         mocks.AssertActualAndExpectedCalls();
 
         ///Ablution
+        messageContent.buffer = NULL;
+        messageContent.size = 0;
         Message_Destroy(m);
-        VECTOR_destroy(v);
         MODULE_DESTROY(theAPIS)(n);
-
+        Broker_Destroy(broker);
     }
 
-    //Tests_SRS_IDMAP_17_047: [ If messageHandle property "source" is not equal to "iothub", then the message shall not be marked as a C2D message. ]
-    TEST_FUNCTION(IdentityMap_Receive_no_direction_no_new_msg)
+    /*Tests_SRS_IDMAP_17_066: [ If the new mapping cannot be parsed, validated or built, IdentityMap_Receive shall keep the current mapping table and return. ]*/
+    TEST_FUNCTION(IdentityMap_Receive_mapping_update_alloc_fails_keeps_table)
     {
         ///Arrange
         CIdentitymapMocks mocks;
         const MODULE_API* theAPIS= Module_GetApi(MODULE_API_VERSION_1);
-        
 
         unsigned char fake;
-        BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
-        VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
-
-        IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
-        IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
-        IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
-        IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
-        IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
-        IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
-        IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
-        IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08", "Sensor8", "theKeyFor8" };
-        IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9", "theKeyFor9" };
-        VECTOR_push_back(v, &c1, 1);
-        VECTOR_push_back(v, &c2, 1);
-        VECTOR_push_back(v, &c3, 1);
-        VECTOR_push_back(v, &c4, 1);
-        VECTOR_push_back(v, &c5, 1);
-        VECTOR_push_back(v, &c6, 1);
-        VECTOR_push_back(v, &c7, 1);
-        VECTOR_push_back(v, &c8, 1);
-        VECTOR_push_back(v, &c9, 1);
-        auto n = MODULE_CREATE(theAPIS)(broker, v);
+        BROKER_HANDLE broker = Broker_Create();
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(testVector1, TEST_MAPPING_UPDATE_SOURCE));
 
         MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
         auto m = Message_Create(&cfg);
 
-        deviceNameProperties = "Sensor7";
-        sourceProperties = NULL;
+        const char * mapping = "pretend this is a valid JSON mapping";
+        messageContent.buffer = (const unsigned char *)mapping;
+        messageContent.size = strlen(mapping);
+        mappingUpdateProperties = "true";
+        sourceProperties = TEST_MAPPING_UPDATE_SOURCE;
+        macAddressProperties = "00:00:00:00:00:00";
 
         mocks.ResetAllCalls();
 
-
         STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
         STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAPPING_UPDATE_PROPERTY))
+            .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
             .IgnoreArgument(1);
-
+        STRICT_EXPECTED_CALL(mocks, Message_GetContent(m));
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(strlen(mapping) + 1)) /*this is for the mapping string*/
+            .SetFailReturn((void_ptr)NULL);
 
         ///Act
         MODULE_RECEIVE(theAPIS)(n, m);
@@ -3775,62 +3079,41 @@ BEGIN_TEST_SUITE(idmap_ut)
         mocks.AssertActualAndExpectedCalls();
 
         ///Ablution
+        messageContent.buffer = NULL;
+        messageContent.size = 0;
         Message_Destroy(m);
-        VECTOR_destroy(v);
         MODULE_DESTROY(theAPIS)(n);
-
+        Broker_Destroy(broker);
     }
 
-    //Tests_SRS_IDMAP_17_047: [ If messageHandle property "source" is not equal to "iothub", then the message shall not be marked as a C2D message. ]
-    TEST_FUNCTION(IdentityMap_Receive_mapping_ignore_mapping_msg)
+    /*Tests_SRS_IDMAP_17_073: [ If the module has no mappingUpdateSource, or the "source" property of a "mappingUpdate" message is missing or not equal to it, IdentityMap_Receive shall ignore the message. ]*/
+    TEST_FUNCTION(IdentityMap_Receive_mapping_update_from_other_source_is_ignored)
     {
         ///Arrange
         CIdentitymapMocks mocks;
         const MODULE_API* theAPIS= Module_GetApi(MODULE_API_VERSION_1);
-        
 
         unsigned char fake;
-        BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
-        VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
-
-        IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
-        IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
-        IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
-        IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
-        IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
-        IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
-        IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
-        IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08", "Sensor8", "theKeyFor8" };
-        IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9", "theKeyFor9" };
-        VECTOR_push_back(v, &c1, 1);
-        VECTOR_push_back(v, &c2, 1);
-        VECTOR_push_back(v, &c3, 1);
-        VECTOR_push_back(v, &c4, 1);
-        VECTOR_push_back(v, &c5, 1);
-        VECTOR_push_back(v, &c6, 1);
-        VECTOR_push_back(v, &c7, 1);
-        VECTOR_push_back(v, &c8, 1);
-        VECTOR_push_back(v, &c9, 1);
-        auto n = MODULE_CREATE(theAPIS)(broker, v);
+        BROKER_HANDLE broker = Broker_Create();
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(testVector1, TEST_MAPPING_UPDATE_SOURCE));
 
         MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
         auto m = Message_Create(&cfg);
 
-        macAddressProperties = "07:07:07:07:07:07";
-        deviceNameProperties = "Sensor7";
-        deviceKeyProperties = "theKeyFor7";
-        sourceProperties = GW_IDMAP_MODULE;
+        mappingUpdateProperties = "true";
+        sourceProperties = GW_SOURCE_BLE_TELEMETRY;
+        macAddressProperties = "00:00:00:00:00:00";
 
         mocks.ResetAllCalls();
 
-
         STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
         STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAPPING_UPDATE_PROPERTY))
+            .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
             .IgnoreArgument(1);
 
-
         ///Act
         MODULE_RECEIVE(theAPIS)(n, m);
 
@@ -3839,10 +3122,47 @@ BEGIN_TEST_SUITE(idmap_ut)
 
         ///Ablution
         Message_Destroy(m);
-        VECTOR_destroy(v);
         MODULE_DESTROY(theAPIS)(n);
+        Broker_Destroy(broker);
+    }
+
+    /*Tests_SRS_IDMAP_17_073: [ If the module has no mappingUpdateSource, or the "source" property of a "mappingUpdate" message is missing or not equal to it, IdentityMap_Receive shall ignore the message. ]*/
+    TEST_FUNCTION(IdentityMap_Receive_mapping_update_without_configured_source_is_ignored)
+    {
+        ///Arrange
+        CIdentitymapMocks mocks;
+        const MODULE_API* theAPIS= Module_GetApi(MODULE_API_VERSION_1);
+
+        unsigned char fake;
+        BROKER_HANDLE broker = Broker_Create();
+        auto n = MODULE_CREATE(theAPIS)(broker, module_config(testVector1, NULL));
+
+        MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
+        auto m = Message_Create(&cfg);
+
+        mappingUpdateProperties = "true";
+        sourceProperties = TEST_MAPPING_UPDATE_SOURCE;
+
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
+        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAPPING_UPDATE_PROPERTY))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
+            .IgnoreArgument(1);
+
+        ///Act
+        MODULE_RECEIVE(theAPIS)(n, m);
+
+        ///Assert
+        mocks.AssertActualAndExpectedCalls();
 
+        ///Ablution
+        Message_Destroy(m);
+        MODULE_DESTROY(theAPIS)(n);
+        Broker_Destroy(broker);
     }
-    //
 
 END_TEST_SUITE(idmap_ut)
@@ -17,6 +17,11 @@ typedef struct IOTHUB_CONFIG_TAG
     const char* IoTHubName;
     const char* IoTHubSuffix;
     IOTHUB_CLIENT_TRANSPORT_PROVIDER transportProvider;
+    size_t maxDevices;        /*0 means no limit on the number of devices with an open IoTHubClient*/
+    size_t deviceIdleTimeout; /*seconds a device can stay silent before its IoTHubClient is closed, 0 means forever*/
+    size_t batchMaxMessages;  /*messages a device holds before sending them together, 0 means no limit on the count*/
+    size_t batchMaxBytes;     /*bytes of content a device holds before sending them together, 0 means no limit on the size*/
+    size_t batchMaxAge;       /*seconds the oldest message held by a device waits before being sent, 0 means no limit on the age*/
 }IOTHUB_CONFIG; /*this needs to be passed to the Module_Create function*/
 
 MODULE_EXPORT const MODULE_API* MODULE_STATIC_GETAPI(IOTHUB_MODULE)(MODULE_API_VERSION gateway_api_version);
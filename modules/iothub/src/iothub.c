@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <string.h>
 #include <ctype.h>
 #include "azure_c_shared_utility/gballoc.h"
 
@@ -14,7 +15,9 @@
 #include "iothubtransportamqp.h"
 #include "iothubtransportmqtt.h"
 #include "iothub_message.h"
-#include "azure_c_shared_utility/vector.h"
+#include "azure_c_shared_utility/agenttime.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/strings.h"
 #include "messageproperties.h"
@@ -29,13 +32,47 @@ typedef struct PERSONALITY_TAG
     IOTHUB_CLIENT_HANDLE iothubHandle;
     BROKER_HANDLE broker;
     MODULE_HANDLE module;
+    size_t hash; /*hash of deviceName*/
+    struct PERSONALITY_TAG* nextInBucket;
+    struct PERSONALITY_TAG* moreRecentlyUsed;
+    struct PERSONALITY_TAG* lessRecentlyUsed;
+    time_t lastUsed;
+    IOTHUB_MESSAGE_HANDLE* batch; /*messages waiting to be sent together*/
+    size_t batchCount;
+    size_t batchCapacity;
+    size_t batchBytes;
+    time_t batchStarted; /*when the oldest message of the batch was received*/
+    struct PERSONALITY_TAG* newerBatch;
+    struct PERSONALITY_TAG* olderBatch;
 }PERSONALITY;
 
 typedef PERSONALITY* PERSONALITY_PTR;
 
 typedef struct IOTHUB_HANDLE_DATA_TAG
 {
-    VECTOR_HANDLE personalities; /*holds PERSONALITYs*/
+    PERSONALITY_PTR* buckets; /*holds PERSONALITYs, chained by nextInBucket*/
+    size_t bucketCount; /*always a power of 2*/
+    size_t personalityCount;
+    PERSONALITY_PTR mostRecentlyUsed;
+    PERSONALITY_PTR leastRecentlyUsed;
+    size_t maxDevices;
+    size_t deviceIdleTimeout;
+    size_t personalityHits;
+    size_t personalityMisses;
+    size_t personalityEvictions;
+    size_t personalityExpirations;
+    size_t batchMaxMessages;
+    size_t batchMaxBytes;
+    size_t batchMaxAge;
+    PERSONALITY_PTR oldestBatch; /*personalities holding a batch, chained by newerBatch*/
+    PERSONALITY_PTR newestBatch;
+    PERSONALITY_PTR retired; /*removed personalities whose client still has events to send, chained by nextInBucket*/
+    size_t retiredCount;
+    size_t batchesSent;
+    size_t messagesBatched;
+    LOCK_HANDLE lockHandle; /*only exists when batches can expire, guards the personalities against the flush thread*/
+    THREAD_HANDLE threadHandle;
+    int stopThread;
     STRING_HANDLE IoTHubName;
     STRING_HANDLE IoTHubSuffix;
     IOTHUB_CLIENT_TRANSPORT_PROVIDER transportProvider;
@@ -50,6 +87,18 @@ typedef struct IOTHUB_HANDLE_DATA_TAG
 #define SUFFIX "IoTHubSuffix"
 #define HUBNAME "IoTHubName"
 #define TRANSPORT "Transport"
+#define MAXDEVICES "MaxDevices"
+#define DEVICEIDLETIMEOUT "DeviceIdleTimeout"
+#define BATCHMAXMESSAGES "BatchMaxMessages"
+#define BATCHMAXBYTES "BatchMaxBytes"
+#define BATCHMAXAGE "BatchMaxAge"
+
+#define INITIAL_BUCKET_COUNT 16
+#define INITIAL_BATCH_CAPACITY 4
+#define BATCH_THREAD_PERIOD_MS 1000
+#define SEND_DRAIN_PERIOD_MS 100
+#define SEND_DRAIN_TIMEOUT_MS 10000
+#define RETIRED_PERSONALITIES_MAX 16
 
 static int strcmp_i(const char* lhs, const char* rhs)
 {
@@ -119,10 +168,30 @@ static void* IotHub_ParseConfigurationFromJson(const char* configuration)
                 }
                 else
                 {
+                    /*Codes_SRS_IOTHUBMODULE_17_024: [ `IotHub_ParseConfigurationFromJson` shall set `maxDevices` to the value named "MaxDevices", or to 0 if there is no such value. ]*/
+                    /*Codes_SRS_IOTHUBMODULE_17_025: [ `IotHub_ParseConfigurationFromJson` shall set `deviceIdleTimeout` to the value named "DeviceIdleTimeout", or to 0 if there is no such value. ]*/
+                    double maxDevices = json_object_get_number(obj, MAXDEVICES);
+                    double deviceIdleTimeout = json_object_get_number(obj, DEVICEIDLETIMEOUT);
+                    /*Codes_SRS_IOTHUBMODULE_17_038: [ `IotHub_ParseConfigurationFromJson` shall set `batchMaxMessages`, `batchMaxBytes` and `batchMaxAge` to the values named "BatchMaxMessages", "BatchMaxBytes" and "BatchMaxAge", or to 0 if there are no such values. ]*/
+                    double batchMaxMessages = json_object_get_number(obj, BATCHMAXMESSAGES);
+                    double batchMaxBytes = json_object_get_number(obj, BATCHMAXBYTES);
+                    double batchMaxAge = json_object_get_number(obj, BATCHMAXAGE);
                     char* name;
                     char* suffix;
                     IOTHUB_CONFIG* config;
-                    if ((name = malloc(strlen(IoTHubName) + 1)) == NULL)
+                    if ((maxDevices < 0) || (deviceIdleTimeout < 0))
+                    {
+                        /*Codes_SRS_IOTHUBMODULE_17_026: [ If "MaxDevices" or "DeviceIdleTimeout" is negative then `IotHub_ParseConfigurationFromJson` shall fail and return NULL. ]*/
+                        LogError("%s and %s cannot be negative", MAXDEVICES, DEVICEIDLETIMEOUT);
+                        result = NULL;
+                    }
+                    else if ((batchMaxMessages < 0) || (batchMaxBytes < 0) || (batchMaxAge < 0))
+                    {
+                        /*Codes_SRS_IOTHUBMODULE_17_039: [ If "BatchMaxMessages", "BatchMaxBytes" or "BatchMaxAge" is negative then `IotHub_ParseConfigurationFromJson` shall fail and return NULL. ]*/
+                        LogError("%s, %s and %s cannot be negative", BATCHMAXMESSAGES, BATCHMAXBYTES, BATCHMAXAGE);
+                        result = NULL;
+                    }
+                    else if ((name = malloc(strlen(IoTHubName) + 1)) == NULL)
                     {
                         LogError("Could not allocate memory for IoTHubName");
                         result = NULL;
@@ -169,6 +238,11 @@ static void* IotHub_ParseConfigurationFromJson(const char* configuration)
                             strcpy(suffix, IoTHubSuffix);
                             config->IoTHubName = name;
                             config->IoTHubSuffix = suffix;
+                            config->maxDevices = (size_t)maxDevices;
+                            config->deviceIdleTimeout = (size_t)deviceIdleTimeout;
+                            config->batchMaxMessages = (size_t)batchMaxMessages;
+                            config->batchMaxBytes = (size_t)batchMaxBytes;
+                            config->batchMaxAge = (size_t)batchMaxAge;
                         }
 
                         result = config;
@@ -235,17 +309,47 @@ static MODULE_HANDLE IotHub_Create(BROKER_HANDLE broker, const void* configurati
         }
         else
         {
-            /*Codes_SRS_IOTHUBMODULE_02_006: [ `IotHub_Create` shall create an empty `VECTOR` containing pointers to `PERSONALITY`s. ]*/
-            result->personalities = VECTOR_create(sizeof(PERSONALITY_PTR));
-            if (result->personalities == NULL)
+            /*Codes_SRS_IOTHUBMODULE_17_027: [ `IotHub_Create` shall create an empty table of `PERSONALITY`s indexed by device ID. ]*/
+            result->buckets = malloc(INITIAL_BUCKET_COUNT * sizeof(PERSONALITY_PTR));
+            if (result->buckets == NULL)
             {
-                /*Codes_SRS_IOTHUBMODULE_02_007: [ If creating the personality vector fails then `IotHub_Create` shall fail and return `NULL`. ]*/
+                /*Codes_SRS_IOTHUBMODULE_17_028: [ If creating the personality table fails then `IotHub_Create` shall fail and return `NULL`. ]*/
                 free(result);
                 result = NULL;
-                LogError("VECTOR_create returned NULL");
+                LogError("unable to allocate the personality table");
             }
             else
             {
+                size_t i;
+                for (i = 0; i < INITIAL_BUCKET_COUNT; i++)
+                {
+                    result->buckets[i] = NULL;
+                }
+                result->bucketCount = INITIAL_BUCKET_COUNT;
+                result->personalityCount = 0;
+                result->mostRecentlyUsed = NULL;
+                result->leastRecentlyUsed = NULL;
+                /*Codes_SRS_IOTHUBMODULE_17_029: [ `IotHub_Create` shall store `configuration->maxDevices` and `configuration->deviceIdleTimeout`. ]*/
+                result->maxDevices = config->maxDevices;
+                result->deviceIdleTimeout = config->deviceIdleTimeout;
+                result->personalityHits = 0;
+                result->personalityMisses = 0;
+                result->personalityEvictions = 0;
+                result->personalityExpirations = 0;
+                /*Codes_SRS_IOTHUBMODULE_17_040: [ `IotHub_Create` shall store `configuration->batchMaxMessages`, `configuration->batchMaxBytes` and `configuration->batchMaxAge`. ]*/
+                result->batchMaxMessages = config->batchMaxMessages;
+                result->batchMaxBytes = config->batchMaxBytes;
+                result->batchMaxAge = config->batchMaxAge;
+                result->oldestBatch = NULL;
+                result->newestBatch = NULL;
+                result->retired = NULL;
+                result->retiredCount = 0;
+                result->batchesSent = 0;
+                result->messagesBatched = 0;
+                result->lockHandle = NULL;
+                result->threadHandle = NULL;
+                result->stopThread = 0;
+
                 result->transportProvider = config->transportProvider;
                 if (result->transportProvider == HTTP_Protocol ||
                     result->transportProvider == AMQP_Protocol)
@@ -255,10 +359,10 @@ static MODULE_HANDLE IotHub_Create(BROKER_HANDLE broker, const void* configurati
                     if (result->transportHandle == NULL)
                     {
                         /*Codes_SRS_IOTHUBMODULE_17_002: [ If creating the shared transport fails, `IotHub_Create` shall fail and return `NULL`. ]*/
-                        VECTOR_destroy(result->personalities);
+                        free(result->buckets);
                         free(result);
                         result = NULL;
-                        LogError("VECTOR_create returned NULL");
+                        LogError("IoTHubTransport_Create returned NULL");
                     }
                 }
                 else
@@ -274,7 +378,7 @@ static MODULE_HANDLE IotHub_Create(BROKER_HANDLE broker, const void* configurati
                     {
                         LogError("STRING_construct returned NULL");
                         IoTHubTransport_Destroy(result->transportHandle);
-                        VECTOR_destroy(result->personalities);
+                        free(result->buckets);
                         free(result);
                         result = NULL;
                     }
@@ -283,7 +387,21 @@ static MODULE_HANDLE IotHub_Create(BROKER_HANDLE broker, const void* configurati
                         LogError("STRING_construct returned NULL");
                         STRING_delete(result->IoTHubName);
                         IoTHubTransport_Destroy(result->transportHandle);
-                        VECTOR_destroy(result->personalities);
+                        free(result->buckets);
+                        free(result);
+                        result = NULL;
+                    }
+                    else if (
+                        (config->batchMaxAge != 0) &&
+                        ((result->lockHandle = Lock_Init()) == NULL)
+                        )
+                    {
+                        /*Codes_SRS_IOTHUBMODULE_17_041: [ If `configuration->batchMaxAge` is not 0, `IotHub_Create` shall create a lock by calling `Lock_Init`. ]*/
+                        LogError("unable to Lock_Init");
+                        STRING_delete(result->IoTHubSuffix);
+                        STRING_delete(result->IoTHubName);
+                        IoTHubTransport_Destroy(result->transportHandle);
+                        free(result->buckets);
                         free(result);
                         result = NULL;
                     }
@@ -300,6 +418,285 @@ static MODULE_HANDLE IotHub_Create(BROKER_HANDLE broker, const void* configurati
     return result;
 }
 
+static bool IotHub_IsBatching(const IOTHUB_HANDLE_DATA* moduleHandleData)
+{
+    return
+        (moduleHandleData->batchMaxMessages != 0) ||
+        (moduleHandleData->batchMaxBytes != 0) ||
+        (moduleHandleData->batchMaxAge != 0);
+}
+
+static void PERSONALITY_batch_send(IOTHUB_HANDLE_DATA* moduleHandleData, PERSONALITY_PTR personality)
+{
+    if (personality->batchCount != 0)
+    {
+        size_t i;
+        for (i = 0; i < personality->batchCount; i++)
+        {
+            /*Codes_SRS_IOTHUBMODULE_17_045: [ To send a batch, `IotHub_Receive` shall call `IoTHubClient_SendEventAsync` for every message of the batch, in the order they were received, and then destroy them. ]*/
+            if (IoTHubClient_SendEventAsync(personality->iothubHandle, personality->batch[i], NULL, NULL) != IOTHUB_CLIENT_OK)
+            {
+                LogError("unable to IoTHubClient_SendEventAsync");
+            }
+            IoTHubMessage_Destroy(personality->batch[i]);
+        }
+        moduleHandleData->batchesSent++;
+        moduleHandleData->messagesBatched += personality->batchCount;
+        personality->batchCount = 0;
+        personality->batchBytes = 0;
+
+        if (personality->olderBatch == NULL)
+        {
+            moduleHandleData->oldestBatch = personality->newerBatch;
+        }
+        else
+        {
+            personality->olderBatch->newerBatch = personality->newerBatch;
+        }
+
+        if (personality->newerBatch == NULL)
+        {
+            moduleHandleData->newestBatch = personality->olderBatch;
+        }
+        else
+        {
+            personality->newerBatch->olderBatch = personality->olderBatch;
+        }
+    }
+}
+
+static void PERSONALITY_batch_send_expired(IOTHUB_HANDLE_DATA* moduleHandleData, time_t now)
+{
+    /*batches are chained in the order they were started, so stop at the first one that is young enough*/
+    while (
+        (moduleHandleData->oldestBatch != NULL) &&
+        (get_difftime(now, moduleHandleData->oldestBatch->batchStarted) >= (double)moduleHandleData->batchMaxAge)
+        )
+    {
+        /*Codes_SRS_IOTHUBMODULE_17_046: [ If `batchMaxAge` is not 0, `IotHub_Receive` shall send every batch whose oldest message was received `batchMaxAge` or more seconds ago. ]*/
+        PERSONALITY_batch_send(moduleHandleData, moduleHandleData->oldestBatch);
+    }
+}
+
+/*returns 0 if the batch of the personality has taken ownership of message*/
+static int PERSONALITY_batch_add(IOTHUB_HANDLE_DATA* moduleHandleData, PERSONALITY_PTR personality, IOTHUB_MESSAGE_HANDLE message, size_t size, time_t now)
+{
+    int result;
+    if (
+        (moduleHandleData->batchMaxBytes != 0) &&
+        (personality->batchCount != 0) &&
+        (personality->batchBytes + size > moduleHandleData->batchMaxBytes)
+        )
+    {
+        /*Codes_SRS_IOTHUBMODULE_17_043: [ If `batchMaxBytes` is not 0 and the message would take the batch over `batchMaxBytes` bytes of content, `IotHub_Receive` shall send the batch before adding the message. ]*/
+        PERSONALITY_batch_send(moduleHandleData, personality);
+    }
+
+    if (personality->batchCount < personality->batchCapacity)
+    {
+        result = 0;
+    }
+    else
+    {
+        size_t newCapacity = (personality->batchCapacity == 0) ? INITIAL_BATCH_CAPACITY : personality->batchCapacity * 2;
+        IOTHUB_MESSAGE_HANDLE* newBatch = realloc(personality->batch, newCapacity * sizeof(IOTHUB_MESSAGE_HANDLE));
+        if (newBatch == NULL)
+        {
+            LogError("unable to grow the batch of device %s", STRING_c_str(personality->deviceName));
+            result = __LINE__;
+        }
+        else
+        {
+            personality->batch = newBatch;
+            personality->batchCapacity = newCapacity;
+            result = 0;
+        }
+    }
+
+    if (result == 0)
+    {
+        if (personality->batchCount == 0)
+        {
+            personality->batchStarted = now;
+            personality->newerBatch = NULL;
+            personality->olderBatch = moduleHandleData->newestBatch;
+            if (moduleHandleData->newestBatch == NULL)
+            {
+                moduleHandleData->oldestBatch = personality;
+            }
+            else
+            {
+                moduleHandleData->newestBatch->newerBatch = personality;
+            }
+            moduleHandleData->newestBatch = personality;
+        }
+        personality->batch[personality->batchCount++] = message;
+        personality->batchBytes += size;
+
+        if (
+            ((moduleHandleData->batchMaxMessages != 0) && (personality->batchCount >= moduleHandleData->batchMaxMessages)) ||
+            ((moduleHandleData->batchMaxBytes != 0) && (personality->batchBytes >= moduleHandleData->batchMaxBytes))
+            )
+        {
+            /*Codes_SRS_IOTHUBMODULE_17_044: [ If the batch holds `batchMaxMessages` messages, or `batchMaxBytes` bytes of content, `IotHub_Receive` shall send it. ]*/
+            PERSONALITY_batch_send(moduleHandleData, personality);
+        }
+    }
+    return result;
+}
+
+static int IotHub_BatchThread(void* param)
+{
+    IOTHUB_HANDLE_DATA* handleData = param;
+    while (1)
+    {
+        if (Lock(handleData->lockHandle) == LOCK_OK)
+        {
+            if (handleData->stopThread)
+            {
+                (void)Unlock(handleData->lockHandle);
+                break; /*gets out of the thread*/
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBMODULE_17_051: [ Otherwise `IotHub_Start` shall start a thread that, every second, sends every batch whose oldest message was received `batchMaxAge` or more seconds ago. ]*/
+                PERSONALITY_batch_send_expired(handleData, get_time(NULL));
+                (void)Unlock(handleData->lockHandle);
+            }
+        }
+        else
+        {
+            /*shall retry*/
+        }
+        (void)ThreadAPI_Sleep(BATCH_THREAD_PERIOD_MS);
+    }
+    return 0;
+}
+
+static void IotHub_Start(MODULE_HANDLE moduleHandle)
+{
+    IOTHUB_HANDLE_DATA* handleData = moduleHandle;
+    if (handleData == NULL)
+    {
+        /*Codes_SRS_IOTHUBMODULE_17_049: [ If `moduleHandle` is `NULL` then `IotHub_Start` shall do nothing. ]*/
+        LogError("moduleHandle parameter was NULL");
+    }
+    else if (handleData->lockHandle == NULL)
+    {
+        /*Codes_SRS_IOTHUBMODULE_17_050: [ If `batchMaxAge` is 0, `IotHub_Start` shall do nothing. ]*/
+    }
+    else if (ThreadAPI_Create(&handleData->threadHandle, IotHub_BatchThread, handleData) != THREADAPI_OK)
+    {
+        /*Codes_SRS_IOTHUBMODULE_17_052: [ If creating the thread fails, `IotHub_Start` shall return, and batches shall only be sent by `IotHub_Receive` and `IotHub_Destroy`. ]*/
+        LogError("failed to spawn the batch thread");
+        handleData->threadHandle = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBMODULE_17_051: [ Otherwise `IotHub_Start` shall start a thread that, every second, sends every batch whose oldest message was received `batchMaxAge` or more seconds ago. ]*/
+    }
+}
+
+static void PERSONALITY_destroy(PERSONALITY* personality)
+{
+    /*the client's callbacks use the personality until the client is destroyed*/
+    IoTHubClient_Destroy(personality->iothubHandle);
+    if (personality->batch != NULL)
+    {
+        free(personality->batch);
+    }
+    STRING_delete(personality->deviceName);
+    STRING_delete(personality->deviceKey);
+}
+
+/*IoTHubClient_Destroy drops the events the client has not sent yet, so a client is only destroyed once it is idle*/
+static bool PERSONALITY_is_idle(PERSONALITY_PTR personality)
+{
+    bool result;
+    IOTHUB_CLIENT_STATUS status;
+    if (IoTHubClient_GetSendStatus(personality->iothubHandle, &status) != IOTHUB_CLIENT_OK)
+    {
+        LogError("unable to IoTHubClient_GetSendStatus, events of device %s may be lost", STRING_c_str(personality->deviceName));
+        result = true;
+    }
+    else
+    {
+        result = (status == IOTHUB_CLIENT_SEND_STATUS_IDLE);
+    }
+    return result;
+}
+
+/*destroys the retired personalities whose client is idle, waiting up to timeout_ms for the others and then destroying them anyway*/
+static void PERSONALITY_destroy_retired(IOTHUB_HANDLE_DATA* moduleHandleData, unsigned int timeout_ms)
+{
+    unsigned int waited = 0;
+    for (;;)
+    {
+        PERSONALITY_PTR* link = &moduleHandleData->retired;
+        while (*link != NULL)
+        {
+            PERSONALITY_PTR personality = *link;
+            if (PERSONALITY_is_idle(personality))
+            {
+                *link = personality->nextInBucket;
+                moduleHandleData->retiredCount--;
+                PERSONALITY_destroy(personality);
+                free(personality);
+            }
+            else
+            {
+                link = &personality->nextInBucket;
+            }
+        }
+
+        if ((moduleHandleData->retired == NULL) || (waited >= timeout_ms))
+        {
+            break;
+        }
+        ThreadAPI_Sleep(SEND_DRAIN_PERIOD_MS);
+        waited += SEND_DRAIN_PERIOD_MS;
+    }
+
+    if (timeout_ms != 0)
+    {
+        while (moduleHandleData->retired != NULL)
+        {
+            PERSONALITY_PTR personality = moduleHandleData->retired;
+            LogError("device %s still has events to send after %u ms, they are lost", STRING_c_str(personality->deviceName), timeout_ms);
+            moduleHandleData->retired = personality->nextInBucket;
+            moduleHandleData->retiredCount--;
+            PERSONALITY_destroy(personality);
+            free(personality);
+        }
+    }
+}
+
+/*keeps a removed personality aside until its client is idle, destroying the oldest retired personality anyway when too many are waiting*/
+static void PERSONALITY_retire(IOTHUB_HANDLE_DATA* moduleHandleData, PERSONALITY_PTR personality)
+{
+    personality->nextInBucket = moduleHandleData->retired;
+    moduleHandleData->retired = personality;
+    moduleHandleData->retiredCount++;
+    PERSONALITY_destroy_retired(moduleHandleData, 0);
+
+    if (moduleHandleData->retiredCount > RETIRED_PERSONALITIES_MAX)
+    {
+        /*Codes_SRS_IOTHUBMODULE_17_067: [ If more than 16 removed personalities are kept aside, `IotHub_Receive` shall destroy the one removed first even if its IoTHubClient still has events to send, and log that they are lost. ]*/
+        PERSONALITY_PTR* link = &moduleHandleData->retired;
+        PERSONALITY_PTR oldest;
+        while ((*link)->nextInBucket != NULL)
+        {
+            link = &(*link)->nextInBucket;
+        }
+        oldest = *link;
+        *link = NULL;
+        moduleHandleData->retiredCount--;
+        LogError("too many devices waiting to send their events, events of device %s are lost", STRING_c_str(oldest->deviceName));
+        PERSONALITY_destroy(oldest);
+        free(oldest);
+    }
+}
+
 static void IotHub_Destroy(MODULE_HANDLE moduleHandle)
 {
     /*Codes_SRS_IOTHUBMODULE_02_023: [ If `moduleHandle` is `NULL` then `IotHub_Destroy` shall return. ]*/
@@ -311,28 +708,61 @@ static void IotHub_Destroy(MODULE_HANDLE moduleHandle)
     {
         /*Codes_SRS_IOTHUBMODULE_02_024: [ Otherwise `IotHub_Destroy` shall free all used resources. ]*/
         IOTHUB_HANDLE_DATA * handleData = moduleHandle;
-        size_t vectorSize = VECTOR_size(handleData->personalities);
-        for (size_t i = 0; i < vectorSize; i++)
+        PERSONALITY_PTR personality;
+        if (handleData->lockHandle != NULL)
+        {
+            /*Codes_SRS_IOTHUBMODULE_17_053: [ `IotHub_Destroy` shall stop the thread started by `IotHub_Start`, if any, and then destroy the lock. ]*/
+            int notUsed;
+            if (Lock(handleData->lockHandle) != LOCK_OK)
+            {
+                LogError("not able to Lock, still setting the thread to finish");
+                handleData->stopThread = 1;
+            }
+            else
+            {
+                handleData->stopThread = 1;
+                (void)Unlock(handleData->lockHandle);
+            }
+
+            if (
+                (handleData->threadHandle != NULL) &&
+                (ThreadAPI_Join(handleData->threadHandle, &notUsed) != THREADAPI_OK)
+                )
+            {
+                LogError("unable to ThreadAPI_Join, still proceeding in _Destroy");
+            }
+            (void)Lock_Deinit(handleData->lockHandle);
+        }
+
+        personality = handleData->mostRecentlyUsed;
+        while (personality != NULL)
         {
-            PERSONALITY_PTR* personality = VECTOR_element(handleData->personalities, i);
-            STRING_delete((*personality)->deviceKey);
-            STRING_delete((*personality)->deviceName);
-            IoTHubClient_Destroy((*personality)->iothubHandle);
-            free(*personality);
+            PERSONALITY_PTR next = personality->lessRecentlyUsed;
+            /*Codes_SRS_IOTHUBMODULE_17_054: [ `IotHub_Destroy` shall send the batch of every personality before destroying the personality. ]*/
+            PERSONALITY_batch_send(handleData, personality);
+            personality->nextInBucket = handleData->retired;
+            handleData->retired = personality;
+            handleData->retiredCount++;
+            personality = next;
+        }
+        /*Codes_SRS_IOTHUBMODULE_17_060: [ `IotHub_Destroy` shall wait up to 10 seconds for the IoTHubClient of every personality to have no events left to send, and then destroy the personalities. ]*/
+        PERSONALITY_destroy_retired(handleData, SEND_DRAIN_TIMEOUT_MS);
+        /*Codes_SRS_IOTHUBMODULE_17_037: [ `IotHub_Destroy` shall log how many personality lookups hit, missed, and how many personalities were evicted and expired. ]*/
+        LogInfo("personality lookups: %zu hits, %zu misses; personalities evicted: %zu, expired: %zu",
+            handleData->personalityHits, handleData->personalityMisses, handleData->personalityEvictions, handleData->personalityExpirations);
+        if (IotHub_IsBatching(handleData))
+        {
+            /*Codes_SRS_IOTHUBMODULE_17_055: [ If batching is enabled, `IotHub_Destroy` shall log how many batches were sent and how many messages they held. ]*/
+            LogInfo("batches sent: %zu, holding %zu messages", handleData->batchesSent, handleData->messagesBatched);
         }
         IoTHubTransport_Destroy(handleData->transportHandle);
-        VECTOR_destroy(handleData->personalities);
+        free(handleData->buckets);
         STRING_delete(handleData->IoTHubName);
         STRING_delete(handleData->IoTHubSuffix);
         free(handleData);
     }
 }
 
-static bool lookup_DeviceName(const void* element, const void* value)
-{
-    return (strcmp(STRING_c_str((*(PERSONALITY_PTR*)element)->deviceName), value) == 0);
-}
-
 static IOTHUBMESSAGE_DISPOSITION_RESULT IotHub_ReceiveMessageCallback(IOTHUB_MESSAGE_HANDLE msg, void* userContextCallback)
 {
     IOTHUBMESSAGE_DISPOSITION_RESULT result;
@@ -508,6 +938,23 @@ static PERSONALITY_PTR PERSONALITY_create(const char* deviceName, const char* de
                     /*it is all fine*/
                     result->broker = moduleHandleData->broker;
                     result->module = moduleHandleData;
+                    result->batch = NULL;
+                    result->batchCount = 0;
+                    result->batchCapacity = 0;
+                    result->batchBytes = 0;
+
+                    if (
+                        IotHub_IsBatching(moduleHandleData) &&
+                        (moduleHandleData->transportProvider == HTTP_Protocol)
+                        )
+                    {
+                        /*Codes_SRS_IOTHUBMODULE_17_056: [ If batching is enabled and the transport is HTTP, a new personality shall set the option "Batching" of its IoTHubClient to `true`, so that a batch can be sent in a single request. ]*/
+                        bool batching = true;
+                        if (IoTHubClient_SetOption(result->iothubHandle, "Batching", &batching) != IOTHUB_CLIENT_OK)
+                        {
+                            LogError("unable to turn on HTTP batching, messages of device %s will be sent one request at a time", deviceName);
+                        }
+                    }
                 }
             }
         }
@@ -515,47 +962,189 @@ static PERSONALITY_PTR PERSONALITY_create(const char* deviceName, const char* de
     return result;
 }
 
-static void PERSONALITY_destroy(PERSONALITY* personality)
+/*FNV-1a*/
+static size_t hash_DeviceName(const char* deviceName)
 {
-    STRING_delete(personality->deviceName);
-    STRING_delete(personality->deviceKey);
-    IoTHubClient_Destroy(personality->iothubHandle);
+    size_t result = 2166136261u;
+    while (*deviceName != '\0')
+    {
+        result ^= (unsigned char)*deviceName++;
+        result *= 16777619u;
+    }
+    return result;
 }
 
-static PERSONALITY* PERSONALITY_find_or_create(IOTHUB_HANDLE_DATA* moduleHandleData, const char* deviceName, const char* deviceKey)
+static void PERSONALITY_unlink(IOTHUB_HANDLE_DATA* moduleHandleData, PERSONALITY_PTR personality)
+{
+    if (personality->moreRecentlyUsed == NULL)
+    {
+        moduleHandleData->mostRecentlyUsed = personality->lessRecentlyUsed;
+    }
+    else
+    {
+        personality->moreRecentlyUsed->lessRecentlyUsed = personality->lessRecentlyUsed;
+    }
+
+    if (personality->lessRecentlyUsed == NULL)
+    {
+        moduleHandleData->leastRecentlyUsed = personality->moreRecentlyUsed;
+    }
+    else
+    {
+        personality->lessRecentlyUsed->moreRecentlyUsed = personality->moreRecentlyUsed;
+    }
+}
+
+static void PERSONALITY_link_as_most_recently_used(IOTHUB_HANDLE_DATA* moduleHandleData, PERSONALITY_PTR personality)
+{
+    personality->moreRecentlyUsed = NULL;
+    personality->lessRecentlyUsed = moduleHandleData->mostRecentlyUsed;
+    if (moduleHandleData->mostRecentlyUsed == NULL)
+    {
+        moduleHandleData->leastRecentlyUsed = personality;
+    }
+    else
+    {
+        moduleHandleData->mostRecentlyUsed->moreRecentlyUsed = personality;
+    }
+    moduleHandleData->mostRecentlyUsed = personality;
+}
+
+static void PERSONALITY_remove(IOTHUB_HANDLE_DATA* moduleHandleData, PERSONALITY_PTR personality)
+{
+    PERSONALITY_PTR* link = &moduleHandleData->buckets[personality->hash & (moduleHandleData->bucketCount - 1)];
+    while (*link != personality)
+    {
+        link = &(*link)->nextInBucket;
+    }
+    *link = personality->nextInBucket;
+    PERSONALITY_unlink(moduleHandleData, personality);
+    /*Codes_SRS_IOTHUBMODULE_17_048: [ Before destroying a personality, `IotHub_Receive` shall send its batch. ]*/
+    PERSONALITY_batch_send(moduleHandleData, personality);
+    moduleHandleData->personalityCount--;
+
+    /*Codes_SRS_IOTHUBMODULE_17_058: [ `IotHub_Receive` shall destroy a removed personality only once `IoTHubClient_GetSendStatus` reports its IoTHubClient has no events left to send, and keep it aside until then. ]*/
+    PERSONALITY_retire(moduleHandleData, personality);
+}
+
+static void PERSONALITY_table_grow(IOTHUB_HANDLE_DATA* moduleHandleData)
+{
+    size_t newBucketCount = moduleHandleData->bucketCount * 2;
+    PERSONALITY_PTR* newBuckets = malloc(newBucketCount * sizeof(PERSONALITY_PTR));
+    if (newBuckets == NULL)
+    {
+        /*Codes_SRS_IOTHUBMODULE_17_036: [ If growing the personality table fails, `IotHub_Receive` shall keep using the current table. ]*/
+        LogError("unable to grow the personality table, lookups will get slower");
+    }
+    else
+    {
+        size_t i;
+        for (i = 0; i < newBucketCount; i++)
+        {
+            newBuckets[i] = NULL;
+        }
+        for (i = 0; i < moduleHandleData->bucketCount; i++)
+        {
+            PERSONALITY_PTR personality = moduleHandleData->buckets[i];
+            while (personality != NULL)
+            {
+                PERSONALITY_PTR next = personality->nextInBucket;
+                size_t index = personality->hash & (newBucketCount - 1);
+                personality->nextInBucket = newBuckets[index];
+                newBuckets[index] = personality;
+                personality = next;
+            }
+        }
+        free(moduleHandleData->buckets);
+        moduleHandleData->buckets = newBuckets;
+        moduleHandleData->bucketCount = newBucketCount;
+    }
+}
+
+static void PERSONALITY_expire_idle(IOTHUB_HANDLE_DATA* moduleHandleData, time_t now)
+{
+    /*the least recently used personality has been idle the longest, so stop at the first one that is still in use*/
+    while (
+        (moduleHandleData->leastRecentlyUsed != NULL) &&
+        (get_difftime(now, moduleHandleData->leastRecentlyUsed->lastUsed) > (double)moduleHandleData->deviceIdleTimeout)
+        )
+    {
+        /*Codes_SRS_IOTHUBMODULE_17_030: [ If `deviceIdleTimeout` is not 0, `IotHub_Receive` shall destroy every personality that has not sent a message for more than `deviceIdleTimeout` seconds. ]*/
+        PERSONALITY_remove(moduleHandleData, moduleHandleData->leastRecentlyUsed);
+        moduleHandleData->personalityExpirations++;
+    }
+}
+
+static PERSONALITY* PERSONALITY_find_or_create(IOTHUB_HANDLE_DATA* moduleHandleData, const char* deviceName, const char* deviceKey, time_t now)
 {
-    /*Codes_SRS_IOTHUBMODULE_02_017: [ Otherwise `IotHub_Receive` shall not create a new personality. ]*/
     PERSONALITY* result;
-    PERSONALITY_PTR* resultPtr = VECTOR_find_if(moduleHandleData->personalities, lookup_DeviceName, deviceName);
-    if (resultPtr == NULL)
+    size_t hash = hash_DeviceName(deviceName);
+
+    if (moduleHandleData->retired != NULL)
+    {
+        /*Codes_SRS_IOTHUBMODULE_17_059: [ `IotHub_Receive` shall destroy every removed personality whose IoTHubClient has no events left to send. ]*/
+        PERSONALITY_destroy_retired(moduleHandleData, 0);
+    }
+
+    if (moduleHandleData->deviceIdleTimeout != 0)
+    {
+        PERSONALITY_expire_idle(moduleHandleData, now);
+    }
+
+    /*Codes_SRS_IOTHUBMODULE_17_031: [ `IotHub_Receive` shall find the personality by hashing the device ID, and compare device IDs only for personalities with the same hash. ]*/
+    result = moduleHandleData->buckets[hash & (moduleHandleData->bucketCount - 1)];
+    while (
+        (result != NULL) &&
+        ((result->hash != hash) || (strcmp(STRING_c_str(result->deviceName), deviceName) != 0))
+        )
+    {
+        result = result->nextInBucket;
+    }
+
+    if (result != NULL)
+    {
+        /*Codes_SRS_IOTHUBMODULE_02_017: [ Otherwise `IotHub_Receive` shall not create a new personality. ]*/
+        /*Codes_SRS_IOTHUBMODULE_17_032: [ A personality that is found shall become the most recently used personality. ]*/
+        PERSONALITY_unlink(moduleHandleData, result);
+        PERSONALITY_link_as_most_recently_used(moduleHandleData, result);
+        result->lastUsed = now;
+        /*Codes_SRS_IOTHUBMODULE_17_034: [ `IotHub_Receive` shall count how many personality lookups hit and missed, and how many personalities were evicted and expired. ]*/
+        moduleHandleData->personalityHits++;
+    }
+    else
     {
         /*a new device has arrived!*/
-        PERSONALITY_PTR personality;
-        if ((personality = PERSONALITY_create(deviceName, deviceKey, moduleHandleData)) == NULL)
+        moduleHandleData->personalityMisses++;
+        if (
+            (moduleHandleData->maxDevices != 0) &&
+            (moduleHandleData->personalityCount >= moduleHandleData->maxDevices)
+            )
+        {
+            /*Codes_SRS_IOTHUBMODULE_17_033: [ If `maxDevices` is not 0 and there are already `maxDevices` personalities, `IotHub_Receive` shall destroy the least recently used personality before creating a new one. ]*/
+            PERSONALITY_remove(moduleHandleData, moduleHandleData->leastRecentlyUsed);
+            moduleHandleData->personalityEvictions++;
+        }
+
+        if ((result = PERSONALITY_create(deviceName, deviceKey, moduleHandleData)) == NULL)
         {
             LogError("unable to create a personality for the device %s", deviceName);
-            result = NULL;
         }
         else
         {
-            if ((VECTOR_push_back(moduleHandleData->personalities, &personality, 1)) != 0)
-            {
-                /*Codes_SRS_IOTHUBMODULE_02_016: [ If adding a new personality to the vector fails, then `IoTHub_Receive` shall return. ]*/
-                LogError("VECTOR_push_back failed");
-                PERSONALITY_destroy(personality);
-                free(personality);
-                result = NULL;
-            }
-            else
+            size_t index = hash & (moduleHandleData->bucketCount - 1);
+            result->hash = hash;
+            result->nextInBucket = moduleHandleData->buckets[index];
+            moduleHandleData->buckets[index] = result;
+            PERSONALITY_link_as_most_recently_used(moduleHandleData, result);
+            result->lastUsed = now;
+            moduleHandleData->personalityCount++;
+
+            if (moduleHandleData->personalityCount > moduleHandleData->bucketCount)
             {
-                resultPtr = VECTOR_back(moduleHandleData->personalities);
-                result = *resultPtr;
-            }
+                /*Codes_SRS_IOTHUBMODULE_17_035: [ If there are more personalities than buckets in the personality table, `IotHub_Receive` shall double the number of buckets. ]*/
+                PERSONALITY_table_grow(moduleHandleData);
             }
         }
-    else
-    {
-        result = *resultPtr;
     }
     return result;
 }
@@ -622,6 +1211,104 @@ static IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromGWMessage(MESSAGE_HANDLE me
     return result;
 }
 
+static time_t IotHub_GetNow(IOTHUB_HANDLE_DATA* moduleHandleData)
+{
+    /*the clock is only needed for idle personalities and aging batches*/
+    return ((moduleHandleData->deviceIdleTimeout != 0) || (moduleHandleData->batchMaxAge != 0))
+        ? get_time(NULL)
+        : (time_t)0;
+}
+
+static void IotHub_SendOnBehalfOfDevice(IOTHUB_HANDLE_DATA* moduleHandleData, MESSAGE_HANDLE messageHandle, const char* deviceName, const char* deviceKey, time_t now)
+{
+    /*Codes_SRS_IOTHUBMODULE_02_013: [ If no personality exists with a device ID equal to the value of the `deviceName` property of the message, then `IotHub_Receive` shall create a new `PERSONALITY` with the ID and key values from the message. ]*/
+    PERSONALITY* whereIsIt = PERSONALITY_find_or_create(moduleHandleData, deviceName, deviceKey, now);
+    if (whereIsIt == NULL)
+    {
+        /*Codes_SRS_IOTHUBMODULE_02_014: [ If creating the personality fails then `IotHub_Receive` shall return. ]*/
+        /*do nothing, device was not added to the GW*/
+        LogError("unable to PERSONALITY_find_or_create");
+    }
+    else
+    {
+        IOTHUB_MESSAGE_HANDLE iotHubMessage = IoTHubMessage_CreateFromGWMessage(messageHandle);
+        if(iotHubMessage == NULL)
+        {
+            LogError("unable to IoTHubMessage_CreateFromGWMessage (internal)");
+        }
+        else if (!IotHub_IsBatching(moduleHandleData))
+        {
+            /*Codes_SRS_IOTHUBMODULE_02_020: [ `IotHub_Receive` shall call IoTHubClient_SendEventAsync passing the IOTHUB_MESSAGE_HANDLE. ]*/
+            if (IoTHubClient_SendEventAsync(whereIsIt->iothubHandle, iotHubMessage, NULL, NULL) != IOTHUB_CLIENT_OK)
+            {
+                /*Codes_SRS_IOTHUBMODULE_02_021: [ If `IoTHubClient_SendEventAsync` fails then `IotHub_Receive` shall return. ]*/
+                LogError("unable to IoTHubClient_SendEventAsync");
+            }
+            else
+            {
+                /*all is fine, message has been accepted for delivery*/
+            }
+            IoTHubMessage_Destroy(iotHubMessage);
+        }
+        /*Codes_SRS_IOTHUBMODULE_17_042: [ If `batchMaxMessages`, `batchMaxBytes` or `batchMaxAge` is not 0, `IotHub_Receive` shall add the IOTHUB_MESSAGE_HANDLE to the batch of the personality instead of sending it. ]*/
+        else if (PERSONALITY_batch_add(moduleHandleData, whereIsIt, iotHubMessage, Message_GetContent(messageHandle)->size, now) != 0)
+        {
+            /*Codes_SRS_IOTHUBMODULE_17_057: [ If adding the message to the batch fails, `IotHub_Receive` shall send the batch, and then the message on its own. ]*/
+            PERSONALITY_batch_send(moduleHandleData, whereIsIt);
+            if (IoTHubClient_SendEventAsync(whereIsIt->iothubHandle, iotHubMessage, NULL, NULL) != IOTHUB_CLIENT_OK)
+            {
+                LogError("unable to IoTHubClient_SendEventAsync");
+            }
+            IoTHubMessage_Destroy(iotHubMessage);
+        }
+        else
+        {
+            /*the batch owns the message now*/
+        }
+    }
+}
+
+static void IotHub_SendExpiredBatches(IOTHUB_HANDLE_DATA* moduleHandleData, time_t now)
+{
+    if (moduleHandleData->batchMaxAge != 0)
+    {
+        PERSONALITY_batch_send_expired(moduleHandleData, now);
+    }
+}
+
+static int IotHub_GetDeviceCredentials(CONSTMAP_HANDLE properties, const char** deviceName, const char** deviceKey)
+{
+    int result;
+    const char* source = ConstMap_GetValue(properties, SOURCE); /*properties is !=NULL by contract of Message*/
+
+    /*Codes_SRS_IOTHUBMODULE_02_010: [ If message properties do not contain a property called "source" having the value set to "mapping" then `IotHub_Receive` shall do nothing. ]*/
+    if (
+        (source == NULL) ||
+        (strcmp(source, MAPPING)!=0)
+        )
+    {
+        /*do nothing, the properties do not contain either "source" or "source":"mapping"*/
+        result = __LINE__;
+    }
+    /*Codes_SRS_IOTHUBMODULE_02_011: [ If message properties do not contain a property called "deviceName" having a non-`NULL` value then `IotHub_Receive` shall do nothing. ]*/
+    else if ((*deviceName = ConstMap_GetValue(properties, DEVICENAME)) == NULL)
+    {
+        /*do nothing, not a message for this module*/
+        result = __LINE__;
+    }
+    /*Codes_SRS_IOTHUBMODULE_02_012: [ If message properties do not contain a property called "deviceKey" having a non-`NULL` value then `IotHub_Receive` shall do nothing. ]*/
+    else if ((*deviceKey = ConstMap_GetValue(properties, DEVICEKEY)) == NULL)
+    {
+        /*do nothing, missing device key*/
+        result = __LINE__;
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
 static void IotHub_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHandle)
 {
     /*Codes_SRS_IOTHUBMODULE_02_009: [ If `moduleHandle` or `messageHandle` is `NULL` then `IotHub_Receive` shall do nothing. ]*/
@@ -636,72 +1323,89 @@ static void IotHub_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHan
     else
     {
         CONSTMAP_HANDLE properties = Message_GetProperties(messageHandle);
-        const char* source = ConstMap_GetValue(properties, SOURCE); /*properties is !=NULL by contract of Message*/
-
-        /*Codes_SRS_IOTHUBMODULE_02_010: [ If message properties do not contain a property called "source" having the value set to "mapping" then `IotHub_Receive` shall do nothing. ]*/
-        if (
-            (source == NULL) ||
-            (strcmp(source, MAPPING)!=0)
-            )
+        const char* deviceName;
+        const char* deviceKey;
+        if (IotHub_GetDeviceCredentials(properties, &deviceName, &deviceKey) != 0)
         {
-            /*do nothing, the properties do not contain either "source" or "source":"mapping"*/
+            /*do nothing, not a message for this module*/
         }
         else
         {
-            /*Codes_SRS_IOTHUBMODULE_02_011: [ If message properties do not contain a property called "deviceName" having a non-`NULL` value then `IotHub_Receive` shall do nothing. ]*/
-            const char* deviceName = ConstMap_GetValue(properties, DEVICENAME);
-            if (deviceName == NULL)
+            IOTHUB_HANDLE_DATA* moduleHandleData = moduleHandle;
+            if (
+                (moduleHandleData->lockHandle != NULL) &&
+                (Lock(moduleHandleData->lockHandle) != LOCK_OK)
+                )
             {
-                /*do nothing, not a message for this module*/
+                /*Codes_SRS_IOTHUBMODULE_17_047: [ If the module has a lock, `IotHub_Receive` shall hold it while it uses the personalities, and shall return if `Lock` fails. ]*/
+                LogError("unable to Lock");
             }
             else
             {
-                /*Codes_SRS_IOTHUBMODULE_02_012: [ If message properties do not contain a property called "deviceKey" having a non-`NULL` value then `IotHub_Receive` shall do nothing. ]*/
-                const char* deviceKey = ConstMap_GetValue(properties, DEVICEKEY);
-                if (deviceKey == NULL)
+                time_t now = IotHub_GetNow(moduleHandleData);
+                IotHub_SendOnBehalfOfDevice(moduleHandleData, messageHandle, deviceName, deviceKey, now);
+                IotHub_SendExpiredBatches(moduleHandleData, now);
+                if (moduleHandleData->lockHandle != NULL)
                 {
-                    /*do nothing, missing device key*/
+                    (void)Unlock(moduleHandleData->lockHandle);
                 }
-                else
-                {
-                    IOTHUB_HANDLE_DATA* moduleHandleData = moduleHandle;
-                    /*Codes_SRS_IOTHUBMODULE_02_013: [ If no personality exists with a device ID equal to the value of the `deviceName` property of the message, then `IotHub_Receive` shall create a new `PERSONALITY` with the ID and key values from the message. ]*/
+            }
+        }
+        ConstMap_Destroy(properties);
+    }
+    /*Codes_SRS_IOTHUBMODULE_02_022: [ If `IoTHubClient_SendEventAsync` succeeds then `IotHub_Receive` shall return. ]*/
+}
 
-                    PERSONALITY* whereIsIt = PERSONALITY_find_or_create(moduleHandleData, deviceName, deviceKey);
-                    if (whereIsIt == NULL)
-                    {
-                        /*Codes_SRS_IOTHUBMODULE_02_014: [ If creating the personality fails then `IotHub_Receive` shall return. ]*/
-                        /*do nothing, device was not added to the GW*/
-                        LogError("unable to PERSONALITY_find_or_create");
-                    }
-                    else
+static void IotHub_ReceiveBatch(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE* messageHandles, size_t count)
+{
+    /*Codes_SRS_IOTHUBMODULE_17_061: [ If `moduleHandle` or `messageHandles` is `NULL` then `IotHub_ReceiveBatch` shall do nothing. ]*/
+    if (
+        (moduleHandle == NULL) ||
+        (messageHandles == NULL)
+        )
+    {
+        LogError("invalid arg moduleHandle=%p, messageHandles=%p", moduleHandle, messageHandles);
+    }
+    else
+    {
+        IOTHUB_HANDLE_DATA* moduleHandleData = moduleHandle;
+        if (
+            (moduleHandleData->lockHandle != NULL) &&
+            (Lock(moduleHandleData->lockHandle) != LOCK_OK)
+            )
+        {
+            /*Codes_SRS_IOTHUBMODULE_17_062: [ If the module has a lock, `IotHub_ReceiveBatch` shall hold it once for the whole batch, and shall return if `Lock` fails. ]*/
+            LogError("unable to Lock");
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBMODULE_17_063: [ `IotHub_ReceiveBatch` shall read the time once for the whole batch. ]*/
+            time_t now = IotHub_GetNow(moduleHandleData);
+            size_t i;
+            for (i = 0; i < count; i++)
+            {
+                /*Codes_SRS_IOTHUBMODULE_17_064: [ `IotHub_ReceiveBatch` shall skip `NULL` entries of `messageHandles`, and handle every other message the way `IotHub_Receive` does. ]*/
+                if (messageHandles[i] != NULL)
+                {
+                    CONSTMAP_HANDLE properties = Message_GetProperties(messageHandles[i]);
+                    const char* deviceName;
+                    const char* deviceKey;
+                    if (IotHub_GetDeviceCredentials(properties, &deviceName, &deviceKey) == 0)
                     {
-                        IOTHUB_MESSAGE_HANDLE iotHubMessage = IoTHubMessage_CreateFromGWMessage(messageHandle);
-                        if(iotHubMessage == NULL)
-                        {
-                            LogError("unable to IoTHubMessage_CreateFromGWMessage (internal)");
-                        }
-                        else
-                        {
-                            /*Codes_SRS_IOTHUBMODULE_02_020: [ `IotHub_Receive` shall call IoTHubClient_SendEventAsync passing the IOTHUB_MESSAGE_HANDLE. ]*/
-                            if (IoTHubClient_SendEventAsync(whereIsIt->iothubHandle, iotHubMessage, NULL, NULL) != IOTHUB_CLIENT_OK)
-                            {
-                                /*Codes_SRS_IOTHUBMODULE_02_021: [ If `IoTHubClient_SendEventAsync` fails then `IotHub_Receive` shall return. ]*/
-                                LogError("unable to IoTHubClient_SendEventAsync");
-                            }
-                            else
-                            {
-                                /*all is fine, message has been accepted for delivery*/
-                            }
-                            IoTHubMessage_Destroy(iotHubMessage);
-                        }
+                        IotHub_SendOnBehalfOfDevice(moduleHandleData, messageHandles[i], deviceName, deviceKey, now);
                     }
+                    ConstMap_Destroy(properties);
                 }
             }
+
+            /*Codes_SRS_IOTHUBMODULE_17_065: [ If `batchMaxAge` is not 0, `IotHub_ReceiveBatch` shall send the expired batches once, after the last message. ]*/
+            IotHub_SendExpiredBatches(moduleHandleData, now);
+            if (moduleHandleData->lockHandle != NULL)
+            {
+                (void)Unlock(moduleHandleData->lockHandle);
+            }
         }
-        ConstMap_Destroy(properties);
     }
-    /*Codes_SRS_IOTHUBMODULE_02_022: [ If `IoTHubClient_SendEventAsync` succeeds then `IotHub_Receive` shall return. ]*/
 }
 
 static const MODULE_API_1 moduleInterface =
@@ -713,7 +1417,22 @@ static const MODULE_API_1 moduleInterface =
     IotHub_Create,
     IotHub_Destroy,
     IotHub_Receive,
-    NULL
+    IotHub_Start
+};
+
+static const MODULE_API_2 moduleInterface_2 =
+{
+    {
+        {MODULE_API_VERSION_2},
+
+        IotHub_ParseConfigurationFromJson,
+        IotHub_FreeConfiguration,
+        IotHub_Create,
+        IotHub_Destroy,
+        IotHub_Receive,
+        IotHub_Start
+    },
+    IotHub_ReceiveBatch
 };
 
 /*Codes_SRS_IOTHUBMODULE_26_001: [ `Module_GetApi` shall return a pointer to a `MODULE_API` structure with the required function pointers. ]*/
@@ -723,6 +1442,15 @@ MODULE_EXPORT const MODULE_API* MODULE_STATIC_GETAPI(IOTHUB_MODULE)(MODULE_API_V
 MODULE_EXPORT const MODULE_API* Module_GetApi(MODULE_API_VERSION gateway_api_version)
 #endif
 {
-    (void)gateway_api_version;
-    return (const MODULE_API *)&moduleInterface;
+    const MODULE_API* result;
+    if (gateway_api_version >= MODULE_API_VERSION_2)
+    {
+        /*Codes_SRS_IOTHUBMODULE_17_066: [ `Module_GetApi` shall return the `MODULE_API_2` table, which adds `IotHub_ReceiveBatch`, if `gateway_api_version` is `MODULE_API_VERSION_2` or later, and the `MODULE_API_1` table otherwise. ]*/
+        result = (const MODULE_API *)&moduleInterface_2;
+    }
+    else
+    {
+        result = (const MODULE_API *)&moduleInterface;
+    }
+    return result;
 }
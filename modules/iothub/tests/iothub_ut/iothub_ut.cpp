@@ -10,9 +10,9 @@
 #include "module.h"
 #include "module_access.h"
 #include "azure_c_shared_utility/lock.h"
-#include "azure_c_shared_utility/vector.h"
-#include "azure_c_shared_utility/vector_types_internal.h"
+#include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/agenttime.h"
 #include "iothubtransport.h"
 #include "iothub_message.h"
 #include "broker.h"
@@ -41,7 +41,6 @@ namespace BASEIMPLEMENTATION
 #undef Lock_Init
 #undef Lock_Deinit
 
-#include "vector.c"
 #include "strings.c"
 };
 
@@ -56,9 +55,6 @@ DEFINE_MICROMOCK_ENUM_TO_STRING(IOTHUBMESSAGE_DISPOSITION_RESULT, IOTHUBMESSAGE_
 static MICROMOCK_MUTEX_HANDLE g_testByTest;
 static MICROMOCK_GLOBAL_SEMAPHORE_HANDLE g_dllByDll;
 
-static size_t currentVECTOR_push_back_call;
-static size_t whenShallVECTOR_push_back_fail;
-
 /*different STRING constructors*/
 static size_t currentSTRING_construct_call;
 static size_t whenShallSTRING_construct_fail;
@@ -74,6 +70,10 @@ static void * IotHub_Receive_message_userContext;
 static const char * IotHub_Receive_message_content;
 static size_t IotHub_Receive_message_size;
 
+static time_t currentTime;
+
+static IOTHUB_CLIENT_STATUS currentSendStatus;
+
 typedef struct PERSONALITY_TAG
 {
     STRING_HANDLE deviceName;
@@ -81,13 +81,47 @@ typedef struct PERSONALITY_TAG
     IOTHUB_CLIENT_HANDLE iothubHandle;
     BROKER_HANDLE broker;
     MODULE_HANDLE module;
+    size_t hash; /*hash of deviceName*/
+    struct PERSONALITY_TAG* nextInBucket;
+    struct PERSONALITY_TAG* moreRecentlyUsed;
+    struct PERSONALITY_TAG* lessRecentlyUsed;
+    time_t lastUsed;
+    IOTHUB_MESSAGE_HANDLE* batch; /*messages waiting to be sent together*/
+    size_t batchCount;
+    size_t batchCapacity;
+    size_t batchBytes;
+    time_t batchStarted; /*when the oldest message of the batch was received*/
+    struct PERSONALITY_TAG* newerBatch;
+    struct PERSONALITY_TAG* olderBatch;
 }PERSONALITY;
 
 typedef PERSONALITY* PERSONALITY_PTR;
 
 typedef struct IOTHUB_HANDLE_DATA_TAG
 {
-    VECTOR_HANDLE personalities; /*holds PERSONALITYs*/
+    PERSONALITY_PTR* buckets; /*holds PERSONALITYs, chained by nextInBucket*/
+    size_t bucketCount; /*always a power of 2*/
+    size_t personalityCount;
+    PERSONALITY_PTR mostRecentlyUsed;
+    PERSONALITY_PTR leastRecentlyUsed;
+    size_t maxDevices;
+    size_t deviceIdleTimeout;
+    size_t personalityHits;
+    size_t personalityMisses;
+    size_t personalityEvictions;
+    size_t personalityExpirations;
+    size_t batchMaxMessages;
+    size_t batchMaxBytes;
+    size_t batchMaxAge;
+    PERSONALITY_PTR oldestBatch; /*personalities holding a batch, chained by newerBatch*/
+    PERSONALITY_PTR newestBatch;
+    PERSONALITY_PTR retired; /*removed personalities whose client still has events to send, chained by nextInBucket*/
+    size_t retiredCount;
+    size_t batchesSent;
+    size_t messagesBatched;
+    LOCK_HANDLE lockHandle; /*only exists when batches can expire, guards the personalities against the flush thread*/
+    THREAD_HANDLE threadHandle;
+    int stopThread;
     STRING_HANDLE IoTHubName;
     STRING_HANDLE IoTHubSuffix;
     IOTHUB_CLIENT_TRANSPORT_PROVIDER transportProvider;
@@ -151,6 +185,8 @@ static pfModule_FreeConfiguration Module_FreeConfiguration = NULL; /*gets assign
 static pfModule_Create Module_Create = NULL; /*gets assigned in TEST_SUITE_INITIALIZE*/
 static pfModule_Destroy Module_Destroy = NULL; /*gets assigned in TEST_SUITE_INITIALIZE*/
 static pfModule_Receive Module_Receive = NULL; /*gets assigned in TEST_SUITE_INITIALIZE*/
+static pfModule_Start Module_Start = NULL; /*gets assigned in TEST_SUITE_INITIALIZE*/
+static pfModule_ReceiveBatch Module_ReceiveBatch = NULL; /*gets assigned in TEST_SUITE_INITIALIZE*/
 
 const char name[] = "name";
 const char suffix[] = "suffix";
@@ -162,11 +198,28 @@ IOTHUB_CONFIG CreateConfigWithTransport(IOTHUB_CLIENT_TRANSPORT_PROVIDER transpo
     strcpy(name_, name);
     strcpy(suffix_, suffix);
 
-    return IOTHUB_CONFIG { name_, suffix_, transport };
+    return IOTHUB_CONFIG { name_, suffix_, transport, 0, 0, 0, 0, 0 };
 }
 
 IOTHUB_CONFIG CreateConfig() { return CreateConfigWithTransport(HTTP_Protocol); }
 
+IOTHUB_CONFIG CreateConfigWithLimits(size_t maxDevices, size_t deviceIdleTimeout)
+{
+    IOTHUB_CONFIG result = CreateConfig();
+    result.maxDevices = maxDevices;
+    result.deviceIdleTimeout = deviceIdleTimeout;
+    return result;
+}
+
+IOTHUB_CONFIG CreateConfigWithBatchLimits(size_t batchMaxMessages, size_t batchMaxBytes, size_t batchMaxAge)
+{
+    IOTHUB_CONFIG result = CreateConfig();
+    result.batchMaxMessages = batchMaxMessages;
+    result.batchMaxBytes = batchMaxBytes;
+    result.batchMaxAge = batchMaxAge;
+    return result;
+}
+
 class AutoConfig
 {
     IOTHUB_CONFIG config_;
@@ -180,6 +233,14 @@ public:
         config_(CreateConfigWithTransport(transport))
     {}
 
+    AutoConfig(size_t maxDevices, size_t deviceIdleTimeout) :
+        config_(CreateConfigWithLimits(maxDevices, deviceIdleTimeout))
+    {}
+
+    AutoConfig(size_t batchMaxMessages, size_t batchMaxBytes, size_t batchMaxAge) :
+        config_(CreateConfigWithBatchLimits(batchMaxMessages, batchMaxBytes, batchMaxAge))
+    {}
+
     ~AutoConfig()
     {
         free((void*)config_.IoTHubName);
@@ -203,6 +264,33 @@ public:
         BASEIMPLEMENTATION::gballoc_free(ptr);
     MOCK_VOID_METHOD_END()
 
+    MOCK_STATIC_METHOD_2(, void*, gballoc_realloc, void*, ptr, size_t, size)
+        void* result2 = BASEIMPLEMENTATION::gballoc_realloc(ptr, size);
+    MOCK_METHOD_END(void*, result2);
+
+    // lock and thread
+    MOCK_STATIC_METHOD_0(, LOCK_HANDLE, Lock_Init)
+    MOCK_METHOD_END(LOCK_HANDLE, (LOCK_HANDLE)0x42)
+
+    MOCK_STATIC_METHOD_1(, LOCK_RESULT, Lock, LOCK_HANDLE, handle)
+    MOCK_METHOD_END(LOCK_RESULT, LOCK_OK)
+
+    MOCK_STATIC_METHOD_1(, LOCK_RESULT, Unlock, LOCK_HANDLE, handle)
+    MOCK_METHOD_END(LOCK_RESULT, LOCK_OK)
+
+    MOCK_STATIC_METHOD_1(, LOCK_RESULT, Lock_Deinit, LOCK_HANDLE, handle)
+    MOCK_METHOD_END(LOCK_RESULT, LOCK_OK)
+
+    MOCK_STATIC_METHOD_3(, THREADAPI_RESULT, ThreadAPI_Create, THREAD_HANDLE*, threadHandle, THREAD_START_FUNC, func, void*, arg)
+        *threadHandle = (THREAD_HANDLE)0x43;
+    MOCK_METHOD_END(THREADAPI_RESULT, THREADAPI_OK)
+
+    MOCK_STATIC_METHOD_2(, THREADAPI_RESULT, ThreadAPI_Join, THREAD_HANDLE, threadHandle, int*, res)
+    MOCK_METHOD_END(THREADAPI_RESULT, THREADAPI_OK)
+
+    MOCK_STATIC_METHOD_1(, void, ThreadAPI_Sleep, unsigned int, milliseconds)
+    MOCK_VOID_METHOD_END()
+
     // ConstMap mocks
     MOCK_STATIC_METHOD_1(, CONSTMAP_HANDLE, ConstMap_Clone, CONSTMAP_HANDLE, handle)
     MOCK_METHOD_END(CONSTMAP_HANDLE, handle)
@@ -229,39 +317,6 @@ public:
         }
     MOCK_METHOD_END(CONSTMAP_RESULT, CONSTMAP_OK)
 
-    MOCK_STATIC_METHOD_1(, VECTOR_HANDLE, VECTOR_create, size_t, elementSize)
-        VECTOR_HANDLE result2 = BASEIMPLEMENTATION::VECTOR_create(elementSize);
-    MOCK_METHOD_END(VECTOR_HANDLE, result2)
-
-    MOCK_STATIC_METHOD_1(, void, VECTOR_destroy, VECTOR_HANDLE, handle)
-        BASEIMPLEMENTATION::VECTOR_destroy(handle);
-    MOCK_VOID_METHOD_END()
-
-    MOCK_STATIC_METHOD_3(, int, VECTOR_push_back, VECTOR_HANDLE, handle, const void*, elements, size_t, numElements)
-        int result2;
-        currentVECTOR_push_back_call++;
-        if (currentVECTOR_push_back_call == whenShallVECTOR_push_back_fail)
-        {
-            result2 = __LINE__;
-        }
-        else
-        {
-            result2 = BASEIMPLEMENTATION::VECTOR_push_back(handle, elements, numElements);
-        }
-    MOCK_METHOD_END(int, result2)
-
-    MOCK_STATIC_METHOD_2(, void*, VECTOR_element, VECTOR_HANDLE, handle, size_t, index)
-    MOCK_METHOD_END(void*, BASEIMPLEMENTATION::VECTOR_element(handle, index))
-
-    MOCK_STATIC_METHOD_3(, void*, VECTOR_find_if, VECTOR_HANDLE, handle, PREDICATE_FUNCTION, pred, const void*, value)
-    MOCK_METHOD_END(void*, BASEIMPLEMENTATION::VECTOR_find_if(handle, pred, value))
-
-    MOCK_STATIC_METHOD_1(, size_t, VECTOR_size, VECTOR_HANDLE, handle)
-    MOCK_METHOD_END(size_t, BASEIMPLEMENTATION::VECTOR_size(handle))
-
-    MOCK_STATIC_METHOD_1(, void*, VECTOR_back, VECTOR_HANDLE, handle)
-    MOCK_METHOD_END(void*, BASEIMPLEMENTATION::VECTOR_back(handle))
-
     MOCK_STATIC_METHOD_1(, void, STRING_delete, STRING_HANDLE, s)
         BASEIMPLEMENTATION::STRING_delete(s);
     MOCK_VOID_METHOD_END()
@@ -328,6 +383,10 @@ public:
         BASEIMPLEMENTATION::gballoc_free(iotHubClientHandle);
     MOCK_VOID_METHOD_END()
 
+    MOCK_STATIC_METHOD_2(, IOTHUB_CLIENT_RESULT, IoTHubClient_GetSendStatus, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_STATUS*, iotHubClientStatus)
+        *iotHubClientStatus = currentSendStatus;
+    MOCK_METHOD_END(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK)
+
     MOCK_STATIC_METHOD_1(, CONSTMAP_HANDLE, Message_GetProperties, MESSAGE_HANDLE, message)
         CONSTMAP_HANDLE result2;
         if (message == MESSAGE_HANDLE_WITHOUT_SOURCE)
@@ -410,6 +469,9 @@ public:
     MOCK_STATIC_METHOD_4(, IOTHUB_CLIENT_RESULT, IoTHubClient_SendEventAsync, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback)
     MOCK_METHOD_END(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK)
 
+    MOCK_STATIC_METHOD_3(, IOTHUB_CLIENT_RESULT, IoTHubClient_SetOption, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, const char*, optionName, const void*, value)
+    MOCK_METHOD_END(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK)
+
     MOCK_STATIC_METHOD_3(, IOTHUB_CLIENT_RESULT, IoTHubClient_SetMessageCallback, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC, messageCallback, void*, userContextCallback)
         IotHub_Receive_message_callback_function = messageCallback;
         IotHub_Receive_message_userContext = userContextCallback;
@@ -499,6 +561,13 @@ public:
         BASEIMPLEMENTATION::gballoc_free(transportHlHandle);
     MOCK_VOID_METHOD_END()
 
+    // time
+    MOCK_STATIC_METHOD_1(, time_t, get_time, time_t*, t)
+    MOCK_METHOD_END(time_t, currentTime)
+
+    MOCK_STATIC_METHOD_2(, double, get_difftime, time_t, stopTime, time_t, startTime)
+    MOCK_METHOD_END(double, (double)(stopTime - startTime))
+
     // broker
     MOCK_STATIC_METHOD_3(, BROKER_RESULT, Broker_Publish, BROKER_HANDLE, broker, MODULE_HANDLE, source, MESSAGE_HANDLE, message)
     MOCK_METHOD_END(BROKER_RESULT, BROKER_OK)
@@ -540,6 +609,9 @@ public:
         }
     MOCK_METHOD_END(const char*, result2);
 
+    MOCK_STATIC_METHOD_2(, double, json_object_get_number, const JSON_Object*, object, const char*, name)
+    MOCK_METHOD_END(double, 0);
+
     MOCK_STATIC_METHOD_1(, void, json_value_free, JSON_Value*, value)
         free(value);
     MOCK_VOID_METHOD_END();
@@ -547,14 +619,16 @@ public:
 
 DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , void*, gballoc_malloc, size_t, size);
 DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , void, gballoc_free, void*, ptr);
+DECLARE_GLOBAL_MOCK_METHOD_2(IotHubMocks, , void*, gballoc_realloc, void*, ptr, size_t, size);
+DECLARE_GLOBAL_MOCK_METHOD_0(IotHubMocks, , LOCK_HANDLE, Lock_Init);
+DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , LOCK_RESULT, Lock, LOCK_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , LOCK_RESULT, Unlock, LOCK_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , LOCK_RESULT, Lock_Deinit, LOCK_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_3(IotHubMocks, , THREADAPI_RESULT, ThreadAPI_Create, THREAD_HANDLE*, threadHandle, THREAD_START_FUNC, func, void*, arg);
+DECLARE_GLOBAL_MOCK_METHOD_2(IotHubMocks, , THREADAPI_RESULT, ThreadAPI_Join, THREAD_HANDLE, threadHandle, int*, res);
+DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , void, ThreadAPI_Sleep, unsigned int, milliseconds);
 DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , CONSTMAP_HANDLE, ConstMap_Clone, CONSTMAP_HANDLE, handle);
 DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , void, ConstMap_Destroy, CONSTMAP_HANDLE, map);
-DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , VECTOR_HANDLE, VECTOR_create, size_t, elementSize)
-DECLARE_GLOBAL_MOCK_METHOD_3(IotHubMocks, , int, VECTOR_push_back, VECTOR_HANDLE, handle, const void*, elements, size_t, numElements)
-DECLARE_GLOBAL_MOCK_METHOD_2(IotHubMocks, , void*, VECTOR_element, VECTOR_HANDLE, handle, size_t, index)
-DECLARE_GLOBAL_MOCK_METHOD_3(IotHubMocks, , void*, VECTOR_find_if, VECTOR_HANDLE, handle, PREDICATE_FUNCTION, pred, const void*, value)
-DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , size_t, VECTOR_size, VECTOR_HANDLE, handle)
-DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , void, VECTOR_destroy, VECTOR_HANDLE, handle)
 DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , void, STRING_delete, STRING_HANDLE, s);
 DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , STRING_HANDLE, STRING_construct, const char*, source);
 DECLARE_GLOBAL_MOCK_METHOD_2(IotHubMocks, , int, STRING_concat, STRING_HANDLE, s1, const char*, s2);
@@ -564,6 +638,7 @@ DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , const char*, STRING_c_str, STRING_HA
 DECLARE_GLOBAL_MOCK_METHOD_2(IotHubMocks, , IOTHUB_CLIENT_HANDLE, IoTHubClient_CreateWithTransport, TRANSPORT_HANDLE, transport, const IOTHUB_CLIENT_CONFIG*, config)
 DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , IOTHUB_CLIENT_HANDLE, IoTHubClient_Create, const IOTHUB_CLIENT_CONFIG*, config)
 DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , void, IoTHubClient_Destroy, IOTHUB_CLIENT_HANDLE, iotHubClientHandle)
+DECLARE_GLOBAL_MOCK_METHOD_2(IotHubMocks, , IOTHUB_CLIENT_RESULT, IoTHubClient_GetSendStatus, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_STATUS*, iotHubClientStatus)
 DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , CONSTMAP_HANDLE, Message_GetProperties, MESSAGE_HANDLE, message)
 DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , MESSAGE_HANDLE, Message_Create, const MESSAGE_CONFIG*, cfg)
 DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , void, Message_Destroy, MESSAGE_HANDLE, message)
@@ -572,6 +647,7 @@ DECLARE_GLOBAL_MOCK_METHOD_3(IotHubMocks, , MAP_RESULT, Map_AddOrUpdate, MAP_HAN
 DECLARE_GLOBAL_MOCK_METHOD_3(IotHubMocks, , MAP_RESULT, Map_Add, MAP_HANDLE, handle, const char*, key, const char*, value);
 DECLARE_GLOBAL_MOCK_METHOD_4(IotHubMocks, , CONSTMAP_RESULT, ConstMap_GetInternals, CONSTMAP_HANDLE, handle, const char*const**, keys, const char*const**, values, size_t*, count)
 DECLARE_GLOBAL_MOCK_METHOD_4(IotHubMocks, ,IOTHUB_CLIENT_RESULT, IoTHubClient_SendEventAsync, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback)
+DECLARE_GLOBAL_MOCK_METHOD_3(IotHubMocks, , IOTHUB_CLIENT_RESULT, IoTHubClient_SetOption, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, const char*, optionName, const void*, value)
 DECLARE_GLOBAL_MOCK_METHOD_3(IotHubMocks, , IOTHUB_CLIENT_RESULT, IoTHubClient_SetMessageCallback, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC, messageCallback, void*, userContextCallback)
 DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , const CONSTBUFFER *, Message_GetContent, MESSAGE_HANDLE, message)
 DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , void, IoTHubMessage_Destroy, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle)
@@ -580,13 +656,15 @@ DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , MAP_HANDLE, IoTHubMessage_Properties
 DECLARE_GLOBAL_MOCK_METHOD_3(IotHubMocks, , IOTHUB_MESSAGE_RESULT, IoTHubMessage_GetByteArray, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle, const unsigned char**, buffer, size_t*, size)
 DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , const char*, IoTHubMessage_GetString, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle)
 DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , IOTHUBMESSAGE_CONTENT_TYPE, IoTHubMessage_GetContentType, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle)
-DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , void*, VECTOR_back, VECTOR_HANDLE, handle)
 DECLARE_GLOBAL_MOCK_METHOD_3(IotHubMocks, , TRANSPORT_HANDLE, IoTHubTransport_Create, IOTHUB_CLIENT_TRANSPORT_PROVIDER, protocol, const char*, iotHubName, const char*, iotHubSuffix)
 DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , void, IoTHubTransport_Destroy, TRANSPORT_HANDLE, transportHlHandle)
+DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , time_t, get_time, time_t*, t)
+DECLARE_GLOBAL_MOCK_METHOD_2(IotHubMocks, , double, get_difftime, time_t, stopTime, time_t, startTime)
 DECLARE_GLOBAL_MOCK_METHOD_3(IotHubMocks, , BROKER_RESULT, Broker_Publish, BROKER_HANDLE, broker, MODULE_HANDLE, source, MESSAGE_HANDLE, message)
 DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , JSON_Value*, json_parse_string, const char *, filename);
 DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , JSON_Object*, json_value_get_object, const JSON_Value*, value);
 DECLARE_GLOBAL_MOCK_METHOD_2(IotHubMocks, , const char*, json_object_get_string, const JSON_Object*, object, const char*, name);
+DECLARE_GLOBAL_MOCK_METHOD_2(IotHubMocks, , double, json_object_get_number, const JSON_Object*, object, const char*, name);
 DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , void, json_value_free, JSON_Value*, value);
 
 BEGIN_TEST_SUITE(iothub_ut)
@@ -603,6 +681,8 @@ BEGIN_TEST_SUITE(iothub_ut)
         Module_Create = MODULE_CREATE(apis);
         Module_Destroy = MODULE_DESTROY(apis);
         Module_Receive = MODULE_RECEIVE(apis);
+        Module_Start = MODULE_START(apis);
+        Module_ReceiveBatch = MODULE_RECEIVE_BATCH(Module_GetApi(MODULE_API_VERSION_2));
     }
 
     TEST_SUITE_CLEANUP(TestClassCleanup)
@@ -618,8 +698,8 @@ BEGIN_TEST_SUITE(iothub_ut)
             ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
         }
 
-        currentVECTOR_push_back_call = 0;
-        whenShallVECTOR_push_back_fail = 0;
+        currentTime = 0;
+        currentSendStatus = IOTHUB_CLIENT_SEND_STATUS_IDLE;
 
         currentSTRING_construct_call = 0;
         whenShallSTRING_construct_fail = 0;
@@ -656,6 +736,26 @@ BEGIN_TEST_SUITE(iothub_ut)
         ASSERT_IS_TRUE(MODULE_CREATE(MODULEAPIS) != NULL);
         ASSERT_IS_TRUE(MODULE_DESTROY(MODULEAPIS) != NULL);
         ASSERT_IS_TRUE(MODULE_RECEIVE(MODULEAPIS) != NULL);
+        ASSERT_IS_TRUE(MODULE_START(MODULEAPIS) != NULL);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_IOTHUBMODULE_17_066: [ `Module_GetApi` shall return the `MODULE_API_2` table, which adds `IotHub_ReceiveBatch`, if `gateway_api_version` is `MODULE_API_VERSION_2` or later, and the `MODULE_API_1` table otherwise. ]*/
+    TEST_FUNCTION(Module_GetApi_returns_ReceiveBatch_only_for_version_2)
+    {
+        ///arrange
+        IotHubMocks mocks;
+
+        ///act
+        const MODULE_API* apis_1 = Module_GetApi(MODULE_API_VERSION_1);
+        const MODULE_API* apis_2 = Module_GetApi(MODULE_API_VERSION_2);
+
+        ///assert
+        ASSERT_IS_NULL(MODULE_RECEIVE_BATCH(apis_1));
+        ASSERT_IS_TRUE(MODULE_RECEIVE_BATCH(apis_2) != NULL);
+        ASSERT_IS_TRUE(MODULE_RECEIVE(apis_2) == MODULE_RECEIVE(apis_1));
         mocks.AssertActualAndExpectedCalls();
 
         ///cleanup
@@ -679,6 +779,16 @@ BEGIN_TEST_SUITE(iothub_ut)
         STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "Transport"))
             .IgnoreArgument(1)
             .SetReturn("HTTP");
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "MaxDevices"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "DeviceIdleTimeout"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "BatchMaxMessages"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "BatchMaxBytes"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "BatchMaxAge"))
+            .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, gballoc_malloc(strlen("aHubName") + 1));
         STRICT_EXPECTED_CALL(mocks, gballoc_malloc(strlen("suffix.name") + 1));
         STRICT_EXPECTED_CALL(mocks, gballoc_malloc(sizeof(IOTHUB_CONFIG)));
@@ -696,6 +806,175 @@ BEGIN_TEST_SUITE(iothub_ut)
         Module_FreeConfiguration(result);
     }
 
+    /*Tests_SRS_IOTHUBMODULE_17_024: [ `IotHub_ParseConfigurationFromJson` shall set `maxDevices` to the value named "MaxDevices", or to 0 if there is no such value. ]*/
+    /*Tests_SRS_IOTHUBMODULE_17_025: [ `IotHub_ParseConfigurationFromJson` shall set `deviceIdleTimeout` to the value named "DeviceIdleTimeout", or to 0 if there is no such value. ]*/
+    TEST_FUNCTION(IotHub_ParseConfigurationFromJson_reads_MaxDevices_and_DeviceIdleTimeout)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+
+        STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "Transport"))
+            .IgnoreArgument(1)
+            .SetReturn("HTTP");
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "MaxDevices"))
+            .IgnoreArgument(1)
+            .SetReturn((double)20000);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "DeviceIdleTimeout"))
+            .IgnoreArgument(1)
+            .SetReturn((double)600);
+
+        ///act
+        auto result = (IOTHUB_CONFIG*)Module_ParseConfigurationFromJson("don't care");
+
+        ///assert
+        ASSERT_IS_NOT_NULL(result);
+        ASSERT_ARE_EQUAL(size_t, 20000, result->maxDevices);
+        ASSERT_ARE_EQUAL(size_t, 600, result->deviceIdleTimeout);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        Module_FreeConfiguration(result);
+    }
+
+    /*Tests_SRS_IOTHUBMODULE_17_024: [ `IotHub_ParseConfigurationFromJson` shall set `maxDevices` to the value named "MaxDevices", or to 0 if there is no such value. ]*/
+    /*Tests_SRS_IOTHUBMODULE_17_025: [ `IotHub_ParseConfigurationFromJson` shall set `deviceIdleTimeout` to the value named "DeviceIdleTimeout", or to 0 if there is no such value. ]*/
+    /*Tests_SRS_IOTHUBMODULE_17_038: [ `IotHub_ParseConfigurationFromJson` shall set `batchMaxMessages`, `batchMaxBytes` and `batchMaxAge` to the values named "BatchMaxMessages", "BatchMaxBytes" and "BatchMaxAge", or to 0 if there are no such values. ]*/
+    TEST_FUNCTION(IotHub_ParseConfigurationFromJson_defaults_MaxDevices_and_DeviceIdleTimeout_to_0)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+
+        STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "Transport"))
+            .IgnoreArgument(1)
+            .SetReturn("HTTP");
+
+        ///act
+        auto result = (IOTHUB_CONFIG*)Module_ParseConfigurationFromJson("don't care");
+
+        ///assert
+        ASSERT_IS_NOT_NULL(result);
+        ASSERT_ARE_EQUAL(size_t, 0, result->maxDevices);
+        ASSERT_ARE_EQUAL(size_t, 0, result->deviceIdleTimeout);
+        ASSERT_ARE_EQUAL(size_t, 0, result->batchMaxMessages);
+        ASSERT_ARE_EQUAL(size_t, 0, result->batchMaxBytes);
+        ASSERT_ARE_EQUAL(size_t, 0, result->batchMaxAge);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        Module_FreeConfiguration(result);
+    }
+
+    /*Tests_SRS_IOTHUBMODULE_17_026: [ If "MaxDevices" or "DeviceIdleTimeout" is negative then `IotHub_ParseConfigurationFromJson` shall fail and return NULL. ]*/
+    TEST_FUNCTION(IotHub_ParseConfigurationFromJson_returns_null_when_MaxDevices_is_negative)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+
+        STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "Transport"))
+            .IgnoreArgument(1)
+            .SetReturn("HTTP");
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "MaxDevices"))
+            .IgnoreArgument(1)
+            .SetReturn((double)-1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1)
+            .NeverInvoked();
+
+        ///act
+        auto result = Module_ParseConfigurationFromJson("don't care");
+
+        ///assert
+        ASSERT_IS_NULL(result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_IOTHUBMODULE_17_026: [ If "MaxDevices" or "DeviceIdleTimeout" is negative then `IotHub_ParseConfigurationFromJson` shall fail and return NULL. ]*/
+    TEST_FUNCTION(IotHub_ParseConfigurationFromJson_returns_null_when_DeviceIdleTimeout_is_negative)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+
+        STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "Transport"))
+            .IgnoreArgument(1)
+            .SetReturn("HTTP");
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "DeviceIdleTimeout"))
+            .IgnoreArgument(1)
+            .SetReturn((double)-1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1)
+            .NeverInvoked();
+
+        ///act
+        auto result = Module_ParseConfigurationFromJson("don't care");
+
+        ///assert
+        ASSERT_IS_NULL(result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_IOTHUBMODULE_17_038: [ `IotHub_ParseConfigurationFromJson` shall set `batchMaxMessages`, `batchMaxBytes` and `batchMaxAge` to the values named "BatchMaxMessages", "BatchMaxBytes" and "BatchMaxAge", or to 0 if there are no such values. ]*/
+    TEST_FUNCTION(IotHub_ParseConfigurationFromJson_reads_the_batch_limits)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+
+        STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "Transport"))
+            .IgnoreArgument(1)
+            .SetReturn("HTTP");
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "BatchMaxMessages"))
+            .IgnoreArgument(1)
+            .SetReturn((double)50);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "BatchMaxBytes"))
+            .IgnoreArgument(1)
+            .SetReturn((double)65536);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "BatchMaxAge"))
+            .IgnoreArgument(1)
+            .SetReturn((double)30);
+
+        ///act
+        auto result = (IOTHUB_CONFIG*)Module_ParseConfigurationFromJson("don't care");
+
+        ///assert
+        ASSERT_IS_NOT_NULL(result);
+        ASSERT_ARE_EQUAL(size_t, 50, result->batchMaxMessages);
+        ASSERT_ARE_EQUAL(size_t, 65536, result->batchMaxBytes);
+        ASSERT_ARE_EQUAL(size_t, 30, result->batchMaxAge);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        Module_FreeConfiguration(result);
+    }
+
+    /*Tests_SRS_IOTHUBMODULE_17_039: [ If "BatchMaxMessages", "BatchMaxBytes" or "BatchMaxAge" is negative then `IotHub_ParseConfigurationFromJson` shall fail and return NULL. ]*/
+    TEST_FUNCTION(IotHub_ParseConfigurationFromJson_returns_null_when_BatchMaxAge_is_negative)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+
+        STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "Transport"))
+            .IgnoreArgument(1)
+            .SetReturn("HTTP");
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "BatchMaxAge"))
+            .IgnoreArgument(1)
+            .SetReturn((double)-1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1)
+            .NeverInvoked();
+
+        ///act
+        auto result = Module_ParseConfigurationFromJson("don't care");
+
+        ///assert
+        ASSERT_IS_NULL(result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+    }
+
     TEST_FUNCTION(IotHub_ParseConfigurationFromJson_returns_NULL_when_malloc_fails_1)
     {
         ///arrange
@@ -712,6 +991,16 @@ BEGIN_TEST_SUITE(iothub_ut)
         STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "Transport"))
             .IgnoreArgument(1)
             .SetReturn("HTTP");
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "MaxDevices"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "DeviceIdleTimeout"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "BatchMaxMessages"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "BatchMaxBytes"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "BatchMaxAge"))
+            .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(mocks, gballoc_malloc(strlen("aHubName") + 1));
         STRICT_EXPECTED_CALL(mocks, gballoc_malloc(strlen("suffix.name") + 1));
@@ -752,6 +1041,16 @@ BEGIN_TEST_SUITE(iothub_ut)
         STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "Transport"))
             .IgnoreArgument(1)
             .SetReturn("HTTP");
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "MaxDevices"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "DeviceIdleTimeout"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "BatchMaxMessages"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "BatchMaxBytes"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "BatchMaxAge"))
+            .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(mocks, gballoc_malloc(strlen("aHubName") + 1));
         STRICT_EXPECTED_CALL(mocks, gballoc_malloc(strlen("suffix.name") + 1))
@@ -789,6 +1088,16 @@ BEGIN_TEST_SUITE(iothub_ut)
         STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "Transport"))
             .IgnoreArgument(1)
             .SetReturn("HTTP");
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "MaxDevices"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "DeviceIdleTimeout"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "BatchMaxMessages"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "BatchMaxBytes"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "BatchMaxAge"))
+            .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(mocks, gballoc_malloc(strlen("aHubName") + 1))
             .SetFailReturn((void*)NULL);
@@ -1160,7 +1469,7 @@ BEGIN_TEST_SUITE(iothub_ut)
     }
 
     /*Tests_SRS_IOTHUBMODULE_02_008: [ Otherwise, `IotHub_Create` shall return a non-`NULL` handle. ]*/
-    /*Tests_SRS_IOTHUBMODULE_02_006: [ `IotHub_Create` shall create an empty `VECTOR` containing pointers to `PERSONALITY`s. ]*/
+    /*Tests_SRS_IOTHUBMODULE_17_027: [ `IotHub_Create` shall create an empty table of `PERSONALITY`s indexed by device ID. ]*/
     /*Tests_SRS_IOTHUBMODULE_17_001: [ If `configuration->transportProvider` is `HTTP_Protocol` or `AMQP_Protocol`, `IotHub_Create` shall create a shared transport by calling `IoTHubTransport_Create`. ]*/
     /*Tests_SRS_IOTHUBMODULE_02_029: [ `IotHub_Create` shall create a copy of `configuration->IoTHubSuffix`. ]*/
     /*Tests_SRS_IOTHUBMODULE_02_028: [ `IotHub_Create` shall create a copy of `configuration->IoTHubName`. ]*/
@@ -1175,7 +1484,8 @@ BEGIN_TEST_SUITE(iothub_ut)
         STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
+        /*personality table*/
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
             .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(mocks, STRING_construct(name));
@@ -1195,50 +1505,34 @@ BEGIN_TEST_SUITE(iothub_ut)
         Module_Destroy(module);
     }
 
-    TEST_FUNCTION(IotHub_Create_creates_a_transport_for_AMQP)
+    /*Tests_SRS_IOTHUBMODULE_17_029: [ `IotHub_Create` shall store `configuration->maxDevices` and `configuration->deviceIdleTimeout`. ]*/
+    TEST_FUNCTION(IotHub_Create_stores_maxDevices_and_deviceIdleTimeout)
     {
         ///arrange
-        IotHubMocks mocks;
-        AutoConfig config(AMQP_Protocol);
-        mocks.ResetAllCalls();
-
-        EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
-
-        EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG));
-
-        EXPECTED_CALL(mocks, STRING_construct(name));
-
-        EXPECTED_CALL(mocks, STRING_construct(suffix));
-
-        STRICT_EXPECTED_CALL(mocks, IoTHubTransport_Create(AMQP_Protocol, name, suffix));
+        CNiceCallComparer<IotHubMocks> mocks;
+        AutoConfig config(100, 60);
 
         ///act
         auto module = Module_Create(BROKER_HANDLE_VALID, config);
 
         ///assert
         ASSERT_IS_NOT_NULL(module);
-        mocks.AssertActualAndExpectedCalls();
+        ASSERT_ARE_EQUAL(size_t, 100, ((IOTHUB_HANDLE_DATA*)module)->maxDevices);
+        ASSERT_ARE_EQUAL(size_t, 60, ((IOTHUB_HANDLE_DATA*)module)->deviceIdleTimeout);
+        ASSERT_ARE_EQUAL(size_t, 0, ((IOTHUB_HANDLE_DATA*)module)->personalityCount);
 
         ///cleanup
         Module_Destroy(module);
     }
 
-    TEST_FUNCTION(IotHub_Create_does_not_create_a_transport_for_MQTT)
+    /*Tests_SRS_IOTHUBMODULE_17_040: [ `IotHub_Create` shall store `configuration->batchMaxMessages`, `configuration->batchMaxBytes` and `configuration->batchMaxAge`. ]*/
+    TEST_FUNCTION(IotHub_Create_stores_the_batch_limits)
     {
         ///arrange
-        IotHubMocks mocks;
-        AutoConfig config(MQTT_Protocol);
-        mocks.ResetAllCalls();
-
-        EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
-
-        EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG));
-
-        EXPECTED_CALL(mocks, STRING_construct(name));
-
-        EXPECTED_CALL(mocks, STRING_construct(suffix));
+        CNiceCallComparer<IotHubMocks> mocks;
+        AutoConfig config(50, 65536, 0);
 
-        EXPECTED_CALL(mocks, IoTHubTransport_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(mocks, Lock_Init())
             .NeverInvoked();
 
         ///act
@@ -1246,35 +1540,32 @@ BEGIN_TEST_SUITE(iothub_ut)
 
         ///assert
         ASSERT_IS_NOT_NULL(module);
+        ASSERT_ARE_EQUAL(size_t, 50, ((IOTHUB_HANDLE_DATA*)module)->batchMaxMessages);
+        ASSERT_ARE_EQUAL(size_t, 65536, ((IOTHUB_HANDLE_DATA*)module)->batchMaxBytes);
+        ASSERT_ARE_EQUAL(size_t, 0, ((IOTHUB_HANDLE_DATA*)module)->batchMaxAge);
+        ASSERT_IS_NULL(((IOTHUB_HANDLE_DATA*)module)->lockHandle);
         mocks.AssertActualAndExpectedCalls();
 
         ///cleanup
         Module_Destroy(module);
     }
 
-    TEST_FUNCTION(IotHub_Create_does_not_create_an_unrecognized_transport)
+    /*Tests_SRS_IOTHUBMODULE_17_041: [ If `configuration->batchMaxAge` is not 0, `IotHub_Create` shall create a lock by calling `Lock_Init`. ]*/
+    TEST_FUNCTION(IotHub_Create_with_batchMaxAge_creates_a_lock)
     {
         ///arrange
-        IotHubMocks mocks;
-        AutoConfig config((IOTHUB_CLIENT_TRANSPORT_PROVIDER)0x42);
-        mocks.ResetAllCalls();
-
-        EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
-
-        EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG));
-
-        EXPECTED_CALL(mocks, STRING_construct(name));
-
-        EXPECTED_CALL(mocks, STRING_construct(suffix));
+        CNiceCallComparer<IotHubMocks> mocks;
+        AutoConfig config(0, 0, 30);
 
-        EXPECTED_CALL(mocks, IoTHubTransport_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .NeverInvoked();
+        STRICT_EXPECTED_CALL(mocks, Lock_Init());
 
         ///act
         auto module = Module_Create(BROKER_HANDLE_VALID, config);
 
         ///assert
         ASSERT_IS_NOT_NULL(module);
+        ASSERT_ARE_EQUAL(size_t, 30, ((IOTHUB_HANDLE_DATA*)module)->batchMaxAge);
+        ASSERT_IS_NOT_NULL(((IOTHUB_HANDLE_DATA*)module)->lockHandle);
         mocks.AssertActualAndExpectedCalls();
 
         ///cleanup
@@ -1282,31 +1573,156 @@ BEGIN_TEST_SUITE(iothub_ut)
     }
 
     /*Tests_SRS_IOTHUBMODULE_02_027: [ When `IotHub_Create` encounters an internal failure it shall fail and return `NULL`. ]*/
-    TEST_FUNCTION(IotHub_Create_fails_when_STRING_construct_fails_1)
+    TEST_FUNCTION(IotHub_Create_fails_when_Lock_Init_fails)
     {
         ///arrange
         IotHubMocks mocks;
-        AutoConfig config;
+        AutoConfig config(0, 0, 30);
         mocks.ResetAllCalls();
 
         STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
             .IgnoreArgument(1);
-
         STRICT_EXPECTED_CALL(mocks, IoTHubTransport_Create(HTTP_Protocol, name, suffix));
-        STRICT_EXPECTED_CALL(mocks, IoTHubTransport_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
         STRICT_EXPECTED_CALL(mocks, STRING_construct(name));
+        STRICT_EXPECTED_CALL(mocks, STRING_construct(suffix));
+        STRICT_EXPECTED_CALL(mocks, Lock_Init())
+            .SetFailReturn((LOCK_HANDLE)NULL);
         STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-
+        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, IoTHubTransport_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+
+        ///assert
+        ASSERT_IS_NULL(module);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+    }
+
+    TEST_FUNCTION(IotHub_Create_creates_a_transport_for_AMQP)
+    {
+        ///arrange
+        IotHubMocks mocks;
+        AutoConfig config(AMQP_Protocol);
+        mocks.ResetAllCalls();
+
+        EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+
+        EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+
+        EXPECTED_CALL(mocks, STRING_construct(name));
+
+        EXPECTED_CALL(mocks, STRING_construct(suffix));
+
+        STRICT_EXPECTED_CALL(mocks, IoTHubTransport_Create(AMQP_Protocol, name, suffix));
+
+        ///act
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(module);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        Module_Destroy(module);
+    }
+
+    TEST_FUNCTION(IotHub_Create_does_not_create_a_transport_for_MQTT)
+    {
+        ///arrange
+        IotHubMocks mocks;
+        AutoConfig config(MQTT_Protocol);
+        mocks.ResetAllCalls();
+
+        EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+
+        EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+
+        EXPECTED_CALL(mocks, STRING_construct(name));
+
+        EXPECTED_CALL(mocks, STRING_construct(suffix));
+
+        EXPECTED_CALL(mocks, IoTHubTransport_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .NeverInvoked();
+
+        ///act
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(module);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        Module_Destroy(module);
+    }
+
+    TEST_FUNCTION(IotHub_Create_does_not_create_an_unrecognized_transport)
+    {
+        ///arrange
+        IotHubMocks mocks;
+        AutoConfig config((IOTHUB_CLIENT_TRANSPORT_PROVIDER)0x42);
+        mocks.ResetAllCalls();
+
+        EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+
+        EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+
+        EXPECTED_CALL(mocks, STRING_construct(name));
+
+        EXPECTED_CALL(mocks, STRING_construct(suffix));
+
+        EXPECTED_CALL(mocks, IoTHubTransport_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .NeverInvoked();
+
+        ///act
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(module);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        Module_Destroy(module);
+    }
+
+    /*Tests_SRS_IOTHUBMODULE_02_027: [ When `IotHub_Create` encounters an internal failure it shall fail and return `NULL`. ]*/
+    TEST_FUNCTION(IotHub_Create_fails_when_STRING_construct_fails_1)
+    {
+        ///arrange
+        IotHubMocks mocks;
+        AutoConfig config;
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        /*personality table*/
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        STRICT_EXPECTED_CALL(mocks, IoTHubTransport_Create(HTTP_Protocol, name, suffix));
+        STRICT_EXPECTED_CALL(mocks, IoTHubTransport_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        STRICT_EXPECTED_CALL(mocks, STRING_construct(name));
+        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
         whenShallSTRING_construct_fail = currentSTRING_construct_call + 2;
         STRICT_EXPECTED_CALL(mocks, STRING_construct(suffix));
 
@@ -1334,9 +1750,10 @@ BEGIN_TEST_SUITE(iothub_ut)
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
+        /*personality table*/
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(mocks, IoTHubTransport_Create(HTTP_Protocol, name, suffix))
@@ -1371,9 +1788,10 @@ BEGIN_TEST_SUITE(iothub_ut)
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
+        /*personality table*/
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(mocks, IoTHubTransport_Create(HTTP_Protocol, name, suffix))
@@ -1390,8 +1808,8 @@ BEGIN_TEST_SUITE(iothub_ut)
         Module_Destroy(module);
     }
 
-    /*Tests_SRS_IOTHUBMODULE_02_007: [ If creating the personality vector fails then `IotHub_Create` shall fail and return `NULL`. ]*/
-    TEST_FUNCTION(IotHub_Create_fails_when_VECTOR_create_fails)
+    /*Tests_SRS_IOTHUBMODULE_17_028: [ If creating the personality table fails then `IotHub_Create` shall fail and return `NULL`. ]*/
+    TEST_FUNCTION(IotHub_Create_fails_when_personality_table_malloc_fails)
     {
         ///arrange
         IotHubMocks mocks;
@@ -1403,9 +1821,10 @@ BEGIN_TEST_SUITE(iothub_ut)
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
+        /*personality table*/
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
             .IgnoreArgument(1)
-            .SetFailReturn((VECTOR_HANDLE)NULL);
+            .SetFailReturn((void*)NULL);
 
         ///act
         auto module = Module_Create(BROKER_HANDLE_VALID, config);
@@ -1467,10 +1886,9 @@ BEGIN_TEST_SUITE(iothub_ut)
         STRICT_EXPECTED_CALL(mocks, IoTHubTransport_Destroy(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        /*personality table*/
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
         /*IoTHubName cache*/
@@ -1513,11 +1931,9 @@ BEGIN_TEST_SUITE(iothub_ut)
 
         /*this is the loop trying to dispose of all personalities*/
         /*none for this case*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
 
-        /*this is VECTOR<PERSONALITY>*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        /*this is the personality table*/
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
         /* transport handle */
@@ -1557,10 +1973,9 @@ BEGIN_TEST_SUITE(iothub_ut)
 
         /*this is the loop trying to dispose of all personalities*/
         /*1 for this case*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
-            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_GetSendStatus(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .IgnoreArgument(2);
         STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
@@ -1574,8 +1989,8 @@ BEGIN_TEST_SUITE(iothub_ut)
         STRICT_EXPECTED_CALL(mocks, IoTHubTransport_Destroy(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
-        /*this is VECTOR<PERSONALITY>*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        /*this is the personality table*/
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
         /*this is allocated memory*/
@@ -1612,11 +2027,10 @@ BEGIN_TEST_SUITE(iothub_ut)
 
         /*this is the loop trying to dispose of all personalities*/
         /*1 for this case*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
         /*first element*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
-            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_GetSendStatus(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .IgnoreArgument(2);
         STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
@@ -1627,8 +2041,9 @@ BEGIN_TEST_SUITE(iothub_ut)
             .IgnoreArgument(1);
 
         /*second element*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
-            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_GetSendStatus(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .IgnoreArgument(2);
         STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
@@ -1642,8 +2057,8 @@ BEGIN_TEST_SUITE(iothub_ut)
         STRICT_EXPECTED_CALL(mocks, IoTHubTransport_Destroy(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
-        /*this is VECTOR<PERSONALITY>*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        /*this is the personality table*/
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
         /*this is allocated memory*/
@@ -1660,13 +2075,14 @@ BEGIN_TEST_SUITE(iothub_ut)
     }
 
     /*Tests_SRS_IOTHUBMODULE_02_009: [ If `moduleHandle` or `messageHandle` is `NULL` then `IotHub_Receive` shall do nothing. ]*/
-    TEST_FUNCTION(IotHub_Receive_with_NULL_moduleHandle_returns)
+    /*Tests_SRS_IOTHUBMODULE_17_049: [ If `moduleHandle` is `NULL` then `IotHub_Start` shall do nothing. ]*/
+    TEST_FUNCTION(IotHub_Start_with_NULL_does_nothing)
     {
         ///arrange
         IotHubMocks mocks;
 
         ///act
-        Module_Receive(NULL, MESSAGE_HANDLE_VALID);
+        Module_Start(NULL);
 
         ///assert
         mocks.AssertActualAndExpectedCalls();
@@ -1674,110 +2090,260 @@ BEGIN_TEST_SUITE(iothub_ut)
         ///cleanup
     }
 
-    /*Tests_SRS_IOTHUBMODULE_02_009: [ If `moduleHandle` or `messageHandle` is `NULL` then `IotHub_Receive` shall do nothing. ]*/
-    TEST_FUNCTION(IotHub_Receive_with_NULL_messageHandle_returns)
+    /*Tests_SRS_IOTHUBMODULE_17_050: [ If `batchMaxAge` is 0, `IotHub_Start` shall do nothing. ]*/
+    TEST_FUNCTION(IotHub_Start_without_batchMaxAge_does_nothing)
     {
         ///arrange
         IotHubMocks mocks;
-        AutoConfig config;
+        AutoConfig config(50, 0, 0);
         auto module = Module_Create(BROKER_HANDLE_VALID, config);
         mocks.ResetAllCalls();
 
         ///act
-        Module_Receive(module, NULL);
+        Module_Start(module);
 
         ///assert
         mocks.AssertActualAndExpectedCalls();
 
         ///cleanup
         Module_Destroy(module);
-
     }
 
-    /*Tests_SRS_IOTHUBMODULE_02_013: [ If no personality exists with a device ID equal to the value of the `deviceName` property of the message, then `IotHub_Receive` shall create a new `PERSONALITY` with the ID and key values from the message. ]*/
-    /*Tests_SRS_IOTHUBMODULE_05_013: [ If a new personality is created and the module's transport has already been created (in `IotHub_Create`), an `IOTHUB_CLIENT_HANDLE` will be added to the personality by a call to `IoTHubClient_CreateWithTransport`. ]*/
-    /*Tests_SRS_IOTHUBMODULE_17_003: [ If a new personality is created, then the associated IoTHubClient will be set to receive messages by calling `IoTHubClient_SetMessageCallback` with callback function `IotHub_ReceiveMessageCallback`, and the personality as context. ]*/
-    /*Tests_SRS_IOTHUBMODULE_02_018: [ `IotHub_Receive` shall create a new IOTHUB_MESSAGE_HANDLE having the same content as `messageHandle`, and the same properties with the exception of `deviceName` and `deviceKey`. ]*/
-    /*Tests_SRS_IOTHUBMODULE_02_020: [ `IotHub_Receive` shall call IoTHubClient_SendEventAsync passing the IOTHUB_MESSAGE_HANDLE. ]*/
-    /*Tests_SRS_IOTHUBMODULE_02_022: [ If `IoTHubClient_SendEventAsync` succeeds then `IotHub_Receive` shall return. ]*/
-    TEST_FUNCTION(IotHub_Receive_succeeds)
+    /*Tests_SRS_IOTHUBMODULE_17_051: [ Otherwise `IotHub_Start` shall start a thread that, every second, sends every batch whose oldest message was received `batchMaxAge` or more seconds ago. ]*/
+    TEST_FUNCTION(IotHub_Start_with_batchMaxAge_starts_a_thread)
     {
         ///arrange
         IotHubMocks mocks;
-        AutoConfig config;
+        AutoConfig config(0, 0, 30);
         auto module = Module_Create(BROKER_HANDLE_VALID, config);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, module))
+            .IgnoreArgument(1)
+            .IgnoreArgument(2);
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        ///act
+        Module_Start(module);
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+        ///assert
+        ASSERT_IS_NOT_NULL(((IOTHUB_HANDLE_DATA*)module)->threadHandle);
+        mocks.AssertActualAndExpectedCalls();
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        ///cleanup
+        Module_Destroy(module);
+    }
 
-        /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
+    /*Tests_SRS_IOTHUBMODULE_17_052: [ If creating the thread fails, `IotHub_Start` shall return, and batches shall only be sent by `IotHub_Receive` and `IotHub_Destroy`. ]*/
+    TEST_FUNCTION(IotHub_Start_when_ThreadAPI_Create_fails_returns)
+    {
+        ///arrange
+        IotHubMocks mocks;
+        AutoConfig config(0, 0, 30);
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+        mocks.ResetAllCalls();
 
-        /*because the deviceName is brand new, it will be added as a new personality*/
-        {/*separate scope for personality building*/
-            /* create a new PERSONALITY */
-            STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
-                .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, module))
+            .IgnoreArgument(1)
+            .IgnoreArgument(2)
+            .SetFailReturn(THREADAPI_ERROR);
 
-            /*making a copy of the deviceName*/
-            STRICT_EXPECTED_CALL(mocks, STRING_construct("firstDevice"));
-            /*making a copy of the deviceKey*/
-            STRICT_EXPECTED_CALL(mocks, STRING_construct("cheiaDeLaPoartaVerde"));
+        ///act
+        Module_Start(module);
 
-            /*getting the stored IoTHubName*/
-            STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-                .IgnoreArgument(1);
-            /*getting the stored IoTHubSuffix*/
-            STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-                .IgnoreArgument(1);
+        ///assert
+        ASSERT_IS_NULL(((IOTHUB_HANDLE_DATA*)module)->threadHandle);
+        mocks.AssertActualAndExpectedCalls();
 
-            /*creating the IOTHUB_CLIENT_HANDLE associated with the device*/
-            STRICT_EXPECTED_CALL(mocks, IoTHubClient_CreateWithTransport(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-                .IgnoreArgument(1)
-                .IgnoreArgument(2);
+        ///cleanup
+        Module_Destroy(module);
+    }
 
-            STRICT_EXPECTED_CALL(mocks, IoTHubClient_SetMessageCallback(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-                .IgnoreArgument(1)
-                .IgnoreArgument(2)
-                .IgnoreArgument(3);
-        }
+    /*Tests_SRS_IOTHUBMODULE_17_053: [ `IotHub_Destroy` shall stop the thread started by `IotHub_Start`, if any, and then destroy the lock. ]*/
+    TEST_FUNCTION(IotHub_Destroy_stops_the_batch_thread)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+        AutoConfig config(0, 0, 30);
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+        Module_Start(module);
+        mocks.ResetAllCalls();
 
-        /*adding the personality to the VECTOR or personalities*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-            .IgnoreArgument(1)
+        STRICT_EXPECTED_CALL(mocks, Lock((LOCK_HANDLE)0x42));
+        STRICT_EXPECTED_CALL(mocks, Unlock((LOCK_HANDLE)0x42));
+        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join((THREAD_HANDLE)0x43, IGNORED_PTR_ARG))
             .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, Lock_Deinit((LOCK_HANDLE)0x42));
 
-        /*getting the location of the personality in the VECTOR*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+        ///act
+        Module_Destroy(module);
 
-        { /*scope for creating the IOTHUBMESSAGE from GWMESSAGE*/
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
 
-            /*gettng the GW message content*/
-            STRICT_EXPECTED_CALL(mocks, Message_GetContent(MESSAGE_HANDLE_VALID_1));
+        ///cleanup
+    }
 
-            /*creating a new IOTHUB_MESSAGE*/
-            STRICT_EXPECTED_CALL(mocks, IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, 1))
-                .ValidateArgumentBuffer(1, CONSTBUFFER_VALID_CONTENT1.buffer, 1);
+    /*Tests_SRS_IOTHUBMODULE_17_060: [ `IotHub_Destroy` shall wait up to 10 seconds for the IoTHubClient of every personality to have no events left to send, and then destroy the personalities. ]*/
+    TEST_FUNCTION(IotHub_Destroy_waits_for_busy_clients_before_destroying_them)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+        AutoConfig config;
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+        IOTHUB_CLIENT_HANDLE client = ((PERSONALITY_PTR)IotHub_Receive_message_userContext)->iothubHandle;
+        currentSendStatus = IOTHUB_CLIENT_SEND_STATUS_BUSY;
+        mocks.ResetAllCalls();
 
-            /*every creation has its destruction - this one actually happens AFTER SendEventAsync*/
-            STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG))
-                .IgnoreArgument(1);
+        /*polled every 100 ms for 10 seconds*/
+        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(100))
+            .ExpectedTimesExactly(100);
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_Destroy(client));
 
-            /*getting the IOTHUBMESSAGE properties*/
-            STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(IGNORED_PTR_ARG))
-                .IgnoreArgument(1);
+        ///act
+        Module_Destroy(module);
 
-            /*getting the GW message properties*/
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup - nothing
+    }
+
+    /*Tests_SRS_IOTHUBMODULE_17_054: [ `IotHub_Destroy` shall send the batch of every personality before destroying the personality. ]*/
+    /*Tests_SRS_IOTHUBMODULE_17_055: [ If batching is enabled, `IotHub_Destroy` shall log how many batches were sent and how many messages they held. ]*/
+    TEST_FUNCTION(IotHub_Destroy_sends_the_batches)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+        AutoConfig config(50, 0, 0);
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+        Module_Receive(module, MESSAGE_HANDLE_VALID_2);
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_SendEventAsync(IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, NULL))
+            .IgnoreArgument(1)
+            .IgnoreArgument(2)
+            .ExpectedTimesExactly(3);
+        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .ExpectedTimesExactly(3);
+
+        ///act
+        Module_Destroy(module);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+    }
+
+    TEST_FUNCTION(IotHub_Receive_with_NULL_moduleHandle_returns)
+    {
+        ///arrange
+        IotHubMocks mocks;
+
+        ///act
+        Module_Receive(NULL, MESSAGE_HANDLE_VALID);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_IOTHUBMODULE_02_009: [ If `moduleHandle` or `messageHandle` is `NULL` then `IotHub_Receive` shall do nothing. ]*/
+    TEST_FUNCTION(IotHub_Receive_with_NULL_messageHandle_returns)
+    {
+        ///arrange
+        IotHubMocks mocks;
+        AutoConfig config;
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+        mocks.ResetAllCalls();
+
+        ///act
+        Module_Receive(module, NULL);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        Module_Destroy(module);
+
+    }
+
+    /*Tests_SRS_IOTHUBMODULE_02_013: [ If no personality exists with a device ID equal to the value of the `deviceName` property of the message, then `IotHub_Receive` shall create a new `PERSONALITY` with the ID and key values from the message. ]*/
+    /*Tests_SRS_IOTHUBMODULE_05_013: [ If a new personality is created and the module's transport has already been created (in `IotHub_Create`), an `IOTHUB_CLIENT_HANDLE` will be added to the personality by a call to `IoTHubClient_CreateWithTransport`. ]*/
+    /*Tests_SRS_IOTHUBMODULE_17_003: [ If a new personality is created, then the associated IoTHubClient will be set to receive messages by calling `IoTHubClient_SetMessageCallback` with callback function `IotHub_ReceiveMessageCallback`, and the personality as context. ]*/
+    /*Tests_SRS_IOTHUBMODULE_02_018: [ `IotHub_Receive` shall create a new IOTHUB_MESSAGE_HANDLE having the same content as `messageHandle`, and the same properties with the exception of `deviceName` and `deviceKey`. ]*/
+    /*Tests_SRS_IOTHUBMODULE_02_020: [ `IotHub_Receive` shall call IoTHubClient_SendEventAsync passing the IOTHUB_MESSAGE_HANDLE. ]*/
+    /*Tests_SRS_IOTHUBMODULE_02_022: [ If `IoTHubClient_SendEventAsync` succeeds then `IotHub_Receive` shall return. ]*/
+    TEST_FUNCTION(IotHub_Receive_succeeds)
+    {
+        ///arrange
+        IotHubMocks mocks;
+        AutoConfig config;
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
+        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+
+        /*because the deviceName is brand new, it will be added as a new personality*/
+        {/*separate scope for personality building*/
+            /* create a new PERSONALITY */
+            STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+                .IgnoreArgument(1);
+
+            /*making a copy of the deviceName*/
+            STRICT_EXPECTED_CALL(mocks, STRING_construct("firstDevice"));
+            /*making a copy of the deviceKey*/
+            STRICT_EXPECTED_CALL(mocks, STRING_construct("cheiaDeLaPoartaVerde"));
+
+            /*getting the stored IoTHubName*/
+            STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+                .IgnoreArgument(1);
+            /*getting the stored IoTHubSuffix*/
+            STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+                .IgnoreArgument(1);
+
+            /*creating the IOTHUB_CLIENT_HANDLE associated with the device*/
+            STRICT_EXPECTED_CALL(mocks, IoTHubClient_CreateWithTransport(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+                .IgnoreArgument(1)
+                .IgnoreArgument(2);
+
+            STRICT_EXPECTED_CALL(mocks, IoTHubClient_SetMessageCallback(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+                .IgnoreArgument(1)
+                .IgnoreArgument(2)
+                .IgnoreArgument(3);
+        }
+
+        { /*scope for creating the IOTHUBMESSAGE from GWMESSAGE*/
+
+            /*gettng the GW message content*/
+            STRICT_EXPECTED_CALL(mocks, Message_GetContent(MESSAGE_HANDLE_VALID_1));
+
+            /*creating a new IOTHUB_MESSAGE*/
+            STRICT_EXPECTED_CALL(mocks, IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, 1))
+                .ValidateArgumentBuffer(1, CONSTBUFFER_VALID_CONTENT1.buffer, 1);
+
+            /*every creation has its destruction - this one actually happens AFTER SendEventAsync*/
+            STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG))
+                .IgnoreArgument(1);
+
+            /*getting the IOTHUBMESSAGE properties*/
+            STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(IGNORED_PTR_ARG))
+                .IgnoreArgument(1);
+
+            /*getting the GW message properties*/
             STRICT_EXPECTED_CALL(mocks, Message_GetProperties(IGNORED_PTR_ARG))
                 .IgnoreArgument(1);
             STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
@@ -1906,13 +2472,10 @@ BEGIN_TEST_SUITE(iothub_ut)
 
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
 
-        /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. One in this test*/
+        /*the personality with the same hash has its deviceName compared*/
         STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
         { /*scope for creating the IOTHUBMESSAGE from GWMESSAGE*/
 
           /*gettng the GW message content*/
@@ -1954,135 +2517,735 @@ BEGIN_TEST_SUITE(iothub_ut)
         /*finally, send the message*/
         STRICT_EXPECTED_CALL(mocks, IoTHubClient_SendEventAsync(IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, NULL))
             .IgnoreArgument(1)
-            .IgnoreArgument(2);
+            .IgnoreArgument(2);
+
+        ///act
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        Module_Destroy(module);
+
+    }
+
+    /*Tests_SRS_IOTHUBMODULE_02_013: [ If no personality exists with a device ID equal to the value of the `deviceName` property of the message, then `IotHub_Receive` shall create a new `PERSONALITY` with the ID and key values from the message. ]*/
+    /*Tests_SRS_IOTHUBMODULE_02_018: [ `IotHub_Receive` shall create a new IOTHUB_MESSAGE_HANDLE having the same content as `messageHandle`, and the same properties with the exception of `deviceName` and `deviceKey`. ]*/
+    /*Tests_SRS_IOTHUBMODULE_02_020: [ `IotHub_Receive` shall call IoTHubClient_SendEventAsync passing the IOTHUB_MESSAGE_HANDLE. ]*/
+    /*Tests_SRS_IOTHUBMODULE_02_022: [ If `IoTHubClient_SendEventAsync` succeeds then `IotHub_Receive` shall return. ]*/
+    TEST_FUNCTION(IotHub_Receive_after_Receive_a_new_device_succeeds)
+    {
+        ///arrange
+        IotHubMocks mocks;
+        AutoConfig config;
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_2));
+        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_2, "source"));
+
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_2, "deviceName"));
+
+        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_2, "deviceKey"));
+
+        /*because the deviceName is brand new, it will be added as a new personality*/
+        {/*separate scope for personality building*/
+         /* create a new PERSONALITY */
+            STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+                .IgnoreArgument(1);
+
+         /*making a copy of the deviceName*/
+            STRICT_EXPECTED_CALL(mocks, STRING_construct("secondDevice"));
+            /*making a copy of the deviceKey*/
+            STRICT_EXPECTED_CALL(mocks, STRING_construct("red"));
+
+            /*getting the stored IoTHubName*/
+            STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+                .IgnoreArgument(1);
+            /*getting the stored IoTHubSuffix*/
+            STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+                .IgnoreArgument(1);
+
+            /*creating the IOTHUB_CLIENT_HANDLE associated with the device*/
+            STRICT_EXPECTED_CALL(mocks, IoTHubClient_CreateWithTransport(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+                .IgnoreArgument(1)
+                .IgnoreArgument(2);
+
+            STRICT_EXPECTED_CALL(mocks, IoTHubClient_SetMessageCallback(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+                .IgnoreArgument(1)
+                .IgnoreArgument(2)
+                .IgnoreArgument(3);
+        }
+
+        { /*scope for creating the IOTHUBMESSAGE from GWMESSAGE*/
+
+          /*gettng the GW message content*/
+            STRICT_EXPECTED_CALL(mocks, Message_GetContent(MESSAGE_HANDLE_VALID_2));
+
+            /*creating a new IOTHUB_MESSAGE*/
+            STRICT_EXPECTED_CALL(mocks, IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, 0))
+                ;
+
+            /*every creation has its destruction - this one actually happens AFTER SendEventAsync*/
+            STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG))
+                .IgnoreArgument(1);
+
+            /*getting the IOTHUBMESSAGE properties*/
+            STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(IGNORED_PTR_ARG))
+                .IgnoreArgument(1);
+
+            /*getting the GW message properties*/
+            STRICT_EXPECTED_CALL(mocks, Message_GetProperties(IGNORED_PTR_ARG))
+                .IgnoreArgument(1);
+            STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
+                .IgnoreArgument(1);
+
+            /*getting the GW keys and values*/
+            STRICT_EXPECTED_CALL(mocks, ConstMap_GetInternals(CONSTMAP_HANDLE_VALID_2, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+                .IgnoreArgument(2)
+                .IgnoreArgument(3)
+                .IgnoreArgument(4);
+
+            /*add "source"*/
+            STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, "source", "mapping"))
+                .IgnoreArgument(1);
+        }
+
+        /*finally, send the message*/
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_SendEventAsync(IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, NULL))
+            .IgnoreArgument(1)
+            .IgnoreArgument(2);
+
+        ///act
+        Module_Receive(module, MESSAGE_HANDLE_VALID_2);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        Module_Destroy(module);
+
+    }
+
+    /*Tests_SRS_IOTHUBMODULE_17_033: [ If `maxDevices` is not 0 and there are already `maxDevices` personalities, `IotHub_Receive` shall destroy the least recently used personality before creating a new one. ]*/
+    TEST_FUNCTION(IotHub_Receive_a_new_device_when_maxDevices_is_reached_evicts_the_least_recently_used_personality)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+        AutoConfig config(1, 0);
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+        IOTHUB_CLIENT_HANDLE firstClient = ((PERSONALITY_PTR)IotHub_Receive_message_userContext)->iothubHandle;
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_Destroy(firstClient));
+        STRICT_EXPECTED_CALL(mocks, STRING_construct("secondDevice"));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_SendEventAsync(IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, NULL))
+            .IgnoreArgument(1)
+            .IgnoreArgument(2);
+
+        ///act
+        Module_Receive(module, MESSAGE_HANDLE_VALID_2);
+
+        ///assert
+        ASSERT_ARE_EQUAL(size_t, 1, ((IOTHUB_HANDLE_DATA*)module)->personalityCount);
+        ASSERT_ARE_EQUAL(size_t, 1, ((IOTHUB_HANDLE_DATA*)module)->personalityEvictions);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        Module_Destroy(module);
+    }
+
+    /*Tests_SRS_IOTHUBMODULE_17_058: [ `IotHub_Receive` shall destroy a removed personality only once `IoTHubClient_GetSendStatus` reports its IoTHubClient has no events left to send, and keep it aside until then. ]*/
+    TEST_FUNCTION(IotHub_Receive_keeps_an_evicted_personality_while_its_client_is_busy)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+        AutoConfig config(1, 0);
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+        PERSONALITY_PTR first = (PERSONALITY_PTR)IotHub_Receive_message_userContext;
+        currentSendStatus = IOTHUB_CLIENT_SEND_STATUS_BUSY;
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_GetSendStatus(first->iothubHandle, IGNORED_PTR_ARG))
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .NeverInvoked();
+
+        ///act
+        Module_Receive(module, MESSAGE_HANDLE_VALID_2);
+
+        ///assert
+        ASSERT_ARE_EQUAL(size_t, 1, ((IOTHUB_HANDLE_DATA*)module)->personalityCount);
+        ASSERT_IS_TRUE(first == ((IOTHUB_HANDLE_DATA*)module)->retired);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        currentSendStatus = IOTHUB_CLIENT_SEND_STATUS_IDLE;
+        Module_Destroy(module);
+    }
+
+    /*Tests_SRS_IOTHUBMODULE_17_059: [ `IotHub_Receive` shall destroy every removed personality whose IoTHubClient has no events left to send. ]*/
+    TEST_FUNCTION(IotHub_Receive_destroys_an_evicted_personality_once_its_client_is_idle)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+        AutoConfig config(1, 0);
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+        IOTHUB_CLIENT_HANDLE firstClient = ((PERSONALITY_PTR)IotHub_Receive_message_userContext)->iothubHandle;
+        currentSendStatus = IOTHUB_CLIENT_SEND_STATUS_BUSY;
+        Module_Receive(module, MESSAGE_HANDLE_VALID_2);
+        currentSendStatus = IOTHUB_CLIENT_SEND_STATUS_IDLE;
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_Destroy(firstClient));
+
+        ///act
+        Module_Receive(module, MESSAGE_HANDLE_VALID_2);
+
+        ///assert
+        ASSERT_IS_NULL(((IOTHUB_HANDLE_DATA*)module)->retired);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        Module_Destroy(module);
+    }
+
+    /*Tests_SRS_IOTHUBMODULE_17_067: [ If more than 16 removed personalities are kept aside, `IotHub_Receive` shall destroy the one removed first even if its IoTHubClient still has events to send, and log that they are lost. ]*/
+    TEST_FUNCTION(IotHub_Receive_destroys_the_oldest_busy_personality_when_too_many_are_kept_aside)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+        AutoConfig config(1, 0);
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+        IOTHUB_CLIENT_HANDLE firstClient = ((PERSONALITY_PTR)IotHub_Receive_message_userContext)->iothubHandle;
+        currentSendStatus = IOTHUB_CLIENT_SEND_STATUS_BUSY;
+        for (int i = 0; i < 16; i++)
+        {
+            Module_Receive(module, (i % 2 == 0) ? MESSAGE_HANDLE_VALID_2 : MESSAGE_HANDLE_VALID_1);
+        }
+        ASSERT_ARE_EQUAL(size_t, 16, ((IOTHUB_HANDLE_DATA*)module)->retiredCount);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_Destroy(firstClient));
+
+        ///act
+        Module_Receive(module, MESSAGE_HANDLE_VALID_2);
+
+        ///assert
+        ASSERT_ARE_EQUAL(size_t, 16, ((IOTHUB_HANDLE_DATA*)module)->retiredCount);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        currentSendStatus = IOTHUB_CLIENT_SEND_STATUS_IDLE;
+        Module_Destroy(module);
+    }
+
+    /*Tests_SRS_IOTHUBMODULE_17_033: [ If `maxDevices` is not 0 and there are already `maxDevices` personalities, `IotHub_Receive` shall destroy the least recently used personality before creating a new one. ]*/
+    TEST_FUNCTION(IotHub_Receive_a_known_device_when_maxDevices_is_reached_evicts_nothing)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+        AutoConfig config(1, 0);
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .NeverInvoked();
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_SendEventAsync(IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, NULL))
+            .IgnoreArgument(1)
+            .IgnoreArgument(2);
+
+        ///act
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+
+        ///assert
+        ASSERT_ARE_EQUAL(size_t, 1, ((IOTHUB_HANDLE_DATA*)module)->personalityHits);
+        ASSERT_ARE_EQUAL(size_t, 1, ((IOTHUB_HANDLE_DATA*)module)->personalityMisses);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        Module_Destroy(module);
+    }
+
+    /*Tests_SRS_IOTHUBMODULE_17_030: [ If `deviceIdleTimeout` is not 0, `IotHub_Receive` shall destroy every personality that has not sent a message for more than `deviceIdleTimeout` seconds. ]*/
+    TEST_FUNCTION(IotHub_Receive_destroys_idle_personalities)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+        AutoConfig config(0, 10);
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+        IOTHUB_CLIENT_HANDLE firstClient = ((PERSONALITY_PTR)IotHub_Receive_message_userContext)->iothubHandle;
+        currentTime = 11;
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, get_time(NULL));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_Destroy(firstClient));
+
+        ///act
+        Module_Receive(module, MESSAGE_HANDLE_VALID_2);
+
+        ///assert
+        ASSERT_ARE_EQUAL(size_t, 1, ((IOTHUB_HANDLE_DATA*)module)->personalityCount);
+        ASSERT_ARE_EQUAL(size_t, 1, ((IOTHUB_HANDLE_DATA*)module)->personalityExpirations);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        Module_Destroy(module);
+    }
+
+    /*Tests_SRS_IOTHUBMODULE_17_030: [ If `deviceIdleTimeout` is not 0, `IotHub_Receive` shall destroy every personality that has not sent a message for more than `deviceIdleTimeout` seconds. ]*/
+    TEST_FUNCTION(IotHub_Receive_keeps_personalities_idle_for_deviceIdleTimeout)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+        AutoConfig config(0, 10);
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+        currentTime = 10;
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .NeverInvoked();
+
+        ///act
+        Module_Receive(module, MESSAGE_HANDLE_VALID_2);
+
+        ///assert
+        ASSERT_ARE_EQUAL(size_t, 2, ((IOTHUB_HANDLE_DATA*)module)->personalityCount);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        Module_Destroy(module);
+    }
+
+    /*Tests_SRS_IOTHUBMODULE_17_032: [ A personality that is found shall become the most recently used personality. ]*/
+    TEST_FUNCTION(IotHub_Receive_a_known_device_makes_it_the_most_recently_used)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+        AutoConfig config(0, 10);
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+        Module_Receive(module, MESSAGE_HANDLE_VALID_2);
+        IOTHUB_CLIENT_HANDLE secondClient = ((PERSONALITY_PTR)IotHub_Receive_message_userContext)->iothubHandle;
+        currentTime = 8;
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+        currentTime = 15;
+        mocks.ResetAllCalls();
+
+        /*the second device has been idle for 15 seconds, the first one only for 7*/
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_Destroy(secondClient));
+        STRICT_EXPECTED_CALL(mocks, STRING_construct("secondDevice"));
+
+        ///act
+        Module_Receive(module, MESSAGE_HANDLE_VALID_2);
+
+        ///assert
+        ASSERT_ARE_EQUAL(size_t, 2, ((IOTHUB_HANDLE_DATA*)module)->personalityCount);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        Module_Destroy(module);
+    }
+
+    /*Tests_SRS_IOTHUBMODULE_17_042: [ If `batchMaxMessages`, `batchMaxBytes` or `batchMaxAge` is not 0, `IotHub_Receive` shall add the IOTHUB_MESSAGE_HANDLE to the batch of the personality instead of sending it. ]*/
+    TEST_FUNCTION(IotHub_Receive_with_batching_holds_the_message)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+        AutoConfig config(3, 0, 0);
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_SendEventAsync(IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, NULL))
+            .IgnoreArgument(1)
+            .IgnoreArgument(2)
+            .NeverInvoked();
+        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .NeverInvoked();
+
+        ///act
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+
+        ///assert
+        ASSERT_ARE_EQUAL(size_t, 2, ((PERSONALITY_PTR)IotHub_Receive_message_userContext)->batchCount);
+        ASSERT_ARE_EQUAL(size_t, 2, ((PERSONALITY_PTR)IotHub_Receive_message_userContext)->batchBytes);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        Module_Destroy(module);
+    }
+
+    /*Tests_SRS_IOTHUBMODULE_17_044: [ If the batch holds `batchMaxMessages` messages, or `batchMaxBytes` bytes of content, `IotHub_Receive` shall send it. ]*/
+    /*Tests_SRS_IOTHUBMODULE_17_045: [ To send a batch, `IotHub_Receive` shall call `IoTHubClient_SendEventAsync` for every message of the batch, in the order they were received, and then destroy them. ]*/
+    TEST_FUNCTION(IotHub_Receive_sends_the_batch_when_it_holds_batchMaxMessages)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+        AutoConfig config(3, 0, 0);
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+        PERSONALITY_PTR personality = (PERSONALITY_PTR)IotHub_Receive_message_userContext;
+        IOTHUB_MESSAGE_HANDLE first = personality->batch[0];
+        IOTHUB_MESSAGE_HANDLE second = personality->batch[1];
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_SendEventAsync(personality->iothubHandle, first, NULL, NULL));
+        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(first));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_SendEventAsync(personality->iothubHandle, second, NULL, NULL));
+        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(second));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_SendEventAsync(personality->iothubHandle, IGNORED_PTR_ARG, NULL, NULL))
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+
+        ///assert
+        ASSERT_ARE_EQUAL(size_t, 0, personality->batchCount);
+        ASSERT_ARE_EQUAL(size_t, 1, ((IOTHUB_HANDLE_DATA*)module)->batchesSent);
+        ASSERT_ARE_EQUAL(size_t, 3, ((IOTHUB_HANDLE_DATA*)module)->messagesBatched);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        Module_Destroy(module);
+    }
+
+    /*Tests_SRS_IOTHUBMODULE_17_044: [ If the batch holds `batchMaxMessages` messages, or `batchMaxBytes` bytes of content, `IotHub_Receive` shall send it. ]*/
+    TEST_FUNCTION(IotHub_Receive_sends_the_batch_when_it_holds_batchMaxBytes)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+        AutoConfig config(0, 2, 0);
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_SendEventAsync(IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, NULL))
+            .IgnoreArgument(1)
+            .IgnoreArgument(2)
+            .ExpectedTimesExactly(2);
+
+        ///act
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+
+        ///assert
+        ASSERT_ARE_EQUAL(size_t, 1, ((IOTHUB_HANDLE_DATA*)module)->batchesSent);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        Module_Destroy(module);
+    }
+
+    /*Tests_SRS_IOTHUBMODULE_17_043: [ If `batchMaxBytes` is not 0 and the message would take the batch over `batchMaxBytes` bytes of content, `IotHub_Receive` shall send the batch before adding the message. ]*/
+    TEST_FUNCTION(IotHub_Receive_sends_the_batch_before_it_goes_over_batchMaxBytes)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+        AutoConfig config(0, 2, 0);
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+        /*the batch holds 1 byte, the next message of 1 byte would take it over the limit*/
+        ((IOTHUB_HANDLE_DATA*)module)->batchMaxBytes = 1;
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_SendEventAsync(IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, NULL))
+            .IgnoreArgument(1)
+            .IgnoreArgument(2)
+            .ExpectedTimesExactly(2);
+
+        ///act
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+
+        ///assert
+        ASSERT_ARE_EQUAL(size_t, 2, ((IOTHUB_HANDLE_DATA*)module)->batchesSent);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        Module_Destroy(module);
+    }
+
+    /*Tests_SRS_IOTHUBMODULE_17_046: [ If `batchMaxAge` is not 0, `IotHub_Receive` shall send every batch whose oldest message was received `batchMaxAge` or more seconds ago. ]*/
+    TEST_FUNCTION(IotHub_Receive_sends_the_batches_older_than_batchMaxAge)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+        AutoConfig config(0, 0, 10);
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+        IOTHUB_MESSAGE_HANDLE oldMessage = ((PERSONALITY_PTR)IotHub_Receive_message_userContext)->batch[0];
+        currentTime = 5;
+        Module_Receive(module, MESSAGE_HANDLE_VALID_2);
+        currentTime = 10;
+        mocks.ResetAllCalls();
+
+        /*only the batch of the first device is 10 seconds old*/
+        STRICT_EXPECTED_CALL(mocks, get_time(NULL));
+        STRICT_EXPECTED_CALL(mocks, Lock((LOCK_HANDLE)0x42));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_SendEventAsync(IGNORED_PTR_ARG, oldMessage, NULL, NULL))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Unlock((LOCK_HANDLE)0x42));
+
+        ///act
+        Module_Receive(module, MESSAGE_HANDLE_VALID_2);
+
+        ///assert
+        ASSERT_ARE_EQUAL(size_t, 1, ((IOTHUB_HANDLE_DATA*)module)->batchesSent);
+        ASSERT_ARE_EQUAL(size_t, 2, ((PERSONALITY_PTR)IotHub_Receive_message_userContext)->batchCount);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        Module_Destroy(module);
+    }
+
+    /*Tests_SRS_IOTHUBMODULE_17_047: [ If the module has a lock, `IotHub_Receive` shall hold it while it uses the personalities, and shall return if `Lock` fails. ]*/
+    TEST_FUNCTION(IotHub_Receive_when_Lock_fails_returns)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+        AutoConfig config(0, 0, 10);
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock((LOCK_HANDLE)0x42))
+            .SetFailReturn(LOCK_ERROR);
+        STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .NeverInvoked();
+        STRICT_EXPECTED_CALL(mocks, Unlock((LOCK_HANDLE)0x42))
+            .NeverInvoked();
+
+        ///act
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+
+        ///assert
+        ASSERT_ARE_EQUAL(size_t, 0, ((IOTHUB_HANDLE_DATA*)module)->personalityCount);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        Module_Destroy(module);
+    }
+
+    /*Tests_SRS_IOTHUBMODULE_17_061: [ If `moduleHandle` or `messageHandles` is `NULL` then `IotHub_ReceiveBatch` shall do nothing. ]*/
+    TEST_FUNCTION(IotHub_ReceiveBatch_with_NULL_arguments_does_nothing)
+    {
+        ///arrange
+        IotHubMocks mocks;
+        MESSAGE_HANDLE messages[] = { MESSAGE_HANDLE_VALID_1 };
+
+        ///act
+        Module_ReceiveBatch(NULL, messages, 1);
+        Module_ReceiveBatch((MODULE_HANDLE)0x42, NULL, 1);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_IOTHUBMODULE_17_062: [ If the module has a lock, `IotHub_ReceiveBatch` shall hold it once for the whole batch, and shall return if `Lock` fails. ]*/
+    /*Tests_SRS_IOTHUBMODULE_17_063: [ `IotHub_ReceiveBatch` shall read the time once for the whole batch. ]*/
+    /*Tests_SRS_IOTHUBMODULE_17_064: [ `IotHub_ReceiveBatch` shall skip `NULL` entries of `messageHandles`, and handle every other message the way `IotHub_Receive` does. ]*/
+    TEST_FUNCTION(IotHub_ReceiveBatch_holds_the_lock_once_for_all_messages)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+        AutoConfig config(0, 0, 10);
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+        MESSAGE_HANDLE messages[] = { MESSAGE_HANDLE_VALID_1, NULL, MESSAGE_HANDLE_WITHOUT_SOURCE, MESSAGE_HANDLE_VALID_2 };
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock((LOCK_HANDLE)0x42));
+        STRICT_EXPECTED_CALL(mocks, get_time(NULL));
+        STRICT_EXPECTED_CALL(mocks, Unlock((LOCK_HANDLE)0x42));
+
+        ///act
+        Module_ReceiveBatch(module, messages, sizeof(messages) / sizeof(messages[0]));
+
+        ///assert
+        ASSERT_ARE_EQUAL(size_t, 2, ((IOTHUB_HANDLE_DATA*)module)->personalityCount);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        Module_Destroy(module);
+    }
+
+    /*Tests_SRS_IOTHUBMODULE_17_062: [ If the module has a lock, `IotHub_ReceiveBatch` shall hold it once for the whole batch, and shall return if `Lock` fails. ]*/
+    TEST_FUNCTION(IotHub_ReceiveBatch_when_Lock_fails_returns)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+        AutoConfig config(0, 0, 10);
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+        MESSAGE_HANDLE messages[] = { MESSAGE_HANDLE_VALID_1, MESSAGE_HANDLE_VALID_2 };
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Lock((LOCK_HANDLE)0x42))
+            .SetFailReturn(LOCK_ERROR);
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .NeverInvoked();
+        STRICT_EXPECTED_CALL(mocks, Unlock((LOCK_HANDLE)0x42))
+            .NeverInvoked();
 
         ///act
-        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+        Module_ReceiveBatch(module, messages, 2);
 
         ///assert
+        ASSERT_ARE_EQUAL(size_t, 0, ((IOTHUB_HANDLE_DATA*)module)->personalityCount);
         mocks.AssertActualAndExpectedCalls();
 
         ///cleanup
         Module_Destroy(module);
-
     }
 
-    /*Tests_SRS_IOTHUBMODULE_02_013: [ If no personality exists with a device ID equal to the value of the `deviceName` property of the message, then `IotHub_Receive` shall create a new `PERSONALITY` with the ID and key values from the message. ]*/
-    /*Tests_SRS_IOTHUBMODULE_02_018: [ `IotHub_Receive` shall create a new IOTHUB_MESSAGE_HANDLE having the same content as `messageHandle`, and the same properties with the exception of `deviceName` and `deviceKey`. ]*/
-    /*Tests_SRS_IOTHUBMODULE_02_020: [ `IotHub_Receive` shall call IoTHubClient_SendEventAsync passing the IOTHUB_MESSAGE_HANDLE. ]*/
-    /*Tests_SRS_IOTHUBMODULE_02_022: [ If `IoTHubClient_SendEventAsync` succeeds then `IotHub_Receive` shall return. ]*/
-    TEST_FUNCTION(IotHub_Receive_after_Receive_a_new_device_succeeds)
+    /*Tests_SRS_IOTHUBMODULE_17_065: [ If `batchMaxAge` is not 0, `IotHub_ReceiveBatch` shall send the expired batches once, after the last message. ]*/
+    TEST_FUNCTION(IotHub_ReceiveBatch_sends_the_batches_older_than_batchMaxAge)
     {
         ///arrange
-        IotHubMocks mocks;
-        AutoConfig config;
+        CNiceCallComparer<IotHubMocks> mocks;
+        AutoConfig config(0, 0, 10);
         auto module = Module_Create(BROKER_HANDLE_VALID, config);
         Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+        IOTHUB_MESSAGE_HANDLE oldMessage = ((PERSONALITY_PTR)IotHub_Receive_message_userContext)->batch[0];
+        currentTime = 10;
+        MESSAGE_HANDLE messages[] = { MESSAGE_HANDLE_VALID_2, MESSAGE_HANDLE_VALID_2 };
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_2));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_SendEventAsync(IGNORED_PTR_ARG, oldMessage, NULL, NULL))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_2, "source"));
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_2, "deviceName"));
+        ///act
+        Module_ReceiveBatch(module, messages, 2);
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_2, "deviceKey"));
+        ///assert
+        ASSERT_ARE_EQUAL(size_t, 1, ((IOTHUB_HANDLE_DATA*)module)->batchesSent);
+        ASSERT_ARE_EQUAL(size_t, 2, ((PERSONALITY_PTR)IotHub_Receive_message_userContext)->batchCount);
+        mocks.AssertActualAndExpectedCalls();
 
-        /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. One in this test*/
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+        ///cleanup
+        Module_Destroy(module);
+    }
 
-        STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
+    /*Tests_SRS_IOTHUBMODULE_17_057: [ If adding the message to the batch fails, `IotHub_Receive` shall send the batch, and then the message on its own. ]*/
+    TEST_FUNCTION(IotHub_Receive_when_the_batch_cannot_grow_sends_the_message_on_its_own)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+        AutoConfig config(50, 0, 0);
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+        mocks.ResetAllCalls();
 
-        /*because the deviceName is brand new, it will be added as a new personality*/
-        {/*separate scope for personality building*/
-         /* create a new PERSONALITY */
-            STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
-                .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_realloc(NULL, IGNORED_NUM_ARG))
+            .IgnoreArgument(2)
+            .SetFailReturn((void*)NULL);
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_SendEventAsync(IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, NULL))
+            .IgnoreArgument(1)
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
 
-         /*making a copy of the deviceName*/
-            STRICT_EXPECTED_CALL(mocks, STRING_construct("secondDevice"));
-            /*making a copy of the deviceKey*/
-            STRICT_EXPECTED_CALL(mocks, STRING_construct("red"));
+        ///act
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
 
-            /*getting the stored IoTHubName*/
-            STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-                .IgnoreArgument(1);
-            /*getting the stored IoTHubSuffix*/
-            STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-                .IgnoreArgument(1);
+        ///assert
+        ASSERT_ARE_EQUAL(size_t, 0, ((PERSONALITY_PTR)IotHub_Receive_message_userContext)->batchCount);
+        mocks.AssertActualAndExpectedCalls();
 
-            /*creating the IOTHUB_CLIENT_HANDLE associated with the device*/
-            STRICT_EXPECTED_CALL(mocks, IoTHubClient_CreateWithTransport(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-                .IgnoreArgument(1)
-                .IgnoreArgument(2);
+        ///cleanup
+        Module_Destroy(module);
+    }
 
-            STRICT_EXPECTED_CALL(mocks, IoTHubClient_SetMessageCallback(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-                .IgnoreArgument(1)
-                .IgnoreArgument(2)
-                .IgnoreArgument(3);
-        }
+    /*Tests_SRS_IOTHUBMODULE_17_048: [ Before destroying a personality, `IotHub_Receive` shall send its batch. ]*/
+    TEST_FUNCTION(IotHub_Receive_sends_the_batch_of_an_evicted_personality)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+        AutoConfig config(50, 0, 0);
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+        ((IOTHUB_HANDLE_DATA*)module)->maxDevices = 1;
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
+        PERSONALITY_PTR personality = (PERSONALITY_PTR)IotHub_Receive_message_userContext;
+        IOTHUB_CLIENT_HANDLE firstClient = personality->iothubHandle;
+        IOTHUB_MESSAGE_HANDLE firstMessage = personality->batch[0];
+        mocks.ResetAllCalls();
 
-        /*adding the personality to the VECTOR or personalities*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_SendEventAsync(firstClient, firstMessage, NULL, NULL));
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_Destroy(firstClient));
 
-        /*getting the location of the personality in the VECTOR*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+        ///act
+        Module_Receive(module, MESSAGE_HANDLE_VALID_2);
 
-        { /*scope for creating the IOTHUBMESSAGE from GWMESSAGE*/
+        ///assert
+        ASSERT_ARE_EQUAL(size_t, 1, ((IOTHUB_HANDLE_DATA*)module)->personalityEvictions);
+        mocks.AssertActualAndExpectedCalls();
 
-          /*gettng the GW message content*/
-            STRICT_EXPECTED_CALL(mocks, Message_GetContent(MESSAGE_HANDLE_VALID_2));
+        ///cleanup
+        Module_Destroy(module);
+    }
 
-            /*creating a new IOTHUB_MESSAGE*/
-            STRICT_EXPECTED_CALL(mocks, IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, 0))
-                ;
+    /*Tests_SRS_IOTHUBMODULE_17_056: [ If batching is enabled and the transport is HTTP, a new personality shall set the option "Batching" of its IoTHubClient to `true`, so that a batch can be sent in a single request. ]*/
+    TEST_FUNCTION(IotHub_Receive_with_batching_over_HTTP_turns_on_the_Batching_option)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+        AutoConfig config(50, 0, 0);
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+        mocks.ResetAllCalls();
 
-            /*every creation has its destruction - this one actually happens AFTER SendEventAsync*/
-            STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG))
-                .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_SetOption(IGNORED_PTR_ARG, "Batching", IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .IgnoreArgument(3);
 
-            /*getting the IOTHUBMESSAGE properties*/
-            STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(IGNORED_PTR_ARG))
-                .IgnoreArgument(1);
+        ///act
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
 
-            /*getting the GW message properties*/
-            STRICT_EXPECTED_CALL(mocks, Message_GetProperties(IGNORED_PTR_ARG))
-                .IgnoreArgument(1);
-            STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-                .IgnoreArgument(1);
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
 
-            /*getting the GW keys and values*/
-            STRICT_EXPECTED_CALL(mocks, ConstMap_GetInternals(CONSTMAP_HANDLE_VALID_2, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-                .IgnoreArgument(2)
-                .IgnoreArgument(3)
-                .IgnoreArgument(4);
+        ///cleanup
+        Module_Destroy(module);
+    }
 
-            /*add "source"*/
-            STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, "source", "mapping"))
-                .IgnoreArgument(1);
-        }
+    /*Tests_SRS_IOTHUBMODULE_17_056: [ If batching is enabled and the transport is HTTP, a new personality shall set the option "Batching" of its IoTHubClient to `true`, so that a batch can be sent in a single request. ]*/
+    TEST_FUNCTION(IotHub_Receive_without_batching_leaves_the_Batching_option_alone)
+    {
+        ///arrange
+        CNiceCallComparer<IotHubMocks> mocks;
+        AutoConfig config;
+        auto module = Module_Create(BROKER_HANDLE_VALID, config);
+        mocks.ResetAllCalls();
 
-        /*finally, send the message*/
-        STRICT_EXPECTED_CALL(mocks, IoTHubClient_SendEventAsync(IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, NULL))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, IoTHubClient_SetOption(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments()
+            .NeverInvoked();
 
         ///act
-        Module_Receive(module, MESSAGE_HANDLE_VALID_2);
+        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
 
         ///assert
         mocks.AssertActualAndExpectedCalls();
 
         ///cleanup
         Module_Destroy(module);
-
     }
 
     /*Tests_SRS_IOTHUBMODULE_02_021: [ If `IoTHubClient_SendEventAsync` fails then `IotHub_Receive` shall return. ]*/
@@ -2104,10 +3267,6 @@ BEGIN_TEST_SUITE(iothub_ut)
 
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
 
-        /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
         /*because the deviceName is brand new, it will be added as a new personality*/
         {/*separate scope for personality building*/
 
@@ -2137,15 +3296,6 @@ BEGIN_TEST_SUITE(iothub_ut)
                 .IgnoreArgument(3);
         }
 
-        /*adding the personality to the VECTOR or personalities*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        /*getting the location of the personality in the VECTOR*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
         { /*scope for creating the IOTHUBMESSAGE from GWMESSAGE*/
 
           /*gettng the GW message content*/
@@ -2220,10 +3370,6 @@ BEGIN_TEST_SUITE(iothub_ut)
 
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
 
-        /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
         /*because the deviceName is brand new, it will be added as a new personality*/
         {/*separate scope for personality building*/
 
@@ -2254,15 +3400,6 @@ BEGIN_TEST_SUITE(iothub_ut)
                 .IgnoreArgument(3);
         }
 
-        /*adding the personality to the VECTOR or personalities*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        /*getting the location of the personality in the VECTOR*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
         { /*scope for creating the IOTHUBMESSAGE from GWMESSAGE*/
 
           /*gettng the GW message content*/
@@ -2332,10 +3469,6 @@ BEGIN_TEST_SUITE(iothub_ut)
 
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
 
-        /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
         /*because the deviceName is brand new, it will be added as a new personality*/
         {/*separate scope for personality building*/
 
@@ -2366,15 +3499,6 @@ BEGIN_TEST_SUITE(iothub_ut)
                 .IgnoreArgument(3);
         }
 
-        /*adding the personality to the VECTOR or personalities*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        /*getting the location of the personality in the VECTOR*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
         { /*scope for creating the IOTHUBMESSAGE from GWMESSAGE*/
 
           /*gettng the GW message content*/
@@ -2440,10 +3564,6 @@ BEGIN_TEST_SUITE(iothub_ut)
 
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
 
-        /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
         /*because the deviceName is brand new, it will be added as a new personality*/
         {/*separate scope for personality building*/
          /* create a new PERSONALITY */
@@ -2472,15 +3592,6 @@ BEGIN_TEST_SUITE(iothub_ut)
                 .IgnoreArgument(3);
         }
 
-        /*adding the personality to the VECTOR or personalities*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        /*getting the location of the personality in the VECTOR*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
         { /*scope for creating the IOTHUBMESSAGE from GWMESSAGE*/
 
           /*gettng the GW message content*/
@@ -2542,10 +3653,6 @@ BEGIN_TEST_SUITE(iothub_ut)
 
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
 
-        /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
         /*because the deviceName is brand new, it will be added as a new personality*/
         {/*separate scope for personality building*/
          /* create a new PERSONALITY */
@@ -2574,15 +3681,6 @@ BEGIN_TEST_SUITE(iothub_ut)
                 .IgnoreArgument(3);
         }
 
-        /*adding the personality to the VECTOR or personalities*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        /*getting the location of the personality in the VECTOR*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
         { /*scope for creating the IOTHUBMESSAGE from GWMESSAGE*/
 
           /*gettng the GW message content*/
@@ -2605,83 +3703,6 @@ BEGIN_TEST_SUITE(iothub_ut)
         Module_Destroy(module);
     }
 
-    /*Tests_SRS_IOTHUBMODULE_02_016: [ If adding a new personality to the vector fails, then `IoTHub_Receive` shall return. ]*/
-    TEST_FUNCTION(IotHub_Receive_when_adding_the_personality_fails_it_fails)
-    {
-        ///arrange
-        IotHubMocks mocks;
-        AutoConfig config;
-        auto module = Module_Create(BROKER_HANDLE_VALID, config);
-        mocks.ResetAllCalls();
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
-
-        /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
-        /*because the deviceName is brand new, it will be added as a new personality*/
-        {/*separate scope for personality building*/
-         /* create a new PERSONALITY */
-            STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
-                .IgnoreArgument(1);
-            STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-                .IgnoreArgument(1);
-
-            /*making a copy of the deviceName*/
-            STRICT_EXPECTED_CALL(mocks, STRING_construct("firstDevice"));
-            STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-                .IgnoreArgument(1);
-
-            /*making a copy of the deviceKey*/
-            STRICT_EXPECTED_CALL(mocks, STRING_construct("cheiaDeLaPoartaVerde"));
-            STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG)) /*this is deviceName*/
-                .IgnoreArgument(1);
-
-            /*getting the stored IoTHubName*/
-            STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-                .IgnoreArgument(1);
-            /*getting the stored IoTHubSuffix*/
-            STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-                .IgnoreArgument(1);
-
-            /*creating the IOTHUB_CLIENT_HANDLE associated with the device*/
-            STRICT_EXPECTED_CALL(mocks, IoTHubClient_CreateWithTransport(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-                .IgnoreArgument(1)
-                .IgnoreArgument(2);
-            STRICT_EXPECTED_CALL(mocks, IoTHubClient_Destroy(IGNORED_PTR_ARG))
-                .IgnoreArgument(1);
-
-            STRICT_EXPECTED_CALL(mocks, IoTHubClient_SetMessageCallback(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-                .IgnoreArgument(1)
-                .IgnoreArgument(2)
-                .IgnoreArgument(3);
-        }
-
-        /*adding the personality to the VECTOR or personalities*/
-        whenShallVECTOR_push_back_fail = currentVECTOR_push_back_call + 1;
-        STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        ///act
-        Module_Receive(module, MESSAGE_HANDLE_VALID_1);
-
-        ///assert
-        mocks.AssertActualAndExpectedCalls();
-
-        ///cleanup
-        Module_Destroy(module);
-    }
-
     /*Tests_SRS_IOTHUBMODULE_02_014: [ If creating the personality fails then `IotHub_Receive` shall return. ]*/
     TEST_FUNCTION(IotHub_Receive_when_creating_the_personality_fails_it_fails_1a)
     {
@@ -2701,10 +3722,6 @@ BEGIN_TEST_SUITE(iothub_ut)
 
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
 
-        /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
         /*because the deviceName is brand new, it will be added as a new personality*/
         {/*separate scope for personality building*/
          /* create a new PERSONALITY */
@@ -2748,10 +3765,6 @@ BEGIN_TEST_SUITE(iothub_ut)
 
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
 
-        /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
         /*because the deviceName is brand new, it will be added as a new personality*/
         {/*separate scope for personality building*/
          /* create a new PERSONALITY */
@@ -2814,10 +3827,6 @@ BEGIN_TEST_SUITE(iothub_ut)
 
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
 
-        /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
         /*because the deviceName is brand new, it will be added as a new personality*/
         {/*separate scope for personality building*/
          /* create a new PERSONALITY */
@@ -2886,10 +3895,6 @@ BEGIN_TEST_SUITE(iothub_ut)
 
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
 
-        /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
         /*because the deviceName is brand new, it will be added as a new personality*/
         {/*separate scope for personality building*/
          /* create a new PERSONALITY */
@@ -2937,10 +3942,6 @@ BEGIN_TEST_SUITE(iothub_ut)
 
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
 
-        /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
-        STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
         /*because the deviceName is brand new, it will be added as a new personality*/
         {/*separate scope for personality building*/
          /* create a new PERSONALITY */
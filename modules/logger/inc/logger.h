@@ -11,6 +11,12 @@ typedef enum LOGGER_TYPE_TAG
     LOGGING_TO_FILE
 } LOGGER_TYPE;
 
+typedef enum LOGGER_FORMAT_TAG
+{
+    LOGGER_FORMAT_JSON,
+    LOGGER_FORMAT_BINARY
+} LOGGER_FORMAT;
+
 typedef struct LOGGER_CONFIG_TAG
 {
     LOGGER_TYPE selector;
@@ -19,6 +25,10 @@ typedef struct LOGGER_CONFIG_TAG
         struct LOGGER_CONFIG_FILE_TAG
         {
             const char * name;
+            LOGGER_FORMAT format;   /*records are a JSON array or length prefixed binary records*/
+            size_t bufferSize;      /*bytes buffered ahead of a background writer thread, 0 writes every message as it is received unless the format is binary or a rotation is set, then it means LOGGER_WRITER_DEFAULT_BUFFER_SIZE*/
+            size_t maxFileSize;     /*bytes written to a file before it is rotated, 0 means no limit*/
+            size_t maxFileAge;      /*seconds a file is written to before it is rotated, 0 means no limit*/
         } loggerConfigFile;
     } selectee;
 } LOGGER_CONFIG; /*this needs to be passed to the Module_Create function*/
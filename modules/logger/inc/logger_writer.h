@@ -0,0 +1,97 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       logger_writer.h
+ *  @brief      Writes the log of the logger module from a background thread.
+ *
+ *  @details    Messages are formatted into one of two large write buffers
+ *              while a background thread writes the other one to the log
+ *              file, so receiving a message never waits on the file system.
+ *              The log file is rotated once it grows past a size or an age.
+ *
+ *              The records are either the JSON values written by the logger
+ *              module or length prefixed binary records. A binary log starts
+ *              with the bytes 0xA1 0x6C and a 16 bit version. Each record
+ *              follows as the size of its payload (32 bits), its kind
+ *              (8 bits), the time it was written in seconds since the epoch
+ *              (64 bits) and its payload, a serialized message for
+ *              #LOGGER_RECORD_MESSAGE records. All integers are in network
+ *              byte order.
+ */
+
+#ifndef LOGGER_WRITER_H
+#define LOGGER_WRITER_H
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C"
+{
+#else
+#include <stddef.h>
+#endif
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#include "message.h"
+#include "logger.h"
+
+/** @brief  Bytes taken by the header of a binary log: two header bytes and a version. */
+#define LOGGER_BINARY_FILE_HEADER_SIZE 4
+
+/** @brief  Version of the binary log written by this writer. */
+#define LOGGER_BINARY_FILE_VERSION 1
+
+/** @brief  Bytes written ahead of the payload of each binary record. */
+#define LOGGER_BINARY_RECORD_HEADER_SIZE 13
+
+/** @brief  Write buffers are a multiple of, and aligned on, this many bytes. */
+#define LOGGER_WRITER_BUFFER_ALIGNMENT 4096
+
+/** @brief  strftime format of the times in a JSON log, shared by everything
+ *          that writes one.
+ */
+#define LOGGER_TIME_FORMAT "%c"
+
+/** @brief  Size of each write buffer when the configuration asks for none. */
+#define LOGGER_WRITER_DEFAULT_BUFFER_SIZE (1024 * 1024)
+
+/** @brief  Longest time, in milliseconds, records wait in a buffer before
+ *          they are written to the file.
+ */
+#define LOGGER_WRITER_PERIOD_MS 1000
+
+typedef enum LOGGER_RECORD_KIND_TAG
+{
+    LOGGER_RECORD_MESSAGE,
+    LOGGER_RECORD_LOG_STARTED,
+    LOGGER_RECORD_LOG_STOPPED
+} LOGGER_RECORD_KIND;
+
+typedef struct LOGGER_WRITER_TAG* LOGGER_WRITER_HANDLE;
+
+/** @brief      Opens the log file named in @c config and starts the thread
+ *              writing to it.
+ *
+ *  @param      config  A #LOGGER_CONFIG with the selector LOGGING_TO_FILE.
+ *
+ *  @return     A non-NULL #LOGGER_WRITER_HANDLE on success, NULL on failure.
+ */
+MOCKABLE_FUNCTION(, LOGGER_WRITER_HANDLE, LoggerWriter_Create, const LOGGER_CONFIG*, config);
+
+/** @brief      Appends a record of @c message to the log. The record reaches
+ *              the file within #LOGGER_WRITER_PERIOD_MS.
+ *
+ *  @return     0 on success, a non-zero value otherwise.
+ */
+MOCKABLE_FUNCTION(, int, LoggerWriter_WriteMessage, LOGGER_WRITER_HANDLE, writer, MESSAGE_HANDLE, message);
+
+/** @brief      Writes every record appended so far, marks the end of the log
+ *              and closes the log file.
+ */
+MOCKABLE_FUNCTION(, void, LoggerWriter_Destroy, LOGGER_WRITER_HANDLE, writer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*LOGGER_WRITER_H*/
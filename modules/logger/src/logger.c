@@ -4,9 +4,12 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <string.h>
 #include <errno.h>
 
 #include "logger.h"
+#include "logger_writer.h"
+#include "base64_encoder.h"
 
 #include <azure_c_shared_utility/gballoc.h>
 #include <azure_c_shared_utility/gb_stdio.h>
@@ -14,16 +17,29 @@
 #include <azure_c_shared_utility/strings.h>
 #include <azure_c_shared_utility/xlogging.h>
 #include <azure_c_shared_utility/crt_abstractions.h>
-#include <azure_c_shared_utility/base64.h>
 #include <azure_c_shared_utility/map.h>
 #include <azure_c_shared_utility/constmap.h>
 #include <azure_c_shared_utility/strings.h>
 
 #include <parson.h>
 
+#define LOGGER_FORMAT_NAME "format"
+#define LOGGER_FORMAT_JSON_VALUE "json"
+#define LOGGER_FORMAT_BINARY_VALUE "binary"
+#define LOGGER_BUFFERSIZE_NAME "bufferSize"
+#define LOGGER_MAXFILESIZE_NAME "maxFileSize"
+#define LOGGER_MAXFILEAGE_NAME "maxFileAge"
+
+#define JSON_RECEIVE_TIME ",{\"time\":\""
+#define JSON_RECEIVE_PROPERTIES "\",\"properties\":"
+#define JSON_RECEIVE_CONTENT ",\"content\":\""
+#define JSON_RECEIVE_END "\"}]"
+#define CONST_STRLEN(s) (sizeof(s) - 1)
+
 typedef struct LOGGER_HANDLE_DATA_TAG
 {
     FILE* fout;
+    LOGGER_WRITER_HANDLE writer; /*when not NULL, messages are written by a background thread and fout is not used*/
 }LOGGER_HANDLE_DATA;
 
 /*this function adds a JSON object to the output*/
@@ -53,6 +69,12 @@ static int addJSONString(FILE* fout, const char* jsonString)
 
 
 
+static char* append_chars(char* destination, const char* source, size_t size)
+{
+    (void)memcpy(destination, source, size);
+    return destination + size;
+}
+
 static int LogStartStop_Print(char* destination, size_t destinationSize, bool appendStart, bool isAbsoluteStart)
 {
     int result;
@@ -76,15 +98,15 @@ static int LogStartStop_Print(char* destination, size_t destinationSize, bool ap
 
             if (isAbsoluteStart)
             {
-                err = strftime(destination, destinationSize, "{\"time\":\"%C\",\"content\":\"Log started\"}]", t);
+                err = strftime(destination, destinationSize, "{\"time\":\"" LOGGER_TIME_FORMAT "\",\"content\":\"Log started\"}]", t);
             }
             else if (appendStart)
             {
-                err = strftime(destination, destinationSize, ",{\"time\":\"%C\",\"content\":\"Log started\"}]", t);
+                err = strftime(destination, destinationSize, ",{\"time\":\"" LOGGER_TIME_FORMAT "\",\"content\":\"Log started\"}]", t);
             }
             else
             {
-                err = strftime(destination, destinationSize, ",{\"time\":\"%C\",\"content\":\"Log stopped\"}]", t);
+                err = strftime(destination, destinationSize, ",{\"time\":\"" LOGGER_TIME_FORMAT "\",\"content\":\"Log stopped\"}]", t);
             }
 
             if (err == 0)
@@ -166,8 +188,28 @@ static MODULE_HANDLE Logger_Create(BROKER_HANDLE broker, const void* configurati
                     LogError("malloc failed");
                     /*return as is*/
                 }
+                else if (
+                    (config->selectee.loggerConfigFile.format != LOGGER_FORMAT_JSON) ||
+                    (config->selectee.loggerConfigFile.bufferSize != 0) ||
+                    (config->selectee.loggerConfigFile.maxFileSize != 0) ||
+                    (config->selectee.loggerConfigFile.maxFileAge != 0)
+                    )
+                {
+                    /*Codes_SRS_LOGGER_17_012: [ If the configuration asks for the binary format, a buffer or a rotation, Logger_Create shall call LoggerWriter_Create instead of opening the file and assign the result to the writer field. ]*/
+                    result->fout = NULL;
+                    result->writer = LoggerWriter_Create(config);
+                    if (result->writer == NULL)
+                    {
+                        /*Codes_SRS_LOGGER_17_013: [ If LoggerWriter_Create fails then Logger_Create shall fail and return NULL. ]*/
+                        LogError("unable to create the writer of %s", config->selectee.loggerConfigFile.name);
+                        free(result);
+                        result = NULL;
+                    }
+                    /*Codes_SRS_LOGGER_02_008: [Otherwise Logger_Create shall return a non-NULL pointer.]*/
+                }
                 else
                 {
+                    result->writer = NULL;
                     /*Codes_SRS_LOGGER_02_006: [Logger_Create shall open the file configuration the filename selectee.loggerConfigFile.name in update (reading and writing) mode and assign the result of fopen to fout field. ]*/
                     result->fout = fopen(config->selectee.loggerConfigFile.name, "r+b"); /*open binary file for update (reading and writing)*/
                     if (result->fout == NULL)
@@ -307,36 +349,65 @@ static void* Logger_ParseConfigurationFromJson(const char* configuration)
                 }
                 else
                 {
-                    /*fileNameValue is believed at this moment to be a string that might point to a filename on the system*/
-
-                    /*Codes_SRS_LOGGER_17_001: [ Logger_ParseConfigurationFromJson shall allocate a new LOGGER_CONFIG structure. ]*/
-                    result = (LOGGER_CONFIG*)malloc(sizeof(LOGGER_CONFIG));
-                    if (result == NULL)
+                    /*Codes_SRS_LOGGER_17_008: [ Logger_ParseConfigurationFromJson shall set format to LOGGER_FORMAT_BINARY if the value named "format" is "binary", and to LOGGER_FORMAT_JSON if it is "json" or if there is no such value. ]*/
+                    const char* formatValue = json_object_get_string(obj, LOGGER_FORMAT_NAME);
+                    /*Codes_SRS_LOGGER_17_010: [ Logger_ParseConfigurationFromJson shall set bufferSize, maxFileSize and maxFileAge to the values named "bufferSize", "maxFileSize" and "maxFileAge", or to 0 if there are no such values. ]*/
+                    double bufferSize = json_object_get_number(obj, LOGGER_BUFFERSIZE_NAME);
+                    double maxFileSize = json_object_get_number(obj, LOGGER_MAXFILESIZE_NAME);
+                    double maxFileAge = json_object_get_number(obj, LOGGER_MAXFILEAGE_NAME);
+                    if (
+                        (formatValue != NULL) &&
+                        (strcmp(formatValue, LOGGER_FORMAT_JSON_VALUE) != 0) &&
+                        (strcmp(formatValue, LOGGER_FORMAT_BINARY_VALUE) != 0)
+                        )
                     {
-                        /*Codes_SRS_LOGGER_17_003: [ If any system call fails, Logger_ParseConfigurationFromJson shall fail and return NULL. ]*/
-                        LogError("malloc failed");
+                        /*Codes_SRS_LOGGER_17_009: [ If the value named "format" is neither "json" nor "binary" then Logger_ParseConfigurationFromJson shall fail and return NULL. ]*/
+                        LogError("unknown %s \"%s\"", LOGGER_FORMAT_NAME, formatValue);
+                        result = NULL;
+                    }
+                    else if ((bufferSize < 0) || (maxFileSize < 0) || (maxFileAge < 0))
+                    {
+                        /*Codes_SRS_LOGGER_17_011: [ If "bufferSize", "maxFileSize" or "maxFileAge" is negative then Logger_ParseConfigurationFromJson shall fail and return NULL. ]*/
+                        LogError("%s, %s and %s cannot be negative", LOGGER_BUFFERSIZE_NAME, LOGGER_MAXFILESIZE_NAME, LOGGER_MAXFILEAGE_NAME);
+                        result = NULL;
                     }
                     else
                     {
-                        /*Codes_SRS_LOGGER_17_002: [ Logger_ParseConfigurationFromJson shall duplicate the filename string into the LOGGER_CONFIG structure. ]*/
-                        /*Codes_SRS_LOGGER_17_007: [ Logger_ParseConfigurationFromJson shall set the selector in LOGGER_CONFIG to LOGGING_TO_FILE. ]*/
-                        result->selector = LOGGING_TO_FILE;
-                        char * logfileName;
-                        int copy_result = mallocAndStrcpy_s(&logfileName, fileNameValue);
-                        if (copy_result != 0)
+                        /*fileNameValue is believed at this moment to be a string that might point to a filename on the system*/
+
+                        /*Codes_SRS_LOGGER_17_001: [ Logger_ParseConfigurationFromJson shall allocate a new LOGGER_CONFIG structure. ]*/
+                        result = (LOGGER_CONFIG*)malloc(sizeof(LOGGER_CONFIG));
+                        if (result == NULL)
                         {
                             /*Codes_SRS_LOGGER_17_003: [ If any system call fails, Logger_ParseConfigurationFromJson shall fail and return NULL. ]*/
-                            LogError("Copying the filename failed, error= %d", copy_result);
-                            free(result);
-                            result = NULL;
+                            LogError("malloc failed");
                         }
                         else
                         {
-                            /*Codes_SRS_LOGGER_17_006: [ Logger_ParseConfigurationFromJson shall return a pointer to the created LOGGER_CONFIG structure. ]*/
-                            /**
-                             * Everything's good.
-                             */
-                             result->selectee.loggerConfigFile.name = (const char *)logfileName;
+                            /*Codes_SRS_LOGGER_17_002: [ Logger_ParseConfigurationFromJson shall duplicate the filename string into the LOGGER_CONFIG structure. ]*/
+                            /*Codes_SRS_LOGGER_17_007: [ Logger_ParseConfigurationFromJson shall set the selector in LOGGER_CONFIG to LOGGING_TO_FILE. ]*/
+                            result->selector = LOGGING_TO_FILE;
+                            char * logfileName;
+                            int copy_result = mallocAndStrcpy_s(&logfileName, fileNameValue);
+                            if (copy_result != 0)
+                            {
+                                /*Codes_SRS_LOGGER_17_003: [ If any system call fails, Logger_ParseConfigurationFromJson shall fail and return NULL. ]*/
+                                LogError("Copying the filename failed, error= %d", copy_result);
+                                free(result);
+                                result = NULL;
+                            }
+                            else
+                            {
+                                /*Codes_SRS_LOGGER_17_006: [ Logger_ParseConfigurationFromJson shall return a pointer to the created LOGGER_CONFIG structure. ]*/
+                                /**
+                                 * Everything's good.
+                                 */
+                                 result->selectee.loggerConfigFile.name = (const char *)logfileName;
+                                 result->selectee.loggerConfigFile.format = ((formatValue != NULL) && (strcmp(formatValue, LOGGER_FORMAT_BINARY_VALUE) == 0)) ? LOGGER_FORMAT_BINARY : LOGGER_FORMAT_JSON;
+                                 result->selectee.loggerConfigFile.bufferSize = (size_t)bufferSize;
+                                 result->selectee.loggerConfigFile.maxFileSize = (size_t)maxFileSize;
+                                 result->selectee.loggerConfigFile.maxFileAge = (size_t)maxFileAge;
+                            }
                         }
                     }
                 }
@@ -371,15 +442,23 @@ static void Logger_Destroy(MODULE_HANDLE module)
     {
         /*Codes_SRS_LOGGER_02_019: [Logger_Destroy shall add to the log file the following end of log JSON object:]*/
         LOGGER_HANDLE_DATA* moduleHandleData = (LOGGER_HANDLE_DATA *)module;
-        if (append_logStartStop(moduleHandleData->fout, false, false) != 0)
+        if (moduleHandleData->writer != NULL)
         {
-            LogError("unable to append log ending time");
+            /*Codes_SRS_LOGGER_17_015: [ If the module has a writer, Logger_Destroy shall call LoggerWriter_Destroy instead of writing to fout. ]*/
+            LoggerWriter_Destroy(moduleHandleData->writer);
         }
-
-        /*Codes_SRS_LOGGER_02_015: [Otherwise Logger_Destroy shall unuse all used resources.]*/
-        if (fclose(moduleHandleData->fout) != 0)
+        else
         {
-            LogError("unable to fclose");
+            if (append_logStartStop(moduleHandleData->fout, false, false) != 0)
+            {
+                LogError("unable to append log ending time");
+            }
+
+            /*Codes_SRS_LOGGER_02_015: [Otherwise Logger_Destroy shall unuse all used resources.]*/
+            if (fclose(moduleHandleData->fout) != 0)
+            {
+                LogError("unable to fclose");
+            }
         }
 
         free(moduleHandleData);
@@ -387,6 +466,117 @@ static void Logger_Destroy(MODULE_HANDLE module)
     }
 }
 
+/*prints the receive time of a message the way it appears in the log*/
+static int Logger_FormatTime(char* destination, size_t destinationSize)
+{
+    int result;
+    time_t temp = time(NULL);
+    if (temp == (time_t)-1)
+    {
+        LogError("time function failed");
+        result = __LINE__;
+    }
+    else
+    {
+        struct tm* t = localtime(&temp);
+        if (t == NULL)
+        {
+            LogError("localtime failed");
+            result = __LINE__;
+        }
+        else if (strftime(destination, destinationSize, LOGGER_TIME_FORMAT, t) == 0)
+        {
+            LogError("unable to strftime");
+            result = __LINE__;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+    return result;
+}
+
+/*appends the JSON object of one message to fout, timetemp being its receive time*/
+static void Logger_AppendMessage(LOGGER_HANDLE_DATA* handleData, MESSAGE_HANDLE messageHandle, const char* timetemp)
+{
+    /*getting the properties*/
+    /*getting the constmap*/
+    CONSTMAP_HANDLE originalProperties = Message_GetProperties(messageHandle); /*by contract this is never NULL*/
+    MAP_HANDLE propertiesAsMap = ConstMap_CloneWriteable(originalProperties); /*sigh, if only there'd be a constmap_tojson*/
+    if (propertiesAsMap == NULL)
+    {
+        LogError("ConstMap_CloneWriteable failed");
+    }
+    else
+    {
+        STRING_HANDLE jsonProperties = Map_ToJSON(propertiesAsMap);
+        if (jsonProperties == NULL)
+        {
+            LogError("unable to Map_ToJSON");
+        }
+        else
+        {
+            /*getting the base64 encode of the message*/
+            const CONSTBUFFER * content = Message_GetContent(messageHandle); /*by contract, this is never NULL*/
+            if ((content == NULL) || ((content->buffer == NULL) && (content->size != 0)))
+            {
+                LogError("unable to get the content of the message");
+            }
+            else
+            {
+                /*the JSON object is sized up front and the content is encoded straight into it*/
+                const char* properties = STRING_c_str(jsonProperties);
+                size_t timeLength = strlen(timetemp);
+                size_t propertiesLength = strlen(properties);
+                size_t contentLength = Base64Encoder_GetEncodedSize(content->size);
+                if ((content->size != 0) && (contentLength == 0))
+                {
+                    LogError("the content of the message is too large to encode");
+                }
+                else
+                {
+                    size_t jsonSize =
+                        CONST_STRLEN(JSON_RECEIVE_TIME) + timeLength +
+                        CONST_STRLEN(JSON_RECEIVE_PROPERTIES) + propertiesLength +
+                        CONST_STRLEN(JSON_RECEIVE_CONTENT) + contentLength +
+                        CONST_STRLEN(JSON_RECEIVE_END);
+                    char* jsonToBeAppended = (char*)malloc(jsonSize + 1);
+                    if (jsonToBeAppended == NULL)
+                    {
+                        LogError("unable to malloc %zu bytes", jsonSize + 1);
+                    }
+                    else
+                    {
+                        char* json = jsonToBeAppended;
+                        json = append_chars(json, JSON_RECEIVE_TIME, CONST_STRLEN(JSON_RECEIVE_TIME));
+                        json = append_chars(json, timetemp, timeLength);
+                        json = append_chars(json, JSON_RECEIVE_PROPERTIES, CONST_STRLEN(JSON_RECEIVE_PROPERTIES));
+                        json = append_chars(json, properties, propertiesLength);
+                        json = append_chars(json, JSON_RECEIVE_CONTENT, CONST_STRLEN(JSON_RECEIVE_CONTENT));
+                        json += Base64Encoder_Encode(content->buffer, content->size, json);
+                        json = append_chars(json, JSON_RECEIVE_END, CONST_STRLEN(JSON_RECEIVE_END));
+                        *json = '\0';
+
+                        if (addJSONString(handleData->fout, jsonToBeAppended) != 0)
+                        {
+                            LogError("failed top add a json string to the output file");
+                        }
+                        else
+                        {
+                            /*all seems fine*/
+                        }
+                        free(jsonToBeAppended);
+                    }
+                }
+            }
+            STRING_delete(jsonProperties);
+        }
+        Map_Destroy(propertiesAsMap);
+    }
+    ConstMap_Destroy(originalProperties);
+}
+
 static void Logger_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHandle)
 {
     /*Codes_SRS_LOGGER_02_009: [If moduleHandle is NULL then Logger_Receive shall fail and return.]*/
@@ -398,6 +588,15 @@ static void Logger_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHan
     {
         LogError("invalid arg moduleHandle = %p", moduleHandle);
     }
+    else if (((LOGGER_HANDLE_DATA *)moduleHandle)->writer != NULL)
+    {
+        /*Codes_SRS_LOGGER_17_014: [ If the module has a writer, Logger_Receive shall call LoggerWriter_WriteMessage instead of writing to fout. ]*/
+        if (LoggerWriter_WriteMessage(((LOGGER_HANDLE_DATA *)moduleHandle)->writer, messageHandle) != 0)
+        {
+            /*Codes_SRS_LOGGER_02_012: [If producing the JSON format or writing it to the file fails, then Logger_Receive shall fail and return.]*/
+            LogError("unable to log the message");
+        }
+    }
     else
     {
         /*Codes_SRS_LOGGER_02_011: [Logger_Receive shall write in the fout FILE the following information in JSON format:]*/
@@ -416,117 +615,64 @@ static void Logger_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHan
         /*the function will gather first all the values then will dump them into a STRING_HANDLE that is JSON*/
 
         /*getting the time*/
-        time_t temp = time(NULL);
-        if (temp == (time_t)-1)
+        char timetemp[80] = { 0 };
+        if (Logger_FormatTime(timetemp, sizeof(timetemp) / sizeof(timetemp[0])) != 0)
         {
-            LogError("time function failed");
+            /*Codes_SRS_LOGGER_02_012: [If producing the JSON format or writing it to the file fails, then Logger_Receive shall fail and return.]*/
+            /*just return*/
         }
         else
         {
-            struct tm* t = localtime(&temp);
-            if (t == NULL)
+            Logger_AppendMessage((LOGGER_HANDLE_DATA *)moduleHandle, messageHandle, timetemp);
+        }
+    }
+    /*Codes_SRS_LOGGER_02_013: [Logger_Receive shall return.]*/
+}
+
+static void Logger_ReceiveBatch(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE* messageHandles, size_t count)
+{
+    /*Codes_SRS_LOGGER_17_016: [ If moduleHandle or messageHandles is NULL then Logger_ReceiveBatch shall fail and return. ]*/
+    if (
+        (moduleHandle == NULL) ||
+        (messageHandles == NULL)
+        )
+    {
+        LogError("invalid arg moduleHandle = %p, messageHandles = %p", moduleHandle, messageHandles);
+    }
+    else if (((LOGGER_HANDLE_DATA *)moduleHandle)->writer != NULL)
+    {
+        size_t i;
+        for (i = 0; i < count; i++)
+        {
+            /*Codes_SRS_LOGGER_17_017: [ Logger_ReceiveBatch shall skip NULL entries of messageHandles and log every other message the way Logger_Receive does. ]*/
+            if ((messageHandles[i] != NULL) &&
+                (LoggerWriter_WriteMessage(((LOGGER_HANDLE_DATA *)moduleHandle)->writer, messageHandles[i]) != 0))
             {
-                LogError("localtime failed");
+                LogError("unable to log the message");
             }
-            else
+        }
+    }
+    else
+    {
+        /*Codes_SRS_LOGGER_17_018: [ If the module has no writer, Logger_ReceiveBatch shall read the time once and give every message of the batch that receive time. ]*/
+        char timetemp[80] = { 0 };
+        if (Logger_FormatTime(timetemp, sizeof(timetemp) / sizeof(timetemp[0])) != 0)
+        {
+            /*just return*/
+        }
+        else
+        {
+            size_t i;
+            for (i = 0; i < count; i++)
             {
-                char timetemp[80] = { 0 };
-                if (strftime(timetemp, sizeof(timetemp) / sizeof(timetemp[0]), "%C", t) == 0)
+                /*Codes_SRS_LOGGER_17_017: [ Logger_ReceiveBatch shall skip NULL entries of messageHandles and log every other message the way Logger_Receive does. ]*/
+                if (messageHandles[i] != NULL)
                 {
-                    LogError("unable to strftime");
-                    /*Codes_SRS_LOGGER_02_012: [If producing the JSON format or writing it to the file fails, then Logger_Receive shall fail and return.]*/
-                    /*just return*/
-                }
-                else
-                {
-                    /*getting the properties*/
-                    /*getting the constmap*/
-                    CONSTMAP_HANDLE originalProperties = Message_GetProperties(messageHandle); /*by contract this is never NULL*/
-                    MAP_HANDLE propertiesAsMap = ConstMap_CloneWriteable(originalProperties); /*sigh, if only there'd be a constmap_tojson*/
-                    if (propertiesAsMap == NULL)
-                    {
-                        LogError("ConstMap_CloneWriteable failed");
-                    }
-                    else
-                    {
-                        STRING_HANDLE jsonProperties = Map_ToJSON(propertiesAsMap);
-                        if (jsonProperties == NULL)
-                        {
-                            LogError("unable to Map_ToJSON");
-                        }
-                        else
-                        {
-                            /*getting the base64 encode of the message*/
-                            const CONSTBUFFER * content = Message_GetContent(messageHandle); /*by contract, this is never NULL*/
-							STRING_HANDLE contentAsJSON;
-							if (content == NULL)
-							{
-								contentAsJSON = NULL;
-							}
-							else
-							{
-								if (content->buffer == NULL)
-								{
-									contentAsJSON = STRING_construct_n("", 0);
-								}
-								else
-								{
-									contentAsJSON = Base64_Encode_Bytes(content->buffer, content->size);
-								}
-							}
-
-							/* NULL value here will be an error.*/
-                            if (contentAsJSON == NULL)
-                            {
-                                LogError("unable to Base64_Encode_Bytes");
-                            }
-                            else
-                            {
-                                STRING_HANDLE jsonToBeAppended = STRING_construct(",{\"time\":\"");
-                                if (jsonToBeAppended == NULL)
-                                {
-                                    LogError("unable to STRING_construct");
-                                }
-                                else
-                                {
-
-                                    if (!(
-                                        (STRING_concat(jsonToBeAppended, timetemp) == 0) &&
-                                        (STRING_concat(jsonToBeAppended, "\",\"properties\":") == 0) &&
-                                        (STRING_concat_with_STRING(jsonToBeAppended, jsonProperties) == 0) &&
-                                        (STRING_concat(jsonToBeAppended, ",\"content\":\"") == 0) &&
-                                        (STRING_concat_with_STRING(jsonToBeAppended, contentAsJSON) == 0) &&
-                                        (STRING_concat(jsonToBeAppended, "\"}]") == 0)
-                                        ))
-                                    {
-                                        LogError("STRING concatenation error");
-                                    }
-                                    else
-                                    {
-                                        LOGGER_HANDLE_DATA *handleData = (LOGGER_HANDLE_DATA *)moduleHandle;
-                                        if (addJSONString(handleData->fout, STRING_c_str(jsonToBeAppended)) != 0)
-                                        {
-                                            LogError("failed top add a json string to the output file");
-                                        }
-                                        else
-                                        {
-                                            /*all seems fine*/
-                                        }
-                                    }
-                                    STRING_delete(jsonToBeAppended);
-                                }
-                                STRING_delete(contentAsJSON);
-                            }
-                            STRING_delete(jsonProperties);
-                        }
-                        Map_Destroy(propertiesAsMap);
-                    }
-                    ConstMap_Destroy(originalProperties);
+                    Logger_AppendMessage((LOGGER_HANDLE_DATA *)moduleHandle, messageHandles[i], timetemp);
                 }
             }
         }
     }
-    /*Codes_SRS_LOGGER_02_013: [Logger_Receive shall return.]*/
 }
 
 /*
@@ -544,6 +690,21 @@ static const MODULE_API_1 Logger_APIS_all =
     NULL
 };
 
+static const MODULE_API_2 Logger_APIS_all_2 =
+{
+    {
+        {MODULE_API_VERSION_2},
+
+        Logger_ParseConfigurationFromJson,
+        Logger_FreeConfiguration,
+        Logger_Create,
+        Logger_Destroy,
+        Logger_Receive,
+        NULL
+    },
+    Logger_ReceiveBatch
+};
+
 
 #ifdef BUILD_MODULE_TYPE_STATIC
 MODULE_EXPORT const MODULE_API* MODULE_STATIC_GETAPI(LOGGER_MODULE)(MODULE_API_VERSION gateway_api_version)
@@ -552,6 +713,15 @@ MODULE_EXPORT const MODULE_API* Module_GetApi(MODULE_API_VERSION gateway_api_ver
 #endif
 {
     /*Codes_SRS_LOGGER_26_001: [ Module_GetApi shall return a pointer to a MODULE_API structure with the required function pointers. */
-    (void)gateway_api_version;
-    return (const MODULE_API *)&Logger_APIS_all;
+    const MODULE_API* result;
+    if (gateway_api_version >= MODULE_API_VERSION_2)
+    {
+        /*Codes_SRS_LOGGER_17_019: [ Module_GetApi shall return the MODULE_API_2 table, which adds Logger_ReceiveBatch, if gateway_api_version is MODULE_API_VERSION_2 or later, and the MODULE_API_1 table otherwise. ]*/
+        result = (const MODULE_API *)&Logger_APIS_all_2;
+    }
+    else
+    {
+        result = (const MODULE_API *)&Logger_APIS_all;
+    }
+    return result;
 }
@@ -0,0 +1,859 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "logger_writer.h"
+#include "base64_encoder.h"
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/gb_stdio.h"
+#include "azure_c_shared_utility/gb_time.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/map.h"
+#include "azure_c_shared_utility/constmap.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
+
+#define FIRST_LOG_BYTE 0xA1  /*0xA1 comes from (A)zure (I)oT*/
+#define SECOND_LOG_BYTE 0x6C /*0x6C comes from (L)og*/
+
+#define TIME_STRING_SIZE 64
+#define MARKER_SIZE 128
+
+#define JSON_RECORD_TIME ",{\"time\":\""
+#define JSON_RECORD_PROPERTIES "\",\"properties\":"
+#define JSON_RECORD_CONTENT ",\"content\":\""
+#define JSON_RECORD_END "\"}"
+#define CONST_STRLEN(s) (sizeof(s) - 1)
+
+typedef struct LOGGER_BUFFER_TAG
+{
+    void* allocation;           /*what malloc returned, data is aligned within it*/
+    unsigned char* data;
+    size_t size;                /*bytes holding records*/
+    size_t capacity;
+} LOGGER_BUFFER;
+
+typedef struct LOGGER_WRITER_TAG
+{
+    char* fileName;
+    LOGGER_FORMAT format;
+    size_t maxFileSize;
+    size_t maxFileAge;
+    /*once the writer thread runs, only the writer thread uses the file*/
+    FILE* fout;
+    size_t fileSize;
+    time_t fileOpened;
+    bool fileHasRecords;
+    unsigned int nextRotation;
+    /*the fields below are guarded by lock*/
+    LOGGER_BUFFER buffers[2];
+    size_t filling;             /*index of the buffer records are appended to, the writer thread owns the other one*/
+    time_t formattedTime;
+    char formattedTimeString[TIME_STRING_SIZE];
+    bool stopThread;
+    LOCK_HANDLE lock;
+    COND_HANDLE dataAvailable;
+    COND_HANDLE spaceAvailable;
+    THREAD_HANDLE thread;
+} LOGGER_WRITER;
+
+static void write_uint32(unsigned char* destination, uint32_t value)
+{
+    destination[0] = (unsigned char)((value >> 24) & 0xFF);
+    destination[1] = (unsigned char)((value >> 16) & 0xFF);
+    destination[2] = (unsigned char)((value >> 8) & 0xFF);
+    destination[3] = (unsigned char)(value & 0xFF);
+}
+
+static void write_record_header(unsigned char* destination, uint32_t payloadSize, LOGGER_RECORD_KIND kind, time_t when)
+{
+    uint64_t seconds = (uint64_t)(int64_t)when;
+    write_uint32(destination, payloadSize);
+    destination[4] = (unsigned char)kind;
+    write_uint32(destination + 5, (uint32_t)(seconds >> 32));
+    write_uint32(destination + 9, (uint32_t)(seconds & 0xFFFFFFFF));
+}
+
+static unsigned char* append_bytes(unsigned char* destination, const char* source, size_t size)
+{
+    (void)memcpy(destination, source, size);
+    return destination + size;
+}
+
+static int format_time(time_t when, char* destination, size_t destinationSize)
+{
+    int result;
+    struct tm* t = localtime(&when);
+    if (t == NULL)
+    {
+        LogError("localtime failed");
+        result = __LINE__;
+    }
+    else if (strftime(destination, destinationSize, LOGGER_TIME_FORMAT, t) == 0)
+    {
+        LogError("unable to strftime");
+        result = __LINE__;
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
+/*a marker written with a time that cannot be had still keeps the log well formed*/
+static void get_marker_time(const LOGGER_WRITER* writer, time_t* now, char* timeString, size_t timeStringSize)
+{
+    timeString[0] = '\0';
+    *now = time(NULL);
+    if (*now == (time_t)-1)
+    {
+        LogError("time function failed");
+        *now = 0;
+    }
+    else if ((writer->format == LOGGER_FORMAT_JSON) && (format_time(*now, timeString, timeStringSize) != 0))
+    {
+        LogError("unable to format the time of a marker");
+        timeString[0] = '\0';
+    }
+}
+
+/*localtime is not reentrant, so the writer thread formats the time of its markers under the lock that guards the time of the records*/
+static void get_marker_time_from_thread(LOGGER_WRITER* writer, time_t* now, char* timeString, size_t timeStringSize)
+{
+    if (Lock(writer->lock) != LOCK_OK)
+    {
+        LogError("unable to lock");
+        get_marker_time(writer, now, timeString, timeStringSize);
+    }
+    else
+    {
+        get_marker_time(writer, now, timeString, timeStringSize);
+        (void)Unlock(writer->lock);
+    }
+}
+
+static int LoggerBuffer_Allocate(LOGGER_BUFFER* buffer, size_t minimumCapacity)
+{
+    int result;
+    if (minimumCapacity > SIZE_MAX - 2 * LOGGER_WRITER_BUFFER_ALIGNMENT)
+    {
+        LogError("a buffer of %zu bytes is too large", minimumCapacity);
+        result = __LINE__;
+    }
+    else
+    {
+        size_t capacity = ((minimumCapacity + LOGGER_WRITER_BUFFER_ALIGNMENT - 1) / LOGGER_WRITER_BUFFER_ALIGNMENT) * LOGGER_WRITER_BUFFER_ALIGNMENT;
+        void* allocation = malloc(capacity + LOGGER_WRITER_BUFFER_ALIGNMENT - 1);
+        if (allocation == NULL)
+        {
+            LogError("unable to allocate a buffer of %zu bytes", capacity);
+            result = __LINE__;
+        }
+        else
+        {
+            free(buffer->allocation);
+            buffer->allocation = allocation;
+            buffer->data = (unsigned char*)(((uintptr_t)allocation + LOGGER_WRITER_BUFFER_ALIGNMENT - 1) & ~(uintptr_t)(LOGGER_WRITER_BUFFER_ALIGNMENT - 1));
+            buffer->size = 0;
+            buffer->capacity = capacity;
+            result = 0;
+        }
+    }
+    return result;
+}
+
+static int LoggerWriter_WriteFile(LOGGER_WRITER* writer, const void* data, size_t size)
+{
+    int result;
+    if (fwrite(data, 1, size, writer->fout) != size)
+    {
+        LogError("unable to write %zu bytes to %s", size, writer->fileName);
+        result = __LINE__;
+    }
+    else
+    {
+        writer->fileSize += size;
+        result = 0;
+    }
+    return result;
+}
+
+static int LoggerWriter_WriteMarker(LOGGER_WRITER* writer, LOGGER_RECORD_KIND kind, const char* jsonPrefix, time_t now, const char* timeString)
+{
+    int result;
+    char marker[MARKER_SIZE];
+    int size;
+    if (writer->format == LOGGER_FORMAT_BINARY)
+    {
+        write_record_header((unsigned char*)marker, 0, kind, now);
+        size = LOGGER_BINARY_RECORD_HEADER_SIZE;
+    }
+    else
+    {
+        size = sprintf_s(marker, sizeof(marker), "%s{\"time\":\"%s\",\"content\":\"%s\"}%s",
+            jsonPrefix,
+            timeString,
+            (kind == LOGGER_RECORD_LOG_STARTED) ? "Log started" : "Log stopped",
+            (kind == LOGGER_RECORD_LOG_STOPPED) ? "]" : "");
+    }
+
+    if (size < 0)
+    {
+        LogError("unable to format a marker");
+        result = __LINE__;
+    }
+    else
+    {
+        result = LoggerWriter_WriteFile(writer, marker, (size_t)size);
+    }
+    return result;
+}
+
+static int LoggerWriter_StartJsonLog(LOGGER_WRITER* writer, time_t now, const char* timeString)
+{
+    int result;
+    if (writer->fileSize == 0)
+    {
+        result = LoggerWriter_WriteMarker(writer, LOGGER_RECORD_LOG_STARTED, "[", now, timeString);
+    }
+    else
+    {
+        /*a log that was stopped ends with ], a log that was not ends with its last record*/
+        int last;
+        if (fseek(writer->fout, -1, SEEK_END) != 0)
+        {
+            LogError("unable to fseek");
+            result = __LINE__;
+        }
+        else if ((last = fgetc(writer->fout)) == EOF)
+        {
+            LogError("unable to read the end of %s", writer->fileName);
+            result = __LINE__;
+        }
+        else if (fseek(writer->fout, (last == ']') ? -1 : 0, SEEK_END) != 0)
+        {
+            LogError("unable to fseek");
+            result = __LINE__;
+        }
+        else
+        {
+            if (last == ']')
+            {
+                writer->fileSize--;
+            }
+            result = LoggerWriter_WriteMarker(writer, LOGGER_RECORD_LOG_STARTED, ",", now, timeString);
+        }
+    }
+    return result;
+}
+
+static int LoggerWriter_StartBinaryLog(LOGGER_WRITER* writer, time_t now)
+{
+    int result;
+    unsigned char header[LOGGER_BINARY_FILE_HEADER_SIZE];
+    if (writer->fileSize == 0)
+    {
+        header[0] = FIRST_LOG_BYTE;
+        header[1] = SECOND_LOG_BYTE;
+        header[2] = (unsigned char)((LOGGER_BINARY_FILE_VERSION >> 8) & 0xFF);
+        header[3] = (unsigned char)(LOGGER_BINARY_FILE_VERSION & 0xFF);
+        result = LoggerWriter_WriteFile(writer, header, sizeof(header));
+    }
+    else if (
+        (fseek(writer->fout, 0, SEEK_SET) != 0) ||
+        (fread(header, 1, sizeof(header), writer->fout) != sizeof(header)) ||
+        (fseek(writer->fout, 0, SEEK_END) != 0)
+        )
+    {
+        LogError("unable to read the header of %s", writer->fileName);
+        result = __LINE__;
+    }
+    else if ((header[0] != FIRST_LOG_BYTE) || (header[1] != SECOND_LOG_BYTE))
+    {
+        LogError("%s exists and is not a binary log", writer->fileName);
+        result = __LINE__;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    if (result == 0)
+    {
+        result = LoggerWriter_WriteMarker(writer, LOGGER_RECORD_LOG_STARTED, NULL, now, NULL);
+    }
+    return result;
+}
+
+static int LoggerWriter_OpenFile(LOGGER_WRITER* writer, time_t now, const char* timeString)
+{
+    int result;
+    long int fileSize;
+    FILE* fout = fopen(writer->fileName, "r+b");
+    if (fout == NULL)
+    {
+        fout = fopen(writer->fileName, "w+b");
+    }
+
+    if (fout == NULL)
+    {
+        LogError("unable to open file %s", writer->fileName);
+        result = __LINE__;
+    }
+    /*the records are already gathered in large buffers, stdio buffering would only copy them once more*/
+    else if (setvbuf(fout, NULL, _IONBF, 0) != 0)
+    {
+        LogError("unable to turn off buffering of %s", writer->fileName);
+        (void)fclose(fout);
+        result = __LINE__;
+    }
+    else if ((fseek(fout, 0, SEEK_END) != 0) || ((fileSize = ftell(fout)) < 0))
+    {
+        LogError("unable to get the size of %s", writer->fileName);
+        (void)fclose(fout);
+        result = __LINE__;
+    }
+    else
+    {
+        writer->fout = fout;
+        writer->fileSize = (size_t)fileSize;
+        writer->fileOpened = now;
+        writer->fileHasRecords = false;
+        result = (writer->format == LOGGER_FORMAT_BINARY) ?
+            LoggerWriter_StartBinaryLog(writer, now) :
+            LoggerWriter_StartJsonLog(writer, now, timeString);
+        if (result != 0)
+        {
+            LogError("unable to start the log in %s", writer->fileName);
+            (void)fclose(fout);
+            writer->fout = NULL;
+        }
+    }
+    return result;
+}
+
+static void LoggerWriter_CloseFile(LOGGER_WRITER* writer, time_t now, const char* timeString)
+{
+    if (LoggerWriter_WriteMarker(writer, LOGGER_RECORD_LOG_STOPPED, ",", now, timeString) != 0)
+    {
+        LogError("unable to mark the end of %s", writer->fileName);
+    }
+
+    if (fclose(writer->fout) != 0)
+    {
+        LogError("unable to close %s", writer->fileName);
+    }
+    writer->fout = NULL;
+}
+
+/*moves the closed log file to the first name <fileName>.<n> that is not taken yet*/
+static void LoggerWriter_RenameFile(LOGGER_WRITER* writer)
+{
+    size_t rotatedNameSize = strlen(writer->fileName) + 12; /*a dot, up to 10 digits and '\0'*/
+    char* rotatedName = (char*)malloc(rotatedNameSize);
+    if (rotatedName == NULL)
+    {
+        LogError("unable to allocate the rotated file name, the log continues in %s", writer->fileName);
+    }
+    else
+    {
+        FILE* existing;
+        do
+        {
+            (void)sprintf_s(rotatedName, rotatedNameSize, "%s.%u", writer->fileName, writer->nextRotation++);
+            existing = fopen(rotatedName, "rb");
+            if (existing != NULL)
+            {
+                (void)fclose(existing);
+            }
+        } while (existing != NULL);
+
+        if (rename(writer->fileName, rotatedName) != 0)
+        {
+            LogError("unable to rename %s to %s, the log continues in %s", writer->fileName, rotatedName, writer->fileName);
+        }
+        free(rotatedName);
+    }
+}
+
+static void LoggerWriter_RotateIfDue(LOGGER_WRITER* writer)
+{
+    if ((writer->fout != NULL) && writer->fileHasRecords)
+    {
+        time_t now = time(NULL);
+        if (
+            ((writer->maxFileSize != 0) && (writer->fileSize >= writer->maxFileSize)) ||
+            ((writer->maxFileAge != 0) && (now != (time_t)-1) && (difftime(now, writer->fileOpened) >= (double)writer->maxFileAge))
+            )
+        {
+            /*Codes_SRS_LOGGER_WRITER_17_018: [ After it writes a buffer, and at least every `LOGGER_WRITER_PERIOD_MS` milliseconds, the writer thread shall rotate a log file that holds records and has reached `maxFileSize` bytes or is `maxFileAge` seconds old: it shall mark the end of the log, close the file, rename it `<name>.<n>` with `n` the first number not taken yet, and start a new log in a new file named `<name>`. ]*/
+            char timeString[TIME_STRING_SIZE];
+            get_marker_time_from_thread(writer, &now, timeString, sizeof(timeString));
+            LoggerWriter_CloseFile(writer, now, timeString);
+            LoggerWriter_RenameFile(writer);
+            if (LoggerWriter_OpenFile(writer, now, timeString) != 0)
+            {
+                LogError("unable to open %s after rotating it, records are dropped until it opens", writer->fileName);
+            }
+        }
+    }
+}
+
+static void LoggerWriter_WriteBuffer(LOGGER_WRITER* writer, LOGGER_BUFFER* buffer, bool isFromThread)
+{
+    if (writer->fout == NULL)
+    {
+        /*a rotation could not open the next file, try again*/
+        time_t now;
+        char timeString[TIME_STRING_SIZE];
+        if (isFromThread)
+        {
+            get_marker_time_from_thread(writer, &now, timeString, sizeof(timeString));
+        }
+        else
+        {
+            get_marker_time(writer, &now, timeString, sizeof(timeString));
+        }
+        (void)LoggerWriter_OpenFile(writer, now, timeString);
+    }
+
+    if (writer->fout == NULL)
+    {
+        LogError("%s is not open, dropping %zu bytes of records", writer->fileName, buffer->size);
+    }
+    else if (LoggerWriter_WriteFile(writer, buffer->data, buffer->size) != 0)
+    {
+        LogError("dropping %zu bytes of records", buffer->size);
+    }
+    else
+    {
+        writer->fileHasRecords = true;
+    }
+    buffer->size = 0;
+}
+
+static int LoggerWriter_Thread(void* param)
+{
+    LOGGER_WRITER* writer = (LOGGER_WRITER*)param;
+    bool isStopping = false;
+    while (!isStopping)
+    {
+        LOGGER_BUFFER* full = NULL;
+        if (Lock(writer->lock) != LOCK_OK)
+        {
+            LogError("unable to lock, the writer thread stops");
+            isStopping = true;
+        }
+        else
+        {
+            /*Codes_SRS_LOGGER_WRITER_17_017: [ The writer thread shall wait until records are appended or `LOGGER_WRITER_PERIOD_MS` milliseconds pass, swap the buffers under the lock, and write the buffer full of records to the file with a single `fwrite` once the lock is released. ]*/
+            if ((writer->buffers[writer->filling].size == 0) && !writer->stopThread)
+            {
+                (void)Condition_Wait(writer->dataAvailable, writer->lock, LOGGER_WRITER_PERIOD_MS);
+            }
+
+            if (writer->buffers[writer->filling].size != 0)
+            {
+                full = &writer->buffers[writer->filling];
+                writer->filling = 1 - writer->filling;
+                (void)Condition_Post(writer->spaceAvailable);
+            }
+            else
+            {
+                /*Codes_SRS_LOGGER_WRITER_17_019: [ The writer thread shall return once it is asked to stop and every record appended before has been written. ]*/
+                isStopping = writer->stopThread;
+            }
+            (void)Unlock(writer->lock);
+        }
+
+        if (full != NULL)
+        {
+            LoggerWriter_WriteBuffer(writer, full, true);
+        }
+
+        if (!isStopping)
+        {
+            LoggerWriter_RotateIfDue(writer);
+        }
+    }
+    return 0;
+}
+
+/*returns the buffer records are appended to once it has room for size more bytes, the lock is held*/
+static LOGGER_BUFFER* LoggerWriter_Reserve(LOGGER_WRITER* writer, size_t size)
+{
+    LOGGER_BUFFER* result = &writer->buffers[writer->filling];
+    while ((result != NULL) && (result->size != 0) && (result->capacity - result->size < size))
+    {
+        /*Codes_SRS_LOGGER_WRITER_17_013: [ If the buffer being filled has no room for the record, `LoggerWriter_WriteMessage` shall wait until the writer thread swaps the buffers. ]*/
+        (void)Condition_Post(writer->dataAvailable);
+        if (Condition_Wait(writer->spaceAvailable, writer->lock, LOGGER_WRITER_PERIOD_MS) == COND_ERROR)
+        {
+            LogError("unable to wait for the writer thread");
+            result = NULL;
+        }
+        else
+        {
+            result = &writer->buffers[writer->filling];
+        }
+    }
+
+    if ((result != NULL) && (result->capacity - result->size < size))
+    {
+        /*Codes_SRS_LOGGER_WRITER_17_014: [ If the record is larger than an empty buffer, `LoggerWriter_WriteMessage` shall grow the buffer to fit it. ]*/
+        if (LoggerBuffer_Allocate(result, size) != 0)
+        {
+            LogError("unable to grow a buffer to %zu bytes", size);
+            result = NULL;
+        }
+    }
+    return result;
+}
+
+/*once half a buffer is filled, the writer thread is woken up to get ahead of the records*/
+static void LoggerWriter_Commit(LOGGER_WRITER* writer, LOGGER_BUFFER* buffer, size_t size)
+{
+    buffer->size += size;
+    if (buffer->size >= buffer->capacity / 2)
+    {
+        (void)Condition_Post(writer->dataAvailable);
+    }
+}
+
+static int LoggerWriter_AppendBinary(LOGGER_WRITER* writer, MESSAGE_HANDLE message, time_t now)
+{
+    int result;
+    int32_t messageSize = Message_ToByteArray(message, NULL, 0);
+    if (messageSize <= 0)
+    {
+        LogError("unable to get the size of the serialized message");
+        result = __LINE__;
+    }
+    else if (Lock(writer->lock) != LOCK_OK)
+    {
+        LogError("unable to lock");
+        result = __LINE__;
+    }
+    else
+    {
+        /*Codes_SRS_LOGGER_WRITER_17_011: [ If the format is `LOGGER_FORMAT_BINARY`, the record shall be a record header with the size of the payload, the kind `LOGGER_RECORD_MESSAGE` and the time, followed by the message serialized by `Message_ToByteArray`. ]*/
+        size_t recordSize = LOGGER_BINARY_RECORD_HEADER_SIZE + (size_t)messageSize;
+        /*Codes_SRS_LOGGER_WRITER_17_012: [ `LoggerWriter_WriteMessage` shall write the record into the buffer being filled while it holds the lock. ]*/
+        LOGGER_BUFFER* buffer = LoggerWriter_Reserve(writer, recordSize);
+        if (buffer == NULL)
+        {
+            LogError("no room for a record of %zu bytes", recordSize);
+            result = __LINE__;
+        }
+        else
+        {
+            unsigned char* record = buffer->data + buffer->size;
+            write_record_header(record, (uint32_t)messageSize, LOGGER_RECORD_MESSAGE, now);
+            if (Message_ToByteArray(message, record + LOGGER_BINARY_RECORD_HEADER_SIZE, messageSize) != messageSize)
+            {
+                LogError("unable to serialize the message");
+                result = __LINE__;
+            }
+            else
+            {
+                LoggerWriter_Commit(writer, buffer, recordSize);
+                result = 0;
+            }
+        }
+        (void)Unlock(writer->lock);
+    }
+    return result;
+}
+
+static int LoggerWriter_AppendJsonRecord(LOGGER_WRITER* writer, STRING_HANDLE jsonProperties, const CONSTBUFFER* content, time_t now)
+{
+    int result;
+    if (Lock(writer->lock) != LOCK_OK)
+    {
+        LogError("unable to lock");
+        result = __LINE__;
+    }
+    else
+    {
+        /*Codes_SRS_LOGGER_WRITER_17_010: [ If the format is `LOGGER_FORMAT_JSON`, the record shall be `,{"time":"<time>","properties":<properties>,"content":"<content>"}`, where the time is printed by `strftime` at most once per second, the properties are made by `Map_ToJSON` and the content is encoded by `Base64Encoder_Encode` straight into the buffer. ]*/
+        if ((writer->formattedTime != now) && (format_time(now, writer->formattedTimeString, sizeof(writer->formattedTimeString)) != 0))
+        {
+            LogError("unable to format the time of the record");
+            result = __LINE__;
+        }
+        else
+        {
+            size_t timeLength = strlen(writer->formattedTimeString);
+            size_t propertiesLength = STRING_length(jsonProperties);
+            size_t contentLength = Base64Encoder_GetEncodedSize(content->size);
+            size_t recordSize =
+                CONST_STRLEN(JSON_RECORD_TIME) + timeLength +
+                CONST_STRLEN(JSON_RECORD_PROPERTIES) + propertiesLength +
+                CONST_STRLEN(JSON_RECORD_CONTENT) + contentLength +
+                CONST_STRLEN(JSON_RECORD_END);
+            /*Codes_SRS_LOGGER_WRITER_17_012: [ `LoggerWriter_WriteMessage` shall write the record into the buffer being filled while it holds the lock. ]*/
+            LOGGER_BUFFER* buffer;
+            writer->formattedTime = now;
+            buffer = LoggerWriter_Reserve(writer, recordSize);
+            if (buffer == NULL)
+            {
+                LogError("no room for a record of %zu bytes", recordSize);
+                result = __LINE__;
+            }
+            else
+            {
+                unsigned char* record = buffer->data + buffer->size;
+                record = append_bytes(record, JSON_RECORD_TIME, CONST_STRLEN(JSON_RECORD_TIME));
+                record = append_bytes(record, writer->formattedTimeString, timeLength);
+                record = append_bytes(record, JSON_RECORD_PROPERTIES, CONST_STRLEN(JSON_RECORD_PROPERTIES));
+                record = append_bytes(record, STRING_c_str(jsonProperties), propertiesLength);
+                record = append_bytes(record, JSON_RECORD_CONTENT, CONST_STRLEN(JSON_RECORD_CONTENT));
+                record += Base64Encoder_Encode(content->buffer, content->size, (char*)record);
+                (void)append_bytes(record, JSON_RECORD_END, CONST_STRLEN(JSON_RECORD_END));
+                LoggerWriter_Commit(writer, buffer, recordSize);
+                result = 0;
+            }
+        }
+        (void)Unlock(writer->lock);
+    }
+    return result;
+}
+
+static int LoggerWriter_AppendJson(LOGGER_WRITER* writer, MESSAGE_HANDLE message, time_t now)
+{
+    int result;
+    CONSTMAP_HANDLE originalProperties = Message_GetProperties(message); /*by contract this is never NULL*/
+    MAP_HANDLE propertiesAsMap = ConstMap_CloneWriteable(originalProperties);
+    if (propertiesAsMap == NULL)
+    {
+        LogError("ConstMap_CloneWriteable failed");
+        result = __LINE__;
+    }
+    else
+    {
+        STRING_HANDLE jsonProperties = Map_ToJSON(propertiesAsMap);
+        if (jsonProperties == NULL)
+        {
+            LogError("unable to Map_ToJSON");
+            result = __LINE__;
+        }
+        else
+        {
+            const CONSTBUFFER* content = Message_GetContent(message); /*by contract, this is never NULL*/
+            if ((content == NULL) || ((content->buffer == NULL) && (content->size != 0)))
+            {
+                LogError("unable to get the content of the message");
+                result = __LINE__;
+            }
+            else if ((content->size != 0) && (Base64Encoder_GetEncodedSize(content->size) == 0))
+            {
+                LogError("the content of the message is too large to encode");
+                result = __LINE__;
+            }
+            else
+            {
+                result = LoggerWriter_AppendJsonRecord(writer, jsonProperties, content, now);
+            }
+            STRING_delete(jsonProperties);
+        }
+        Map_Destroy(propertiesAsMap);
+    }
+    ConstMap_Destroy(originalProperties);
+    return result;
+}
+
+static void LoggerWriter_Free(LOGGER_WRITER* writer)
+{
+    if (writer->spaceAvailable != NULL)
+    {
+        Condition_Deinit(writer->spaceAvailable);
+    }
+    if (writer->dataAvailable != NULL)
+    {
+        Condition_Deinit(writer->dataAvailable);
+    }
+    if (writer->lock != NULL)
+    {
+        (void)Lock_Deinit(writer->lock);
+    }
+    free(writer->buffers[0].allocation);
+    free(writer->buffers[1].allocation);
+    free(writer->fileName);
+    free(writer);
+}
+
+LOGGER_WRITER_HANDLE LoggerWriter_Create(const LOGGER_CONFIG* config)
+{
+    LOGGER_WRITER* result;
+    if (
+        (config == NULL) ||
+        (config->selector != LOGGING_TO_FILE) ||
+        (config->selectee.loggerConfigFile.name == NULL)
+        )
+    {
+        /*Codes_SRS_LOGGER_WRITER_17_001: [ If `config` is `NULL`, its selector is not `LOGGING_TO_FILE` or it names no file, `LoggerWriter_Create` shall fail and return `NULL`. ]*/
+        LogError("invalid arg config=%p", config);
+        result = NULL;
+    }
+    else if ((result = (LOGGER_WRITER*)malloc(sizeof(LOGGER_WRITER))) == NULL)
+    {
+        /*Codes_SRS_LOGGER_WRITER_17_007: [ If any step fails, `LoggerWriter_Create` shall release everything it acquired and return `NULL`. ]*/
+        LogError("malloc failed");
+    }
+    else
+    {
+        /*Codes_SRS_LOGGER_WRITER_17_002: [ `LoggerWriter_Create` shall allocate two buffers of `bufferSize` bytes, or `LOGGER_WRITER_DEFAULT_BUFFER_SIZE` bytes if `bufferSize` is 0, rounded up to a multiple of `LOGGER_WRITER_BUFFER_ALIGNMENT` and aligned on `LOGGER_WRITER_BUFFER_ALIGNMENT` bytes. ]*/
+        size_t bufferSize = (config->selectee.loggerConfigFile.bufferSize == 0) ?
+            LOGGER_WRITER_DEFAULT_BUFFER_SIZE :
+            config->selectee.loggerConfigFile.bufferSize;
+        time_t now;
+        char timeString[TIME_STRING_SIZE];
+
+        (void)memset(result, 0, sizeof(LOGGER_WRITER));
+        result->format = config->selectee.loggerConfigFile.format;
+        result->maxFileSize = config->selectee.loggerConfigFile.maxFileSize;
+        result->maxFileAge = config->selectee.loggerConfigFile.maxFileAge;
+        result->nextRotation = 1;
+        result->formattedTime = (time_t)-1;
+
+        if (mallocAndStrcpy_s(&result->fileName, config->selectee.loggerConfigFile.name) != 0)
+        {
+            /*Codes_SRS_LOGGER_WRITER_17_007: [ If any step fails, `LoggerWriter_Create` shall release everything it acquired and return `NULL`. ]*/
+            LogError("unable to copy the file name");
+            LoggerWriter_Free(result);
+            result = NULL;
+        }
+        else if (
+            (LoggerBuffer_Allocate(&result->buffers[0], bufferSize) != 0) ||
+            (LoggerBuffer_Allocate(&result->buffers[1], bufferSize) != 0)
+            )
+        {
+            /*Codes_SRS_LOGGER_WRITER_17_007: [ If any step fails, `LoggerWriter_Create` shall release everything it acquired and return `NULL`. ]*/
+            LogError("unable to allocate the write buffers");
+            LoggerWriter_Free(result);
+            result = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_LOGGER_WRITER_17_003: [ `LoggerWriter_Create` shall open the file in update mode, create it if it does not exist, and turn off the stdio buffering of the file. ]*/
+            /*Codes_SRS_LOGGER_WRITER_17_004: [ If the format is `LOGGER_FORMAT_JSON`, `LoggerWriter_Create` shall start a JSON array holding a "Log started" marker in an empty file, or add the marker to the array already in the file, in place of its closing `]` if there is one. ]*/
+            /*Codes_SRS_LOGGER_WRITER_17_005: [ If the format is `LOGGER_FORMAT_BINARY`, `LoggerWriter_Create` shall write the binary log header to an empty file, fail if a file that is not empty does not start with it, and add a `LOGGER_RECORD_LOG_STARTED` record. ]*/
+            get_marker_time(result, &now, timeString, sizeof(timeString));
+            if (LoggerWriter_OpenFile(result, now, timeString) != 0)
+            {
+                /*Codes_SRS_LOGGER_WRITER_17_007: [ If any step fails, `LoggerWriter_Create` shall release everything it acquired and return `NULL`. ]*/
+                LogError("unable to open the log");
+                LoggerWriter_Free(result);
+                result = NULL;
+            }
+            /*Codes_SRS_LOGGER_WRITER_17_006: [ `LoggerWriter_Create` shall create a lock, two conditions and a thread that writes the buffers to the file. ]*/
+            else if (
+                ((result->lock = Lock_Init()) == NULL) ||
+                ((result->dataAvailable = Condition_Init()) == NULL) ||
+                ((result->spaceAvailable = Condition_Init()) == NULL) ||
+                (ThreadAPI_Create(&result->thread, LoggerWriter_Thread, result) != THREADAPI_OK)
+                )
+            {
+                /*Codes_SRS_LOGGER_WRITER_17_007: [ If any step fails, `LoggerWriter_Create` shall release everything it acquired and return `NULL`. ]*/
+                LogError("unable to start the writer thread");
+                LoggerWriter_CloseFile(result, now, timeString);
+                LoggerWriter_Free(result);
+                result = NULL;
+            }
+            else
+            {
+                /*Codes_SRS_LOGGER_WRITER_17_008: [ Otherwise `LoggerWriter_Create` shall return a non-`NULL` handle. ]*/
+            }
+        }
+    }
+    return result;
+}
+
+int LoggerWriter_WriteMessage(LOGGER_WRITER_HANDLE writer, MESSAGE_HANDLE message)
+{
+    int result;
+    if ((writer == NULL) || (message == NULL))
+    {
+        /*Codes_SRS_LOGGER_WRITER_17_009: [ If `writer` or `message` is `NULL`, `LoggerWriter_WriteMessage` shall fail and return a non-zero value. ]*/
+        LogError("invalid arg writer=%p message=%p", writer, message);
+        result = __LINE__;
+    }
+    else
+    {
+        time_t now = time(NULL);
+        if (now == (time_t)-1)
+        {
+            /*Codes_SRS_LOGGER_WRITER_17_015: [ If any step fails, `LoggerWriter_WriteMessage` shall fail and return a non-zero value. ]*/
+            LogError("time function failed");
+            result = __LINE__;
+        }
+        else
+        {
+            /*Codes_SRS_LOGGER_WRITER_17_015: [ If any step fails, `LoggerWriter_WriteMessage` shall fail and return a non-zero value. ]*/
+            /*Codes_SRS_LOGGER_WRITER_17_016: [ Otherwise `LoggerWriter_WriteMessage` shall return 0. ]*/
+            result = (writer->format == LOGGER_FORMAT_BINARY) ?
+                LoggerWriter_AppendBinary(writer, message, now) :
+                LoggerWriter_AppendJson(writer, message, now);
+        }
+    }
+    return result;
+}
+
+void LoggerWriter_Destroy(LOGGER_WRITER_HANDLE writer)
+{
+    if (writer == NULL)
+    {
+        /*Codes_SRS_LOGGER_WRITER_17_020: [ If `writer` is `NULL`, `LoggerWriter_Destroy` shall return. ]*/
+        LogError("invalid arg writer=NULL");
+    }
+    else
+    {
+        int notUsed;
+        time_t now;
+        char timeString[TIME_STRING_SIZE];
+
+        /*Codes_SRS_LOGGER_WRITER_17_021: [ `LoggerWriter_Destroy` shall ask the writer thread to stop, wake it up and join it. ]*/
+        if (Lock(writer->lock) != LOCK_OK)
+        {
+            LogError("unable to lock, stopping the writer thread anyway");
+            writer->stopThread = true;
+        }
+        else
+        {
+            writer->stopThread = true;
+            (void)Condition_Post(writer->dataAvailable);
+            (void)Unlock(writer->lock);
+        }
+
+        if (ThreadAPI_Join(writer->thread, &notUsed) != THREADAPI_OK)
+        {
+            LogError("unable to join the writer thread");
+        }
+
+        /*Codes_SRS_LOGGER_WRITER_17_022: [ `LoggerWriter_Destroy` shall write the records the writer thread left behind, mark the end of the log and close the file. ]*/
+        if (writer->buffers[writer->filling].size != 0)
+        {
+            LoggerWriter_WriteBuffer(writer, &writer->buffers[writer->filling], false);
+        }
+
+        if (writer->fout != NULL)
+        {
+            get_marker_time(writer, &now, timeString, sizeof(timeString));
+            LoggerWriter_CloseFile(writer, now, timeString);
+        }
+
+        /*Codes_SRS_LOGGER_WRITER_17_023: [ `LoggerWriter_Destroy` shall free all resources. ]*/
+        LoggerWriter_Free(writer);
+    }
+}
@@ -3,6 +3,7 @@
 
 #include <cstdlib>
 #include <cstddef>
+#include <cstdint>
 #include "testrunnerswitcher.h"
 #include "micromock.h"
 #include "micromockcharstararenullterminatedstrings.h"
@@ -28,8 +29,8 @@ FOR_EACH_1(DEFINE_FAIL_VARIABLES, LIST_OF_COUNTED_APIS)
 #include "azure_c_shared_utility/constmap.h"
 #include "azure_c_shared_utility/map.h"
 #include "message.h"
-#include "azure_c_shared_utility/base64.h"
 #include "logger.h"
+#include "logger_writer.h"
 
 #include <parson.h>
 
@@ -126,6 +127,7 @@ namespace BASEIMPLEMENTATION
     JSON_Value* json_parse_string(const char* string);
     JSON_Object* json_value_get_object(const JSON_Value* value);
     const char* json_object_get_string(const JSON_Object* object, const char* name);
+    double json_object_get_number(const JSON_Object* object, const char* name);
     void json_value_free(JSON_Value *value);
 
 };
@@ -133,6 +135,7 @@ namespace BASEIMPLEMENTATION
 typedef struct LOGGER_HANDLE_DATA_TAG
 {
     FILE* fout;
+    LOGGER_WRITER_HANDLE writer;
 }LOGGER_HANDLE_DATA;
 
 static MICROMOCK_MUTEX_HANDLE g_testByTest;
@@ -145,6 +148,7 @@ static pfModule_FreeConfiguration Logger_FreeConfiguration = NULL; /*gets assign
 static pfModule_Create  Logger_Create = NULL; /*gets assigned in TEST_SUITE_INITIALIZE*/
 static pfModule_Destroy Logger_Destroy = NULL; /*gets assigned in TEST_SUITE_INITIALIZE*/
 static pfModule_Receive Logger_Receive = NULL; /*gets assigned in TEST_SUITE_INITIALIZE*/
+static pfModule_ReceiveBatch Logger_ReceiveBatch = NULL; /*gets assigned in TEST_SUITE_INITIALIZE*/
 
 static LOGGER_CONFIG validConfig =
 {
@@ -153,6 +157,16 @@ static LOGGER_CONFIG validConfig =
 };
 static BROKER_HANDLE validBrokerHandle = (BROKER_HANDLE)0x1;
 
+static LOGGER_CONFIG validConfig_buffered =
+{
+	LOGGING_TO_FILE,
+	"a.bin",
+	LOGGER_FORMAT_BINARY,
+	65536,
+	1000000,
+	3600
+};
+
 static LOGGER_CONFIG invalidConfig_fileName =
 {
     (LOGGER_TYPE)~LOGGING_TO_FILE,
@@ -167,7 +181,10 @@ static LOGGER_CONFIG invalidConfig_selector =
 
 #define VALID_CONFIG_STRING "{\"filename\":\"log.txt\"}"
 
+#define WRITER_CONFIG_STRING "{\"filename\":\"log.bin\",\"format\":\"binary\",\"bufferSize\":65536,\"maxFileSize\":1000000,\"maxFileAge\":3600}"
+
 #define TIME_IN_STRFTIME "time"
+static LOGGER_WRITER_HANDLE validWriterHandle = (LOGGER_WRITER_HANDLE)0x44;
 static MESSAGE_HANDLE validMessageHandle = (MESSAGE_HANDLE)0x032;
 static unsigned char buffer[3] = { 1,2,3 };
 static CONSTBUFFER validBuffer = { buffer, sizeof(buffer)/sizeof(buffer[0]) };
@@ -196,10 +213,23 @@ public:
     MOCK_STATIC_METHOD_2(, const char*, json_object_get_string, const JSON_Object*, object, const char*, name)
     MOCK_METHOD_END(const char*, (strcmp(name, "filename") == 0) ? "log.txt" : NULL);
 
+    MOCK_STATIC_METHOD_2(, double, json_object_get_number, const JSON_Object*, object, const char*, name)
+    MOCK_METHOD_END(double, 0);
+
     MOCK_STATIC_METHOD_1(, void, json_value_free, JSON_Value*, value)
         free(value);
     MOCK_VOID_METHOD_END();
 
+    //logger_writer
+    MOCK_STATIC_METHOD_1(, LOGGER_WRITER_HANDLE, LoggerWriter_Create, const LOGGER_CONFIG*, config)
+    MOCK_METHOD_END(LOGGER_WRITER_HANDLE, validWriterHandle);
+
+    MOCK_STATIC_METHOD_2(, int, LoggerWriter_WriteMessage, LOGGER_WRITER_HANDLE, writer, MESSAGE_HANDLE, message)
+    MOCK_METHOD_END(int, 0);
+
+    MOCK_STATIC_METHOD_1(, void, LoggerWriter_Destroy, LOGGER_WRITER_HANDLE, writer)
+    MOCK_VOID_METHOD_END();
+
     //memory
     MOCK_STATIC_METHOD_1(, void*, gballoc_malloc, size_t, size)
         void* result2 = BASEIMPLEMENTATION::gballoc_malloc(size);
@@ -226,24 +256,10 @@ public:
 	MOCK_METHOD_END(int, r)
 
     //string
-    MOCK_STATIC_METHOD_1(, STRING_HANDLE, STRING_construct, const char*, source)
-        STRING_HANDLE result2 = (STRING_HANDLE)malloc(4);
-    MOCK_METHOD_END(STRING_HANDLE, result2)
-
-	MOCK_STATIC_METHOD_2(, STRING_HANDLE, STRING_construct_n, const char*, psz, size_t, n)
-		STRING_HANDLE result3 = (STRING_HANDLE)malloc(n+1);
-	MOCK_METHOD_END(STRING_HANDLE, result3)
-
     MOCK_STATIC_METHOD_1(, void, STRING_delete, STRING_HANDLE, s)
         free(s);
     MOCK_VOID_METHOD_END()
 
-    MOCK_STATIC_METHOD_2(, int, STRING_concat, STRING_HANDLE, s1, const char*, s2)
-    MOCK_METHOD_END(int, 0);
-
-    MOCK_STATIC_METHOD_2(, int, STRING_concat_with_STRING, STRING_HANDLE, s1, STRING_HANDLE, s2)
-    MOCK_METHOD_END(int, 0);
-
     MOCK_STATIC_METHOD_1(, const char*, STRING_c_str, STRING_HANDLE, s)
     MOCK_METHOD_END(const char*, "thisIsRandomContent")
 
@@ -271,10 +287,6 @@ public:
         const CONSTBUFFER * result2 = &validBuffer;
     MOCK_METHOD_END(const CONSTBUFFER *, result2)
 
-    MOCK_STATIC_METHOD_2(, STRING_HANDLE, Base64_Encode_Bytes, const unsigned char*, source, size_t, size);
-        STRING_HANDLE result2 = (STRING_HANDLE)malloc(7);
-    MOCK_METHOD_END(STRING_HANDLE, result2);
-
     MOCK_STATIC_METHOD_2(, FILE*, gb_fopen, const char*, filename, const char*, mode)
         FILE* result2 = (FILE*)malloc(8);
     MOCK_METHOD_END(FILE*, result2);
@@ -315,18 +327,19 @@ public:
 DECLARE_GLOBAL_MOCK_METHOD_1(CLoggerMocks, , JSON_Value*, json_parse_string, const char *, filename);
 DECLARE_GLOBAL_MOCK_METHOD_1(CLoggerMocks, , JSON_Object*, json_value_get_object, const JSON_Value*, value);
 DECLARE_GLOBAL_MOCK_METHOD_2(CLoggerMocks, , const char*, json_object_get_string, const JSON_Object*, object, const char*, name);
+DECLARE_GLOBAL_MOCK_METHOD_2(CLoggerMocks, , double, json_object_get_number, const JSON_Object*, object, const char*, name);
 DECLARE_GLOBAL_MOCK_METHOD_1(CLoggerMocks, , void, json_value_free, JSON_Value*, value);
 
+DECLARE_GLOBAL_MOCK_METHOD_1(CLoggerMocks, , LOGGER_WRITER_HANDLE, LoggerWriter_Create, const LOGGER_CONFIG*, config);
+DECLARE_GLOBAL_MOCK_METHOD_2(CLoggerMocks, , int, LoggerWriter_WriteMessage, LOGGER_WRITER_HANDLE, writer, MESSAGE_HANDLE, message);
+DECLARE_GLOBAL_MOCK_METHOD_1(CLoggerMocks, , void, LoggerWriter_Destroy, LOGGER_WRITER_HANDLE, writer);
+
 DECLARE_GLOBAL_MOCK_METHOD_1(CLoggerMocks, , void*, gballoc_malloc, size_t, size);
 DECLARE_GLOBAL_MOCK_METHOD_1(CLoggerMocks, , void, gballoc_free, void*, ptr);
 DECLARE_GLOBAL_MOCK_METHOD_2(CLoggerMocks, , int, mallocAndStrcpy_s, char**, destination, const char*, source);
 
-DECLARE_GLOBAL_MOCK_METHOD_1(CLoggerMocks, , STRING_HANDLE, STRING_construct, const char*, s);
-DECLARE_GLOBAL_MOCK_METHOD_2(CLoggerMocks, , STRING_HANDLE, STRING_construct_n, const char*, psz, size_t, n);
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CLoggerMocks, , void, STRING_delete, STRING_HANDLE, s);
-DECLARE_GLOBAL_MOCK_METHOD_2(CLoggerMocks, , int, STRING_concat, STRING_HANDLE, s1, const char*, s2);
-DECLARE_GLOBAL_MOCK_METHOD_2(CLoggerMocks, , int, STRING_concat_with_STRING, STRING_HANDLE, s1, STRING_HANDLE, s2);
 DECLARE_GLOBAL_MOCK_METHOD_1(CLoggerMocks, , const char*, STRING_c_str, STRING_HANDLE, s);
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CLoggerMocks, , MAP_HANDLE, ConstMap_CloneWriteable, CONSTMAP_HANDLE, handle);
@@ -337,7 +350,6 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CLoggerMocks, , CONSTMAP_HANDLE, Message_GetPropert
 DECLARE_GLOBAL_MOCK_METHOD_1(CLoggerMocks, , void,  ConstMap_Destroy, CONSTMAP_HANDLE, handle);
 DECLARE_GLOBAL_MOCK_METHOD_1(CLoggerMocks, , const CONSTBUFFER *, Message_GetContent, MESSAGE_HANDLE, message);
 
-DECLARE_GLOBAL_MOCK_METHOD_2(CLoggerMocks, , STRING_HANDLE, Base64_Encode_Bytes, const unsigned char*, source, size_t, size);
 
 DECLARE_GLOBAL_MOCK_METHOD_2(CLoggerMocks, , FILE*, gb_fopen, const char*, filename, const char*, mode);
 DECLARE_GLOBAL_MOCK_METHOD_1(CLoggerMocks, , int, gb_fclose, FILE*, stream);
@@ -368,6 +380,7 @@ BEGIN_TEST_SUITE(logger_ut)
         Logger_Create = MODULE_CREATE(apis);
         Logger_Destroy = MODULE_DESTROY(apis);
         Logger_Receive = MODULE_RECEIVE(apis);
+        Logger_ReceiveBatch = MODULE_RECEIVE_BATCH(Module_GetApi(MODULE_API_VERSION_2));
     }
 
     TEST_SUITE_CLEANUP(TestClassCleanup)
@@ -428,6 +441,14 @@ BEGIN_TEST_SUITE(logger_ut)
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "filename")) /*this is getting a json string that is what follows "filename": in the json*/
             .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "format")) /*this is getting the optional record format*/
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "bufferSize")) /*these are getting the optional writer settings*/
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "maxFileSize"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "maxFileAge"))
+            .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, gballoc_malloc(sizeof(LOGGER_CONFIG)));
 		STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 			.IgnoreArgument(1)
@@ -458,6 +479,14 @@ BEGIN_TEST_SUITE(logger_ut)
 			.IgnoreArgument(1);
 		STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "filename")) /*this is getting a json string that is what follows "filename": in the json*/
 			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "format")) /*this is getting the optional record format*/
+			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "bufferSize")) /*these are getting the optional writer settings*/
+			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "maxFileSize"))
+			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "maxFileAge"))
+			.IgnoreArgument(1);
 		STRICT_EXPECTED_CALL(mocks, gballoc_malloc(sizeof(LOGGER_CONFIG)));
 		STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
 			.IgnoreArgument(1);
@@ -489,6 +518,14 @@ BEGIN_TEST_SUITE(logger_ut)
 			.IgnoreArgument(1);
 		STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "filename")) /*this is getting a json string that is what follows "filename": in the json*/
 			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "format")) /*this is getting the optional record format*/
+			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "bufferSize")) /*these are getting the optional writer settings*/
+			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "maxFileSize"))
+			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "maxFileAge"))
+			.IgnoreArgument(1);
 		STRICT_EXPECTED_CALL(mocks, gballoc_malloc(sizeof(LOGGER_CONFIG)))
 			.SetFailReturn(nullptr);
 
@@ -572,6 +609,138 @@ BEGIN_TEST_SUITE(logger_ut)
         ///cleanup
     }
 
+    /*Tests_SRS_LOGGER_17_008: [ Logger_ParseConfigurationFromJson shall set format to LOGGER_FORMAT_BINARY if the value named "format" is "binary", and to LOGGER_FORMAT_JSON if it is "json" or if there is no such value. ]*/
+    /*Tests_SRS_LOGGER_17_010: [ Logger_ParseConfigurationFromJson shall set bufferSize, maxFileSize and maxFileAge to the values named "bufferSize", "maxFileSize" and "maxFileAge", or to 0 if there are no such values. ]*/
+    TEST_FUNCTION(Logger_ParseConfigurationFromJson_reads_writer_settings)
+    {
+        ///arrange
+        CLoggerMocks mocks;
+
+        STRICT_EXPECTED_CALL(mocks, json_parse_string(WRITER_CONFIG_STRING));
+        STRICT_EXPECTED_CALL(mocks, json_value_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_value_get_object(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "filename"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "format"))
+            .IgnoreArgument(1)
+            .SetReturn("binary");
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "bufferSize"))
+            .IgnoreArgument(1)
+            .SetReturn(65536);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "maxFileSize"))
+            .IgnoreArgument(1)
+            .SetReturn(1000000);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "maxFileAge"))
+            .IgnoreArgument(1)
+            .SetReturn(3600);
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(sizeof(LOGGER_CONFIG)));
+        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .IgnoreArgument(2);
+
+        ///act
+        auto result = (LOGGER_CONFIG*)Logger_ParseConfigurationFromJson(WRITER_CONFIG_STRING);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(result);
+        ASSERT_ARE_EQUAL(int, (int)LOGGER_FORMAT_BINARY, (int)result->selectee.loggerConfigFile.format);
+        ASSERT_ARE_EQUAL(size_t, 65536, result->selectee.loggerConfigFile.bufferSize);
+        ASSERT_ARE_EQUAL(size_t, 1000000, result->selectee.loggerConfigFile.maxFileSize);
+        ASSERT_ARE_EQUAL(size_t, 3600, result->selectee.loggerConfigFile.maxFileAge);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        Logger_FreeConfiguration(result);
+    }
+
+    /*Tests_SRS_LOGGER_17_008: [ Logger_ParseConfigurationFromJson shall set format to LOGGER_FORMAT_BINARY if the value named "format" is "binary", and to LOGGER_FORMAT_JSON if it is "json" or if there is no such value. ]*/
+    TEST_FUNCTION(Logger_ParseConfigurationFromJson_defaults_to_an_unbuffered_json_log)
+    {
+        ///arrange
+        CLoggerMocks mocks;
+
+        ///act
+        auto result = (LOGGER_CONFIG*)Logger_ParseConfigurationFromJson(VALID_CONFIG_STRING);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(result);
+        ASSERT_ARE_EQUAL(int, (int)LOGGER_FORMAT_JSON, (int)result->selectee.loggerConfigFile.format);
+        ASSERT_ARE_EQUAL(size_t, 0, result->selectee.loggerConfigFile.bufferSize);
+        ASSERT_ARE_EQUAL(size_t, 0, result->selectee.loggerConfigFile.maxFileSize);
+        ASSERT_ARE_EQUAL(size_t, 0, result->selectee.loggerConfigFile.maxFileAge);
+
+        ///cleanup
+        Logger_FreeConfiguration(result);
+    }
+
+    /*Tests_SRS_LOGGER_17_009: [ If the value named "format" is neither "json" nor "binary" then Logger_ParseConfigurationFromJson shall fail and return NULL. ]*/
+    TEST_FUNCTION(Logger_ParseConfigurationFromJson_with_unknown_format_fails)
+    {
+        ///arrange
+        CLoggerMocks mocks;
+
+        STRICT_EXPECTED_CALL(mocks, json_parse_string(VALID_CONFIG_STRING));
+        STRICT_EXPECTED_CALL(mocks, json_value_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_value_get_object(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "filename"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "format"))
+            .IgnoreArgument(1)
+            .SetReturn("xml");
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "bufferSize"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "maxFileSize"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "maxFileAge"))
+            .IgnoreArgument(1);
+
+        ///act
+        auto result = Logger_ParseConfigurationFromJson(VALID_CONFIG_STRING);
+
+        ///assert
+        ASSERT_IS_NULL(result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_LOGGER_17_011: [ If "bufferSize", "maxFileSize" or "maxFileAge" is negative then Logger_ParseConfigurationFromJson shall fail and return NULL. ]*/
+    TEST_FUNCTION(Logger_ParseConfigurationFromJson_with_negative_maxFileSize_fails)
+    {
+        ///arrange
+        CLoggerMocks mocks;
+
+        STRICT_EXPECTED_CALL(mocks, json_parse_string(VALID_CONFIG_STRING));
+        STRICT_EXPECTED_CALL(mocks, json_value_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_value_get_object(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "filename"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "format"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "bufferSize"))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "maxFileSize"))
+            .IgnoreArgument(1)
+            .SetReturn(-1);
+        STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "maxFileAge"))
+            .IgnoreArgument(1);
+
+        ///act
+        auto result = Logger_ParseConfigurationFromJson(VALID_CONFIG_STRING);
+
+        ///assert
+        ASSERT_IS_NULL(result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+    }
+
     /*Tests_SRS_LOGGER_17_005: [ Logger_FreeConfiguration shall free all resources created by Logger_ParseConfigurationFromJson. ]*/
 	TEST_FUNCTION(Logger_FreeConfiguration_happy_path_succeeds)
 	{
@@ -585,6 +754,14 @@ BEGIN_TEST_SUITE(logger_ut)
 			.IgnoreArgument(1);
 		STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "filename")) /*this is getting a json string that is what follows "filename": in the json*/
 			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "format")) /*this is getting the optional record format*/
+			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "bufferSize")) /*these are getting the optional writer settings*/
+			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "maxFileSize"))
+			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "maxFileAge"))
+			.IgnoreArgument(1);
 		STRICT_EXPECTED_CALL(mocks, gballoc_malloc(sizeof(LOGGER_CONFIG)));
 		STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 			.IgnoreArgument(1)
@@ -716,7 +893,7 @@ BEGIN_TEST_SUITE(logger_ut)
         STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG)) /*this is transforming the time from time_t to struct tm* */
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "{\"time\":\"%C\",\"content\":\"Log started\"}]", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
+        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "{\"time\":\"%c\",\"content\":\"Log started\"}]", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
             .IgnoreArgument(1)
             .IgnoreArgument(2)
             .IgnoreArgument(4);
@@ -778,7 +955,7 @@ BEGIN_TEST_SUITE(logger_ut)
         STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG)) /*this is transforming the time from time_t to struct tm* */
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "{\"time\":\"%C\",\"content\":\"Log started\"}]", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
+        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "{\"time\":\"%c\",\"content\":\"Log started\"}]", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
             .IgnoreArgument(1)
             .IgnoreArgument(2)
             .IgnoreArgument(4);
@@ -841,7 +1018,7 @@ BEGIN_TEST_SUITE(logger_ut)
         STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG)) /*this is transforming the time from time_t to struct tm* */
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "{\"time\":\"%C\",\"content\":\"Log started\"}]", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
+        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "{\"time\":\"%c\",\"content\":\"Log started\"}]", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
             .IgnoreArgument(1)
             .IgnoreArgument(2)
             .IgnoreArgument(4);
@@ -899,7 +1076,7 @@ BEGIN_TEST_SUITE(logger_ut)
         STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG)) /*this is transforming the time from time_t to struct tm* */
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "{\"time\":\"%C\",\"content\":\"Log started\"}]", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
+        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "{\"time\":\"%c\",\"content\":\"Log started\"}]", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
             .IgnoreArgument(1)
             .IgnoreArgument(2)
             .IgnoreArgument(4)
@@ -1211,7 +1388,7 @@ BEGIN_TEST_SUITE(logger_ut)
         STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG)) /*this is transforming the time from time_t to struct tm* */
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, ",{\"time\":\"%C\",\"content\":\"Log started\"}]", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
+        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, ",{\"time\":\"%c\",\"content\":\"Log started\"}]", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
             .IgnoreArgument(1)
             .IgnoreArgument(2)
             .IgnoreArgument(4);
@@ -1289,7 +1466,7 @@ BEGIN_TEST_SUITE(logger_ut)
         STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG)) /*this is transforming the time from time_t to struct tm* */
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "%C", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
+        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "%c", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
             .IgnoreArgument(1)
             .IgnoreArgument(2)
             .IgnoreArgument(4);
@@ -1310,31 +1487,12 @@ BEGIN_TEST_SUITE(logger_ut)
 
         STRICT_EXPECTED_CALL(mocks, Message_GetContent(validMessageHandle)); /*this is getting the content*/
 
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(buffer, sizeof(buffer) / sizeof(buffer[0]))); /*this is getting a STRING_HANDLE that is the base64 encode of the bytes*/
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_construct(",{\"time\":\"")); /*this is the actual JSON object building*/
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*this is harvesting the const char* of the properties*/
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is adding the real time to the json*/
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\",\"properties\":")) /*this is adding the "properties":" string*/
-            .IgnoreArgument(1); 
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is adding the result of MapToJSON*/
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, ",\"content\":\"")) /*this is adding the ,"content":"*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is adding the result of base64_encode*/
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\"}]")) /*this closes the JSON*/
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is the JSON object, the content is encoded straight into it*/
             .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*this is harvesting the const char* of the json string*/
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(mocks, gb_fseek(IGNORED_PTR_ARG, -1, SEEK_END)) /*this is rewinding the file by 1 character*/
@@ -1352,6 +1510,7 @@ BEGIN_TEST_SUITE(logger_ut)
         ///assert
         mocks.AssertActualAndExpectedCalls();
         ASSERT_ARE_EQUAL(size_t, 1, CURRENT_API_CALL(gb_fprintf));
+        ASSERT_ARE_EQUAL(char_ptr, ",{\"time\":\"" TIME_IN_STRFTIME "\",\"properties\":thisIsRandomContent,\"content\":\"AQID\"}]", all_fprintfs[0]);
 
         ///cleanup
         Logger_Destroy(moduleHandle);
@@ -1376,7 +1535,7 @@ BEGIN_TEST_SUITE(logger_ut)
 		STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG)) /*this is transforming the time from time_t to struct tm* */
 			.IgnoreArgument(1);
 
-		STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "%C", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
+		STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "%c", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
 			.IgnoreArgument(1)
 			.IgnoreArgument(2)
 			.IgnoreArgument(4);
@@ -1397,31 +1556,12 @@ BEGIN_TEST_SUITE(logger_ut)
 
 		STRICT_EXPECTED_CALL(mocks, Message_GetContent(validMessageHandle)).SetReturn(&empty_content); /*this is getting the content*/
 
-		STRICT_EXPECTED_CALL(mocks, STRING_construct_n("", 0));
-		STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-			.IgnoreArgument(1);
-
-		STRICT_EXPECTED_CALL(mocks, STRING_construct(",{\"time\":\"")); /*this is the actual JSON object building*/
-		STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+		STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*this is harvesting the const char* of the properties*/
 			.IgnoreArgument(1);
 
-		STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is adding the real time to the json*/
-			.IgnoreArgument(1)
-			.IgnoreArgument(2);
-		STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\",\"properties\":")) /*this is adding the "properties":" string*/
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is adding the result of MapToJSON*/
-			.IgnoreArgument(1)
-			.IgnoreArgument(2);
-		STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, ",\"content\":\"")) /*this is adding the ,"content":"*/
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is adding the result of base64_encode*/
-			.IgnoreArgument(1)
-			.IgnoreArgument(2);
-		STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\"}]")) /*this closes the JSON*/
+		STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is the JSON object, the content is encoded straight into it*/
 			.IgnoreArgument(1);
-
-		STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*this is harvesting the const char* of the json string*/
+		STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
 			.IgnoreArgument(1);
 
 		STRICT_EXPECTED_CALL(mocks, gb_fseek(IGNORED_PTR_ARG, -1, SEEK_END)) /*this is rewinding the file by 1 character*/
@@ -1459,7 +1599,7 @@ BEGIN_TEST_SUITE(logger_ut)
         STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG)) /*this is transforming the time from time_t to struct tm* */
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "%C", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
+        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "%c", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
             .IgnoreArgument(1)
             .IgnoreArgument(2)
             .IgnoreArgument(4);
@@ -1480,31 +1620,12 @@ BEGIN_TEST_SUITE(logger_ut)
 
         STRICT_EXPECTED_CALL(mocks, Message_GetContent(validMessageHandle)); /*this is getting the content*/
 
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(buffer, sizeof(buffer) / sizeof(buffer[0]))); /*this is getting a STRING_HANDLE that is the base64 encode of the bytes*/
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_construct(",{\"time\":\"")); /*this is the actual JSON object building*/
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*this is harvesting the const char* of the properties*/
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is adding the real time to the json*/
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\",\"properties\":")) /*this is adding the "properties":" string*/
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is the JSON object, the content is encoded straight into it*/
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is adding the result of MapToJSON*/
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, ",\"content\":\"")) /*this is adding the ,"content":"*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is adding the result of base64_encode*/
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\"}]")) /*this closes the JSON*/
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*this is harvesting the const char* of the json string*/
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(mocks, gb_fseek(IGNORED_PTR_ARG, -1, SEEK_END)) /*this is rewinding the file by 1 character*/
@@ -1543,7 +1664,7 @@ BEGIN_TEST_SUITE(logger_ut)
         STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG)) /*this is transforming the time from time_t to struct tm* */
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "%C", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
+        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "%c", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
             .IgnoreArgument(1)
             .IgnoreArgument(2)
             .IgnoreArgument(4);
@@ -1564,31 +1685,12 @@ BEGIN_TEST_SUITE(logger_ut)
 
         STRICT_EXPECTED_CALL(mocks, Message_GetContent(validMessageHandle)); /*this is getting the content*/
 
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(buffer, sizeof(buffer) / sizeof(buffer[0]))); /*this is getting a STRING_HANDLE that is the base64 encode of the bytes*/
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_construct(",{\"time\":\"")); /*this is the actual JSON object building*/
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*this is harvesting the const char* of the properties*/
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is adding the real time to the json*/
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\",\"properties\":")) /*this is adding the "properties":" string*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is adding the result of MapToJSON*/
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, ",\"content\":\"")) /*this is adding the ,"content":"*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is adding the result of base64_encode*/
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\"}]")) /*this closes the JSON*/
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is the JSON object, the content is encoded straight into it*/
             .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*this is harvesting the const char* of the json string*/
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(mocks, gb_fseek(IGNORED_PTR_ARG, -1, SEEK_END)) /*this is rewinding the file by 1 character*/
@@ -1608,7 +1710,7 @@ BEGIN_TEST_SUITE(logger_ut)
     }
 
     /*Tests_SRS_LOGGER_02_012: [If producing the JSON format or writing it to the file fails, then Logger_Receive shall fail and return.]*/
-    TEST_FUNCTION(Logger_Receive_fails_when_STRING_concat_fails_1)
+    TEST_FUNCTION(Logger_Receive_fails_when_malloc_fails)
     {
         ///arrange
         CLoggerMocks mocks;
@@ -1621,7 +1723,7 @@ BEGIN_TEST_SUITE(logger_ut)
         STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG)) /*this is transforming the time from time_t to struct tm* */
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "%C", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
+        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "%c", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
             .IgnoreArgument(1)
             .IgnoreArgument(2)
             .IgnoreArgument(4);
@@ -1642,31 +1744,12 @@ BEGIN_TEST_SUITE(logger_ut)
 
         STRICT_EXPECTED_CALL(mocks, Message_GetContent(validMessageHandle)); /*this is getting the content*/
 
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(buffer, sizeof(buffer) / sizeof(buffer[0]))); /*this is getting a STRING_HANDLE that is the base64 encode of the bytes*/
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_construct(",{\"time\":\"")); /*this is the actual JSON object building*/
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is adding the real time to the json*/
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\",\"properties\":")) /*this is adding the "properties":" string*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is adding the result of MapToJSON*/
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, ",\"content\":\"")) /*this is adding the ,"content":"*/
+        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*this is harvesting the const char* of the properties*/
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is adding the result of base64_encode*/
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
 
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\"}]")) /*this closes the JSON*/
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is the JSON object, the content is encoded straight into it*/
             .IgnoreArgument(1)
-            .SetFailReturn(__LINE__);
+            .SetFailReturn((void*)NULL);
 
         ///act
         Logger_Receive(moduleHandle, validMessageHandle);
@@ -1681,20 +1764,24 @@ BEGIN_TEST_SUITE(logger_ut)
     }
 
     /*Tests_SRS_LOGGER_02_012: [If producing the JSON format or writing it to the file fails, then Logger_Receive shall fail and return.]*/
-    TEST_FUNCTION(Logger_Receive_fails_when_STRING_concat_with_STRING_fails_1)
+    TEST_FUNCTION(Logger_Receive_fails_when_content_is_too_large_to_encode)
     {
         ///arrange
         CLoggerMocks mocks;
         auto moduleHandle = Logger_Create(validBrokerHandle, &validConfig);
         mocks.ResetAllCalls();
         mocks_ResetAllCounters();
+        const CONSTBUFFER too_large_content = {
+            buffer,
+            SIZE_MAX
+        };
 
         STRICT_EXPECTED_CALL(mocks, gb_time(NULL)); /*this is getting the time*/
 
         STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG)) /*this is transforming the time from time_t to struct tm* */
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "%C", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
+        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "%c", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
             .IgnoreArgument(1)
             .IgnoreArgument(2)
             .IgnoreArgument(4);
@@ -1713,32 +1800,12 @@ BEGIN_TEST_SUITE(logger_ut)
         STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetContent(validMessageHandle)); /*this is getting the content*/
-
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(buffer, sizeof(buffer) / sizeof(buffer[0]))); /*this is getting a STRING_HANDLE that is the base64 encode of the bytes*/
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_construct(",{\"time\":\"")); /*this is the actual JSON object building*/
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Message_GetContent(validMessageHandle)) /*this is getting the content*/
+            .SetReturn(&too_large_content);
 
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is adding the real time to the json*/
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\",\"properties\":")) /*this is adding the "properties":" string*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is adding the result of MapToJSON*/
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, ",\"content\":\"")) /*this is adding the ,"content":"*/
+        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*this is harvesting the const char* of the properties*/
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is adding the result of base64_encode*/
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
-            .SetFailReturn(__LINE__);
-
         ///act
         Logger_Receive(moduleHandle, validMessageHandle);
 
@@ -1751,8 +1818,55 @@ BEGIN_TEST_SUITE(logger_ut)
 
     }
 
+	/*Tests_SRS_LOGGER_02_012: [If producing the JSON format or writing it to the file fails, then Logger_Receive shall fail and return.]*/
+	TEST_FUNCTION(Logger_Receive_fails_when_content_is_null)
+	{
+		///arrange
+		CLoggerMocks mocks;
+		auto moduleHandle = Logger_Create(validBrokerHandle, &validConfig);
+		mocks.ResetAllCalls();
+		mocks_ResetAllCounters();
+
+		STRICT_EXPECTED_CALL(mocks, gb_time(NULL)); /*this is getting the time*/
+
+		STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG)) /*this is transforming the time from time_t to struct tm* */
+			.IgnoreArgument(1);
+
+		STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "%c", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
+			.IgnoreArgument(1)
+			.IgnoreArgument(2)
+			.IgnoreArgument(4);
+
+		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(validMessageHandle)); /*this is getting the properties from the message*/
+		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
+			.IgnoreArgument(1);
+
+		STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)) /*this is getting the properties in a writeable map, because ConstMap doesn't have ToJSON*/
+			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG))
+			.IgnoreArgument(1);
+
+		STRICT_EXPECTED_CALL(mocks, Map_ToJSON(IGNORED_PTR_ARG)) /*this is getting a STRING_HANDLE that is the MAP as JSON*/
+			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+			.IgnoreArgument(1);
+
+		STRICT_EXPECTED_CALL(mocks, Message_GetContent(validMessageHandle)).SetFailReturn((const CONSTBUFFER *)NULL); /*this is getting the content*/
+
+		///act
+		Logger_Receive(moduleHandle, validMessageHandle);
+
+		///assert
+		mocks.AssertActualAndExpectedCalls();
+		ASSERT_ARE_EQUAL(size_t, 0, CURRENT_API_CALL(gb_fprintf));
+
+		///cleanup
+		Logger_Destroy(moduleHandle);
+
+	}
+
     /*Tests_SRS_LOGGER_02_012: [If producing the JSON format or writing it to the file fails, then Logger_Receive shall fail and return.]*/
-    TEST_FUNCTION(Logger_Receive_fails_when_STRING_concat_fails_2)
+    TEST_FUNCTION(Logger_Receive_fails_when_Map_ToJSON_fails)
     {
         ///arrange
         CLoggerMocks mocks;
@@ -1765,7 +1879,7 @@ BEGIN_TEST_SUITE(logger_ut)
         STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG)) /*this is transforming the time from time_t to struct tm* */
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "%C", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
+        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "%c", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
             .IgnoreArgument(1)
             .IgnoreArgument(2)
             .IgnoreArgument(4);
@@ -1780,33 +1894,9 @@ BEGIN_TEST_SUITE(logger_ut)
             .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(mocks, Map_ToJSON(IGNORED_PTR_ARG)) /*this is getting a STRING_HANDLE that is the MAP as JSON*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetContent(validMessageHandle)); /*this is getting the content*/
-
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(buffer, sizeof(buffer) / sizeof(buffer[0]))); /*this is getting a STRING_HANDLE that is the base64 encode of the bytes*/
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_construct(",{\"time\":\"")); /*this is the actual JSON object building*/
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is adding the real time to the json*/
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\",\"properties\":")) /*this is adding the "properties":" string*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is adding the result of MapToJSON*/
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, ",\"content\":\"")) /*this is adding the ,"content":"*/
             .IgnoreArgument(1)
-            .SetFailReturn(__LINE__);
-
+            .SetFailReturn((STRING_HANDLE)NULL);
+        
         ///act
         Logger_Receive(moduleHandle, validMessageHandle);
 
@@ -1820,7 +1910,7 @@ BEGIN_TEST_SUITE(logger_ut)
     }
 
     /*Tests_SRS_LOGGER_02_012: [If producing the JSON format or writing it to the file fails, then Logger_Receive shall fail and return.]*/
-    TEST_FUNCTION(Logger_Receive_fails_when_STRING_concat_with_STRING_fails_2)
+    TEST_FUNCTION(Logger_Receive_fails_when_ConstMap_CloneWriteable_fails)
     {
         ///arrange
         CLoggerMocks mocks;
@@ -1833,7 +1923,7 @@ BEGIN_TEST_SUITE(logger_ut)
         STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG)) /*this is transforming the time from time_t to struct tm* */
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "%C", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
+        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "%c", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
             .IgnoreArgument(1)
             .IgnoreArgument(2)
             .IgnoreArgument(4);
@@ -1843,35 +1933,8 @@ BEGIN_TEST_SUITE(logger_ut)
             .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)) /*this is getting the properties in a writeable map, because ConstMap doesn't have ToJSON*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Map_ToJSON(IGNORED_PTR_ARG)) /*this is getting a STRING_HANDLE that is the MAP as JSON*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetContent(validMessageHandle)); /*this is getting the content*/
-
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(buffer, sizeof(buffer) / sizeof(buffer[0]))); /*this is getting a STRING_HANDLE that is the base64 encode of the bytes*/
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_construct(",{\"time\":\"")); /*this is the actual JSON object building*/
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is adding the real time to the json*/
             .IgnoreArgument(1)
-            .IgnoreArgument(2);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\",\"properties\":")) /*this is adding the "properties":" string*/
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is adding the result of MapToJSON*/
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
-            .SetFailReturn(__LINE__);
+            .SetFailReturn((MAP_HANDLE)NULL);
 
         ///act
         Logger_Receive(moduleHandle, validMessageHandle);
@@ -1886,7 +1949,7 @@ BEGIN_TEST_SUITE(logger_ut)
     }
 
     /*Tests_SRS_LOGGER_02_012: [If producing the JSON format or writing it to the file fails, then Logger_Receive shall fail and return.]*/
-    TEST_FUNCTION(Logger_Receive_fails_when_STRING_concat_fails_3)
+    TEST_FUNCTION(Logger_Receive_fails_when_gb_strftime_fails)
     {
         ///arrange
         CLoggerMocks mocks;
@@ -1899,42 +1962,11 @@ BEGIN_TEST_SUITE(logger_ut)
         STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG)) /*this is transforming the time from time_t to struct tm* */
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "%C", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
+        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "%c", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
             .IgnoreArgument(1)
             .IgnoreArgument(2)
-            .IgnoreArgument(4);
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(validMessageHandle)); /*this is getting the properties from the message*/
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)) /*this is getting the properties in a writeable map, because ConstMap doesn't have ToJSON*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Map_ToJSON(IGNORED_PTR_ARG)) /*this is getting a STRING_HANDLE that is the MAP as JSON*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetContent(validMessageHandle)); /*this is getting the content*/
-
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(buffer, sizeof(buffer) / sizeof(buffer[0]))); /*this is getting a STRING_HANDLE that is the base64 encode of the bytes*/
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_construct(",{\"time\":\"")); /*this is the actual JSON object building*/
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is adding the real time to the json*/
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\",\"properties\":")) /*this is adding the "properties":" string*/
-            .IgnoreArgument(1)
-            .SetFailReturn(__LINE__);
+            .IgnoreArgument(4)
+            .SetFailReturn(0);
 
         ///act
         Logger_Receive(moduleHandle, validMessageHandle);
@@ -1949,7 +1981,7 @@ BEGIN_TEST_SUITE(logger_ut)
     }
 
     /*Tests_SRS_LOGGER_02_012: [If producing the JSON format or writing it to the file fails, then Logger_Receive shall fail and return.]*/
-    TEST_FUNCTION(Logger_Receive_fails_when_STRING_concat_fails_4)
+    TEST_FUNCTION(Logger_Receive_fails_when_gb_localtime_fails)
     {
         ///arrange
         CLoggerMocks mocks;
@@ -1960,41 +1992,8 @@ BEGIN_TEST_SUITE(logger_ut)
         STRICT_EXPECTED_CALL(mocks, gb_time(NULL)); /*this is getting the time*/
 
         STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG)) /*this is transforming the time from time_t to struct tm* */
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "%C", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
-            .IgnoreArgument(4);
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(validMessageHandle)); /*this is getting the properties from the message*/
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)) /*this is getting the properties in a writeable map, because ConstMap doesn't have ToJSON*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Map_ToJSON(IGNORED_PTR_ARG)) /*this is getting a STRING_HANDLE that is the MAP as JSON*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetContent(validMessageHandle)); /*this is getting the content*/
-
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(buffer, sizeof(buffer) / sizeof(buffer[0]))); /*this is getting a STRING_HANDLE that is the base64 encode of the bytes*/
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_construct(",{\"time\":\"")); /*this is the actual JSON object building*/
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is adding the real time to the json*/
             .IgnoreArgument(1)
-            .IgnoreArgument(2)
-            .SetFailReturn(__LINE__);
+            .SetFailReturn((struct tm*)NULL);
 
         ///act
         Logger_Receive(moduleHandle, validMessageHandle);
@@ -2009,7 +2008,7 @@ BEGIN_TEST_SUITE(logger_ut)
     }
 
     /*Tests_SRS_LOGGER_02_012: [If producing the JSON format or writing it to the file fails, then Logger_Receive shall fail and return.]*/
-    TEST_FUNCTION(Logger_Receive_fails_when_STRING_construct_fails)
+    TEST_FUNCTION(Logger_Receive_fails_when_gb_time_fails)
     {
         ///arrange
         CLoggerMocks mocks;
@@ -2017,39 +2016,9 @@ BEGIN_TEST_SUITE(logger_ut)
         mocks.ResetAllCalls();
         mocks_ResetAllCounters();
 
-        STRICT_EXPECTED_CALL(mocks, gb_time(NULL)); /*this is getting the time*/
-
-        STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG)) /*this is transforming the time from time_t to struct tm* */
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "%C", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
-            .IgnoreArgument(4);
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(validMessageHandle)); /*this is getting the properties from the message*/
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)) /*this is getting the properties in a writeable map, because ConstMap doesn't have ToJSON*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Map_ToJSON(IGNORED_PTR_ARG)) /*this is getting a STRING_HANDLE that is the MAP as JSON*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetContent(validMessageHandle)); /*this is getting the content*/
-
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(buffer, sizeof(buffer) / sizeof(buffer[0]))); /*this is getting a STRING_HANDLE that is the base64 encode of the bytes*/
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gb_time(NULL)) /*this is getting the time*/
+            .SetFailReturn((time_t)-1);
 
-        STRICT_EXPECTED_CALL(mocks, STRING_construct(",{\"time\":\"")) /*this is the actual JSON object building*/
-            .SetFailReturn((STRING_HANDLE)NULL);
-        
         ///act
         Logger_Receive(moduleHandle, validMessageHandle);
 
@@ -2062,105 +2031,25 @@ BEGIN_TEST_SUITE(logger_ut)
 
     }
 
-    /*Tests_SRS_LOGGER_02_012: [If producing the JSON format or writing it to the file fails, then Logger_Receive shall fail and return.]*/
-    TEST_FUNCTION(Logger_Receive_fails_when_Base64_Encode_Bytes_fails)
+    /*Tests_SRS_LOGGER_02_014: [If moduleHandle is NULL then Logger_Destroy shall return.] */
+    TEST_FUNCTION(Logger_Destroy_with_NULL_parameter_returns)
     {
         ///arrange
         CLoggerMocks mocks;
-        auto moduleHandle = Logger_Create(validBrokerHandle, &validConfig);
-        mocks.ResetAllCalls();
-        mocks_ResetAllCounters();
 
-        STRICT_EXPECTED_CALL(mocks, gb_time(NULL)); /*this is getting the time*/
-
-        STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG)) /*this is transforming the time from time_t to struct tm* */
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "%C", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
-            .IgnoreArgument(4);
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(validMessageHandle)); /*this is getting the properties from the message*/
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)) /*this is getting the properties in a writeable map, because ConstMap doesn't have ToJSON*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Map_ToJSON(IGNORED_PTR_ARG)) /*this is getting a STRING_HANDLE that is the MAP as JSON*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetContent(validMessageHandle)); /*this is getting the content*/
-
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(buffer, sizeof(buffer) / sizeof(buffer[0]))) /*this is getting a STRING_HANDLE that is the base64 encode of the bytes*/
-            .SetFailReturn((STRING_HANDLE)NULL);
-                                                                        
         ///act
-        Logger_Receive(moduleHandle, validMessageHandle);
+        Logger_Destroy(NULL);
+
 
         ///assert
         mocks.AssertActualAndExpectedCalls();
-        ASSERT_ARE_EQUAL(size_t, 0, CURRENT_API_CALL(gb_fprintf));
 
         ///cleanup
-        Logger_Destroy(moduleHandle);
-
     }
 
-	/*Tests_SRS_LOGGER_02_012: [If producing the JSON format or writing it to the file fails, then Logger_Receive shall fail and return.]*/
-	TEST_FUNCTION(Logger_Receive_fails_when_content_is_null)
-	{
-		///arrange
-		CLoggerMocks mocks;
-		auto moduleHandle = Logger_Create(validBrokerHandle, &validConfig);
-		mocks.ResetAllCalls();
-		mocks_ResetAllCounters();
-
-		STRICT_EXPECTED_CALL(mocks, gb_time(NULL)); /*this is getting the time*/
-
-		STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG)) /*this is transforming the time from time_t to struct tm* */
-			.IgnoreArgument(1);
-
-		STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "%C", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
-			.IgnoreArgument(1)
-			.IgnoreArgument(2)
-			.IgnoreArgument(4);
-
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(validMessageHandle)); /*this is getting the properties from the message*/
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-			.IgnoreArgument(1);
-
-		STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)) /*this is getting the properties in a writeable map, because ConstMap doesn't have ToJSON*/
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG))
-			.IgnoreArgument(1);
-
-		STRICT_EXPECTED_CALL(mocks, Map_ToJSON(IGNORED_PTR_ARG)) /*this is getting a STRING_HANDLE that is the MAP as JSON*/
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-			.IgnoreArgument(1);
-
-		STRICT_EXPECTED_CALL(mocks, Message_GetContent(validMessageHandle)).SetFailReturn((const CONSTBUFFER *)NULL); /*this is getting the content*/
-
-		///act
-		Logger_Receive(moduleHandle, validMessageHandle);
-
-		///assert
-		mocks.AssertActualAndExpectedCalls();
-		ASSERT_ARE_EQUAL(size_t, 0, CURRENT_API_CALL(gb_fprintf));
-
-		///cleanup
-		Logger_Destroy(moduleHandle);
-
-	}
-
-    /*Tests_SRS_LOGGER_02_012: [If producing the JSON format or writing it to the file fails, then Logger_Receive shall fail and return.]*/
-    TEST_FUNCTION(Logger_Receive_fails_when_Map_ToJSON_fails)
+    /*Tests_SRS_LOGGER_02_019: [Logger_Destroy shall add to the log file the following end of log JSON object:]*/
+    /*Tests_SRS_LOGGER_02_015: [Otherwise Logger_Destroy shall unuse all used resources.]*/
+    TEST_FUNCTION(Logger_Destroy_happy_path)
     {
         ///arrange
         CLoggerMocks mocks;
@@ -2173,121 +2062,92 @@ BEGIN_TEST_SUITE(logger_ut)
         STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG)) /*this is transforming the time from time_t to struct tm* */
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "%C", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
+        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, ",{\"time\":\"%c\",\"content\":\"Log stopped\"}]", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
             .IgnoreArgument(1)
             .IgnoreArgument(2)
             .IgnoreArgument(4);
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(validMessageHandle)); /*this is getting the properties from the message*/
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(mocks, gb_fseek(IGNORED_PTR_ARG, -1, SEEK_END)) /*after getting the STRING that is the beginning of the log, it needs to be appended to the file, this essenially eats the "," from the last entry*/
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)) /*this is getting the properties in a writeable map, because ConstMap doesn't have ToJSON*/
+        /*here a call to fprintf happens({
+        "time":"timeAsPrinted by ctime",
+        "content": "Log stopped"
+        }]"
+        it is captured by a weak verification in ASSERT*/
+
+        STRICT_EXPECTED_CALL(mocks, gb_fclose(IGNORED_PTR_ARG)) /*this closes the file opened in _create*/
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG))
+
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this frees the memory allocated for the handle data*/
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, Map_ToJSON(IGNORED_PTR_ARG)) /*this is getting a STRING_HANDLE that is the MAP as JSON*/
-            .IgnoreArgument(1)
-            .SetFailReturn((STRING_HANDLE)NULL);
-        
         ///act
-        Logger_Receive(moduleHandle, validMessageHandle);
+        Logger_Destroy(moduleHandle);
 
         ///assert
         mocks.AssertActualAndExpectedCalls();
-        ASSERT_ARE_EQUAL(size_t, 0, CURRENT_API_CALL(gb_fprintf));
 
         ///cleanup
-        Logger_Destroy(moduleHandle);
-
     }
 
-    /*Tests_SRS_LOGGER_02_012: [If producing the JSON format or writing it to the file fails, then Logger_Receive shall fail and return.]*/
-    TEST_FUNCTION(Logger_Receive_fails_when_ConstMap_CloneWriteable_fails)
+    /*Tests_SRS_LOGGER_17_012: [ If the configuration asks for the binary format, a buffer or a rotation, Logger_Create shall call LoggerWriter_Create instead of opening the file and assign the result to the writer field. ]*/
+    /*Tests_SRS_LOGGER_02_008: [Otherwise Logger_Create shall return a non-NULL pointer.]*/
+    TEST_FUNCTION(Logger_Create_with_writer_settings_creates_a_writer)
     {
         ///arrange
         CLoggerMocks mocks;
-        auto moduleHandle = Logger_Create(validBrokerHandle, &validConfig);
-        mocks.ResetAllCalls();
-        mocks_ResetAllCounters();
-
-        STRICT_EXPECTED_CALL(mocks, gb_time(NULL)); /*this is getting the time*/
-
-        STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG)) /*this is transforming the time from time_t to struct tm* */
-            .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "%C", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
-            .IgnoreArgument(4);
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(validMessageHandle)); /*this is getting the properties from the message*/
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is the handle*/
             .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)) /*this is getting the properties in a writeable map, because ConstMap doesn't have ToJSON*/
-            .IgnoreArgument(1)
-            .SetFailReturn((MAP_HANDLE)NULL);
+        STRICT_EXPECTED_CALL(mocks, LoggerWriter_Create(&validConfig_buffered)); /*the writer opens the file, not Logger_Create*/
 
         ///act
-        Logger_Receive(moduleHandle, validMessageHandle);
+        auto handle = Logger_Create(validBrokerHandle, &validConfig_buffered);
 
         ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(void_ptr, (void*)validWriterHandle, (void*)((LOGGER_HANDLE_DATA*)handle)->writer);
         mocks.AssertActualAndExpectedCalls();
         ASSERT_ARE_EQUAL(size_t, 0, CURRENT_API_CALL(gb_fprintf));
 
         ///cleanup
-        Logger_Destroy(moduleHandle);
-
+        Logger_Destroy(handle);
     }
 
-    /*Tests_SRS_LOGGER_02_012: [If producing the JSON format or writing it to the file fails, then Logger_Receive shall fail and return.]*/
-    TEST_FUNCTION(Logger_Receive_fails_when_gb_strftime_fails)
+    /*Tests_SRS_LOGGER_17_013: [ If LoggerWriter_Create fails then Logger_Create shall fail and return NULL. ]*/
+    TEST_FUNCTION(Logger_Create_fails_when_LoggerWriter_Create_fails)
     {
         ///arrange
         CLoggerMocks mocks;
-        auto moduleHandle = Logger_Create(validBrokerHandle, &validConfig);
-        mocks.ResetAllCalls();
-        mocks_ResetAllCounters();
-
-        STRICT_EXPECTED_CALL(mocks, gb_time(NULL)); /*this is getting the time*/
 
-        STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG)) /*this is transforming the time from time_t to struct tm* */
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is the handle*/
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, LoggerWriter_Create(&validConfig_buffered))
+            .SetFailReturn((LOGGER_WRITER_HANDLE)NULL);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "%C", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
-            .IgnoreArgument(4)
-            .SetFailReturn(0);
 
         ///act
-        Logger_Receive(moduleHandle, validMessageHandle);
+        auto handle = Logger_Create(validBrokerHandle, &validConfig_buffered);
 
         ///assert
+        ASSERT_IS_NULL(handle);
         mocks.AssertActualAndExpectedCalls();
-        ASSERT_ARE_EQUAL(size_t, 0, CURRENT_API_CALL(gb_fprintf));
 
         ///cleanup
-        Logger_Destroy(moduleHandle);
-
     }
 
-    /*Tests_SRS_LOGGER_02_012: [If producing the JSON format or writing it to the file fails, then Logger_Receive shall fail and return.]*/
-    TEST_FUNCTION(Logger_Receive_fails_when_gb_localtime_fails)
+    /*Tests_SRS_LOGGER_17_014: [ If the module has a writer, Logger_Receive shall call LoggerWriter_WriteMessage instead of writing to fout. ]*/
+    TEST_FUNCTION(Logger_Receive_with_writer_calls_LoggerWriter_WriteMessage)
     {
         ///arrange
         CLoggerMocks mocks;
-        auto moduleHandle = Logger_Create(validBrokerHandle, &validConfig);
+        auto moduleHandle = Logger_Create(validBrokerHandle, &validConfig_buffered);
         mocks.ResetAllCalls();
         mocks_ResetAllCounters();
 
-        STRICT_EXPECTED_CALL(mocks, gb_time(NULL)); /*this is getting the time*/
-
-        STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG)) /*this is transforming the time from time_t to struct tm* */
-            .IgnoreArgument(1)
-            .SetFailReturn((struct tm*)NULL);
+        STRICT_EXPECTED_CALL(mocks, LoggerWriter_WriteMessage(validWriterHandle, validMessageHandle));
 
         ///act
         Logger_Receive(moduleHandle, validMessageHandle);
@@ -2298,23 +2158,21 @@ BEGIN_TEST_SUITE(logger_ut)
 
         ///cleanup
         Logger_Destroy(moduleHandle);
-
     }
 
-    /*Tests_SRS_LOGGER_02_012: [If producing the JSON format or writing it to the file fails, then Logger_Receive shall fail and return.]*/
-    TEST_FUNCTION(Logger_Receive_fails_when_gb_time_fails)
+    /*Tests_SRS_LOGGER_17_016: [ If moduleHandle or messageHandles is NULL then Logger_ReceiveBatch shall fail and return. ]*/
+    TEST_FUNCTION(Logger_ReceiveBatch_with_NULL_arguments_fails)
     {
         ///arrange
         CLoggerMocks mocks;
         auto moduleHandle = Logger_Create(validBrokerHandle, &validConfig);
+        MESSAGE_HANDLE messages[] = { validMessageHandle };
         mocks.ResetAllCalls();
         mocks_ResetAllCounters();
 
-        STRICT_EXPECTED_CALL(mocks, gb_time(NULL)) /*this is getting the time*/
-            .SetFailReturn((time_t)-1);
-
         ///act
-        Logger_Receive(moduleHandle, validMessageHandle);
+        Logger_ReceiveBatch(NULL, messages, 1);
+        Logger_ReceiveBatch(moduleHandle, NULL, 1);
 
         ///assert
         mocks.AssertActualAndExpectedCalls();
@@ -2322,65 +2180,114 @@ BEGIN_TEST_SUITE(logger_ut)
 
         ///cleanup
         Logger_Destroy(moduleHandle);
-
     }
 
-    /*Tests_SRS_LOGGER_02_014: [If moduleHandle is NULL then Logger_Destroy shall return.] */
-    TEST_FUNCTION(Logger_Destroy_with_NULL_parameter_returns)
+    /*Tests_SRS_LOGGER_17_017: [ Logger_ReceiveBatch shall skip NULL entries of messageHandles and log every other message the way Logger_Receive does. ]*/
+    TEST_FUNCTION(Logger_ReceiveBatch_with_writer_calls_LoggerWriter_WriteMessage_for_every_message)
     {
         ///arrange
         CLoggerMocks mocks;
+        auto moduleHandle = Logger_Create(validBrokerHandle, &validConfig_buffered);
+        MESSAGE_HANDLE messages[] = { validMessageHandle, NULL, validMessageHandle };
+        mocks.ResetAllCalls();
+        mocks_ResetAllCounters();
 
-        ///act
-        Logger_Destroy(NULL);
+        STRICT_EXPECTED_CALL(mocks, LoggerWriter_WriteMessage(validWriterHandle, validMessageHandle))
+            .ExpectedTimesExactly(2);
 
+        ///act
+        Logger_ReceiveBatch(moduleHandle, messages, 3);
 
         ///assert
         mocks.AssertActualAndExpectedCalls();
+        ASSERT_ARE_EQUAL(size_t, 0, CURRENT_API_CALL(gb_fprintf));
 
         ///cleanup
+        Logger_Destroy(moduleHandle);
     }
 
-    /*Tests_SRS_LOGGER_02_019: [Logger_Destroy shall add to the log file the following end of log JSON object:]*/
-    /*Tests_SRS_LOGGER_02_015: [Otherwise Logger_Destroy shall unuse all used resources.]*/
-    TEST_FUNCTION(Logger_Destroy_happy_path)
+    /*Tests_SRS_LOGGER_17_017: [ Logger_ReceiveBatch shall skip NULL entries of messageHandles and log every other message the way Logger_Receive does. ]*/
+    /*Tests_SRS_LOGGER_17_018: [ If the module has no writer, Logger_ReceiveBatch shall read the time once and give every message of the batch that receive time. ]*/
+    TEST_FUNCTION(Logger_ReceiveBatch_reads_the_time_once)
     {
         ///arrange
         CLoggerMocks mocks;
         auto moduleHandle = Logger_Create(validBrokerHandle, &validConfig);
+        MESSAGE_HANDLE messages[] = { validMessageHandle, NULL, validMessageHandle };
         mocks.ResetAllCalls();
         mocks_ResetAllCounters();
 
-        STRICT_EXPECTED_CALL(mocks, gb_time(NULL)); /*this is getting the time*/
-
-        STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG)) /*this is transforming the time from time_t to struct tm* */
+        STRICT_EXPECTED_CALL(mocks, gb_time(NULL)); /*this is getting the time, once for the batch*/
+        STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, ",{\"time\":\"%C\",\"content\":\"Log stopped\"}]", IGNORED_PTR_ARG)) /*this is building a JSON object in timetemp*/
+        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, "%c", IGNORED_PTR_ARG))
             .IgnoreArgument(1)
             .IgnoreArgument(2)
             .IgnoreArgument(4);
 
-        STRICT_EXPECTED_CALL(mocks, gb_fseek(IGNORED_PTR_ARG, -1, SEEK_END)) /*after getting the STRING that is the beginning of the log, it needs to be appended to the file, this essenially eats the "," from the last entry*/
-            .IgnoreArgument(1);
+        /*everything below happens once per message*/
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(validMessageHandle))
+            .ExpectedTimesExactly(2);
+        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .ExpectedTimesExactly(2);
+        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .ExpectedTimesExactly(2);
+        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .ExpectedTimesExactly(2);
+        STRICT_EXPECTED_CALL(mocks, Map_ToJSON(IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .ExpectedTimesExactly(2);
+        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .ExpectedTimesExactly(2);
+        STRICT_EXPECTED_CALL(mocks, Message_GetContent(validMessageHandle))
+            .ExpectedTimesExactly(2);
+        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .ExpectedTimesExactly(2);
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1)
+            .ExpectedTimesExactly(2);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .ExpectedTimesExactly(2);
+        STRICT_EXPECTED_CALL(mocks, gb_fseek(IGNORED_PTR_ARG, -1, SEEK_END))
+            .IgnoreArgument(1)
+            .ExpectedTimesExactly(2);
 
-        /*here a call to fprintf happens({
-        "time":"timeAsPrinted by ctime",
-        "content": "Log stopped"
-        }]"
-        it is captured by a weak verification in ASSERT*/
+        ///act
+        Logger_ReceiveBatch(moduleHandle, messages, 3);
 
-        STRICT_EXPECTED_CALL(mocks, gb_fclose(IGNORED_PTR_ARG)) /*this closes the file opened in _create*/
-            .IgnoreArgument(1);
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+        ASSERT_ARE_EQUAL(size_t, 2, CURRENT_API_CALL(gb_fprintf));
+        ASSERT_ARE_EQUAL(char_ptr, ",{\"time\":\"" TIME_IN_STRFTIME "\",\"properties\":thisIsRandomContent,\"content\":\"AQID\"}]", all_fprintfs[1]);
 
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this frees the memory allocated for the handle data*/
-            .IgnoreArgument(1);
+        ///cleanup
+        Logger_Destroy(moduleHandle);
+    }
+
+    /*Tests_SRS_LOGGER_17_015: [ If the module has a writer, Logger_Destroy shall call LoggerWriter_Destroy instead of writing to fout. ]*/
+    TEST_FUNCTION(Logger_Destroy_with_writer_calls_LoggerWriter_Destroy)
+    {
+        ///arrange
+        CLoggerMocks mocks;
+        auto moduleHandle = Logger_Create(validBrokerHandle, &validConfig_buffered);
+        mocks.ResetAllCalls();
+        mocks_ResetAllCounters();
+
+        STRICT_EXPECTED_CALL(mocks, LoggerWriter_Destroy(validWriterHandle));
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(moduleHandle));
 
         ///act
         Logger_Destroy(moduleHandle);
 
         ///assert
         mocks.AssertActualAndExpectedCalls();
+        ASSERT_ARE_EQUAL(size_t, 0, CURRENT_API_CALL(gb_fprintf));
 
         ///cleanup
     }
@@ -2402,4 +2309,19 @@ BEGIN_TEST_SUITE(logger_ut)
         ASSERT_IS_TRUE(MODULE_DESTROY(result) != NULL);
         ASSERT_IS_TRUE(MODULE_RECEIVE(result) != NULL);
     }
+
+    /*Tests_SRS_LOGGER_17_019: [ Module_GetApi shall return the MODULE_API_2 table, which adds Logger_ReceiveBatch, if gateway_api_version is MODULE_API_VERSION_2 or later, and the MODULE_API_1 table otherwise. ]*/
+    TEST_FUNCTION(Module_GetApi_returns_ReceiveBatch_only_for_version_2)
+    {
+        ///arrange
+
+        ///act
+        const MODULE_API* apis_1 = Module_GetApi(MODULE_API_VERSION_1);
+        const MODULE_API* apis_2 = Module_GetApi(MODULE_API_VERSION_2);
+
+        ///assert
+        ASSERT_IS_NULL(MODULE_RECEIVE_BATCH(apis_1));
+        ASSERT_IS_TRUE(MODULE_RECEIVE_BATCH(apis_2) != NULL);
+        ASSERT_IS_TRUE(MODULE_RECEIVE(apis_2) == MODULE_RECEIVE(apis_1));
+    }
 END_TEST_SUITE(logger_ut)
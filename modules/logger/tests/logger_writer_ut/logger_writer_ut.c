@@ -0,0 +1,653 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#define GATEWAY_EXPORT_H
+#define GATEWAY_EXPORT
+
+void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/map.h"
+#include "azure_c_shared_utility/constmap.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "message.h"
+
+#undef ENABLE_MOCKS
+
+#include "logger_writer.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+#ifdef _MSC_VER
+#pragma warning(disable:4505)
+#endif
+
+#define TEST_LOG_FILE "logger_writer_ut.log"
+#define TEST_ROTATED_LOG_FILE "logger_writer_ut.log.1"
+
+static const unsigned char serialized_message[] = { 0xA1, 0x60, 0x01, 0x02, 0x03 };
+static const unsigned char content_bytes[] = { 0x01, 0x02, 0x03 };
+static const CONSTBUFFER test_content = { content_bytes, sizeof(content_bytes) };
+static const char test_properties_json[] = "{\"a\":\"b\"}";
+static int32_t serialized_size = (int32_t)sizeof(serialized_message);
+
+static MESSAGE_HANDLE validMessageHandle = (MESSAGE_HANDLE)0x42;
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+/*the writer thread runs when it is joined, so a test sees everything it wrote once LoggerWriter_Destroy returns*/
+static THREAD_START_FUNC thread_func;
+static void* thread_arg;
+
+static THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
+{
+    thread_func = func;
+    thread_arg = arg;
+    *threadHandle = (THREAD_HANDLE)0x50;
+    return THREADAPI_OK;
+}
+
+static THREADAPI_RESULT my_ThreadAPI_Join(THREAD_HANDLE threadHandle, int* res)
+{
+    int thread_result = (*thread_func)(thread_arg);
+    (void)threadHandle;
+    if (res != NULL)
+    {
+        *res = thread_result;
+    }
+    return THREADAPI_OK;
+}
+
+static LOCK_HANDLE my_Lock_Init(void)
+{
+    return (LOCK_HANDLE)my_gballoc_malloc(1);
+}
+
+static LOCK_RESULT my_Lock_Deinit(LOCK_HANDLE handle)
+{
+    my_gballoc_free(handle);
+    return LOCK_OK;
+}
+
+static COND_HANDLE my_Condition_Init(void)
+{
+    return (COND_HANDLE)my_gballoc_malloc(1);
+}
+
+static void my_Condition_Deinit(COND_HANDLE handle)
+{
+    my_gballoc_free(handle);
+}
+
+static int32_t my_Message_ToByteArray(MESSAGE_HANDLE messageHandle, unsigned char* buf, int32_t size)
+{
+    (void)messageHandle;
+    if ((buf != NULL) && (size >= serialized_size))
+    {
+        int32_t i;
+        for (i = 0; i < serialized_size; i++)
+        {
+            buf[i] = serialized_message[i % sizeof(serialized_message)];
+        }
+    }
+    return serialized_size;
+}
+
+/*STRING handles are the C strings they hold*/
+static const char* my_STRING_c_str(STRING_HANDLE handle)
+{
+    return (const char*)handle;
+}
+
+static size_t my_STRING_length(STRING_HANDLE handle)
+{
+    return strlen((const char*)handle);
+}
+
+static STRING_HANDLE my_Map_ToJSON(MAP_HANDLE handle)
+{
+    (void)handle;
+    return (STRING_HANDLE)test_properties_json;
+}
+
+static unsigned char* read_file(const char* fileName, size_t* size)
+{
+    unsigned char* result;
+    FILE* file = fopen(fileName, "rb");
+    ASSERT_IS_NOT_NULL(file);
+    ASSERT_ARE_EQUAL(int, 0, fseek(file, 0, SEEK_END));
+    *size = (size_t)ftell(file);
+    ASSERT_ARE_EQUAL(int, 0, fseek(file, 0, SEEK_SET));
+    result = (unsigned char*)malloc(*size + 1);
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(size_t, *size, fread(result, 1, *size, file));
+    result[*size] = '\0';
+    (void)fclose(file);
+    return result;
+}
+
+static void write_file(const char* fileName, const char* text)
+{
+    FILE* file = fopen(fileName, "wb");
+    ASSERT_IS_NOT_NULL(file);
+    ASSERT_ARE_EQUAL(size_t, strlen(text), fwrite(text, 1, strlen(text), file));
+    (void)fclose(file);
+}
+
+static uint32_t read_uint32(const unsigned char* source)
+{
+    return
+        ((uint32_t)source[0] << 24) |
+        ((uint32_t)source[1] << 16) |
+        ((uint32_t)source[2] << 8) |
+        (uint32_t)source[3];
+}
+
+static bool ends_with(const unsigned char* text, size_t size, const char* suffix)
+{
+    size_t suffixSize = strlen(suffix);
+    return (size >= suffixSize) && (memcmp(text + size - suffixSize, suffix, suffixSize) == 0);
+}
+
+static LOGGER_CONFIG make_config(LOGGER_FORMAT format, size_t bufferSize, size_t maxFileSize)
+{
+    LOGGER_CONFIG config;
+    (void)memset(&config, 0, sizeof(config));
+    config.selector = LOGGING_TO_FILE;
+    config.selectee.loggerConfigFile.name = TEST_LOG_FILE;
+    config.selectee.loggerConfigFile.format = format;
+    config.selectee.loggerConfigFile.bufferSize = bufferSize;
+    config.selectee.loggerConfigFile.maxFileSize = maxFileSize;
+    return config;
+}
+
+BEGIN_TEST_SUITE(logger_writer_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+    umocktypes_charptr_register_types();
+    umocktypes_stdint_register_types();
+
+    REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(CONSTMAP_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
+
+    // malloc/free hooks
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    // thread hooks
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Join, my_ThreadAPI_Join);
+
+    //Lock Hooks
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Init, my_Lock_Init);
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Deinit, my_Lock_Deinit);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+
+    //Condition Hooks
+    REGISTER_GLOBAL_MOCK_HOOK(Condition_Init, my_Condition_Init);
+    REGISTER_GLOBAL_MOCK_HOOK(Condition_Deinit, my_Condition_Deinit);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Post, COND_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Wait, COND_OK);
+
+    // message, map and STRING
+    REGISTER_GLOBAL_MOCK_HOOK(Message_ToByteArray, my_Message_ToByteArray);
+    REGISTER_GLOBAL_MOCK_RETURN(Message_GetProperties, (CONSTMAP_HANDLE)0x43);
+    REGISTER_GLOBAL_MOCK_RETURN(Message_GetContent, &test_content);
+    REGISTER_GLOBAL_MOCK_RETURN(ConstMap_CloneWriteable, (MAP_HANDLE)0x44);
+    REGISTER_GLOBAL_MOCK_HOOK(Map_ToJSON, my_Map_ToJSON);
+    REGISTER_GLOBAL_MOCK_HOOK(STRING_c_str, my_STRING_c_str);
+    REGISTER_GLOBAL_MOCK_HOOK(STRING_length, my_STRING_length);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest) != 0)
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+    serialized_size = (int32_t)sizeof(serialized_message);
+    thread_func = NULL;
+    thread_arg = NULL;
+    (void)remove(TEST_LOG_FILE);
+    (void)remove(TEST_ROTATED_LOG_FILE);
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    (void)remove(TEST_LOG_FILE);
+    (void)remove(TEST_ROTATED_LOG_FILE);
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_LOGGER_WRITER_17_001: [ If `config` is `NULL`, its selector is not `LOGGING_TO_FILE` or it names no file, `LoggerWriter_Create` shall fail and return `NULL`. ]*/
+TEST_FUNCTION(LoggerWriter_Create_with_bad_config_fails)
+{
+    ///arrange
+    LOGGER_CONFIG noName = make_config(LOGGER_FORMAT_JSON, 0, 0);
+    LOGGER_CONFIG badSelector = make_config(LOGGER_FORMAT_JSON, 0, 0);
+    noName.selectee.loggerConfigFile.name = NULL;
+    badSelector.selector = (LOGGER_TYPE)~LOGGING_TO_FILE;
+
+    ///act
+    LOGGER_WRITER_HANDLE result1 = LoggerWriter_Create(NULL);
+    LOGGER_WRITER_HANDLE result2 = LoggerWriter_Create(&noName);
+    LOGGER_WRITER_HANDLE result3 = LoggerWriter_Create(&badSelector);
+
+    ///assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+    ASSERT_IS_NULL(result3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_LOGGER_WRITER_17_002: [ `LoggerWriter_Create` shall allocate two buffers of `bufferSize` bytes, or `LOGGER_WRITER_DEFAULT_BUFFER_SIZE` bytes if `bufferSize` is 0, rounded up to a multiple of `LOGGER_WRITER_BUFFER_ALIGNMENT` and aligned on `LOGGER_WRITER_BUFFER_ALIGNMENT` bytes. ]*/
+/*Tests_SRS_LOGGER_WRITER_17_006: [ `LoggerWriter_Create` shall create a lock, two conditions and a thread that writes the buffers to the file. ]*/
+/*Tests_SRS_LOGGER_WRITER_17_008: [ Otherwise `LoggerWriter_Create` shall return a non-`NULL` handle. ]*/
+TEST_FUNCTION(LoggerWriter_Create_succeeds)
+{
+    ///arrange
+    LOGGER_CONFIG config = make_config(LOGGER_FORMAT_JSON, 0, 0);
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*the writer*/
+    STRICT_EXPECTED_CALL(gballoc_malloc(LOGGER_WRITER_DEFAULT_BUFFER_SIZE + LOGGER_WRITER_BUFFER_ALIGNMENT - 1));
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    STRICT_EXPECTED_CALL(gballoc_malloc(LOGGER_WRITER_DEFAULT_BUFFER_SIZE + LOGGER_WRITER_BUFFER_ALIGNMENT - 1));
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    ///act
+    LOGGER_WRITER_HANDLE result = LoggerWriter_Create(&config);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    LoggerWriter_Destroy(result);
+}
+
+/*Tests_SRS_LOGGER_WRITER_17_007: [ If any step fails, `LoggerWriter_Create` shall release everything it acquired and return `NULL`. ]*/
+TEST_FUNCTION(LoggerWriter_Create_fails_when_the_thread_cannot_start)
+{
+    ///arrange
+    LOGGER_CONFIG config = make_config(LOGGER_FORMAT_JSON, 0, 0);
+    unsigned char* log;
+    size_t size;
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(THREADAPI_ERROR);
+    STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    ///act
+    LOGGER_WRITER_HANDLE result = LoggerWriter_Create(&config);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    log = read_file(TEST_LOG_FILE, &size);
+    ASSERT_IS_TRUE(ends_with(log, size, "\"content\":\"Log stopped\"}]"));
+
+    ///cleanup
+    free(log);
+}
+
+/*Tests_SRS_LOGGER_WRITER_17_003: [ `LoggerWriter_Create` shall open the file in update mode, create it if it does not exist, and turn off the stdio buffering of the file. ]*/
+/*Tests_SRS_LOGGER_WRITER_17_004: [ If the format is `LOGGER_FORMAT_JSON`, `LoggerWriter_Create` shall start a JSON array holding a "Log started" marker in an empty file, or add the marker to the array already in the file, in place of its closing `]` if there is one. ]*/
+/*Tests_SRS_LOGGER_WRITER_17_010: [ If the format is `LOGGER_FORMAT_JSON`, the record shall be `,{"time":"<time>","properties":<properties>,"content":"<content>"}`, where the time is printed by `strftime` at most once per second, the properties are made by `Map_ToJSON` and the content is encoded by `Base64Encoder_Encode` straight into the buffer. ]*/
+/*Tests_SRS_LOGGER_WRITER_17_016: [ Otherwise `LoggerWriter_WriteMessage` shall return 0. ]*/
+/*Tests_SRS_LOGGER_WRITER_17_022: [ `LoggerWriter_Destroy` shall write the records the writer thread left behind, mark the end of the log and close the file. ]*/
+TEST_FUNCTION(LoggerWriter_writes_a_json_log)
+{
+    ///arrange
+    LOGGER_CONFIG config = make_config(LOGGER_FORMAT_JSON, 0, 0);
+    LOGGER_WRITER_HANDLE writer = LoggerWriter_Create(&config);
+    unsigned char* log;
+    size_t size;
+    ASSERT_IS_NOT_NULL(writer);
+
+    ///act
+    int result1 = LoggerWriter_WriteMessage(writer, validMessageHandle);
+    int result2 = LoggerWriter_WriteMessage(writer, validMessageHandle);
+    LoggerWriter_Destroy(writer);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result1);
+    ASSERT_ARE_EQUAL(int, 0, result2);
+    log = read_file(TEST_LOG_FILE, &size);
+    ASSERT_ARE_EQUAL(int, 0, strncmp((const char*)log, "[{\"time\":\"", 10));
+    ASSERT_IS_NOT_NULL(strstr((const char*)log, "\"content\":\"Log started\"},{\"time\":\""));
+    ASSERT_IS_NOT_NULL(strstr((const char*)log, "\",\"properties\":{\"a\":\"b\"},\"content\":\"AQID\"},{\"time\":\""));
+    ASSERT_IS_TRUE(ends_with(log, size, "\"content\":\"Log stopped\"}]"));
+
+    ///cleanup
+    free(log);
+}
+
+/*Tests_SRS_LOGGER_WRITER_17_004: [ If the format is `LOGGER_FORMAT_JSON`, `LoggerWriter_Create` shall start a JSON array holding a "Log started" marker in an empty file, or add the marker to the array already in the file, in place of its closing `]` if there is one. ]*/
+TEST_FUNCTION(LoggerWriter_appends_to_a_stopped_json_log)
+{
+    ///arrange
+    LOGGER_CONFIG config = make_config(LOGGER_FORMAT_JSON, 0, 0);
+    LOGGER_WRITER_HANDLE writer;
+    unsigned char* log;
+    size_t size;
+    write_file(TEST_LOG_FILE, "[{\"content\":\"Log stopped\"}]");
+
+    ///act
+    writer = LoggerWriter_Create(&config);
+    LoggerWriter_Destroy(writer);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(writer);
+    log = read_file(TEST_LOG_FILE, &size);
+    ASSERT_ARE_EQUAL(int, 0, strncmp((const char*)log, "[{\"content\":\"Log stopped\"},{\"time\":\"", 36));
+    ASSERT_IS_NOT_NULL(strstr((const char*)log, "\"content\":\"Log started\"},{\"time\":\""));
+    ASSERT_IS_TRUE(ends_with(log, size, "\"content\":\"Log stopped\"}]"));
+
+    ///cleanup
+    free(log);
+}
+
+/*Tests_SRS_LOGGER_WRITER_17_005: [ If the format is `LOGGER_FORMAT_BINARY`, `LoggerWriter_Create` shall write the binary log header to an empty file, fail if a file that is not empty does not start with it, and add a `LOGGER_RECORD_LOG_STARTED` record. ]*/
+/*Tests_SRS_LOGGER_WRITER_17_011: [ If the format is `LOGGER_FORMAT_BINARY`, the record shall be a record header with the size of the payload, the kind `LOGGER_RECORD_MESSAGE` and the time, followed by the message serialized by `Message_ToByteArray`. ]*/
+/*Tests_SRS_LOGGER_WRITER_17_022: [ `LoggerWriter_Destroy` shall write the records the writer thread left behind, mark the end of the log and close the file. ]*/
+TEST_FUNCTION(LoggerWriter_writes_a_binary_log)
+{
+    ///arrange
+    const unsigned char expectedHeader[LOGGER_BINARY_FILE_HEADER_SIZE] = { 0xA1, 0x6C, 0x00, LOGGER_BINARY_FILE_VERSION };
+    LOGGER_CONFIG config = make_config(LOGGER_FORMAT_BINARY, 0, 0);
+    LOGGER_WRITER_HANDLE writer = LoggerWriter_Create(&config);
+    unsigned char* log;
+    const unsigned char* record;
+    size_t size;
+    ASSERT_IS_NOT_NULL(writer);
+
+    ///act
+    int result = LoggerWriter_WriteMessage(writer, validMessageHandle);
+    LoggerWriter_Destroy(writer);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    log = read_file(TEST_LOG_FILE, &size);
+    ASSERT_ARE_EQUAL(size_t, LOGGER_BINARY_FILE_HEADER_SIZE + 3 * LOGGER_BINARY_RECORD_HEADER_SIZE + sizeof(serialized_message), size);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(expectedHeader, log, sizeof(expectedHeader)));
+    record = log + LOGGER_BINARY_FILE_HEADER_SIZE;
+    ASSERT_ARE_EQUAL(uint32_t, 0, read_uint32(record));
+    ASSERT_ARE_EQUAL(int, (int)LOGGER_RECORD_LOG_STARTED, (int)record[4]);
+    record += LOGGER_BINARY_RECORD_HEADER_SIZE;
+    ASSERT_ARE_EQUAL(uint32_t, sizeof(serialized_message), read_uint32(record));
+    ASSERT_ARE_EQUAL(int, (int)LOGGER_RECORD_MESSAGE, (int)record[4]);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(serialized_message, record + LOGGER_BINARY_RECORD_HEADER_SIZE, sizeof(serialized_message)));
+    record += LOGGER_BINARY_RECORD_HEADER_SIZE + sizeof(serialized_message);
+    ASSERT_ARE_EQUAL(uint32_t, 0, read_uint32(record));
+    ASSERT_ARE_EQUAL(int, (int)LOGGER_RECORD_LOG_STOPPED, (int)record[4]);
+
+    ///cleanup
+    free(log);
+}
+
+/*Tests_SRS_LOGGER_WRITER_17_005: [ If the format is `LOGGER_FORMAT_BINARY`, `LoggerWriter_Create` shall write the binary log header to an empty file, fail if a file that is not empty does not start with it, and add a `LOGGER_RECORD_LOG_STARTED` record. ]*/
+/*Tests_SRS_LOGGER_WRITER_17_007: [ If any step fails, `LoggerWriter_Create` shall release everything it acquired and return `NULL`. ]*/
+TEST_FUNCTION(LoggerWriter_Create_fails_on_a_file_that_is_not_a_binary_log)
+{
+    ///arrange
+    LOGGER_CONFIG config = make_config(LOGGER_FORMAT_BINARY, 0, 0);
+    unsigned char* log;
+    size_t size;
+    write_file(TEST_LOG_FILE, "[]");
+
+    ///act
+    LOGGER_WRITER_HANDLE result = LoggerWriter_Create(&config);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    log = read_file(TEST_LOG_FILE, &size);
+    ASSERT_ARE_EQUAL(size_t, 2, size);
+
+    ///cleanup
+    free(log);
+}
+
+/*Tests_SRS_LOGGER_WRITER_17_009: [ If `writer` or `message` is `NULL`, `LoggerWriter_WriteMessage` shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(LoggerWriter_WriteMessage_with_NULL_arguments_fails)
+{
+    ///arrange
+    LOGGER_CONFIG config = make_config(LOGGER_FORMAT_BINARY, 0, 0);
+    LOGGER_WRITER_HANDLE writer = LoggerWriter_Create(&config);
+    ASSERT_IS_NOT_NULL(writer);
+    umock_c_reset_all_calls();
+
+    ///act
+    int result1 = LoggerWriter_WriteMessage(NULL, validMessageHandle);
+    int result2 = LoggerWriter_WriteMessage(writer, NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    LoggerWriter_Destroy(writer);
+}
+
+/*Tests_SRS_LOGGER_WRITER_17_012: [ `LoggerWriter_WriteMessage` shall write the record into the buffer being filled while it holds the lock. ]*/
+TEST_FUNCTION(LoggerWriter_WriteMessage_writes_under_the_lock)
+{
+    ///arrange
+    LOGGER_CONFIG config = make_config(LOGGER_FORMAT_BINARY, 0, 0);
+    LOGGER_WRITER_HANDLE writer = LoggerWriter_Create(&config);
+    ASSERT_IS_NOT_NULL(writer);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Message_ToByteArray(validMessageHandle, NULL, 0));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Message_ToByteArray(validMessageHandle, IGNORED_PTR_ARG, sizeof(serialized_message)));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    ///act
+    int result = LoggerWriter_WriteMessage(writer, validMessageHandle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    LoggerWriter_Destroy(writer);
+}
+
+/*Tests_SRS_LOGGER_WRITER_17_014: [ If the record is larger than an empty buffer, `LoggerWriter_WriteMessage` shall grow the buffer to fit it. ]*/
+TEST_FUNCTION(LoggerWriter_WriteMessage_grows_the_buffer_for_a_large_record)
+{
+    ///arrange
+    LOGGER_CONFIG config = make_config(LOGGER_FORMAT_BINARY, 1, 0);
+    LOGGER_WRITER_HANDLE writer = LoggerWriter_Create(&config);
+    unsigned char* log;
+    size_t size;
+    ASSERT_IS_NOT_NULL(writer);
+    serialized_size = 3 * LOGGER_WRITER_BUFFER_ALIGNMENT;
+
+    ///act
+    int result = LoggerWriter_WriteMessage(writer, validMessageHandle);
+    LoggerWriter_Destroy(writer);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    log = read_file(TEST_LOG_FILE, &size);
+    ASSERT_ARE_EQUAL(size_t, LOGGER_BINARY_FILE_HEADER_SIZE + 3 * LOGGER_BINARY_RECORD_HEADER_SIZE + (size_t)serialized_size, size);
+    ASSERT_ARE_EQUAL(uint32_t, (uint32_t)serialized_size, read_uint32(log + LOGGER_BINARY_FILE_HEADER_SIZE + LOGGER_BINARY_RECORD_HEADER_SIZE));
+
+    ///cleanup
+    free(log);
+}
+
+/*Tests_SRS_LOGGER_WRITER_17_015: [ If any step fails, `LoggerWriter_WriteMessage` shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(LoggerWriter_WriteMessage_fails_when_Map_ToJSON_fails)
+{
+    ///arrange
+    LOGGER_CONFIG config = make_config(LOGGER_FORMAT_JSON, 0, 0);
+    LOGGER_WRITER_HANDLE writer = LoggerWriter_Create(&config);
+    ASSERT_IS_NOT_NULL(writer);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Message_GetProperties(validMessageHandle));
+    STRICT_EXPECTED_CALL(ConstMap_CloneWriteable(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Map_ToJSON(IGNORED_PTR_ARG))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(Map_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(ConstMap_Destroy(IGNORED_PTR_ARG));
+
+    ///act
+    int result = LoggerWriter_WriteMessage(writer, validMessageHandle);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    LoggerWriter_Destroy(writer);
+}
+
+/*Tests_SRS_LOGGER_WRITER_17_017: [ The writer thread shall wait until records are appended or `LOGGER_WRITER_PERIOD_MS` milliseconds pass, swap the buffers under the lock, and write the buffer full of records to the file with a single `fwrite` once the lock is released. ]*/
+/*Tests_SRS_LOGGER_WRITER_17_018: [ After it writes a buffer, and at least every `LOGGER_WRITER_PERIOD_MS` milliseconds, the writer thread shall rotate a log file that holds records and has reached `maxFileSize` bytes or is `maxFileAge` seconds old: it shall mark the end of the log, close the file, rename it `<name>.<n>` with `n` the first number not taken yet, and start a new log in a new file named `<name>`. ]*/
+/*Tests_SRS_LOGGER_WRITER_17_019: [ The writer thread shall return once it is asked to stop and every record appended before has been written. ]*/
+TEST_FUNCTION(LoggerWriter_rotates_a_log_that_reached_maxFileSize)
+{
+    ///arrange
+    LOGGER_CONFIG config = make_config(LOGGER_FORMAT_BINARY, 0, 1);
+    LOGGER_WRITER_HANDLE writer = LoggerWriter_Create(&config);
+    unsigned char* rotatedLog;
+    unsigned char* log;
+    size_t rotatedSize;
+    size_t size;
+    ASSERT_IS_NOT_NULL(writer);
+    ASSERT_ARE_EQUAL(int, 0, LoggerWriter_WriteMessage(writer, validMessageHandle));
+
+    ///act
+    LoggerWriter_Destroy(writer);
+
+    ///assert
+    rotatedLog = read_file(TEST_ROTATED_LOG_FILE, &rotatedSize);
+    log = read_file(TEST_LOG_FILE, &size);
+    ASSERT_ARE_EQUAL(size_t, LOGGER_BINARY_FILE_HEADER_SIZE + 3 * LOGGER_BINARY_RECORD_HEADER_SIZE + sizeof(serialized_message), rotatedSize);
+    ASSERT_ARE_EQUAL(int, (int)LOGGER_RECORD_LOG_STOPPED, (int)rotatedLog[rotatedSize - LOGGER_BINARY_RECORD_HEADER_SIZE + 4]);
+    ASSERT_ARE_EQUAL(size_t, LOGGER_BINARY_FILE_HEADER_SIZE + 2 * LOGGER_BINARY_RECORD_HEADER_SIZE, size);
+    ASSERT_ARE_EQUAL(int, (int)LOGGER_RECORD_LOG_STARTED, (int)log[LOGGER_BINARY_FILE_HEADER_SIZE + 4]);
+
+    ///cleanup
+    free(rotatedLog);
+    free(log);
+}
+
+/*Tests_SRS_LOGGER_WRITER_17_020: [ If `writer` is `NULL`, `LoggerWriter_Destroy` shall return. ]*/
+TEST_FUNCTION(LoggerWriter_Destroy_with_NULL_returns)
+{
+    ///act
+    LoggerWriter_Destroy(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_LOGGER_WRITER_17_021: [ `LoggerWriter_Destroy` shall ask the writer thread to stop, wake it up and join it. ]*/
+/*Tests_SRS_LOGGER_WRITER_17_023: [ `LoggerWriter_Destroy` shall free all resources. ]*/
+TEST_FUNCTION(LoggerWriter_Destroy_stops_the_thread_and_frees_everything)
+{
+    ///arrange
+    LOGGER_CONFIG config = make_config(LOGGER_FORMAT_BINARY, 0, 0);
+    LOGGER_WRITER_HANDLE writer = LoggerWriter_Create(&config);
+    ASSERT_IS_NOT_NULL(writer);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Post(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)); /*the writer thread finds nothing to write and stops*/
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    ///act
+    LoggerWriter_Destroy(writer);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+END_TEST_SUITE(logger_writer_ut)
@@ -0,0 +1,225 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/*converts a binary log written by the logger module to the JSON array the logger module writes by default*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/base64.h"
+#include "azure_c_shared_utility/map.h"
+#include "azure_c_shared_utility/constmap.h"
+
+#include "message.h"
+#include "logger_writer.h"
+
+#define FIRST_LOG_BYTE 0xA1
+#define SECOND_LOG_BYTE 0x6C
+
+static uint32_t read_uint32(const unsigned char* source)
+{
+    return
+        ((uint32_t)source[0] << 24) |
+        ((uint32_t)source[1] << 16) |
+        ((uint32_t)source[2] << 8) |
+        (uint32_t)source[3];
+}
+
+static void format_time(int64_t seconds, char* timeString, size_t timeStringSize)
+{
+    time_t when = (time_t)seconds;
+    struct tm* t = localtime(&when);
+    if ((t == NULL) || (strftime(timeString, timeStringSize, LOGGER_TIME_FORMAT, t) == 0))
+    {
+        timeString[0] = '\0';
+    }
+}
+
+/*the message is converted first so that nothing is printed for a record that cannot be converted*/
+static int print_message(FILE* out, const char* separator, const char* timeString, const unsigned char* payload, uint32_t size)
+{
+    int result;
+    MESSAGE_HANDLE message = Message_CreateFromByteArray(payload, (int32_t)size);
+    if (message == NULL)
+    {
+        (void)fprintf(stderr, "unable to deserialize a message\n");
+        result = __LINE__;
+    }
+    else
+    {
+        CONSTMAP_HANDLE originalProperties = Message_GetProperties(message);
+        MAP_HANDLE propertiesAsMap = ConstMap_CloneWriteable(originalProperties);
+        STRING_HANDLE jsonProperties = (propertiesAsMap == NULL) ? NULL : Map_ToJSON(propertiesAsMap);
+        const CONSTBUFFER* content = Message_GetContent(message);
+        STRING_HANDLE jsonContent =
+            (content == NULL) ? NULL :
+            (content->buffer == NULL) ? STRING_construct_n("", 0) :
+            Base64_Encode_Bytes(content->buffer, content->size);
+        if ((jsonProperties == NULL) || (jsonContent == NULL))
+        {
+            (void)fprintf(stderr, "unable to convert a message to JSON\n");
+            result = __LINE__;
+        }
+        else
+        {
+            (void)fprintf(out, "%s{\"time\":\"%s\",\"properties\":%s,\"content\":\"%s\"}", separator, timeString, STRING_c_str(jsonProperties), STRING_c_str(jsonContent));
+            result = 0;
+        }
+        STRING_delete(jsonContent);
+        STRING_delete(jsonProperties);
+        if (propertiesAsMap != NULL)
+        {
+            Map_Destroy(propertiesAsMap);
+        }
+        ConstMap_Destroy(originalProperties);
+        Message_Destroy(message);
+    }
+    return result;
+}
+
+/*returns the number of bytes left to read in the file, or -1 if it cannot tell*/
+static long bytes_left(FILE* in)
+{
+    long result;
+    long position = ftell(in);
+    if ((position < 0) || (fseek(in, 0, SEEK_END) != 0))
+    {
+        result = -1;
+    }
+    else
+    {
+        long end = ftell(in);
+        result = ((end < position) || (fseek(in, position, SEEK_SET) != 0)) ? -1 : end - position;
+    }
+    return result;
+}
+
+static int convert(FILE* in, FILE* out)
+{
+    int result;
+    unsigned char header[LOGGER_BINARY_RECORD_HEADER_SIZE];
+    long left;
+    if (
+        (fread(header, 1, LOGGER_BINARY_FILE_HEADER_SIZE, in) != LOGGER_BINARY_FILE_HEADER_SIZE) ||
+        (header[0] != FIRST_LOG_BYTE) ||
+        (header[1] != SECOND_LOG_BYTE)
+        )
+    {
+        (void)fprintf(stderr, "not a binary log\n");
+        result = __LINE__;
+    }
+    else if ((left = bytes_left(in)) < 0)
+    {
+        (void)fprintf(stderr, "unable to get the size of the log\n");
+        result = __LINE__;
+    }
+    else
+    {
+        bool isFirst = true;
+        bool isTruncated = false;
+        result = 0;
+        (void)fprintf(out, "[");
+        while (fread(header, 1, sizeof(header), in) == sizeof(header))
+        {
+            uint32_t size = read_uint32(header);
+            LOGGER_RECORD_KIND kind = (LOGGER_RECORD_KIND)header[4];
+            int64_t seconds = (int64_t)(((uint64_t)read_uint32(header + 5) << 32) | read_uint32(header + 9));
+            char timeString[64] = { 0 };
+            unsigned char* payload;
+            left -= (long)sizeof(header);
+            if ((size > (uint32_t)INT32_MAX) || ((long)size > left))
+            {
+                /*a log that was not stopped can end in the middle of a record, the size is not trusted before it is checked*/
+                (void)fprintf(stderr, "the last record is truncated\n");
+                isTruncated = true;
+                result = __LINE__;
+                break;
+            }
+
+            payload = (size == 0) ? NULL : (unsigned char*)malloc(size);
+            if ((size != 0) && ((payload == NULL) || (fread(payload, 1, size, in) != size)))
+            {
+                (void)fprintf(stderr, "unable to read a record\n");
+                isTruncated = true;
+                result = __LINE__;
+                free(payload);
+                break;
+            }
+            left -= (long)size;
+
+            format_time(seconds, timeString, sizeof(timeString));
+            if (kind == LOGGER_RECORD_MESSAGE)
+            {
+                if (print_message(out, isFirst ? "" : ",", timeString, payload, size) != 0)
+                {
+                    /*the record is skipped, the array stays valid and the exit code reports the loss*/
+                    (void)fprintf(stderr, "skipping a record that cannot be converted\n");
+                    result = __LINE__;
+                }
+                else
+                {
+                    isFirst = false;
+                }
+            }
+            else
+            {
+                (void)fprintf(out, "%s{\"time\":\"%s\",\"content\":\"%s\"}", isFirst ? "" : ",", timeString, (kind == LOGGER_RECORD_LOG_STARTED) ? "Log started" : "Log stopped");
+                isFirst = false;
+            }
+            free(payload);
+        }
+
+        if (!isTruncated && (left != 0))
+        {
+            /*the log ends in the middle of a record header*/
+            (void)fprintf(stderr, "the last record is truncated\n");
+            result = __LINE__;
+        }
+        (void)fprintf(out, "]\n");
+    }
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    int result;
+    if ((argc != 2) && (argc != 3))
+    {
+        (void)printf("usage: logger_to_json binaryLogFile [jsonFile]\n");
+        (void)printf("where binaryLogFile is a log written by the logger module with \"format\":\"binary\"\n");
+        (void)printf("and jsonFile is the file to write, the JSON is printed if there is none\n");
+        result = 1;
+    }
+    else
+    {
+        FILE* in = fopen(argv[1], "rb");
+        if (in == NULL)
+        {
+            (void)fprintf(stderr, "unable to open %s\n", argv[1]);
+            result = 1;
+        }
+        else
+        {
+            FILE* out = (argc == 3) ? fopen(argv[2], "wb") : stdout;
+            if (out == NULL)
+            {
+                (void)fprintf(stderr, "unable to open %s\n", argv[2]);
+                result = 1;
+            }
+            else
+            {
+                result = (convert(in, out) == 0) ? 0 : 1;
+                if (out != stdout)
+                {
+                    (void)fclose(out);
+                }
+            }
+            (void)fclose(in);
+        }
+    }
+    return result;
+}
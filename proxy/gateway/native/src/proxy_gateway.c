@@ -5,6 +5,7 @@
 #include "broker.h"
 
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -19,6 +20,19 @@
 #include "control_message.h"
 #include "gateway.h"
 #include "message.h"
+#include "message_batch.h"
+#include "message_ring.h"
+
+/* how long Broker_Publish waits for room in a full message ring */
+#define MESSAGE_RING_PUBLISH_WAIT 1000
+
+/* how long the worker thread blocks on its sockets before checking for a halt signal it may have missed */
+#define WORKER_THREAD_POLL_TIMEOUT 1000
+
+/* how long the worker thread blocks on an empty message ring before checking the control channel again */
+#define WORKER_THREAD_RING_WAIT 100
+
+#define WAKE_CHANNEL_URI_PREFIX "inproc://proxy_gateway_wake_"
 
 typedef enum REMOTE_MODULE_RESULT_TAG {
     REMOTE_MODULE_DETACH = -1,
@@ -29,6 +43,16 @@ typedef enum REMOTE_MODULE_RESULT_TAG {
 
 typedef struct MESSAGE_THREAD_TAG * MESSAGE_THREAD_HANDLE;
 
+void
+close_wake_channel (
+    MESSAGE_THREAD_HANDLE message_thread
+);
+
+int
+create_wake_channel (
+    MESSAGE_THREAD_HANDLE message_thread
+);
+
 int
 connect_to_message_channel (
     REMOTE_MODULE_HANDLE remote_module,
@@ -40,6 +64,13 @@ disconnect_from_message_channel (
     REMOTE_MODULE_HANDLE remote_module
 );
 
+void
+deliver_message_batch (
+    REMOTE_MODULE_HANDLE remote_module,
+    const unsigned char * batch,
+    int32_t batch_size
+);
+
 int
 invoke_add_module_procedure (
     REMOTE_MODULE_HANDLE remote_module,
@@ -58,6 +89,11 @@ send_control_reply (
     uint8_t response
 );
 
+void
+wait_for_messages (
+    REMOTE_MODULE_HANDLE remote_module
+);
+
 int
 worker_thread(
     void * thread_arg
@@ -67,6 +103,8 @@ typedef struct MESSAGE_THREAD_TAG {
     bool halt;
     LOCK_HANDLE mutex;
     THREAD_HANDLE thread;
+    int wake_receiver;
+    int wake_sender;
 } MESSAGE_THREAD;
 
 typedef struct REMOTE_MODULE_TAG {
@@ -74,6 +112,8 @@ typedef struct REMOTE_MODULE_TAG {
 	int control_socket;
     int message_endpoint;
     int message_socket;
+    MESSAGE_RING_HANDLE incoming_ring;
+    MESSAGE_RING_HANDLE outgoing_ring;
     MESSAGE_THREAD_HANDLE message_thread;
     MODULE module;
 } REMOTE_MODULE;
@@ -278,8 +318,29 @@ ProxyGateway_DoWork (
             (void)nn_freemsg(control_message);
         }
 
+        if (NULL != remote_module->incoming_ring) {
+            const unsigned char * ring_message = NULL;
+
+            /* Codes_SRS_PROXY_GATEWAY_027_067: [Message Ring - If the message channel is a pair of message rings, `ProxyGateway_DoWork` shall poll the incoming ring by calling `int32_t MessageRing_BeginRead(MESSAGE_RING_HANDLE ring, const unsigned char ** buffer, unsigned int timeout_ms)` with `0` for `timeout_ms`] */
+            if (0 > (bytes_received = MessageRing_BeginRead(remote_module->incoming_ring, &ring_message, 0))) {
+                LogError("%s: Unexpected error received from the message ring!", __FUNCTION__);
+            } else if (0 == bytes_received) {
+                // no messages available at this time
+            } else {
+                MESSAGE_HANDLE structured_module_message;
+
+                /* Codes_SRS_PROXY_GATEWAY_027_068: [Message Ring - If a module message was received, then `ProxyGateway_DoWork` will parse that message in place by calling `MESSAGE_HANDLE Message_CreateFromByteArray(const unsigned char * source, int32_t size)`, pass the structured message to the module and destroy it] */
+                if (NULL == (structured_module_message = Message_CreateFromByteArray(ring_message, bytes_received))) {
+                    LogError("%s: Unable to parse module message!", __FUNCTION__);
+                } else {
+                    ((MODULE_API_1 *)remote_module->module.module_apis)->Module_Receive(remote_module->module.module_handle, structured_module_message);
+                    Message_Destroy(structured_module_message);
+                }
+                /* Codes_SRS_PROXY_GATEWAY_027_069: [Message Ring - `ProxyGateway_DoWork` shall release the module message from the ring by calling `void MessageRing_EndRead(MESSAGE_RING_HANDLE ring)`] */
+                MessageRing_EndRead(remote_module->incoming_ring);
+            }
         /* Codes_SRS_PROXY_GATEWAY_027_037: [Message Channel - `ProxyGateway_DoWork` shall not check for messages, if the message socket is not available] */
-        if ( 0 > remote_module->message_socket ) {
+        } else if ( 0 > remote_module->message_socket ) {
             // not connected to message channel
         } else {
             void * module_message = NULL;
@@ -292,6 +353,11 @@ ProxyGateway_DoWork (
                 } else {
                     LogError("%s: Unexpected error received from the message channel!", __FUNCTION__);
                 }
+            } else if (MessageBatch_IsBatch((const unsigned char *)module_message, bytes_received)) {
+                /* Codes_SRS_PROXY_GATEWAY_027_070: [Message Channel - If the module message is a message batch, then `ProxyGateway_DoWork` shall parse each message in the batch in place, in order, pass it to the module and destroy it] */
+                deliver_message_batch(remote_module, (const unsigned char *)module_message, bytes_received);
+                /* Codes_SRS_PROXY_GATEWAY_027_044: [Message Channel - `ProxyGateway_DoWork` shall free the resources held by the gateway message by calling `int nn_freemsg(void * msg)` with the resulting buffer from the previous call to `nn_recv`] */
+                (void)nn_freemsg(module_message);
             } else {
                 MESSAGE_HANDLE structured_module_message;
 
@@ -339,6 +405,8 @@ ProxyGateway_HaltWorkerThread (
         int thread_exit_result = -1;
         // Signal the message thread
         remote_module->message_thread->halt = true;
+        /* Codes_SRS_PROXY_GATEWAY_027_073: [`ProxyGateway_HaltWorkerThread` shall wake the worker thread by calling `int nn_send(int s, const void * buf, size_t len, int flags)` on the wake channel with `NN_DONTWAIT` for `flags`, and ignore any error] */
+        (void)nn_send(remote_module->message_thread->wake_sender, "", 1, NN_DONTWAIT);
         
         /* Codes_SRS_PROXY_GATEWAY_027_049: [`ProxyGateway_HaltWorkerThread` shall release the thread mutex upon signalling by calling `LOCK_RESULT Unlock(LOCK_HANDLE handle)`] */
         if (LOCK_OK != Unlock(remote_module->message_thread->mutex)) {
@@ -351,6 +419,8 @@ ProxyGateway_HaltWorkerThread (
             LogError("%s: Unable to halt message thread!", __FUNCTION__);
             result = __LINE__;
         } else {
+            /* Codes_SRS_PROXY_GATEWAY_027_074: [`ProxyGateway_HaltWorkerThread` shall close both sockets of the wake channel by calling `int nn_close(int s)`] */
+            close_wake_channel(remote_module->message_thread);
             /* Codes_SRS_PROXY_GATEWAY_027_053: [`ProxyGateway_HaltWorkerThread` shall free the thread mutex by calling `LOCK_RESULT Lock_Deinit(LOCK_HANDLE handle)`] */
             /* Codes_SRS_PROXY_GATEWAY_027_054: [If unable to free the thread mutex, then `ProxyGateway_HaltWorkerThread` shall ignore the result and continue processing] */
             (void)Lock_Deinit(remote_module->message_thread->mutex);
@@ -398,11 +468,20 @@ ProxyGateway_StartWorkerThread (
         result = __LINE__;
         free(remote_module->message_thread);
         remote_module->message_thread = (MESSAGE_THREAD_HANDLE)NULL;
+    /* Codes_SRS_PROXY_GATEWAY_027_071: [`ProxyGateway_StartWorkerThread` shall create a wake channel, a pair of `inproc` sockets used to interrupt the worker thread while it waits for messages] */
+    } else if (0 != create_wake_channel(remote_module->message_thread)) {
+        /* Codes_SRS_PROXY_GATEWAY_027_072: [If the wake channel cannot be created, then `ProxyGateway_StartWorkerThread` shall free any previously allocated memory and return a non-zero value] */
+        LogError("%s: Unable to create the worker thread wake channel!", __FUNCTION__);
+        result = __LINE__;
+        (void)Lock_Deinit(remote_module->message_thread->mutex);
+        free(remote_module->message_thread);
+        remote_module->message_thread = (MESSAGE_THREAD_HANDLE)NULL;
     /* Codes_SRS_PROXY_GATEWAY_027_023: [`ProxyGateway_StartWorkerThread` shall start a worker thread by calling `THREADAPI_RESULT ThreadAPI_Create(&THREAD_HANDLE threadHandle, THREAD_START_FUNC func, void * arg)` with an empty thread handle for `threadHandle`, a function that loops polling the messages for `func`, and `remote_module` for `arg`] */
     } else if (THREADAPI_OK != ThreadAPI_Create(&remote_module->message_thread->thread, worker_thread, remote_module)) {
         /* Codes_SRS_PROXY_GATEWAY_027_024: [If the worker thread failed to start, then `ProxyGateway_StartWorkerThread` shall free any previously allocated memory and return a non-zero value] */
         LogError("%s: Unable to create worker thread!", __FUNCTION__);
         result = __LINE__;
+        close_wake_channel(remote_module->message_thread);
         (void)Lock_Deinit(remote_module->message_thread->mutex);
         free(remote_module->message_thread);
         remote_module->message_thread = (MESSAGE_THREAD_HANDLE)NULL;
@@ -415,9 +494,10 @@ ProxyGateway_StartWorkerThread (
 }
 
 
-/* Codes_SRS_BROKER_17_022: [ N/A - Broker_Publish shall Lock the modules lock. ] */
-/* Codes_SRS_BROKER_17_023: [ N/A - Broker_Publish shall Unlock the modules lock. ] */
+/* Codes_SRS_BROKER_17_022: [ N/A - Broker_Publish shall acquire the current routing table without taking the modules lock. ] */
+/* Codes_SRS_BROKER_17_023: [ N/A - Broker_Publish shall release the routing table. ] */
 /* Codes_SRS_BROKER_17_026: [ N/A - Broker_Publish shall copy source into the beginning of the nanomsg buffer. ] */
+/* Messages are published one per frame; only the gateway to module direction is batched. */
 BROKER_RESULT
 Broker_Publish (
     BROKER_HANDLE broker,
@@ -450,6 +530,24 @@ Broker_Publish (
             Message_Destroy(msg);
             result = BROKER_ERROR;
         }
+        else if (NULL != remote_module->outgoing_ring)
+        {
+            /* serialize straight into the shared ring, the gateway parses it from there */
+            unsigned char * ring_bytes = MessageRing_BeginWrite(remote_module->outgoing_ring, msg_size, MESSAGE_RING_PUBLISH_WAIT);
+            if (ring_bytes == NULL)
+            {
+                /* Codes_SRS_BROKER_13_037: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ] */
+                LogError("unable to write a message to the message ring [%p]", msg);
+                result = BROKER_ERROR;
+            }
+            else
+            {
+                (void)Message_ToByteArray(message, ring_bytes, msg_size);
+                MessageRing_EndWrite(remote_module->outgoing_ring);
+                result = BROKER_OK;
+            }
+            Message_Destroy(msg);
+        }
         else
         {
             /* Codes_SRS_BROKER_17_025: [ Broker_Publish shall allocate a nanomsg buffer the size of the serialized message + sizeof(MODULE_HANDLE). ] */
@@ -494,6 +592,61 @@ Broker_Publish (
 }
 
 
+static MESSAGE_RING_HANDLE
+open_message_ring (
+    const char * ring_id,
+    const char * direction
+) {
+    MESSAGE_RING_HANDLE ring;
+    const size_t ring_id_size = strlen(ring_id);
+    const size_t direction_size = strlen(direction);
+    char * ring_name;
+
+    if (NULL == (ring_name = (char *)malloc(ring_id_size + direction_size + 1))) {
+        LogError("%s: Unable to allocate memory!", __FUNCTION__);
+        ring = NULL;
+    } else {
+        (void)memcpy(ring_name, ring_id, ring_id_size);
+        (void)memcpy(ring_name + ring_id_size, direction, direction_size + 1);
+        if (NULL == (ring = MessageRing_Open(ring_name))) {
+            LogError("%s: Unable to open message ring %s!", __FUNCTION__, ring_name);
+        }
+        free(ring_name);
+    }
+
+    return ring;
+}
+
+
+void
+deliver_message_batch (
+    REMOTE_MODULE_HANDLE remote_module,
+    const unsigned char * batch,
+    int32_t batch_size
+) {
+    int32_t position = 0;
+    int32_t message_size;
+    const unsigned char * message;
+
+    /* SRS_PROXY_GATEWAY_027_0xx: [`deliver_message_batch` shall walk the batch by calling `int32_t MessageBatch_GetNext(const unsigned char * source, int32_t size, int32_t * position, const unsigned char ** message)` until it returns 0] */
+    while (0 < (message_size = MessageBatch_GetNext(batch, batch_size, &position, &message))) {
+        MESSAGE_HANDLE structured_module_message;
+
+        if (NULL == (structured_module_message = Message_CreateFromByteArray(message, message_size))) {
+            /* SRS_PROXY_GATEWAY_027_0xx: [If unable to parse a message, then `deliver_message_batch` shall skip it and continue with the next message in the batch] */
+            LogError("%s: Unable to parse module message in batch!", __FUNCTION__);
+        } else {
+            ((MODULE_API_1 *)remote_module->module.module_apis)->Module_Receive(remote_module->module.module_handle, structured_module_message);
+            Message_Destroy(structured_module_message);
+        }
+    }
+
+    if (0 > message_size) {
+        /* SRS_PROXY_GATEWAY_027_0xx: [If the batch is malformed, then `deliver_message_batch` shall abandon the rest of the batch] */
+        LogError("%s: Malformed message batch!", __FUNCTION__);
+    }
+}
+
 int
 connect_to_message_channel (
     REMOTE_MODULE_HANDLE remote_module,
@@ -501,8 +654,21 @@ connect_to_message_channel (
 ) {
     int result;
 
+    if (0 == strncmp(channel_uri->uri, MESSAGE_RING_URI_HEAD, MESSAGE_RING_URI_HEAD_SIZE)) {
+        const char * ring_id = channel_uri->uri + MESSAGE_RING_URI_HEAD_SIZE;
+
+        /* SRS_PROXY_GATEWAY_027_0xx: [If `MESSAGE_URI::uri` starts with "shm://", `connect_to_message_channel` shall open the message rings created by the gateway, reading from the one named with the "_to_module" suffix and writing to the one named with the "_to_gateway" suffix] */
+        if (NULL == (remote_module->incoming_ring = open_message_ring(ring_id, MESSAGE_RING_TO_MODULE_SUFFIX))) {
+            result = __LINE__;
+        } else if (NULL == (remote_module->outgoing_ring = open_message_ring(ring_id, MESSAGE_RING_TO_GATEWAY_SUFFIX))) {
+            result = __LINE__;
+            MessageRing_Destroy(remote_module->incoming_ring);
+            remote_module->incoming_ring = NULL;
+        } else {
+            result = 0;
+        }
     /* SRS_PROXY_GATEWAY_027_0xx: [`connect_to_message_channel` shall create a socket for the Azure IoT Gateway message channel by calling `int nn_socket(int domain, int protocol)` with `AF_SP` as `domain` and `MESSAGE_URI::uri_type` as `protocol`] */
-    if (-1 == (remote_module->message_socket = nn_socket(AF_SP, channel_uri->uri_type))) {
+    } else if (-1 == (remote_module->message_socket = nn_socket(AF_SP, channel_uri->uri_type))) {
         /* SRS_PROXY_GATEWAY_027_0xx: [If a call to `nn_socket` returns -1, then `connect_to_message_channel` shall free any previously allocated memory, abandon the control message and prepare for the next create message] */
         LogError("%s: Unable to create the gateway socket!", __FUNCTION__);
         result = __LINE__;
@@ -526,12 +692,24 @@ void
 disconnect_from_message_channel (
     REMOTE_MODULE_HANDLE remote_module
 ) {
-    /* SRS_PROXY_GATEWAY_027_0xx: [`disconnect_from_message_channel` shall shutdown the Azure IoT Gateway message channel by calling `int nn_shutdown(int s, int how)`] */
-    (void)nn_shutdown(remote_module->message_socket, remote_module->message_endpoint);
-    remote_module->message_endpoint = -1;
-    /* SRS_PROXY_GATEWAY_027_0xx: [`disconnect_from_message_channel` shall close the Azure IoT Gateway message socket by calling `int nn_close(int s)`] */
-    (void)nn_close(remote_module->message_socket);
-    remote_module->message_socket = -1;
+    if (NULL != remote_module->incoming_ring || NULL != remote_module->outgoing_ring) {
+        /* SRS_PROXY_GATEWAY_027_0xx: [If connected through message rings, `disconnect_from_message_channel` shall unmap them by calling `void MessageRing_Destroy(MESSAGE_RING_HANDLE ring)`] */
+        if (NULL != remote_module->incoming_ring) {
+            MessageRing_Destroy(remote_module->incoming_ring);
+            remote_module->incoming_ring = NULL;
+        }
+        if (NULL != remote_module->outgoing_ring) {
+            MessageRing_Destroy(remote_module->outgoing_ring);
+            remote_module->outgoing_ring = NULL;
+        }
+    } else {
+        /* SRS_PROXY_GATEWAY_027_0xx: [`disconnect_from_message_channel` shall shutdown the Azure IoT Gateway message channel by calling `int nn_shutdown(int s, int how)`] */
+        (void)nn_shutdown(remote_module->message_socket, remote_module->message_endpoint);
+        remote_module->message_endpoint = -1;
+        /* SRS_PROXY_GATEWAY_027_0xx: [`disconnect_from_message_channel` shall close the Azure IoT Gateway message socket by calling `int nn_close(int s)`] */
+        (void)nn_close(remote_module->message_socket);
+        remote_module->message_socket = -1;
+    }
 
     return;
 }
@@ -669,12 +847,103 @@ send_control_reply (
 }
 
 
+void
+close_wake_channel (
+    MESSAGE_THREAD_HANDLE message_thread
+) {
+    /* SRS_PROXY_GATEWAY_027_0xx: [`close_wake_channel` shall close both wake channel sockets by calling `int nn_close(int s)`] */
+    (void)nn_close(message_thread->wake_sender);
+    message_thread->wake_sender = -1;
+    (void)nn_close(message_thread->wake_receiver);
+    message_thread->wake_receiver = -1;
+}
+
+
+int
+create_wake_channel (
+    MESSAGE_THREAD_HANDLE message_thread
+) {
+    int result;
+    char wake_channel_uri[sizeof(WAKE_CHANNEL_URI_PREFIX) + 32];
+
+    // The thread data address keeps the uri unique within the process
+    (void)sprintf(wake_channel_uri, WAKE_CHANNEL_URI_PREFIX "%p", (void *)message_thread);
+
+    /* SRS_PROXY_GATEWAY_027_0xx: [`create_wake_channel` shall create the receiving socket by calling `int nn_socket(int domain, int protocol)` with `AF_SP` as `domain` and `NN_PAIR` as `protocol`] */
+    if (-1 == (message_thread->wake_receiver = nn_socket(AF_SP, NN_PAIR))) {
+        /* SRS_PROXY_GATEWAY_027_0xx: [If a call to `nn_socket` returns -1, then `create_wake_channel` shall close any socket it created and return a non-zero value] */
+        LogError("%s: Unable to create the wake receiver socket!", __FUNCTION__);
+        result = __LINE__;
+    /* SRS_PROXY_GATEWAY_027_0xx: [`create_wake_channel` shall create the sending socket by calling `int nn_socket(int domain, int protocol)` with `AF_SP` as `domain` and `NN_PAIR` as `protocol`] */
+    } else if (-1 == (message_thread->wake_sender = nn_socket(AF_SP, NN_PAIR))) {
+        LogError("%s: Unable to create the wake sender socket!", __FUNCTION__);
+        result = __LINE__;
+        (void)nn_close(message_thread->wake_receiver);
+        message_thread->wake_receiver = -1;
+    /* SRS_PROXY_GATEWAY_027_0xx: [`create_wake_channel` shall bind the receiving socket to an `inproc` address unique to the thread by calling `int nn_bind(int s, const char * addr)`] */
+    /* SRS_PROXY_GATEWAY_027_0xx: [`create_wake_channel` shall connect the sending socket to the same address by calling `int nn_connect(int s, const char * addr)`] */
+    } else if (0 > nn_bind(message_thread->wake_receiver, wake_channel_uri)
+            || 0 > nn_connect(message_thread->wake_sender, wake_channel_uri)) {
+        /* SRS_PROXY_GATEWAY_027_0xx: [If a call to `nn_bind` or `nn_connect` returns a negative value, then `create_wake_channel` shall close both sockets and return a non-zero value] */
+        LogError("%s: Unable to connect the wake channel!", __FUNCTION__);
+        result = __LINE__;
+        close_wake_channel(message_thread);
+    } else {
+        /* SRS_PROXY_GATEWAY_027_0xx: [If no errors are encountered, then `create_wake_channel` shall return zero] */
+        result = 0;
+    }
+
+    return result;
+}
+
+
+void
+wait_for_messages (
+    REMOTE_MODULE_HANDLE remote_module
+) {
+    struct nn_pollfd sockets[3];
+    int socket_count = 0;
+    int poll_result;
+
+    sockets[socket_count].fd = remote_module->message_thread->wake_receiver;
+    sockets[socket_count].events = NN_POLLIN;
+    ++socket_count;
+    sockets[socket_count].fd = remote_module->control_socket;
+    sockets[socket_count].events = NN_POLLIN;
+    ++socket_count;
+    if (-1 != remote_module->message_socket) {
+        sockets[socket_count].fd = remote_module->message_socket;
+        sockets[socket_count].events = NN_POLLIN;
+        ++socket_count;
+    }
+
+    if (NULL == remote_module->incoming_ring) {
+        /* SRS_PROXY_GATEWAY_027_0xx: [`wait_for_messages` shall block until the wake channel, the control socket or the message socket is readable by calling `int nn_poll(struct nn_pollfd * fds, int nfds, int timeout)` with `WORKER_THREAD_POLL_TIMEOUT` for `timeout`] */
+        poll_result = nn_poll(sockets, socket_count, WORKER_THREAD_POLL_TIMEOUT);
+    } else if (0 == (poll_result = nn_poll(sockets, socket_count, 0))) {
+        const unsigned char * buffer;
+        int32_t ring_result;
+
+        /* SRS_PROXY_GATEWAY_027_0xx: [If the message channel is a pair of message rings and no socket is readable, `wait_for_messages` shall wait for the incoming ring by calling `int32_t MessageRing_BeginRead(MESSAGE_RING_HANDLE ring, const unsigned char ** buffer, unsigned int timeout_ms)` with `WORKER_THREAD_RING_WAIT` for `timeout_ms`, leaving the message in the ring] */
+        if (0 > (ring_result = MessageRing_BeginRead(remote_module->incoming_ring, &buffer, WORKER_THREAD_RING_WAIT))) {
+            /* SRS_PROXY_GATEWAY_027_0xx: [If the wait fails, `wait_for_messages` shall return without waiting] */
+            LogError("%s: Unable to wait for the message ring <%d>!", __FUNCTION__, (int)ring_result);
+        }
+    }
+
+    if (0 > poll_result) {
+        /* SRS_PROXY_GATEWAY_027_0xx: [If the wait fails, `wait_for_messages` shall return without waiting] */
+        LogError("%s: Unable to wait for messages <%d>!", __FUNCTION__, nn_errno());
+    }
+}
+
+
 /* SRS_PROXY_GATEWAY_027_0xx: [`worker_thread` shall obtain the thread mutex in order to initialize the thread by calling `LOCK_RESULT Lock(LOCK_HANDLE handle)`] */
 /* SRS_PROXY_GATEWAY_027_0xx: [If unable to obtain the mutex, then `worker_thread` shall return a non-zero value] */
 /* SRS_PROXY_GATEWAY_027_0xx: [`worker_thread` shall release the thread mutex upon entering the loop by calling `LOCK_RESULT Unlock(LOCK_HANDLE handle)`] */
 /* SRS_PROXY_GATEWAY_027_0xx: [If unable to release the mutex, then `worker_thread` shall exit the thread and return a non-zero value] */
+/* SRS_PROXY_GATEWAY_027_0xx: [`worker_thread` shall block until a message arrives or the thread is woken by calling `void wait_for_messages(REMOTE_MODULE_HANDLE remote_module)`] */
 /* SRS_PROXY_GATEWAY_027_0xx: [`worker_thread` shall invoke asynchronous processing by calling `void ProxyGateway_DoWork(REMOTE_MODULE_HANDLE remote_module)`] */
-/* SRS_PROXY_GATEWAY_027_0xx: [`worker_thread` shall yield its remaining quantum by calling `void THREADAPI_Sleep(unsigned int milliseconds)`] */
 /* SRS_PROXY_GATEWAY_027_0xx: [`worker_thread` shall obtain the thread mutex in order to check for a halt signal by calling `LOCK_RESULT Lock(LOCK_HANDLE handle)`] */
 /* SRS_PROXY_GATEWAY_027_0xx: [If unable to obtain the mutex, then `worker_thread` shall exit the thread return a non-zero value] */
 /* SRS_PROXY_GATEWAY_027_0xx: [If unable to obtain the mutex, then `worker_thread` shall exit the thread return a non-zero value] */
@@ -703,8 +972,9 @@ worker_thread (
                 break;
             }
             else {
+                // Readiness persists until every pending message is received, so the loop drains them one at a time
+                wait_for_messages(remote_module);
                 ProxyGateway_DoWork(remote_module);
-                ThreadAPI_Sleep(0);  // Release the CPU
                 if (LOCK_ERROR == Lock(remote_module->message_thread->mutex)) {
                     LogError("%s: Failed to obtain mutex!", __FUNCTION__);
                     result = __LINE__;
@@ -72,6 +72,8 @@ non_mocked_free(
   #include "azure_c_shared_utility/threadapi.h"
   #include "control_message.h"
   #include "message.h"
+  #include "message_batch.h"
+  #include "message_ring.h"
   #include "module.h"
 #undef ENABLE_MOCKS
 
@@ -84,6 +86,10 @@ non_mocked_free(
 #define MOCK_LOCK (LOCK_HANDLE)0x17091979
 #define MOCK_MODULE (MODULE_HANDLE)0x09171979
 #define MOCK_REMOTE_MODULE (REMOTE_MODULE_HANDLE)0x19790917
+#define MOCK_INCOMING_RING (MESSAGE_RING_HANDLE)0x17091980
+#define MOCK_OUTGOING_RING (MESSAGE_RING_HANDLE)0x17091981
+#define MOCK_WAKE_RECEIVER 1709
+#define MOCK_WAKE_SENDER 1710
 
 #ifdef __cplusplus
 extern "C"
@@ -395,12 +401,18 @@ MOCK_FUNCTION_END(0)
 MOCK_FUNCTION_WITH_CODE(, int, nn_close, int, s)
 MOCK_FUNCTION_END(0)
 
+MOCK_FUNCTION_WITH_CODE(, int, nn_connect, int, s, const char *, addr)
+MOCK_FUNCTION_END(0)
+
 MOCK_FUNCTION_WITH_CODE(, int, nn_errno)
 MOCK_FUNCTION_END(0)
 
 MOCK_FUNCTION_WITH_CODE(, int, nn_freemsg, void *, msg)
 MOCK_FUNCTION_END(0)
 
+MOCK_FUNCTION_WITH_CODE(, int, nn_poll, struct nn_pollfd *, fds, int, nfds, int, timeout)
+MOCK_FUNCTION_END(0)
+
 MOCK_FUNCTION_WITH_CODE(, int, nn_recv, int, s, void *, buf, size_t, len, int, flags)
 MOCK_FUNCTION_END(0)
 
@@ -462,6 +474,76 @@ expected_calls_connect_to_message_channel (
         .SetReturn(COMMAND_ENDPOINT);
 }
 
+static
+void
+expected_calls_connect_to_message_rings (
+    void
+) {
+    enableNegativeTest(negative_test_index++);
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    enableNegativeTest(negative_test_index++);
+    STRICT_EXPECTED_CALL(MessageRing_Open("proxy_gateway_ut_to_module"))
+        .SetFailReturn(NULL)
+        .SetReturn(MOCK_INCOMING_RING);
+    disableNegativeTest(negative_test_index++);
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    enableNegativeTest(negative_test_index++);
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    enableNegativeTest(negative_test_index++);
+    STRICT_EXPECTED_CALL(MessageRing_Open("proxy_gateway_ut_to_gateway"))
+        .SetFailReturn(NULL)
+        .SetReturn(MOCK_OUTGOING_RING);
+    disableNegativeTest(negative_test_index++);
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+}
+
+static
+void
+expected_calls_create_wake_channel (
+    void
+) {
+    enableNegativeTest(negative_test_index++);
+    STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR))
+        .SetFailReturn(-1)
+        .SetReturn(MOCK_WAKE_RECEIVER);
+    enableNegativeTest(negative_test_index++);
+    STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR))
+        .SetFailReturn(-1)
+        .SetReturn(MOCK_WAKE_SENDER);
+    enableNegativeTest(negative_test_index++);
+    STRICT_EXPECTED_CALL(nn_bind(MOCK_WAKE_RECEIVER, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .SetFailReturn(-1)
+        .SetReturn(1);
+    enableNegativeTest(negative_test_index++);
+    STRICT_EXPECTED_CALL(nn_connect(MOCK_WAKE_SENDER, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .SetFailReturn(-1)
+        .SetReturn(1);
+}
+
+static
+void
+expected_calls_wake_worker_thread (
+    void
+) {
+    disableNegativeTest(negative_test_index++);
+    STRICT_EXPECTED_CALL(nn_send(MOCK_WAKE_SENDER, IGNORED_PTR_ARG, 1, NN_DONTWAIT))
+        .IgnoreArgument(2)
+        .SetReturn(1);
+}
+
+static
+void
+expected_calls_close_wake_channel (
+    void
+) {
+    disableNegativeTest(negative_test_index++);
+    STRICT_EXPECTED_CALL(nn_close(MOCK_WAKE_SENDER));
+    disableNegativeTest(negative_test_index++);
+    STRICT_EXPECTED_CALL(nn_close(MOCK_WAKE_RECEIVER));
+}
+
 static
 void
 expected_calls_disconnect_from_message_channel (
@@ -566,6 +648,7 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void *);
     REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
     REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_HANDLE, void *);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_RING_HANDLE, void *);
     REGISTER_UMOCK_ALIAS_TYPE(MODULE_HANDLE, void *);
     REGISTER_UMOCK_ALIAS_TYPE(REMOTE_MODULE_HANDLE, void *);
     REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void *);
@@ -919,6 +1002,7 @@ TEST_FUNCTION(startWorkerThread_SCENARIO_threadAlreadyStarted)
     EXPECTED_CALL(gballoc_calloc(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     EXPECTED_CALL(Lock_Init())
         .SetReturn(MOCK_LOCK);
+    expected_calls_create_wake_channel();
     EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .SetReturn(THREADAPI_OK);
 
@@ -939,6 +1023,7 @@ TEST_FUNCTION(startWorkerThread_SCENARIO_threadAlreadyStarted)
 
 /* Tests_SRS_PROXY_GATEWAY_027_019: [`ProxyGateway_StartWorkerThread` shall allocate the memory required to support the worker thread] */
 /* Tests_SRS_PROXY_GATEWAY_027_021: [`ProxyGateway_StartWorkerThread` shall create a mutex by calling `LOCK_HANDLE Lock_Init(void)`] */
+/* Tests_SRS_PROXY_GATEWAY_027_071: [`ProxyGateway_StartWorkerThread` shall create a wake channel, a pair of `inproc` sockets used to interrupt the worker thread while it waits for messages] */
 /* Tests_SRS_PROXY_GATEWAY_027_023: [`ProxyGateway_StartWorkerThread` shall start a worker thread by calling `THREADAPI_RESULT ThreadAPI_Create(&THREAD_HANDLE threadHandle, THREAD_START_FUNC func, void * arg)` with an empty thread handle for `threadHandle`, a function that loops polling the messages for `func`, and `remote_module` for `arg`] */
 /* Tests_SRS_PROXY_GATEWAY_027_025: [If no errors are encountered, then `ProxyGateway_StartWorkerThread` shall return zero] */
 TEST_FUNCTION(startWorkerThread_SCENARIO_success)
@@ -953,6 +1038,7 @@ TEST_FUNCTION(startWorkerThread_SCENARIO_success)
     EXPECTED_CALL(gballoc_calloc(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     EXPECTED_CALL(Lock_Init())
         .SetReturn(MOCK_LOCK);
+    expected_calls_create_wake_channel();
     EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .SetReturn(THREADAPI_OK);
 
@@ -970,6 +1056,7 @@ TEST_FUNCTION(startWorkerThread_SCENARIO_success)
 
 /* Tests_SRS_PROXY_GATEWAY_027_020: [If memory allocation fails for the worker thread data, then `ProxyGateway_StartWorkerThread` shall return a non-zero value] */
 /* Tests_SRS_PROXY_GATEWAY_027_022: [If a mutex is unable to be created, then `ProxyGateway_StartWorkerThread` shall free any previously allocated memory and return a non-zero value] */
+/* Tests_SRS_PROXY_GATEWAY_027_072: [If the wake channel cannot be created, then `ProxyGateway_StartWorkerThread` shall free any previously allocated memory and return a non-zero value] */
 /* Tests_SRS_PROXY_GATEWAY_027_024: [If the worker thread failed to start, then `ProxyGateway_StartWorkerThread` shall free any previously allocated memory and return a non-zero value] */
 TEST_FUNCTION(startWorkerThread_SCENARIO_negative_tests)
 {
@@ -990,6 +1077,7 @@ TEST_FUNCTION(startWorkerThread_SCENARIO_negative_tests)
     EXPECTED_CALL(Lock_Init())
         .SetFailReturn(NULL)
         .SetReturn(MOCK_LOCK);
+    expected_calls_create_wake_channel();
     enableNegativeTest(negative_test_index++);
     EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .SetFailReturn(THREADAPI_ERROR)
@@ -1099,6 +1187,7 @@ TEST_FUNCTION(doWork_SCENARIO_create_message_success)
         .IgnoreArgument(1)
         .IgnoreArgument(2)
         .SetReturn(NN_MESSAGE_SIZE);
+    STRICT_EXPECTED_CALL(MessageBatch_IsBatch((const unsigned char *)NN_MESSAGE_BUFFER, NN_MESSAGE_SIZE));
     STRICT_EXPECTED_CALL(Message_CreateFromByteArray((const unsigned char *)NN_MESSAGE_BUFFER, IGNORED_NUM_ARG))
         .IgnoreArgument(2)
         .SetReturn((MESSAGE_HANDLE)&CREATE_MESSAGE);
@@ -1188,6 +1277,7 @@ TEST_FUNCTION(doWork_SCENARIO_start_message_success)
         .IgnoreArgument(1)
         .IgnoreArgument(2)
         .SetReturn(NN_MESSAGE_SIZE);
+    STRICT_EXPECTED_CALL(MessageBatch_IsBatch((const unsigned char *)NN_MESSAGE_BUFFER, NN_MESSAGE_SIZE));
     STRICT_EXPECTED_CALL(Message_CreateFromByteArray((const unsigned char *)NN_MESSAGE_BUFFER, IGNORED_NUM_ARG))
         .IgnoreArgument(2)
         .SetReturn((MESSAGE_HANDLE)&START_MESSAGE);
@@ -1465,6 +1555,7 @@ TEST_FUNCTION(doWork_SCENARIO_gateway_message_bad_parse)
         .IgnoreArgument(1)
         .IgnoreArgument(2)
         .SetReturn(NN_MESSAGE_SIZE);
+    STRICT_EXPECTED_CALL(MessageBatch_IsBatch((const unsigned char *)NN_MESSAGE_BUFFER, NN_MESSAGE_SIZE));
     STRICT_EXPECTED_CALL(Message_CreateFromByteArray((const unsigned char *)NN_MESSAGE_BUFFER, IGNORED_NUM_ARG))
         .IgnoreArgument(2)
         .SetReturn(NULL);
@@ -1480,6 +1571,179 @@ TEST_FUNCTION(doWork_SCENARIO_gateway_message_bad_parse)
     ProxyGateway_Detach(remote_module);
 }
 
+/* Tests_SRS_PROXY_GATEWAY_027_070: [Message Channel - If the module message is a message batch, then `ProxyGateway_DoWork` shall parse each message in the batch in place, in order, pass it to the module and destroy it] */
+TEST_FUNCTION(doWork_SCENARIO_gateway_message_batch_success)
+{
+    // Arrange
+    CONTROL_MESSAGE_MODULE_CREATE CREATE_MESSAGE = {
+        {
+            CONTROL_MESSAGE_VERSION_CURRENT,
+            CONTROL_MESSAGE_TYPE_MODULE_CREATE
+        },
+        GATEWAY_MESSAGE_VERSION_CURRENT,
+        {
+            sizeof("ipc://message_channel"),
+            NN_PAIR,
+            "ipc://message_channel"
+        },
+        sizeof("json_encoded_remote_module_parameters"),
+        "json_encoded_remote_module_parameters"
+    };
+    static const void * NN_MESSAGE_BUFFER = (void *)0xEBADF00D;
+    static const int32_t NN_MESSAGE_SIZE = 1979;
+    static const unsigned char * BATCHED_MESSAGES[2] = { (const unsigned char *)0xEBADF013, (const unsigned char *)0xEBADF3E4 };
+    static const int32_t BATCHED_MESSAGE_SIZE = 977;
+    static const MESSAGE_HANDLE STRUCTURED_MESSAGES[2] = { (MESSAGE_HANDLE)0x19791709, (MESSAGE_HANDLE)0x19791710 };
+    static const CONTROL_MESSAGE_MODULE_REPLY REPLY = {
+        {
+            CONTROL_MESSAGE_VERSION_1,
+            CONTROL_MESSAGE_TYPE_MODULE_REPLY
+        },
+        0
+    };
+
+    REMOTE_MODULE_HANDLE remote_module = ProxyGateway_Attach((MODULE_API *)&MOCK_MODULE_APIS, "proxy_gateway_ut");
+    ASSERT_IS_NOT_NULL(remote_module);
+
+    // Expected call listing
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .CopyOutArgumentBuffer(2, &NN_MESSAGE_BUFFER, sizeof(void *))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(NN_MESSAGE_SIZE);
+    STRICT_EXPECTED_CALL(ControlMessage_CreateFromByteArray((const unsigned char *)NN_MESSAGE_BUFFER, IGNORED_NUM_ARG))
+        .IgnoreArgument(2)
+        .SetReturn((CONTROL_MESSAGE *)&CREATE_MESSAGE);
+    expected_calls_process_module_create_message(remote_module, &CREATE_MESSAGE, &REPLY);
+    STRICT_EXPECTED_CALL(ControlMessage_Destroy((CONTROL_MESSAGE *)&CREATE_MESSAGE));
+    STRICT_EXPECTED_CALL(nn_freemsg((void *)NN_MESSAGE_BUFFER));
+    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .CopyOutArgumentBuffer(2, &NN_MESSAGE_BUFFER, sizeof(void *))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(NN_MESSAGE_SIZE);
+    STRICT_EXPECTED_CALL(MessageBatch_IsBatch((const unsigned char *)NN_MESSAGE_BUFFER, NN_MESSAGE_SIZE))
+        .SetReturn(true);
+    STRICT_EXPECTED_CALL(MessageBatch_GetNext((const unsigned char *)NN_MESSAGE_BUFFER, NN_MESSAGE_SIZE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(4, &BATCHED_MESSAGES[0], sizeof(const unsigned char *))
+        .IgnoreArgument(3)
+        .IgnoreArgument(4)
+        .SetReturn(BATCHED_MESSAGE_SIZE);
+    STRICT_EXPECTED_CALL(Message_CreateFromByteArray(BATCHED_MESSAGES[0], BATCHED_MESSAGE_SIZE))
+        .SetReturn(STRUCTURED_MESSAGES[0]);
+    STRICT_EXPECTED_CALL(mock_receive(MOCK_MODULE, STRUCTURED_MESSAGES[0]));
+    STRICT_EXPECTED_CALL(Message_Destroy(STRUCTURED_MESSAGES[0]));
+    STRICT_EXPECTED_CALL(MessageBatch_GetNext((const unsigned char *)NN_MESSAGE_BUFFER, NN_MESSAGE_SIZE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(4, &BATCHED_MESSAGES[1], sizeof(const unsigned char *))
+        .IgnoreArgument(3)
+        .IgnoreArgument(4)
+        .SetReturn(BATCHED_MESSAGE_SIZE);
+    STRICT_EXPECTED_CALL(Message_CreateFromByteArray(BATCHED_MESSAGES[1], BATCHED_MESSAGE_SIZE))
+        .SetReturn(STRUCTURED_MESSAGES[1]);
+    STRICT_EXPECTED_CALL(mock_receive(MOCK_MODULE, STRUCTURED_MESSAGES[1]));
+    STRICT_EXPECTED_CALL(Message_Destroy(STRUCTURED_MESSAGES[1]));
+    STRICT_EXPECTED_CALL(MessageBatch_GetNext((const unsigned char *)NN_MESSAGE_BUFFER, NN_MESSAGE_SIZE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(3)
+        .IgnoreArgument(4)
+        .SetReturn(0);
+    STRICT_EXPECTED_CALL(nn_freemsg((void *)NN_MESSAGE_BUFFER));
+
+    // Act
+    ProxyGateway_DoWork(remote_module);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
+/* Tests_SRS_PROXY_GATEWAY_027_067: [Message Ring - If the message channel is a pair of message rings, `ProxyGateway_DoWork` shall poll the incoming ring by calling `int32_t MessageRing_BeginRead(MESSAGE_RING_HANDLE ring, const unsigned char ** buffer, unsigned int timeout_ms)` with `0` for `timeout_ms`] */
+/* Tests_SRS_PROXY_GATEWAY_027_068: [Message Ring - If a module message was received, then `ProxyGateway_DoWork` will parse that message in place by calling `MESSAGE_HANDLE Message_CreateFromByteArray(const unsigned char * source, int32_t size)`, pass the structured message to the module and destroy it] */
+/* Tests_SRS_PROXY_GATEWAY_027_069: [Message Ring - `ProxyGateway_DoWork` shall release the module message from the ring by calling `void MessageRing_EndRead(MESSAGE_RING_HANDLE ring)`] */
+TEST_FUNCTION(doWork_SCENARIO_message_ring_message_success)
+{
+    // Arrange
+    static const MESSAGE_URI MESSAGE = {
+        sizeof("shm://proxy_gateway_ut"),
+        NN_PAIR,
+        "shm://proxy_gateway_ut"
+    };
+    static const unsigned char * RING_MESSAGE_BUFFER = (const unsigned char *)0xEBADF00D;
+    static const int32_t RING_MESSAGE_SIZE = 1979;
+    static const MESSAGE_HANDLE STRUCTURED_MESSAGE = (MESSAGE_HANDLE)0x19791709;
+
+    REMOTE_MODULE_HANDLE remote_module = ProxyGateway_Attach((MODULE_API *)&MOCK_MODULE_APIS, "proxy_gateway_ut");
+    ASSERT_IS_NOT_NULL(remote_module);
+    expected_calls_connect_to_message_rings();
+    ASSERT_ARE_EQUAL(int, 0, connect_to_message_channel(remote_module, &MESSAGE));
+
+    // Expected call listing
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(-1);
+    STRICT_EXPECTED_CALL(nn_errno())
+        .SetReturn(EAGAIN);
+    STRICT_EXPECTED_CALL(MessageRing_BeginRead(MOCK_INCOMING_RING, IGNORED_PTR_ARG, 0))
+        .CopyOutArgumentBuffer(2, &RING_MESSAGE_BUFFER, sizeof(const unsigned char *))
+        .IgnoreArgument(2)
+        .SetReturn(RING_MESSAGE_SIZE);
+    STRICT_EXPECTED_CALL(Message_CreateFromByteArray(RING_MESSAGE_BUFFER, RING_MESSAGE_SIZE))
+        .SetReturn(STRUCTURED_MESSAGE);
+    STRICT_EXPECTED_CALL(mock_receive(NULL, STRUCTURED_MESSAGE));
+    STRICT_EXPECTED_CALL(Message_Destroy(STRUCTURED_MESSAGE));
+    STRICT_EXPECTED_CALL(MessageRing_EndRead(MOCK_INCOMING_RING));
+
+    // Act
+    ProxyGateway_DoWork(remote_module);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
+/* Tests_SRS_PROXY_GATEWAY_027_067: [Message Ring - If the message channel is a pair of message rings, `ProxyGateway_DoWork` shall poll the incoming ring by calling `int32_t MessageRing_BeginRead(MESSAGE_RING_HANDLE ring, const unsigned char ** buffer, unsigned int timeout_ms)` with `0` for `timeout_ms`] */
+TEST_FUNCTION(doWork_SCENARIO_message_ring_message_not_available)
+{
+    // Arrange
+    static const MESSAGE_URI MESSAGE = {
+        sizeof("shm://proxy_gateway_ut"),
+        NN_PAIR,
+        "shm://proxy_gateway_ut"
+    };
+
+    REMOTE_MODULE_HANDLE remote_module = ProxyGateway_Attach((MODULE_API *)&MOCK_MODULE_APIS, "proxy_gateway_ut");
+    ASSERT_IS_NOT_NULL(remote_module);
+    expected_calls_connect_to_message_rings();
+    ASSERT_ARE_EQUAL(int, 0, connect_to_message_channel(remote_module, &MESSAGE));
+
+    // Expected call listing
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(-1);
+    STRICT_EXPECTED_CALL(nn_errno())
+        .SetReturn(EAGAIN);
+    STRICT_EXPECTED_CALL(MessageRing_BeginRead(MOCK_INCOMING_RING, IGNORED_PTR_ARG, 0))
+        .IgnoreArgument(2)
+        .SetReturn(0);
+
+    // Act
+    ProxyGateway_DoWork(remote_module);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
 /* Tests_SRS_PROXY_GATEWAY_027_045: [Prerequisite Check - If the `remote_module` parameter is `NULL`, then `ProxyGateway_HaltWorkerThread` shall return a non-zero value] */
 TEST_FUNCTION(haltWorkerThread_SCENARIO_NULL_handle)
 {
@@ -1523,8 +1787,10 @@ TEST_FUNCTION(haltWorkerThread_SCENARIO_no_worker_thread)
 }
 
 /* Tests_SRS_PROXY_GATEWAY_027_047: [`ProxyGateway_HaltWorkerThread` shall obtain the thread mutex in order to signal the thread by calling `LOCK_RESULT Lock(LOCK_HANDLE handle)`] */
+/* Tests_SRS_PROXY_GATEWAY_027_073: [`ProxyGateway_HaltWorkerThread` shall wake the worker thread by calling `int nn_send(int s, const void * buf, size_t len, int flags)` on the wake channel with `NN_DONTWAIT` for `flags`, and ignore any error] */
 /* Tests_SRS_PROXY_GATEWAY_027_049: [`ProxyGateway_HaltWorkerThread` shall release the thread mutex upon signalling by calling `LOCK_RESULT Unlock(LOCK_HANDLE handle)`] */
 /* Tests_SRS_PROXY_GATEWAY_027_051: [`ProxyGateway_HaltWorkerThread` shall halt the thread by calling `THREADAPI_RESULT ThreadAPI_Join(THREAD_HANDLE handle, int * res)`] */
+/* Tests_SRS_PROXY_GATEWAY_027_074: [`ProxyGateway_HaltWorkerThread` shall close both sockets of the wake channel by calling `int nn_close(int s)`] */
 /* Tests_SRS_PROXY_GATEWAY_027_053: [`ProxyGateway_HaltWorkerThread` shall free the thread mutex by calling `LOCK_RESULT Lock_Deinit(LOCK_HANDLE handle)`] */
 /* Tests_SRS_PROXY_GATEWAY_027_055: [`ProxyGateway_HaltWorkerThread` shall free the memory allocated to the thread details] */
 /* Tests_SRS_PROXY_GATEWAY_027_057: [If no errors are encountered, then `ProxyGateway_HaltWorkerThread` shall return zero] */
@@ -1542,12 +1808,14 @@ TEST_FUNCTION(haltWorkerThread_SCENARIO_success)
     EXPECTED_CALL(gballoc_calloc(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     EXPECTED_CALL(Lock_Init())
         .SetReturn(MOCK_LOCK);
+    expected_calls_create_wake_channel();
     EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .SetReturn(THREADAPI_OK);
 
     STRICT_EXPECTED_CALL(Lock(MOCK_LOCK))
         .SetFailReturn(LOCK_ERROR)
         .SetReturn(LOCK_OK);
+    expected_calls_wake_worker_thread();
     STRICT_EXPECTED_CALL(Unlock(MOCK_LOCK))
         .SetFailReturn(LOCK_ERROR)
         .SetReturn(LOCK_OK);
@@ -1557,6 +1825,7 @@ TEST_FUNCTION(haltWorkerThread_SCENARIO_success)
         .CopyOutArgumentBuffer(2, &thread_exit_result, sizeof(thread_exit_result))
         .SetFailReturn(THREADAPI_ERROR)
         .SetReturn(THREADAPI_OK);
+    expected_calls_close_wake_channel();
     STRICT_EXPECTED_CALL(Lock_Deinit(MOCK_LOCK))
         .SetFailReturn(LOCK_ERROR)
         .SetReturn(LOCK_OK);
@@ -1590,12 +1859,14 @@ TEST_FUNCTION(haltWorkerThread_SCENARIO_thread_error)
     EXPECTED_CALL(gballoc_calloc(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     EXPECTED_CALL(Lock_Init())
         .SetReturn(MOCK_LOCK);
+    expected_calls_create_wake_channel();
     EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .SetReturn(THREADAPI_OK);
 
     STRICT_EXPECTED_CALL(Lock(MOCK_LOCK))
         .SetFailReturn(LOCK_ERROR)
         .SetReturn(LOCK_OK);
+    expected_calls_wake_worker_thread();
     STRICT_EXPECTED_CALL(Unlock(MOCK_LOCK))
         .SetFailReturn(LOCK_ERROR)
         .SetReturn(LOCK_OK);
@@ -1605,6 +1876,7 @@ TEST_FUNCTION(haltWorkerThread_SCENARIO_thread_error)
         .CopyOutArgumentBuffer(2, &thread_exit_result, sizeof(thread_exit_result))
         .SetFailReturn(THREADAPI_ERROR)
         .SetReturn(THREADAPI_OK);
+    expected_calls_close_wake_channel();
     STRICT_EXPECTED_CALL(Lock_Deinit(MOCK_LOCK))
         .SetFailReturn(LOCK_ERROR)
         .SetReturn(LOCK_OK);
@@ -1637,6 +1909,7 @@ TEST_FUNCTION(haltWorkerThread_SCENARIO_can_not_obtain_mutex)
     EXPECTED_CALL(gballoc_calloc(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     EXPECTED_CALL(Lock_Init())
         .SetReturn(MOCK_LOCK);
+    expected_calls_create_wake_channel();
     EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .SetReturn(THREADAPI_OK);
 
@@ -1670,11 +1943,13 @@ TEST_FUNCTION(haltWorkerThread_SCENARIO_can_not_release_mutex)
     EXPECTED_CALL(gballoc_calloc(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     EXPECTED_CALL(Lock_Init())
         .SetReturn(MOCK_LOCK);
+    expected_calls_create_wake_channel();
     EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .SetReturn(THREADAPI_OK);
 
     STRICT_EXPECTED_CALL(Lock(MOCK_LOCK))
         .SetReturn(LOCK_OK);
+    expected_calls_wake_worker_thread();
     STRICT_EXPECTED_CALL(Unlock(MOCK_LOCK))
         .SetReturn(LOCK_ERROR);
 
@@ -1706,12 +1981,14 @@ TEST_FUNCTION(haltWorkerThread_SCENARIO_can_not_join_thread)
     EXPECTED_CALL(gballoc_calloc(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     EXPECTED_CALL(Lock_Init())
         .SetReturn(MOCK_LOCK);
+    expected_calls_create_wake_channel();
     EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .SetReturn(THREADAPI_OK);
 
     STRICT_EXPECTED_CALL(Lock(MOCK_LOCK))
         .SetFailReturn(LOCK_ERROR)
         .SetReturn(LOCK_OK);
+    expected_calls_wake_worker_thread();
     STRICT_EXPECTED_CALL(Unlock(MOCK_LOCK))
         .SetFailReturn(LOCK_ERROR)
         .SetReturn(LOCK_OK);
@@ -1749,12 +2026,14 @@ TEST_FUNCTION(haltWorkerThread_SCENARIO_can_not_free_mutex)
     EXPECTED_CALL(gballoc_calloc(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     EXPECTED_CALL(Lock_Init())
         .SetReturn(MOCK_LOCK);
+    expected_calls_create_wake_channel();
     EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .SetReturn(THREADAPI_OK);
 
     STRICT_EXPECTED_CALL(Lock(MOCK_LOCK))
         .SetFailReturn(LOCK_ERROR)
         .SetReturn(LOCK_OK);
+    expected_calls_wake_worker_thread();
     STRICT_EXPECTED_CALL(Unlock(MOCK_LOCK))
         .SetFailReturn(LOCK_ERROR)
         .SetReturn(LOCK_OK);
@@ -1764,6 +2043,7 @@ TEST_FUNCTION(haltWorkerThread_SCENARIO_can_not_free_mutex)
         .CopyOutArgumentBuffer(2, &thread_exit_result, sizeof(thread_exit_result))
         .SetFailReturn(THREADAPI_ERROR)
         .SetReturn(THREADAPI_OK);
+    expected_calls_close_wake_channel();
     STRICT_EXPECTED_CALL(Lock_Deinit(MOCK_LOCK))
         .SetFailReturn(LOCK_ERROR)
         .SetReturn(LOCK_OK);
@@ -1822,12 +2102,14 @@ TEST_FUNCTION(detach_SCENARIO_halt_not_called)
     EXPECTED_CALL(gballoc_calloc(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     EXPECTED_CALL(Lock_Init())
         .SetReturn(MOCK_LOCK);
+    expected_calls_create_wake_channel();
     EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .SetReturn(THREADAPI_OK);
 
     STRICT_EXPECTED_CALL(Lock(MOCK_LOCK))
         .SetFailReturn(LOCK_ERROR)
         .SetReturn(LOCK_OK);
+    expected_calls_wake_worker_thread();
     STRICT_EXPECTED_CALL(Unlock(MOCK_LOCK))
         .SetFailReturn(LOCK_ERROR)
         .SetReturn(LOCK_OK);
@@ -1837,6 +2119,7 @@ TEST_FUNCTION(detach_SCENARIO_halt_not_called)
         .CopyOutArgumentBuffer(2, &thread_exit_result, sizeof(thread_exit_result))
         .SetFailReturn(THREADAPI_ERROR)
         .SetReturn(THREADAPI_OK);
+    expected_calls_close_wake_channel();
     STRICT_EXPECTED_CALL(Lock_Deinit(MOCK_LOCK))
         .SetReturn(LOCK_ERROR);
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
@@ -1918,12 +2201,14 @@ TEST_FUNCTION(detach_SCENARIO_unable_to_halt_thread)
     EXPECTED_CALL(gballoc_calloc(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     EXPECTED_CALL(Lock_Init())
         .SetReturn(MOCK_LOCK);
+    expected_calls_create_wake_channel();
     EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .SetReturn(THREADAPI_OK);
 
     STRICT_EXPECTED_CALL(Lock(MOCK_LOCK))
         .SetFailReturn(LOCK_ERROR)
         .SetReturn(LOCK_OK);
+    expected_calls_wake_worker_thread();
     STRICT_EXPECTED_CALL(Unlock(MOCK_LOCK))
         .SetReturn(LOCK_ERROR);
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
@@ -2029,6 +2314,81 @@ TEST_FUNCTION(connect_to_message_channel_SCENARIO_negative_tests)
     umock_c_negative_tests_deinit();
 }
 
+/* SRS_PROXY_GATEWAY_027_0xx: [If `MESSAGE_URI::uri` starts with "shm://", `connect_to_message_channel` shall open the message rings created by the gateway, reading from the one named with the "_to_module" suffix and writing to the one named with the "_to_gateway" suffix] */
+TEST_FUNCTION(connect_to_message_channel_SCENARIO_message_rings_success)
+{
+    // Arrange
+    static const MESSAGE_URI MESSAGE = {
+        sizeof("shm://proxy_gateway_ut"),
+        NN_PAIR,
+        "shm://proxy_gateway_ut"
+    };
+
+    int result;
+
+    REMOTE_MODULE_HANDLE remote_module = ProxyGateway_Attach((MODULE_API *)&MOCK_MODULE_APIS, "proxy_gateway_ut");
+    ASSERT_IS_NOT_NULL(remote_module);
+
+    // Expected call listing
+    umock_c_reset_all_calls();
+    expected_calls_connect_to_message_rings();
+
+    // Act
+    result = connect_to_message_channel(remote_module, &MESSAGE);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
+/* SRS_PROXY_GATEWAY_027_0xx: [If `MESSAGE_URI::uri` starts with "shm://", `connect_to_message_channel` shall open the message rings created by the gateway, reading from the one named with the "_to_module" suffix and writing to the one named with the "_to_gateway" suffix] */
+TEST_FUNCTION(connect_to_message_channel_SCENARIO_message_rings_negative_tests)
+{
+    // Arrange
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    static const MESSAGE_URI MESSAGE = {
+        sizeof("shm://proxy_gateway_ut"),
+        NN_PAIR,
+        "shm://proxy_gateway_ut"
+    };
+
+    int result;
+
+    REMOTE_MODULE_HANDLE remote_module = ProxyGateway_Attach((MODULE_API *)&MOCK_MODULE_APIS, "proxy_gateway_ut");
+    ASSERT_IS_NOT_NULL(remote_module);
+
+    // Expected call listing
+    umock_c_reset_all_calls();
+    expected_calls_connect_to_message_rings();
+    umock_c_negative_tests_snapshot();
+
+    ASSERT_ARE_EQUAL(int, negative_test_index, umock_c_negative_tests_call_count());
+    for (size_t i = 0; i < umock_c_negative_tests_call_count(); ++i) {
+        if (skipNegativeTest(i)) {
+            printf("%s: Skipping negative tests: %zx\n", __FUNCTION__, i);
+            continue;
+        }
+        printf("%s: Running negative tests: %zx\n", __FUNCTION__, i);
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        // Act
+        result = connect_to_message_channel(remote_module, &MESSAGE);
+
+        // Assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    }
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+    umock_c_negative_tests_deinit();
+}
+
 /* SRS_PROXY_GATEWAY_027_0xx: [`disconnect_from_message_channel` shall shutdown the Azure IoT Gateway message channel by calling `int nn_shutdown(int s, int how)`] */
 /* SRS_PROXY_GATEWAY_027_0xx: [`disconnect_from_message_channel` shall close the Azure IoT Gateway message socket by calling `int nn_close(int s)`] */
 TEST_FUNCTION(disconnect_from_message_channel_SCENARIO_success)
@@ -2051,6 +2411,36 @@ TEST_FUNCTION(disconnect_from_message_channel_SCENARIO_success)
     ProxyGateway_Detach(remote_module);
 }
 
+/* SRS_PROXY_GATEWAY_027_0xx: [If connected through message rings, `disconnect_from_message_channel` shall unmap them by calling `void MessageRing_Destroy(MESSAGE_RING_HANDLE ring)`] */
+TEST_FUNCTION(disconnect_from_message_channel_SCENARIO_message_rings)
+{
+    // Arrange
+    static const MESSAGE_URI MESSAGE = {
+        sizeof("shm://proxy_gateway_ut"),
+        NN_PAIR,
+        "shm://proxy_gateway_ut"
+    };
+
+    REMOTE_MODULE_HANDLE remote_module = ProxyGateway_Attach((MODULE_API *)&MOCK_MODULE_APIS, "proxy_gateway_ut");
+    ASSERT_IS_NOT_NULL(remote_module);
+    expected_calls_connect_to_message_rings();
+    ASSERT_ARE_EQUAL(int, 0, connect_to_message_channel(remote_module, &MESSAGE));
+
+    // Expected call listing
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(MessageRing_Destroy(MOCK_INCOMING_RING));
+    STRICT_EXPECTED_CALL(MessageRing_Destroy(MOCK_OUTGOING_RING));
+
+    // Act
+    disconnect_from_message_channel(remote_module);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
 /* SRS_PROXY_GATEWAY_027_0xx: [Special Handling - If `Module_ParseConfigurationFromJson` was provided, `invoke_add_module_procedure` shall parse the configuration by calling `void * Module_ParseConfigurationFromJson(const char * configuration)` using the `CONTROL_MESSAGE_MODULE_CREATE::args` as `configuration`] */
 TEST_FUNCTION(invoke_add_module_procedure_SCENARIO_NULL_Module_ParseConfigurationFromJson)
 {
@@ -2496,8 +2886,8 @@ TEST_FUNCTION(send_control_reply_SCENARIO_negative_tests)
 /* Tests_SRS_BROKER_17_010: [ Broker_Publish shall send a message on the publish_socket. ] */
 /* Tests_SRS_BROKER_17_011: [ Broker_Publish shall free the serialized message data. ] */
 /* Tests_SRS_BROKER_17_012: [ Broker_Publish shall free the message. ] */
-/* Tests_SRS_BROKER_17_022: [ N/A - Broker_Publish shall Lock the modules lock. ] */
-/* Tests_SRS_BROKER_17_023: [ N/A - Broker_Publish shall Unlock the modules lock. ] */
+/* Tests_SRS_BROKER_17_022: [ N/A - Broker_Publish shall acquire the current routing table without taking the modules lock. ] */
+/* Tests_SRS_BROKER_17_023: [ N/A - Broker_Publish shall release the routing table. ] */
 /* Tests_SRS_BROKER_17_025: [ Broker_Publish shall allocate a nanomsg buffer the size of the serialized message + sizeof(MODULE_HANDLE). ] */
 /* Tests_SRS_BROKER_17_026: [ N/A - Broker_Publish shall copy source into the beginning of the nanomsg buffer. ] */
 /* Tests_SRS_BROKER_17_027: [ Broker_Publish shall serialize the message into the remainder of the nanomsg buffer. ] */
@@ -2551,6 +2941,7 @@ TEST_FUNCTION(publish_SCENARIO_create_message_success)
         .IgnoreArgument(1)
         .IgnoreArgument(2)
         .SetReturn(NN_MESSAGE_SIZE);
+    STRICT_EXPECTED_CALL(MessageBatch_IsBatch((const unsigned char *)NN_MESSAGE_BUFFER, NN_MESSAGE_SIZE));
     STRICT_EXPECTED_CALL(Message_CreateFromByteArray((const unsigned char *)NN_MESSAGE_BUFFER, IGNORED_NUM_ARG))
         .IgnoreArgument(2)
         .SetReturn((MESSAGE_HANDLE)&CREATE_MESSAGE);
@@ -2569,6 +2960,93 @@ TEST_FUNCTION(publish_SCENARIO_create_message_success)
 }
 
 
+/* Tests_SRS_BROKER_17_008: [ Broker_Publish shall serialize the message. ] */
+/* Tests_SRS_BROKER_17_012: [ Broker_Publish shall free the message. ] */
+/* Tests_SRS_BROKER_13_037: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ] */
+TEST_FUNCTION(publish_SCENARIO_message_ring_success)
+{
+    // Arrange
+    static const MESSAGE_URI MESSAGE = {
+        sizeof("shm://proxy_gateway_ut"),
+        NN_PAIR,
+        "shm://proxy_gateway_ut"
+    };
+    static const MESSAGE_HANDLE PUBLISHED_MESSAGE = (MESSAGE_HANDLE)0x19791709;
+    static const MESSAGE_HANDLE CLONED_MESSAGE = (MESSAGE_HANDLE)0x19791710;
+    static const int32_t SERIALIZED_SIZE = 1979;
+    unsigned char ring_bytes[1];
+
+    REMOTE_MODULE_HANDLE remote_module = ProxyGateway_Attach((MODULE_API *)&MOCK_MODULE_APIS, "proxy_gateway_ut");
+    ASSERT_IS_NOT_NULL(remote_module);
+    expected_calls_connect_to_message_rings();
+    ASSERT_ARE_EQUAL(int, 0, connect_to_message_channel(remote_module, &MESSAGE));
+
+    // Expected call listing
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(Message_Clone(PUBLISHED_MESSAGE))
+        .SetReturn(CLONED_MESSAGE);
+    STRICT_EXPECTED_CALL(Message_ToByteArray(PUBLISHED_MESSAGE, NULL, 0))
+        .SetReturn(SERIALIZED_SIZE);
+    STRICT_EXPECTED_CALL(MessageRing_BeginWrite(MOCK_OUTGOING_RING, SERIALIZED_SIZE, IGNORED_NUM_ARG))
+        .IgnoreArgument(3)
+        .SetReturn(ring_bytes);
+    STRICT_EXPECTED_CALL(Message_ToByteArray(PUBLISHED_MESSAGE, ring_bytes, SERIALIZED_SIZE))
+        .SetReturn(SERIALIZED_SIZE);
+    STRICT_EXPECTED_CALL(MessageRing_EndWrite(MOCK_OUTGOING_RING));
+    STRICT_EXPECTED_CALL(Message_Destroy(CLONED_MESSAGE));
+
+    // Act
+    BROKER_RESULT result = Broker_Publish((BROKER_HANDLE)remote_module, MOCK_MODULE, PUBLISHED_MESSAGE);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, BROKER_OK, result);
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
+/* Tests_SRS_BROKER_13_037: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ] */
+TEST_FUNCTION(publish_SCENARIO_message_ring_full)
+{
+    // Arrange
+    static const MESSAGE_URI MESSAGE = {
+        sizeof("shm://proxy_gateway_ut"),
+        NN_PAIR,
+        "shm://proxy_gateway_ut"
+    };
+    static const MESSAGE_HANDLE PUBLISHED_MESSAGE = (MESSAGE_HANDLE)0x19791709;
+    static const MESSAGE_HANDLE CLONED_MESSAGE = (MESSAGE_HANDLE)0x19791710;
+    static const int32_t SERIALIZED_SIZE = 1979;
+
+    REMOTE_MODULE_HANDLE remote_module = ProxyGateway_Attach((MODULE_API *)&MOCK_MODULE_APIS, "proxy_gateway_ut");
+    ASSERT_IS_NOT_NULL(remote_module);
+    expected_calls_connect_to_message_rings();
+    ASSERT_ARE_EQUAL(int, 0, connect_to_message_channel(remote_module, &MESSAGE));
+
+    // Expected call listing
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(Message_Clone(PUBLISHED_MESSAGE))
+        .SetReturn(CLONED_MESSAGE);
+    STRICT_EXPECTED_CALL(Message_ToByteArray(PUBLISHED_MESSAGE, NULL, 0))
+        .SetReturn(SERIALIZED_SIZE);
+    STRICT_EXPECTED_CALL(MessageRing_BeginWrite(MOCK_OUTGOING_RING, SERIALIZED_SIZE, IGNORED_NUM_ARG))
+        .IgnoreArgument(3)
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(Message_Destroy(CLONED_MESSAGE));
+
+    // Act
+    BROKER_RESULT result = Broker_Publish((BROKER_HANDLE)remote_module, MOCK_MODULE, PUBLISHED_MESSAGE);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, BROKER_ERROR, result);
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
+
 /* SRS_PROXY_GATEWAY_027_0xx: [`worker_thread` shall obtain the thread mutex in order to initialize the thread by calling `LOCK_RESULT Lock(LOCK_HANDLE handle)`] */
 /* SRS_PROXY_GATEWAY_027_0xx: [If unable to obtain the mutex, then `worker_thread` shall return a non-zero value] */
 /* SRS_PROXY_GATEWAY_027_0xx: [`worker_thread` shall release the thread mutex upon entering the loop by calling `LOCK_RESULT Unlock(LOCK_HANDLE handle)`] */
@@ -0,0 +1,81 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       message_batch.h
+ *  @brief      Packs several serialized gateway messages into one frame on a
+ *              message channel.
+ *
+ *  @details    A batch starts with the header bytes 0xA1 0x6B, followed by the
+ *              number of messages it holds. Each message follows as its size
+ *              and its serialized bytes, all integers in network byte order.
+ *              The header cannot be confused with the header of a serialized
+ *              gateway message, so a receiver can accept both on one channel.
+ */
+
+#ifndef MESSAGE_BATCH_H
+#define MESSAGE_BATCH_H
+
+#ifdef __cplusplus
+#include <cstdint>
+#include <cstdbool>
+extern "C"
+{
+#else
+#include <stdint.h>
+#include <stdbool.h>
+#endif
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#include "gateway_export.h"
+
+/** @brief  Bytes taken by the batch header: two header bytes and a message count. */
+#define MESSAGE_BATCH_HEADER_SIZE 6
+
+/** @brief  Bytes written ahead of each message in a batch. */
+#define MESSAGE_BATCH_ENTRY_HEADER_SIZE 4
+
+/** @brief      Writes the header of a batch holding @c message_count messages.
+ *
+ *  @param      destination     At least #MESSAGE_BATCH_HEADER_SIZE bytes.
+ *  @param      message_count   The number of messages that will follow.
+ *
+ *  @return     The number of bytes written.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int32_t, MessageBatch_WriteHeader, unsigned char*, destination, uint32_t, message_count);
+
+/** @brief      Writes the entry header of a message of @c message_size bytes.
+ *              The serialized message is expected right after it.
+ *
+ *  @param      destination     At least #MESSAGE_BATCH_ENTRY_HEADER_SIZE bytes.
+ *  @param      message_size    The size of the serialized message.
+ *
+ *  @return     The number of bytes written.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int32_t, MessageBatch_WriteEntryHeader, unsigned char*, destination, int32_t, message_size);
+
+/** @brief      Tells whether a frame received on a message channel is a batch.
+ *
+ *  @return     @c true if @c source starts with a batch header, @c false
+ *              otherwise.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT bool, MessageBatch_IsBatch, const unsigned char*, source, int32_t, size);
+
+/** @brief      Gets the next message in a batch without copying it.
+ *
+ *  @param      source      The batch.
+ *  @param      size        The size of the batch.
+ *  @param      position    Where the previous message ended, 0 to start with
+ *                          the first message. Updated past the message returned.
+ *  @param      message     Receives a pointer to the serialized message.
+ *
+ *  @return     The size of the message, 0 once the batch holds no more
+ *              messages, or a negative value if the batch is malformed.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int32_t, MessageBatch_GetNext, const unsigned char*, source, int32_t, size, int32_t*, position, const unsigned char**, message);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*MESSAGE_BATCH_H*/
@@ -0,0 +1,112 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       message_ring.h
+ *  @brief      A single producer, single consumer ring of serialized gateway
+ *              messages shared between the gateway and a module host process.
+ *
+ *  @details    The ring lives in a named shared memory segment. The gateway
+ *              creates it and the module host opens it by name, so a
+ *              serialized message is written once by one process and parsed
+ *              in place by the other. Each side of a ring is used by at most
+ *              one writer and one reader; writers in the same process are
+ *              serialized by the ring handle.
+ */
+
+#ifndef MESSAGE_RING_H
+#define MESSAGE_RING_H
+
+#ifdef __cplusplus
+#include <cstdint>
+#include <cstddef>
+extern "C"
+{
+#else
+#include <stdint.h>
+#include <stddef.h>
+#endif
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#include "gateway_export.h"
+
+/** @brief  URI scheme of a message channel carried by a pair of message rings. */
+#define MESSAGE_RING_URI_HEAD "shm://"
+#define MESSAGE_RING_URI_HEAD_SIZE 6
+
+/** @brief  Appended to the id in a "shm://" uri to name the ring carrying
+ *          messages from the gateway to the module host, and back. */
+#define MESSAGE_RING_TO_MODULE_SUFFIX "_to_module"
+#define MESSAGE_RING_TO_GATEWAY_SUFFIX "_to_gateway"
+
+/** @brief  Space reserved for messages in a ring created with a size of 0. */
+#define MESSAGE_RING_DEFAULT_SIZE (1024 * 1024)
+
+typedef struct MESSAGE_RING_TAG* MESSAGE_RING_HANDLE;
+
+/** @brief      Creates a new shared memory segment called @c name holding an
+ *              empty ring of @c size bytes.
+ *
+ *  @details    The segment is removed when the ring is destroyed.
+ *
+ *  @param      name    The name of the segment, without a leading '/'.
+ *  @param      size    The number of bytes reserved for messages, or 0 for
+ *                      #MESSAGE_RING_DEFAULT_SIZE.
+ *
+ *  @return     A non-NULL #MESSAGE_RING_HANDLE, or NULL upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_RING_HANDLE, MessageRing_Create, const char*, name, uint32_t, size);
+
+/** @brief      Maps a ring created by #MessageRing_Create in another process.
+ *
+ *  @param      name    The name given to #MessageRing_Create.
+ *
+ *  @return     A non-NULL #MESSAGE_RING_HANDLE, or NULL upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_RING_HANDLE, MessageRing_Open, const char*, name);
+
+/** @brief      Reserves @c size contiguous bytes at the end of the ring.
+ *
+ *  @details    Waits up to @c timeout_ms milliseconds for the reader to make
+ *              room. On success the caller owns the ring for writing until
+ *              it calls #MessageRing_EndWrite.
+ *
+ *  @return     A pointer to @c size writable bytes, or NULL if the ring stayed
+ *              full or upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT unsigned char*, MessageRing_BeginWrite, MESSAGE_RING_HANDLE, ring, int32_t, size, unsigned int, timeout_ms);
+
+/** @brief      Publishes the bytes reserved by #MessageRing_BeginWrite and
+ *              wakes the reader.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT void, MessageRing_EndWrite, MESSAGE_RING_HANDLE, ring);
+
+/** @brief      Gets the oldest message in the ring without copying it.
+ *
+ *  @details    Waits up to @c timeout_ms milliseconds for a message. The bytes
+ *              stay valid until #MessageRing_EndRead is called.
+ *
+ *  @param      ring        The ring to read from.
+ *  @param      buffer      Receives a pointer to the message.
+ *  @param      timeout_ms  How long to wait for a message, 0 to not wait.
+ *
+ *  @return     The size of the message, 0 if there was no message, or a
+ *              negative value upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int32_t, MessageRing_BeginRead, MESSAGE_RING_HANDLE, ring, const unsigned char**, buffer, unsigned int, timeout_ms);
+
+/** @brief      Releases the message returned by #MessageRing_BeginRead and
+ *              wakes the writer.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT void, MessageRing_EndRead, MESSAGE_RING_HANDLE, ring);
+
+/** @brief      Unmaps the ring, and removes its segment if this process
+ *              created it.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT void, MessageRing_Destroy, MESSAGE_RING_HANDLE, ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*MESSAGE_RING_H*/
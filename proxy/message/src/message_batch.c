@@ -0,0 +1,168 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "message_batch.h"
+
+#include <stddef.h>
+
+#include "azure_c_shared_utility/xlogging.h"
+
+#define FIRST_BATCH_BYTE 0xA1  /*0xA1 comes from (A)zure (I)oT*/
+#define SECOND_BATCH_BYTE 0x6B /*0x6B comes from (G)ateway (B)atch*/
+
+static void write_uint32(unsigned char* destination, uint32_t value)
+{
+    destination[0] = (unsigned char)((value >> 24) & 0xFF);
+    destination[1] = (unsigned char)((value >> 16) & 0xFF);
+    destination[2] = (unsigned char)((value >> 8) & 0xFF);
+    destination[3] = (unsigned char)(value & 0xFF);
+}
+
+static uint32_t read_uint32(const unsigned char* source)
+{
+    return
+        ((uint32_t)source[0] << 24) |
+        ((uint32_t)source[1] << 16) |
+        ((uint32_t)source[2] << 8) |
+        (uint32_t)source[3];
+}
+
+int32_t MessageBatch_WriteHeader(unsigned char* destination, uint32_t message_count)
+{
+    int32_t result;
+    if (destination == NULL)
+    {
+        /*Codes_SRS_MESSAGE_BATCH_17_001: [ If `destination` is `NULL`, `MessageBatch_WriteHeader` shall return 0. ]*/
+        LogError("invalid argument destination=[%p]", destination);
+        result = 0;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_BATCH_17_002: [ `MessageBatch_WriteHeader` shall write the bytes 0xA1 0x6B followed by `message_count` in network byte order. ]*/
+        destination[0] = FIRST_BATCH_BYTE;
+        destination[1] = SECOND_BATCH_BYTE;
+        write_uint32(destination + 2, message_count);
+        /*Codes_SRS_MESSAGE_BATCH_17_003: [ `MessageBatch_WriteHeader` shall return `MESSAGE_BATCH_HEADER_SIZE`. ]*/
+        result = MESSAGE_BATCH_HEADER_SIZE;
+    }
+    return result;
+}
+
+int32_t MessageBatch_WriteEntryHeader(unsigned char* destination, int32_t message_size)
+{
+    int32_t result;
+    if ((destination == NULL) || (message_size < 0))
+    {
+        /*Codes_SRS_MESSAGE_BATCH_17_004: [ If `destination` is `NULL` or `message_size` is negative, `MessageBatch_WriteEntryHeader` shall return 0. ]*/
+        LogError("invalid arguments destination=[%p], message_size=[%d]", destination, (int)message_size);
+        result = 0;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_BATCH_17_005: [ `MessageBatch_WriteEntryHeader` shall write `message_size` in network byte order and return `MESSAGE_BATCH_ENTRY_HEADER_SIZE`. ]*/
+        write_uint32(destination, (uint32_t)message_size);
+        result = MESSAGE_BATCH_ENTRY_HEADER_SIZE;
+    }
+    return result;
+}
+
+bool MessageBatch_IsBatch(const unsigned char* source, int32_t size)
+{
+    /*Codes_SRS_MESSAGE_BATCH_17_006: [ `MessageBatch_IsBatch` shall return `true` if `source` holds at least `MESSAGE_BATCH_HEADER_SIZE` bytes starting with 0xA1 0x6B, and `false` otherwise. ]*/
+    return
+        (source != NULL) &&
+        (size >= MESSAGE_BATCH_HEADER_SIZE) &&
+        (source[0] == FIRST_BATCH_BYTE) &&
+        (source[1] == SECOND_BATCH_BYTE);
+}
+
+/*returns 0 if the entries of the batch end exactly at size and are as many as its header says*/
+static int validate_batch(const unsigned char* source, int32_t size)
+{
+    int result;
+    uint32_t expected_count = read_uint32(source + 2);
+    uint32_t count = 0;
+    int32_t current = MESSAGE_BATCH_HEADER_SIZE;
+    while ((current < size) && (size - current >= MESSAGE_BATCH_ENTRY_HEADER_SIZE))
+    {
+        uint32_t message_size = read_uint32(source + current);
+        if ((message_size == 0) || (message_size > (uint32_t)(size - current - MESSAGE_BATCH_ENTRY_HEADER_SIZE)))
+        {
+            break;
+        }
+        current += MESSAGE_BATCH_ENTRY_HEADER_SIZE + (int32_t)message_size;
+        count++;
+    }
+
+    if (current != size)
+    {
+        LogError("batch entries do not end at the end of the batch");
+        result = __LINE__;
+    }
+    else if (count != expected_count)
+    {
+        LogError("batch holds [%u] messages, its header says [%u]", (unsigned int)count, (unsigned int)expected_count);
+        result = __LINE__;
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
+int32_t MessageBatch_GetNext(const unsigned char* source, int32_t size, int32_t* position, const unsigned char** message)
+{
+    int32_t result;
+    if ((position == NULL) || (message == NULL) || !MessageBatch_IsBatch(source, size))
+    {
+        /*Codes_SRS_MESSAGE_BATCH_17_007: [ If `position` or `message` is `NULL`, or `source` is not a batch, `MessageBatch_GetNext` shall return a negative value. ]*/
+        LogError("invalid arguments source=[%p], position=[%p], message=[%p]", source, position, message);
+        result = -1;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_BATCH_17_008: [ If `*position` is 0, `MessageBatch_GetNext` shall start with the first message, right after the batch header. ]*/
+        int32_t current = (*position == 0) ? MESSAGE_BATCH_HEADER_SIZE : *position;
+        if ((current < MESSAGE_BATCH_HEADER_SIZE) || (current > size))
+        {
+            /*Codes_SRS_MESSAGE_BATCH_17_009: [ If `*position` is outside the batch, `MessageBatch_GetNext` shall return a negative value. ]*/
+            LogError("position [%d] is outside the batch", (int)current);
+            result = -1;
+        }
+        else if ((*position == 0) && (validate_batch(source, size) != 0))
+        {
+            /*Codes_SRS_MESSAGE_BATCH_17_013: [ If `*position` is 0, `MessageBatch_GetNext` shall return a negative value, before it returns any message, if the messages do not end exactly at the end of the batch or are not as many as the batch header says. ]*/
+            result = -1;
+        }
+        else if (current == size)
+        {
+            /*Codes_SRS_MESSAGE_BATCH_17_010: [ If `*position` is at the end of the batch, `MessageBatch_GetNext` shall return 0. ]*/
+            result = 0;
+        }
+        else if (size - current < MESSAGE_BATCH_ENTRY_HEADER_SIZE)
+        {
+            /*Codes_SRS_MESSAGE_BATCH_17_011: [ If the rest of the batch is too short for the entry header or for the message it announces, `MessageBatch_GetNext` shall return a negative value. ]*/
+            LogError("batch entry header is truncated");
+            result = -1;
+        }
+        else
+        {
+            uint32_t message_size = read_uint32(source + current);
+            if ((message_size == 0) || (message_size > (uint32_t)(size - current - MESSAGE_BATCH_ENTRY_HEADER_SIZE)))
+            {
+                /*Codes_SRS_MESSAGE_BATCH_17_011: [ If the rest of the batch is too short for the entry header or for the message it announces, `MessageBatch_GetNext` shall return a negative value. ]*/
+                LogError("batch entry of [%u] bytes is empty or truncated", (unsigned int)message_size);
+                result = -1;
+            }
+            else
+            {
+                /*Codes_SRS_MESSAGE_BATCH_17_012: [ `MessageBatch_GetNext` shall set `*message` to the serialized message, advance `*position` past it and return its size. ]*/
+                *message = source + current + MESSAGE_BATCH_ENTRY_HEADER_SIZE;
+                *position = current + MESSAGE_BATCH_ENTRY_HEADER_SIZE + (int32_t)message_size;
+                result = (int32_t)message_size;
+            }
+        }
+    }
+    return result;
+}
@@ -0,0 +1,551 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "message_ring.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <semaphore.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MESSAGE_RING_MAGIC 0xA16D5249 /*(A)zure (I)oT (M)essage (R)(I)ng*/
+#define RECORD_HEADER_SIZE 8
+#define RECORD_PADDING 0xFFFFFFFF
+#define ALIGN_RECORD(n) (((n) + 7) & ~(uint64_t)7)
+
+/*positions are published with sequentially consistent atomics so a side that is about to sleep either sees the other side's progress or gets woken up*/
+#define RING_ATOMIC_LOAD(p)         __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define RING_ATOMIC_STORE(p, v)     __atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+#define RING_ATOMIC_EXCHANGE(p, v)  __atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+
+typedef struct MESSAGE_RING_SHARED_TAG
+{
+    uint32_t magic;
+    uint32_t size;
+    uint64_t head;              /*bytes ever written, only advanced by the writer*/
+    uint64_t tail;              /*bytes ever read, only advanced by the reader*/
+    uint32_t reader_waiting;
+    uint32_t writer_waiting;
+    sem_t data_ready;
+    sem_t space_ready;
+    uint64_t data[1];           /*size bytes of records, each a length followed by a serialized message*/
+} MESSAGE_RING_SHARED;
+
+typedef struct MESSAGE_RING_TAG
+{
+    MESSAGE_RING_SHARED* shared;
+    size_t mapped_size;
+    char* owned_name;           /*only set in the process that created the segment*/
+    LOCK_HANDLE write_lock;
+    uint64_t write_position;    /*where the reserved record starts*/
+    uint64_t write_end;         /*head once the reserved record is published*/
+    int32_t write_size;
+    int32_t read_size;
+} MESSAGE_RING;
+
+static unsigned char* ring_data(MESSAGE_RING_SHARED* shared, uint64_t position)
+{
+    return (unsigned char*)shared->data + (position % shared->size);
+}
+
+static char* make_segment_name(const char* name)
+{
+    size_t length = strlen(name);
+    char* result = (char*)malloc(length + 2);
+    if (result == NULL)
+    {
+        LogError("unable to allocate the segment name");
+    }
+    else
+    {
+        result[0] = '/';
+        (void)memcpy(result + 1, name, length + 1);
+    }
+    return result;
+}
+
+static MESSAGE_RING* map_ring(int fd, size_t mapped_size)
+{
+    MESSAGE_RING* result = (MESSAGE_RING*)malloc(sizeof(MESSAGE_RING));
+    if (result == NULL)
+    {
+        LogError("unable to allocate the ring handle");
+    }
+    else
+    {
+        void* mapped = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED)
+        {
+            LogError("unable to map the ring, errno = %d", errno);
+            free(result);
+            result = NULL;
+        }
+        else if ((result->write_lock = Lock_Init()) == NULL)
+        {
+            LogError("unable to create the ring write lock");
+            (void)munmap(mapped, mapped_size);
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            result->shared = (MESSAGE_RING_SHARED*)mapped;
+            result->mapped_size = mapped_size;
+            result->owned_name = NULL;
+            result->write_size = -1;
+            result->read_size = -1;
+        }
+    }
+    return result;
+}
+
+/*waits until *position moves away from unchanged; returns non-zero if it did not within timeout_ms*/
+static int wait_for_progress(sem_t* doorbell, uint32_t* waiting, uint64_t* position, uint64_t unchanged, unsigned int timeout_ms)
+{
+    int result;
+    struct timespec deadline;
+    if (clock_gettime(CLOCK_REALTIME, &deadline) != 0)
+    {
+        LogError("unable to read the clock, errno = %d", errno);
+        result = __LINE__;
+    }
+    else
+    {
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+
+        for (;;)
+        {
+            /*announce the wait before the last look, the other side rings the doorbell only when it sees this*/
+            RING_ATOMIC_STORE(waiting, 1);
+            if (RING_ATOMIC_LOAD(position) != unchanged)
+            {
+                result = 0;
+                break;
+            }
+            else if (sem_timedwait(doorbell, &deadline) != 0 && errno != EINTR)
+            {
+                result = (RING_ATOMIC_LOAD(position) != unchanged) ? 0 : __LINE__;
+                break;
+            }
+            else
+            {
+                /*woken up, possibly by a doorbell left over from an earlier wait*/
+            }
+        }
+    }
+    return result;
+}
+
+static void ring_doorbell(sem_t* doorbell, uint32_t* waiting)
+{
+    if (RING_ATOMIC_EXCHANGE(waiting, 0) != 0)
+    {
+        (void)sem_post(doorbell);
+    }
+}
+
+MESSAGE_RING_HANDLE MessageRing_Create(const char* name, uint32_t size)
+{
+    MESSAGE_RING* result;
+    if (name == NULL)
+    {
+        /*Codes_SRS_MESSAGE_RING_17_001: [ If name is NULL, MessageRing_Create shall return NULL. ]*/
+        LogError("invalid arg name=%p", name);
+        result = NULL;
+    }
+    else if (ALIGN_RECORD((uint64_t)size) > UINT32_MAX)
+    {
+        /*Codes_SRS_MESSAGE_RING_17_027: [ If size rounded up to a multiple of 8 does not fit in 32 bits, MessageRing_Create shall return NULL. ]*/
+        LogError("invalid arg size=%u", (unsigned int)size);
+        result = NULL;
+    }
+    else
+    {
+        char* segment_name = make_segment_name(name);
+        if (segment_name == NULL)
+        {
+            result = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_RING_17_002: [ MessageRing_Create shall create a shared memory segment called '/' followed by name, replacing any segment of the same name, large enough for a ring header and size bytes rounded up to a multiple of 8, or MESSAGE_RING_DEFAULT_SIZE bytes if size is 0. ]*/
+            uint32_t data_size = (uint32_t)ALIGN_RECORD((size == 0) ? MESSAGE_RING_DEFAULT_SIZE : size);
+            size_t mapped_size = offsetof(MESSAGE_RING_SHARED, data) + data_size;
+            /*a segment left behind by a gateway that did not shut down cleanly is replaced*/
+            (void)shm_unlink(segment_name);
+            int fd = shm_open(segment_name, O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+            if (fd < 0)
+            {
+                LogError("unable to create shared memory segment %s, errno = %d", segment_name, errno);
+                free(segment_name);
+                result = NULL;
+            }
+            else
+            {
+                if (ftruncate(fd, (off_t)mapped_size) != 0)
+                {
+                    LogError("unable to size shared memory segment %s, errno = %d", segment_name, errno);
+                    result = NULL;
+                }
+                else if ((result = map_ring(fd, mapped_size)) == NULL)
+                {
+                    /*already logged*/
+                }
+                else
+                {
+                    MESSAGE_RING_SHARED* shared = result->shared;
+                    /*Codes_SRS_MESSAGE_RING_17_003: [ MessageRing_Create shall initialize two process shared semaphores in the segment, one to wake the reader and one to wake the writer. ]*/
+                    /*Codes_SRS_MESSAGE_RING_17_004: [ If any step fails, MessageRing_Create shall release everything it acquired, remove the segment and return NULL. ]*/
+                    if (sem_init(&shared->data_ready, 1, 0) != 0)
+                    {
+                        LogError("unable to create the data doorbell, errno = %d", errno);
+                        MessageRing_Destroy(result);
+                        result = NULL;
+                    }
+                    else if (sem_init(&shared->space_ready, 1, 0) != 0)
+                    {
+                        LogError("unable to create the space doorbell, errno = %d", errno);
+                        (void)sem_destroy(&shared->data_ready);
+                        MessageRing_Destroy(result);
+                        result = NULL;
+                    }
+                    else
+                    {
+                        shared->size = data_size;
+                        shared->head = 0;
+                        shared->tail = 0;
+                        shared->reader_waiting = 0;
+                        shared->writer_waiting = 0;
+                        /*the magic is written last, MessageRing_Open refuses a ring without it*/
+                        RING_ATOMIC_STORE(&shared->magic, MESSAGE_RING_MAGIC);
+                        result->owned_name = segment_name;
+                        segment_name = NULL;
+                    }
+                }
+                (void)close(fd);
+                if (segment_name != NULL)
+                {
+                    (void)shm_unlink(segment_name);
+                    free(segment_name);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+MESSAGE_RING_HANDLE MessageRing_Open(const char* name)
+{
+    MESSAGE_RING* result;
+    if (name == NULL)
+    {
+        /*Codes_SRS_MESSAGE_RING_17_005: [ If name is NULL, MessageRing_Open shall return NULL. ]*/
+        LogError("invalid arg name=%p", name);
+        result = NULL;
+    }
+    else
+    {
+        char* segment_name = make_segment_name(name);
+        if (segment_name == NULL)
+        {
+            result = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_RING_17_006: [ MessageRing_Open shall map the shared memory segment created by MessageRing_Create for name. ]*/
+            int fd = shm_open(segment_name, O_RDWR, 0);
+            if (fd < 0)
+            {
+                LogError("unable to open shared memory segment %s, errno = %d", segment_name, errno);
+                result = NULL;
+            }
+            else
+            {
+                struct stat segment;
+                if (fstat(fd, &segment) != 0 ||
+                    (size_t)segment.st_size <= offsetof(MESSAGE_RING_SHARED, data))
+                {
+                    LogError("shared memory segment %s is not a message ring", segment_name);
+                    result = NULL;
+                }
+                else if ((result = map_ring(fd, (size_t)segment.st_size)) == NULL)
+                {
+                    /*already logged*/
+                }
+                /*Codes_SRS_MESSAGE_RING_17_007: [ If the segment does not exist or does not hold a ring, MessageRing_Open shall return NULL. ]*/
+                else if (RING_ATOMIC_LOAD(&result->shared->magic) != MESSAGE_RING_MAGIC ||
+                    offsetof(MESSAGE_RING_SHARED, data) + result->shared->size != (size_t)segment.st_size)
+                {
+                    LogError("shared memory segment %s is not a message ring", segment_name);
+                    MessageRing_Destroy(result);
+                    result = NULL;
+                }
+                else
+                {
+                    /*mapped*/
+                }
+                (void)close(fd);
+            }
+            free(segment_name);
+        }
+    }
+    return result;
+}
+
+unsigned char* MessageRing_BeginWrite(MESSAGE_RING_HANDLE ring, int32_t size, unsigned int timeout_ms)
+{
+    unsigned char* result;
+    if (ring == NULL || size < 0)
+    {
+        /*Codes_SRS_MESSAGE_RING_17_008: [ If ring is NULL or size is negative, MessageRing_BeginWrite shall return NULL. ]*/
+        LogError("invalid args ring=%p, size=%d", ring, (int)size);
+        result = NULL;
+    }
+    else if (ALIGN_RECORD(RECORD_HEADER_SIZE + (uint64_t)size) > ring->shared->size)
+    {
+        /*Codes_SRS_MESSAGE_RING_17_009: [ If a record of size bytes can never fit in the ring, MessageRing_BeginWrite shall return NULL. ]*/
+        LogError("a message of %d bytes does not fit in a ring of %u bytes", (int)size, (unsigned int)ring->shared->size);
+        result = NULL;
+    }
+    /*Codes_SRS_MESSAGE_RING_17_010: [ MessageRing_BeginWrite shall lock the ring for writing, and return NULL if this fails. ]*/
+    else if (Lock(ring->write_lock) != LOCK_OK)
+    {
+        LogError("unable to lock the ring for writing");
+        result = NULL;
+    }
+    else
+    {
+        MESSAGE_RING_SHARED* shared = ring->shared;
+        uint64_t record_size = ALIGN_RECORD(RECORD_HEADER_SIZE + (uint64_t)size);
+        uint64_t head = shared->head;
+        uint64_t start = head;
+        uint64_t room_to_end = shared->size - (head % shared->size);
+        if (room_to_end < record_size)
+        {
+            /*Codes_SRS_MESSAGE_RING_17_011: [ If the record does not fit between the end of the ring's data and the end of the ring, MessageRing_BeginWrite shall place it at the start of the ring. ]*/
+            start += room_to_end;
+        }
+
+        result = NULL;
+        for (;;)
+        {
+            uint64_t tail = RING_ATOMIC_LOAD(&shared->tail);
+            if (start + record_size - tail <= shared->size)
+            {
+                /*Codes_SRS_MESSAGE_RING_17_013: [ MessageRing_BeginWrite shall return a pointer to size bytes following the record's header. ]*/
+                ring->write_position = start;
+                ring->write_end = start + record_size;
+                ring->write_size = size;
+                result = ring_data(shared, start) + RECORD_HEADER_SIZE;
+                break;
+            }
+            else if (timeout_ms == 0 ||
+                wait_for_progress(&shared->space_ready, &shared->writer_waiting, &shared->tail, tail, timeout_ms) != 0)
+            {
+                /*Codes_SRS_MESSAGE_RING_17_012: [ If there is not enough free space, MessageRing_BeginWrite shall wait up to timeout_ms milliseconds for the reader, and if there still is not, unlock the ring and return NULL. ]*/
+                LogError("message ring is full");
+                break;
+            }
+        }
+
+        if (result == NULL)
+        {
+            (void)Unlock(ring->write_lock);
+        }
+    }
+    return result;
+}
+
+void MessageRing_EndWrite(MESSAGE_RING_HANDLE ring)
+{
+    if (ring == NULL || ring->write_size < 0)
+    {
+        /*Codes_SRS_MESSAGE_RING_17_014: [ If ring is NULL or no write is in progress, MessageRing_EndWrite shall do nothing. ]*/
+        LogError("no write in progress on ring=%p", ring);
+    }
+    else
+    {
+        MESSAGE_RING_SHARED* shared = ring->shared;
+        /*Codes_SRS_MESSAGE_RING_17_015: [ MessageRing_EndWrite shall mark any bytes skipped at the end of the ring as padding, write the record's size, publish the record, wake the reader if it is waiting and unlock the ring. ]*/
+        if (ring->write_position != shared->head)
+        {
+            *(uint32_t*)ring_data(shared, shared->head) = RECORD_PADDING;
+        }
+        *(uint32_t*)ring_data(shared, ring->write_position) = (uint32_t)ring->write_size;
+        ring->write_size = -1;
+        RING_ATOMIC_STORE(&shared->head, ring->write_end);
+        ring_doorbell(&shared->data_ready, &shared->reader_waiting);
+        (void)Unlock(ring->write_lock);
+    }
+}
+
+int32_t MessageRing_BeginRead(MESSAGE_RING_HANDLE ring, const unsigned char** buffer, unsigned int timeout_ms)
+{
+    int32_t result;
+    if (ring == NULL || buffer == NULL)
+    {
+        /*Codes_SRS_MESSAGE_RING_17_016: [ If ring or buffer is NULL, MessageRing_BeginRead shall return a negative value. ]*/
+        LogError("invalid args ring=%p, buffer=%p", ring, buffer);
+        result = -1;
+    }
+    else
+    {
+        MESSAGE_RING_SHARED* shared = ring->shared;
+        result = 0;
+        for (;;)
+        {
+            uint64_t tail = shared->tail;
+            uint64_t head = RING_ATOMIC_LOAD(&shared->head);
+            if (head == tail)
+            {
+                /*Codes_SRS_MESSAGE_RING_17_017: [ If the ring is empty, MessageRing_BeginRead shall wait up to timeout_ms milliseconds for the writer, and return 0 if it stays empty. ]*/
+                if (timeout_ms == 0 ||
+                    wait_for_progress(&shared->data_ready, &shared->reader_waiting, &shared->head, head, timeout_ms) != 0)
+                {
+                    break;
+                }
+            }
+            else
+            {
+                uint32_t record = *(uint32_t*)ring_data(shared, tail);
+                uint64_t room_to_end = shared->size - (tail % shared->size);
+                if (record == RECORD_PADDING && room_to_end <= head - tail)
+                {
+                    /*Codes_SRS_MESSAGE_RING_17_018: [ MessageRing_BeginRead shall skip padding. ]*/
+                    RING_ATOMIC_STORE(&shared->tail, tail + room_to_end);
+                    ring_doorbell(&shared->space_ready, &shared->writer_waiting);
+                }
+                else if (record > (uint32_t)INT32_MAX ||
+                    ALIGN_RECORD(RECORD_HEADER_SIZE + (uint64_t)record) > head - tail)
+                {
+                    /*Codes_SRS_MESSAGE_RING_17_019: [ If a record is larger than the data published by the writer, MessageRing_BeginRead shall return a negative value. ]*/
+                    LogError("message ring is corrupted");
+                    result = -1;
+                    break;
+                }
+                else if (ALIGN_RECORD(RECORD_HEADER_SIZE + (uint64_t)record) > room_to_end)
+                {
+                    /*Codes_SRS_MESSAGE_RING_17_028: [ If a record runs past the end of the ring's data, MessageRing_BeginRead shall return a negative value. ]*/
+                    LogError("message ring is corrupted, record of %u bytes runs past the end of the ring", (unsigned int)record);
+                    result = -1;
+                    break;
+                }
+                else
+                {
+                    /*Codes_SRS_MESSAGE_RING_17_020: [ MessageRing_BeginRead shall set *buffer to the oldest message and return its size. ]*/
+                    *buffer = ring_data(shared, tail) + RECORD_HEADER_SIZE;
+                    ring->read_size = (int32_t)record;
+                    result = (int32_t)record;
+                    break;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+void MessageRing_EndRead(MESSAGE_RING_HANDLE ring)
+{
+    if (ring == NULL || ring->read_size < 0)
+    {
+        /*Codes_SRS_MESSAGE_RING_17_021: [ If ring is NULL or no read is in progress, MessageRing_EndRead shall do nothing. ]*/
+        LogError("no read in progress on ring=%p", ring);
+    }
+    else
+    {
+        MESSAGE_RING_SHARED* shared = ring->shared;
+        /*Codes_SRS_MESSAGE_RING_17_022: [ MessageRing_EndRead shall release the record and wake the writer if it is waiting. ]*/
+        RING_ATOMIC_STORE(&shared->tail, shared->tail + ALIGN_RECORD(RECORD_HEADER_SIZE + (uint64_t)ring->read_size));
+        ring->read_size = -1;
+        ring_doorbell(&shared->space_ready, &shared->writer_waiting);
+    }
+}
+
+void MessageRing_Destroy(MESSAGE_RING_HANDLE ring)
+{
+    /*Codes_SRS_MESSAGE_RING_17_023: [ If ring is NULL, MessageRing_Destroy shall do nothing. ]*/
+    if (ring != NULL)
+    {
+        /*Codes_SRS_MESSAGE_RING_17_024: [ If the ring was created by MessageRing_Create, MessageRing_Destroy shall destroy its semaphores and remove its segment. ]*/
+        if (ring->owned_name != NULL)
+        {
+            (void)sem_destroy(&ring->shared->data_ready);
+            (void)sem_destroy(&ring->shared->space_ready);
+            (void)shm_unlink(ring->owned_name);
+            free(ring->owned_name);
+        }
+        /*Codes_SRS_MESSAGE_RING_17_025: [ MessageRing_Destroy shall unmap the ring and free its handle. ]*/
+        (void)munmap(ring->shared, ring->mapped_size);
+        Lock_Deinit(ring->write_lock);
+        free(ring);
+    }
+}
+
+#else /*shared memory rings need POSIX shared memory and process shared semaphores*/
+
+MESSAGE_RING_HANDLE MessageRing_Create(const char* name, uint32_t size)
+{
+    (void)name;
+    (void)size;
+    /*Codes_SRS_MESSAGE_RING_17_026: [ On platforms without POSIX shared memory, MessageRing_Create and MessageRing_Open shall return NULL. ]*/
+    LogError("shared memory message rings are not supported on this platform");
+    return NULL;
+}
+
+MESSAGE_RING_HANDLE MessageRing_Open(const char* name)
+{
+    (void)name;
+    LogError("shared memory message rings are not supported on this platform");
+    return NULL;
+}
+
+unsigned char* MessageRing_BeginWrite(MESSAGE_RING_HANDLE ring, int32_t size, unsigned int timeout_ms)
+{
+    (void)ring;
+    (void)size;
+    (void)timeout_ms;
+    return NULL;
+}
+
+void MessageRing_EndWrite(MESSAGE_RING_HANDLE ring)
+{
+    (void)ring;
+}
+
+int32_t MessageRing_BeginRead(MESSAGE_RING_HANDLE ring, const unsigned char** buffer, unsigned int timeout_ms)
+{
+    (void)ring;
+    (void)buffer;
+    (void)timeout_ms;
+    return -1;
+}
+
+void MessageRing_EndRead(MESSAGE_RING_HANDLE ring)
+{
+    (void)ring;
+}
+
+void MessageRing_Destroy(MESSAGE_RING_HANDLE ring)
+{
+    (void)ring;
+}
+
+#endif
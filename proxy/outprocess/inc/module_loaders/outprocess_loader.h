@@ -33,6 +33,15 @@ extern "C"
  */
 DEFINE_ENUM(OUTPROCESS_LOADER_ACTIVATION_TYPE, OUTPROCESS_LOADER_ACTIVATION_TYPE_VALUES);
 
+#define OUTPROCESS_LOADER_TRANSPORT_VALUES \
+    OUTPROCESS_LOADER_TRANSPORT_IPC, \
+    OUTPROCESS_LOADER_TRANSPORT_SHM
+
+/**
+ * @brief Enumeration listing the ways messages may travel to the module host
+ */
+DEFINE_ENUM(OUTPROCESS_LOADER_TRANSPORT, OUTPROCESS_LOADER_TRANSPORT_VALUES);
+
 /** @brief Structure to load an out of process proxy module */
 typedef struct OUTPROCESS_LOADER_ENTRYPOINT_TAG
 {
@@ -47,6 +56,20 @@ typedef struct OUTPROCESS_LOADER_ENTRYPOINT_TAG
     STRING_HANDLE message_id;
 	/** @brief controls timeout for ipc retries. */
 	unsigned int remote_message_wait;
+	/** @brief Carries the message channel over nanomsg ipc or shared memory rings. */
+	OUTPROCESS_LOADER_TRANSPORT transport;
+	/** @brief Most messages packed into one frame on an ipc message channel, 0 or 1 to send them one at a time. */
+	unsigned int batch_max_count;
+	/** @brief Most serialized bytes packed into one frame, 0 for no limit. */
+	unsigned int batch_max_bytes;
+	/** @brief How long, in microseconds, a partly filled frame may wait for more messages. */
+	unsigned int batch_max_linger;
+	/** @brief Most messages waiting to be sent to the module host, 0 for no limit. */
+	unsigned int queue_capacity;
+	/** @brief What to do with a new message when the queue holds queue_capacity messages. */
+	BROKER_QUEUE_POLICY queue_policy;
+	/** @brief Bytes reserved for messages in each message ring of the "shm" transport, 0 for MESSAGE_RING_DEFAULT_SIZE. */
+	unsigned int ring_size;
 } OUTPROCESS_LOADER_ENTRYPOINT;
 
 /** @brief      The API for the out of process proxy module loader. */
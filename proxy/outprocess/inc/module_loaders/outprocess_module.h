@@ -35,6 +35,18 @@ typedef struct OUTPROCESS_MODULE_CONFIG_DATA
     STRING_HANDLE outprocess_module_args;
 	/** @brief controls timeout for ipc retries. */
 	unsigned int remote_message_wait;
+	/** @brief Most messages packed into one frame on an ipc message channel, 0 or 1 to send them one at a time. */
+	unsigned int batch_max_count;
+	/** @brief Most serialized bytes packed into one frame, 0 for no limit. */
+	unsigned int batch_max_bytes;
+	/** @brief How long, in microseconds, a partly filled frame may wait for more messages. */
+	unsigned int batch_max_linger;
+	/** @brief Most messages waiting to be sent to the module host, 0 for no limit. */
+	unsigned int queue_capacity;
+	/** @brief What to do with a new message when the queue holds queue_capacity messages. */
+	BROKER_QUEUE_POLICY queue_policy;
+	/** @brief Bytes reserved for messages in each message ring of a "shm://" message channel, 0 for MESSAGE_RING_DEFAULT_SIZE. */
+	unsigned int ring_size;
 } OUTPROCESS_MODULE_CONFIG;
 
 /** @brief the API fr this module */
@@ -12,6 +12,7 @@
 #include "module_loader.h"
 #include "module_loaders/outprocess_loader.h"
 #include "module_loaders/outprocess_module.h"
+#include "message_ring.h"
 
 DEFINE_ENUM_STRINGS(OUTPROCESS_LOADER_ACTIVATION_TYPE, OUTPROCESS_LOADER_ACTIVATION_TYPE_VALUES);
 
@@ -22,11 +23,62 @@ DEFINE_ENUM_STRINGS(OUTPROCESS_LOADER_ACTIVATION_TYPE, OUTPROCESS_LOADER_ACTIVAT
 
 #define REMOTE_MESSAGE_WAIT_DEFAULT 1000;
 
+/* largest batching settings accepted, anything above falls back to the default of 0 */
+#define BATCH_COUNT_MAX 1024
+#define BATCH_BYTES_MAX INT32_MAX
+#define BATCH_LINGER_MAX 1000000
+
+/* largest outgoing queue accepted, anything above falls back to the default of 0, an unbounded queue */
+#define QUEUE_CAPACITY_MAX INT32_MAX
+#define RING_SIZE_MAX INT32_MAX
+
 typedef struct OUTPROCESS_MODULE_HANDLE_DATA_TAG
 {
 	const MODULE_API* api;
 } OUTPROCESS_MODULE_HANDLE_DATA;
 
+static unsigned int get_numeric_setting(const JSON_Object* entrypoint, const char* name, double max_value)
+{
+	unsigned int result;
+	double value = json_object_get_number(entrypoint, name);
+	if (value < 0 || value > max_value)
+	{
+		/*Codes_SRS_OUTPROCESS_LOADER_17_050: [ This function shall assign batch_max_count, batch_max_bytes and batch_max_linger to these values, or to 0 if a value is missing, negative or above its limit. ]*/
+		/*Codes_SRS_OUTPROCESS_LOADER_17_053: [ This function shall assign queue_capacity to "queue.capacity", or to 0 if it is missing, negative or above INT32_MAX. ]*/
+		/*Codes_SRS_OUTPROCESS_LOADER_17_057: [ This function shall assign ring_size to the "ring.size" value, or to 0 if it is missing, negative or above INT32_MAX. ]*/
+		LogError("Ignoring \"%s\" value %f, expected 0 to %.0f", name, value, max_value);
+		result = 0;
+	}
+	else
+	{
+		result = (unsigned int)value;
+	}
+	return result;
+}
+
+static int get_queue_policy(const char* policy, BROKER_QUEUE_POLICY* queue_policy)
+{
+	int result = 0;
+	/*Codes_SRS_OUTPROCESS_LOADER_17_054: [ This function shall assign queue_policy to BROKER_QUEUE_POLICY_DROP_OLDEST, BROKER_QUEUE_POLICY_DROP_NEWEST or BROKER_QUEUE_POLICY_BLOCK when "queue.policy" is "drop_oldest", "drop_newest" or "block", and to BROKER_QUEUE_POLICY_DROP_OLDEST when it is missing. ]*/
+	if (policy == NULL || strcmp(policy, "drop_oldest") == 0)
+	{
+		*queue_policy = BROKER_QUEUE_POLICY_DROP_OLDEST;
+	}
+	else if (strcmp(policy, "drop_newest") == 0)
+	{
+		*queue_policy = BROKER_QUEUE_POLICY_DROP_NEWEST;
+	}
+	else if (strcmp(policy, "block") == 0)
+	{
+		*queue_policy = BROKER_QUEUE_POLICY_BLOCK;
+	}
+	else
+	{
+		result = __LINE__;
+	}
+	return result;
+}
+
 static MODULE_LIBRARY_HANDLE OutprocessModuleLoader_Load(const MODULE_LOADER* loader, const void* entrypoint)
 {
 	OUTPROCESS_MODULE_HANDLE_DATA * result;
@@ -128,6 +180,13 @@ static void* OutprocessModuleLoader_ParseEntrypointFromJson(const struct MODULE_
 	//		"control.id" : "outproc_module_control", 
 	//		"message.id" : "outproc_module_message", (optional)
 	//		"timeout" : numeric, (optional, default 250 ms)
+	//		"transport" : "ipc" | "shm", (optional, default "ipc")
+	//		"batch.count" : numeric, (optional, 0 to 1024, default 0, messages are sent one at a time)
+	//		"batch.bytes" : numeric, (optional, 0 to INT32_MAX, default 0, no limit)
+	//		"batch.linger" : numeric, (optional, 0 to 1000000 us, default 0 us)
+	//		"queue.capacity" : numeric, (optional, 0 to INT32_MAX, default 0, no limit)
+	//		"queue.policy" : "drop_oldest" | "drop_newest" | "block", (optional, default "drop_oldest")
+	//		"ring.size" : numeric, (optional, 0 to INT32_MAX bytes, default 0, MESSAGE_RING_DEFAULT_SIZE)
 	//		}
 	//  }
 	OUTPROCESS_LOADER_ENTRYPOINT * config;
@@ -192,22 +251,54 @@ static void* OutprocessModuleLoader_ParseEntrypointFromJson(const struct MODULE_
 						{
 							config->remote_message_wait = (unsigned int)timeout;
 						}
-						/*Codes_SRS_OUTPROCESS_LOADER_17_017: [ This function shall assign the entrypoint activation_type to NONE. ] */
-						config->activation_type = OUTPROCESS_LOADER_ACTIVATION_NONE;
-						/*Codes_SRS_OUTPROCESS_LOADER_17_018: [ This function shall assign the entrypoint control_id to the string value of "control.id" in json, NULL if not present. ] */
-						config->control_id = STRING_construct(controlId);
-						if (config->control_id == NULL)
+						/*Codes_SRS_OUTPROCESS_LOADER_17_049: [ This function shall read the "batch.count", "batch.bytes" and "batch.linger" values. ]*/
+						/*Codes_SRS_OUTPROCESS_LOADER_17_050: [ This function shall assign batch_max_count, batch_max_bytes and batch_max_linger to these values, or to 0 if a value is missing, negative or above its limit. ]*/
+						config->batch_max_count = get_numeric_setting(entrypoint, "batch.count", BATCH_COUNT_MAX);
+						config->batch_max_bytes = get_numeric_setting(entrypoint, "batch.bytes", BATCH_BYTES_MAX);
+						config->batch_max_linger = get_numeric_setting(entrypoint, "batch.linger", BATCH_LINGER_MAX);
+						/*Codes_SRS_OUTPROCESS_LOADER_17_052: [ This function shall read the "queue.capacity" and "queue.policy" values. ]*/
+						config->queue_capacity = get_numeric_setting(entrypoint, "queue.capacity", QUEUE_CAPACITY_MAX);
+						const char* queuePolicy = json_object_get_string(entrypoint, "queue.policy");
+						config->ring_size = get_numeric_setting(entrypoint, "ring.size", RING_SIZE_MAX);
+						/*Codes_SRS_OUTPROCESS_LOADER_17_045: [ This function shall read the "transport" value. ]*/
+						const char* transport = json_object_get_string(entrypoint, "transport");
+						if (transport != NULL && strcmp(transport, "ipc") != 0 && strcmp(transport, "shm") != 0)
+						{
+							/*Codes_SRS_OUTPROCESS_LOADER_17_047: [ This function shall return NULL if "transport" is neither "ipc" nor "shm". ]*/
+							LogError("Invalid JSON parameters, transport=[%s]", transport);
+							free(config);
+							config = NULL;
+						}
+						else if (get_queue_policy(queuePolicy, &config->queue_policy) != 0)
 						{
-							/*Codes_SRS_OUTPROCESS_LOADER_17_021: [ This function shall return NULL if any calls fails. ] */
-							LogError("Could not allocate loader args string");
+							/*Codes_SRS_OUTPROCESS_LOADER_17_055: [ This function shall return NULL if "queue.policy" has any other value. ]*/
+							LogError("Invalid JSON parameters, queue.policy=[%s]", queuePolicy);
 							free(config);
 							config = NULL;
 						}
 						else
 						{
-							/*Codes_SRS_OUTPROCESS_LOADER_17_019: [ This function shall assign the entrypoint message_id to the string value of "message.id" in json, NULL if not present. ] */
-							config->message_id = STRING_construct(messageId);
-							/*Codes_SRS_OUTPROCESS_LOADER_17_022: [ This function shall return a valid pointer to an OUTPROCESS_LOADER_ENTRYPOINT on success. ]*/
+							/*Codes_SRS_OUTPROCESS_LOADER_17_046: [ This function shall assign the entrypoint transport to OUTPROCESS_LOADER_TRANSPORT_SHM if "transport" is "shm", and to OUTPROCESS_LOADER_TRANSPORT_IPC otherwise. ]*/
+							config->transport = (transport != NULL && strcmp(transport, "shm") == 0) ?
+								OUTPROCESS_LOADER_TRANSPORT_SHM :
+								OUTPROCESS_LOADER_TRANSPORT_IPC;
+							/*Codes_SRS_OUTPROCESS_LOADER_17_017: [ This function shall assign the entrypoint activation_type to NONE. ] */
+							config->activation_type = OUTPROCESS_LOADER_ACTIVATION_NONE;
+							/*Codes_SRS_OUTPROCESS_LOADER_17_018: [ This function shall assign the entrypoint control_id to the string value of "control.id" in json, NULL if not present. ] */
+							config->control_id = STRING_construct(controlId);
+							if (config->control_id == NULL)
+							{
+								/*Codes_SRS_OUTPROCESS_LOADER_17_021: [ This function shall return NULL if any calls fails. ] */
+								LogError("Could not allocate loader args string");
+								free(config);
+								config = NULL;
+							}
+							else
+							{
+								/*Codes_SRS_OUTPROCESS_LOADER_17_019: [ This function shall assign the entrypoint message_id to the string value of "message.id" in json, NULL if not present. ] */
+								config->message_id = STRING_construct(messageId);
+								/*Codes_SRS_OUTPROCESS_LOADER_17_022: [ This function shall return a valid pointer to an OUTPROCESS_LOADER_ENTRYPOINT on success. ]*/
+							}
 						}
 					}
 				}
@@ -278,6 +369,8 @@ static void* OutprocessModuleLoader_BuildModuleConfiguration(
 		else
 		{
 			OUTPROCESS_LOADER_ENTRYPOINT* ep = (OUTPROCESS_LOADER_ENTRYPOINT*)entrypoint;
+			/*Codes_SRS_OUTPROCESS_LOADER_17_048: [ If the entrypoint's transport is OUTPROCESS_LOADER_TRANSPORT_SHM, the message uri shall start with "shm://" instead of "ipc://". ]*/
+			const char* message_uri_head = (ep->transport == OUTPROCESS_LOADER_TRANSPORT_SHM) ? MESSAGE_RING_URI_HEAD : IPC_URI_HEAD;
 			char uuid[LOADER_GUID_SIZE];
 			UNIQUEID_RESULT uuid_result = UNIQUEID_OK;
 			if (ep->message_id == NULL)
@@ -294,13 +387,13 @@ static void* OutprocessModuleLoader_BuildModuleConfiguration(
 				else
 				{
 					/*Codes_SRS_OUTPROCESS_LOADER_17_032: [ The message uri shall be composed of "ipc://" + unique id . ]*/
-					fullModuleConfiguration->message_uri = STRING_construct_sprintf("%s%s", IPC_URI_HEAD, uuid);
+					fullModuleConfiguration->message_uri = STRING_construct_sprintf("%s%s", message_uri_head, uuid);
 				}
 			}
 			else
 			{
 				/*Codes_SRS_OUTPROCESS_LOADER_17_033: [ This function shall allocate and copy each string in OUTPROCESS_LOADER_ENTRYPOINT and assign them to the corresponding fields in OUTPROCESS_MODULE_CONFIG. ]*/
-				fullModuleConfiguration->message_uri = STRING_construct_sprintf("%s%s", IPC_URI_HEAD, STRING_c_str(ep->message_id));
+				fullModuleConfiguration->message_uri = STRING_construct_sprintf("%s%s", message_uri_head, STRING_c_str(ep->message_id));
 			}
 			if (fullModuleConfiguration->message_uri == NULL)
 			{
@@ -340,6 +433,14 @@ static void* OutprocessModuleLoader_BuildModuleConfiguration(
 					{
 						/*Codes_SRS_OUTPROCESS_LOADER_17_035: [ Upon success, this function shall return a valid pointer to an OUTPROCESS_MODULE_CONFIG structure. ]*/
 						fullModuleConfiguration->remote_message_wait = ep->remote_message_wait;
+						/*Codes_SRS_OUTPROCESS_LOADER_17_051: [ This function shall copy the entrypoint's batch_max_count, batch_max_bytes and batch_max_linger into the module configuration. ]*/
+						fullModuleConfiguration->batch_max_count = ep->batch_max_count;
+						fullModuleConfiguration->batch_max_bytes = ep->batch_max_bytes;
+						fullModuleConfiguration->batch_max_linger = ep->batch_max_linger;
+						/*Codes_SRS_OUTPROCESS_LOADER_17_056: [ This function shall copy the entrypoint's queue_capacity, queue_policy and ring_size into the module configuration. ]*/
+						fullModuleConfiguration->queue_capacity = ep->queue_capacity;
+						fullModuleConfiguration->queue_policy = ep->queue_policy;
+						fullModuleConfiguration->ring_size = ep->ring_size;
 						fullModuleConfiguration->lifecycle_model = OUTPROCESS_LIFECYCLE_SYNC;
 					}
 				}
@@ -2,6 +2,7 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 #include <nanomsg/nn.h>
 #include <nanomsg/pair.h>
@@ -11,12 +12,15 @@
 #include "message.h"
 #include "message_queue.h"
 #include "control_message.h"
+#include "message_batch.h"
+#include "message_ring.h"
 #include "module_loaders/outprocess_module.h"
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 
 typedef struct THREAD_CONTROL_TAG
 {
@@ -27,18 +31,34 @@ typedef struct THREAD_CONTROL_TAG
 
 #define THREAD_FLAG_STOP 1
 
+/* how long the incoming thread waits on a message ring before checking whether it should stop */
+#define MESSAGE_RING_RECEIVE_WAIT 100
+
+/* how long a receive blocked on a full outgoing queue waits before checking whether the module is stopping */
+#define OUTGOING_QUEUE_BLOCK_WAIT 100
+
 typedef struct OUTPROCESS_HANDLE_DATA_TAG
 {
 	LOCK_HANDLE handle_lock;
 	int message_socket;
 	int control_socket;
+	MESSAGE_RING_HANDLE outgoing_ring;
+	MESSAGE_RING_HANDLE incoming_ring;
 	MESSAGE_QUEUE_HANDLE outgoing_messages;
+	COND_HANDLE outgoing_messages_cond;
 	STRING_HANDLE control_uri;
 	STRING_HANDLE message_uri;
 	STRING_HANDLE module_args;
 	OUTPROCESS_MODULE_LIFECYCLE lifecyle_model;
 	BROKER_HANDLE broker;
 	unsigned int remote_message_wait;
+	unsigned int batch_max_count;
+	unsigned int batch_max_bytes;
+	unsigned int batch_max_linger;
+	unsigned int queue_capacity;
+	BROKER_QUEUE_POLICY queue_policy;
+	size_t dropped_messages;
+	uint32_t ring_size;
 
 	THREAD_CONTROL message_receive_thread;
 	THREAD_CONTROL message_send_thread;
@@ -46,10 +66,41 @@ typedef struct OUTPROCESS_HANDLE_DATA_TAG
 	THREAD_CONTROL control_thread;
 } OUTPROCESS_HANDLE_DATA;
 
+typedef struct OUTGOING_BATCH_ENTRY_TAG
+{
+	MESSAGE_HANDLE message;
+	const unsigned char* bytes; /* serialized message, kept by the message */
+	int32_t size;
+} OUTGOING_BATCH_ENTRY;
+
 // forward definitions
 static void* construct_create_message(OUTPROCESS_HANDLE_DATA* handleData, int32_t * creationMessageSize);
 static void send_start_message(OUTPROCESS_HANDLE_DATA* handleData);
 
+/*
+ * The proxy gateways publish one message per frame, batches only come from
+ * module hosts that build them.
+ */
+static void publish_message_batch(OUTPROCESS_HANDLE_DATA* handleData, const unsigned char* batch, int32_t batch_size)
+{
+	int32_t position = 0;
+	const unsigned char* message;
+	int32_t message_size;
+	while ((message_size = MessageBatch_GetNext(batch, batch_size, &position, &message)) > 0)
+	{
+		MESSAGE_HANDLE msg = Message_CreateFromByteArray(message, message_size);
+		if (msg != NULL)
+		{
+			Broker_Publish(handleData->broker, (MODULE_HANDLE)handleData, msg);
+			Message_Destroy(msg);
+		}
+	}
+	if (message_size < 0)
+	{
+		LogError("dropping a malformed message batch");
+	}
+}
+
 
 int outprocessIncomingMessageThread(void *param)
 {
@@ -73,6 +124,7 @@ int outprocessIncomingMessageThread(void *param)
 				break;
 			}
 			int nn_fd = handleData->message_socket;
+			MESSAGE_RING_HANDLE incoming_ring = handleData->incoming_ring;
 			if (Unlock(handleData->handle_lock) != LOCK_OK)
 			{
 				should_continue = 0;
@@ -101,33 +153,78 @@ int outprocessIncomingMessageThread(void *param)
 			int nbytes;
 			unsigned char *buf = NULL;
 			errno = 0;
-			/*Codes_SRS_OUTPROCESS_MODULE_17_038: [ This function shall read from the message channel for gateway messages from the module host. ]*/
-			nbytes = nn_recv(nn_fd, (void *)&buf, NN_MSG, 0);
-			if (nbytes < 0)
+			if (incoming_ring != NULL)
 			{
-				int receive_error = nn_errno();
-				if (receive_error != ETIMEDOUT)
+				const unsigned char* ring_bytes = NULL;
+				/*Codes_SRS_OUTPROCESS_MODULE_17_066: [ If the message channel is a pair of message rings, this function shall wait on the incoming ring for gateway messages from the module host. ]*/
+				nbytes = MessageRing_BeginRead(incoming_ring, &ring_bytes, MESSAGE_RING_RECEIVE_WAIT);
+				if (nbytes < 0)
+				{
+					LogError("unable to read from the incoming message ring");
 					should_continue = 0;
+				}
+				else if (nbytes > 0)
+				{
+					/*Codes_SRS_OUTPROCESS_MODULE_17_067: [ This function shall deserialize the gateway message directly from the incoming ring, publish it to the broker and then release it from the ring. ]*/
+					MESSAGE_HANDLE msg = Message_CreateFromByteArray(ring_bytes, nbytes);
+					if (msg != NULL)
+					{
+						Broker_Publish(handleData->broker, (MODULE_HANDLE)handleData, msg);
+						Message_Destroy(msg);
+					}
+					MessageRing_EndRead(incoming_ring);
+				}
+				else
+				{
+					/*nothing arrived, check for stop and wait again*/
+				}
 			}
 			else
 			{
-				/*Codes_SRS_OUTPROCESS_MODULE_17_039: [ Upon successful receiving a gateway message, this function shall deserialize the message. ]*/
-				const unsigned char*buf_bytes = (const unsigned char*)buf;
-				MESSAGE_HANDLE msg = Message_CreateFromByteArray(buf_bytes, nbytes);
-				if (msg != NULL)
+				/*Codes_SRS_OUTPROCESS_MODULE_17_038: [ This function shall read from the message channel for gateway messages from the module host. ]*/
+				nbytes = nn_recv(nn_fd, (void *)&buf, NN_MSG, 0);
+				if (nbytes < 0)
 				{
-					/*Codes_SRS_OUTPROCESS_MODULE_17_040: [ This function shall publish any successfully created gateway message to the broker. ]*/
-					Broker_Publish(handleData->broker, (MODULE_HANDLE)handleData, msg);
-					Message_Destroy(msg);
+					int receive_error = nn_errno();
+					if (receive_error != ETIMEDOUT)
+						should_continue = 0;
+				}
+				else if (MessageBatch_IsBatch((const unsigned char*)buf, nbytes))
+				{
+					/*Codes_SRS_OUTPROCESS_MODULE_17_077: [ If the received frame is a message batch, this function shall deserialize and publish each message in the batch, in order. ]*/
+					publish_message_batch(handleData, (const unsigned char*)buf, nbytes);
+					nn_freemsg(buf);
+				}
+				else
+				{
+					/*Codes_SRS_OUTPROCESS_MODULE_17_039: [ Upon successful receiving a gateway message, this function shall deserialize the message. ]*/
+					const unsigned char*buf_bytes = (const unsigned char*)buf;
+					MESSAGE_HANDLE msg = Message_CreateFromByteArray(buf_bytes, nbytes);
+					if (msg != NULL)
+					{
+						/*Codes_SRS_OUTPROCESS_MODULE_17_040: [ This function shall publish any successfully created gateway message to the broker. ]*/
+						Broker_Publish(handleData->broker, (MODULE_HANDLE)handleData, msg);
+						Message_Destroy(msg);
+					}
+					nn_freemsg(buf);
 				}
-				nn_freemsg(buf);
 			}
-			ThreadAPI_Sleep(1);
+			/*Codes_SRS_OUTPROCESS_MODULE_17_065: [ This function shall not wait between messages; it shall only block on the message channel. ]*/
 		}
 	}
 	return 0;
 }
 
+/* wakes a receive waiting for room in a full outgoing queue, handle_lock must be held */
+static void signal_room_in_outgoing_queue(OUTPROCESS_HANDLE_DATA* handleData)
+{
+	if ((handleData->queue_capacity != 0) && (handleData->queue_policy == BROKER_QUEUE_POLICY_BLOCK))
+	{
+		/*Codes_SRS_OUTPROCESS_MODULE_17_084: [ If queue_capacity is not 0 and queue_policy is BROKER_QUEUE_POLICY_BLOCK, the outgoing thread shall signal the outgoing message condition after removing a message from the queue. ]*/
+		(void)Condition_Post(handleData->outgoing_messages_cond);
+	}
+}
+
 static int outprocessOutgoingMessagesThread(void * param)
 {
 	OUTPROCESS_HANDLE_DATA * handleData = (OUTPROCESS_HANDLE_DATA*)param;
@@ -171,6 +268,18 @@ static int outprocessOutgoingMessagesThread(void * param)
 			if (MESSAGE_QUEUE_is_empty(handleData->outgoing_messages))
 			{
 				messageHandle = NULL;
+				/* Outprocess_Destroy signals the condition under handle_lock after setting the stop flag */
+				if (handleData->message_send_thread.thread_flag != THREAD_FLAG_STOP)
+				{
+					/*Codes_SRS_OUTPROCESS_MODULE_17_063: [ If the outgoing gateway message queue is empty, this function shall wait on the outgoing message condition until a message is queued or the thread is asked to stop. ]*/
+					if (Condition_Wait(handleData->outgoing_messages_cond, handleData->handle_lock, 0) != COND_OK)
+					{
+						LogError("unable to wait for outgoing messages");
+						(void)Unlock(handleData->handle_lock);
+						should_continue = 0;
+						break;
+					}
+				}
 			}
 			else
 			{
@@ -183,6 +292,7 @@ static int outprocessOutgoingMessagesThread(void * param)
 					should_continue = 0;
 					break;
 				}
+				signal_room_in_outgoing_queue(handleData);
 			}
 			if (Unlock(handleData->handle_lock) != LOCK_OK)
 			{
@@ -194,11 +304,32 @@ static int outprocessOutgoingMessagesThread(void * param)
 			if (messageHandle != NULL)
 			{
 				/*Codes_SRS_OUTPROCESS_MODULE_17_023: [ This function shall serialize the message for transmission on the message channel. ]*/
-				int32_t msg_size = Message_ToByteArray(messageHandle, NULL, 0);
+				/*Codes_SRS_OUTPROCESS_MODULE_17_078: [ The message shall be serialized with Message_GetSerialized, so that a message sent to several remote modules is serialized once. ]*/
+				const CONSTBUFFER* serialized = Message_GetSerialized(messageHandle);
+				int32_t msg_size = (serialized == NULL) ? -1 : (int32_t)serialized->size;
 				if (msg_size < 0)
 				{
 					LogError("unable to serialize outgoing message [%p]", messageHandle);
 				}
+				else if ((handleData->outgoing_ring != NULL) && ((uint32_t)msg_size > handleData->ring_size))
+				{
+					/*Codes_SRS_OUTPROCESS_MODULE_17_086: [ If the message channel is a pair of message rings and the serialized message is larger than the ring, this function shall log an error and drop the message without waiting for room. ]*/
+					LogError("outgoing message [%p] of %d bytes can never fit in a message ring of %u bytes, raise \"ring.size\"", messageHandle, (int)msg_size, (unsigned int)handleData->ring_size);
+				}
+				else if (handleData->outgoing_ring != NULL)
+				{
+					/*Codes_SRS_OUTPROCESS_MODULE_17_068: [ If the message channel is a pair of message rings, this function shall serialize the message directly into the outgoing ring, waiting at most remote_message_wait milliseconds for room. ]*/
+					unsigned char* ring_bytes = MessageRing_BeginWrite(handleData->outgoing_ring, msg_size, handleData->remote_message_wait);
+					if (ring_bytes == NULL)
+					{
+						LogError("unable to write outgoing message [%p] to the message ring", messageHandle);
+					}
+					else
+					{
+						memcpy(ring_bytes, serialized->buffer, msg_size);
+						MessageRing_EndWrite(handleData->outgoing_ring);
+					}
+				}
 				else
 				{
 					void* result = nn_allocmsg(msg_size, 0);
@@ -209,7 +340,7 @@ static int outprocessOutgoingMessagesThread(void * param)
 					else
 					{
 						unsigned char *nn_msg_bytes = (unsigned char *)result;
-						Message_ToByteArray(messageHandle, nn_msg_bytes, msg_size);
+						memcpy(nn_msg_bytes, serialized->buffer, msg_size);
 						/*Codes_SRS_OUTPROCESS_MODULE_17_024: [ This function shall send the message on the message channel. ]*/
 						int nbytes = nn_send(handleData->message_socket, &result, NN_MSG, 0);
 						if (nbytes != msg_size)
@@ -224,12 +355,212 @@ static int outprocessOutgoingMessagesThread(void * param)
 				/*Codes_SRS_OUTPROCESS_MODULE_17_055: [ This function shall Destroy the message once successfully transmitted. ]*/
 				Message_Destroy(messageHandle);
 			}
-			ThreadAPI_Sleep(1);
 		}
 	}
 	return 0;
 }
 
+static size_t take_outgoing_messages(OUTPROCESS_HANDLE_DATA* handleData, OUTGOING_BATCH_ENTRY* entries, size_t count)
+{
+	/*Codes_SRS_OUTPROCESS_MODULE_17_072: [ The batching thread shall remove up to batch_max_count of the oldest messages from the outgoing gateway message queue. ]*/
+	while ((count < handleData->batch_max_count) && !MESSAGE_QUEUE_is_empty(handleData->outgoing_messages))
+	{
+		MESSAGE_HANDLE messageHandle = MESSAGE_QUEUE_pop(handleData->outgoing_messages);
+		if (messageHandle == NULL)
+		{
+			LogError("bad condition: message handle in queue is NULL");
+			break;
+		}
+		entries[count].message = messageHandle;
+		entries[count].bytes = NULL;
+		entries[count].size = 0;
+		count++;
+		signal_room_in_outgoing_queue(handleData);
+	}
+	return count;
+}
+
+static void send_outgoing_frame(OUTPROCESS_HANDLE_DATA* handleData, OUTGOING_BATCH_ENTRY* entries, size_t count, int32_t frame_size)
+{
+	void* result = nn_allocmsg(frame_size, 0);
+	if (result == NULL)
+	{
+		LogError("unable to allocate buffer for [%lu] outgoing messages", (unsigned long)count);
+	}
+	else
+	{
+		unsigned char *nn_msg_bytes = (unsigned char *)result;
+		if (count == 1)
+		{
+			/*Codes_SRS_OUTPROCESS_MODULE_17_075: [ A frame holding a single message shall carry the serialized message alone. ]*/
+			memcpy(nn_msg_bytes, entries[0].bytes, entries[0].size);
+		}
+		else
+		{
+			/*Codes_SRS_OUTPROCESS_MODULE_17_076: [ A frame holding several messages shall be a message batch with the serialized messages in the order they were queued. ]*/
+			int32_t position = MessageBatch_WriteHeader(nn_msg_bytes, (uint32_t)count);
+			size_t i;
+			for (i = 0; i < count; i++)
+			{
+				position += MessageBatch_WriteEntryHeader(nn_msg_bytes + position, entries[i].size);
+				memcpy(nn_msg_bytes + position, entries[i].bytes, entries[i].size);
+				position += entries[i].size;
+			}
+		}
+		/*Codes_SRS_OUTPROCESS_MODULE_17_024: [ This function shall send the message on the message channel. ]*/
+		int nbytes = nn_send(handleData->message_socket, &result, NN_MSG, 0);
+		if (nbytes != frame_size)
+		{
+			LogError("unable to send buffer to remote for [%lu] messages", (unsigned long)count);
+			/*Codes_SRS_OUTPROCESS_MODULE_17_025: [ This function shall free any resources created. ]*/
+			nn_freemsg(result);
+		}
+	}
+}
+
+static void send_outgoing_batch(OUTPROCESS_HANDLE_DATA* handleData, OUTGOING_BATCH_ENTRY* entries, size_t count)
+{
+	int64_t frame_limit = ((handleData->batch_max_bytes == 0) || (handleData->batch_max_bytes > INT32_MAX)) ? INT32_MAX : handleData->batch_max_bytes;
+	size_t serialized = 0;
+	size_t i;
+	for (i = 0; i < count; i++)
+	{
+		/*Codes_SRS_OUTPROCESS_MODULE_17_023: [ This function shall serialize the message for transmission on the message channel. ]*/
+		/*Codes_SRS_OUTPROCESS_MODULE_17_078: [ The message shall be serialized with Message_GetSerialized, so that a message sent to several remote modules is serialized once. ]*/
+		const CONSTBUFFER* serialized_message = Message_GetSerialized(entries[i].message);
+		if (serialized_message == NULL)
+		{
+			LogError("unable to serialize outgoing message [%p]", entries[i].message);
+			Message_Destroy(entries[i].message);
+		}
+		else
+		{
+			entries[serialized].message = entries[i].message;
+			entries[serialized].bytes = serialized_message->buffer;
+			entries[serialized].size = (int32_t)serialized_message->size;
+			serialized++;
+		}
+	}
+
+	i = 0;
+	while (i < serialized)
+	{
+		/*Codes_SRS_OUTPROCESS_MODULE_17_074: [ The batching thread shall pack consecutive messages into one frame for as long as the frame stays within batch_max_bytes, if set; a message larger than batch_max_bytes shall be sent in a frame of its own. ]*/
+		size_t end = i + 1;
+		int64_t frame_size = MESSAGE_BATCH_HEADER_SIZE + MESSAGE_BATCH_ENTRY_HEADER_SIZE + (int64_t)entries[i].size;
+		while ((end < serialized) &&
+			(frame_size + MESSAGE_BATCH_ENTRY_HEADER_SIZE + entries[end].size <= frame_limit))
+		{
+			frame_size += MESSAGE_BATCH_ENTRY_HEADER_SIZE + entries[end].size;
+			end++;
+		}
+		send_outgoing_frame(handleData, entries + i, end - i, (end - i == 1) ? entries[i].size : (int32_t)frame_size);
+		i = end;
+	}
+
+	for (i = 0; i < serialized; i++)
+	{
+		/*Codes_SRS_OUTPROCESS_MODULE_17_055: [ This function shall Destroy the message once successfully transmitted. ]*/
+		Message_Destroy(entries[i].message);
+	}
+}
+
+static int outprocessOutgoingBatchesThread(void * param)
+{
+	OUTPROCESS_HANDLE_DATA * handleData = (OUTPROCESS_HANDLE_DATA*)param;
+	OUTGOING_BATCH_ENTRY * entries;
+	if (handleData == NULL)
+	{
+		LogError("outprocess send batch thread: parameter is NULL");
+	}
+	else if ((entries = (OUTGOING_BATCH_ENTRY*)malloc(handleData->batch_max_count * sizeof(OUTGOING_BATCH_ENTRY))) == NULL)
+	{
+		LogError("unable to allocate outgoing message batch");
+	}
+	else
+	{
+		/* conditions wait in milliseconds, so the linger is rounded up */
+		int linger_ms = (int)((handleData->batch_max_linger + 999) / 1000);
+		size_t previous_count = 0;
+		int should_continue = 1;
+
+		while (should_continue)
+		{
+			/*Codes_SRS_OUTPROCESS_MODULE_17_053: [ This thread shall ensure thread safety on the module data. ]*/
+			if (Lock(handleData->message_send_thread.thread_lock) != LOCK_OK)
+			{
+				LogError("unable to Lock");
+				should_continue = 0;
+				break;
+			}
+			if (handleData->message_send_thread.thread_flag == THREAD_FLAG_STOP)
+			{
+				should_continue = 0;
+				(void)Unlock(handleData->message_send_thread.thread_lock);
+				break;
+			}
+			if (Unlock(handleData->message_send_thread.thread_lock) != LOCK_OK)
+			{
+				should_continue = 0;
+				break;
+			}
+			/*Codes_SRS_OUTPROCESS_MODULE_17_053: [ This thread shall ensure thread safety on the module data. ]*/
+			if (Lock(handleData->handle_lock) != LOCK_OK)
+			{
+				LogError("unable to Lock");
+				should_continue = 0;
+				break;
+			}
+
+			size_t count = 0;
+			if (MESSAGE_QUEUE_is_empty(handleData->outgoing_messages))
+			{
+				/* Outprocess_Destroy signals the condition under handle_lock after setting the stop flag */
+				if (handleData->message_send_thread.thread_flag != THREAD_FLAG_STOP)
+				{
+					/*Codes_SRS_OUTPROCESS_MODULE_17_063: [ If the outgoing gateway message queue is empty, this function shall wait on the outgoing message condition until a message is queued or the thread is asked to stop. ]*/
+					if (Condition_Wait(handleData->outgoing_messages_cond, handleData->handle_lock, 0) != COND_OK)
+					{
+						LogError("unable to wait for outgoing messages");
+						should_continue = 0;
+					}
+				}
+			}
+			else
+			{
+				count = take_outgoing_messages(handleData, entries, 0);
+				/*Codes_SRS_OUTPROCESS_MODULE_17_073: [ If the batch is not full and the previous batch held more than one message, the batching thread shall wait once, up to batch_max_linger microseconds rounded up to whole milliseconds, for more messages before sending the batch. ]*/
+				if ((count < handleData->batch_max_count) && (previous_count > 1) && (linger_ms > 0) &&
+					(handleData->message_send_thread.thread_flag != THREAD_FLAG_STOP))
+				{
+					if (Condition_Wait(handleData->outgoing_messages_cond, handleData->handle_lock, linger_ms) == COND_ERROR)
+					{
+						LogError("unable to wait for more outgoing messages");
+						should_continue = 0;
+					}
+					else
+					{
+						count = take_outgoing_messages(handleData, entries, count);
+					}
+				}
+			}
+			if (Unlock(handleData->handle_lock) != LOCK_OK)
+			{
+				should_continue = 0;
+			}
+
+			/* forward messages to remote, even if the thread is about to end, as they have left the queue */
+			if (count > 0)
+			{
+				send_outgoing_batch(handleData, entries, count);
+			}
+			previous_count = count;
+		}
+		free(entries);
+	}
+	return 0;
+}
+
 static int outprocessCreate(void *param)
 {
 	int thread_return;
@@ -455,61 +786,115 @@ int outprocessControlThread(void *param)
 /* Connection related functions
 */
 
+static MESSAGE_RING_HANDLE create_message_ring(const char* ring_id, const char* direction, uint32_t size)
+{
+	MESSAGE_RING_HANDLE result;
+	size_t id_length = strlen(ring_id);
+	size_t direction_length = strlen(direction);
+	char* ring_name = (char*)malloc(id_length + direction_length + 1);
+	if (ring_name == NULL)
+	{
+		LogError("unable to allocate message ring name");
+		result = NULL;
+	}
+	else
+	{
+		(void)memcpy(ring_name, ring_id, id_length);
+		(void)memcpy(ring_name + id_length, direction, direction_length + 1);
+		result = MessageRing_Create(ring_name, size);
+		if (result == NULL)
+		{
+			LogError("unable to create message ring %s", ring_name);
+		}
+		free(ring_name);
+	}
+	return result;
+}
+
 static int connection_setup(OUTPROCESS_HANDLE_DATA* handleData, OUTPROCESS_MODULE_CONFIG * config)
 {
 	int result;
+	const char* message_uri = STRING_c_str(config->message_uri);
 	handleData->control_socket = -1;
+	handleData->message_socket = -1;
+	handleData->outgoing_ring = NULL;
+	handleData->incoming_ring = NULL;
 	/*
 	* Start with messaging socket.
 	*/
-	/*Codes_SRS_OUTPROCESS_MODULE_17_008: [ This function shall create a pair socket for sending gateway messages to the module host. ]*/
-	handleData->message_socket = nn_socket(AF_SP, NN_PAIR);
-	if (handleData->message_socket < 0)
+	if (message_uri != NULL && strncmp(message_uri, MESSAGE_RING_URI_HEAD, MESSAGE_RING_URI_HEAD_SIZE) == 0)
 	{
-		result = handleData->message_socket;
-		LogError("message socket failed to create, result = %d, errno = %d", result, nn_errno());
+		/*Codes_SRS_OUTPROCESS_MODULE_17_069: [ If the message_uri starts with "shm://", this function shall create a message ring named after the rest of the uri followed by "_to_module" for gateway messages to the module host, and one followed by "_to_gateway" for gateway messages from the module host. ]*/
+		/*Codes_SRS_OUTPROCESS_MODULE_17_085: [ Each message ring shall reserve ring_size bytes for messages, or MESSAGE_RING_DEFAULT_SIZE bytes if ring_size is 0. ]*/
+		const char* ring_id = message_uri + MESSAGE_RING_URI_HEAD_SIZE;
+		if ((handleData->outgoing_ring = create_message_ring(ring_id, MESSAGE_RING_TO_MODULE_SUFFIX, config->ring_size)) == NULL)
+		{
+			result = -1;
+		}
+		else if ((handleData->incoming_ring = create_message_ring(ring_id, MESSAGE_RING_TO_GATEWAY_SUFFIX, config->ring_size)) == NULL)
+		{
+			result = -1;
+		}
+		else
+		{
+			result = 0;
+		}
 	}
 	else
 	{
-		/*Codes_SRS_OUTPROCESS_MODULE_17_009: [ This function shall bind and connect the pair socket to the message_uri. ]*/
-		int message_bind_id = nn_connect(handleData->message_socket, STRING_c_str(config->message_uri));
-		if (message_bind_id < 0)
+		/*Codes_SRS_OUTPROCESS_MODULE_17_008: [ This function shall create a pair socket for sending gateway messages to the module host. ]*/
+		handleData->message_socket = nn_socket(AF_SP, NN_PAIR);
+		if (handleData->message_socket < 0)
 		{
-			result = message_bind_id;
-			LogError("remote socket failed to bind to message URL, result = %d, errno = %d", result, nn_errno());
+			result = handleData->message_socket;
+			LogError("message socket failed to create, result = %d, errno = %d", result, nn_errno());
 		}
 		else
 		{
-			/*
-			* Now, the control socket.
-			*/
-			/*Codes_SRS_OUTPROCESS_MODULE_17_010: [ This function shall create a request/reply socket for sending control messages to the module host. ]*/
-			handleData->control_socket = nn_socket(AF_SP, NN_PAIR);
-			if (handleData->control_socket < 0)
+			/*Codes_SRS_OUTPROCESS_MODULE_17_009: [ This function shall bind and connect the pair socket to the message_uri. ]*/
+			result = nn_connect(handleData->message_socket, message_uri);
+			if (result < 0)
+			{
+				LogError("remote socket failed to bind to message URL, result = %d, errno = %d", result, nn_errno());
+			}
+			else
 			{
-				result = handleData->control_socket;
+				result = 0;
+			}
+		}
+	}
+
+	if (result == 0)
+	{
+		/*
+		* Now, the control socket.
+		*/
+		/*Codes_SRS_OUTPROCESS_MODULE_17_010: [ This function shall create a request/reply socket for sending control messages to the module host. ]*/
+		handleData->control_socket = nn_socket(AF_SP, NN_PAIR);
+		if (handleData->control_socket < 0)
+		{
+			result = handleData->control_socket;
+			LogError("remote socket failed to connect to control URL, result = %d, errno = %d", result, nn_errno());
+		}
+		else
+		{
+			/*Codes_SRS_OUTPROCESS_MODULE_17_011: [ This function shall connect the request/reply socket to the control_id. ]*/
+			int control_connect_id = nn_connect(handleData->control_socket, STRING_c_str(config->control_uri));
+			if (control_connect_id < 0)
+			{
+				result = control_connect_id;
 				LogError("remote socket failed to connect to control URL, result = %d, errno = %d", result, nn_errno());
 			}
 			else
 			{
-				/*Codes_SRS_OUTPROCESS_MODULE_17_011: [ This function shall connect the request/reply socket to the control_id. ]*/
-				int control_connect_id = nn_connect(handleData->control_socket, STRING_c_str(config->control_uri));
-				if (control_connect_id < 0)
-				{
-					result = control_connect_id;
-					LogError("remote socket failed to connect to control URL, result = %d, errno = %d", result, nn_errno());
-				}
-				else
-				{
-					result = 0;
-				}
+				result = 0;
 			}
 		}
 	}
 	return result;
 }
 
-static void connection_teardown(OUTPROCESS_HANDLE_DATA* handleData)
+static void sockets_teardown(OUTPROCESS_HANDLE_DATA* handleData)
 {
 	if (Lock(handleData->handle_lock) != LOCK_OK)
 	{
@@ -522,6 +907,27 @@ static void connection_teardown(OUTPROCESS_HANDLE_DATA* handleData)
 	(void)Unlock(handleData->handle_lock);
 }
 
+/* rings are unmapped only once no thread can be using them */
+static void message_rings_teardown(OUTPROCESS_HANDLE_DATA* handleData)
+{
+	if (handleData->outgoing_ring != NULL)
+	{
+		MessageRing_Destroy(handleData->outgoing_ring);
+		handleData->outgoing_ring = NULL;
+	}
+	if (handleData->incoming_ring != NULL)
+	{
+		MessageRing_Destroy(handleData->incoming_ring);
+		handleData->incoming_ring = NULL;
+	}
+}
+
+static void connection_teardown(OUTPROCESS_HANDLE_DATA* handleData)
+{
+	sockets_teardown(handleData);
+	message_rings_teardown(handleData);
+}
+
 
 
 /**/
@@ -731,7 +1137,10 @@ static MODULE_HANDLE Outprocess_Create(BROKER_HANDLE broker, const void* configu
 			else
 			{
 				/*Codes_SRS_OUTPROCESS_MODULE_17_042: [ This function shall initialize a queue for outgoing gateway messages. ]*/
-				module->outgoing_messages = MESSAGE_QUEUE_create();
+				/*Codes_SRS_OUTPROCESS_MODULE_17_079: [ If queue_capacity is not 0, this function shall create the queue by calling MESSAGE_QUEUE_create_bounded with queue_capacity. ]*/
+				module->outgoing_messages = (config->queue_capacity == 0) ?
+					MESSAGE_QUEUE_create() :
+					MESSAGE_QUEUE_create_bounded(config->queue_capacity);
 				if (module->outgoing_messages == NULL)
 				{
 					LogError("unable to create outgoing message queue");
@@ -761,6 +1170,13 @@ static MODULE_HANDLE Outprocess_Create(BROKER_HANDLE broker, const void* configu
 						};
 						module->broker = broker;
 						module->remote_message_wait = config->remote_message_wait;
+						module->batch_max_count = config->batch_max_count;
+						module->batch_max_bytes = config->batch_max_bytes;
+						module->batch_max_linger = config->batch_max_linger;
+						module->queue_capacity = config->queue_capacity;
+						module->queue_policy = config->queue_policy;
+						module->dropped_messages = 0;
+						module->ring_size = (config->ring_size == 0) ? MESSAGE_RING_DEFAULT_SIZE : config->ring_size;
 						module->message_receive_thread = default_thread;
 						module->message_send_thread = default_thread;
 						module->control_thread = default_thread;
@@ -806,6 +1222,19 @@ static MODULE_HANDLE Outprocess_Create(BROKER_HANDLE broker, const void* configu
 							free(module);
 							module = NULL;
 						}
+						/*Codes_SRS_OUTPROCESS_MODULE_17_061: [ This function shall initialize a condition to signal the outgoing gateway message thread when a message is queued. ]*/
+						else if ((module->outgoing_messages_cond = Condition_Init()) == NULL)
+						{
+							connection_teardown(module);
+							MESSAGE_QUEUE_destroy(module->outgoing_messages);
+							Lock_Deinit(module->async_create_thread.thread_lock);
+							Lock_Deinit(module->control_thread.thread_lock);
+							Lock_Deinit(module->message_receive_thread.thread_lock);
+							Lock_Deinit(module->message_send_thread.thread_lock);
+							Lock_Deinit(module->handle_lock);
+							free(module);
+							module = NULL;
+						}
 						else if (save_strings(module, config) != 0)
 						{
 							connection_teardown(module);
@@ -814,6 +1243,7 @@ static MODULE_HANDLE Outprocess_Create(BROKER_HANDLE broker, const void* configu
 							Lock_Deinit(module->control_thread.thread_lock);
 							Lock_Deinit(module->message_receive_thread.thread_lock);
 							Lock_Deinit(module->message_send_thread.thread_lock);
+							Condition_Deinit(module->outgoing_messages_cond);
 							Lock_Deinit(module->handle_lock);
 							free(module);
 							module = NULL;
@@ -834,6 +1264,7 @@ static MODULE_HANDLE Outprocess_Create(BROKER_HANDLE broker, const void* configu
 								Lock_Deinit(module->control_thread.thread_lock);
 								Lock_Deinit(module->message_receive_thread.thread_lock);
 								Lock_Deinit(module->message_send_thread.thread_lock);
+								Condition_Deinit(module->outgoing_messages_cond);
 								Lock_Deinit(module->handle_lock);
 								free(module);
 								module = NULL;
@@ -870,6 +1301,7 @@ static MODULE_HANDLE Outprocess_Create(BROKER_HANDLE broker, const void* configu
 									Lock_Deinit(module->control_thread.thread_lock);
 									Lock_Deinit(module->message_receive_thread.thread_lock);
 									Lock_Deinit(module->message_send_thread.thread_lock);
+									Condition_Deinit(module->outgoing_messages_cond);
 									Lock_Deinit(module->handle_lock);
 									free(module);
 									module = NULL;
@@ -884,7 +1316,7 @@ static MODULE_HANDLE Outprocess_Create(BROKER_HANDLE broker, const void* configu
 	return module;
 }
 
-static void shutdown_a_thread(THREAD_CONTROL * theThreadControl)
+static void shutdown_a_thread(THREAD_CONTROL * theThreadControl, LOCK_HANDLE wake_lock, COND_HANDLE wake_condition)
 {
 	int notUsed;
 	THREAD_HANDLE theCurrentThread;
@@ -908,6 +1340,21 @@ static void shutdown_a_thread(THREAD_CONTROL * theThreadControl)
 		(void)Unlock(theThreadControl->thread_lock);
 	}
 
+	/* a thread waiting on a condition only sees the flag once woken up */
+	if (wake_condition != NULL)
+	{
+		if (Lock(wake_lock) != LOCK_OK)
+		{
+			LogError("not able to Lock, still waking the thread");
+			(void)Condition_Post(wake_condition);
+		}
+		else
+		{
+			(void)Condition_Post(wake_condition);
+			(void)Unlock(wake_lock);
+		}
+	}
+
 	/*Codes_SRS_OUTPROCESS_MODULE_17_033: [ This function shall wait for the messaging thread to complete. ]*/
 	/*Codes_SRS_OUTPROCESS_MODULE_17_051: [ This function shall wait for the outgoing gateway message thread to complete. ]*/
 	/*Codes_SRS_OUTPROCESS_MODULE_17_052: [ This function shall wait for the control thread to complete. ]*/
@@ -963,25 +1410,82 @@ static void Outprocess_Destroy(MODULE_HANDLE moduleHandle)
 
 		/*Codes_SRS_OUTPROCESS_MODULE_17_030: [ This function shall close the message channel socket. ]*/
 		/*Codes_SRS_OUTPROCESS_MODULE_17_031: [ This function shall close the control channel socket. ]*/
-		connection_teardown(handleData);
+		sockets_teardown(handleData);
 		/* then stop the threads */
 
 		/*Codes_SRS_OUTPROCESS_MODULE_17_032: [ This function shall signal the messaging thread to close. ]*/
-		shutdown_a_thread(&(handleData->message_receive_thread));
+		shutdown_a_thread(&(handleData->message_receive_thread), NULL, NULL);
 		/*Codes_SRS_OUTPROCESS_MODULE_17_049: [ This function shall signal the outgoing gateway message thread to close. ]*/
-		shutdown_a_thread(&(handleData->message_send_thread));
+		/*Codes_SRS_OUTPROCESS_MODULE_17_064: [ This function shall signal the outgoing message condition to wake up the outgoing gateway message thread. ]*/
+		shutdown_a_thread(&(handleData->message_send_thread), handleData->handle_lock, handleData->outgoing_messages_cond);
 		/*Codes_SRS_OUTPROCESS_MODULE_17_050: [ This function shall signal the control thread to close. ]*/
-		shutdown_a_thread(&(handleData->control_thread));
-		shutdown_a_thread(&(handleData->async_create_thread));
+		shutdown_a_thread(&(handleData->control_thread), NULL, NULL);
+		shutdown_a_thread(&(handleData->async_create_thread), NULL, NULL);
+		/*Codes_SRS_OUTPROCESS_MODULE_17_070: [ This function shall destroy the message rings, if any, after all threads have completed. ]*/
+		message_rings_teardown(handleData);
 
 		/* Free remaining resources */
 		/*Codes_SRS_OUTPROCESS_MODULE_17_034: [ This function shall release all resources created by this module. ]*/
 		delete_strings(handleData);
+		Condition_Deinit(handleData->outgoing_messages_cond);
 		(void)Lock_Deinit(handleData->handle_lock);
 		free(handleData);
 	}
 }
 
+/* applies the queue policy to *message when the bounded outgoing queue is full, handle_lock must be held.
+ * Returns the message discarded by the policy, if any, which must be destroyed once handle_lock is released.
+ * *message is set to NULL when it is the one discarded. */
+static MESSAGE_HANDLE make_room_in_outgoing_queue(OUTPROCESS_HANDLE_DATA* handleData, MESSAGE_HANDLE* message)
+{
+	MESSAGE_HANDLE dropped;
+	switch (handleData->queue_policy)
+	{
+	case BROKER_QUEUE_POLICY_DROP_NEWEST:
+		/*Codes_SRS_OUTPROCESS_MODULE_17_081: [ If the queue is full and queue_policy is BROKER_QUEUE_POLICY_DROP_NEWEST, this function shall discard the clone. ]*/
+		dropped = *message;
+		*message = NULL;
+		break;
+	case BROKER_QUEUE_POLICY_DROP_OLDEST:
+		/*Codes_SRS_OUTPROCESS_MODULE_17_080: [ If the queue is full and queue_policy is BROKER_QUEUE_POLICY_DROP_OLDEST, this function shall discard the oldest queued message and queue the clone. ]*/
+		dropped = MESSAGE_QUEUE_pop(handleData->outgoing_messages);
+		break;
+	default:
+		/*Codes_SRS_OUTPROCESS_MODULE_17_082: [ If the queue is full and queue_policy is BROKER_QUEUE_POLICY_BLOCK, this function shall wait on the outgoing message condition until the queue has room, and discard the clone if the outgoing thread is not running or the wait fails. ]*/
+		dropped = *message;
+		while ((handleData->message_send_thread.thread_handle != NULL) &&
+			(handleData->message_send_thread.thread_flag != THREAD_FLAG_STOP))
+		{
+			if (Condition_Wait(handleData->outgoing_messages_cond, handleData->handle_lock, OUTGOING_QUEUE_BLOCK_WAIT) == COND_ERROR)
+			{
+				LogError("unable to wait for room in the outgoing message queue");
+				break;
+			}
+			else if (!MESSAGE_QUEUE_is_full(handleData->outgoing_messages))
+			{
+				dropped = NULL;
+				break;
+			}
+		}
+		if (dropped != NULL)
+		{
+			*message = NULL;
+		}
+		break;
+	}
+
+	if (dropped != NULL)
+	{
+		/*Codes_SRS_OUTPROCESS_MODULE_17_083: [ This function shall count the messages discarded by the queue policy and log the first discarded message and then progressively less often. ]*/
+		handleData->dropped_messages++;
+		if ((handleData->dropped_messages & (handleData->dropped_messages - 1)) == 0)
+		{
+			LogError("outgoing queue of module [%p] is full, %zu messages dropped so far", handleData, handleData->dropped_messages);
+		}
+	}
+	return dropped;
+}
+
 static void Outprocess_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHandle)
 {
 	OUTPROCESS_HANDLE_DATA* handleData = moduleHandle;
@@ -1004,13 +1508,33 @@ static void Outprocess_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messag
 			}
 			else
 			{
+				MESSAGE_HANDLE dropped = NULL;
+				if ((handleData->queue_capacity != 0) && MESSAGE_QUEUE_is_full(handleData->outgoing_messages))
+				{
+					dropped = make_room_in_outgoing_queue(handleData, &queued_message);
+				}
+
+				if (queued_message == NULL)
+				{
+					/* discarded by the queue policy */
+				}
 				/*Codes_SRS_OUTPROCESS_MODULE_17_047: [ This function shall push the message onto the end of the outgoing gateway message queue. ]*/
-				if (MESSAGE_QUEUE_push(handleData->outgoing_messages, queued_message) != 0)
+				else if (MESSAGE_QUEUE_push(handleData->outgoing_messages, queued_message) != 0)
 				{
 					LogError("unable to queue the message");
 					Message_Destroy(queued_message);
 				}
+				else
+				{
+					/*Codes_SRS_OUTPROCESS_MODULE_17_062: [ This function shall signal the outgoing message condition after queueing the message. ]*/
+					(void)Condition_Post(handleData->outgoing_messages_cond);
+				}
 				(void)Unlock(handleData->handle_lock);
+
+				if (dropped != NULL)
+				{
+					Message_Destroy(dropped);
+				}
 			}
 		}
 	}
@@ -1030,7 +1554,10 @@ static void Outprocess_Start(MODULE_HANDLE moduleHandle)
 			handleData->message_receive_thread.thread_handle = NULL;
 		}
 		/*Codes_SRS_OUTPROCESS_MODULE_17_043: [ This function shall create a thread to handle outgoing gateway messages to the module host. ]*/
-		else if (ThreadAPI_Create(&(handleData->message_send_thread.thread_handle), outprocessOutgoingMessagesThread, handleData) != THREADAPI_OK)
+		/*Codes_SRS_OUTPROCESS_MODULE_17_071: [ If batch_max_count is greater than 1 and the message channel is not a pair of message rings, the outgoing thread shall send gateway messages in batches. ]*/
+		else if (ThreadAPI_Create(&(handleData->message_send_thread.thread_handle),
+			((handleData->batch_max_count > 1) && (handleData->outgoing_ring == NULL)) ? outprocessOutgoingBatchesThread : outprocessOutgoingMessagesThread,
+			handleData) != THREADAPI_OK)
 		{
 			LogError("failed to spawn outgoing message thread");
 			handleData->control_thread.thread_handle = NULL;